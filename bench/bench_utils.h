@@ -0,0 +1,111 @@
+#ifndef PRIMITIV_BENCH_UTILS_H_
+#define PRIMITIV_BENCH_UTILS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <primitiv/cpu_device.h>
+#include <primitiv/device.h>
+
+#ifdef PRIMITIV_USE_CUDA
+#include <primitiv/cuda_device.h>
+#endif  // PRIMITIV_USE_CUDA
+
+namespace bench_utils {
+
+// Device with its name used in reports.
+struct NamedDevice {
+  std::string name;
+  std::unique_ptr<primitiv::Device> device;
+};
+
+// Makes all devices to be benchmarked: the single-threaded CPU, the CPU with
+// all hardware threads, and every CUDA device.
+inline std::vector<NamedDevice> make_devices() {
+  std::vector<NamedDevice> ret;
+  const unsigned nt = std::max(1u, std::thread::hardware_concurrency());
+  ret.push_back({"CPU(1)", std::unique_ptr<primitiv::Device>(
+        new primitiv::CPUDevice(12345, 1))});
+  if (nt > 1) {
+    ret.push_back({"CPU(" + std::to_string(nt) + ')',
+        std::unique_ptr<primitiv::Device>(
+          new primitiv::CPUDevice(12345, nt))});
+  }
+#ifdef PRIMITIV_USE_CUDA
+  for (unsigned i = 0; i < primitiv::CUDADevice::num_devices(); ++i) {
+    ret.push_back({"CUDA(" + std::to_string(i) + ')',
+        std::unique_ptr<primitiv::Device>(
+          new primitiv::CUDADevice(i, 12345))});
+  }
+#endif  // PRIMITIV_USE_CUDA
+  return ret;
+}
+
+// Returns the number of seconds elapsed from `start`.
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Calls fn() repeatedly until `min_seconds` elapses, and returns the average
+// seconds per call. The device is synchronized before stopping the timer so
+// that asynchronous kernels are included.
+template<typename Fn>
+double measure(primitiv::Device &dev, Fn fn, double min_seconds = .2) {
+  // Warming up, which also fills memory pools.
+  fn();
+  dev.synchronize();
+  unsigned n = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    fn();
+    ++n;
+    dev.synchronize();
+    elapsed = seconds_since(start);
+  } while (elapsed < min_seconds);
+  return elapsed / n;
+}
+
+// Prints the header of the result table.
+inline void print_header() {
+  std::printf(
+      "%-10s %-20s %-32s %12s %10s %10s\n",
+      "device", "benchmark", "config", "usec/call", "GFLOP/s", "GB/s");
+}
+
+// Prints one row of the result table.
+// flops and bytes are the numbers of floating point operations and memory
+// transfers of one call. 0 means that the throughput is not meaningful.
+inline void report(
+    const std::string &device, const std::string &name,
+    const std::string &config, double seconds, double flops, double bytes) {
+  std::printf("%-10s %-20s %-32s %12.2f", device.c_str(), name.c_str(),
+      config.c_str(), seconds * 1e6);
+  if (flops > 0) std::printf(" %10.2f", flops / seconds * 1e-9);
+  else std::printf(" %10s", "-");
+  if (bytes > 0) std::printf(" %10.2f", bytes / seconds * 1e-9);
+  else std::printf(" %10s", "-");
+  std::printf("\n");
+  std::fflush(stdout);
+}
+
+// Checks whether the benchmark is selected by filters.
+// All benchmarks are selected if no filter is given. Otherwise, benchmarks
+// whose names contain one of the filters are selected.
+inline bool selected(
+    const std::vector<std::string> &filters, const std::string &name) {
+  if (filters.empty()) return true;
+  for (const std::string &f : filters) {
+    if (name.find(f) != std::string::npos) return true;
+  }
+  return false;
+}
+
+}  // namespace bench_utils
+
+#endif  // PRIMITIV_BENCH_UTILS_H_
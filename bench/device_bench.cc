@@ -0,0 +1,178 @@
+// Microbenchmarks of Device primitives.
+//
+// Usage:
+//   device_bench [filter...]
+//
+// Each filter selects benchmarks whose names contain it, e.g.
+// `device_bench matmul random_` runs matmul and all random generators.
+// Every benchmark is run on the single-threaded CPU, the CPU with all hardware
+// threads and every CUDA device.
+
+#include <config.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <primitiv/device.h>
+#include <primitiv/shape.h>
+#include <primitiv/tensor.h>
+#include <bench_utils.h>
+
+using primitiv::Device;
+using primitiv::Shape;
+using primitiv::Tensor;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Size of one element in bytes.
+const double F = sizeof(float);
+
+// Shapes used by elementwise operations and random generators.
+const vector<Shape> VECTOR_SHAPES {
+  Shape({1 << 10}), Shape({1 << 10}, 64), Shape({1 << 16}),
+  Shape({1 << 16}, 16), Shape({1 << 20}),
+};
+
+// Shapes used by reductions and manipulations.
+const vector<Shape> MATRIX_SHAPES {
+  Shape({64, 64}), Shape({64, 64}, 64), Shape({256, 256}),
+  Shape({256, 256}, 16), Shape({1024, 1024}),
+};
+
+struct Context {
+  const vector<string> *filters;
+  const string *dev_name;
+  Device *dev;
+
+  // Runs the benchmark if it is selected.
+  // flops and bytes are the amounts of one call.
+  void run(
+      const string &name, const string &config, double flops, double bytes,
+      const std::function<void()> &fn) const {
+    if (!bench_utils::selected(*filters, name)) return;
+    const double sec = bench_utils::measure(*dev, fn);
+    bench_utils::report(*dev_name, name, config, sec, flops, bytes);
+  }
+
+  void run(
+      const string &name, const Shape &shape, double flops, double bytes,
+      const std::function<void()> &fn) const {
+    run(name, shape.to_string(), flops, bytes, fn);
+  }
+};
+
+void bench_matmul(const Context &c) {
+  struct Case { unsigned m, k, n, batch; };
+  const vector<Case> cases {
+    {64, 64, 64, 1}, {64, 64, 64, 64}, {256, 256, 256, 1},
+    {256, 256, 256, 16}, {1024, 1024, 1024, 1}, {1024, 1024, 1, 1},
+    {1024, 1024, 64, 1}, {4096, 512, 32, 1},
+  };
+  for (const Case &cs : cases) {
+    const Shape sa({cs.m, cs.k}, cs.batch);
+    const Shape sb({cs.k, cs.n}, cs.batch);
+    const Tensor a = c.dev->random_uniform(sa, -1, 1);
+    const Tensor b = c.dev->random_uniform(sb, -1, 1);
+    const double flops = 2. * cs.m * cs.k * cs.n * cs.batch;
+    const double bytes =
+      F * cs.batch * (cs.m * cs.k + cs.k * cs.n + cs.m * cs.n);
+    c.run("matmul", sa.to_string() + '*' + sb.to_string(), flops, bytes,
+        [&] { c.dev->matmul_fw(a, b); });
+  }
+}
+
+void bench_elementwise(const Context &c) {
+  for (const Shape &s : VECTOR_SHAPES) {
+    const double n = s.size();
+    const Tensor a = c.dev->random_uniform(s, -1, 1);
+    const Tensor b = c.dev->random_uniform(s, 1, 2);
+    c.run("add", s, n, 3 * F * n, [&] { c.dev->add_fw(a, b); });
+    c.run("multiply", s, n, 3 * F * n, [&] { c.dev->multiply_fw(a, b); });
+    c.run("divide", s, n, 3 * F * n, [&] { c.dev->divide_fw(a, b); });
+    c.run("multiply_const", s, n, 2 * F * n,
+        [&] { c.dev->multiply_const_fw(a, 2); });
+    c.run("exp", s, n, 2 * F * n, [&] { c.dev->exp_fw(a); });
+    c.run("tanh", s, n, 2 * F * n, [&] { c.dev->tanh_fw(a); });
+    c.run("sigmoid", s, n, 2 * F * n, [&] { c.dev->sigmoid_fw(a); });
+    c.run("sqrt", s, n, 2 * F * n, [&] { c.dev->sqrt_fw(b); });
+  }
+}
+
+void bench_reductions(const Context &c) {
+  for (const Shape &s : MATRIX_SHAPES) {
+    const double n = s.size();
+    const Tensor x = c.dev->random_uniform(s, -1, 1);
+    c.run("sum(0)", s, n, F * (n + n / s[0]),
+        [&] { c.dev->sum_fw(x, 0); });
+    c.run("sum(1)", s, n, F * (n + n / s[1]),
+        [&] { c.dev->sum_fw(x, 1); });
+    c.run("logsumexp(0)", s, 3 * n, F * (n + n / s[0]),
+        [&] { c.dev->logsumexp_fw(x, 0); });
+    c.run("softmax(0)", s, 4 * n, 2 * F * n,
+        [&] { c.dev->softmax_fw(x, 0); });
+    if (s.has_batch()) {
+      c.run("batch_sum", s, n, F * (n + n / s.batch()),
+          [&] { c.dev->batch_sum_fw(x); });
+    }
+  }
+}
+
+void bench_manipulations(const Context &c) {
+  for (const Shape &s : MATRIX_SHAPES) {
+    const double n = s.size();
+    const Tensor x = c.dev->random_uniform(s, -1, 1);
+    // Picks one row for each minibatch.
+    vector<unsigned> pick_ids;
+    for (unsigned b = 0; b < s.batch(); ++b) pick_ids.emplace_back(b % s[0]);
+    c.run("pick(0)", s, 0, 2 * F * n / s[0],
+        [&] { c.dev->pick_fw(x, 0, pick_ids); });
+    // Gathers a half of rows.
+    vector<unsigned> gather_ids;
+    for (unsigned i = 0; i < s[0]; i += 2) gather_ids.emplace_back(i);
+    c.run("gather(0)", s, 0, F * n,
+        [&] { c.dev->gather_fw(x, 0, gather_ids); });
+    c.run("slice(0)", s, 0, F * n,
+        [&] { c.dev->slice_fw(x, 0, 0, s[0] / 2); });
+    c.run("slice(1)", s, 0, F * n,
+        [&] { c.dev->slice_fw(x, 1, 0, s[1] / 2); });
+    const vector<const Tensor *> xs {&x, &x, &x, &x};
+    c.run("concat(0)x4", s, 0, 8 * F * n,
+        [&] { c.dev->concat_fw(xs, 0); });
+    c.run("concat(1)x4", s, 0, 8 * F * n,
+        [&] { c.dev->concat_fw(xs, 1); });
+    c.run("transpose", s, 0, 2 * F * n, [&] { c.dev->transpose_fw(x); });
+  }
+}
+
+void bench_random(const Context &c) {
+  for (const Shape &s : VECTOR_SHAPES) {
+    const double bytes = F * s.size();
+    c.run("random_bernoulli", s, 0, bytes,
+        [&] { c.dev->random_bernoulli(s, .3); });
+    c.run("random_uniform", s, 0, bytes,
+        [&] { c.dev->random_uniform(s, -1, 1); });
+    c.run("random_normal", s, 0, bytes,
+        [&] { c.dev->random_normal(s, 0, 1); });
+    c.run("random_log_normal", s, 0, bytes,
+        [&] { c.dev->random_log_normal(s, 0, 1); });
+  }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const vector<string> filters(argv + 1, argv + argc);
+  vector<bench_utils::NamedDevice> devices = bench_utils::make_devices();
+  bench_utils::print_header();
+  for (bench_utils::NamedDevice &nd : devices) {
+    const Context c {&filters, &nd.name, nd.device.get()};
+    ::bench_matmul(c);
+    ::bench_elementwise(c);
+    ::bench_reductions(c);
+    ::bench_manipulations(c);
+    ::bench_random(c);
+  }
+  return 0;
+}
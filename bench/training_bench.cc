@@ -0,0 +1,318 @@
+// End-to-end training benchmarks on synthetic data.
+//
+// Usage:
+//   training_bench [--steps=N] [--profile] [filter...]
+//
+// Models follow the examples: `mlp` is the perceptron of
+// `example/mnist/mnist.cc`, `rnnlm` and `lstmlm` are the language models of
+// `example/ptb/ptb_rnnlm.cc` and `example/ptb/ptb_rnnlm_lstm.cc`.
+// Inputs are generated by a fixed seed, and each step reports the average
+// time of the graph construction, forward, backward and parameter update,
+// and the peak memory of the device. `--profile` also prints the time of each
+// function measured by the profiler of Graph over all steps, which slows down
+// the measured steps.
+
+#include <config.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <primitiv/primitiv.h>
+#include <bench_utils.h>
+
+using primitiv::Device;
+using primitiv::Graph;
+using primitiv::Node;
+using primitiv::Parameter;
+using primitiv::Shape;
+using primitiv::Trainer;
+using primitiv::initializers::Constant;
+using primitiv::initializers::XavierUniform;
+using std::string;
+using std::vector;
+namespace F = primitiv::node_ops;
+
+namespace {
+
+// Seed of the synthetic data.
+const unsigned DATA_SEED = 12345;
+
+// Number of steps measured by default.
+const unsigned DEFAULT_NUM_STEPS = 10;
+
+// Interface of benchmarked models.
+class Model {
+public:
+  virtual ~Model() = default;
+
+  // Returns the trainer which holds all parameters.
+  virtual Trainer &trainer() = 0;
+
+  // Constructs the graph of one step and returns the loss.
+  virtual Node build(Graph &g) = 0;
+};
+
+// Sizes of the multilayer perceptron.
+const unsigned MLP_NUM_INPUT_UNITS = 28 * 28;
+const unsigned MLP_NUM_HIDDEN_UNITS = 800;
+const unsigned MLP_NUM_OUTPUT_UNITS = 10;
+const unsigned MLP_BATCH_SIZE = 200;
+
+// Multilayer perceptron in example/mnist/mnist.cc.
+class MLP : public Model {
+public:
+  explicit MLP(Device &dev)
+    : dev_(dev)
+    , pw1_(
+        "w1", {MLP_NUM_HIDDEN_UNITS, MLP_NUM_INPUT_UNITS}, XavierUniform(),
+        &dev)
+    , pb1_("b1", {MLP_NUM_HIDDEN_UNITS}, Constant(0), &dev)
+    , pw2_(
+        "w2", {MLP_NUM_OUTPUT_UNITS, MLP_NUM_HIDDEN_UNITS}, XavierUniform(),
+        &dev)
+    , pb2_("b2", {MLP_NUM_OUTPUT_UNITS}, Constant(0), &dev)
+    , trainer_(.5)
+    , inputs_(MLP_NUM_INPUT_UNITS * MLP_BATCH_SIZE)
+    , labels_(MLP_BATCH_SIZE) {
+      trainer_.add_parameter(&pw1_);
+      trainer_.add_parameter(&pb1_);
+      trainer_.add_parameter(&pw2_);
+      trainer_.add_parameter(&pb2_);
+      std::mt19937 rng(DATA_SEED);
+      std::uniform_real_distribution<float> pixel(0, 1);
+      for (float &x : inputs_) x = pixel(rng);
+      for (unsigned &t : labels_) t = rng() % MLP_NUM_OUTPUT_UNITS;
+    }
+
+  Trainer &trainer() override { return trainer_; }
+
+  Node build(Graph &g) override {
+    const Node x = F::input(
+        Shape({MLP_NUM_INPUT_UNITS}, MLP_BATCH_SIZE), inputs_, &dev_, &g);
+    const Node w1 = F::input(&pw1_, &g);
+    const Node b1 = F::input(&pb1_, &g);
+    const Node w2 = F::input(&pw2_, &g);
+    const Node b2 = F::input(&pb2_, &g);
+    const Node h = F::dropout(F::relu(F::matmul(w1, x) + b1), .5, true);
+    const Node y = F::matmul(w2, h) + b2;
+    return F::batch::mean(F::softmax_cross_entropy(y, 0, labels_));
+  }
+
+private:
+  Device &dev_;
+  Parameter pw1_, pb1_, pw2_, pb2_;
+  primitiv::trainers::SGD trainer_;
+  vector<float> inputs_;
+  vector<unsigned> labels_;
+};
+
+// Sizes of language models.
+const unsigned LM_VOCAB_SIZE = 10000;
+const unsigned LM_NUM_UNITS = 256;
+const unsigned LM_BATCH_SIZE = 64;
+const unsigned LM_SEQUENCE_LENGTH = 16;
+
+// Makes a minibatch of random word IDs.
+vector<vector<unsigned>> make_sentences() {
+  std::mt19937 rng(DATA_SEED);
+  vector<vector<unsigned>> ret(
+      LM_SEQUENCE_LENGTH + 1, vector<unsigned>(LM_BATCH_SIZE));
+  for (auto &words : ret) {
+    for (unsigned &w : words) w = rng() % LM_VOCAB_SIZE;
+  }
+  return ret;
+}
+
+// Simple RNN language model in example/ptb/ptb_rnnlm.cc.
+class RNNLM : public Model {
+public:
+  explicit RNNLM(Device &dev)
+    : dev_(dev)
+    , plookup_(
+        "lookup", {LM_NUM_UNITS, LM_VOCAB_SIZE}, XavierUniform(), &dev)
+    , pwxs_("wxs", {LM_NUM_UNITS, LM_NUM_UNITS}, XavierUniform(), &dev)
+    , pwsy_("wsy", {LM_VOCAB_SIZE, LM_NUM_UNITS}, XavierUniform(), &dev)
+    , inputs_(make_sentences()) {
+      trainer_.add_parameter(&plookup_);
+      trainer_.add_parameter(&pwxs_);
+      trainer_.add_parameter(&pwsy_);
+    }
+
+  Trainer &trainer() override { return trainer_; }
+
+  Node build(Graph &g) override {
+    const Node lookup = F::input(&plookup_, &g);
+    const Node wxs = F::input(&pwxs_, &g);
+    const Node wsy = F::input(&pwsy_, &g);
+    Node s = F::zeros(Shape({LM_NUM_UNITS}, LM_BATCH_SIZE), &dev_, &g);
+    vector<Node> losses;
+    for (unsigned i = 0; i < LM_SEQUENCE_LENGTH; ++i) {
+      s = F::sigmoid(F::matmul(wxs, F::pick(lookup, 1, inputs_[i]) + s));
+      losses.emplace_back(
+          F::softmax_cross_entropy(F::matmul(wsy, s), 0, inputs_[i + 1]));
+    }
+    return F::batch::mean(F::sum(losses));
+  }
+
+private:
+  Device &dev_;
+  Parameter plookup_, pwxs_, pwsy_;
+  primitiv::trainers::Adam trainer_;
+  vector<vector<unsigned>> inputs_;
+};
+
+// LSTM language model in example/ptb/ptb_rnnlm_lstm.cc.
+class LSTMLM : public Model {
+public:
+  explicit LSTMLM(Device &dev)
+    : dev_(dev)
+    , plookup_(
+        "lookup", {LM_NUM_UNITS, LM_VOCAB_SIZE}, XavierUniform(), &dev)
+    , pwxh_("wxh", {4 * LM_NUM_UNITS, LM_NUM_UNITS}, XavierUniform(), &dev)
+    , pwhh_("whh", {4 * LM_NUM_UNITS, LM_NUM_UNITS}, XavierUniform(), &dev)
+    , pbh_("bh", {4 * LM_NUM_UNITS}, Constant(0), &dev)
+    , pwhy_("why", {LM_VOCAB_SIZE, LM_NUM_UNITS}, XavierUniform(), &dev)
+    , pby_("by", {LM_VOCAB_SIZE}, Constant(0), &dev)
+    , inputs_(make_sentences()) {
+      for (Parameter *p : {
+          &plookup_, &pwxh_, &pwhh_, &pbh_, &pwhy_, &pby_}) {
+        trainer_.add_parameter(p);
+      }
+    }
+
+  Trainer &trainer() override { return trainer_; }
+
+  Node build(Graph &g) override {
+    const Node lookup = F::input(&plookup_, &g);
+    const Node wxh = F::input(&pwxh_, &g);
+    const Node whh = F::input(&pwhh_, &g);
+    const Node bh = F::input(&pbh_, &g);
+    const Node why = F::input(&pwhy_, &g);
+    const Node by = F::input(&pby_, &g);
+    Node h = F::zeros({LM_NUM_UNITS}, &dev_, &g);
+    Node c = h;
+    vector<Node> losses;
+    for (unsigned i = 0; i < LM_SEQUENCE_LENGTH; ++i) {
+      const Node x = F::pick(lookup, 1, inputs_[i]);
+      const Node u = F::matmul(wxh, x) + F::matmul(whh, h) + bh;
+      const Node hc = F::lstm_cell(u, c);
+      h = F::slice(hc, 0, 0, LM_NUM_UNITS);
+      c = F::slice(hc, 0, LM_NUM_UNITS, 2 * LM_NUM_UNITS);
+      const Node y = F::matmul(why, h) + by;
+      losses.emplace_back(F::softmax_cross_entropy(y, 0, inputs_[i + 1]));
+    }
+    return F::batch::mean(F::sum(losses));
+  }
+
+private:
+  Device &dev_;
+  Parameter plookup_, pwxh_, pwhh_, pbh_, pwhy_, pby_;
+  primitiv::trainers::Adam trainer_;
+  vector<vector<unsigned>> inputs_;
+};
+
+// Times of each phase in seconds, accumulated over steps.
+struct StepTimes {
+  double construct = 0, forward = 0, backward = 0, update = 0;
+};
+
+// Trains the model for `num_steps` steps after one warm-up step.
+// If `profile` is not nullptr, function calls of measured steps are recorded.
+StepTimes train(
+    Model &model, Device &dev, unsigned num_steps, Graph *profile) {
+  using Clock = std::chrono::steady_clock;
+  StepTimes t;
+  for (unsigned step = 0; step <= num_steps; ++step) {
+    // The first step is not measured to fill memory pools.
+    const double w = step > 0;
+    model.trainer().reset_gradients();
+    dev.synchronize();
+    Graph local_g;
+    Graph &g = profile ? *profile : local_g;
+    g.set_profiling(profile && step > 0);
+    auto start = Clock::now();
+    const Node loss = model.build(g);
+    t.construct += w * bench_utils::seconds_since(start);
+    start = Clock::now();
+    g.forward(loss);
+    dev.synchronize();
+    t.forward += w * bench_utils::seconds_since(start);
+    start = Clock::now();
+    g.backward(loss);
+    dev.synchronize();
+    t.backward += w * bench_utils::seconds_since(start);
+    // Values held by the graph are released before the update, otherwise
+    // the update duplicates the memory of each parameter.
+    g.clear();
+    start = Clock::now();
+    model.trainer().update(1);
+    dev.synchronize();
+    t.update += w * bench_utils::seconds_since(start);
+  }
+  return t;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned num_steps = DEFAULT_NUM_STEPS;
+  bool profile = false;
+  vector<string> filters;
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    if (arg.compare(0, 8, "--steps=") == 0) {
+      num_steps = std::max(1, std::stoi(arg.substr(8)));
+    } else if (arg == "--profile") {
+      profile = true;
+    } else {
+      filters.emplace_back(arg);
+    }
+  }
+
+  struct Entry {
+    string name;
+    std::unique_ptr<Model> (*make)(Device &);
+  };
+  const vector<Entry> entries {
+    {"mlp", [](Device &dev) { return std::unique_ptr<Model>(new MLP(dev)); }},
+    {"rnnlm",
+      [](Device &dev) { return std::unique_ptr<Model>(new RNNLM(dev)); }},
+    {"lstmlm",
+      [](Device &dev) { return std::unique_ptr<Model>(new LSTMLM(dev)); }},
+  };
+
+  std::printf(
+      "%-10s %-8s %6s %12s %12s %12s %12s %12s %10s\n",
+      "device", "model", "steps", "build[ms]", "forward[ms]", "backward[ms]",
+      "update[ms]", "total[ms]", "peak[MB]");
+  for (const Entry &e : entries) {
+    if (!bench_utils::selected(filters, e.name)) continue;
+    // Each model uses new devices so that peak memories are not mixed.
+    vector<bench_utils::NamedDevice> devices = bench_utils::make_devices();
+    for (bench_utils::NamedDevice &nd : devices) {
+      Device &dev = *nd.device;
+      std::unique_ptr<Model> model = e.make(dev);
+      Graph profile_g;
+      const StepTimes t =
+        ::train(*model, dev, num_steps, profile ? &profile_g : nullptr);
+      const double k = 1e3 / num_steps;
+      std::printf(
+          "%-10s %-8s %6u %12.3f %12.3f %12.3f %12.3f %12.3f %10.2f\n",
+          nd.name.c_str(), e.name.c_str(), num_steps,
+          k * t.construct, k * t.forward, k * t.backward, k * t.update,
+          k * (t.construct + t.forward + t.backward + t.update),
+          dev.memory_pool_stats().peak_bytes_in_use / 1048576.);
+      std::fflush(stdout);
+      if (profile) {
+        profile_g.dump_profile(std::cout);
+        std::cout << std::endl;
+      }
+    }
+  }
+  return 0;
+}
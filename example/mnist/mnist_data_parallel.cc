@@ -0,0 +1,211 @@
+// Sample code to train/test the MNIST dataset:
+//   http://yann.lecun.com/exdb/mnist/
+//
+// The model consists of a full-connected 2-layer (input/hidden/output)
+// perceptron with the softmax cross entropy loss.
+// In addition, this example replicates the model on 2 different GPUs, and each
+// GPU calculates the half of every minibatch.
+//
+// Usage:
+//   Run 'download_mnist.sh' in the same directory before using this code.
+// g++
+//   -std=c++11
+//   -I/path/to/primitiv/includes (typically -I../..)
+//   -L/path/to/primitiv/libs     (typically -L../../build/primitiv)
+//   mnist_data_parallel.cc -lprimitiv
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <primitiv/primitiv.h>
+#include <primitiv/primitiv_cuda.h>
+
+using primitiv::CUDADevice;
+using primitiv::DataParallel;
+using primitiv::Device;
+using primitiv::Graph;
+using primitiv::Node;
+using primitiv::Parameter;
+using primitiv::trainers::SGD;
+using primitiv::Shape;
+using primitiv::initializers::Constant;
+using primitiv::initializers::XavierUniform;
+namespace F = primitiv::node_ops;
+using namespace std;
+
+namespace {
+
+const unsigned NUM_TRAIN_SAMPLES = 60000;
+const unsigned NUM_TEST_SAMPLES = 10000;
+const unsigned NUM_INPUT_UNITS = 28 * 28;
+const unsigned NUM_HIDDEN_UNITS = 800;
+const unsigned NUM_OUTPUT_UNITS = 10;
+const unsigned BATCH_SIZE = 50;
+const unsigned NUM_DEVICES = 2;
+const unsigned LOCAL_BATCH_SIZE = BATCH_SIZE / NUM_DEVICES;
+const unsigned NUM_TRAIN_BATCHES = NUM_TRAIN_SAMPLES / BATCH_SIZE;
+const unsigned NUM_TEST_BATCHES = NUM_TEST_SAMPLES / BATCH_SIZE;
+const unsigned MAX_EPOCH = 100;
+
+// Helper function to load input images.
+vector<float> load_images(const string &filename, const unsigned n) {
+  ifstream ifs(filename, ios::binary);
+  if (!ifs.is_open()) {
+    cerr << "File could not be opened: " << filename << endl;
+    abort();
+  }
+
+  ifs.ignore(16);  // header
+  const unsigned size = n * NUM_INPUT_UNITS;
+  vector<unsigned char> buf(size);
+  ifs.read(reinterpret_cast<char *>(&buf[0]), size);
+  vector<float> ret(size);
+  for (unsigned i = 0; i < size; ++i) ret[i] = buf[i] / 255.0;
+  return ret;
+}
+
+// Helper function to load labels.
+vector<char> load_labels(const string &filename, const unsigned n) {
+  ifstream ifs(filename, ios::binary);
+  if (!ifs.is_open()) {
+    cerr << "File could not be opened: " << filename << endl;
+    abort();
+  }
+
+  ifs.ignore(8);  // header
+  vector<char> ret(n);
+  ifs.read(&ret[0], n);
+  return ret;
+}
+
+}  // namespace
+
+int main() {
+  // Loads data
+  vector<float> train_inputs = ::load_images("data/train-images-idx3-ubyte", NUM_TRAIN_SAMPLES);
+  vector<char> train_labels = ::load_labels("data/train-labels-idx1-ubyte", NUM_TRAIN_SAMPLES);
+  vector<float> test_inputs = ::load_images("data/t10k-images-idx3-ubyte", NUM_TEST_SAMPLES);
+  vector<char> test_labels = ::load_labels("data/t10k-labels-idx1-ubyte", NUM_TEST_SAMPLES);
+
+  // Initializes 2 device objects which manage different GPUs.
+  CUDADevice dev0(0);  // GPU 0
+  CUDADevice dev1(1);  // GPU 1
+  const vector<Device *> devices {&dev0, &dev1};
+
+  // Replicas of parameters on each GPU.
+  // Names of replicas should be different to register them to one trainer.
+  vector<unique_ptr<Parameter>> pw1, pb1, pw2, pb2;
+  for (unsigned d = 0; d < NUM_DEVICES; ++d) {
+    const string suffix = "@" + to_string(d);
+    pw1.emplace_back(new Parameter("w1" + suffix, {NUM_HIDDEN_UNITS, NUM_INPUT_UNITS}, XavierUniform(), devices[d]));
+    pb1.emplace_back(new Parameter("b1" + suffix, {NUM_HIDDEN_UNITS}, Constant(0), devices[d]));
+    pw2.emplace_back(new Parameter("w2" + suffix, {NUM_OUTPUT_UNITS, NUM_HIDDEN_UNITS}, XavierUniform(), devices[d]));
+    pb2.emplace_back(new Parameter("b2" + suffix, {NUM_OUTPUT_UNITS}, Constant(0), devices[d]));
+  }
+
+  // Synchronizes replicas and averages their gradients.
+  DataParallel dp(devices);
+  for (auto *params : {&pw1, &pb1, &pw2, &pb2}) {
+    vector<Parameter *> replicas;
+    for (auto &p : *params) replicas.emplace_back(p.get());
+    dp.add_parameter(replicas);
+  }
+  dp.broadcast_values();
+
+  // Trainer
+  // All replicas are updated by the same trainer using averaged gradients.
+  SGD trainer(.1);
+  for (auto *params : {&pw1, &pb1, &pw2, &pb2}) {
+    for (auto &p : *params) trainer.add_parameter(p.get());
+  }
+
+  // Helper lambda to construct the predictor network on the d-th GPU.
+  auto make_graph = [&](unsigned d, const vector<float> &inputs, Graph &g) {
+    const unsigned batch_size = inputs.size() / NUM_INPUT_UNITS;
+    Node x = F::input(Shape({NUM_INPUT_UNITS}, batch_size), inputs, devices[d], &g);
+    Node w1 = F::input(pw1[d].get(), &g);
+    Node b1 = F::input(pb1[d].get(), &g);
+    Node w2 = F::input(pw2[d].get(), &g);
+    Node b2 = F::input(pb2[d].get(), &g);
+    Node h = F::relu(F::matmul(w1, x) + b1);
+    return F::matmul(w2, h) + b2;
+  };
+
+  // Batch randomizer
+  mt19937 rng;
+  vector<unsigned> ids(NUM_TRAIN_SAMPLES);
+  iota(begin(ids), end(ids), 0);
+
+  for (unsigned epoch = 0; epoch < MAX_EPOCH; ++epoch) {
+    // Shuffles sample IDs.
+    shuffle(begin(ids), end(ids), rng);
+
+    // Training loop
+    for (unsigned batch = 0; batch < NUM_TRAIN_BATCHES; ++batch) {
+      trainer.reset_gradients();
+
+      // Each GPU calculates gradients of its own part of the minibatch.
+      for (unsigned d = 0; d < NUM_DEVICES; ++d) {
+        vector<float> inputs(LOCAL_BATCH_SIZE * NUM_INPUT_UNITS);
+        vector<unsigned> labels(LOCAL_BATCH_SIZE);
+        for (unsigned i = 0; i < LOCAL_BATCH_SIZE; ++i) {
+          const unsigned id = ids[i + d * LOCAL_BATCH_SIZE + batch * BATCH_SIZE];
+          copy(&train_inputs[id * NUM_INPUT_UNITS],
+               &train_inputs[(id + 1) * NUM_INPUT_UNITS],
+               &inputs[i * NUM_INPUT_UNITS]);
+          labels[i] = train_labels[id];
+        }
+
+        Graph g;
+        Node y = make_graph(d, inputs, g);
+        Node loss = F::softmax_cross_entropy(y, 0, labels);
+        Node avg_loss = F::batch::mean(loss);
+        g.forward(avg_loss);
+        g.backward(avg_loss);
+      }
+
+      // Averages gradients over GPUs, and updates all replicas.
+      dp.allreduce_gradients();
+      trainer.update(1);
+    }
+
+    unsigned match = 0;
+
+    // Test loop
+    // Replicas have the same values, so the test uses only GPU 0.
+    for (unsigned batch = 0; batch < NUM_TEST_BATCHES; ++batch) {
+      // Makes a test minibatch.
+      vector<float> inputs(BATCH_SIZE * NUM_INPUT_UNITS);
+      copy(&test_inputs[batch * BATCH_SIZE * NUM_INPUT_UNITS],
+           &test_inputs[(batch + 1) * BATCH_SIZE * NUM_INPUT_UNITS],
+           &inputs[0]);
+
+      // Constructs the graph.
+      Graph g;
+      Node y = make_graph(0, inputs, g);
+
+      // Gets outputs, argmax, and compares them with the label.
+      vector<float> y_val = g.forward(y).to_vector();
+      for (unsigned i = 0; i < BATCH_SIZE; ++i) {
+        float maxval = -1e10;
+        unsigned argmax = -1;
+        for (unsigned j = 0; j < NUM_OUTPUT_UNITS; ++j) {
+          float v = y_val[j + i * NUM_OUTPUT_UNITS];
+          if (v > maxval) maxval = v, argmax = j;
+        }
+        if (argmax == test_labels[i + batch * BATCH_SIZE]) ++match;
+      }
+    }
+
+    const float accuracy = 100.0 * match / NUM_TEST_SAMPLES;
+    printf("epoch %d: accuracy: %.2f%%\n", epoch, accuracy);
+  }
+
+  return 0;
+}
@@ -149,7 +149,10 @@ int main() {
       }
 
       // Constructs the graph.
+      // Functions on GPU 0 and GPU 1 are launched by different threads so
+      // that independent parts of the network can overlap.
       Graph g;
+      g.set_parallel_execution(true);
       Node y = make_graph(inputs, g);
       Node loss = F::softmax_cross_entropy(y, 0, labels);
       Node avg_loss = F::batch::mean(loss);
@@ -158,6 +161,9 @@ int main() {
       trainer.reset_gradients();
       g.forward(avg_loss);
       g.backward(avg_loss);
+      // Values held by the graph are released before the update so that
+      // parameters are updated without duplicating their memory.
+      g.clear();
       trainer.update(1);
     }
 
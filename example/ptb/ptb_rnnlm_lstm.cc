@@ -142,13 +142,11 @@ class LSTM {
 
     // Forward one step.
     Node forward(const Node &x) {
+      // All gates are calculated from one preactivation by the fused cell.
       const Node u = F::matmul(wxh_, x) + F::matmul(whh_, h_) + bh_;
-      const Node i = F::sigmoid(F::slice(u, 0, 0, out_size_));
-      const Node f = F::sigmoid(F::slice(u, 0, out_size_, 2 * out_size_));
-      const Node o = F::sigmoid(F::slice(u, 0, 2 * out_size_, 3 * out_size_));
-      const Node j = F::tanh(F::slice(u, 0, 3 * out_size_, 4 * out_size_));
-      c_ = i * j + f * c_;
-      h_ = o * F::tanh(c_);
+      const Node hc = F::lstm_cell(u, c_);
+      h_ = F::slice(hc, 0, 0, out_size_);
+      c_ = F::slice(hc, 0, out_size_, 2 * out_size_);
       return h_;
     }
 
@@ -102,6 +102,10 @@ int main() {
     // Backpropagation
     g.backward(loss);
 
+    // Releases values held by the graph before updating parameters so that
+    // the parameters are updated without duplicating their memory.
+    g.clear();
+
     // Updates parameters.
     trainer.update(1);
   }
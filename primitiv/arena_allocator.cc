@@ -0,0 +1,127 @@
+#include <config.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <primitiv/arena_allocator.h>
+#include <primitiv/error.h>
+
+using std::make_pair;
+
+namespace primitiv {
+
+ArenaAllocator::ArenaAllocator(std::uint64_t alignment)
+: alignment_(alignment)
+, bytes_in_use_(0)
+, bytes_total_(0) {
+  if (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0) {
+    THROW_ERROR("Alignment should be a power of 2. given: " << alignment_);
+  }
+}
+
+void ArenaAllocator::insert_free(
+    std::uintptr_t addr, std::uint64_t size, std::uintptr_t seg) {
+  blocks_[addr] = Block {size, seg, false};
+  free_blocks_.insert(make_pair(size, addr));
+}
+
+void ArenaAllocator::add_segment(void *base, std::uint64_t size) {
+  const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(base);
+  if (addr & (alignment_ - 1) || size == 0 || size & (alignment_ - 1)) {
+    THROW_ERROR(
+        "Invalid segment. base: " << base << ", size: " << size
+        << ", alignment: " << alignment_);
+  }
+  if (!segments_.insert(make_pair(addr, size)).second) {
+    THROW_ERROR("Segment " << base << " is already registered.");
+  }
+  insert_free(addr, size, addr);
+  bytes_total_ += size;
+}
+
+void *ArenaAllocator::allocate(std::uint64_t size) {
+  if (size > std::numeric_limits<std::uint64_t>::max() - alignment_) {
+    return nullptr;
+  }
+  size = round_up(std::max<std::uint64_t>(size, 1));
+
+  // Best-fit: the smallest free block which is not smaller than `size`.
+  auto it = free_blocks_.lower_bound(make_pair(size, 0));
+  if (it == free_blocks_.end()) return nullptr;
+
+  const std::uint64_t found_size = it->first;
+  const std::uintptr_t addr = it->second;
+  free_blocks_.erase(it);
+
+  Block &block = blocks_[addr];
+  block.used = true;
+  block.size = size;
+  if (found_size > size) {
+    // Splits the remainder as a new free block.
+    insert_free(addr + size, found_size - size, block.segment);
+  }
+  bytes_in_use_ += size;
+  return reinterpret_cast<void *>(addr);
+}
+
+std::uint64_t ArenaAllocator::free(void *ptr) {
+  std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(ptr);
+  auto it = blocks_.find(addr);
+  if (it == blocks_.end() || !it->second.used) {
+    THROW_ERROR("Detected to dispose unknown handle: " << ptr);
+  }
+  const std::uint64_t freed_size = it->second.size;
+  const std::uintptr_t seg = it->second.segment;
+  std::uint64_t size = freed_size;
+  bytes_in_use_ -= freed_size;
+
+  // Coalesces with the next block.
+  auto next = std::next(it);
+  if (next != blocks_.end() &&
+      !next->second.used && next->second.segment == seg) {
+    free_blocks_.erase(make_pair(next->second.size, next->first));
+    size += next->second.size;
+    blocks_.erase(next);
+  }
+
+  // Coalesces with the previous block.
+  if (it != blocks_.begin()) {
+    auto prev = std::prev(it);
+    if (!prev->second.used && prev->second.segment == seg) {
+      free_blocks_.erase(make_pair(prev->second.size, prev->first));
+      size += prev->second.size;
+      addr = prev->first;
+      blocks_.erase(it);
+      it = prev;
+    }
+  }
+
+  it->second.size = size;
+  it->second.used = false;
+  free_blocks_.insert(make_pair(size, addr));
+  return freed_size;
+}
+
+std::vector<void *> ArenaAllocator::remove_free_segments() {
+  std::vector<void *> ret;
+  for (auto it = segments_.begin(); it != segments_.end(); ) {
+    auto bit = blocks_.find(it->first);
+    // A segment is free iff it consists of one free block.
+    if (!bit->second.used && bit->second.size == it->second) {
+      free_blocks_.erase(make_pair(bit->second.size, bit->first));
+      blocks_.erase(bit);
+      bytes_total_ -= it->second;
+      ret.emplace_back(reinterpret_cast<void *>(it->first));
+      it = segments_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return ret;
+}
+
+std::uint64_t ArenaAllocator::largest_free_block() const {
+  return free_blocks_.empty() ? 0 : free_blocks_.rbegin()->first;
+}
+
+}  // namespace primitiv
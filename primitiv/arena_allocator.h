@@ -0,0 +1,129 @@
+#ifndef PRIMITIV_ARENA_ALLOCATOR_H_
+#define PRIMITIV_ARENA_ALLOCATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Bookkeeper of variable-size blocks carved out of large memory segments.
+ * This class never touches the memory itself, and the segments are provided
+ * and released by the owner.
+ * Allocations use the best-fit strategy, splitting the found block.
+ * Adjacent free blocks in the same segment are coalesced on deallocation.
+ */
+class ArenaAllocator {
+  ArenaAllocator() = delete;
+  ArenaAllocator(const ArenaAllocator &) = delete;
+  ArenaAllocator(ArenaAllocator &&) = delete;
+  ArenaAllocator &operator=(const ArenaAllocator &) = delete;
+  ArenaAllocator &operator=(ArenaAllocator &&) = delete;
+
+public:
+  /**
+   * Creates a new ArenaAllocator object.
+   * @param alignment Alignment of the resulting blocks in bytes. Sizes of all
+   *                  blocks are rounded up to the multiple of this value.
+   *                  This value should be a power of 2.
+   */
+  explicit ArenaAllocator(std::uint64_t alignment);
+
+  /**
+   * Retrieves the alignment of blocks.
+   * @return Alignment in bytes.
+   */
+  std::uint64_t alignment() const { return alignment_; }
+
+  /**
+   * Rounds up the size to the multiple of the alignment.
+   * @param size Size in bytes.
+   * @return Rounded size.
+   */
+  std::uint64_t round_up(std::uint64_t size) const {
+    return (size + alignment_ - 1) & ~(alignment_ - 1);
+  }
+
+  /**
+   * Registers a new segment.
+   * @param base Pointer to the head of the segment. This pointer should be
+   *             aligned.
+   * @param size Size of the segment in bytes. This value should be a multiple
+   *             of the alignment.
+   */
+  void add_segment(void *base, std::uint64_t size);
+
+  /**
+   * Allocates a block from registered segments.
+   * @param size Size of the block in bytes.
+   * @return Pointer to the head of the block, or `nullptr` if there is no
+   *         free block large enough.
+   */
+  void *allocate(std::uint64_t size);
+
+  /**
+   * Deallocates a block.
+   * @param ptr Pointer returned by `allocate()`.
+   * @return Size of the deallocated block.
+   */
+  std::uint64_t free(void *ptr);
+
+  /**
+   * Unregisters all segments which have no allocated blocks.
+   * @return Pointers to the head of unregistered segments.
+   */
+  std::vector<void *> remove_free_segments();
+
+  /**
+   * Retrieves the total size of allocated blocks.
+   * @return Size in bytes.
+   */
+  std::uint64_t bytes_in_use() const { return bytes_in_use_; }
+
+  /**
+   * Retrieves the total size of registered segments.
+   * @return Size in bytes.
+   */
+  std::uint64_t bytes_total() const { return bytes_total_; }
+
+  /**
+   * Retrieves the number of registered segments.
+   * @return Number of segments.
+   */
+  unsigned num_segments() const { return segments_.size(); }
+
+  /**
+   * Retrieves the size of the largest free block.
+   * @return Size in bytes, or 0 if there is no free block.
+   */
+  std::uint64_t largest_free_block() const;
+
+private:
+  struct Block {
+    std::uint64_t size;
+    std::uintptr_t segment;
+    bool used;
+  };
+
+  void insert_free(std::uintptr_t addr, std::uint64_t size, std::uintptr_t seg);
+
+  std::uint64_t alignment_;
+  std::uint64_t bytes_in_use_;
+  std::uint64_t bytes_total_;
+
+  // Sizes of segments.
+  std::map<std::uintptr_t, std::uint64_t> segments_;
+
+  // All blocks in all segments, ordered by addresses.
+  std::map<std::uintptr_t, Block> blocks_;
+
+  // Free blocks ordered by (size, address).
+  std::set<std::pair<std::uint64_t, std::uintptr_t>> free_blocks_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_ARENA_ALLOCATOR_H_
@@ -0,0 +1,117 @@
+#include <config.h>
+
+#include <algorithm>
+#include <primitiv/beam_search.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+
+using std::vector;
+
+namespace {
+
+// Extension of a live hypothesis by one token.
+struct Candidate {
+  float score;
+  unsigned parent;
+  unsigned id;
+};
+
+// Sorts hypotheses in descending order of scores. Ties keep their order.
+void sort_hypotheses(vector<primitiv::BeamSearch::Hypothesis> &hyps) {
+  std::stable_sort(
+      hyps.begin(), hyps.end(),
+      [](const primitiv::BeamSearch::Hypothesis &a,
+         const primitiv::BeamSearch::Hypothesis &b) {
+        return a.score > b.score;
+      });
+}
+
+}  // namespace
+
+namespace primitiv {
+
+BeamSearch::BeamSearch(
+    unsigned beam_size, unsigned bos_id, unsigned eos_id, unsigned max_length)
+  : beam_size_(beam_size), bos_id_(bos_id), eos_id_(eos_id)
+  , max_length_(max_length) {
+  if (beam_size == 0) THROW_ERROR("Beam size should be greater than 0.");
+  if (max_length == 0) THROW_ERROR("Maximum length should be greater than 0.");
+}
+
+vector<BeamSearch::Hypothesis> BeamSearch::decode(
+    const StepFunction &step) const {
+  vector<Hypothesis> live {{{}, 0}};
+  vector<Hypothesis> finished;
+  vector<unsigned> ids {bos_id_};
+  vector<unsigned> parents {0};
+  vector<unsigned> top_ids;
+  vector<float> top_values;
+  vector<Candidate> candidates;
+
+  for (unsigned length = 0; length < max_length_; ++length) {
+    const Node scores = step(ids, parents);
+    const Shape &s = scores.shape();
+    if (!s.is_row_vector() || s.batch() != live.size()) {
+      THROW_ERROR(
+          "Invalid shape of scores: " << s.to_string()
+          << ", number of hypotheses: " << live.size());
+    }
+    const Tensor &value = scores.graph()->forward(scores);
+
+    // One more candidate than the beam size is required for each hypothesis
+    // because one of them may be the terminal token.
+    const unsigned k = std::min(beam_size_ + 1, s.volume());
+    value.device()->top_k(value, k, top_ids, top_values);
+    candidates.clear();
+    for (unsigned b = 0; b < live.size(); ++b) {
+      for (unsigned i = 0; i < k; ++i) {
+        candidates.push_back(
+            {live[b].score + top_values[b * k + i], b, top_ids[b * k + i]});
+      }
+    }
+    std::stable_sort(
+        candidates.begin(), candidates.end(),
+        [](const Candidate &a, const Candidate &b) {
+          return a.score > b.score;
+        });
+
+    vector<Hypothesis> next;
+    ids.clear();
+    parents.clear();
+    for (const Candidate &c : candidates) {
+      if (next.size() == beam_size_) break;
+      Hypothesis hyp {live[c.parent].ids, c.score};
+      hyp.ids.emplace_back(c.id);
+      if (c.id == eos_id_) {
+        finished.emplace_back(std::move(hyp));
+      } else {
+        next.emplace_back(std::move(hyp));
+        ids.emplace_back(c.id);
+        parents.emplace_back(c.parent);
+      }
+    }
+    live = std::move(next);
+    if (live.empty()) break;
+
+    // Scores never increase, and the search can stop if the best live
+    // hypothesis is worse than all of the best finished ones.
+    if (finished.size() >= beam_size_) {
+      ::sort_hypotheses(finished);
+      finished.resize(beam_size_);
+      if (finished.back().score >= live.front().score) {
+        live.clear();
+        break;
+      }
+    }
+  }
+
+  finished.insert(
+      finished.end(),
+      std::make_move_iterator(live.begin()),
+      std::make_move_iterator(live.end()));
+  ::sort_hypotheses(finished);
+  if (finished.size() > beam_size_) finished.resize(beam_size_);
+  return finished;
+}
+
+}  // namespace primitiv
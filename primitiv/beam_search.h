@@ -0,0 +1,94 @@
+#ifndef PRIMITIV_BEAM_SEARCH_H_
+#define PRIMITIV_BEAM_SEARCH_H_
+
+#include <functional>
+#include <vector>
+#include <primitiv/graph.h>
+
+namespace primitiv {
+
+/**
+ * Beam search decoder of sequences whose next tokens are scored by a
+ * computation graph.
+ *
+ * Hypotheses in the beam are the samples of the minibatch: each step
+ * calculates the scores of all hypotheses by one call of the model, and only
+ * the best candidates of each hypothesis, obtained by `Device::top_k()`, are
+ * transferred to the host.
+ */
+class BeamSearch {
+  BeamSearch() = delete;
+
+public:
+  /**
+   * Decoded sequence.
+   */
+  struct Hypothesis {
+    // Tokens after the initial token. Finished sequences end with the
+    // terminal token.
+    std::vector<unsigned> ids;
+
+    // Sum of scores of all tokens.
+    float score;
+  };
+
+  /**
+   * Function to calculate scores of the next tokens.
+   * The first argument is the last token of each hypothesis, and the second
+   * argument is the index of the hypothesis of the previous call extended by
+   * each hypothesis, which is used to rearrange the states of the model,
+   * e.g., by `batch::pick(h, parents)`. The first call receives one
+   * hypothesis with `parents == {0}`.
+   * The function should return a node with the shape
+   * `Shape({vocabulary size}, ids.size())` which holds log-probabilities of
+   * the next tokens.
+   */
+  using StepFunction = std::function<Node(
+      const std::vector<unsigned> &ids, const std::vector<unsigned> &parents)>;
+
+  /**
+   * Creates a new BeamSearch object.
+   * @param beam_size Maximum number of hypotheses kept by each step.
+   * @param bos_id The initial token given to the first step.
+   * @param eos_id The terminal token which finishes hypotheses.
+   * @param max_length Maximum number of tokens of each hypothesis.
+   */
+  BeamSearch(
+      unsigned beam_size, unsigned bos_id, unsigned eos_id,
+      unsigned max_length);
+
+  /**
+   * Retrieves the beam size.
+   * @return Maximum number of hypotheses kept by each step.
+   */
+  unsigned beam_size() const { return beam_size_; }
+
+  /**
+   * Retrieves the maximum length of hypotheses.
+   * @return Maximum number of tokens of each hypothesis.
+   */
+  unsigned max_length() const { return max_length_; }
+
+  /**
+   * Searches the best sequences.
+   * @param step Function to calculate scores of the next tokens.
+   * @return At most `beam_size()` hypotheses in descending order of scores.
+   *         Hypotheses which reached `max_length()` are included even if
+   *         they are not finished.
+   * @remarks The search stops as soon as no live hypothesis could be better
+   *          than the finished ones, assuming that scores are not positive.
+   *          Nodes made by `step` are kept by their graph until it is
+   *          cleared, or truncated by `Graph::truncate()`.
+   */
+  std::vector<Hypothesis> decode(const StepFunction &step) const;
+
+private:
+  unsigned beam_size_;
+  unsigned bos_id_;
+  unsigned eos_id_;
+  unsigned max_length_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_BEAM_SEARCH_H_
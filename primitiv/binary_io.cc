@@ -0,0 +1,67 @@
+#include <config.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <primitiv/binary_io.h>
+
+using std::string;
+using std::vector;
+
+namespace primitiv {
+
+MappedFile::MappedFile(const string &path) : data_(nullptr), size_(0) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) THROW_ERROR("Could not open file: " << path);
+  struct ::stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    THROW_ERROR("Could not get the status of file: " << path);
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void *ptr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      ::close(fd);
+      THROW_ERROR("Could not map file: " << path);
+    }
+    data_ = static_cast<const char *>(ptr);
+  }
+  // The mapping remains valid after closing the descriptor.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) ::munmap(const_cast<char *>(data_), size_);
+}
+
+Shape BinaryReader::read_shape() {
+  const std::uint32_t depth = read<std::uint32_t>();
+  vector<unsigned> dims;
+  dims.reserve(depth);
+  for (std::uint32_t i = 0; i < depth; ++i) {
+    dims.emplace_back(read<std::uint32_t>());
+  }
+  const std::uint32_t batch = read<std::uint32_t>();
+  return Shape(dims, batch);
+}
+
+void BinaryWriter::write_shape(const Shape &value) {
+  write<std::uint32_t>(value.depth());
+  for (unsigned i = 0; i < value.depth(); ++i) {
+    write<std::uint32_t>(value[i]);
+  }
+  write<std::uint32_t>(value.batch());
+}
+
+void BinaryWriter::pad(std::uint64_t alignment) {
+  static const char zeros[64] = {};
+  while (pos_ % alignment != 0) {
+    const std::uint64_t n = alignment - pos_ % alignment;
+    write_block(zeros, n < sizeof(zeros) ? n : sizeof(zeros));
+  }
+}
+
+}  // namespace primitiv
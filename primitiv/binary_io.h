@@ -0,0 +1,197 @@
+#ifndef PRIMITIV_BINARY_IO_H_
+#define PRIMITIV_BINARY_IO_H_
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <primitiv/error.h>
+#include <primitiv/shape.h>
+
+namespace primitiv {
+
+/**
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+  MappedFile() = delete;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile(MappedFile &&) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile &operator=(MappedFile &&) = delete;
+
+public:
+  /**
+   * Maps a file into the memory.
+   * @param path File path to map.
+   */
+  explicit MappedFile(const std::string &path);
+
+  ~MappedFile();
+
+  /**
+   * Retrieves the head of the mapped memory.
+   * @return Pointer to the first byte, or nullptr if the file is empty.
+   */
+  const char *data() const { return data_; }
+
+  /**
+   * Retrieves the size of the file.
+   * @return Number of bytes.
+   */
+  std::uint64_t size() const { return size_; }
+
+private:
+  const char *data_;
+  std::uint64_t size_;
+};
+
+/**
+ * Sequential reader of binary values in a memory region.
+ * Values are stored in the native byte order.
+ */
+class BinaryReader {
+  BinaryReader() = delete;
+
+public:
+  /**
+   * Creates a new BinaryReader object.
+   * @param data Head of the region.
+   * @param size Number of bytes of the region.
+   */
+  BinaryReader(const char *data, std::uint64_t size)
+    : data_(data), size_(size), pos_(0) {}
+
+  /**
+   * Retrieves the current position.
+   * @return Offset from the head of the region in bytes.
+   */
+  std::uint64_t position() const { return pos_; }
+
+  /**
+   * Moves the current position.
+   * @param pos New position.
+   */
+  void seek(std::uint64_t pos) {
+    if (pos > size_) {
+      THROW_ERROR(
+          "Position out of range. pos: " << pos << ", size: " << size_);
+    }
+    pos_ = pos;
+  }
+
+  /**
+   * Reads a raw block.
+   * @param size Number of bytes to read.
+   * @return Pointer to the head of the block in the region.
+   */
+  const char *read_block(std::uint64_t size) {
+    if (size > size_ - pos_) {
+      THROW_ERROR(
+          "Unexpected end of data. required: " << size
+          << ", remaining: " << size_ - pos_);
+    }
+    const char *ret = data_ + pos_;
+    pos_ += size;
+    return ret;
+  }
+
+  /**
+   * Reads a scalar value.
+   * @return The value.
+   */
+  template<typename T>
+  T read() {
+    T value;
+    std::memcpy(&value, read_block(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  /**
+   * Reads a string written by `BinaryWriter::write_string()`.
+   * @return The string.
+   */
+  std::string read_string() {
+    const std::uint32_t len = read<std::uint32_t>();
+    return std::string(read_block(len), len);
+  }
+
+  /**
+   * Reads a shape written by `BinaryWriter::write_shape()`.
+   * @return The shape.
+   */
+  Shape read_shape();
+
+private:
+  const char *data_;
+  std::uint64_t size_;
+  std::uint64_t pos_;
+};
+
+/**
+ * Sequential writer of binary values into a stream.
+ * Values are stored in the native byte order.
+ */
+class BinaryWriter {
+  BinaryWriter() = delete;
+
+public:
+  /**
+   * Creates a new BinaryWriter object.
+   * @param os Output stream which should be opened in the binary mode.
+   */
+  explicit BinaryWriter(std::ostream &os) : os_(os), pos_(0) {}
+
+  /**
+   * Retrieves the number of bytes written so far.
+   * @return Number of bytes.
+   */
+  std::uint64_t position() const { return pos_; }
+
+  /**
+   * Writes a raw block.
+   * @param data Head of the block.
+   * @param size Number of bytes to write.
+   */
+  void write_block(const void *data, std::uint64_t size) {
+    os_.write(static_cast<const char *>(data), size);
+    if (!os_) THROW_ERROR("Failed to write " << size << " bytes.");
+    pos_ += size;
+  }
+
+  /**
+   * Writes a scalar value.
+   * @param value The value.
+   */
+  template<typename T>
+  void write(T value) { write_block(&value, sizeof(T)); }
+
+  /**
+   * Writes a string with its length.
+   * @param value The string.
+   */
+  void write_string(const std::string &value) {
+    write<std::uint32_t>(value.size());
+    write_block(value.data(), value.size());
+  }
+
+  /**
+   * Writes dimensions and the batch size of a shape.
+   * @param value The shape.
+   */
+  void write_shape(const Shape &value);
+
+  /**
+   * Writes zeros until the position becomes a multiple of `alignment`.
+   * @param alignment Alignment in bytes.
+   */
+  void pad(std::uint64_t alignment);
+
+private:
+  std::ostream &os_;
+  std::uint64_t pos_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_BINARY_IO_H_
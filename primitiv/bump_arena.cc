@@ -0,0 +1,95 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <primitiv/bump_arena.h>
+#include <primitiv/error.h>
+
+namespace primitiv {
+
+BumpArena::BumpArena(std::size_t chunk_size)
+: chunk_size_(std::max<std::size_t>(chunk_size, 1))
+, chunks_()
+, current_(0)
+, offset_(0)
+, bytes_in_use_(0)
+, bytes_total_(0) {}
+
+BumpArena::~BumpArena() {
+  for (Chunk &chunk : chunks_) std::free(chunk.data);
+}
+
+void *BumpArena::allocate(std::size_t size, std::size_t alignment) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+      alignment > alignof(std::max_align_t)) {
+    THROW_ERROR("Invalid alignment: " << alignment);
+  }
+  size = std::max<std::size_t>(size, 1);
+
+  // Finds the first chunk which has enough space after the current position.
+  // NOTE: Chunks from std::malloc() are aligned to alignof(max_align_t).
+  while (current_ < chunks_.size()) {
+    const Chunk &chunk = chunks_[current_];
+    const std::size_t begin = (offset_ + alignment - 1) & ~(alignment - 1);
+    if (begin <= chunk.size && size <= chunk.size - begin) {
+      bytes_in_use_ += begin + size - offset_;
+      offset_ = begin + size;
+      return chunk.data + begin;
+    }
+    bytes_in_use_ += chunk.size - offset_;
+    ++current_;
+    offset_ = 0;
+  }
+
+  const std::size_t chunk_size = std::max(chunk_size_, size);
+  char *data = static_cast<char *>(std::malloc(chunk_size));
+  if (!data) throw std::bad_alloc();
+  chunks_.push_back(Chunk {data, chunk_size});
+  bytes_total_ += chunk_size;
+  current_ = chunks_.size() - 1;
+  offset_ = size;
+  bytes_in_use_ += size;
+  return data;
+}
+
+void BumpArena::reset() {
+  if (chunks_.size() > 1) {
+    // Merges all chunks.
+    for (Chunk &chunk : chunks_) std::free(chunk.data);
+    chunks_.clear();
+    char *data = static_cast<char *>(std::malloc(bytes_total_));
+    if (data) {
+      chunks_.push_back(Chunk {data, bytes_total_});
+    } else {
+      bytes_total_ = 0;
+    }
+  }
+  current_ = 0;
+  offset_ = 0;
+  bytes_in_use_ = 0;
+}
+
+bool BumpArena::allocated_after(const void *ptr, const Position &pos) const {
+  const char *p = static_cast<const char *>(ptr);
+  for (unsigned i = 0; i < chunks_.size(); ++i) {
+    const Chunk &chunk = chunks_[i];
+    if (p < chunk.data || p >= chunk.data + chunk.size) continue;
+    return i > pos.chunk || (i == pos.chunk && p >= chunk.data + pos.offset);
+  }
+  return false;
+}
+
+void BumpArena::rewind(const Position &pos) {
+  if (pos.bytes_in_use > bytes_in_use_) {
+    THROW_ERROR(
+        "Invalid position: " << pos.bytes_in_use
+        << " bytes are used, but only " << bytes_in_use_
+        << " bytes are used currently.");
+  }
+  current_ = pos.chunk;
+  offset_ = pos.offset;
+  bytes_in_use_ = pos.bytes_in_use;
+}
+
+}  // namespace primitiv
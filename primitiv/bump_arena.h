@@ -0,0 +1,193 @@
+#ifndef PRIMITIV_BUMP_ARENA_H_
+#define PRIMITIV_BUMP_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Memory arena which serves small objects by bumping a pointer.
+ * Objects in the arena are never freed individually, and all memory is
+ * recycled at once by `reset()`, or after a recorded position by `rewind()`.
+ * The arena never calls destructors, and the owner should destroy non-trivial
+ * objects before resetting the arena.
+ */
+class BumpArena {
+  BumpArena(const BumpArena &) = delete;
+  BumpArena(BumpArena &&) = delete;
+  BumpArena &operator=(const BumpArena &) = delete;
+  BumpArena &operator=(BumpArena &&) = delete;
+
+public:
+  /**
+   * Position of the bump pointer, which separates blocks allocated before and
+   * after recording it.
+   */
+  struct Position {
+    unsigned chunk;
+    std::size_t offset;
+    std::size_t bytes_in_use;
+  };
+
+  /**
+   * Creates a new BumpArena object.
+   * @param chunk_size Minimum size of each memory chunk in bytes.
+   * @remarks No memory is allocated until the first call of `allocate()`.
+   */
+  explicit BumpArena(std::size_t chunk_size = 64 * 1024);
+
+  ~BumpArena();
+
+  /**
+   * Allocates a memory block.
+   * @param size Size of the block in bytes.
+   * @param alignment Alignment of the block in bytes. This value should be a
+   *                  power of 2 and not greater than `alignof(max_align_t)`.
+   * @return Pointer to the head of the block.
+   */
+  void *allocate(std::size_t size, std::size_t alignment);
+
+  /**
+   * Constructs a new object in the arena.
+   * @param params Arguments of the constructor.
+   * @return Pointer to the new object.
+   */
+  template <typename T, typename... Params>
+  T *create(Params &&... params) {
+    return new (allocate(sizeof(T), alignof(T)))
+      T(std::forward<Params>(params)...);
+  }
+
+  /**
+   * Invalidates all blocks and makes the memory reusable.
+   * @remarks If the last usage required multiple chunks, they are merged into
+   *          one chunk so that the same usage is served by one allocation.
+   */
+  void reset();
+
+  /**
+   * Retrieves the current position.
+   * @return Position of the next block.
+   */
+  Position position() const { return {current_, offset_, bytes_in_use_}; }
+
+  /**
+   * Checks whether the block is allocated after the position.
+   * @param ptr Pointer to the block.
+   * @param pos Position obtained by `position()` after the last reset.
+   * @return true if `ptr` points a block allocated after `pos`, false if it
+   *         is allocated before `pos` or does not point the arena.
+   */
+  bool allocated_after(const void *ptr, const Position &pos) const;
+
+  /**
+   * Invalidates blocks allocated after the position and makes their memory
+   * reusable.
+   * @param pos Position obtained by `position()` after the last reset. All
+   *            blocks allocated after `pos` are invalidated.
+   * @remarks Unlike `reset()`, chunks are never merged.
+   */
+  void rewind(const Position &pos);
+
+  /**
+   * Retrieves the total size of blocks allocated after the last reset.
+   * @return Size in bytes, including paddings for alignments.
+   */
+  std::size_t bytes_in_use() const { return bytes_in_use_; }
+
+  /**
+   * Retrieves the total size of chunks.
+   * @return Size in bytes.
+   */
+  std::size_t bytes_total() const { return bytes_total_; }
+
+  /**
+   * Retrieves the number of chunks.
+   * @return Number of chunks.
+   */
+  unsigned num_chunks() const { return chunks_.size(); }
+
+private:
+  struct Chunk {
+    char *data;
+    std::size_t size;
+  };
+
+  std::size_t chunk_size_;
+  std::vector<Chunk> chunks_;
+  unsigned current_;
+  std::size_t offset_;
+  std::size_t bytes_in_use_;
+  std::size_t bytes_total_;
+};
+
+/**
+ * Growable array whose elements are stored in a BumpArena.
+ * This object only holds a pointer and sizes, and copying the object makes
+ * another handle of the same elements.
+ * @remarks Growing the array moves elements to a new block, and the old block
+ *          remains in the arena until it is reset.
+ */
+template <typename T>
+class ArenaVector {
+  static_assert(
+      std::is_trivially_destructible<T>::value,
+      "ArenaVector requires trivially destructible elements.");
+
+public:
+  ArenaVector() : data_(nullptr), size_(0), capacity_(0) {}
+
+  unsigned size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T &operator[](unsigned i) { return data_[i]; }
+  const T &operator[](unsigned i) const { return data_[i]; }
+
+  T *begin() { return data_; }
+  T *end() { return data_ + size_; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+
+  /**
+   * Appends a new element.
+   * @param x Element to be appended.
+   * @param arena Arena which stores elements.
+   */
+  void push_back(const T &x, BumpArena &arena) {
+    if (size_ == capacity_) reserve(capacity_ ? 2 * capacity_ : 2, arena);
+    new (data_ + size_++) T(x);
+  }
+
+  /**
+   * Replaces elements with a copy of the range.
+   * @param first Pointer to the first element.
+   * @param last Pointer to the next of the last element.
+   * @param arena Arena which stores elements.
+   */
+  void assign(const T *first, const T *last, BumpArena &arena) {
+    size_ = 0;
+    reserve(last - first, arena);
+    for (; first != last; ++first) new (data_ + size_++) T(*first);
+  }
+
+private:
+  void reserve(unsigned n, BumpArena &arena) {
+    if (n <= capacity_) return;
+    T *data = static_cast<T *>(arena.allocate(n * sizeof(T), alignof(T)));
+    for (unsigned i = 0; i < size_; ++i) new (data + i) T(data_[i]);
+    data_ = data;
+    capacity_ = n;
+  }
+
+  T *data_;
+  unsigned size_;
+  unsigned capacity_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_BUMP_ARENA_H_
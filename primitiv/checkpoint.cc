@@ -0,0 +1,281 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <primitiv/binary_io.h>
+#include <primitiv/checkpoint.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+#include <primitiv/parameter.h>
+#include <primitiv/thread_pool.h>
+#include <primitiv/trainer.h>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Format of checkpoints:
+//   char[8] magic
+//   uint32 version
+//   uint32 dtype (0: float32)
+//   uint32 number of states
+//   for each state (in the name order):
+//     string name
+//     uint32 value
+//   uint32 number of parameters
+//   for each parameter (in the name order):
+//     string name
+//     uint32 number of tensors
+//     for each tensor (the value, followed by statistics in the name order):
+//       string key (empty for the value)
+//       shape
+//       uint64 offset of the data from the head of the file
+//   data blocks, each of them is aligned to CHECKPOINT_ALIGNMENT bytes
+const char CHECKPOINT_MAGIC[8] = {'P', 'R', 'M', 'T', 'V', 'C', 'K', 'P'};
+const std::uint32_t CHECKPOINT_VERSION = 1;
+const std::uint32_t CHECKPOINT_DTYPE_FLOAT32 = 0;
+const std::uint64_t CHECKPOINT_ALIGNMENT = 64;
+
+// Tensor to be written into the checkpoint.
+struct SavedTensor {
+  string key;
+  const primitiv::Tensor *tensor;
+  std::uint64_t offset;
+};
+
+// Parameter to be written into the checkpoint.
+struct SavedParameter {
+  string name;
+  vector<SavedTensor> tensors;
+};
+
+// Writes the header and the index of the checkpoint.
+void write_header(
+    primitiv::BinaryWriter &writer,
+    const vector<std::pair<string, unsigned>> &states,
+    const vector<SavedParameter> &params) {
+  writer.write_block(::CHECKPOINT_MAGIC, sizeof(::CHECKPOINT_MAGIC));
+  writer.write<std::uint32_t>(::CHECKPOINT_VERSION);
+  writer.write<std::uint32_t>(::CHECKPOINT_DTYPE_FLOAT32);
+  writer.write<std::uint32_t>(states.size());
+  for (const auto &kv : states) {
+    writer.write_string(kv.first);
+    writer.write<std::uint32_t>(kv.second);
+  }
+  writer.write<std::uint32_t>(params.size());
+  for (const SavedParameter &param : params) {
+    writer.write_string(param.name);
+    writer.write<std::uint32_t>(param.tensors.size());
+    for (const SavedTensor &t : param.tensors) {
+      writer.write_string(t.key);
+      writer.write_shape(t.tensor->shape());
+      writer.write<std::uint64_t>(t.offset);
+    }
+  }
+}
+
+}  // namespace
+
+namespace primitiv {
+
+void Checkpoint::save(const string &path, const Trainer &trainer) {
+  const auto state_map = trainer.get_states();
+  vector<std::pair<string, unsigned>> states(
+      state_map.begin(), state_map.end());
+  std::sort(states.begin(), states.end());
+
+  vector<::SavedParameter> params;
+  for (const Parameter *param : trainer.parameters()) {
+    params.push_back({param->name(), {{"", &param->value(), 0}}});
+    if (!param->value().valid()) {
+      THROW_ERROR(
+          "Attempted to save an invalid Parameter object: " << param->name());
+    }
+    for (const string &key : param->stats_names()) {
+      // Invalid statistics have no data to be written.
+      const Tensor &stats = param->stats(key);
+      if (stats.valid()) params.back().tensors.push_back({key, &stats, 0});
+    }
+  }
+
+  // Calculates offsets of data blocks using a dummy header.
+  std::ostringstream dummy;
+  BinaryWriter dummy_writer(dummy);
+  ::write_header(dummy_writer, states, params);
+  std::uint64_t offset = dummy_writer.position();
+  for (::SavedParameter &param : params) {
+    for (::SavedTensor &t : param.tensors) {
+      offset = (offset + ::CHECKPOINT_ALIGNMENT - 1)
+        / ::CHECKPOINT_ALIGNMENT * ::CHECKPOINT_ALIGNMENT;
+      t.offset = offset;
+      offset += sizeof(float) * t.tensor->shape().size();
+    }
+  }
+
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs.is_open()) {
+    THROW_ERROR("Could not open file: " << path);
+  }
+  BinaryWriter writer(ofs);
+  ::write_header(writer, states, params);
+
+  // Each tensor is transferred to the host one by one.
+  for (const ::SavedParameter &param : params) {
+    for (const ::SavedTensor &t : param.tensors) {
+      writer.pad(::CHECKPOINT_ALIGNMENT);
+      const vector<float> values = t.tensor->to_vector();
+      writer.write_block(&values[0], sizeof(float) * values.size());
+    }
+  }
+}
+
+Checkpoint::Checkpoint(const string &path) : file_(new MappedFile(path)) {
+  BinaryReader reader(file_->data(), file_->size());
+  if (file_->size() < sizeof(::CHECKPOINT_MAGIC) ||
+      std::memcmp(
+        file_->data(), ::CHECKPOINT_MAGIC, sizeof(::CHECKPOINT_MAGIC))) {
+    THROW_ERROR("Not a checkpoint file: " << path);
+  }
+  reader.read_block(sizeof(::CHECKPOINT_MAGIC));
+  const std::uint32_t version = reader.read<std::uint32_t>();
+  if (version != ::CHECKPOINT_VERSION) {
+    THROW_ERROR("Unsupported version of the checkpoint: " << version);
+  }
+  const std::uint32_t dtype = reader.read<std::uint32_t>();
+  if (dtype != ::CHECKPOINT_DTYPE_FLOAT32) {
+    THROW_ERROR("Unsupported data type of the checkpoint: " << dtype);
+  }
+
+  const std::uint32_t num_states = reader.read<std::uint32_t>();
+  for (std::uint32_t i = 0; i < num_states; ++i) {
+    string name = reader.read_string();
+    states_.emplace(std::move(name), reader.read<std::uint32_t>());
+  }
+
+  const std::uint32_t num_params = reader.read<std::uint32_t>();
+  for (std::uint32_t i = 0; i < num_params; ++i) {
+    const string name = reader.read_string();
+    ParameterEntry &param = index_[name];
+    const std::uint32_t num_tensors = reader.read<std::uint32_t>();
+    for (std::uint32_t j = 0; j < num_tensors; ++j) {
+      const string key = reader.read_string();
+      const Shape shape = reader.read_shape();
+      const std::uint64_t offset = reader.read<std::uint64_t>();
+      param.emplace(key, TensorEntry {shape, offset});
+      // Checks the range of the data here to validate the whole index.
+      tensor_data(param.at(key));
+    }
+    if (param.find("") == param.end()) {
+      THROW_ERROR("Parameter '" << name << "' has no value.");
+    }
+  }
+}
+
+Checkpoint::~Checkpoint() {}
+
+vector<string> Checkpoint::parameter_names() const {
+  vector<string> ret;
+  for (const auto &kv : index_) ret.emplace_back(kv.first);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+const Checkpoint::ParameterEntry &Checkpoint::entry(const string &name) const {
+  const auto it = index_.find(name);
+  if (it == index_.end()) {
+    THROW_ERROR("Parameter '" << name << "' does not exist in the checkpoint.");
+  }
+  return it->second;
+}
+
+const float *Checkpoint::tensor_data(const TensorEntry &entry) const {
+  BinaryReader reader(file_->data(), file_->size());
+  reader.seek(entry.offset);
+  return reinterpret_cast<const float *>(
+      reader.read_block(sizeof(float) * entry.shape.size()));
+}
+
+Parameter Checkpoint::load_parameter(const string &name, Device *device) const {
+  const ParameterEntry &param_entry = entry(name);
+  Parameter param(name, param_entry.at("").shape, device);
+  restore_parameter(param_entry, param);
+  return param;
+}
+
+void Checkpoint::check_parameter(
+    const ParameterEntry &entry, const Parameter &param) const {
+  for (const auto &kv : entry) {
+    if (kv.first.empty()) {
+      if (param.shape() != kv.second.shape) {
+        THROW_ERROR(
+            "Shape mismatched. parameter '" << param.name() << "': "
+            << param.shape().to_string() << " != checkpoint: "
+            << kv.second.shape.to_string());
+      }
+      continue;
+    }
+    if (!param.has_stats(kv.first)) continue;
+    const Tensor &stats = param.stats(kv.first);
+    if (stats.valid() && stats.shape() != kv.second.shape) {
+      THROW_ERROR(
+          "Shape mismatched. parameter '" << param.name() << "', stats('"
+          << kv.first << "').shape(): " << stats.shape().to_string()
+          << " != checkpoint: " << kv.second.shape.to_string());
+    }
+  }
+}
+
+void Checkpoint::restore_parameter(
+    const ParameterEntry &entry, Parameter &param) const {
+  for (const auto &kv : entry) {
+    const float *data = tensor_data(kv.second);
+    if (kv.first.empty()) {
+      param.value().reset_by_array(data);
+      continue;
+    }
+    if (!param.has_stats(kv.first)) param.add_stats(kv.first, kv.second.shape);
+    Tensor &stats = param.stats(kv.first);
+    if (!stats.valid()) {
+      stats = param.device()->new_tensor_by_array(kv.second.shape, data);
+      continue;
+    }
+    stats.reset_by_array(data);
+  }
+}
+
+void Checkpoint::restore(Trainer &trainer) const {
+  // Checks all parameters before overwriting anything.
+  vector<Device *> devices;
+  vector<vector<Parameter *>> groups;
+  for (Parameter *param : trainer.parameters()) {
+    check_parameter(entry(param->name()), *param);
+    Device *dev = param->device();
+    const auto it = std::find(devices.begin(), devices.end(), dev);
+    if (it == devices.end()) {
+      devices.emplace_back(dev);
+      groups.emplace_back(1, param);
+    } else {
+      groups[it - devices.begin()].emplace_back(param);
+    }
+  }
+
+  // Each device is used by only one thread.
+  ThreadPool pool(groups.size());
+  pool.parallel_for(
+      groups.size(), 1,
+      [&](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) {
+          for (Parameter *param : groups[i]) {
+            restore_parameter(entry(param->name()), *param);
+          }
+        }
+      });
+
+  trainer.set_states(states_);
+}
+
+}  // namespace primitiv
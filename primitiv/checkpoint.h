@@ -0,0 +1,140 @@
+#ifndef PRIMITIV_CHECKPOINT_H_
+#define PRIMITIV_CHECKPOINT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <primitiv/shape.h>
+
+namespace primitiv {
+
+class Device;
+class MappedFile;
+class Parameter;
+class Trainer;
+
+/**
+ * Reader of a checkpoint file which holds all parameters registered to a
+ * trainer and internal states of the trainer.
+ * The file begins with the index of all tensors, and each tensor is read from
+ * the memory-mapped file only when it is required.
+ */
+class Checkpoint {
+  Checkpoint() = delete;
+  Checkpoint(const Checkpoint &) = delete;
+  Checkpoint(Checkpoint &&) = delete;
+  Checkpoint &operator=(const Checkpoint &) = delete;
+  Checkpoint &operator=(Checkpoint &&) = delete;
+
+public:
+  /**
+   * Saves all parameters registered to the trainer and its internal states.
+   * @param path File path to write the checkpoint.
+   * @param trainer Trainer object.
+   */
+  static void save(const std::string &path, const Trainer &trainer);
+
+  /**
+   * Opens a checkpoint file and reads its index.
+   * @param path File path of the checkpoint.
+   */
+  explicit Checkpoint(const std::string &path);
+
+  ~Checkpoint();
+
+  /**
+   * Retrieves names of all parameters in the checkpoint.
+   * @return List of names in the ascending order.
+   */
+  std::vector<std::string> parameter_names() const;
+
+  /**
+   * Checks whether the parameter with name `name` exists or not.
+   * @param name Name of the parameter.
+   * @return true if the entry exists, false otherwise.
+   */
+  bool has_parameter(const std::string &name) const {
+    return index_.find(name) != index_.end();
+  }
+
+  /**
+   * Retrieves internal states of the trainer.
+   * @return Map from names to values of states.
+   */
+  const std::unordered_map<std::string, unsigned> &states() const {
+    return states_;
+  }
+
+  /**
+   * Loads one parameter without reading other parameters.
+   * @param name Name of the parameter.
+   * @param device Device object to manage internal memories.
+   * @return A new Parameter object with its statistics.
+   */
+  Parameter load_parameter(const std::string &name, Device *device) const;
+
+  /**
+   * Restores values and statistics of all parameters registered to the
+   * trainer, and internal states of the trainer.
+   * @param trainer Trainer object.
+   * @remarks Parameters on different devices are restored in parallel.
+   *          Values are overwritten in place so that packed buffers of the
+   *          trainer remain valid. Statistics which do not exist in the
+   *          parameter are added.
+   */
+  void restore(Trainer &trainer) const;
+
+private:
+  /**
+   * Location of a tensor in the file.
+   */
+  struct TensorEntry {
+    Shape shape;
+    std::uint64_t offset;
+  };
+
+  /**
+   * Tensors of a parameter. The value has an empty key.
+   */
+  using ParameterEntry = std::unordered_map<std::string, TensorEntry>;
+
+  /**
+   * Retrieves the index entry of a parameter.
+   * @param name Name of the parameter.
+   * @return Index entry.
+   */
+  const ParameterEntry &entry(const std::string &name) const;
+
+  /**
+   * Retrieves the head of the data of a tensor.
+   * @param entry Index entry of the tensor.
+   * @return Pointer to the mapped memory.
+   */
+  const float *tensor_data(const TensorEntry &entry) const;
+
+  /**
+   * Checks whether an existing parameter can be restored from the checkpoint.
+   * @param entry Index entry of the parameter.
+   * @param param Parameter to be checked.
+   */
+  void check_parameter(
+      const ParameterEntry &entry, const Parameter &param) const;
+
+  /**
+   * Copies values and statistics into an existing parameter.
+   * @param entry Index entry of the parameter.
+   * @param param Parameter to be overwritten.
+   * @remarks Shapes should be checked by check_parameter() beforehand.
+   */
+  void restore_parameter(const ParameterEntry &entry, Parameter &param) const;
+
+  std::unique_ptr<MappedFile> file_;
+  std::unordered_map<std::string, unsigned> states_;
+  std::unordered_map<std::string, ParameterEntry> index_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CHECKPOINT_H_
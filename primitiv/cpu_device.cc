@@ -6,20 +6,422 @@
 #include <cmath>
 #include <iostream>
 #include <primitiv/cpu_device.h>
+#include <primitiv/cpu_gemm.h>
+#include <primitiv/cpu_math.h>
+#include <primitiv/cpu_philox.h>
+#include <primitiv/cpu_qgemm.h>
+#include <primitiv/elementwise_ops.h>
 #include <primitiv/error.h>
+#include <primitiv/quantized_parameter.h>
+
+#ifdef PRIMITIV_USE_BLAS
+#include <cblas.h>
+#endif  // PRIMITIV_USE_BLAS
 
 using std::cerr;
 using std::endl;
+namespace E = primitiv::elementwise;
+
+namespace {
+
+// Minimum number of elements processed by each thread.
+const unsigned PARALLEL_GRAIN = 1 << 14;
+
+// Minimum number of multiply-adds to parallelize gemm.
+const double GEMM_PARALLEL_THRESHOLD = 1 << 20;
+
+// Calls op(i) for every i in [0, n) using multiple threads.
+// grain is the minimum number of iterations processed by each thread.
+template<typename Op>
+inline void parallel_repeat(
+    primitiv::ThreadPool &pool, unsigned n, unsigned grain, Op op) {
+  pool.parallel_for(n, grain, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; ++i) op(i);
+  });
+}
+
+// Number of rows processed at once by softmax-like reductions.
+const unsigned SOFTMAX_LANES = 64;
+
+// Calculates max(x) and sum(exp(x - max(x))) of every row along `dim`, and
+// calls op(offset, row, lanes, max, sum) for each block of at most
+// SOFTMAX_LANES rows using multiple threads.
+// Rows in a block are interleaved: the j-th element of the l-th row is
+// src[offset + j * stride + l], where stride is shape.lower_volume(dim), and
+// the index of the row in the reduced shape is `row + l`.
+// Every inner loop runs over contiguous memory so that it can be vectorized.
+template<typename Op>
+void parallel_softmax(
+    primitiv::ThreadPool &pool, const primitiv::Shape &shape, unsigned dim,
+    const float *src, Op op) {
+  const unsigned n = shape[dim];
+  const unsigned stride = shape.lower_volume(dim);
+  const unsigned groups = shape.size() / (stride * n);
+  const unsigned blocks = (stride + SOFTMAX_LANES - 1) / SOFTMAX_LANES;
+  const unsigned grain = std::max(
+      1u, PARALLEL_GRAIN / (n * std::min(stride, SOFTMAX_LANES)));
+  pool.parallel_for(groups * blocks, grain, [&](unsigned begin, unsigned end) {
+    float max[SOFTMAX_LANES];
+    float sum[SOFTMAX_LANES];
+    for (unsigned u = begin; u < end; ++u) {
+      const unsigned l0 = (u % blocks) * SOFTMAX_LANES;
+      const unsigned lanes = std::min(SOFTMAX_LANES, stride - l0);
+      const unsigned row = (u / blocks) * stride + l0;
+      const unsigned offset = (u / blocks) * stride * n + l0;
+      const float *sp = src + offset;
+      if (stride == 1) {
+        float m = sp[0];
+        for (unsigned j = 1; j < n; ++j) m = std::max(m, sp[j]);
+        float s = 0;
+        for (unsigned j = 0; j < n; ++j) s += std::exp(sp[j] - m);
+        max[0] = m;
+        sum[0] = s;
+      } else {
+        for (unsigned l = 0; l < lanes; ++l) max[l] = sp[l];
+        for (unsigned j = 1; j < n; ++j) {
+          const float *p = sp + j * stride;
+          for (unsigned l = 0; l < lanes; ++l) max[l] = std::max(max[l], p[l]);
+        }
+        for (unsigned l = 0; l < lanes; ++l) sum[l] = 0;
+        for (unsigned j = 0; j < n; ++j) {
+          const float *p = sp + j * stride;
+          for (unsigned l = 0; l < lanes; ++l) {
+            sum[l] += std::exp(p[l] - max[l]);
+          }
+        }
+      }
+      op(offset, row, lanes, max, sum);
+    }
+  });
+}
+
+// Calculates dest = f(src, l) for every element of a block of rows made by
+// parallel_softmax().
+template<typename F>
+inline void map_rows(
+    unsigned n, unsigned stride, unsigned lanes,
+    const float *src, float *dest, F f) {
+  if (stride == 1) {
+    for (unsigned j = 0; j < n; ++j) dest[j] = f(src[j], 0);
+    return;
+  }
+  for (unsigned j = 0; j < n; ++j) {
+    const float *sp = src + j * stride;
+    float *dp = dest + j * stride;
+    for (unsigned l = 0; l < lanes; ++l) dp[l] = f(sp[l], l);
+  }
+}
+
+// Calls op(batch, begin, end) to process the elements [begin, end) of every
+// minibatch using multiple threads.
+// If split_batch is false, the same element of different minibatches is
+// always processed by the same thread. This is required when the destination
+// is broadcasted over the minibatch.
+template<typename Op>
+inline void parallel_batch(
+    primitiv::ThreadPool &pool, unsigned bs, unsigned size, bool split_batch,
+    Op op) {
+  if (split_batch) {
+    pool.parallel_for(
+        bs * size, PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          for (unsigned batch = begin / size; batch * size < end; ++batch) {
+            const unsigned offset = batch * size;
+            op(batch,
+               std::max(begin, offset) - offset,
+               std::min(end, offset + size) - offset);
+          }
+        });
+  } else {
+    pool.parallel_for(
+        size, std::max(1u, PARALLEL_GRAIN / bs),
+        [&](unsigned begin, unsigned end) {
+          for (unsigned batch = 0; batch < bs; ++batch) op(batch, begin, end);
+        });
+  }
+}
+
+// Calls op(t, begin, end) to process the elements [begin, end) of the t-th
+// tensor using multiple threads. offsets[t] is the total size of the first t
+// tensors, and elements of all tensors are distributed to threads at once.
+template<typename Op>
+inline void parallel_tensors(
+    primitiv::ThreadPool &pool, const std::vector<unsigned> &offsets, Op op) {
+  const unsigned n = offsets.size() - 1;
+  pool.parallel_for(
+      offsets.back(), PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+        unsigned t = std::upper_bound(
+            offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+        for (; t < n && offsets[t] < end; ++t) {
+          const unsigned offset = offsets[t];
+          op(t,
+             std::max(begin, offset) - offset,
+             std::min(end, offsets[t + 1]) - offset);
+        }
+      });
+}
+
+// Calculates offsets of tensors used by parallel_tensors().
+template<typename TensorPtr>
+inline std::vector<unsigned> tensor_offsets(const std::vector<TensorPtr> &xs) {
+  std::vector<unsigned> offsets(xs.size() + 1, 0);
+  for (unsigned t = 0; t < xs.size(); ++t) {
+    offsets[t + 1] = offsets[t] + xs[t]->shape().size();
+  }
+  return offsets;
+}
+
+// Retrieves writable memory of tensors before parallel_tensors(). Tensor::data()
+// copies the memory shared with other tensors, and it should not be called by
+// multiple threads for the same tensor.
+inline std::vector<float *> mutable_data(
+    const std::vector<primitiv::Tensor *> &xs) {
+  std::vector<float *> ptrs(xs.size());
+  for (unsigned t = 0; t < xs.size(); ++t) {
+    ptrs[t] = static_cast<float *>(xs[t]->data());
+  }
+  return ptrs;
+}
+
+// Number of elements evaluated at once by each instruction of the elementwise
+// program.
+const unsigned ELEMENTWISE_BLOCK = 128;
+
+/*
+ * Elementwise engine. Each function applies a functor of
+ * primitiv/elementwise_ops.h by contiguous loops which the compiler can
+ * vectorize, and the broadcasting of operands is resolved outside the loops.
+ */
+
+// Calculates py[i] = Op::fw(px[i], k).
+template<typename Op>
+inline void unary_fw(
+    primitiv::ThreadPool &pool,
+    const float *px, float k, unsigned size, float *py) {
+  pool.parallel_for(size, PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; ++i) py[i] = Op::fw(px[i], k);
+  });
+}
+
+// Calculates pgx[i] += Op::bw(px[i], py[i], pgy[i], k).
+template<typename Op>
+inline void unary_bw(
+    primitiv::ThreadPool &pool,
+    const float *px, const float *py, const float *pgy, float k,
+    unsigned size, float *pgx) {
+  pool.parallel_for(size, PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; ++i) {
+      pgx[i] += Op::bw(px[i], py[i], pgy[i], k);
+    }
+  });
+}
+
+// Inner loop of binary_fw(). EA (EB) is false if each sample of `a` (`b`) is
+// one value broadcasted to all elements, e.g., the scalar of `add_scalar`.
+template<typename Op, bool EA, bool EB>
+void binary_fw_loop(
+    const float *pa, const float *pb, unsigned begin, unsigned end,
+    float *py) {
+  for (unsigned i = begin; i < end; ++i) {
+    py[i] = Op::fw(pa[EA ? i : 0], pb[EB ? i : 0]);
+  }
+}
+
+// Calculates y = Op::fw(a, b) for every element of each sample. Operands are
+// broadcasted to the minibatch, and operands with one element per sample are
+// also broadcasted to all elements.
+template<typename Op>
+inline void binary_fw(
+    primitiv::ThreadPool &pool,
+    const float *pa, const primitiv::Shape &sa,
+    const float *pb, const primitiv::Shape &sb,
+    const primitiv::Shape &sy, float *py) {
+  typedef void (*Loop)(
+      const float *, const float *, unsigned, unsigned, float *);
+  const unsigned size = sy.volume();
+  const bool ea = sa.volume() == size;
+  const bool eb = sb.volume() == size;
+  const Loop loop = ea
+    ? (eb ? &binary_fw_loop<Op, true, true> : &binary_fw_loop<Op, true, false>)
+    : (eb
+        ? &binary_fw_loop<Op, false, true>
+        : &binary_fw_loop<Op, false, false>);
+  const unsigned skip_a = sa.has_batch() * sa.volume();
+  const unsigned skip_b = sb.has_batch() * sb.volume();
+  ::parallel_batch(
+      pool, sy.batch(), size, true,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        loop(
+            pa + batch * skip_a, pb + batch * skip_b, begin, end,
+            py + batch * size);
+      });
+}
+
+// Calculates ga += ga' and gb += gb' for every element, where
+// Op::bw(a, b, y, gy, ga', gb'). All operands should have the same volume.
+template<typename Op>
+inline void binary_bw(
+    primitiv::ThreadPool &pool,
+    const float *pa, const float *pb, const float *py, const float *pgy,
+    const primitiv::Shape &sy, bool ba, bool bb, float *pga, float *pgb) {
+  const unsigned size = sy.volume();
+  const unsigned skip_a = ba * size;
+  const unsigned skip_b = bb * size;
+  // NOTE: Gradients of broadcasted arguments should be accumulated by the
+  // same thread.
+  ::parallel_batch(
+      pool, sy.batch(), size, ba && bb,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        const float *a = pa + batch * skip_a;
+        const float *b = pb + batch * skip_b;
+        const float *y = py + batch * size;
+        const float *gy = pgy + batch * size;
+        float *ga = pga + batch * skip_a;
+        float *gb = pgb + batch * skip_b;
+        for (unsigned i = begin; i < end; ++i) {
+          float dga, dgb;
+          Op::bw(a[i], b[i], y[i], gy[i], dga, dgb);
+          ga[i] += dga;
+          gb[i] += dgb;
+        }
+      });
+}
+
+// Retrieves the activation of the gemm epilogue.
+inline primitiv::cpu::GemmActivation gemm_activation(
+    primitiv::Device::Activation act) {
+  using namespace primitiv::cpu;
+  switch (act) {
+    case primitiv::Device::ACTIVATION_RELU: return GEMM_ACTIVATION_RELU;
+    case primitiv::Device::ACTIVATION_TANH: return GEMM_ACTIVATION_TANH;
+    case primitiv::Device::ACTIVATION_SIGMOID: return GEMM_ACTIVATION_SIGMOID;
+    default: return GEMM_ACTIVATION_IDENTITY;
+  }
+}
+
+// Calculates C := alpha * op(A) . op(B) + beta * C (column-major) using the
+// CBLAS library if available, or the builtin implementation otherwise.
+// If `ep` is not nullptr, C := act(C + bias) is also applied.
+inline void call_sgemm(
+    primitiv::ThreadPool &pool,
+    bool trans_a, bool trans_b, unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc,
+    const primitiv::cpu::GemmEpilogue *ep = nullptr) {
+  using primitiv::cpu::GemmEpilogue;
+  using primitiv::cpu::GEMM_ACTIVATION_IDENTITY;
+  GemmEpilogue e { nullptr, GEMM_ACTIVATION_IDENTITY };
+  if (ep) e = *ep;
+#ifdef PRIMITIV_USE_BLAS
+  // NOTE: The BLAS library manages its own threads.
+  static_cast<void>(pool);
+  if (e.bias && beta == 0) {
+    // Accumulates the product onto the bias.
+    for (unsigned j = 0; j < n; ++j) {
+      std::copy(e.bias, e.bias + m, c + j * ldc);
+    }
+    beta = 1;
+    e.bias = nullptr;
+  }
+  ::cblas_sgemm(
+      ::CblasColMajor,
+      trans_a ? ::CblasTrans : ::CblasNoTrans,
+      trans_b ? ::CblasTrans : ::CblasNoTrans,
+      m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+  if (e.bias || e.activation != GEMM_ACTIVATION_IDENTITY) {
+    // Applies only the remaining epilogue.
+    primitiv::cpu::gemm(
+        false, false, m, n, 0, 0, nullptr, 1, nullptr, 1, 1, c, ldc, e);
+  }
+#else
+  const unsigned nt = pool.num_threads();
+  if (nt == 1 || static_cast<double>(m) * n * k < GEMM_PARALLEL_THRESHOLD) {
+    primitiv::cpu::gemm(
+        trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, e);
+  } else if (n >= m) {
+    // Splits columns of C.
+    pool.parallel_for(
+        n, std::max(16u, (n + nt - 1) / nt), [&](unsigned begin, unsigned end) {
+          primitiv::cpu::gemm(
+              trans_a, trans_b, m, end - begin, k,
+              alpha, a, lda, b + (trans_b ? begin : begin * ldb), ldb,
+              beta, c + begin * ldc, ldc, e);
+        });
+  } else {
+    // Splits rows of C.
+    pool.parallel_for(
+        m, std::max(16u, (m + nt - 1) / nt), [&](unsigned begin, unsigned end) {
+          GemmEpilogue sub_e = e;
+          if (sub_e.bias) sub_e.bias += begin;
+          primitiv::cpu::gemm(
+              trans_a, trans_b, end - begin, n, k,
+              alpha, a + (trans_a ? begin * lda : begin), lda, b, ldb,
+              beta, c + begin, ldc, sub_e);
+        });
+  }
+#endif  // PRIMITIV_USE_BLAS
+}
+
+/*
+ * Steps of multi-step LSTMs.
+ * Each sample `b` of `y` and `xu` has the layout of lstm_fw(), and vectors of
+ * the previous step are obtained by lstm_prev_h() and lstm_prev_c().
+ */
+struct LSTMArgs {
+  unsigned n;
+  unsigned steps;
+  unsigned xu_skip;
+  unsigned h0_skip;
+  unsigned c0_skip;
+  const float *pxu;
+  const float *pwh;
+  const float *ph0;
+  const float *pc0;
+  const float *py;
+};
+
+inline const float *lstm_prev_h(const LSTMArgs &a, unsigned b, unsigned t) {
+  return t == 0
+    ? a.ph0 + b * a.h0_skip
+    : a.py + (b * a.steps + t - 1) * 2 * a.n;
+}
+
+inline const float *lstm_prev_c(const LSTMArgs &a, unsigned b, unsigned t) {
+  return t == 0
+    ? a.pc0 + b * a.c0_skip
+    : a.py + (b * a.steps + t - 1) * 2 * a.n + a.n;
+}
+
+// Calculates u[b] = xu[b][:, t] + wh . h_{t-1}[b] for all samples.
+// Columns of `wh` are accumulated in order to keep inner loops contiguous.
+void lstm_preactivations(
+    primitiv::ThreadPool &pool, const LSTMArgs &a, unsigned bs, unsigned t,
+    float *pu) {
+  const unsigned n4 = 4 * a.n;
+  pool.parallel_for(
+      bs * n4, std::max(::PARALLEL_GRAIN / a.n, 1u),
+      [&](unsigned begin, unsigned end) {
+        for (unsigned b = begin / n4; b * n4 < end; ++b) {
+          const unsigned r0 = std::max(begin, b * n4) - b * n4;
+          const unsigned r1 = std::min(end, (b + 1) * n4) - b * n4;
+          const float *x = a.pxu + b * a.xu_skip + t * n4;
+          const float *h = ::lstm_prev_h(a, b, t);
+          float *u = pu + b * n4;
+          for (unsigned r = r0; r < r1; ++r) u[r] = x[r];
+          for (unsigned j = 0; j < a.n; ++j) {
+            const float hj = h[j];
+            const float *w = a.pwh + j * n4;
+            for (unsigned r = r0; r < r1; ++r) u[r] += w[r] * hj;
+          }
+        }
+      });
+}
+
+}  // namespace
 
 namespace primitiv {
 
 std::shared_ptr<void> CPUDevice::new_handle(const Shape &shape) {
-  const unsigned mem_size = sizeof(float) * shape.size();
-  void *data = std::malloc(mem_size);
-  if (!data) {
-    THROW_ERROR("Memory allocation failed. Requested size: " << mem_size);
-  }
-  return std::shared_ptr<void>(data, std::free);
+  return pool_.allocate(sizeof(float) * shape.size());
 }
 
 #define DATA(x) static_cast<float *>((x).data())
@@ -28,6 +430,10 @@ std::shared_ptr<void> CPUDevice::new_handle(const Shape &shape) {
 #define REPEAT_OP(i, n, op) \
   for (unsigned (i) = 0; (i) < (n); ++(i)) { (op); }
 
+#define PARALLEL_REPEAT_OP(i, n, op) \
+  ::parallel_repeat( \
+      thread_pool_, (n), ::PARALLEL_GRAIN, [&](unsigned i) { (op); })
+
 std::vector<float> CPUDevice::tensor_to_vector_impl(const Tensor &x) {
   const unsigned num_elements = x.shape().size();
   std::vector<float> ret(num_elements);
@@ -35,10 +441,14 @@ std::vector<float> CPUDevice::tensor_to_vector_impl(const Tensor &x) {
   return ret;
 }
 
+void CPUDevice::tensor_to_array_impl(const Tensor &x, float values[]) {
+  std::memcpy(values, x.data(), sizeof(float) * x.shape().size());
+}
+
 void CPUDevice::reset_tensor_impl(float k, Tensor &x) {
   float *dest = DATA(x);
   const unsigned size = x.shape().size();
-  REPEAT_OP(i, size, dest[i] = k);
+  PARALLEL_REPEAT_OP(i, size, dest[i] = k);
 }
 
 void CPUDevice::reset_tensor_by_array_impl(const float values[], Tensor &x) {
@@ -51,21 +461,51 @@ void CPUDevice::copy_tensor_impl(const Tensor &x, Tensor &y) {
       reset_tensor_by_array(CDATA(x), y);
       break;
     default:
-      reset_tensor_by_vector(x.to_vector(), y);
+      // Other devices write their values into `y` directly.
+      x.to_array(DATA(y));
   }
 }
 
+std::uint64_t CPUDevice::reserve_rng_counters(unsigned size) {
+  const std::uint64_t offset = rng_counter_;
+  // Each counter makes 4 numbers.
+  rng_counter_ += (static_cast<std::uint64_t>(size) + 3) / 4;
+  return offset;
+}
+
 void CPUDevice::random_bernoulli_impl(float p, Tensor &y) {
-  std::bernoulli_distribution dist(p);
   float *dest = DATA(y);
   const unsigned size = y.shape().size();
+  if (counter_based_rng_) {
+    const std::uint64_t offset = reserve_rng_counters(size);
+    thread_pool_.parallel_for(
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          cpu::philox_uniform(rng_seed_, offset, begin, end, dest);
+          for (unsigned i = begin; i < end; ++i) dest[i] = dest[i] <= p;
+        });
+    return;
+  }
+  std::bernoulli_distribution dist(p);
   REPEAT_OP(i, size, dest[i] = dist(rng_));
 }
 
 void CPUDevice::random_uniform_impl(float lower, float upper, Tensor &y) {
-  std::uniform_real_distribution<float> dist(lower, upper);
   float *dest = DATA(y);
   const unsigned size = y.shape().size();
+  if (counter_based_rng_) {
+    const std::uint64_t offset = reserve_rng_counters(size);
+    const float scale = upper - lower;
+    thread_pool_.parallel_for(
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          cpu::philox_uniform(rng_seed_, offset, begin, end, dest);
+          for (unsigned i = begin; i < end; ++i) {
+            const float x = lower + scale * dest[i];
+            dest[i] = x == lower ? upper : x;
+          }
+        });
+    return;
+  }
+  std::uniform_real_distribution<float> dist(lower, upper);
   for (unsigned i = 0; i < size; ++i) {
     const float x = dist(rng_);
     dest[i] = x == lower ? upper : x;
@@ -73,16 +513,36 @@ void CPUDevice::random_uniform_impl(float lower, float upper, Tensor &y) {
 }
 
 void CPUDevice::random_normal_impl(float mean, float sd, Tensor &y) {
-  std::normal_distribution<float> dist(mean, sd);
   float *dest = DATA(y);
   const unsigned size = y.shape().size();
+  if (counter_based_rng_) {
+    const std::uint64_t offset = reserve_rng_counters(size);
+    thread_pool_.parallel_for(
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          cpu::philox_normal(rng_seed_, offset, begin, end, dest);
+          for (unsigned i = begin; i < end; ++i) dest[i] = mean + sd * dest[i];
+        });
+    return;
+  }
+  std::normal_distribution<float> dist(mean, sd);
   REPEAT_OP(i, size, dest[i] = dist(rng_));
 }
 
 void CPUDevice::random_log_normal_impl(float mean, float sd, Tensor &y) {
-  std::lognormal_distribution<float> dist(mean, sd);
   float *dest = DATA(y);
   const unsigned size = y.shape().size();
+  if (counter_based_rng_) {
+    const std::uint64_t offset = reserve_rng_counters(size);
+    thread_pool_.parallel_for(
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          cpu::philox_normal(rng_seed_, offset, begin, end, dest);
+          for (unsigned i = begin; i < end; ++i) {
+            dest[i] = std::exp(mean + sd * dest[i]);
+          }
+        });
+    return;
+  }
+  std::lognormal_distribution<float> dist(mean, sd);
   REPEAT_OP(i, size, dest[i] = dist(rng_));
 }
 
@@ -107,6 +567,24 @@ void CPUDevice::pick_fw_impl(
   }
 }
 
+void CPUDevice::gather_fw_impl(
+    const Tensor &x, unsigned dim,
+    const std::vector<unsigned> &ids, Tensor &y) {
+  const unsigned base = y.shape().lower_volume(dim);
+  const unsigned skip = base * x.shape()[dim];
+  const unsigned repeat = y.shape().size() / (base * ids.size());
+
+  const float *src = CDATA(x);
+  float *dest = DATA(y);
+  for (unsigned i = 0; i < repeat; ++i) {
+    for (const unsigned id : ids) {
+      const float *sp = src + base * id;
+      REPEAT_OP(j, base, *dest++ = *sp++);
+    }
+    src += skip;
+  }
+}
+
 void CPUDevice::slice_fw_impl(
     const Tensor &x, unsigned dim, unsigned offset, Tensor &y) {
   const unsigned base = y.shape().lower_volume(dim);
@@ -130,22 +608,20 @@ void CPUDevice::concat_fw_impl(
   const unsigned skip = base * y.shape()[dim];
   const unsigned repeat = y.shape().volume() / skip;
 
+  // Each source is copied by rows of `span` elements, which are contiguous in
+  // both tensors.
   unsigned offset = 0;
   for (const Tensor *x : xs) {
-    const unsigned src_dim = x->shape()[dim];
-    const unsigned span = base * src_dim;
+    const unsigned span = base * x->shape()[dim];
     const unsigned b_skip = x->shape().has_batch() * span * repeat;
     float *dest = DATA(y) + offset;
     const float *src = CDATA(*x);
-    for (unsigned batch = 0; batch < new_bs; ++batch) {
-      const float *sp = src;
-      for (unsigned i = 0; i < repeat; ++i) {
-        float *dp = dest;
-        REPEAT_OP(j, span, *dp++ = *sp++);
-        dest += skip;
-      }
-      src += b_skip;
-    }
+    ::parallel_repeat(
+        thread_pool_, new_bs * repeat, std::max(1u, ::PARALLEL_GRAIN / span),
+        [&](unsigned r) {
+          const float *sp = src + (r / repeat) * b_skip + (r % repeat) * span;
+          std::memcpy(dest + r * skip, sp, sizeof(float) * span);
+        });
     offset += span;
   }
 }
@@ -170,6 +646,44 @@ void CPUDevice::pick_bw_impl(
   }
 }
 
+void CPUDevice::pick_assign_impl(
+    const Tensor &y, unsigned dim, const std::vector<unsigned>& ids,
+    Tensor &x) {
+  const unsigned bs = y.shape().batch();
+  const unsigned skip_x = x.shape().has_batch() * x.shape().volume();
+  const unsigned skip_i = ids.size() > 1;
+  const unsigned base = y.shape().lower_volume(dim);
+  const unsigned skip = base * x.shape()[dim];
+  const unsigned repeat = y.shape().volume() / base;
+  const float *src = CDATA(y);
+  for (unsigned batch = 0; batch < bs; ++batch) {
+    float *dest = DATA(x) + batch * skip_x + base * ids[batch * skip_i];
+    for (unsigned i = 0; i < repeat; ++i) {
+      std::memcpy(dest, src, sizeof(float) * base);
+      src += base;
+      dest += skip;
+    }
+  }
+}
+
+void CPUDevice::gather_bw_impl(
+    const Tensor &gy, unsigned dim, const std::vector<unsigned>& ids,
+    Tensor &gx) {
+  const unsigned base = gy.shape().lower_volume(dim);
+  const unsigned skip = base * gx.shape()[dim];
+  const unsigned repeat = gy.shape().size() / (base * ids.size());
+
+  const float *src = CDATA(gy);
+  float *dest = DATA(gx);
+  for (unsigned i = 0; i < repeat; ++i) {
+    for (const unsigned id : ids) {
+      float *dp = dest + base * id;
+      REPEAT_OP(j, base, *dp++ += *src++);
+    }
+    dest += skip;
+  }
+}
+
 void CPUDevice::slice_bw_impl(
     const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx) {
   const Shape &sy = gy.shape();
@@ -197,232 +711,166 @@ void CPUDevice::slice_bw_impl(
 }
 
 #define CPUDEV_FW_X(name, op) \
+void CPUDevice::name##_fw_impl(const Tensor &x, Tensor &y) { \
+  ::unary_fw<E::op<double>>( \
+      thread_pool_, CDATA(x), 0, x.shape().size(), DATA(y)); \
+}
+
+// Same as CPUDEV_FW_X, but uses the SIMD approximation `fast_fn` if enabled.
+#define CPUDEV_FW_X_FAST(name, fast_fn, op) \
 void CPUDevice::name##_fw_impl(const Tensor &x, Tensor &y) { \
   float *dest = DATA(y); \
   const float *src = CDATA(x); \
   const unsigned size = x.shape().size(); \
-  REPEAT_OP(i, size, dest[i] = (op)); \
+  if (fast_math_) { \
+    thread_pool_.parallel_for( \
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) { \
+          fast_fn(src + begin, dest + begin, end - begin); \
+        }); \
+  } else { \
+    ::unary_fw<E::op<double>>(thread_pool_, src, 0, size, dest); \
+  } \
 }
 
 #define CPUDEV_BW_X(name, op) \
 void CPUDevice::name##_bw_impl( \
     const Tensor &x, const Tensor &y, const Tensor &gy, Tensor &gx) { \
-  const float *px = CDATA(x); static_cast<void>(px); \
-  const float *py = CDATA(y); static_cast<void>(py); \
-  const float *pgy = CDATA(gy); \
-  float *pgx = DATA(gx); \
-  const unsigned size = x.shape().size(); \
-  REPEAT_OP(i, size, pgx[i] += (op)); \
+  ::unary_bw<E::op<double>>( \
+      thread_pool_, CDATA(x), CDATA(y), CDATA(gy), 0, x.shape().size(), \
+      DATA(gx)); \
 }
 
 #define CPUDEV_FW_X_CONST(name, op) \
 void CPUDevice::name##_fw_impl(const Tensor &x, float k, Tensor &y) { \
-  float *dest = DATA(y); \
-  const float *src = CDATA(x); \
-  const unsigned size = x.shape().size(); \
-  REPEAT_OP(i, size, dest[i] = (op)); \
+  ::unary_fw<E::op<double>>( \
+      thread_pool_, CDATA(x), k, x.shape().size(), DATA(y)); \
 }
 
 #define CPUDEV_BW_X_CONST(name, op) \
 void CPUDevice::name##_bw_impl( \
     const Tensor &x, const Tensor &y, const Tensor &gy, float k, Tensor &gx) { \
-  const float *px = CDATA(x); static_cast<void>(px); \
-  const float *py = CDATA(y); static_cast<void>(py); \
-  const float *pgy = CDATA(gy); \
-  float *pgx = DATA(gx); \
-  const unsigned size = x.shape().size(); \
-  REPEAT_OP(i, size, pgx[i] += (op)); \
+  ::unary_bw<E::op<double>>( \
+      thread_pool_, CDATA(x), CDATA(y), CDATA(gy), k, x.shape().size(), \
+      DATA(gx)); \
 }
 
-#define CPUDEV_FW_X_SCALAR(name, op) \
+// The scalar is the right (R) or left (L) operand of `op`.
+#define CPUDEV_FW_X_SCALAR_R(name, op) \
 void CPUDevice::name##_fw_impl(const Tensor &x, const Tensor &k, Tensor &y) { \
-  const unsigned size = y.shape().volume(); \
-  const unsigned bs = y.shape().batch(); \
-  const unsigned skip_x = x.shape().has_batch() * size; \
-  const unsigned skip_k = k.shape().has_batch(); \
-  float *dest = DATA(y); \
-  const float *src_x = CDATA(x); \
-  const float *src_k = CDATA(k); \
-  for (unsigned batch = 0; batch < bs; ++batch) { \
-    REPEAT_OP(i, size, dest[i] = (op)); \
-    dest += size; \
-    src_x += skip_x; \
-    src_k += skip_k; \
-  } \
+  ::binary_fw<E::op<double>>( \
+      thread_pool_, CDATA(x), x.shape(), CDATA(k), k.shape(), y.shape(), \
+      DATA(y)); \
+}
+
+#define CPUDEV_FW_X_SCALAR_L(name, op) \
+void CPUDevice::name##_fw_impl(const Tensor &x, const Tensor &k, Tensor &y) { \
+  ::binary_fw<E::op<double>>( \
+      thread_pool_, CDATA(k), k.shape(), CDATA(x), x.shape(), y.shape(), \
+      DATA(y)); \
 }
 
 #define CPUDEV_FW_AB(name, op) \
 void CPUDevice::name##_fw_impl(const Tensor &a, const Tensor &b, Tensor &y) { \
-  const unsigned size = y.shape().volume(); \
-  const unsigned bs = y.shape().batch(); \
-  const unsigned skip_a = a.shape().has_batch() * size; \
-  const unsigned skip_b = b.shape().has_batch() * size; \
-  float *dest = DATA(y); \
-  const float *src_a = CDATA(a); \
-  const float *src_b = CDATA(b); \
-  for (unsigned batch = 0; batch < bs; ++batch) { \
-    REPEAT_OP(i, size, dest[i] = (op)); \
-    dest += size; \
-    src_a += skip_a; \
-    src_b += skip_b; \
-  } \
+  ::binary_fw<E::op<double>>( \
+      thread_pool_, CDATA(a), a.shape(), CDATA(b), b.shape(), y.shape(), \
+      DATA(y)); \
 }
 
-CPUDEV_FW_X(negate, -src[i]);
-CPUDEV_FW_X(sqrt, std::sqrt(src[i]));
-CPUDEV_FW_X(exp, std::exp(src[i]));
-CPUDEV_FW_X(tanh, std::tanh(src[i]));
-CPUDEV_FW_X(sigmoid, .5 + .5 * std::tanh(.5 * src[i]));
-CPUDEV_FW_X(
-    softplus, src[i] > 0
-      ? src[i] + std::log(1 + std::exp(-src[i]))
-      : std::log(1 + std::exp(src[i])));
-CPUDEV_FW_X(sin, std::sin(src[i]));
-CPUDEV_FW_X(cos, std::cos(src[i]));
-CPUDEV_FW_X(tan, std::tan(src[i]));
-
-CPUDEV_BW_X(sqrt, .5 * pgy[i] / py[i]);
-CPUDEV_BW_X(exp, py[i] * pgy[i]);
-CPUDEV_BW_X(tanh, (1. - py[i] * py[i]) * pgy[i]);
-CPUDEV_BW_X(sigmoid, py[i] * (1. - py[i]) * pgy[i]);
-CPUDEV_BW_X(softplus, (.5 + .5 * std::tanh(.5 * px[i])) * pgy[i]);
-CPUDEV_BW_X(sin, std::cos(px[i]) * pgy[i]);
-CPUDEV_BW_X(cos, -std::sin(px[i]) * pgy[i]);
-CPUDEV_BW_X(tan, (1 + py[i] * py[i]) * pgy[i]);
-
-CPUDEV_FW_X_CONST(add_const, src[i] + k);
-CPUDEV_FW_X_CONST(subtract_const_r, src[i] - k);
-CPUDEV_FW_X_CONST(subtract_const_l, k - src[i]);
-CPUDEV_FW_X_CONST(multiply_const, src[i] * k);
-CPUDEV_FW_X_CONST(divide_const_r, src[i] / k);
-CPUDEV_FW_X_CONST(divide_const_l, k / src[i]);
-CPUDEV_FW_X_CONST(prelu, src[i] * ((src[i] > 0) + k * (src[i] <= 0)));
-CPUDEV_FW_X_CONST(
-    elu, src[i] * (src[i] > 0) + k * (std::exp(src[i] * (src[i] <= 0)) - 1));
-
-CPUDEV_BW_X_CONST(add_const, pgy[i]);
-CPUDEV_BW_X_CONST(subtract_const_r, pgy[i]);
-CPUDEV_BW_X_CONST(subtract_const_l, -pgy[i]);
-CPUDEV_BW_X_CONST(multiply_const, k * pgy[i]);
-CPUDEV_BW_X_CONST(divide_const_r, pgy[i] / k);
-CPUDEV_BW_X_CONST(divide_const_l, -py[i] * pgy[i] / px[i]);
-CPUDEV_BW_X_CONST(prelu, pgy[i] * ((px[i] > 0) + k * (px[i] <= 0)));
-CPUDEV_BW_X_CONST(elu, pgy[i] * ((px[i] > 0) + (py[i] + k) * (px[i] <= 0)));
-
-CPUDEV_FW_X_SCALAR(add_scalar, src_x[i] + *src_k);
-CPUDEV_FW_X_SCALAR(subtract_scalar_r, src_x[i] - *src_k);
-CPUDEV_FW_X_SCALAR(subtract_scalar_l, *src_k - src_x[i]);
-CPUDEV_FW_X_SCALAR(multiply_scalar, src_x[i] * *src_k);
-CPUDEV_FW_X_SCALAR(divide_scalar_r, src_x[i] / *src_k);
-CPUDEV_FW_X_SCALAR(divide_scalar_l, *src_k / src_x[i]);
-
-CPUDEV_FW_AB(add, src_a[i] + src_b[i]);
-CPUDEV_FW_AB(subtract, src_a[i] - src_b[i]);
-CPUDEV_FW_AB(multiply, src_a[i] * src_b[i]);
-CPUDEV_FW_AB(divide, src_a[i] / src_b[i]);
+#define CPUDEV_BW_AB(name, op) \
+void CPUDevice::name##_bw_impl( \
+    const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy, \
+    Tensor &ga, Tensor &gb) { \
+  ::binary_bw<E::op<double>>( \
+      thread_pool_, CDATA(a), CDATA(b), CDATA(y), CDATA(gy), gy.shape(), \
+      ga.shape().has_batch(), gb.shape().has_batch(), DATA(ga), DATA(gb)); \
+}
 
-#undef CPUDEV_FW_X
-#undef CPUDEV_BW_X
-#undef CPUDEV_FW_X_CONST
-#undef CPUDEV_BW_X_CONST
-#undef CPUDEV_FW_X_SCALAR
-#undef CPUDEV_FW_AB
+CPUDEV_FW_X(negate, Negate);
+CPUDEV_FW_X(sqrt, Sqrt);
+CPUDEV_FW_X_FAST(exp, cpu::fast_exp, Exp);
+CPUDEV_FW_X_FAST(tanh, cpu::fast_tanh, Tanh);
+CPUDEV_FW_X_FAST(sigmoid, cpu::fast_sigmoid, Sigmoid);
+CPUDEV_FW_X_FAST(softplus, cpu::fast_softplus, Softplus);
+CPUDEV_FW_X(sin, Sin);
+CPUDEV_FW_X(cos, Cos);
+CPUDEV_FW_X(tan, Tan);
 
-void CPUDevice::add_bw_impl(
-    const Tensor &, const Tensor &, const Tensor &, const Tensor &gy,
-    Tensor &ga, Tensor &gb) {
-  const unsigned size = gy.shape().volume();
-  const unsigned bs = gy.shape().batch();
-  const unsigned skip_a = ga.shape().has_batch() * size;
-  const unsigned skip_b = gb.shape().has_batch() * size;
-  const float *pgy = CDATA(gy);
-  float *pga = DATA(ga);
-  float *pgb = DATA(gb);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    for (unsigned i = 0; i < size; ++i) {
-      const float k = pgy[i];
-      pga[i] += k;
-      pgb[i] += k;
-    }
-    pgy += size;
-    pga += skip_a;
-    pgb += skip_b;
-  }
-}
+CPUDEV_BW_X(sqrt, Sqrt);
+CPUDEV_BW_X(exp, Exp);
+CPUDEV_BW_X(tanh, Tanh);
+CPUDEV_BW_X(sigmoid, Sigmoid);
+CPUDEV_BW_X(sin, Sin);
+CPUDEV_BW_X(cos, Cos);
+CPUDEV_BW_X(tan, Tan);
 
-void CPUDevice::subtract_bw_impl(
-    const Tensor &, const Tensor &, const Tensor &, const Tensor &gy,
-    Tensor &ga, Tensor &gb) {
-  const unsigned size = gy.shape().volume();
-  const unsigned bs = gy.shape().batch();
-  const unsigned skip_a = ga.shape().has_batch() * size;
-  const unsigned skip_b = gb.shape().has_batch() * size;
+void CPUDevice::softplus_bw_impl(
+    const Tensor &x, const Tensor &y, const Tensor &gy, Tensor &gx) {
+  const float *px = CDATA(x);
   const float *pgy = CDATA(gy);
-  float *pga = DATA(ga);
-  float *pgb = DATA(gb);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    for (unsigned i = 0; i < size; ++i) {
-      const float k = pgy[i];
-      pga[i] += k;
-      pgb[i] -= k;
-    }
-    pgy += size;
-    pga += skip_a;
-    pgb += skip_b;
+  float *pgx = DATA(gx);
+  const unsigned size = x.shape().size();
+  if (fast_math_) {
+    thread_pool_.parallel_for(
+        size, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          // d softplus(x) / dx == sigmoid(x)
+          const unsigned BLOCK = 256;
+          float buf[BLOCK];
+          for (unsigned b = begin; b < end; b += BLOCK) {
+            const unsigned n = std::min(BLOCK, end - b);
+            cpu::fast_sigmoid(px + b, buf, n);
+            for (unsigned i = 0; i < n; ++i) pgx[b + i] += buf[i] * pgy[b + i];
+          }
+        });
+  } else {
+    ::unary_bw<E::Softplus<double>>(
+        thread_pool_, px, CDATA(y), pgy, 0, size, pgx);
   }
 }
 
-void CPUDevice::multiply_bw_impl(
-    const Tensor &a, const Tensor &b, const Tensor &, const Tensor &gy,
-    Tensor &ga, Tensor &gb) {
-  const unsigned size = gy.shape().volume();
-  const unsigned bs = gy.shape().batch();
-  const unsigned skip_a = ga.shape().has_batch() * size;
-  const unsigned skip_b = gb.shape().has_batch() * size;
-  const float *pa = CDATA(a);
-  const float *pb = CDATA(b);
-  const float *pgy = CDATA(gy);
-  float *pga = DATA(ga);
-  float *pgb = DATA(gb);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    for (unsigned i = 0; i < size; ++i) {
-      const float k = pgy[i];
-      pga[i] += k * pb[i];
-      pgb[i] += k * pa[i];
-    }
-    pa += skip_a;
-    pb += skip_b;
-    pgy += size;
-    pga += skip_a;
-    pgb += skip_b;
-  }
-}
+CPUDEV_FW_X_CONST(add_const, AddConst);
+CPUDEV_FW_X_CONST(subtract_const_r, SubtractConstR);
+CPUDEV_FW_X_CONST(subtract_const_l, SubtractConstL);
+CPUDEV_FW_X_CONST(multiply_const, MultiplyConst);
+CPUDEV_FW_X_CONST(divide_const_r, DivideConstR);
+CPUDEV_FW_X_CONST(divide_const_l, DivideConstL);
+CPUDEV_FW_X_CONST(prelu, PReLU);
+CPUDEV_FW_X_CONST(elu, ELU);
 
-void CPUDevice::divide_bw_impl(
-    const Tensor &, const Tensor &b, const Tensor &y, const Tensor &gy,
-    Tensor &ga, Tensor &gb) {
-  const unsigned size = gy.shape().volume();
-  const unsigned bs = gy.shape().batch();
-  const unsigned skip_a = ga.shape().has_batch() * size;
-  const unsigned skip_b = gb.shape().has_batch() * size;
-  const float *pb = CDATA(b);
-  const float *py = CDATA(y);
-  const float *pgy = CDATA(gy);
-  float *pga = DATA(ga);
-  float *pgb = DATA(gb);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    for (unsigned i = 0; i < size; ++i) {
-      const float k = pgy[i] / pb[i];
-      pga[i] += k;
-      pgb[i] -= k * py[i];
-    }
-    pb += skip_b;
-    py += size;
-    pgy += size;
-    pga += skip_a;
-    pgb += skip_b;
-  }
-}
+CPUDEV_BW_X_CONST(add_const, AddConst);
+CPUDEV_BW_X_CONST(subtract_const_r, SubtractConstR);
+CPUDEV_BW_X_CONST(subtract_const_l, SubtractConstL);
+CPUDEV_BW_X_CONST(multiply_const, MultiplyConst);
+CPUDEV_BW_X_CONST(divide_const_r, DivideConstR);
+CPUDEV_BW_X_CONST(divide_const_l, DivideConstL);
+CPUDEV_BW_X_CONST(prelu, PReLU);
+CPUDEV_BW_X_CONST(elu, ELU);
+
+CPUDEV_FW_X_SCALAR_R(add_scalar, Add);
+CPUDEV_FW_X_SCALAR_R(subtract_scalar_r, Subtract);
+CPUDEV_FW_X_SCALAR_L(subtract_scalar_l, Subtract);
+CPUDEV_FW_X_SCALAR_R(multiply_scalar, Multiply);
+CPUDEV_FW_X_SCALAR_R(divide_scalar_r, Divide);
+CPUDEV_FW_X_SCALAR_L(divide_scalar_l, Divide);
+
+CPUDEV_FW_AB(add, Add);
+CPUDEV_FW_AB(subtract, Subtract);
+CPUDEV_FW_AB(multiply, Multiply);
+CPUDEV_FW_AB(divide, Divide);
+
+CPUDEV_BW_AB(add, Add);
+CPUDEV_BW_AB(subtract, Subtract);
+CPUDEV_BW_AB(multiply, Multiply);
+CPUDEV_BW_AB(divide, Divide);
+
+#undef CPUDEV_FW_X
+#undef CPUDEV_FW_X_FAST
+#undef CPUDEV_BW_X
+#undef CPUDEV_FW_X_CONST
+#undef CPUDEV_BW_X_CONST
+#undef CPUDEV_FW_X_SCALAR_R
+#undef CPUDEV_FW_X_SCALAR_L
+#undef CPUDEV_FW_AB
+#undef CPUDEV_BW_AB
 
 void CPUDevice::transpose_fw_impl(const Tensor &x, Tensor &y) {
   const unsigned d1 = x.shape()[0];
@@ -447,47 +895,579 @@ void CPUDevice::transpose_fw_impl(const Tensor &x, Tensor &y) {
 }
 
 void CPUDevice::matmul_fw_impl(const Tensor &a, const Tensor &b, Tensor &y) {
-  const unsigned d1 = a.shape()[0];
-  const unsigned d2 = a.shape()[1];
-  const unsigned d3 = b.shape()[1];
-  const unsigned bs = y.shape().batch();
-  const unsigned dest_shift = d1 * d3;
-  const unsigned src_a_shift = a.shape().has_batch() * d1 * d2;
-  const unsigned src_b_shift = b.shape().has_batch() * d2 * d3;
-
-  float *dest = DATA(y);
-  const float *src_a = CDATA(a);
-  const float *src_b = CDATA(b);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    for (unsigned i = 0; i < d1; ++i) {
-      for (unsigned ky = 0, kb = 0; ky < dest_shift; ky += d1, kb += d2) {
-        float tmp = 0;
-        for (unsigned ja = 0, jb = 0; jb < d2; ja += d1, ++jb) {
-          tmp += src_a[i + ja] * src_b[jb + kb];
-        }
-        dest[i + ky] = tmp;
-      }
+  const unsigned di = a.shape()[0];
+  const unsigned dj = a.shape()[1];
+  const unsigned dk = b.shape()[1];
+  if (a.shape().has_batch()) {
+    // Do gemm multiple times.
+    const unsigned a_skip = di * dj;
+    const unsigned b_skip = b.shape().has_batch() * dj * dk;
+    const unsigned y_skip = di * dk;
+    const unsigned bs = a.shape().batch();
+    for (unsigned n = 0; n < bs; ++n) {
+      ::call_sgemm(
+          thread_pool_,
+          false, false, di, dk, dj,
+          1, CDATA(a) + n * a_skip, di, CDATA(b) + n * b_skip, dj,
+          0, DATA(y) + n * y_skip, di);
     }
-    dest += dest_shift;
-    src_a += src_a_shift;
-    src_b += src_b_shift;
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    ::call_sgemm(
+        thread_pool_,
+        false, false, di, dk * b.shape().batch(), dj,
+        1, CDATA(a), di, CDATA(b), dj,
+        0, DATA(y), di);
   }
 }
 
 void CPUDevice::transpose_bw_impl(
     const Tensor &, const Tensor &, const Tensor &gy, Tensor &gx) {
-  // TODO(odashi): This code could be slow and requires memory. Fix this.
-  inplace_add_impl(transpose_fw(gy), gx);
+  // Accumulates transposed values directly without temporary tensors.
+  const unsigned d1 = gx.shape()[0];
+  const unsigned d2 = gx.shape()[1];
+  const unsigned ms = d1 * d2;
+  const unsigned bs = gx.shape().batch();
+  float *dest = DATA(gx);
+  const float *src = CDATA(gy);
+
+  for (unsigned k = 0; k < bs; ++k) {
+    float *pd = dest;
+    for (unsigned j = 0; j < d1; ++j) {
+      float *ppd = pd;
+      for (unsigned i = 0; i < d2; ++i) {
+        *ppd += *src++;
+        ppd += d1;
+      }
+      ++pd;
+    }
+    dest += ms;
+  }
 }
 
 void CPUDevice::matmul_bw_impl(
     const Tensor &a, const Tensor &b, const Tensor &, const Tensor &gy,
     Tensor &ga, Tensor &gb) {
-  // TODO(odashi): This code could be slow and requires memory. Fix this.
-  inplace_add_impl(matmul_fw(gy, transpose_fw(b)), ga);
-  inplace_add_impl(matmul_fw(transpose_fw(a), gy), gb);
+  // ga += gy . b^T
+  // gb += a^T . gy
+  const unsigned di = a.shape()[0];
+  const unsigned dj = a.shape()[1];
+  const unsigned dk = b.shape()[1];
+  if (a.shape().has_batch()) {
+    // Do gemm multiple times.
+    const unsigned a_skip = di * dj;
+    const unsigned b_skip = b.shape().has_batch() * dj * dk;
+    const unsigned y_skip = di * dk;
+    const unsigned bs = a.shape().batch();
+    for (unsigned n = 0; n < bs; ++n) {
+      ::call_sgemm(
+          thread_pool_,
+          false, true, di, dj, dk,
+          1, CDATA(gy) + n * y_skip, di, CDATA(b) + n * b_skip, dj,
+          1, DATA(ga) + n * a_skip, di);
+      ::call_sgemm(
+          thread_pool_,
+          true, false, dj, dk, di,
+          1, CDATA(a) + n * a_skip, di, CDATA(gy) + n * y_skip, di,
+          1, DATA(gb) + n * b_skip, dj);
+    }
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    ::call_sgemm(
+        thread_pool_,
+        false, true, di, dj, dk * b.shape().batch(),
+        1, CDATA(gy), di, CDATA(b), dj,
+        1, DATA(ga), di);
+    ::call_sgemm(
+        thread_pool_,
+        true, false, dj, dk * b.shape().batch(), di,
+        1, CDATA(a), di, CDATA(gy), di,
+        1, DATA(gb), dj);
+  }
+}
+
+void CPUDevice::affine_fw_impl(
+    const Tensor &w, const Tensor &x, const Tensor &b, Activation act,
+    Tensor &y) {
+  const unsigned di = w.shape()[0];
+  const unsigned dj = w.shape()[1];
+  const unsigned dk = x.shape()[1];
+  const cpu::GemmActivation ga = ::gemm_activation(act);
+  if (w.shape().has_batch() || b.shape().has_batch()) {
+    // Do gemm multiple times.
+    const unsigned w_skip = w.shape().has_batch() * di * dj;
+    const unsigned x_skip = x.shape().has_batch() * dj * dk;
+    const unsigned b_skip = b.shape().has_batch() * di;
+    const unsigned y_skip = di * dk;
+    const unsigned bs = y.shape().batch();
+    for (unsigned n = 0; n < bs; ++n) {
+      const cpu::GemmEpilogue ep { CDATA(b) + n * b_skip, ga };
+      ::call_sgemm(
+          thread_pool_,
+          false, false, di, dk, dj,
+          1, CDATA(w) + n * w_skip, di, CDATA(x) + n * x_skip, dj,
+          0, DATA(y) + n * y_skip, di, &ep);
+    }
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    const cpu::GemmEpilogue ep { CDATA(b), ga };
+    ::call_sgemm(
+        thread_pool_,
+        false, false, di, dk * x.shape().batch(), dj,
+        1, CDATA(w), di, CDATA(x), dj,
+        0, DATA(y), di, &ep);
+  }
 }
 
+void CPUDevice::affine_bw_impl(
+    const Tensor &w, const Tensor &x, const Tensor &b,
+    const Tensor &y, const Tensor &gy, Activation act,
+    Tensor &gw, Tensor &gx, Tensor &gb) {
+  // g := gy * act'(y)
+  // gw += g . x^T
+  // gx += w^T . g
+  // gb += sum_j g[:, j]
+  Tensor g_act;
+  if (act != ACTIVATION_IDENTITY) {
+    g_act = new_workspace_tensor(y.shape());
+    const unsigned size = y.shape().size();
+    const float *py = CDATA(y);
+    const float *pgy = CDATA(gy);
+    float *pg = DATA(g_act);
+    switch (act) {
+      case ACTIVATION_RELU:
+        PARALLEL_REPEAT_OP(i, size, pg[i] = pgy[i] * (py[i] > 0));
+        break;
+      case ACTIVATION_TANH:
+        PARALLEL_REPEAT_OP(i, size, pg[i] = pgy[i] * (1 - py[i] * py[i]));
+        break;
+      case ACTIVATION_SIGMOID:
+        PARALLEL_REPEAT_OP(i, size, pg[i] = pgy[i] * py[i] * (1 - py[i]));
+        break;
+      default:
+        break;
+    }
+  }
+  const Tensor &g = g_act.valid() ? g_act : gy;
+
+  const unsigned di = w.shape()[0];
+  const unsigned dj = w.shape()[1];
+  const unsigned dk = x.shape()[1];
+  const unsigned w_skip = w.shape().has_batch() * di * dj;
+  const unsigned x_skip = x.shape().has_batch() * dj * dk;
+  const unsigned b_skip = b.shape().has_batch() * di;
+  const unsigned y_skip = di * dk;
+  const unsigned bs = y.shape().batch();
+  if (w.shape().has_batch() || b.shape().has_batch()) {
+    // Do gemm multiple times.
+    for (unsigned n = 0; n < bs; ++n) {
+      ::call_sgemm(
+          thread_pool_,
+          false, true, di, dj, dk,
+          1, CDATA(g) + n * y_skip, di, CDATA(x) + n * x_skip, dj,
+          1, DATA(gw) + n * w_skip, di);
+      ::call_sgemm(
+          thread_pool_,
+          true, false, dj, dk, di,
+          1, CDATA(w) + n * w_skip, di, CDATA(g) + n * y_skip, di,
+          1, DATA(gx) + n * x_skip, dj);
+    }
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    ::call_sgemm(
+        thread_pool_,
+        false, true, di, dj, dk * x.shape().batch(),
+        1, CDATA(g), di, CDATA(x), dj,
+        1, DATA(gw), di);
+    ::call_sgemm(
+        thread_pool_,
+        true, false, dj, dk * x.shape().batch(), di,
+        1, CDATA(w), di, CDATA(g), di,
+        1, DATA(gx), dj);
+  }
+
+  const float *pg = CDATA(g);
+  float *pgb = DATA(gb);
+  for (unsigned n = 0; n < bs; ++n) {
+    const float *pgn = pg + n * y_skip;
+    float *pgbn = pgb + n * b_skip;
+    PARALLEL_REPEAT_OP(i, di, [&] {
+      float sum = 0;
+      for (unsigned j = 0; j < dk; ++j) sum += pgn[i + j * di];
+      pgbn[i] += sum;
+    }());
+  }
+}
+
+void CPUDevice::lstm_cell_fw_impl(
+    const Tensor &u, const Tensor &c, Tensor &y) {
+  const unsigned n = c.shape()[0];
+  const unsigned size = c.shape().volume();
+  const unsigned u_skip = u.shape().has_batch() * 4 * size;
+  const unsigned c_skip = c.shape().has_batch() * size;
+  const float *pu = CDATA(u);
+  const float *pc = CDATA(c);
+  float *py = DATA(y);
+  ::parallel_batch(
+      thread_pool_, y.shape().batch(), size, true,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        for (unsigned k = begin; k < end; ++k) {
+          const unsigned col = k / n;
+          const float *uk = pu + batch * u_skip + 3 * n * col + k;
+          const float *ck = pc + batch * c_skip + k;
+          float *yk = py + batch * 2 * size + n * col + k;
+          const float i = .5 + .5 * std::tanh(.5 * uk[0]);
+          const float f = .5 + .5 * std::tanh(.5 * uk[n]);
+          const float o = .5 + .5 * std::tanh(.5 * uk[2 * n]);
+          const float j = std::tanh(uk[3 * n]);
+          const float cc = i * j + f * *ck;
+          yk[0] = o * std::tanh(cc);
+          yk[n] = cc;
+        }
+      });
+}
+
+void CPUDevice::lstm_cell_bw_impl(
+    const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+    Tensor &gu, Tensor &gc) {
+  const unsigned n = c.shape()[0];
+  const unsigned size = c.shape().volume();
+  const unsigned u_skip = u.shape().has_batch() * 4 * size;
+  const unsigned c_skip = c.shape().has_batch() * size;
+  const float *pu = CDATA(u);
+  const float *pc = CDATA(c);
+  const float *py = CDATA(y);
+  const float *pgy = CDATA(gy);
+  float *pgu = DATA(gu);
+  float *pgc = DATA(gc);
+  // NOTE: Gradients of broadcasted arguments should be accumulated by the
+  // same thread.
+  ::parallel_batch(
+      thread_pool_, y.shape().batch(), size,
+      u.shape().has_batch() && c.shape().has_batch(),
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        for (unsigned k = begin; k < end; ++k) {
+          const unsigned col = k / n;
+          const unsigned uk = batch * u_skip + 3 * n * col + k;
+          const unsigned ck = batch * c_skip + k;
+          const unsigned yk = batch * 2 * size + n * col + k;
+          const float i = .5 + .5 * std::tanh(.5 * pu[uk]);
+          const float f = .5 + .5 * std::tanh(.5 * pu[uk + n]);
+          const float o = .5 + .5 * std::tanh(.5 * pu[uk + 2 * n]);
+          const float j = std::tanh(pu[uk + 3 * n]);
+          const float tc = std::tanh(py[yk + n]);
+          const float gh = pgy[yk];
+          const float gcc = pgy[yk + n] + gh * o * (1 - tc * tc);
+          pgu[uk] += gcc * j * i * (1 - i);
+          pgu[uk + n] += gcc * pc[ck] * f * (1 - f);
+          pgu[uk + 2 * n] += gh * tc * o * (1 - o);
+          pgu[uk + 3 * n] += gcc * i * (1 - j * j);
+          pgc[ck] += gcc * f;
+        }
+      });
+}
+
+void CPUDevice::lstm_fw_impl(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+    Tensor &y) {
+  const unsigned n = h0.shape()[0];
+  const unsigned steps = y.shape()[1];
+  const unsigned bs = y.shape().batch();
+  const ::LSTMArgs a {
+    n, steps, xu.shape().has_batch() * 4 * n * steps,
+    h0.shape().has_batch() * n, c0.shape().has_batch() * n,
+    CDATA(xu), CDATA(wh), CDATA(h0), CDATA(c0), DATA(y),
+  };
+  float *py = DATA(y);
+  std::vector<float> u(bs * 4 * n);
+  for (unsigned t = 0; t < steps; ++t) {
+    ::lstm_preactivations(thread_pool_, a, bs, t, u.data());
+    thread_pool_.parallel_for(
+        bs * n, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          for (unsigned k = begin; k < end; ++k) {
+            const unsigned b = k / n;
+            const unsigned l = k % n;
+            const float *uk = u.data() + 4 * n * b + l;
+            float *yk = py + (b * steps + t) * 2 * n + l;
+            const float i = .5 + .5 * std::tanh(.5 * uk[0]);
+            const float f = .5 + .5 * std::tanh(.5 * uk[n]);
+            const float o = .5 + .5 * std::tanh(.5 * uk[2 * n]);
+            const float j = std::tanh(uk[3 * n]);
+            const float cc = i * j + f * ::lstm_prev_c(a, b, t)[l];
+            yk[0] = o * std::tanh(cc);
+            yk[n] = cc;
+          }
+        });
+  }
+}
+
+void CPUDevice::lstm_bw_impl(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+    const Tensor &y, const Tensor &gy,
+    Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) {
+  const unsigned n = h0.shape()[0];
+  const unsigned n4 = 4 * n;
+  const unsigned steps = y.shape()[1];
+  const unsigned bs = y.shape().batch();
+  const ::LSTMArgs a {
+    n, steps, xu.shape().has_batch() * n4 * steps,
+    h0.shape().has_batch() * n, c0.shape().has_batch() * n,
+    CDATA(xu), CDATA(wh), CDATA(h0), CDATA(c0), CDATA(y),
+  };
+  const float *pwh = CDATA(wh);
+  const float *py = CDATA(y);
+  const float *pgy = CDATA(gy);
+  float *pgxu = DATA(gxu);
+  float *pgwh = DATA(gwh);
+  float *pgh0 = DATA(gh0);
+  float *pgc0 = DATA(gc0);
+
+  // Gradients of h_t and c_t from the next step.
+  std::vector<float> gh(bs * n, 0), gc(bs * n, 0);
+  std::vector<float> u(bs * n4), gu(bs * n4);
+  for (unsigned t = steps; t-- > 0; ) {
+    // Recalculates gates of this step.
+    ::lstm_preactivations(thread_pool_, a, bs, t, u.data());
+    thread_pool_.parallel_for(
+        bs * n, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          for (unsigned k = begin; k < end; ++k) {
+            const unsigned b = k / n;
+            const unsigned l = k % n;
+            const unsigned uk = n4 * b + l;
+            const unsigned yk = (b * steps + t) * 2 * n + l;
+            const float i = .5 + .5 * std::tanh(.5 * u[uk]);
+            const float f = .5 + .5 * std::tanh(.5 * u[uk + n]);
+            const float o = .5 + .5 * std::tanh(.5 * u[uk + 2 * n]);
+            const float j = std::tanh(u[uk + 3 * n]);
+            const float tc = std::tanh(py[yk + n]);
+            const float ghk = pgy[yk] + gh[k];
+            const float gcc = pgy[yk + n] + gc[k] + ghk * o * (1 - tc * tc);
+            gu[uk] = gcc * j * i * (1 - i);
+            gu[uk + n] = gcc * ::lstm_prev_c(a, b, t)[l] * f * (1 - f);
+            gu[uk + 2 * n] = ghk * tc * o * (1 - o);
+            gu[uk + 3 * n] = gcc * i * (1 - j * j);
+            gc[k] = gcc * f;
+          }
+        });
+
+    // NOTE(odashi):
+    // Each range of rows (columns) is accumulated over all samples by the
+    // same thread, because `xu` (`wh`) may be shared by all samples.
+    thread_pool_.parallel_for(
+        n4, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+          for (unsigned b = 0; b < bs; ++b) {
+            float *g = pgxu + b * a.xu_skip + t * n4;
+            const float *s = gu.data() + b * n4;
+            for (unsigned r = begin; r < end; ++r) g[r] += s[r];
+          }
+        });
+    thread_pool_.parallel_for(
+        n, std::max(::PARALLEL_GRAIN / n4, 1u),
+        [&](unsigned begin, unsigned end) {
+          for (unsigned b = 0; b < bs; ++b) {
+            const float *h = ::lstm_prev_h(a, b, t);
+            const float *s = gu.data() + b * n4;
+            for (unsigned l = begin; l < end; ++l) {
+              const float hl = h[l];
+              float *g = pgwh + l * n4;
+              for (unsigned r = 0; r < n4; ++r) g[r] += s[r] * hl;
+            }
+          }
+        });
+
+    // gh = wh^T . gu
+    thread_pool_.parallel_for(
+        bs * n, std::max(::PARALLEL_GRAIN / n4, 1u),
+        [&](unsigned begin, unsigned end) {
+          for (unsigned k = begin; k < end; ++k) {
+            const float *w = pwh + (k % n) * n4;
+            const float *s = gu.data() + (k / n) * n4;
+            float sum = 0;
+            for (unsigned r = 0; r < n4; ++r) sum += w[r] * s[r];
+            gh[k] = sum;
+          }
+        });
+  }
+
+  thread_pool_.parallel_for(
+      n, ::PARALLEL_GRAIN, [&](unsigned begin, unsigned end) {
+        for (unsigned b = 0; b < bs; ++b) {
+          for (unsigned l = begin; l < end; ++l) {
+            pgh0[b * a.h0_skip + l] += gh[b * n + l];
+            pgc0[b * a.c0_skip + l] += gc[b * n + l];
+          }
+        }
+      });
+}
+
+// Cases of the switch statement in elementwise_fw_impl().
+#define ELEMENTWISE_CASE_X(code, op) \
+  case P::OPCODE_##code: \
+    for (unsigned i = 0; i < n; ++i) r[i] = E::op<double>::fw(a[i], k); \
+    break;
+
+// Same as ELEMENTWISE_CASE_X, but uses the SIMD approximation `fast_fn` if
+// enabled.
+#define ELEMENTWISE_CASE_X_FAST(code, fast_fn, op) \
+  case P::OPCODE_##code: \
+    if (fast_math_) fast_fn(a, r, n); \
+    else for (unsigned i = 0; i < n; ++i) r[i] = E::op<double>::fw(a[i], k); \
+    break;
+
+#define ELEMENTWISE_CASE_AB(code, op) \
+  case P::OPCODE_##code: \
+    for (unsigned i = 0; i < n; ++i) r[i] = E::op<double>::fw(a[i], b[i]); \
+    break;
+
+void CPUDevice::quantized_matmul_fw_impl(
+    const QuantizedParameter &w, const Tensor &x, Tensor &y) {
+  const unsigned di = w.shape()[0];
+  const unsigned dj = w.shape()[1];
+  const unsigned kp = cpu::qgemm_padded_depth(dj);
+  // Columns of all minibatches are multiplied as one matrix.
+  const unsigned dk = x.shape()[1] * x.shape().batch();
+  const unsigned nt = thread_pool_.num_threads();
+  const std::int8_t *pw = w.values().data();
+  const float *ps = w.scales().data();
+  const std::int32_t *pc = w.sums().data();
+  if (nt == 1 ||
+      static_cast<double>(di) * dj * dk < ::GEMM_PARALLEL_THRESHOLD) {
+    cpu::qgemm(di, dk, dj, pw, ps, pc, CDATA(x), dj, DATA(y), di);
+  } else if (dk >= nt) {
+    // Splits columns of y.
+    thread_pool_.parallel_for(
+        dk, (dk + nt - 1) / nt, [&](unsigned begin, unsigned end) {
+          cpu::qgemm(
+              di, end - begin, dj, pw, ps, pc,
+              CDATA(x) + begin * dj, dj, DATA(y) + begin * di, di);
+        });
+  } else {
+    // Splits rows of y, e.g., for the inference of one sample.
+    thread_pool_.parallel_for(
+        di, std::max(16u, (di + nt - 1) / nt),
+        [&](unsigned begin, unsigned end) {
+          cpu::qgemm(
+              end - begin, dk, dj, pw + begin * kp, ps + begin, pc + begin,
+              CDATA(x), dj, DATA(y) + begin, di);
+        });
+  }
+}
+
+void CPUDevice::batch_moments_fw_impl(
+    const Tensor &x, Tensor &mean, Tensor &var) {
+  const float *src = CDATA(x);
+  float *pm = DATA(mean);
+  float *pv = DATA(var);
+  const unsigned bs = x.shape().batch();
+  const unsigned size = mean.shape().size();
+  ::parallel_repeat(
+      thread_pool_, size, std::max(1u, ::PARALLEL_GRAIN / bs),
+      [&](unsigned i) {
+        float m = 0, m2 = 0;
+        for (unsigned batch = 0, pos = i; batch < bs; ++batch, pos += size) {
+          const float d = src[pos] - m;
+          m += d / (batch + 1);
+          m2 += d * (src[pos] - m);
+        }
+        pm[i] = m;
+        pv[i] = m2 / (bs - 1);
+      });
+}
+
+void CPUDevice::batch_normalize_fw_impl(
+    const Tensor &x, const Tensor &mean, const Tensor &var, float eps,
+    Tensor &y) {
+  const float *src = CDATA(x);
+  const float *pm = CDATA(mean);
+  const float *pv = CDATA(var);
+  float *dest = DATA(y);
+  const unsigned bs = x.shape().batch();
+  const unsigned size = mean.shape().size();
+  ::parallel_repeat(
+      thread_pool_, size, std::max(1u, ::PARALLEL_GRAIN / bs),
+      [&](unsigned i) {
+        const float m = pm[i];
+        const float r = 1.f / std::sqrt(pv[i] + eps);
+        for (unsigned batch = 0, pos = i; batch < bs; ++batch, pos += size) {
+          dest[pos] = (src[pos] - m) * r;
+        }
+      });
+}
+
+void CPUDevice::elementwise_fw_impl(
+    const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs,
+    Tensor &y) {
+  typedef ElementwiseProgram P;
+  const unsigned size = y.shape().volume();
+  const unsigned bs = y.shape().batch();
+  const unsigned num_insts = prog.instructions.size();
+  std::vector<const float *> psrcs(xs.size());
+  std::vector<unsigned> skips(xs.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    psrcs[i] = CDATA(*xs[i]);
+    skips[i] = xs[i]->shape().has_batch() * size;
+  }
+  float *pdest = DATA(y);
+
+  ::parallel_batch(
+      thread_pool_, bs, size, true,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        // Each instruction is applied to a small block of elements at once so
+        // that temporary values stay in the cache.
+        float buf[P::MAX_INSTRUCTIONS][::ELEMENTWISE_BLOCK];
+        const float *regs[P::MAX_INSTRUCTIONS];
+        for (unsigned offset = begin; offset < end;
+            offset += ::ELEMENTWISE_BLOCK) {
+          const unsigned n = std::min(::ELEMENTWISE_BLOCK, end - offset);
+          float *dest = pdest + batch * size + offset;
+          for (unsigned j = 0; j < num_insts; ++j) {
+            const P::Instruction &inst = prog.instructions[j];
+            if (inst.opcode == P::OPCODE_INPUT) {
+              regs[j] = psrcs[inst.a] + batch * skips[inst.a] + offset;
+              if (j + 1 == num_insts) {
+                std::memcpy(dest, regs[j], sizeof(float) * n);
+              }
+              continue;
+            }
+            // The last instruction writes the result directly.
+            float *r = j + 1 == num_insts ? dest : buf[j];
+            const float *a = regs[inst.a];
+            const float *b = regs[inst.b];
+            const float k = inst.k;
+            switch (inst.opcode) {
+              ELEMENTWISE_CASE_X(NEGATE, Negate);
+              ELEMENTWISE_CASE_X(SQRT, Sqrt);
+              ELEMENTWISE_CASE_X_FAST(EXP, cpu::fast_exp, Exp);
+              ELEMENTWISE_CASE_X_FAST(TANH, cpu::fast_tanh, Tanh);
+              ELEMENTWISE_CASE_X_FAST(SIGMOID, cpu::fast_sigmoid, Sigmoid);
+              ELEMENTWISE_CASE_X_FAST(SOFTPLUS, cpu::fast_softplus, Softplus);
+              ELEMENTWISE_CASE_X(SIN, Sin);
+              ELEMENTWISE_CASE_X(COS, Cos);
+              ELEMENTWISE_CASE_X(TAN, Tan);
+              ELEMENTWISE_CASE_X(ADD_CONST, AddConst);
+              ELEMENTWISE_CASE_X(SUBTRACT_CONST_R, SubtractConstR);
+              ELEMENTWISE_CASE_X(SUBTRACT_CONST_L, SubtractConstL);
+              ELEMENTWISE_CASE_X(MULTIPLY_CONST, MultiplyConst);
+              ELEMENTWISE_CASE_X(DIVIDE_CONST_R, DivideConstR);
+              ELEMENTWISE_CASE_X(DIVIDE_CONST_L, DivideConstL);
+              ELEMENTWISE_CASE_X(PRELU, PReLU);
+              ELEMENTWISE_CASE_X(ELU, ELU);
+              ELEMENTWISE_CASE_AB(ADD, Add);
+              ELEMENTWISE_CASE_AB(SUBTRACT, Subtract);
+              ELEMENTWISE_CASE_AB(MULTIPLY, Multiply);
+              ELEMENTWISE_CASE_AB(DIVIDE, Divide);
+              default: break;
+            }
+            regs[j] = r;
+          }
+        }
+      });
+}
+
+#undef ELEMENTWISE_CASE_X
+#undef ELEMENTWISE_CASE_X_FAST
+#undef ELEMENTWISE_CASE_AB
+
 void CPUDevice::sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
   const unsigned n = x.shape()[dim];
   const unsigned repeat = y.shape().size();
@@ -495,37 +1475,66 @@ void CPUDevice::sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
   const unsigned skip2 = skip1 * n;
   float *dest = DATA(y);
   const float *src = CDATA(x);
-  for (unsigned i = 0; i < repeat; ++i) {
-    unsigned offset = i % skip1 + (i / skip1) * skip2;
-    float tmp = 0;
-    for (unsigned j = 0; j < n; ++j) {
-      tmp += src[offset];
-      offset += skip1;
-    }
-    dest[i] = tmp;
-  }
+  ::parallel_repeat(
+      thread_pool_, repeat, std::max(1u, ::PARALLEL_GRAIN / n),
+      [&](unsigned i) {
+        unsigned offset = i % skip1 + (i / skip1) * skip2;
+        float tmp = 0;
+        for (unsigned j = 0; j < n; ++j) {
+          tmp += src[offset];
+          offset += skip1;
+        }
+        dest[i] = tmp;
+      });
 }
 
 void CPUDevice::logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+  float *dest = DATA(y);
+  ::parallel_softmax(
+      thread_pool_, x.shape(), dim, CDATA(x),
+      [&](unsigned, unsigned row, unsigned lanes,
+          const float *max, const float *sum) {
+        for (unsigned l = 0; l < lanes; ++l) {
+          dest[row + l] = max[l] + std::log(sum[l]);
+        }
+      });
+}
+
+void CPUDevice::softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
   const unsigned n = x.shape()[dim];
-  const unsigned repeat = y.shape().size();
-  const unsigned skip1 = y.shape().lower_volume(dim);
-  const unsigned skip2 = skip1 * n;
+  const unsigned stride = x.shape().lower_volume(dim);
+  const float *src = CDATA(x);
   float *dest = DATA(y);
+  ::parallel_softmax(
+      thread_pool_, x.shape(), dim, src,
+      [&](unsigned offset, unsigned, unsigned lanes,
+          const float *max, const float *sum) {
+        float inv[::SOFTMAX_LANES];
+        for (unsigned l = 0; l < lanes; ++l) inv[l] = 1 / sum[l];
+        ::map_rows(
+            n, stride, lanes, src + offset, dest + offset,
+            [&](float v, unsigned l) { return std::exp(v - max[l]) * inv[l]; });
+      });
+}
+
+void CPUDevice::log_softmax_fw_impl(
+    const Tensor &x, unsigned dim, Tensor &y) {
+  const unsigned n = x.shape()[dim];
+  const unsigned stride = x.shape().lower_volume(dim);
   const float *src = CDATA(x);
-  for (unsigned i = 0; i < repeat; ++i) {
-    // TODO(odashi): This calculation might generate large errors.
-    unsigned offset = i % skip1 + (i / skip1) * skip2;
-    float tmp = src[offset];
-    for (unsigned j = 1; j < n; ++j) {
-      offset += skip1;
-      float arg = src[offset];
-      tmp = tmp > arg
-        ? tmp + std::log(1. + std::exp(arg - tmp))
-        : arg + std::log(1. + std::exp(tmp - arg));
-    }
-    dest[i] = tmp;
-  }
+  float *dest = DATA(y);
+  ::parallel_softmax(
+      thread_pool_, x.shape(), dim, src,
+      [&](unsigned offset, unsigned, unsigned lanes,
+          const float *max, const float *sum) {
+        float lse[::SOFTMAX_LANES];
+        for (unsigned l = 0; l < lanes; ++l) {
+          lse[l] = max[l] + std::log(sum[l]);
+        }
+        ::map_rows(
+            n, stride, lanes, src + offset, dest + offset,
+            [&](float v, unsigned l) { return v - lse[l]; });
+      });
 }
 
 void CPUDevice::broadcast_fw_impl(
@@ -535,14 +1544,16 @@ void CPUDevice::broadcast_fw_impl(
   const unsigned skip2 = skip1 * size;
   float *dest = DATA(y);
   const float *src = CDATA(x);
-  for (unsigned i = 0; i < repeat; ++i) {
-    unsigned offset = i % skip1 + (i / skip1) * skip2;
-    float tmp = src[i];
-    for (unsigned j = 0; j < size; ++j) {
-      dest[offset] = tmp;
-      offset += skip1;
-    }
-  }
+  ::parallel_repeat(
+      thread_pool_, repeat, std::max(1u, ::PARALLEL_GRAIN / size),
+      [&](unsigned i) {
+        unsigned offset = i % skip1 + (i / skip1) * skip2;
+        const float tmp = src[i];
+        for (unsigned j = 0; j < size; ++j) {
+          dest[offset] = tmp;
+          offset += skip1;
+        }
+      });
 }
 
 void CPUDevice::batch_sum_fw_impl(const Tensor &x, Tensor &y) {
@@ -550,19 +1561,21 @@ void CPUDevice::batch_sum_fw_impl(const Tensor &x, Tensor &y) {
   const float *src = CDATA(x);
   const unsigned bs = x.shape().batch();
   const unsigned size = y.shape().size();
-  for (unsigned i = 0; i < size; ++i) {
-    float temp = 0;
-    for (unsigned batch = 0, pos = i; batch < bs; ++batch, pos += size) {
-      temp += src[pos];
-    }
-    dest[i] = temp;
-  }
+  ::parallel_repeat(
+      thread_pool_, size, std::max(1u, ::PARALLEL_GRAIN / bs),
+      [&](unsigned i) {
+        float temp = 0;
+        for (unsigned batch = 0, pos = i; batch < bs; ++batch, pos += size) {
+          temp += src[pos];
+        }
+        dest[i] = temp;
+      });
 }
 
 void CPUDevice::inplace_multiply_const_impl(float k, Tensor &x) {
   const unsigned size = x.shape().size();
   float *dest = DATA(x);
-  REPEAT_OP(i, size, dest[i] *= k);
+  PARALLEL_REPEAT_OP(i, size, dest[i] *= k);
 }
 
 void CPUDevice::inplace_add_impl(const Tensor &x, Tensor &y) {
@@ -572,13 +1585,15 @@ void CPUDevice::inplace_add_impl(const Tensor &x, Tensor &y) {
   const unsigned bs = std::max(sx.batch(), sy.batch());
   const unsigned b_skip_d = sy.has_batch() * size;
   const unsigned b_skip_s = sx.has_batch() * size;
-  float *dest = DATA(y);
-  const float *src = CDATA(x);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    REPEAT_OP(i, size, dest[i] += src[i]);
-    dest += b_skip_d;
-    src += b_skip_s;
-  }
+  float *pdest = DATA(y);
+  const float *psrc = CDATA(x);
+  ::parallel_batch(
+      thread_pool_, bs, size, b_skip_d,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        float *dest = pdest + batch * b_skip_d;
+        const float *src = psrc + batch * b_skip_s;
+        for (unsigned i = begin; i < end; ++i) dest[i] += src[i];
+      });
 }
 
 void CPUDevice::inplace_subtract_impl(const Tensor &x, Tensor &y) {
@@ -588,13 +1603,191 @@ void CPUDevice::inplace_subtract_impl(const Tensor &x, Tensor &y) {
   const unsigned bs = std::max(sx.batch(), sy.batch());
   const unsigned b_skip_d = sy.has_batch() * size;
   const unsigned b_skip_s = sx.has_batch() * size;
-  float *dest = DATA(y);
-  const float *src = CDATA(x);
-  for (unsigned batch = 0; batch < bs; ++batch) {
-    REPEAT_OP(i, size, dest[i] -= src[i]);
-    dest += b_skip_d;
-    src += b_skip_s;
-  }
+  float *pdest = DATA(y);
+  const float *psrc = CDATA(x);
+  ::parallel_batch(
+      thread_pool_, bs, size, b_skip_d,
+      [&](unsigned batch, unsigned begin, unsigned end) {
+        float *dest = pdest + batch * b_skip_d;
+        const float *src = psrc + batch * b_skip_s;
+        for (unsigned i = begin; i < end; ++i) dest[i] -= src[i];
+      });
+}
+
+void CPUDevice::sgd_update_impl(float eta, const Tensor &g, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const float *pg = CDATA(g);
+  float *px = DATA(x);
+  PARALLEL_REPEAT_OP(i, size, px[i] -= eta * pg[i]);
+}
+
+void CPUDevice::momentum_sgd_update_impl(
+    float eta, float momentum, const Tensor &g, Tensor &m, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const float *pg = CDATA(g);
+  float *pm = DATA(m);
+  float *px = DATA(x);
+  PARALLEL_REPEAT_OP(i, size, [&] {
+    const float mi = momentum * pm[i] - eta * pg[i];
+    pm[i] = mi;
+    px[i] += mi;
+  }());
+}
+
+void CPUDevice::adam_update_impl(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const float k1 = 1 - beta1;
+  const float k2 = 1 - beta2;
+  const float c1 = 1 - std::pow(beta1, epoch);
+  const float c2 = 1 - std::pow(beta2, epoch);
+  const float *pg = CDATA(g);
+  float *pm1 = DATA(m1);
+  float *pm2 = DATA(m2);
+  float *px = DATA(x);
+  PARALLEL_REPEAT_OP(i, size, [&] {
+    const float gi = pg[i];
+    const float m1i = beta1 * pm1[i] + k1 * gi;
+    const float m2i = beta2 * pm2[i] + k2 * gi * gi;
+    pm1[i] = m1i;
+    pm2[i] = m2i;
+    px[i] -= alpha * (m1i / c1) / (std::sqrt(m2i / c2) + eps);
+  }());
+}
+
+void CPUDevice::sgd_update_multi_impl(
+    float eta,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &xs) {
+  const std::vector<float *> pxs = ::mutable_data(xs);
+  ::parallel_tensors(
+      thread_pool_, ::tensor_offsets(xs),
+      [&](unsigned t, unsigned begin, unsigned end) {
+        const float *pg = CDATA(*gs[t]);
+        float *px = pxs[t];
+        for (unsigned i = begin; i < end; ++i) px[i] -= eta * pg[i];
+      });
+}
+
+void CPUDevice::momentum_sgd_update_multi_impl(
+    float eta, float momentum,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+    const std::vector<Tensor *> &xs) {
+  const std::vector<float *> pms = ::mutable_data(ms);
+  const std::vector<float *> pxs = ::mutable_data(xs);
+  ::parallel_tensors(
+      thread_pool_, ::tensor_offsets(xs),
+      [&](unsigned t, unsigned begin, unsigned end) {
+        const float *pg = CDATA(*gs[t]);
+        float *pm = pms[t];
+        float *px = pxs[t];
+        for (unsigned i = begin; i < end; ++i) {
+          const float mi = momentum * pm[i] - eta * pg[i];
+          pm[i] = mi;
+          px[i] += mi;
+        }
+      });
+}
+
+void CPUDevice::adam_update_multi_impl(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+    const std::vector<Tensor *> &m2s, const std::vector<Tensor *> &xs) {
+  const float k1 = 1 - beta1;
+  const float k2 = 1 - beta2;
+  const float c1 = 1 - std::pow(beta1, epoch);
+  const float c2 = 1 - std::pow(beta2, epoch);
+  const std::vector<float *> pm1s = ::mutable_data(m1s);
+  const std::vector<float *> pm2s = ::mutable_data(m2s);
+  const std::vector<float *> pxs = ::mutable_data(xs);
+  ::parallel_tensors(
+      thread_pool_, ::tensor_offsets(xs),
+      [&](unsigned t, unsigned begin, unsigned end) {
+        const float *pg = CDATA(*gs[t]);
+        float *pm1 = pm1s[t];
+        float *pm2 = pm2s[t];
+        float *px = pxs[t];
+        for (unsigned i = begin; i < end; ++i) {
+          const float gi = pg[i];
+          const float m1i = beta1 * pm1[i] + k1 * gi;
+          const float m2i = beta2 * pm2[i] + k2 * gi * gi;
+          pm1[i] = m1i;
+          pm2[i] = m2i;
+          px[i] -= alpha * (m1i / c1) / (std::sqrt(m2i / c2) + eps);
+        }
+      });
+}
+
+void CPUDevice::squared_norm_multi_impl(
+    const std::vector<const Tensor *> &xs, Tensor &y) {
+  // NOTE(odashi):
+  // Partial sums are calculated for fixed ranges and added in order, so that
+  // the result does not depend on the number of threads.
+  const std::vector<unsigned> offsets = ::tensor_offsets(xs);
+  const unsigned n = xs.size();
+  const unsigned total = offsets.back();
+  const unsigned num_ranges = (total + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN;
+  std::vector<double> partials(num_ranges, 0);
+  thread_pool_.parallel_for(
+      num_ranges, 1, [&](unsigned rbegin, unsigned rend) {
+        for (unsigned r = rbegin; r < rend; ++r) {
+          const unsigned begin = r * PARALLEL_GRAIN;
+          const unsigned end = std::min(begin + PARALLEL_GRAIN, total);
+          unsigned t = std::upper_bound(
+              offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+          double sum = 0;
+          for (; t < n && offsets[t] < end; ++t) {
+            const float *px = CDATA(*xs[t]);
+            const unsigned offset = offsets[t];
+            const unsigned e = std::min(end, offsets[t + 1]) - offset;
+            for (unsigned i = std::max(begin, offset) - offset; i < e; ++i) {
+              sum += px[i] * px[i];
+            }
+          }
+          partials[r] = sum;
+        }
+      });
+  double sum = 0;
+  for (const double p : partials) sum += p;
+  DATA(y)[0] = sum;
+}
+
+void CPUDevice::clip_by_norm_multi_impl(
+    float max_norm, const Tensor &sq_norm, const std::vector<Tensor *> &xs) {
+  const float norm = std::sqrt(CDATA(sq_norm)[0]);
+  if (!(norm > max_norm)) return;
+  const float k = max_norm / norm;
+  const std::vector<float *> pxs = ::mutable_data(xs);
+  ::parallel_tensors(
+      thread_pool_, ::tensor_offsets(xs),
+      [&](unsigned t, unsigned begin, unsigned end) {
+        float *px = pxs[t];
+        for (unsigned i = begin; i < end; ++i) px[i] *= k;
+      });
+}
+
+void CPUDevice::top_k_impl(
+    const Tensor &x, unsigned k, unsigned ids[], float values[]) {
+  const unsigned bs = x.shape().batch();
+  const unsigned n = x.shape().volume();
+  const float *px = CDATA(x);
+  thread_pool_.parallel_for(
+      bs, std::max(1u, PARALLEL_GRAIN / n), [&](unsigned begin, unsigned end) {
+        std::vector<unsigned> order(n);
+        for (unsigned batch = begin; batch < end; ++batch) {
+          const float *pb = px + batch * n;
+          for (unsigned i = 0; i < n; ++i) order[i] = i;
+          std::partial_sort(
+              order.begin(), order.begin() + k, order.end(),
+              [pb](unsigned a, unsigned b) {
+                return pb[a] > pb[b] || (pb[a] == pb[b] && a < b);
+              });
+          for (unsigned i = 0; i < k; ++i) {
+            ids[batch * k + i] = order[i];
+            values[batch * k + i] = pb[order[i]];
+          }
+        }
+      });
 }
 
 }  // namespace primitiv
@@ -1,8 +1,12 @@
 #ifndef PRIMITIV_CPU_DEVICE_H_
 #define PRIMITIV_CPU_DEVICE_H_
 
+#include <cstdint>
 #include <random>
+#include <primitiv/cpu_memory_pool.h>
 #include <primitiv/device.h>
+#include <primitiv/numa.h>
+#include <primitiv/thread_pool.h>
 
 namespace primitiv {
 
@@ -21,22 +25,109 @@ public:
    * @remarks The internal random number generator is initialized by
    *          `std::random_device`.
    */
-  CPUDevice() : rng_(std::random_device()()) {}
+  CPUDevice() : CPUDevice(std::random_device()()) {}
 
   /**
    * Creates a CPUDevice object.
    * @param rng_seed The seed value of internal random number generator.
    */
-  explicit CPUDevice(unsigned rng_seed) : rng_(rng_seed) {}
+  explicit CPUDevice(unsigned rng_seed) : CPUDevice(rng_seed, 1) {}
 
-  ~CPUDevice() override = default;
+  /**
+   * Creates a CPUDevice object.
+   * @param rng_seed The seed value of internal random number generator.
+   * @param num_threads Number of threads used by each operation.
+   * @remarks Operations over small tensors are always performed on the
+   *          calling thread. Random number generators are parallelized only
+   *          if the counter-based generator is enabled.
+   */
+  CPUDevice(unsigned rng_seed, unsigned num_threads)
+    : rng_seed_(rng_seed), rng_(rng_seed), thread_pool_(num_threads)
+    , fast_math_(false), counter_based_rng_(false), rng_counter_(0)
+    , pool_() {}
+
+  /**
+   * Creates a CPUDevice object bound to a NUMA node.
+   * @param rng_seed The seed value of internal random number generator.
+   * @param num_threads Number of threads used by each operation.
+   * @param numa_node ID of the NUMA node. Worker threads run on processors of
+   *                  the node, and memories are allocated on the node.
+   * @remarks The calling thread also processes a part of each operation, and
+   *          it should be bound to the same node to avoid traffic between
+   *          nodes, e.g., by
+   *          `numa::bind_current_thread(numa::node_cpus(numa_node))` of
+   *          `primitiv/numa.h`.
+   */
+  CPUDevice(unsigned rng_seed, unsigned num_threads, unsigned numa_node)
+    : rng_seed_(rng_seed), rng_(rng_seed)
+    , thread_pool_(num_threads, numa::node_cpus(numa_node))
+    , fast_math_(false), counter_based_rng_(false), rng_counter_(0)
+    , pool_(numa_node) {}
+
+  ~CPUDevice() override {
+    // The workspace should be returned before the memory pool is destroyed.
+    release_workspace();
+  }
 
   Device::DeviceType type() const override { return Device::DEVICE_TYPE_CPU; }
 
+  MemoryPoolStats memory_pool_stats() const override { return pool_.stats(); }
+  void release_reserved_memory() override { pool_.release_reserved_blocks(); }
+  void synchronize() override {}
+
+  /**
+   * Retrieves the number of threads used by each operation.
+   * @return Number of threads.
+   */
+  unsigned num_threads() const { return thread_pool_.num_threads(); }
+
+  /**
+   * Retrieves the NUMA node of this device.
+   * @return ID of the node, or -1 if the device is not bound to any node.
+   */
+  int numa_node() const { return pool_.numa_node(); }
+
+  /**
+   * Switches the implementation of transcendental functions.
+   * @param enabled If true, `exp`, `tanh`, `sigmoid` and `softplus` use SIMD
+   *                approximations in `cpu_math.h`. Otherwise they use the
+   *                standard library (default).
+   * @remarks Results of the approximations may differ from the standard
+   *          library by a few ULP. See `cpu_math.h` for the error bounds.
+   */
+  void set_fast_math(bool enabled) { fast_math_ = enabled; }
+
+  /**
+   * Retrieves whether the SIMD approximations are used.
+   * @return true if the approximations are used, false otherwise.
+   */
+  bool fast_math() const { return fast_math_; }
+
+  /**
+   * Switches the generator of `random_*` operations.
+   * @param enabled If true, random numbers are generated by the counter-based
+   *                Philox4x32-10 generator in `cpu_philox.h` using multiple
+   *                threads. Otherwise they are generated by `std::mt19937`
+   *                serially (default).
+   * @remarks The counter-based generator uses the seed as the key, and each
+   *          operation consumes consecutive counters. Results depend only on
+   *          the seed and the order of operations, not on the number of
+   *          threads.
+   */
+  void set_counter_based_rng(bool enabled) { counter_based_rng_ = enabled; }
+
+  /**
+   * Retrieves whether the counter-based generator is used.
+   * @return true if the counter-based generator is used, false otherwise.
+   */
+  bool counter_based_rng() const { return counter_based_rng_; }
+
+
 private:
   std::shared_ptr<void> new_handle(const Shape &shape) override;
 
   std::vector<float> tensor_to_vector_impl(const Tensor &x) override;
+  void tensor_to_array_impl(const Tensor &x, float values[]) override;
 
   void reset_tensor_impl(float k, Tensor &x) override;
   void reset_tensor_by_array_impl(const float values[], Tensor &x) override;
@@ -49,10 +140,13 @@ private:
   void random_log_normal_impl(float mean, float sd, Tensor &y) override;
 
   void pick_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) override;
+  void gather_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) override;
   void slice_fw_impl(const Tensor &x, unsigned dim, unsigned offset, Tensor &y) override;
   void concat_fw_impl(const std::vector<const Tensor *> &xs, unsigned dim, Tensor &y) override;
 
   void pick_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) override;
+  void pick_assign_impl(const Tensor &y, unsigned dim, const std::vector<unsigned> &ids, Tensor &x) override;
+  void gather_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) override;
   void slice_bw_impl(const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx) override;
 
   void negate_fw_impl(const Tensor &x, Tensor &y) override;
@@ -123,8 +217,43 @@ private:
       const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy,
       Tensor &ga, Tensor &gb) override;
 
+  void affine_fw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b, Activation act,
+      Tensor &y) override;
+  void affine_bw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b,
+      const Tensor &y, const Tensor &gy, Activation act,
+      Tensor &gw, Tensor &gx, Tensor &gb) override;
+
+  void lstm_cell_fw_impl(
+      const Tensor &u, const Tensor &c, Tensor &y) override;
+  void lstm_cell_bw_impl(
+      const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+      Tensor &gu, Tensor &gc) override;
+  void lstm_fw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      Tensor &y) override;
+  void lstm_bw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      const Tensor &y, const Tensor &gy,
+      Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) override;
+
+  void quantized_matmul_fw_impl(
+      const QuantizedParameter &w, const Tensor &x, Tensor &y) override;
+  void batch_moments_fw_impl(
+      const Tensor &x, Tensor &mean, Tensor &var) override;
+  void batch_normalize_fw_impl(
+      const Tensor &x, const Tensor &mean, const Tensor &var, float eps,
+      Tensor &y) override;
+
+  void elementwise_fw_impl(
+      const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs,
+      Tensor &y) override;
+
   void sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
   void logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
+  void softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
+  void log_softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
   void broadcast_fw_impl(const Tensor &x, unsigned dim, unsigned size, Tensor &y) override;
   void batch_sum_fw_impl(const Tensor &x, Tensor &y) override;
 
@@ -133,8 +262,45 @@ private:
   void inplace_add_impl(const Tensor &x, Tensor &y) override;
   void inplace_subtract_impl(const Tensor &x, Tensor &y) override;
 
+  void sgd_update_impl(float eta, const Tensor &g, Tensor &x) override;
+  void momentum_sgd_update_impl(
+      float eta, float momentum, const Tensor &g, Tensor &m,
+      Tensor &x) override;
+  void adam_update_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) override;
+  void sgd_update_multi_impl(
+      float eta,
+      const std::vector<const Tensor *> &gs,
+      const std::vector<Tensor *> &xs) override;
+  void momentum_sgd_update_multi_impl(
+      float eta, float momentum,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+      const std::vector<Tensor *> &xs) override;
+  void adam_update_multi_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+      const std::vector<Tensor *> &m2s,
+      const std::vector<Tensor *> &xs) override;
+  void squared_norm_multi_impl(
+      const std::vector<const Tensor *> &xs, Tensor &y) override;
+  void clip_by_norm_multi_impl(
+      float max_norm, const Tensor &sq_norm,
+      const std::vector<Tensor *> &xs) override;
+
+  void top_k_impl(
+      const Tensor &x, unsigned k, unsigned ids[], float values[]) override;
+
 private:
+  std::uint64_t reserve_rng_counters(unsigned size);
+
+  unsigned rng_seed_;
   std::mt19937 rng_;
+  ThreadPool thread_pool_;
+  bool fast_math_;
+  bool counter_based_rng_;
+  std::uint64_t rng_counter_;
+  CPUMemoryPool pool_;
 };
 
 }  // namespace primitiv
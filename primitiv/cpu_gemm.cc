@@ -0,0 +1,366 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <primitiv/cpu_gemm.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRIMITIV_CPU_GEMM_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Microkernel: C[0:MR, 0:NR] += A_panel . B_panel
+// A_panel: MR-by-kc packed matrix (MR elements for each k).
+// B_panel: kc-by-NR packed matrix (NR elements for each k).
+typedef void (*MicroKernel)(
+    unsigned kc, const float *a, const float *b, float *c, unsigned ldc);
+
+struct KernelInfo {
+  const char *name;
+  unsigned mr;  // Rows of the microkernel.
+  unsigned nr;  // Columns of the microkernel.
+  unsigned mc;  // Rows of the packed A block (fits in L2).
+  unsigned kc;  // Depth of the packed blocks (A panel fits in L1).
+  unsigned nc;  // Columns of the packed B block (fits in L3).
+  MicroKernel fn;
+};
+
+// Upper bound of mr * nr over all microkernels.
+const unsigned MAX_TILE_SIZE = 32 * 12;
+
+void kernel_generic(
+    unsigned kc, const float *a, const float *b, float *c, unsigned ldc) {
+  float acc[8 * 4] = {};
+  for (unsigned l = 0; l < kc; ++l) {
+    for (unsigned j = 0; j < 4; ++j) {
+      const float bj = b[j];
+      for (unsigned i = 0; i < 8; ++i) {
+        acc[i + 8 * j] += a[i] * bj;
+      }
+    }
+    a += 8;
+    b += 4;
+  }
+  for (unsigned j = 0; j < 4; ++j) {
+    for (unsigned i = 0; i < 8; ++i) {
+      c[i + j * ldc] += acc[i + 8 * j];
+    }
+  }
+}
+
+#ifdef PRIMITIV_CPU_GEMM_X86
+
+__attribute__((target("avx2,fma")))
+void kernel_avx2(
+    unsigned kc, const float *a, const float *b, float *c, unsigned ldc) {
+  // 16x6 tile: 12 accumulators + 2 columns of A + 1 broadcasted B.
+  __m256 c0[6], c1[6];
+  for (unsigned j = 0; j < 6; ++j) {
+    c0[j] = _mm256_setzero_ps();
+    c1[j] = _mm256_setzero_ps();
+  }
+  for (unsigned l = 0; l < kc; ++l) {
+    const __m256 a0 = _mm256_loadu_ps(a);
+    const __m256 a1 = _mm256_loadu_ps(a + 8);
+    for (unsigned j = 0; j < 6; ++j) {
+      const __m256 bj = _mm256_broadcast_ss(b + j);
+      c0[j] = _mm256_fmadd_ps(a0, bj, c0[j]);
+      c1[j] = _mm256_fmadd_ps(a1, bj, c1[j]);
+    }
+    a += 16;
+    b += 6;
+  }
+  for (unsigned j = 0; j < 6; ++j) {
+    float *cj = c + j * ldc;
+    _mm256_storeu_ps(cj, _mm256_add_ps(_mm256_loadu_ps(cj), c0[j]));
+    _mm256_storeu_ps(cj + 8, _mm256_add_ps(_mm256_loadu_ps(cj + 8), c1[j]));
+  }
+}
+
+__attribute__((target("avx512f")))
+void kernel_avx512(
+    unsigned kc, const float *a, const float *b, float *c, unsigned ldc) {
+  // 32x12 tile: 24 accumulators + 2 columns of A + 1 broadcasted B.
+  __m512 c0[12], c1[12];
+  for (unsigned j = 0; j < 12; ++j) {
+    c0[j] = _mm512_setzero_ps();
+    c1[j] = _mm512_setzero_ps();
+  }
+  for (unsigned l = 0; l < kc; ++l) {
+    const __m512 a0 = _mm512_loadu_ps(a);
+    const __m512 a1 = _mm512_loadu_ps(a + 16);
+    for (unsigned j = 0; j < 12; ++j) {
+      const __m512 bj = _mm512_set1_ps(b[j]);
+      c0[j] = _mm512_fmadd_ps(a0, bj, c0[j]);
+      c1[j] = _mm512_fmadd_ps(a1, bj, c1[j]);
+    }
+    a += 32;
+    b += 12;
+  }
+  for (unsigned j = 0; j < 12; ++j) {
+    float *cj = c + j * ldc;
+    _mm512_storeu_ps(cj, _mm512_add_ps(_mm512_loadu_ps(cj), c0[j]));
+    _mm512_storeu_ps(cj + 16, _mm512_add_ps(_mm512_loadu_ps(cj + 16), c1[j]));
+  }
+}
+
+#endif  // PRIMITIV_CPU_GEMM_X86
+
+const KernelInfo KERNEL_GENERIC {
+  "generic", 8, 4, 128, 256, 2048, ::kernel_generic,
+};
+
+#ifdef PRIMITIV_CPU_GEMM_X86
+const KernelInfo KERNEL_AVX2 {
+  "avx2", 16, 6, 128, 256, 2046, ::kernel_avx2,
+};
+const KernelInfo KERNEL_AVX512 {
+  "avx512", 32, 12, 256, 256, 2040, ::kernel_avx512,
+};
+#endif  // PRIMITIV_CPU_GEMM_X86
+
+bool kernel_supported(primitiv::cpu::GemmKernelType type) {
+  using namespace primitiv::cpu;
+  switch (type) {
+    case GEMM_KERNEL_AUTO:
+    case GEMM_KERNEL_GENERIC:
+      return true;
+#ifdef PRIMITIV_CPU_GEMM_X86
+    case GEMM_KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case GEMM_KERNEL_AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif  // PRIMITIV_CPU_GEMM_X86
+    default:
+      return false;
+  }
+}
+
+const KernelInfo &select_kernel(primitiv::cpu::GemmKernelType type) {
+  using namespace primitiv::cpu;
+#ifdef PRIMITIV_CPU_GEMM_X86
+  static const KernelInfo &best =
+    ::kernel_supported(GEMM_KERNEL_AVX512) ? KERNEL_AVX512 :
+    ::kernel_supported(GEMM_KERNEL_AVX2) ? KERNEL_AVX2 :
+    KERNEL_GENERIC;
+  if (!::kernel_supported(type)) return KERNEL_GENERIC;
+  switch (type) {
+    case GEMM_KERNEL_AUTO: return best;
+    case GEMM_KERNEL_AVX2: return KERNEL_AVX2;
+    case GEMM_KERNEL_AVX512: return KERNEL_AVX512;
+    default: return KERNEL_GENERIC;
+  }
+#else
+  static_cast<void>(type);
+  return KERNEL_GENERIC;
+#endif  // PRIMITIV_CPU_GEMM_X86
+}
+
+// Packs alpha * op(A)[0:mc, 0:kc] into row panels of height mr.
+// Rows beyond mc are padded by 0.
+void pack_a(
+    bool trans, unsigned mc, unsigned kc, float alpha,
+    const float *a, unsigned lda, unsigned mr, float *dest) {
+  for (unsigned p = 0; p < mc; p += mr) {
+    const unsigned rows = std::min(mr, mc - p);
+    for (unsigned l = 0; l < kc; ++l) {
+      if (trans) {
+        const float *src = a + l + p * lda;
+        for (unsigned i = 0; i < rows; ++i) dest[i] = alpha * src[i * lda];
+      } else {
+        const float *src = a + p + l * lda;
+        for (unsigned i = 0; i < rows; ++i) dest[i] = alpha * src[i];
+      }
+      for (unsigned i = rows; i < mr; ++i) dest[i] = 0;
+      dest += mr;
+    }
+  }
+}
+
+// Packs op(B)[0:kc, 0:nc] into column panels of width nr.
+// Columns beyond nc are padded by 0.
+void pack_b(
+    bool trans, unsigned kc, unsigned nc,
+    const float *b, unsigned ldb, unsigned nr, float *dest) {
+  for (unsigned q = 0; q < nc; q += nr) {
+    const unsigned cols = std::min(nr, nc - q);
+    for (unsigned l = 0; l < kc; ++l) {
+      if (trans) {
+        const float *src = b + q + l * ldb;
+        for (unsigned j = 0; j < cols; ++j) dest[j] = src[j];
+      } else {
+        const float *src = b + l + q * ldb;
+        for (unsigned j = 0; j < cols; ++j) dest[j] = src[j * ldb];
+      }
+      for (unsigned j = cols; j < nr; ++j) dest[j] = 0;
+      dest += nr;
+    }
+  }
+}
+
+// C[i, j] := op(C[i, j] + bias[i]) for the rows x cols submatrix.
+template<typename Op>
+void apply_epilogue_op(
+    const float *bias, unsigned rows, unsigned cols, float *c, unsigned ldc,
+    Op op) {
+  for (unsigned j = 0; j < cols; ++j) {
+    float *cj = c + j * ldc;
+    if (bias) for (unsigned i = 0; i < rows; ++i) cj[i] = op(cj[i] + bias[i]);
+    else for (unsigned i = 0; i < rows; ++i) cj[i] = op(cj[i]);
+  }
+}
+
+// Applies the epilogue to the submatrix of C starting at the row `row`.
+void apply_epilogue(
+    const primitiv::cpu::GemmEpilogue &ep,
+    unsigned row, unsigned rows, unsigned cols, float *c, unsigned ldc) {
+  using namespace primitiv::cpu;
+  const float *bias = ep.bias ? ep.bias + row : nullptr;
+  switch (ep.activation) {
+    case GEMM_ACTIVATION_IDENTITY:
+      if (bias) {
+        ::apply_epilogue_op(
+            bias, rows, cols, c, ldc, [](float x) { return x; });
+      }
+      break;
+    case GEMM_ACTIVATION_RELU:
+      ::apply_epilogue_op(
+          bias, rows, cols, c, ldc, [](float x) { return x * (x > 0); });
+      break;
+    case GEMM_ACTIVATION_TANH:
+      ::apply_epilogue_op(
+          bias, rows, cols, c, ldc, [](float x) { return std::tanh(x); });
+      break;
+    case GEMM_ACTIVATION_SIGMOID:
+      ::apply_epilogue_op(
+          bias, rows, cols, c, ldc,
+          [](float x) { return .5f + .5f * std::tanh(.5f * x); });
+      break;
+  }
+}
+
+// C += alpha * op(A) . op(B) using the blocked algorithm.
+// If `ep` is not nullptr, it is applied to each tile after the last update.
+void gemm_blocked(
+    const KernelInfo &ki, bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float *c, unsigned ldc, const primitiv::cpu::GemmEpilogue *ep) {
+  // NOTE: Buffers are kept for each thread to avoid allocations on every call.
+  thread_local std::vector<float> buf_a, buf_b;
+  const unsigned mr = ki.mr, nr = ki.nr;
+
+  for (unsigned jc = 0; jc < n; jc += ki.nc) {
+    const unsigned nc = std::min(ki.nc, n - jc);
+    const unsigned nc_pad = (nc + nr - 1) / nr * nr;
+
+    for (unsigned pc = 0; pc < k; pc += ki.kc) {
+      const unsigned kc = std::min(ki.kc, k - pc);
+      const bool last = pc + kc == k;
+      buf_b.resize(std::max<std::size_t>(buf_b.size(), nc_pad * kc));
+      const float *b_org = trans_b ? b + jc + pc * ldb : b + pc + jc * ldb;
+      ::pack_b(trans_b, kc, nc, b_org, ldb, nr, buf_b.data());
+
+      for (unsigned ic = 0; ic < m; ic += ki.mc) {
+        const unsigned mc = std::min(ki.mc, m - ic);
+        const unsigned mc_pad = (mc + mr - 1) / mr * mr;
+        buf_a.resize(std::max<std::size_t>(buf_a.size(), mc_pad * kc));
+        const float *a_org = trans_a ? a + pc + ic * lda : a + ic + pc * lda;
+        ::pack_a(trans_a, mc, kc, alpha, a_org, lda, mr, buf_a.data());
+
+        for (unsigned jr = 0; jr < nc; jr += nr) {
+          const unsigned cols = std::min(nr, nc - jr);
+          const float *bp = buf_b.data() + jr * kc;
+          for (unsigned ir = 0; ir < mc; ir += mr) {
+            const unsigned rows = std::min(mr, mc - ir);
+            const float *ap = buf_a.data() + ir * kc;
+            float *cp = c + (ic + ir) + (jc + jr) * ldc;
+            if (rows == mr && cols == nr) {
+              ki.fn(kc, ap, bp, cp, ldc);
+            } else {
+              // Edge tile: calculates into the temporary and writes back only
+              // the valid region.
+              float tmp[MAX_TILE_SIZE] = {};
+              ki.fn(kc, ap, bp, tmp, mr);
+              for (unsigned j = 0; j < cols; ++j) {
+                for (unsigned i = 0; i < rows; ++i) {
+                  cp[i + j * ldc] += tmp[i + j * mr];
+                }
+              }
+            }
+            if (ep && last) ::apply_epilogue(*ep, ic + ir, rows, cols, cp, ldc);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Implementation of gemm() with the optional epilogue.
+void gemm_impl(
+    bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc,
+    const primitiv::cpu::GemmEpilogue *epilogue,
+    primitiv::cpu::GemmKernelType type) {
+  if (m == 0 || n == 0) return;
+
+  if (beta == 0) {
+    for (unsigned j = 0; j < n; ++j) std::fill(c + j * ldc, c + j * ldc + m, 0);
+  } else if (beta != 1) {
+    for (unsigned j = 0; j < n; ++j) {
+      float *cj = c + j * ldc;
+      for (unsigned i = 0; i < m; ++i) cj[i] *= beta;
+    }
+  }
+  if (k == 0 || alpha == 0) {
+    if (epilogue) ::apply_epilogue(*epilogue, 0, m, n, c, ldc);
+    return;
+  }
+
+  ::gemm_blocked(
+      ::select_kernel(type), trans_a, trans_b,
+      m, n, k, alpha, a, lda, b, ldb, c, ldc, epilogue);
+}
+
+}  // namespace
+
+namespace primitiv {
+namespace cpu {
+
+bool gemm_kernel_supported(GemmKernelType type) {
+  return ::kernel_supported(type);
+}
+
+const char *gemm_kernel_name(GemmKernelType type) {
+  return ::select_kernel(type).name;
+}
+
+void gemm(
+    bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc,
+    GemmKernelType type) {
+  ::gemm_impl(
+      trans_a, trans_b, m, n, k,
+      alpha, a, lda, b, ldb, beta, c, ldc, nullptr, type);
+}
+
+void gemm(
+    bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc, const GemmEpilogue &epilogue,
+    GemmKernelType type) {
+  ::gemm_impl(
+      trans_a, trans_b, m, n, k,
+      alpha, a, lda, b, ldb, beta, c, ldc, &epilogue, type);
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,97 @@
+#ifndef PRIMITIV_CPU_GEMM_H_
+#define PRIMITIV_CPU_GEMM_H_
+
+namespace primitiv {
+namespace cpu {
+
+/**
+ * Microkernels of the CPU matrix multiplication.
+ */
+enum GemmKernelType {
+  GEMM_KERNEL_AUTO,
+  GEMM_KERNEL_GENERIC,
+  GEMM_KERNEL_AVX2,
+  GEMM_KERNEL_AVX512,
+};
+
+/**
+ * Activation functions applied by `GemmEpilogue`.
+ */
+enum GemmActivation {
+  GEMM_ACTIVATION_IDENTITY,
+  GEMM_ACTIVATION_RELU,
+  GEMM_ACTIVATION_TANH,
+  GEMM_ACTIVATION_SIGMOID,
+};
+
+/**
+ * Operation applied to each tile of C just after it is finished:
+ *   C[i, j] := act(C[i, j] + bias[i]).
+ */
+struct GemmEpilogue {
+  const float *bias;  // m elements, or nullptr to add nothing.
+  GemmActivation activation;
+};
+
+/**
+ * Checks whether the microkernel is available on the running CPU.
+ * @param type Microkernel type.
+ * @return true if the microkernel can be used, false otherwise.
+ */
+bool gemm_kernel_supported(GemmKernelType type);
+
+/**
+ * Retrieves the name of the microkernel.
+ * @param type Microkernel type. `GEMM_KERNEL_AUTO` resolves the microkernel
+ *             which is selected at runtime.
+ * @return Name of the microkernel.
+ */
+const char *gemm_kernel_name(GemmKernelType type);
+
+/**
+ * Calculates the general matrix multiplication:
+ *   C := alpha * op(A) . op(B) + beta * C,
+ * where op(X) is X or X^T, op(A) is an m-by-k matrix, op(B) is a k-by-n matrix
+ * and C is an m-by-n matrix. All matrices are stored in the column-major order.
+ * @param trans_a Whether to use A^T instead of A.
+ * @param trans_b Whether to use B^T instead of B.
+ * @param m Number of rows of op(A) and C.
+ * @param n Number of columns of op(B) and C.
+ * @param k Number of columns of op(A) and rows of op(B).
+ * @param alpha Scaling factor of op(A) . op(B).
+ * @param a Pointer to the matrix A.
+ * @param lda Leading dimension of A.
+ * @param b Pointer to the matrix B.
+ * @param ldb Leading dimension of B.
+ * @param beta Scaling factor of C. If `beta == 0`, C needs not to be
+ *             initialized.
+ * @param c Pointer to the matrix C.
+ * @param ldc Leading dimension of C.
+ * @param type Microkernel to use. Unsupported microkernels fall back to the
+ *             generic one.
+ */
+void gemm(
+    bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc,
+    GemmKernelType type = GEMM_KERNEL_AUTO);
+
+/**
+ * Same as above, but also applies the epilogue to the result:
+ *   C := act(alpha * op(A) . op(B) + beta * C + bias).
+ * The epilogue is applied while each output tile is still in the cache.
+ * @param epilogue Bias and activation function applied to C.
+ * @param type Microkernel to use.
+ */
+void gemm(
+    bool trans_a, bool trans_b,
+    unsigned m, unsigned n, unsigned k,
+    float alpha, const float *a, unsigned lda, const float *b, unsigned ldb,
+    float beta, float *c, unsigned ldc, const GemmEpilogue &epilogue,
+    GemmKernelType type = GEMM_KERNEL_AUTO);
+
+}  // namespace cpu
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CPU_GEMM_H_
@@ -0,0 +1,499 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <primitiv/cpu_math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRIMITIV_CPU_MATH_X86
+#include <immintrin.h>
+#endif
+
+// NOTE: Each function is based on the polynomial approximations of the Cephes
+//       library. The rounding of the reduced argument uses round/convert
+//       instructions explicitly because the library is compiled with
+//       -ffast-math and arithmetic tricks may be eliminated by the compiler.
+
+namespace {
+
+// Constants of exp().
+const float EXP_HI = 88.7228f;
+const float EXP_LO = -104.f;
+const float EXP_LOG2E = 1.44269504088896341f;
+const float EXP_C1 = 0.693359375f;
+const float EXP_C2 = -2.12194440e-4f;
+const float EXP_P0 = 1.9875691500e-4f;
+const float EXP_P1 = 1.3981999507e-3f;
+const float EXP_P2 = 8.3334519073e-3f;
+const float EXP_P3 = 4.1665795894e-2f;
+const float EXP_P4 = 1.6666665459e-1f;
+const float EXP_P5 = 5.0000001201e-1f;
+
+// Upper bound of the argument of exp() in sigmoid().
+const float SIGMOID_EXP_HI = 88.f;
+
+// Constants of log().
+const float LOG_SQRTHF = 0.707106781186547524f;
+const float LOG_SQRT2M1 = 0.414213562373095049f;
+const float LOG_P0 = 7.0376836292e-2f;
+const float LOG_P1 = -1.1514610310e-1f;
+const float LOG_P2 = 1.1676998740e-1f;
+const float LOG_P3 = -1.2420140846e-1f;
+const float LOG_P4 = 1.4249322787e-1f;
+const float LOG_P5 = -1.6668057665e-1f;
+const float LOG_P6 = 2.0000714765e-1f;
+const float LOG_P7 = -2.4999993993e-1f;
+const float LOG_P8 = 3.3333331174e-1f;
+const float LOG_Q1 = -2.12194440e-4f;
+const float LOG_Q2 = 0.693359375f;
+
+// Constants of tanh().
+const float TANH_SMALL = 0.625f;
+const float TANH_LARGE = 10.f;  // tanh(10) == 1 in single precision.
+const float TANH_P0 = -5.70498872745e-3f;
+const float TANH_P1 = 2.06390887954e-2f;
+const float TANH_P2 = -5.37397155531e-2f;
+const float TANH_P3 = 1.33314422036e-1f;
+const float TANH_P4 = -3.33332819422e-1f;
+
+// Generic implementations.
+
+void exp_generic(const float *x, float *y, unsigned size) {
+  for (unsigned i = 0; i < size; ++i) y[i] = std::exp(x[i]);
+}
+
+void log_generic(const float *x, float *y, unsigned size) {
+  for (unsigned i = 0; i < size; ++i) y[i] = std::log(x[i]);
+}
+
+void tanh_generic(const float *x, float *y, unsigned size) {
+  for (unsigned i = 0; i < size; ++i) y[i] = std::tanh(x[i]);
+}
+
+void sigmoid_generic(const float *x, float *y, unsigned size) {
+  for (unsigned i = 0; i < size; ++i) {
+    y[i] = 1 / (1 + std::exp(std::min(-x[i], SIGMOID_EXP_HI)));
+  }
+}
+
+void softplus_generic(const float *x, float *y, unsigned size) {
+  for (unsigned i = 0; i < size; ++i) {
+    const float v = x[i];
+    y[i] = std::max(v, 0.f) + std::log1p(std::exp(-std::fabs(v)));
+  }
+}
+
+#ifdef PRIMITIV_CPU_MATH_X86
+
+// Applies the vector function `fn` to the whole array.
+// The remainder is calculated in a padded buffer.
+#define DEFINE_ARRAY_FUNCTION(isa, name, width, load, store, fn) \
+__attribute__((target(isa))) \
+void name(const float *x, float *y, unsigned size) { \
+  unsigned i = 0; \
+  for (; i + (width) <= size; i += (width)) { \
+    store(y + i, fn(load(x + i))); \
+  } \
+  if (i < size) { \
+    float buf[(width)] = {}; \
+    std::copy(x + i, x + size, buf); \
+    store(buf, fn(load(buf))); \
+    std::copy(buf, buf + size - i, y + i); \
+  } \
+}
+
+// AVX2 implementations.
+
+#define AVX2_TARGET "avx2,fma"
+
+__attribute__((target(AVX2_TARGET)))
+inline __m256 exp_avx2(__m256 x) {
+  const __m256 hi = _mm256_set1_ps(EXP_HI);
+  const __m256 lo = _mm256_set1_ps(EXP_LO);
+  const __m256 v = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+  const __m256 fx = _mm256_round_ps(
+      _mm256_mul_ps(v, _mm256_set1_ps(EXP_LOG2E)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), v);
+  r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), r);
+  __m256 p = _mm256_set1_ps(EXP_P0);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P4));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P5));
+  p = _mm256_fmadd_ps(
+      p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+  // 2^n is split into 2^n1 * 2^n2 to cover subnormal/large results.
+  // 2^n1 is applied by adding to the exponent bits directly to prevent the
+  // reassociation of multiplications which may overflow.
+  const __m256i n = _mm256_cvtps_epi32(fx);
+  const __m256i n1 = _mm256_srai_epi32(n, 1);
+  const __m256i n2 = _mm256_sub_epi32(n, n1);
+  const __m256 s2 = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_add_epi32(n2, _mm256_set1_epi32(127)), 23));
+  __m256 y = _mm256_castsi256_ps(_mm256_add_epi32(
+        _mm256_castps_si256(p), _mm256_slli_epi32(n1, 23)));
+  y = _mm256_mul_ps(y, s2);
+  y = _mm256_blendv_ps(
+      y, _mm256_set1_ps(HUGE_VALF), _mm256_cmp_ps(x, hi, _CMP_GT_OQ));
+  y = _mm256_blendv_ps(y, _mm256_setzero_ps(), _mm256_cmp_ps(x, lo, _CMP_LT_OQ));
+  return _mm256_blendv_ps(y, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+}
+
+// Calculates fe * log(2) + log(1 + m) for m in [sqrt(0.5) - 1, sqrt(2) - 1].
+__attribute__((target(AVX2_TARGET)))
+inline __m256 log_poly_avx2(__m256 m, __m256 fe) {
+  const __m256 z = _mm256_mul_ps(m, m);
+  __m256 p = _mm256_set1_ps(LOG_P0);
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P1));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P2));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P3));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P4));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P5));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P6));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P7));
+  p = _mm256_fmadd_ps(p, m, _mm256_set1_ps(LOG_P8));
+  p = _mm256_mul_ps(_mm256_mul_ps(p, m), z);
+  p = _mm256_fmadd_ps(fe, _mm256_set1_ps(LOG_Q1), p);
+  p = _mm256_fnmadd_ps(z, _mm256_set1_ps(.5f), p);
+  return _mm256_fmadd_ps(fe, _mm256_set1_ps(LOG_Q2), _mm256_add_ps(m, p));
+}
+
+__attribute__((target(AVX2_TARGET)))
+inline __m256 log_avx2(__m256 x) {
+  // Scales subnormal numbers.
+  const __m256 small = _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_LT_OQ);
+  __m256 v = _mm256_blendv_ps(
+      x, _mm256_mul_ps(x, _mm256_set1_ps(8388608.f)), small);
+  const __m256i bits = _mm256_castps_si256(v);
+  __m256i e = _mm256_sub_epi32(
+      _mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+  e = _mm256_sub_epi32(
+      e, _mm256_and_si256(_mm256_castps_si256(small), _mm256_set1_epi32(23)));
+  // m in [0.5, 1)
+  __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+        _mm256_set1_epi32(0x3f000000)));
+  // if m < sqrt(0.5): e -= 1, m = 2m - 1; else m = m - 1
+  const __m256 lt = _mm256_cmp_ps(m, _mm256_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+  e = _mm256_add_epi32(e, _mm256_castps_si256(lt));  // lt is -1 for true.
+  m = _mm256_sub_ps(
+      _mm256_add_ps(m, _mm256_and_ps(lt, m)), _mm256_set1_ps(1.f));
+  __m256 y = log_poly_avx2(m, _mm256_cvtepi32_ps(e));
+  // Special values.
+  const __m256 inf = _mm256_set1_ps(HUGE_VALF);
+  y = _mm256_blendv_ps(y, inf, _mm256_cmp_ps(x, inf, _CMP_EQ_OQ));
+  y = _mm256_blendv_ps(
+      y, _mm256_sub_ps(_mm256_setzero_ps(), inf),
+      _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ));
+  return _mm256_blendv_ps(
+      y, _mm256_set1_ps(NAN),
+      _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NGE_UQ));
+}
+
+__attribute__((target(AVX2_TARGET)))
+inline __m256 tanh_avx2(__m256 x) {
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  const __m256 ax = _mm256_andnot_ps(sign, x);
+  // Small arguments: x + x^3 * P(x^2)
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 p = _mm256_set1_ps(TANH_P0);
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P1));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P2));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P3));
+  p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(TANH_P4));
+  const __m256 ys = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+  // Large arguments: 1 - 2 / (exp(2|x|) + 1)
+  const __m256 one = _mm256_set1_ps(1.f);
+  // NOTE: Arguments are clamped to avoid infinities because divisions may be
+  //       replaced by approximated reciprocals with -ffast-math.
+  const __m256 cx = _mm256_min_ps(ax, _mm256_set1_ps(TANH_LARGE));
+  const __m256 e = exp_avx2(_mm256_add_ps(cx, cx));
+  __m256 yl = _mm256_sub_ps(
+      one, _mm256_div_ps(_mm256_set1_ps(2.f), _mm256_add_ps(e, one)));
+  yl = _mm256_or_ps(yl, _mm256_and_ps(sign, x));
+  return _mm256_blendv_ps(
+      yl, ys, _mm256_cmp_ps(ax, _mm256_set1_ps(TANH_SMALL), _CMP_LT_OQ));
+}
+
+__attribute__((target(AVX2_TARGET)))
+inline __m256 sigmoid_avx2(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 e = exp_avx2(_mm256_min_ps(
+        _mm256_sub_ps(_mm256_setzero_ps(), x), _mm256_set1_ps(SIGMOID_EXP_HI)));
+  return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+__attribute__((target(AVX2_TARGET)))
+inline __m256 softplus_avx2(__m256 x) {
+  const __m256 ax = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+  const __m256 e = exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), ax));
+  // log(1 + e) is calculated directly by the polynomial for small e to avoid
+  // the rounding error of 1 + e.
+  const __m256 l = _mm256_blendv_ps(
+      log_avx2(_mm256_add_ps(_mm256_set1_ps(1.f), e)),
+      log_poly_avx2(e, _mm256_setzero_ps()),
+      _mm256_cmp_ps(e, _mm256_set1_ps(LOG_SQRT2M1), _CMP_LT_OQ));
+  return _mm256_add_ps(_mm256_max_ps(x, _mm256_setzero_ps()), l);
+}
+
+DEFINE_ARRAY_FUNCTION(
+    AVX2_TARGET, exp_array_avx2, 8,
+    _mm256_loadu_ps, _mm256_storeu_ps, exp_avx2);
+DEFINE_ARRAY_FUNCTION(
+    AVX2_TARGET, log_array_avx2, 8,
+    _mm256_loadu_ps, _mm256_storeu_ps, log_avx2);
+DEFINE_ARRAY_FUNCTION(
+    AVX2_TARGET, tanh_array_avx2, 8,
+    _mm256_loadu_ps, _mm256_storeu_ps, tanh_avx2);
+DEFINE_ARRAY_FUNCTION(
+    AVX2_TARGET, sigmoid_array_avx2, 8,
+    _mm256_loadu_ps, _mm256_storeu_ps, sigmoid_avx2);
+DEFINE_ARRAY_FUNCTION(
+    AVX2_TARGET, softplus_array_avx2, 8,
+    _mm256_loadu_ps, _mm256_storeu_ps, softplus_avx2);
+
+// AVX-512 implementations.
+
+// NOTE: Some versions of GCC report false positives of -Wmaybe-uninitialized
+// in the AVX-512 intrinsics which use `_mm512_undefined_*()` internally.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#define AVX512_TARGET "avx512f"
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 exp_avx512(__m512 x) {
+  const __m512 hi = _mm512_set1_ps(EXP_HI);
+  const __m512 lo = _mm512_set1_ps(EXP_LO);
+  const __m512 v = _mm512_min_ps(_mm512_max_ps(x, lo), hi);
+  const __m512 fx = _mm512_roundscale_ps(
+      _mm512_mul_ps(v, _mm512_set1_ps(EXP_LOG2E)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), v);
+  r = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), r);
+  __m512 p = _mm512_set1_ps(EXP_P0);
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P4));
+  p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P5));
+  p = _mm512_fmadd_ps(
+      p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.f)));
+  const __m512i n = _mm512_cvtps_epi32(fx);
+  const __m512i n1 = _mm512_srai_epi32(n, 1);
+  const __m512i n2 = _mm512_sub_epi32(n, n1);
+  const __m512 s2 = _mm512_castsi512_ps(_mm512_slli_epi32(
+        _mm512_add_epi32(n2, _mm512_set1_epi32(127)), 23));
+  __m512 y = _mm512_castsi512_ps(_mm512_add_epi32(
+        _mm512_castps_si512(p), _mm512_slli_epi32(n1, 23)));
+  y = _mm512_mul_ps(y, s2);
+  y = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(x, hi, _CMP_GT_OQ), y, _mm512_set1_ps(HUGE_VALF));
+  y = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(x, lo, _CMP_LT_OQ), y, _mm512_setzero_ps());
+  return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q), y, x);
+}
+
+// Calculates fe * log(2) + log(1 + m) for m in [sqrt(0.5) - 1, sqrt(2) - 1].
+__attribute__((target(AVX512_TARGET)))
+inline __m512 log_poly_avx512(__m512 m, __m512 fe) {
+  const __m512 z = _mm512_mul_ps(m, m);
+  __m512 p = _mm512_set1_ps(LOG_P0);
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P1));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P2));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P3));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P4));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P5));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P6));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P7));
+  p = _mm512_fmadd_ps(p, m, _mm512_set1_ps(LOG_P8));
+  p = _mm512_mul_ps(_mm512_mul_ps(p, m), z);
+  p = _mm512_fmadd_ps(fe, _mm512_set1_ps(LOG_Q1), p);
+  p = _mm512_fnmadd_ps(z, _mm512_set1_ps(.5f), p);
+  return _mm512_fmadd_ps(fe, _mm512_set1_ps(LOG_Q2), _mm512_add_ps(m, p));
+}
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 log_avx512(__m512 x) {
+  const __mmask16 small = _mm512_cmp_ps_mask(
+      x, _mm512_set1_ps(FLT_MIN), _CMP_LT_OQ);
+  const __m512 v = _mm512_mask_mul_ps(x, small, x, _mm512_set1_ps(8388608.f));
+  const __m512i bits = _mm512_castps_si512(v);
+  __m512i e = _mm512_sub_epi32(
+      _mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126));
+  e = _mm512_mask_sub_epi32(e, small, e, _mm512_set1_epi32(23));
+  __m512 m = _mm512_castsi512_ps(_mm512_or_epi32(
+        _mm512_and_epi32(bits, _mm512_set1_epi32(0x007fffff)),
+        _mm512_set1_epi32(0x3f000000)));
+  const __mmask16 lt = _mm512_cmp_ps_mask(
+      m, _mm512_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+  e = _mm512_mask_sub_epi32(e, lt, e, _mm512_set1_epi32(1));
+  m = _mm512_sub_ps(_mm512_mask_add_ps(m, lt, m, m), _mm512_set1_ps(1.f));
+  __m512 y = log_poly_avx512(m, _mm512_cvtepi32_ps(e));
+  const __m512 inf = _mm512_set1_ps(HUGE_VALF);
+  const __m512 zero = _mm512_setzero_ps();
+  y = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, inf, _CMP_EQ_OQ), y, inf);
+  y = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(x, zero, _CMP_EQ_OQ), y, _mm512_sub_ps(zero, inf));
+  return _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(x, zero, _CMP_NGE_UQ), y, _mm512_set1_ps(NAN));
+}
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 abs_avx512(__m512 x) {
+  return _mm512_castsi512_ps(_mm512_and_epi32(
+        _mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff)));
+}
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 tanh_avx512(__m512 x) {
+  const __m512 ax = abs_avx512(x);
+  const __m512 z = _mm512_mul_ps(x, x);
+  __m512 p = _mm512_set1_ps(TANH_P0);
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(TANH_P1));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(TANH_P2));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(TANH_P3));
+  p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(TANH_P4));
+  const __m512 ys = _mm512_fmadd_ps(_mm512_mul_ps(p, z), x, x);
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 cx = _mm512_min_ps(ax, _mm512_set1_ps(TANH_LARGE));
+  const __m512 e = exp_avx512(_mm512_add_ps(cx, cx));
+  __m512 yl = _mm512_sub_ps(
+      one, _mm512_div_ps(_mm512_set1_ps(2.f), _mm512_add_ps(e, one)));
+  yl = _mm512_castsi512_ps(_mm512_or_epi32(
+        _mm512_castps_si512(yl),
+        _mm512_and_epi32(
+          _mm512_castps_si512(x), _mm512_set1_epi32(0x80000000))));
+  return _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(ax, _mm512_set1_ps(TANH_SMALL), _CMP_LT_OQ), yl, ys);
+}
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 sigmoid_avx512(__m512 x) {
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 e = exp_avx512(_mm512_min_ps(
+        _mm512_sub_ps(_mm512_setzero_ps(), x), _mm512_set1_ps(SIGMOID_EXP_HI)));
+  return _mm512_div_ps(one, _mm512_add_ps(one, e));
+}
+
+__attribute__((target(AVX512_TARGET)))
+inline __m512 softplus_avx512(__m512 x) {
+  const __m512 e = exp_avx512(_mm512_sub_ps(_mm512_setzero_ps(), abs_avx512(x)));
+  const __m512 l = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(e, _mm512_set1_ps(LOG_SQRT2M1), _CMP_LT_OQ),
+      log_avx512(_mm512_add_ps(_mm512_set1_ps(1.f), e)),
+      log_poly_avx512(e, _mm512_setzero_ps()));
+  return _mm512_add_ps(_mm512_max_ps(x, _mm512_setzero_ps()), l);
+}
+
+DEFINE_ARRAY_FUNCTION(
+    AVX512_TARGET, exp_array_avx512, 16,
+    _mm512_loadu_ps, _mm512_storeu_ps, exp_avx512);
+DEFINE_ARRAY_FUNCTION(
+    AVX512_TARGET, log_array_avx512, 16,
+    _mm512_loadu_ps, _mm512_storeu_ps, log_avx512);
+DEFINE_ARRAY_FUNCTION(
+    AVX512_TARGET, tanh_array_avx512, 16,
+    _mm512_loadu_ps, _mm512_storeu_ps, tanh_avx512);
+DEFINE_ARRAY_FUNCTION(
+    AVX512_TARGET, sigmoid_array_avx512, 16,
+    _mm512_loadu_ps, _mm512_storeu_ps, sigmoid_avx512);
+DEFINE_ARRAY_FUNCTION(
+    AVX512_TARGET, softplus_array_avx512, 16,
+    _mm512_loadu_ps, _mm512_storeu_ps, softplus_avx512);
+
+#pragma GCC diagnostic pop
+
+#undef AVX2_TARGET
+#undef AVX512_TARGET
+#undef DEFINE_ARRAY_FUNCTION
+
+#endif  // PRIMITIV_CPU_MATH_X86
+
+bool kernel_supported(primitiv::cpu::MathKernelType type) {
+  using namespace primitiv::cpu;
+  switch (type) {
+    case MATH_KERNEL_AUTO:
+    case MATH_KERNEL_GENERIC:
+      return true;
+#ifdef PRIMITIV_CPU_MATH_X86
+    case MATH_KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case MATH_KERNEL_AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif  // PRIMITIV_CPU_MATH_X86
+    default:
+      return false;
+  }
+}
+
+// Resolves MATH_KERNEL_AUTO and unsupported types.
+primitiv::cpu::MathKernelType resolve(primitiv::cpu::MathKernelType type) {
+  using namespace primitiv::cpu;
+  static const MathKernelType best =
+    ::kernel_supported(MATH_KERNEL_AVX512) ? MATH_KERNEL_AVX512 :
+    ::kernel_supported(MATH_KERNEL_AVX2) ? MATH_KERNEL_AVX2 :
+    MATH_KERNEL_GENERIC;
+  if (type == MATH_KERNEL_AUTO) return best;
+  return ::kernel_supported(type) ? type : MATH_KERNEL_GENERIC;
+}
+
+}  // namespace
+
+namespace primitiv {
+namespace cpu {
+
+bool math_kernel_supported(MathKernelType type) {
+  return ::kernel_supported(type);
+}
+
+const char *math_kernel_name(MathKernelType type) {
+  switch (::resolve(type)) {
+    case MATH_KERNEL_AVX2: return "avx2";
+    case MATH_KERNEL_AVX512: return "avx512";
+    default: return "generic";
+  }
+}
+
+#ifdef PRIMITIV_CPU_MATH_X86
+#define DISPATCH(name, x, y, size, type) \
+  switch (::resolve(type)) { \
+    case MATH_KERNEL_AVX2: ::name##_array_avx2(x, y, size); break; \
+    case MATH_KERNEL_AVX512: ::name##_array_avx512(x, y, size); break; \
+    default: ::name##_generic(x, y, size); \
+  }
+#else
+#define DISPATCH(name, x, y, size, type) \
+  static_cast<void>(type); \
+  ::name##_generic(x, y, size);
+#endif  // PRIMITIV_CPU_MATH_X86
+
+void fast_exp(const float *x, float *y, unsigned size, MathKernelType type) {
+  DISPATCH(exp, x, y, size, type);
+}
+
+void fast_log(const float *x, float *y, unsigned size, MathKernelType type) {
+  DISPATCH(log, x, y, size, type);
+}
+
+void fast_tanh(const float *x, float *y, unsigned size, MathKernelType type) {
+  DISPATCH(tanh, x, y, size, type);
+}
+
+void fast_sigmoid(
+    const float *x, float *y, unsigned size, MathKernelType type) {
+  DISPATCH(sigmoid, x, y, size, type);
+}
+
+void fast_softplus(
+    const float *x, float *y, unsigned size, MathKernelType type) {
+  DISPATCH(softplus, x, y, size, type);
+}
+
+#undef DISPATCH
+
+}  // namespace cpu
+}  // namespace primitiv
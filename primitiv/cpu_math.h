@@ -0,0 +1,104 @@
+#ifndef PRIMITIV_CPU_MATH_H_
+#define PRIMITIV_CPU_MATH_H_
+
+namespace primitiv {
+namespace cpu {
+
+/**
+ * Implementations of the fast transcendental functions.
+ */
+enum MathKernelType {
+  MATH_KERNEL_AUTO,
+  MATH_KERNEL_GENERIC,
+  MATH_KERNEL_AVX2,
+  MATH_KERNEL_AVX512,
+};
+
+/**
+ * Checks whether the implementation is available on the running CPU.
+ * @param type Implementation type.
+ * @return true if the implementation can be used, false otherwise.
+ */
+bool math_kernel_supported(MathKernelType type);
+
+/**
+ * Retrieves the name of the implementation.
+ * @param type Implementation type. `MATH_KERNEL_AUTO` resolves the
+ *             implementation which is selected at runtime.
+ * @return Name of the implementation.
+ */
+const char *math_kernel_name(MathKernelType type);
+
+/**
+ * Calculates y[i] = exp(x[i]) for all i in [0, size).
+ * @param x Source array.
+ * @param y Destination array. `x == y` is allowed.
+ * @param size Number of elements.
+ * @param type Implementation to use. Unsupported implementations fall back
+ *             to the generic one which calls the standard library.
+ * @remarks The maximum error of SIMD implementations is 1 ULP if the result is
+ *          a normalized number. Results less than `FLT_MIN` may be flushed to
+ *          0 and results larger than `FLT_MAX` become infinity.
+ */
+void fast_exp(
+    const float *x, float *y, unsigned size,
+    MathKernelType type = MATH_KERNEL_AUTO);
+
+/**
+ * Calculates y[i] = log(x[i]) for all i in [0, size).
+ * @param x Source array.
+ * @param y Destination array. `x == y` is allowed.
+ * @param size Number of elements.
+ * @param type Implementation to use.
+ * @remarks The maximum error of SIMD implementations is 1 ULP.
+ *          log(0) is -infinity and log(x) for x < 0 is NaN.
+ *          Subnormal arguments may be treated as 0 depending on the
+ *          floating-point environment.
+ */
+void fast_log(
+    const float *x, float *y, unsigned size,
+    MathKernelType type = MATH_KERNEL_AUTO);
+
+/**
+ * Calculates y[i] = tanh(x[i]) for all i in [0, size).
+ * @param x Source array.
+ * @param y Destination array. `x == y` is allowed.
+ * @param size Number of elements.
+ * @param type Implementation to use.
+ * @remarks The maximum error of SIMD implementations is 2 ULP.
+ */
+void fast_tanh(
+    const float *x, float *y, unsigned size,
+    MathKernelType type = MATH_KERNEL_AUTO);
+
+/**
+ * Calculates y[i] = 1 / (1 + exp(-x[i])) for all i in [0, size).
+ * @param x Source array.
+ * @param y Destination array. `x == y` is allowed.
+ * @param size Number of elements.
+ * @param type Implementation to use.
+ * @remarks The maximum error of SIMD implementations is 4 ULP if the result is
+ *          a normalized number.
+ */
+void fast_sigmoid(
+    const float *x, float *y, unsigned size,
+    MathKernelType type = MATH_KERNEL_AUTO);
+
+/**
+ * Calculates y[i] = log(1 + exp(x[i])) for all i in [0, size).
+ * @param x Source array.
+ * @param y Destination array. `x == y` is allowed.
+ * @param size Number of elements.
+ * @param type Implementation to use.
+ * @remarks The maximum error of SIMD implementations is 4 ULP if the result is
+ *          a normalized number. This function is calculated in the
+ *          numerically stable form: max(x, 0) + log(1 + exp(-|x|)).
+ */
+void fast_softplus(
+    const float *x, float *y, unsigned size,
+    MathKernelType type = MATH_KERNEL_AUTO);
+
+}  // namespace cpu
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CPU_MATH_H_
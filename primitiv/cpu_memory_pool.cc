@@ -0,0 +1,173 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <primitiv/cpu_memory_pool.h>
+#include <primitiv/error.h>
+#include <primitiv/numa.h>
+
+using std::cerr;
+using std::endl;
+using std::make_pair;
+
+namespace {
+
+// Blocks smaller than 2^MIN_SCALE bytes are rounded up to this size so that
+// every block occupies whole cache lines.
+const unsigned MIN_SCALE = 6;
+
+// Available maximum size of the memory is 2^MAX_SCALE bytes.
+const unsigned MAX_SCALE = 63;
+
+}  // namespace
+
+namespace primitiv {
+
+const unsigned CPUMemoryPool::ALIGNMENT;
+
+CPUMemoryPool::CPUMemoryPool()
+: numa_node_(-1)
+, link_(std::make_shared<Link>())
+, reserved_(::MAX_SCALE + 1)
+, supplied_()
+, stats_() {
+  link_->pool = this;
+}
+
+CPUMemoryPool::CPUMemoryPool(unsigned numa_node)
+: numa_node_(numa_node)
+, link_(std::make_shared<Link>())
+, reserved_(::MAX_SCALE + 1)
+, supplied_()
+, stats_() {
+  if (numa_node >= numa::num_nodes()) {
+    THROW_ERROR(
+        "Invalid NUMA node: " << numa_node << ", number of nodes: "
+        << numa::num_nodes());
+  }
+  link_->pool = this;
+}
+
+CPUMemoryPool::~CPUMemoryPool() {
+  std::lock_guard<std::mutex> lock(link_->mutex);
+  // NOTE(odashi):
+  // Tensors may outlive their device, and their blocks are freed by the
+  // deleters directly after the pool is destroyed.
+  if (!supplied_.empty()) {
+    cerr << "WARNING: CPU memory pool is destroyed while "
+         << supplied_.size() << " block(s) are still used." << endl;
+    cerr << "Remaining blocks (handle: size):" << endl;
+    for (const auto &kv : supplied_) {
+      cerr << "  " << kv.first << ": " << (1ull << kv.second) << endl;
+    }
+  }
+  link_->pool = nullptr;
+  release_reserved_blocks_unsafe();
+}
+
+void CPUMemoryPool::release_reserved_blocks() {
+  std::lock_guard<std::mutex> lock(link_->mutex);
+  release_reserved_blocks_unsafe();
+}
+
+void CPUMemoryPool::release_reserved_blocks_unsafe() {
+  for (auto &ptrs : reserved_) {
+    while (!ptrs.empty()) {
+      std::free(ptrs.back());
+      ptrs.pop_back();
+    }
+  }
+  stats_.bytes_reserved = 0;
+}
+
+MemoryPoolStats CPUMemoryPool::stats() const {
+  std::lock_guard<std::mutex> lock(link_->mutex);
+  MemoryPoolStats ret = stats_;
+  ret.reserved_bytes_by_scale.resize(reserved_.size());
+  for (unsigned i = 0; i < reserved_.size(); ++i) {
+    ret.reserved_bytes_by_scale[i] =
+      static_cast<std::uint64_t>(reserved_[i].size()) << i;
+  }
+  return ret;
+}
+
+std::shared_ptr<void> CPUMemoryPool::allocate(std::uint64_t size) {
+  unsigned scale = ::MIN_SCALE;
+  while (1ull << scale < size) {
+    if (scale == ::MAX_SCALE) {
+      THROW_ERROR(
+          "Attempted to allocate more than 2^" << ::MAX_SCALE << " bytes.");
+    }
+    ++scale;
+  }
+  const std::uint64_t block_size = 1ull << scale;
+
+  std::lock_guard<std::mutex> lock(link_->mutex);
+  ++stats_.num_requests;
+
+  void *ptr;
+  if (reserved_[scale].empty()) {
+    // Allocates a new block.
+    ptr = allocate_block(block_size);
+    if (!ptr) {
+      // Maybe out-of-memory.
+      // Release other blocks and try allocation again.
+      ++stats_.num_oom_retries;
+      release_reserved_blocks_unsafe();
+      ptr = allocate_block(block_size);
+      if (!ptr) {
+        THROW_ERROR("Memory allocation failed. Requested size: " << size);
+      }
+    }
+    ++stats_.num_system_allocs;
+  } else {
+    // Returns an existing block.
+    ptr = reserved_[scale].back();
+    reserved_[scale].pop_back();
+    stats_.bytes_reserved -= block_size;
+    ++stats_.num_hits;
+  }
+  supplied_.insert(make_pair(ptr, scale));
+  stats_.bytes_in_use += block_size;
+  stats_.peak_bytes_in_use =
+    std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+
+  return std::shared_ptr<void>(ptr, CPUMemoryDeleter(link_));
+}
+
+void *CPUMemoryPool::allocate_block(std::uint64_t block_size) {
+  // NOTE(odashi):
+  // Memory policies are applied to whole pages, and blocks smaller than the
+  // page are left to the first-touch policy to keep neighboring blocks
+  // unaffected.
+  const std::uint64_t page = numa::page_size();
+  const bool bind = numa_node_ >= 0 && block_size >= page;
+  void *ptr;
+  if (::posix_memalign(&ptr, bind ? page : ALIGNMENT, block_size) != 0) {
+    return nullptr;
+  }
+  if (bind) numa::bind_memory(ptr, block_size, numa_node_);
+  return ptr;
+}
+
+void CPUMemoryPool::free_unsafe(void *ptr) {
+  auto it = supplied_.find(ptr);
+  if (it == supplied_.end()) {
+    THROW_ERROR("Detected to dispose unknown handle: " << ptr);
+  }
+
+  const std::uint64_t block_size = 1ull << it->second;
+  reserved_[it->second].emplace_back(ptr);
+  supplied_.erase(it);
+  stats_.bytes_in_use -= block_size;
+  stats_.bytes_reserved += block_size;
+}
+
+void CPUMemoryDeleter::operator()(void *ptr) {
+  std::lock_guard<std::mutex> lock(link_->mutex);
+  if (link_->pool) link_->pool->free_unsafe(ptr);
+  else std::free(ptr);
+}
+
+}  // namespace primitiv
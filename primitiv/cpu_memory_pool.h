@@ -0,0 +1,129 @@
+#ifndef PRIMITIV_CPU_MEMORY_POOL_H_
+#define PRIMITIV_CPU_MEMORY_POOL_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <primitiv/memory_pool_stats.h>
+
+namespace primitiv {
+
+class CPUMemoryDeleter;
+
+/**
+ * Memory manager on the host.
+ */
+class CPUMemoryPool {
+  friend CPUMemoryDeleter;
+
+  CPUMemoryPool(const CPUMemoryPool &) = delete;
+  CPUMemoryPool(CPUMemoryPool &&) = delete;
+  CPUMemoryPool &operator=(const CPUMemoryPool &) = delete;
+  CPUMemoryPool &operator=(CPUMemoryPool &&) = delete;
+
+public:
+  /**
+   * Alignment of every memory block in bytes.
+   */
+  static const unsigned ALIGNMENT = 64;
+
+  /**
+   * Creates a memory pool.
+   */
+  CPUMemoryPool();
+
+  /**
+   * Creates a memory pool whose memories are placed on a NUMA node.
+   * @param numa_node Node ID.
+   * @remarks Blocks larger than the page size are bound to the node
+   *          explicitly, and smaller blocks are placed by the first-touch
+   *          policy of the system.
+   */
+  explicit CPUMemoryPool(unsigned numa_node);
+
+  /**
+   * Destroys the pool.
+   * @remarks Blocks still used by other objects are reported to the standard
+   *          error, and they are returned to the system when they are
+   *          released.
+   */
+  ~CPUMemoryPool();
+
+  /**
+   * Allocates a memory.
+   * @param size Size of the resulting memory.
+   * @return Shared pointer of the allocated memory.
+   * @remarks The resulting memory is aligned to `ALIGNMENT` bytes.
+   */
+  std::shared_ptr<void> allocate(std::uint64_t size);
+
+  /**
+   * Releases all reserved memory blocks.
+   * @remarks Memories which are currently used are not affected.
+   */
+  void release_reserved_blocks();
+
+  /**
+   * Retrieves the current usage of the pool.
+   * @return Statistics of this pool.
+   */
+  MemoryPoolStats stats() const;
+
+  /**
+   * Retrieves the NUMA node of this pool.
+   * @return Node ID, or -1 if memories are not bound.
+   */
+  int numa_node() const { return numa_node_; }
+
+private:
+  /**
+   * State shared with deleters of supplied blocks, which may outlive the pool.
+   */
+  struct Link {
+    std::mutex mutex;
+    CPUMemoryPool *pool;
+  };
+
+  /**
+   * Obtains a new block from the system.
+   * @param block_size Size of the block.
+   * @return Head of the block, or nullptr if the allocation failed.
+   */
+  void *allocate_block(std::uint64_t block_size);
+
+  /**
+   * Disposes the memory without locking.
+   * @param ptr Handle of the memory to be disposed.
+   */
+  void free_unsafe(void *ptr);
+
+  /**
+   * Releases all reserved memory blocks without locking.
+   */
+  void release_reserved_blocks_unsafe();
+
+  int numa_node_;
+  std::shared_ptr<Link> link_;
+  std::vector<std::vector<void *>> reserved_;
+  std::unordered_map<void *, unsigned> supplied_;
+  MemoryPoolStats stats_;
+};
+
+/**
+ * Custom deleter class for host memories.
+ */
+class CPUMemoryDeleter {
+  CPUMemoryDeleter() = delete;
+public:
+  explicit CPUMemoryDeleter(const std::shared_ptr<CPUMemoryPool::Link> &link)
+    : link_(link) {}
+  void operator()(void *ptr);
+private:
+  std::shared_ptr<CPUMemoryPool::Link> link_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CPU_MEMORY_POOL_H_
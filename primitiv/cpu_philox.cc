@@ -0,0 +1,133 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <primitiv/cpu_philox.h>
+
+namespace {
+
+const std::uint32_t PHILOX_M0 = 0xd2511f53;
+const std::uint32_t PHILOX_M1 = 0xcd9e8d57;
+const std::uint32_t PHILOX_W0 = 0x9e3779b9;
+const std::uint32_t PHILOX_W1 = 0xbb67ae85;
+const unsigned PHILOX_ROUNDS = 10;
+
+// Number of blocks calculated at once. Every round runs over all blocks by
+// independent loops so that they can be vectorized.
+const unsigned PHILOX_LANES = 16;
+
+// Constants to convert integers to floats, same as cuRAND.
+const float TWO_POW32_INV = 2.3283064e-10f;
+const float TWO_POW32_INV_2PI = 2.3283064e-10f * 6.2831855f;
+
+// Calculates PHILOX_LANES blocks with counters offset + [0, PHILOX_LANES).
+// The j-th integer of the l-th block is stored in dest[4 * l + j].
+void philox_blocks(
+    std::uint64_t seed, std::uint64_t offset, std::uint32_t *dest) {
+  std::uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES];
+  std::uint32_t c2[PHILOX_LANES], c3[PHILOX_LANES];
+  for (unsigned l = 0; l < PHILOX_LANES; ++l) {
+    const std::uint64_t c = offset + l;
+    c0[l] = static_cast<std::uint32_t>(c);
+    c1[l] = static_cast<std::uint32_t>(c >> 32);
+    c2[l] = 0;
+    c3[l] = 0;
+  }
+  std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+  std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+  for (unsigned r = 0; r < ::PHILOX_ROUNDS; ++r) {
+    for (unsigned l = 0; l < PHILOX_LANES; ++l) {
+      const std::uint64_t p0 = static_cast<std::uint64_t>(::PHILOX_M0) * c0[l];
+      const std::uint64_t p1 = static_cast<std::uint64_t>(::PHILOX_M1) * c2[l];
+      c0[l] = static_cast<std::uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+      c1[l] = static_cast<std::uint32_t>(p1);
+      c2[l] = static_cast<std::uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+      c3[l] = static_cast<std::uint32_t>(p0);
+    }
+    k0 += ::PHILOX_W0;
+    k1 += ::PHILOX_W1;
+  }
+  for (unsigned l = 0; l < PHILOX_LANES; ++l) {
+    dest[4 * l] = c0[l];
+    dest[4 * l + 1] = c1[l];
+    dest[4 * l + 2] = c2[l];
+    dest[4 * l + 3] = c3[l];
+  }
+}
+
+// Calls op(lo, hi, bits, dest) for each group of blocks which covers
+// [begin, end), where bits[i] is the integer of the (first + i)-th number,
+// and [first + lo, first + hi) is the range to be written to dest[first:].
+template<typename Op>
+void philox_generate(
+    std::uint64_t seed, std::uint64_t offset,
+    unsigned begin, unsigned end, float *dest, Op op) {
+  const unsigned group = 4 * ::PHILOX_LANES;
+  std::uint32_t bits[group];
+  for (std::uint64_t first = begin / group * group; first < end;
+      first += group) {
+    ::philox_blocks(seed, offset + first / 4, bits);
+    const unsigned lo = std::max<std::uint64_t>(begin, first) - first;
+    const unsigned hi = std::min<std::uint64_t>(end, first + group) - first;
+    op(lo, hi, bits, dest + first);
+  }
+}
+
+}  // namespace
+
+namespace primitiv {
+namespace cpu {
+
+void philox4x32_10(
+    const std::uint32_t counter[4], const std::uint32_t key[2],
+    std::uint32_t result[4]) {
+  std::uint32_t c0 = counter[0], c1 = counter[1];
+  std::uint32_t c2 = counter[2], c3 = counter[3];
+  std::uint32_t k0 = key[0], k1 = key[1];
+  for (unsigned r = 0; r < ::PHILOX_ROUNDS; ++r) {
+    const std::uint64_t p0 = static_cast<std::uint64_t>(::PHILOX_M0) * c0;
+    const std::uint64_t p1 = static_cast<std::uint64_t>(::PHILOX_M1) * c2;
+    c0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+    c1 = static_cast<std::uint32_t>(p1);
+    c2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+    c3 = static_cast<std::uint32_t>(p0);
+    k0 += ::PHILOX_W0;
+    k1 += ::PHILOX_W1;
+  }
+  result[0] = c0;
+  result[1] = c1;
+  result[2] = c2;
+  result[3] = c3;
+}
+
+void philox_uniform(
+    std::uint64_t seed, std::uint64_t offset,
+    unsigned begin, unsigned end, float *dest) {
+  ::philox_generate(
+      seed, offset, begin, end, dest,
+      [](unsigned lo, unsigned hi, const std::uint32_t *bits, float *d) {
+        for (unsigned i = lo; i < hi; ++i) {
+          d[i] = bits[i] * ::TWO_POW32_INV + ::TWO_POW32_INV / 2;
+        }
+      });
+}
+
+void philox_normal(
+    std::uint64_t seed, std::uint64_t offset,
+    unsigned begin, unsigned end, float *dest) {
+  ::philox_generate(
+      seed, offset, begin, end, dest,
+      [](unsigned lo, unsigned hi, const std::uint32_t *bits, float *d) {
+        for (unsigned i = lo & ~1u; i < hi; i += 2) {
+          const float u = bits[i] * ::TWO_POW32_INV + ::TWO_POW32_INV / 2;
+          const float v =
+            bits[i + 1] * ::TWO_POW32_INV_2PI + ::TWO_POW32_INV_2PI / 2;
+          const float s = std::sqrt(-2.f * std::log(u));
+          if (i >= lo) d[i] = s * std::sin(v);
+          if (i + 1 < hi) d[i + 1] = s * std::cos(v);
+        }
+      });
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,54 @@
+#ifndef PRIMITIV_CPU_PHILOX_H_
+#define PRIMITIV_CPU_PHILOX_H_
+
+#include <cstdint>
+
+namespace primitiv {
+namespace cpu {
+
+/**
+ * Calculates one block of the Philox4x32-10 counter-based generator.
+ * @param counter 128-bit counter.
+ * @param key 64-bit key.
+ * @param result Resulting 4 integers.
+ */
+void philox4x32_10(
+    const std::uint32_t counter[4], const std::uint32_t key[2],
+    std::uint32_t result[4]);
+
+/**
+ * Generates uniform random numbers in (0, 1].
+ * The i-th number is made from the (i % 4)-th integer of the block with the
+ * counter `offset + i / 4` and the key `seed`, in the same way as
+ * `curand_uniform()` with the Philox4_32_10 state.
+ * @param seed Key of the generator.
+ * @param offset Counter of the block which makes the 0-th number.
+ * @param begin Index of the first number.
+ * @param end Index of the next of the last number.
+ * @param dest Destination array. Only dest[begin:end] is written.
+ * @remarks Each number depends only on `seed`, `offset` and its index, and
+ *          the results do not depend on how the whole range is split.
+ */
+void philox_uniform(
+    std::uint64_t seed, std::uint64_t offset,
+    unsigned begin, unsigned end, float *dest);
+
+/**
+ * Generates random numbers of the standard normal distribution.
+ * Integers are made in the same way as `philox_uniform()`, and every two
+ * numbers with indices 2k and 2k+1 are made by the Box-Muller transform in
+ * the same way as `curand_normal4()`.
+ * @param seed Key of the generator.
+ * @param offset Counter of the block which makes the 0-th number.
+ * @param begin Index of the first number.
+ * @param end Index of the next of the last number.
+ * @param dest Destination array. Only dest[begin:end] is written.
+ */
+void philox_normal(
+    std::uint64_t seed, std::uint64_t offset,
+    unsigned begin, unsigned end, float *dest);
+
+}  // namespace cpu
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CPU_PHILOX_H_
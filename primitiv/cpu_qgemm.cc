@@ -0,0 +1,226 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <primitiv/cpu_qgemm.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRIMITIV_CPU_QGEMM_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Number of int8 elements processed by each step of kernels.
+const unsigned QGEMM_DEPTH_ALIGNMENT = 32;
+
+// Number of rows of W processed for all columns of X at once (fits in L2).
+const unsigned QGEMM_ROW_BLOCK = 64;
+
+// Largest magnitude of quantized values. -128 is never used so that the
+// magnitude of every product fits in 16 bits with its neighbor.
+const float QGEMM_MAX_VALUE = 127;
+
+// Kernel: returns sum_l w[l] * x[l] for kp elements.
+// If the kernel uses unsigned inputs, x is biased by 128 and the result
+// includes 128 * sum_l w[l].
+typedef std::int32_t (*DotKernel)(
+    unsigned kp, const std::int8_t *w, const std::int8_t *x);
+
+struct KernelInfo {
+  const char *name;
+  bool unsigned_x;
+  DotKernel fn;
+};
+
+std::int32_t kernel_generic(
+    unsigned kp, const std::int8_t *w, const std::int8_t *x) {
+  std::int32_t acc = 0;
+  for (unsigned l = 0; l < kp; ++l) acc += w[l] * x[l];
+  return acc;
+}
+
+#ifdef PRIMITIV_CPU_QGEMM_X86
+
+__attribute__((target("avx2")))
+inline std::int32_t reduce_epi32(__m256i v) {
+  __m128i s = _mm_add_epi32(
+      _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+std::int32_t kernel_avx2(
+    unsigned kp, const std::int8_t *w, const std::int8_t *x) {
+  // |w| * sign(x, w) is calculated as u8 * s8 pairs, the sum of two products
+  // never saturates because magnitudes of values are at most 127.
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i acc = _mm256_setzero_si256();
+  for (unsigned l = 0; l < kp; l += 32) {
+    const __m256i vw = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(w + l));
+    const __m256i vx = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(x + l));
+    const __m256i p16 = _mm256_maddubs_epi16(
+        _mm256_abs_epi8(vw), _mm256_sign_epi8(vx, vw));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(p16, ones));
+  }
+  return ::reduce_epi32(acc);
+}
+
+__attribute__((target("avx2,avx512vl,avx512vnni")))
+std::int32_t kernel_vnni(
+    unsigned kp, const std::int8_t *w, const std::int8_t *x) {
+  // x is biased to unsigned values.
+  __m256i acc = _mm256_setzero_si256();
+  for (unsigned l = 0; l < kp; l += 32) {
+    const __m256i vw = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(w + l));
+    const __m256i vx = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(x + l));
+    acc = _mm256_dpbusd_epi32(acc, vx, vw);
+  }
+  return ::reduce_epi32(acc);
+}
+
+#endif  // PRIMITIV_CPU_QGEMM_X86
+
+const KernelInfo KERNEL_GENERIC { "generic", false, ::kernel_generic };
+
+#ifdef PRIMITIV_CPU_QGEMM_X86
+const KernelInfo KERNEL_AVX2 { "avx2", false, ::kernel_avx2 };
+const KernelInfo KERNEL_VNNI { "vnni", true, ::kernel_vnni };
+#endif  // PRIMITIV_CPU_QGEMM_X86
+
+bool kernel_supported(primitiv::cpu::QGemmKernelType type) {
+  using namespace primitiv::cpu;
+  switch (type) {
+    case QGEMM_KERNEL_AUTO:
+    case QGEMM_KERNEL_GENERIC:
+      return true;
+#ifdef PRIMITIV_CPU_QGEMM_X86
+    case QGEMM_KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2");
+    case QGEMM_KERNEL_VNNI:
+      return __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512vnni");
+#endif  // PRIMITIV_CPU_QGEMM_X86
+    default:
+      return false;
+  }
+}
+
+const KernelInfo &select_kernel(primitiv::cpu::QGemmKernelType type) {
+  using namespace primitiv::cpu;
+#ifdef PRIMITIV_CPU_QGEMM_X86
+  static const KernelInfo &best =
+    ::kernel_supported(QGEMM_KERNEL_VNNI) ? KERNEL_VNNI :
+    ::kernel_supported(QGEMM_KERNEL_AVX2) ? KERNEL_AVX2 :
+    KERNEL_GENERIC;
+  if (!::kernel_supported(type)) return KERNEL_GENERIC;
+  switch (type) {
+    case QGEMM_KERNEL_AUTO: return best;
+    case QGEMM_KERNEL_AVX2: return KERNEL_AVX2;
+    case QGEMM_KERNEL_VNNI: return KERNEL_VNNI;
+    default: return KERNEL_GENERIC;
+  }
+#else
+  static_cast<void>(type);
+  return KERNEL_GENERIC;
+#endif  // PRIMITIV_CPU_QGEMM_X86
+}
+
+// Quantizes n values with the stride and returns the scale.
+// Elements in [n, kp) of dest are set to 0.
+float quantize_vector(
+    unsigned n, unsigned kp, const float *src, unsigned stride,
+    std::int8_t *dest) {
+  float amax = 0;
+  for (unsigned l = 0; l < n; ++l) {
+    amax = std::max(amax, std::abs(src[l * stride]));
+  }
+  const float scale = amax > 0 ? amax / ::QGEMM_MAX_VALUE : 1;
+  const float inv_scale = 1 / scale;
+  for (unsigned l = 0; l < n; ++l) {
+    const float q = std::round(src[l * stride] * inv_scale);
+    dest[l] = static_cast<std::int8_t>(
+        std::min(::QGEMM_MAX_VALUE, std::max(-::QGEMM_MAX_VALUE, q)));
+  }
+  std::fill(dest + n, dest + kp, 0);
+  return scale;
+}
+
+}  // namespace
+
+namespace primitiv {
+namespace cpu {
+
+bool qgemm_kernel_supported(QGemmKernelType type) {
+  return ::kernel_supported(type);
+}
+
+const char *qgemm_kernel_name(QGemmKernelType type) {
+  return ::select_kernel(type).name;
+}
+
+unsigned qgemm_padded_depth(unsigned k) {
+  return (k + ::QGEMM_DEPTH_ALIGNMENT - 1)
+    / ::QGEMM_DEPTH_ALIGNMENT * ::QGEMM_DEPTH_ALIGNMENT;
+}
+
+void quantize_rows(
+    unsigned m, unsigned k, const float *w, unsigned ldw,
+    std::int8_t *dest, float *scales, std::int32_t *sums) {
+  const unsigned kp = qgemm_padded_depth(k);
+  for (unsigned i = 0; i < m; ++i) {
+    std::int8_t *row = dest + i * kp;
+    scales[i] = ::quantize_vector(k, kp, w + i, ldw, row);
+    std::int32_t sum = 0;
+    for (unsigned l = 0; l < k; ++l) sum += row[l];
+    sums[i] = sum;
+  }
+}
+
+void qgemm(
+    unsigned m, unsigned n, unsigned k,
+    const std::int8_t *w, const float *w_scales, const std::int32_t *w_sums,
+    const float *x, unsigned ldx, float *c, unsigned ldc,
+    QGemmKernelType type) {
+  if (m == 0 || n == 0) return;
+  const ::KernelInfo &ki = ::select_kernel(type);
+  const unsigned kp = qgemm_padded_depth(k);
+
+  // NOTE: Buffers are kept for each thread to avoid allocations on every call.
+  thread_local std::vector<std::int8_t> buf_x;
+  thread_local std::vector<float> x_scales;
+  buf_x.resize(std::max<std::size_t>(buf_x.size(), n * kp));
+  x_scales.resize(std::max<std::size_t>(x_scales.size(), n));
+  for (unsigned j = 0; j < n; ++j) {
+    std::int8_t *xq = buf_x.data() + j * kp;
+    x_scales[j] = ::quantize_vector(k, kp, x + j * ldx, 1, xq);
+    if (ki.unsigned_x) {
+      // Biases values by 128 to use them as unsigned integers.
+      for (unsigned l = 0; l < kp; ++l) xq[l] ^= 0x80;
+    }
+  }
+
+  for (unsigned i0 = 0; i0 < m; i0 += ::QGEMM_ROW_BLOCK) {
+    const unsigned i1 = std::min(m, i0 + ::QGEMM_ROW_BLOCK);
+    for (unsigned j = 0; j < n; ++j) {
+      const std::int8_t *xq = buf_x.data() + j * kp;
+      float *cj = c + j * ldc;
+      for (unsigned i = i0; i < i1; ++i) {
+        std::int32_t acc = ki.fn(kp, w + i * kp, xq);
+        if (ki.unsigned_x) acc -= 128 * w_sums[i];
+        cj[i] = w_scales[i] * x_scales[j] * acc;
+      }
+    }
+  }
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,88 @@
+#ifndef PRIMITIV_CPU_QGEMM_H_
+#define PRIMITIV_CPU_QGEMM_H_
+
+#include <cstdint>
+
+namespace primitiv {
+namespace cpu {
+
+/**
+ * Kernels of the quantized matrix multiplication.
+ */
+enum QGemmKernelType {
+  QGEMM_KERNEL_AUTO,
+  QGEMM_KERNEL_GENERIC,
+  QGEMM_KERNEL_AVX2,
+  QGEMM_KERNEL_VNNI,
+};
+
+/**
+ * Checks whether the kernel is available on the running CPU.
+ * @param type Kernel type.
+ * @return true if the kernel can be used, false otherwise.
+ */
+bool qgemm_kernel_supported(QGemmKernelType type);
+
+/**
+ * Retrieves the name of the kernel.
+ * @param type Kernel type. `QGEMM_KERNEL_AUTO` resolves the kernel which is
+ *             selected at runtime.
+ * @return Name of the kernel.
+ */
+const char *qgemm_kernel_name(QGemmKernelType type);
+
+/**
+ * Retrieves the number of int8 elements stored for each row of a quantized
+ * matrix.
+ * @param k Number of columns of the original matrix.
+ * @return `k` rounded up to the multiple of the SIMD width.
+ */
+unsigned qgemm_padded_depth(unsigned k);
+
+/**
+ * Quantizes each row of a matrix to int8 with its own scale:
+ *   W[i, l] ~= scales[i] * dest[i * qgemm_padded_depth(k) + l].
+ * @param m Number of rows of W.
+ * @param k Number of columns of W.
+ * @param w Pointer to W stored in the column-major order.
+ * @param ldw Leading dimension of W.
+ * @param dest Resulting int8 values stored row by row. Padded elements are
+ *             set to 0. This array should have `m * qgemm_padded_depth(k)`
+ *             elements.
+ * @param scales Resulting scales of rows. This array should have `m`
+ *               elements.
+ * @param sums Resulting sums of int8 values of each row, which are used by
+ *             some kernels. This array should have `m` elements.
+ */
+void quantize_rows(
+    unsigned m, unsigned k, const float *w, unsigned ldw,
+    std::int8_t *dest, float *scales, std::int32_t *sums);
+
+/**
+ * Calculates the product of a quantized matrix and a float matrix:
+ *   C := W . X,
+ * where W is an m-by-k matrix made by `quantize_rows()`, X is a k-by-n matrix
+ * and C is an m-by-n matrix. Each column of X is quantized to int8 with its
+ * own scale on the fly, and products are accumulated in int32.
+ * @param m Number of rows of W and C.
+ * @param n Number of columns of X and C.
+ * @param k Number of columns of W and rows of X.
+ * @param w Quantized values of W.
+ * @param w_scales Scales of rows of W.
+ * @param w_sums Sums of quantized values of rows of W.
+ * @param x Pointer to X stored in the column-major order.
+ * @param ldx Leading dimension of X.
+ * @param c Pointer to C stored in the column-major order.
+ * @param ldc Leading dimension of C.
+ * @param type Kernel to use. Unsupported kernels fall back to the generic one.
+ */
+void qgemm(
+    unsigned m, unsigned n, unsigned k,
+    const std::int8_t *w, const float *w_scales, const std::int32_t *w_sums,
+    const float *x, unsigned ldx, float *c, unsigned ldc,
+    QGemmKernelType type = QGEMM_KERNEL_AUTO);
+
+}  // namespace cpu
+}  // namespace primitiv
+
+#endif  // PRIMITIV_CPU_QGEMM_H_
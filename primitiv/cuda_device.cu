@@ -1,16 +1,24 @@
 #include <config.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cublas_v2.h>
 #include <cuda_runtime_api.h>
 #include <curand.h>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <random>
+#include <tuple>
+#include <unordered_set>
 #include <primitiv/cuda_device.h>
 #include <primitiv/cuda_utils.h>
+#include <primitiv/elementwise_ops.h>
 #include <primitiv/error.h>
 
 using std::cerr;
 using std::endl;
+namespace E = primitiv::elementwise;
 
 namespace {
 
@@ -47,17 +55,21 @@ __global__ void pick_fw_dev(
   if (t < sy) py[oy + t] = px[ox + (t / wy) * wx + (t % wy)];
 }
 
-__global__ void slice_fw_dev(
-    const float *px, unsigned span, unsigned skip, unsigned size, float *py) {
+__global__ void gather_fw_dev(
+    const float *px, const unsigned *pi,
+    unsigned wy, unsigned nx, unsigned ny, unsigned size, float *py) {
   const unsigned i = IDX;
-  if (i < size) py[i] = px[(i / span) * skip + (i % span)];
+  if (i < size) {
+    const unsigned j = (i / wy) % ny;
+    const unsigned r = i / (wy * ny);
+    py[i] = px[(r * nx + pi[j]) * wy + i % wy];
+  }
 }
 
-__global__ void concat_fw_dev(
-    const float *px, unsigned span, unsigned skip, unsigned x_size,
-    unsigned y_size, float *py) {
+__global__ void slice_fw_dev(
+    const float *px, unsigned span, unsigned skip, unsigned size, float *py) {
   const unsigned i = IDX;
-  if (i < y_size) py[(i / span) * skip + (i % span)] = px[i % x_size];
+  if (i < size) py[i] = px[(i / span) * skip + (i % span)];
 }
 
 __global__ void pick_bw_dev(
@@ -70,6 +82,27 @@ __global__ void pick_bw_dev(
   if (t < sy) ::atomicAdd(pgx + ox + (t / wy) * wx + (t % wy), pgy[oy + t]);
 }
 
+__global__ void pick_assign_dev(
+    const float *py, const unsigned *pi,
+    unsigned wx, unsigned wy, unsigned sx, unsigned si, unsigned sy,
+    float *px) {
+  const unsigned t = IDX;
+  const unsigned ox = blockIdx.y * sx + pi[blockIdx.y * si] * wy;
+  const unsigned oy = blockIdx.y * sy;
+  if (t < sy) px[ox + (t / wy) * wx + (t % wy)] = py[oy + t];
+}
+
+__global__ void gather_bw_dev(
+    const float *pgy, const unsigned *pi,
+    unsigned wy, unsigned nx, unsigned ny, unsigned size, float *pgx) {
+  const unsigned i = IDX;
+  if (i < size) {
+    const unsigned j = (i / wy) % ny;
+    const unsigned r = i / (wy * ny);
+    ::atomicAdd(pgx + (r * nx + pi[j]) * wy + i % wy, pgy[i]);
+  }
+}
+
 __global__ void slice_bw_dev(
     const float *pgy, unsigned wx, unsigned wy, unsigned nx, unsigned ny,
     float *pgx) {
@@ -80,178 +113,55 @@ __global__ void slice_bw_dev(
   }
 }
 
-#define CUDADEV_KERNEL_FW_X(name, op) \
-__global__ void name##_fw_dev(const float *px, unsigned size, float *py) { \
-  const unsigned i = IDX; \
-  if (i < size) py[i] = (op); \
-}
-
-#define CUDADEV_KERNEL_BW_X(name, op) \
-__global__ void name##_bw_dev( \
-    const float *px, const float *py, const float *pgy, unsigned size, \
-    float *pgx) { \
-  static_cast<void>(px); \
-  static_cast<void>(py); \
-  const unsigned i = IDX; \
-  if (i < size) pgx[i] += (op); \
-}
-
-#define CUDADEV_KERNEL_FW_X_CONST(name, op) \
-__global__ void name##_fw_dev( \
-    const float *px, float k, unsigned size, float *py) { \
-  const unsigned i = IDX; \
-  if (i < size) py[i] = (op); \
-}
-
-#define CUDADEV_KERNEL_BW_X_CONST(name, op) \
-__global__ void name##_bw_dev( \
-    const float *px, const float *py, const float *pgy, float k, \
-    unsigned size, float *pgx) { \
-  static_cast<void>(px); \
-  static_cast<void>(py); \
-  const unsigned i = IDX; \
-  if (i < size) pgx[i] += (op); \
-}
-
-#define CUDADEV_KERNEL_FW_X_SCALAR_R(name, op) \
-__global__ void name##_fw_dev( \
-    const float *px, const float *pk, unsigned size, unsigned mbx, \
-    unsigned mbk, float *py) { \
-  const unsigned i = IDX; \
-  const unsigned shift = blockIdx.y * size; \
-  if (i < size) py[i + shift] = op(px[i + mbx * shift], pk[mbk * blockIdx.y]); \
-}
-
-#define CUDADEV_KERNEL_FW_X_SCALAR_L(name, op) \
-__global__ void name##_fw_dev( \
-    const float *px, const float *pk, unsigned size, unsigned mbx, \
-    unsigned mbk, float *py) { \
-  const unsigned i = IDX; \
-  const unsigned shift = blockIdx.y * size; \
-  if (i < size) py[i + shift] = op(pk[mbk * blockIdx.y], px[i + mbx * shift]); \
-}
-
-#define CUDADEV_KERNEL_FW_AB(name, op) \
-__global__ void name##_fw_dev( \
-    const float *pa, const float *pb, unsigned size, unsigned mba, \
-    unsigned mbb, float *py) { \
-  const unsigned i = IDX; \
-  const unsigned shift = blockIdx.y * size; \
-  if (i < size) py[i + shift] = op(pa[i + mba * shift], pb[i + mbb * shift]); \
-}
-
-CUDADEV_KERNEL_FW_X(negate, -px[i]);
-CUDADEV_KERNEL_FW_X(sqrt, ::__fsqrt_rn(px[i]));
-CUDADEV_KERNEL_FW_X(exp, ::expf(px[i]));
-CUDADEV_KERNEL_FW_X(tanh, ::tanhf(px[i]));
-CUDADEV_KERNEL_FW_X(sigmoid, .5f + .5f * ::tanhf(.5f * px[i]));
-CUDADEV_KERNEL_FW_X(
-    softplus, ::fmaxf(px[i], .0f) + ::logf(1.f + ::expf(-::fabs(px[i]))));
-CUDADEV_KERNEL_FW_X(sin, ::sinf(px[i]));
-CUDADEV_KERNEL_FW_X(cos, ::cosf(px[i]));
-CUDADEV_KERNEL_FW_X(tan, ::tanf(px[i]));
-
-CUDADEV_KERNEL_BW_X(sqrt, .5f * pgy[i] / py[i]);
-CUDADEV_KERNEL_BW_X(exp, py[i] * pgy[i]);
-CUDADEV_KERNEL_BW_X(tanh, (1.f - py[i] * py[i]) * pgy[i]);
-CUDADEV_KERNEL_BW_X(sigmoid, py[i] * (1.f - py[i]) * pgy[i]);
-CUDADEV_KERNEL_BW_X(softplus, (.5f + .5f * ::tanhf(.5f * px[i])) * pgy[i]);
-CUDADEV_KERNEL_BW_X(sin, ::cosf(px[i]) * pgy[i]);
-CUDADEV_KERNEL_BW_X(cos, -::sinf(px[i]) * pgy[i]);
-CUDADEV_KERNEL_BW_X(tan, (1.f + py[i] * py[i]) * pgy[i]);
-
-CUDADEV_KERNEL_FW_X_CONST(add_const, px[i] + k);
-CUDADEV_KERNEL_FW_X_CONST(subtract_const_r, px[i] - k);
-CUDADEV_KERNEL_FW_X_CONST(subtract_const_l, k - px[i]);
-CUDADEV_KERNEL_FW_X_CONST(multiply_const, px[i] * k);
-CUDADEV_KERNEL_FW_X_CONST(divide_const_r, px[i] / k);
-CUDADEV_KERNEL_FW_X_CONST(divide_const_l, k / px[i]);
-CUDADEV_KERNEL_FW_X_CONST(prelu, ::fmaxf(px[i], .0f) + k * ::fminf(px[i], .0f));
-CUDADEV_KERNEL_FW_X_CONST(
-    elu, ::fmaxf(px[i], .0f) + k * (::expf(::fminf(px[i], .0f)) - 1.0f));
-
-CUDADEV_KERNEL_BW_X_CONST(add_const, pgy[i]);
-CUDADEV_KERNEL_BW_X_CONST(subtract_const_r, pgy[i]);
-CUDADEV_KERNEL_BW_X_CONST(subtract_const_l, -pgy[i]);
-CUDADEV_KERNEL_BW_X_CONST(multiply_const, k * pgy[i]);
-CUDADEV_KERNEL_BW_X_CONST(divide_const_r, pgy[i] / k);
-CUDADEV_KERNEL_BW_X_CONST(divide_const_l, -py[i] * pgy[i] / px[i]);
-CUDADEV_KERNEL_BW_X_CONST(prelu, pgy[i] * ((px[i] > .0f) + k * (px[i] <= .0f)));
-CUDADEV_KERNEL_BW_X_CONST(
-    elu, pgy[i] * ((px[i] > .0f) + (py[i] + k) * (px[i] <= .0f)));
-
-CUDADEV_KERNEL_FW_X_SCALAR_R(add_scalar, ::__fadd_rn);
-CUDADEV_KERNEL_FW_X_SCALAR_R(subtract_scalar_r, ::__fsub_rn);
-CUDADEV_KERNEL_FW_X_SCALAR_L(subtract_scalar_l, ::__fsub_rn);
-CUDADEV_KERNEL_FW_X_SCALAR_R(multiply_scalar, ::__fmul_rn);
-CUDADEV_KERNEL_FW_X_SCALAR_R(divide_scalar_r, ::__fdiv_rn);
-CUDADEV_KERNEL_FW_X_SCALAR_L(divide_scalar_l, ::__fdiv_rn);
-
-CUDADEV_KERNEL_FW_AB(add, ::__fadd_rn);
-CUDADEV_KERNEL_FW_AB(subtract, ::__fsub_rn);
-CUDADEV_KERNEL_FW_AB(multiply, ::__fmul_rn);
-CUDADEV_KERNEL_FW_AB(divide, ::__fdiv_rn);
-
-#undef CUDADEV_KERNEL_FW_X
-#undef CUDADEV_KERNEL_BW_X
-#undef CUDADEV_KERNEL_FW_X_CONST
-#undef CUDADEV_KERNEL_BW_X_CONST
-#undef CUDADEV_KERNEL_FW_X_SCALAR_R
-#undef CUDADEV_KERNEL_FW_X_SCALAR_L
-#undef CUDADEV_KERNEL_FW_AB
-
-__global__ void add_bw_dev(
-    const float *, const float *, const float *, const float *pgy,
-    unsigned size, unsigned mba, unsigned mbb, float *pga, float *pgb) {
-  const unsigned i = IDX;
-  const unsigned shift = blockIdx.y * size;
-  if (i < size) {
-    const float gy = pgy[i + shift];
-    ::atomicAdd(pga + i + mba * shift, gy);
-    ::atomicAdd(pgb + i + mbb * shift, gy);
-  }
+// Elementwise kernels applying functors of primitiv/elementwise_ops.h.
+// Each thread processes elements with the stride of the whole grid, and
+// kernels can be launched with any number of blocks.
+#define GRID_STRIDE_LOOP(i, size) \
+  for (unsigned i = IDX; i < (size); i += gridDim.x * blockDim.x)
+
+template<typename Op>
+__global__ void unary_fw_dev(
+    const float *px, float k, unsigned size, float *py) {
+  GRID_STRIDE_LOOP(i, size) py[i] = Op::fw(px[i], k);
 }
 
-__global__ void subtract_bw_dev(
-    const float *, const float *, const float *, const float *pgy,
-    unsigned size, unsigned mba, unsigned mbb, float *pga, float *pgb) {
-  const unsigned i = IDX;
-  const unsigned shift = blockIdx.y * size;
-  if (i < size) {
-    const float gy = pgy[i + shift];
-    ::atomicAdd(pga + i + mba * shift, gy);
-    ::atomicAdd(pgb + i + mbb * shift, -gy);
-  }
+template<typename Op>
+__global__ void unary_bw_dev(
+    const float *px, const float *py, const float *pgy, float k,
+    unsigned size, float *pgx) {
+  GRID_STRIDE_LOOP(i, size) pgx[i] += Op::bw(px[i], py[i], pgy[i], k);
 }
 
-__global__ void multiply_bw_dev(
-    const float *pa, const float *pb, const float *, const float *pgy,
-    unsigned size, unsigned mba, unsigned mbb, float *pga, float *pgb) {
-  const unsigned i = IDX;
-  const unsigned shift = blockIdx.y * size;
-  if (i < size) {
-    const float gy = pgy[i + shift];
-    const unsigned a_ofs = i + mba * shift;
-    const unsigned b_ofs = i + mbb * shift;
-    ::atomicAdd(pga + a_ofs, gy * pb[b_ofs]);
-    ::atomicAdd(pgb + b_ofs, gy * pa[a_ofs]);
-  }
+// EA (EB) is false if each sample of `a` (`b`) is one value broadcasted to all
+// elements, e.g., the scalar of `add_scalar`. skip_a (skip_b) is the offset of
+// the operand between samples, or 0 to broadcast the operand to the minibatch.
+template<typename Op, bool EA, bool EB>
+__global__ void binary_fw_dev(
+    const float *pa, const float *pb, unsigned size, unsigned skip_a,
+    unsigned skip_b, float *py) {
+  pa += blockIdx.y * skip_a;
+  pb += blockIdx.y * skip_b;
+  py += blockIdx.y * size;
+  GRID_STRIDE_LOOP(i, size) py[i] = Op::fw(pa[EA ? i : 0], pb[EB ? i : 0]);
 }
 
-__global__ void divide_bw_dev(
-    const float *, const float *pb, const float *py, const float *pgy,
+template<typename Op>
+__global__ void binary_bw_dev(
+    const float *pa, const float *pb, const float *py, const float *pgy,
     unsigned size, unsigned mba, unsigned mbb, float *pga, float *pgb) {
-  const unsigned i = IDX;
   const unsigned shift = blockIdx.y * size;
-  if (i < size) {
+  GRID_STRIDE_LOOP(i, size) {
+    const unsigned a_ofs = i + mba * shift;
     const unsigned b_ofs = i + mbb * shift;
-    const unsigned y_ofs = i + shift;
-    const float k = pgy[y_ofs] / pb[b_ofs];
-    ::atomicAdd(pga + i + mba * shift, k);
-    ::atomicAdd(pgb + b_ofs, -k * py[y_ofs]);
+    float ga, gb;
+    Op::bw(pa[a_ofs], pb[b_ofs], py[i + shift], pgy[i + shift], ga, gb);
+    ::atomicAdd(pga + a_ofs, ga);
+    ::atomicAdd(pgb + b_ofs, gb);
   }
 }
 
+#undef GRID_STRIDE_LOOP
+
 __global__ void transpose_fw_dev(
     const float *px, unsigned rows, unsigned cols, float *py) {
   const unsigned i = IDX;
@@ -268,13 +178,12 @@ __global__ void transpose_bw_dev(
   if (i < rows && j < cols) px[ofs + i + j * rows] += py[ofs + j + i * cols];
 }
 
+// Calculates sum(x) of a row by one block. Only the thread 0 receives the
+// result. px should point the first element of the row.
 template<unsigned BLOCK_SIZE>
-__global__ void sum_fw_dev(
-    const float *px, unsigned skip, unsigned n, float *py) {
-  __shared__ float temp[BLOCK_SIZE];
-  const unsigned bid = blockIdx.x;
+__device__ float sum_row_dev(
+    const float *px, unsigned skip, unsigned n, float *temp) {
   const unsigned tid = threadIdx.x;
-  px += bid % skip + (bid / skip) * skip * n;
   temp[tid] = 0;
   for (unsigned i = tid; i < n; i += BLOCK_SIZE) temp[tid] += px[i * skip];
   __syncthreads();
@@ -294,46 +203,227 @@ __global__ void sum_fw_dev(
   REDUCE(2)
   REDUCE(1)
 #undef REDUCE
-  if (tid == 0) py[bid] = temp[0];
-}
-
-__device__ float logsumexp2_fw_dev(float a, float b) {
-  return a > b
-    ? a + ::log(1.f + ::exp(b - a))
-    : b + ::log(1.f + ::exp(a - b));
+  return temp[0];
 }
 
 template<unsigned BLOCK_SIZE>
-__global__ void logsumexp_fw_dev(
+__global__ void sum_fw_dev(
     const float *px, unsigned skip, unsigned n, float *py) {
   __shared__ float temp[BLOCK_SIZE];
   const unsigned bid = blockIdx.x;
-  const unsigned tid = threadIdx.x;
   px += bid % skip + (bid / skip) * skip * n;
+  const float sum = ::sum_row_dev<BLOCK_SIZE>(px, skip, n, temp);
+  if (threadIdx.x == 0) py[bid] = sum;
+}
+
+// Calculates max(x) and sum(exp(x - max(x))) of a row by one block.
+// px should point the first element of the row.
+template<unsigned BLOCK_SIZE>
+__device__ void softmax_stats_dev(
+    const float *px, unsigned skip, unsigned n, float *temp,
+    float &max, float &sum) {
+  const unsigned tid = threadIdx.x;
   temp[tid] = -1e38;  // NOTE(odashi): Near the minimum of the float.
   for (unsigned i = tid; i < n; i += BLOCK_SIZE) {
-    temp[tid] = ::logsumexp2_fw_dev(temp[tid], px[i * skip]);
+    temp[tid] = ::fmaxf(temp[tid], px[i * skip]);
   }
   __syncthreads();
-#define REDUCE(k) \
+#define REDUCE(k, op) \
   if (BLOCK_SIZE >= k << 1) { \
-    if (tid < k) temp[tid] = ::logsumexp2_fw_dev(temp[tid], temp[tid + k]); \
+    if (tid < k) temp[tid] = op(temp[tid], temp[tid + k]); \
     __syncthreads(); \
   }
-  REDUCE(512)
-  REDUCE(256)
-  REDUCE(128)
-  REDUCE(64)
-  REDUCE(32)
-  REDUCE(16)
-  REDUCE(8)
-  REDUCE(4)
-  REDUCE(2)
-  REDUCE(1)
+#define REDUCE_ALL(op) \
+  REDUCE(512, op) REDUCE(256, op) REDUCE(128, op) REDUCE(64, op) \
+  REDUCE(32, op) REDUCE(16, op) REDUCE(8, op) REDUCE(4, op) \
+  REDUCE(2, op) REDUCE(1, op)
+#define MAX_OP(a, b) ::fmaxf(a, b)
+#define ADD_OP(a, b) ((a) + (b))
+  REDUCE_ALL(MAX_OP)
+  max = temp[0];
+  __syncthreads();
+  temp[tid] = 0;
+  for (unsigned i = tid; i < n; i += BLOCK_SIZE) {
+    temp[tid] += ::exp(px[i * skip] - max);
+  }
+  __syncthreads();
+  REDUCE_ALL(ADD_OP)
+#undef ADD_OP
+#undef MAX_OP
+#undef REDUCE_ALL
 #undef REDUCE
-  if (tid == 0) py[bid] = temp[0];
+  sum = temp[0];
+}
+
+template<unsigned BLOCK_SIZE>
+__global__ void logsumexp_fw_dev(
+    const float *px, unsigned skip, unsigned n, float *py) {
+  __shared__ float temp[BLOCK_SIZE];
+  const unsigned bid = blockIdx.x;
+  px += bid % skip + (bid / skip) * skip * n;
+  float max, sum;
+  ::softmax_stats_dev<BLOCK_SIZE>(px, skip, n, temp, max, sum);
+  if (threadIdx.x == 0) py[bid] = max + ::log(sum);
 }
 
+template<unsigned BLOCK_SIZE>
+__global__ void softmax_fw_dev(
+    const float *px, unsigned skip, unsigned n, float *py) {
+  __shared__ float temp[BLOCK_SIZE];
+  const unsigned bid = blockIdx.x;
+  const unsigned offset = bid % skip + (bid / skip) * skip * n;
+  px += offset;
+  py += offset;
+  float max, sum;
+  ::softmax_stats_dev<BLOCK_SIZE>(px, skip, n, temp, max, sum);
+  const float inv = 1.f / sum;
+  for (unsigned i = threadIdx.x; i < n; i += BLOCK_SIZE) {
+    py[i * skip] = ::exp(px[i * skip] - max) * inv;
+  }
+}
+
+template<unsigned BLOCK_SIZE>
+__global__ void log_softmax_fw_dev(
+    const float *px, unsigned skip, unsigned n, float *py) {
+  __shared__ float temp[BLOCK_SIZE];
+  const unsigned bid = blockIdx.x;
+  const unsigned offset = bid % skip + (bid / skip) * skip * n;
+  px += offset;
+  py += offset;
+  float max, sum;
+  ::softmax_stats_dev<BLOCK_SIZE>(px, skip, n, temp, max, sum);
+  const float lse = max + ::log(sum);
+  for (unsigned i = threadIdx.x; i < n; i += BLOCK_SIZE) {
+    py[i * skip] = px[i * skip] - lse;
+  }
+}
+
+// Each block of split reductions processes `chunk` elements of the row
+// `blockIdx.x` from the index `blockIdx.y * chunk`.
+#define SPLIT_RANGE(px, skip, n, chunk, len) \
+  const unsigned begin = blockIdx.y * (chunk); \
+  const unsigned len = ::min((chunk), (n) - begin); \
+  px += blockIdx.x % (skip) + (blockIdx.x / (skip)) * (skip) * (n) + \
+    begin * (skip)
+
+// Writes the partial sum of each chunk to pp[row * splits + split].
+template<unsigned BLOCK_SIZE>
+__global__ void sum_split_fw_dev(
+    const float *px, unsigned skip, unsigned n, unsigned chunk, float *pp) {
+  __shared__ float temp[BLOCK_SIZE];
+  SPLIT_RANGE(px, skip, n, chunk, len);
+  const float sum = ::sum_row_dev<BLOCK_SIZE>(px, skip, len, temp);
+  if (threadIdx.x == 0) pp[blockIdx.x * gridDim.y + blockIdx.y] = sum;
+}
+
+// Writes max(x) and sum(exp(x - max(x))) of each chunk in the same order as
+// sum_split_fw_dev.
+template<unsigned BLOCK_SIZE>
+__global__ void logsumexp_split_fw_dev(
+    const float *px, unsigned skip, unsigned n, unsigned chunk,
+    float *pm, float *ps) {
+  __shared__ float temp[BLOCK_SIZE];
+  SPLIT_RANGE(px, skip, n, chunk, len);
+  float max, sum;
+  ::softmax_stats_dev<BLOCK_SIZE>(px, skip, len, temp, max, sum);
+  if (threadIdx.x == 0) {
+    const unsigned i = blockIdx.x * gridDim.y + blockIdx.y;
+    pm[i] = max;
+    ps[i] = sum;
+  }
+}
+
+#undef SPLIT_RANGE
+
+__global__ void sum_merge_dev(
+    const float *pp, unsigned splits, unsigned rows, float *py) {
+  const unsigned i = IDX;
+  if (i < rows) {
+    pp += i * splits;
+    float sum = 0;
+    for (unsigned k = 0; k < splits; ++k) sum += pp[k];
+    py[i] = sum;
+  }
+}
+
+__global__ void logsumexp_merge_dev(
+    const float *pm, const float *ps, unsigned splits, unsigned rows,
+    float *py) {
+  const unsigned i = IDX;
+  if (i < rows) {
+    pm += i * splits;
+    ps += i * splits;
+    float max = -1e38;
+    for (unsigned k = 0; k < splits; ++k) max = ::fmaxf(max, pm[k]);
+    float sum = 0;
+    for (unsigned k = 0; k < splits; ++k) sum += ps[k] * ::exp(pm[k] - max);
+    py[i] = max + ::log(sum);
+  }
+}
+
+// Number of threads in a warp.
+static const unsigned WARP_SIZE = 32;
+
+// Number of warps in a block of warp-level reductions.
+static const unsigned WARPS_PER_BLOCK = 8;
+
+#if CUDART_VERSION >= 9000
+#define SHFL_XOR(v, k) __shfl_xor_sync(0xffffffff, (v), (k))
+#else
+#define SHFL_XOR(v, k) __shfl_xor((v), (k))
+#endif  // CUDART_VERSION
+
+// Reductions over all lanes of the warp. All lanes receive the result.
+__device__ float warp_sum_dev(float v) {
+  for (unsigned k = ::WARP_SIZE >> 1; k > 0; k >>= 1) v += SHFL_XOR(v, k);
+  return v;
+}
+
+__device__ float warp_max_dev(float v) {
+  for (unsigned k = ::WARP_SIZE >> 1; k > 0; k >>= 1) {
+    v = ::fmaxf(v, SHFL_XOR(v, k));
+  }
+  return v;
+}
+
+#undef SHFL_XOR
+
+// Each warp of warp-level reductions processes one row. Whole warps exit
+// together so that shuffles are always done by all lanes.
+#define WARP_ROW(px, skip, n, rows, row, lane) \
+  const unsigned row = blockIdx.x * ::WARPS_PER_BLOCK + threadIdx.x / \
+    ::WARP_SIZE; \
+  const unsigned lane = threadIdx.x % ::WARP_SIZE; \
+  if (row >= (rows)) return; \
+  px += row % (skip) + (row / (skip)) * (skip) * (n)
+
+__global__ void sum_warp_fw_dev(
+    const float *px, unsigned skip, unsigned n, unsigned rows, float *py) {
+  WARP_ROW(px, skip, n, rows, row, lane);
+  float sum = 0;
+  for (unsigned i = lane; i < n; i += ::WARP_SIZE) sum += px[i * skip];
+  sum = ::warp_sum_dev(sum);
+  if (lane == 0) py[row] = sum;
+}
+
+__global__ void logsumexp_warp_fw_dev(
+    const float *px, unsigned skip, unsigned n, unsigned rows, float *py) {
+  WARP_ROW(px, skip, n, rows, row, lane);
+  float max = -1e38;
+  for (unsigned i = lane; i < n; i += ::WARP_SIZE) {
+    max = ::fmaxf(max, px[i * skip]);
+  }
+  max = ::warp_max_dev(max);
+  float sum = 0;
+  for (unsigned i = lane; i < n; i += ::WARP_SIZE) {
+    sum += ::exp(px[i * skip] - max);
+  }
+  sum = ::warp_sum_dev(sum);
+  if (lane == 0) py[row] = max + ::log(sum);
+}
+
+#undef WARP_ROW
+
 __global__ void broadcast_fw_dev(
     const float *px, unsigned skip1, unsigned skip2, unsigned size, float *py) {
   const unsigned i = IDX;
@@ -353,6 +443,359 @@ __global__ void batch_sum_fw_dev(
   }
 }
 
+__global__ void batch_moments_fw_dev(
+    const float *px, unsigned size, unsigned batch, float *pm, float *pv) {
+  const unsigned i = IDX;
+  if (i < size) {
+    float m = .0f, m2 = .0f;
+    px += i;
+    for (unsigned j = 0; j < batch; ++j, px += size) {
+      const float d = *px - m;
+      m += d / (j + 1);
+      m2 += d * (*px - m);
+    }
+    pm[i] = m;
+    pv[i] = m2 / (batch - 1);
+  }
+}
+
+__global__ void batch_normalize_fw_dev(
+    const float *px, const float *pm, const float *pv, float eps,
+    unsigned size, unsigned total, float *py) {
+  const unsigned i = IDX;
+  if (i < total) {
+    const unsigned j = i % size;
+    py[i] = (px[i] - pm[j]) * ::rsqrtf(pv[j] + eps);
+  }
+}
+
+__global__ void affine_bias_dev(
+    const float *pb, unsigned rows, unsigned size, unsigned mbb, float *py) {
+  const unsigned i = IDX;
+  const unsigned bid_y = blockIdx.y;
+  if (i < size) py[i + bid_y * size] = pb[i % rows + mbb * bid_y * rows];
+}
+
+__device__ float affine_act_dev(primitiv::Device::Activation act, float x) {
+  switch (act) {
+    case primitiv::Device::ACTIVATION_RELU: return ::fmaxf(x, .0f);
+    case primitiv::Device::ACTIVATION_TANH: return ::tanhf(x);
+    case primitiv::Device::ACTIVATION_SIGMOID:
+      return .5f + .5f * ::tanhf(.5f * x);
+    default: return x;
+  }
+}
+
+__global__ void affine_epilogue_dev(
+    primitiv::Device::Activation act, unsigned size, float *py) {
+  const unsigned i = IDX;
+  if (i < size) py[i] = ::affine_act_dev(act, py[i]);
+}
+
+__global__ void affine_act_bw_dev(
+    const float *py, const float *pgy, primitiv::Device::Activation act,
+    unsigned size, float *pg) {
+  const unsigned i = IDX;
+  if (i < size) {
+    const float y = py[i];
+    switch (act) {
+      case primitiv::Device::ACTIVATION_RELU:
+        pg[i] = (y > .0f) * pgy[i];
+        break;
+      case primitiv::Device::ACTIVATION_TANH:
+        pg[i] = (1.f - y * y) * pgy[i];
+        break;
+      case primitiv::Device::ACTIVATION_SIGMOID:
+        pg[i] = y * (1.f - y) * pgy[i];
+        break;
+      default:
+        pg[i] = pgy[i];
+    }
+  }
+}
+
+__global__ void affine_bias_bw_dev(
+    const float *pg, unsigned rows, unsigned cols, unsigned bs, unsigned mbb,
+    float *pgb) {
+  const unsigned i = IDX;
+  if (i < rows) {
+    float sum = .0f;
+    for (unsigned n = 0; n < bs; ++n) {
+      const float *pgn = pg + i + n * rows * cols;
+      for (unsigned j = 0; j < cols; ++j) sum += pgn[j * rows];
+      if (mbb) {
+        pgb[i + n * rows] += sum;
+        sum = .0f;
+      }
+    }
+    if (!mbb) pgb[i] += sum;
+  }
+}
+
+__device__ float lstm_sigmoid_dev(float x) {
+  return .5f + .5f * ::tanhf(.5f * x);
+}
+
+__global__ void lstm_cell_fw_dev(
+    const float *pu, const float *pc, unsigned n, unsigned size,
+    unsigned mbu, unsigned mbc, float *py) {
+  const unsigned k = IDX;
+  const unsigned bid_y = blockIdx.y;
+  if (k < size) {
+    const unsigned col = k / n;
+    pu += mbu * bid_y * 4 * size + 3 * n * col + k;
+    pc += mbc * bid_y * size + k;
+    py += bid_y * 2 * size + n * col + k;
+    const float i = ::lstm_sigmoid_dev(pu[0]);
+    const float f = ::lstm_sigmoid_dev(pu[n]);
+    const float o = ::lstm_sigmoid_dev(pu[2 * n]);
+    const float j = ::tanhf(pu[3 * n]);
+    const float c = i * j + f * *pc;
+    py[0] = o * ::tanhf(c);
+    py[n] = c;
+  }
+}
+
+__global__ void lstm_cell_bw_dev(
+    const float *pu, const float *pc, const float *py, const float *pgy,
+    unsigned n, unsigned size, unsigned bs, unsigned mbu, unsigned mbc,
+    float *pgu, float *pgc) {
+  // NOTE: Each thread processes all minibatches to accumulate gradients of
+  // broadcasted arguments without atomic operations.
+  const unsigned k = IDX;
+  if (k < size) {
+    const unsigned col = k / n;
+    for (unsigned b = 0; b < bs; ++b) {
+      const unsigned uk = mbu * b * 4 * size + 3 * n * col + k;
+      const unsigned ck = mbc * b * size + k;
+      const unsigned yk = b * 2 * size + n * col + k;
+      const float i = ::lstm_sigmoid_dev(pu[uk]);
+      const float f = ::lstm_sigmoid_dev(pu[uk + n]);
+      const float o = ::lstm_sigmoid_dev(pu[uk + 2 * n]);
+      const float j = ::tanhf(pu[uk + 3 * n]);
+      const float tc = ::tanhf(py[yk + n]);
+      const float gh = pgy[yk];
+      const float gc = pgy[yk + n] + gh * o * (1.f - tc * tc);
+      pgu[uk] += gc * j * i * (1.f - i);
+      pgu[uk + n] += gc * pc[ck] * f * (1.f - f);
+      pgu[uk + 2 * n] += gh * tc * o * (1.f - o);
+      pgu[uk + 3 * n] += gc * i * (1.f - j * j);
+      pgc[ck] += gc * f;
+    }
+  }
+}
+
+// Maximum size of the shared memory used by persistent LSTM kernels.
+// Recurrent weights are kept in the shared memory if they fit in this size,
+// and are read from the global memory (and the cache) otherwise.
+const unsigned LSTM_MAX_SHARED_BYTES = 48 * 1024;
+
+// Arguments of persistent LSTM kernels. Each block processes all steps of
+// one sample `blockIdx.x`.
+struct LSTMArgs {
+  unsigned n;
+  unsigned steps;
+  unsigned xu_skip;
+  unsigned h0_skip;
+  unsigned c0_skip;
+  bool cache_wh;
+  const float *pxu;
+  const float *pwh;
+  const float *ph0;
+  const float *pc0;
+};
+
+// Loads `wh` into the shared memory if enabled, and returns the copy to be
+// used.
+__device__ const float *lstm_load_wh_dev(const LSTMArgs &a, float *sw) {
+  if (!a.cache_wh) return a.pwh;
+  for (unsigned r = threadIdx.x; r < 4 * a.n * a.n; r += blockDim.x) {
+    sw[r] = a.pwh[r];
+  }
+  return sw;
+}
+
+// Calculates su = xu[:, t] + wh . sh by all threads of the block.
+__device__ void lstm_preactivations_dev(
+    const LSTMArgs &a, const float *pxu, const float *pwh, const float *sh,
+    unsigned t, float *su) {
+  const unsigned n4 = 4 * a.n;
+  for (unsigned r = threadIdx.x; r < n4; r += blockDim.x) {
+    float sum = pxu[t * n4 + r];
+    for (unsigned j = 0; j < a.n; ++j) sum += pwh[r + j * n4] * sh[j];
+    su[r] = sum;
+  }
+}
+
+__global__ void lstm_fw_dev(const LSTMArgs a, float *py) {
+  extern __shared__ float smem[];
+  const unsigned n = a.n;
+  const unsigned b = blockIdx.x;
+  float *sh = smem;
+  float *su = sh + n;
+  const float *pwh = ::lstm_load_wh_dev(a, su + 4 * n);
+  const float *pxu = a.pxu + b * a.xu_skip;
+  const float *pc0 = a.pc0 + b * a.c0_skip;
+  py += b * a.steps * 2 * n;
+  for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+    sh[l] = a.ph0[b * a.h0_skip + l];
+  }
+  for (unsigned t = 0; t < a.steps; ++t) {
+    __syncthreads();
+    ::lstm_preactivations_dev(a, pxu, pwh, sh, t, su);
+    __syncthreads();
+    // NOTE(odashi):
+    // Each thread always processes the same elements, and reads only the
+    // cell state written by itself.
+    for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+      const float i = ::lstm_sigmoid_dev(su[l]);
+      const float f = ::lstm_sigmoid_dev(su[l + n]);
+      const float o = ::lstm_sigmoid_dev(su[l + 2 * n]);
+      const float j = ::tanhf(su[l + 3 * n]);
+      const float c_prev = t == 0 ? pc0[l] : py[(t - 1) * 2 * n + n + l];
+      const float c = i * j + f * c_prev;
+      const float h = o * ::tanhf(c);
+      py[t * 2 * n + l] = h;
+      py[t * 2 * n + n + l] = c;
+      sh[l] = h;
+    }
+  }
+}
+
+// Calculates gradients of preactivations of all steps into `pgu` and
+// previous hidden states into `php` with the layout [4n, T] and [n, T] for
+// each sample, and accumulates gradients of `h0` and `c0`.
+__global__ void lstm_bw_dev(
+    const LSTMArgs a, const float *py, const float *pgy,
+    float *pgu, float *php, float *pgh0, float *pgc0) {
+  extern __shared__ float smem[];
+  const unsigned n = a.n;
+  const unsigned n4 = 4 * n;
+  const unsigned b = blockIdx.x;
+  float *sh = smem;
+  float *sgh = sh + n;
+  float *sgc = sgh + n;
+  float *su = sgc + n;
+  float *sgu = su + n4;
+  const float *pwh = ::lstm_load_wh_dev(a, sgu + n4);
+  const float *pxu = a.pxu + b * a.xu_skip;
+  const float *pc0 = a.pc0 + b * a.c0_skip;
+  py += b * a.steps * 2 * n;
+  pgy += b * a.steps * 2 * n;
+  pgu += b * a.steps * n4;
+  php += b * a.steps * n;
+  for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+    sgh[l] = 0;
+    sgc[l] = 0;
+  }
+  for (unsigned t = a.steps; t-- > 0; ) {
+    __syncthreads();
+    for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+      const float h = t == 0
+        ? a.ph0[b * a.h0_skip + l] : py[(t - 1) * 2 * n + l];
+      sh[l] = h;
+      php[t * n + l] = h;
+    }
+    __syncthreads();
+    ::lstm_preactivations_dev(a, pxu, pwh, sh, t, su);
+    __syncthreads();
+    for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+      const float i = ::lstm_sigmoid_dev(su[l]);
+      const float f = ::lstm_sigmoid_dev(su[l + n]);
+      const float o = ::lstm_sigmoid_dev(su[l + 2 * n]);
+      const float j = ::tanhf(su[l + 3 * n]);
+      const float c_prev = t == 0 ? pc0[l] : py[(t - 1) * 2 * n + n + l];
+      const float tc = ::tanhf(py[t * 2 * n + n + l]);
+      const float gh = pgy[t * 2 * n + l] + sgh[l];
+      const float gc =
+        pgy[t * 2 * n + n + l] + sgc[l] + gh * o * (1.f - tc * tc);
+      sgu[l] = gc * j * i * (1.f - i);
+      sgu[l + n] = gc * c_prev * f * (1.f - f);
+      sgu[l + 2 * n] = gh * tc * o * (1.f - o);
+      sgu[l + 3 * n] = gc * i * (1.f - j * j);
+      sgc[l] = gc * f;
+    }
+    __syncthreads();
+    for (unsigned r = threadIdx.x; r < n4; r += blockDim.x) {
+      pgu[t * n4 + r] = sgu[r];
+    }
+    // gh = wh^T . gu
+    for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+      float sum = 0;
+      for (unsigned r = 0; r < n4; ++r) sum += pwh[r + l * n4] * sgu[r];
+      sgh[l] = sum;
+    }
+  }
+  __syncthreads();
+  for (unsigned l = threadIdx.x; l < n; l += blockDim.x) {
+    ::atomicAdd(pgh0 + b * a.h0_skip + l, sgh[l]);
+    ::atomicAdd(pgc0 + b * a.c0_skip + l, sgc[l]);
+  }
+}
+
+// Arguments of elementwise_fw_dev() which are passed by value.
+struct ElementwiseArgs {
+  unsigned num_insts;
+  primitiv::ElementwiseProgram::Instruction insts[
+    primitiv::ElementwiseProgram::MAX_INSTRUCTIONS];
+  const float *px[primitiv::ElementwiseProgram::MAX_INSTRUCTIONS];
+  unsigned mbx[primitiv::ElementwiseProgram::MAX_INSTRUCTIONS];
+};
+
+__global__ void elementwise_fw_dev(
+    const ElementwiseArgs args, unsigned size, float *py) {
+  typedef primitiv::ElementwiseProgram P;
+  const unsigned i = IDX;
+  const unsigned shift = blockIdx.y * size;
+  if (i < size) {
+    float regs[P::MAX_INSTRUCTIONS];
+    for (unsigned j = 0; j < args.num_insts; ++j) {
+      const P::Instruction &inst = args.insts[j];
+      const float k = inst.k;
+#define A regs[inst.a]
+#define B regs[inst.b]
+      float r;
+      switch (inst.opcode) {
+        case P::OPCODE_INPUT:
+          r = args.px[inst.a][i + args.mbx[inst.a] * shift];
+          break;
+#define CASE_X(code, op) \
+        case P::OPCODE_##code: r = E::op<float>::fw(A, k); break;
+#define CASE_AB(code, op) \
+        case P::OPCODE_##code: r = E::op<float>::fw(A, B); break;
+        CASE_X(NEGATE, Negate);
+        CASE_X(SQRT, Sqrt);
+        CASE_X(EXP, Exp);
+        CASE_X(TANH, Tanh);
+        CASE_X(SIGMOID, Sigmoid);
+        CASE_X(SOFTPLUS, Softplus);
+        CASE_X(SIN, Sin);
+        CASE_X(COS, Cos);
+        CASE_X(TAN, Tan);
+        CASE_X(ADD_CONST, AddConst);
+        CASE_X(SUBTRACT_CONST_R, SubtractConstR);
+        CASE_X(SUBTRACT_CONST_L, SubtractConstL);
+        CASE_X(MULTIPLY_CONST, MultiplyConst);
+        CASE_X(DIVIDE_CONST_R, DivideConstR);
+        CASE_X(DIVIDE_CONST_L, DivideConstL);
+        CASE_X(PRELU, PReLU);
+        CASE_X(ELU, ELU);
+        CASE_AB(ADD, Add);
+        CASE_AB(SUBTRACT, Subtract);
+        CASE_AB(MULTIPLY, Multiply);
+        CASE_AB(DIVIDE, Divide);
+#undef CASE_X
+#undef CASE_AB
+        default: r = .0f;
+      }
+#undef A
+#undef B
+      regs[j] = r;
+    }
+    py[i + shift] = regs[args.num_insts - 1];
+  }
+}
+
 __global__ void inplace_multiply_const_dev(
     unsigned k, unsigned size, float *px) {
   const unsigned i = IDX;
@@ -373,6 +816,237 @@ __global__ void inplace_subtract_dev(
   if (i < size) ::atomicAdd(py + i + mby * shift, -px[i + mbx * shift]);
 }
 
+__device__ void sgd_update_element(
+    unsigned i, float eta, const float *pg, float *px) {
+  px[i] -= eta * pg[i];
+}
+
+__device__ void momentum_sgd_update_element(
+    unsigned i, float eta, float momentum, const float *pg,
+    float *pm, float *px) {
+  const float mi = momentum * pm[i] - eta * pg[i];
+  pm[i] = mi;
+  px[i] += mi;
+}
+
+__device__ void adam_update_element(
+    unsigned i, float alpha, float beta1, float beta2, float eps,
+    float c1, float c2, const float *pg, float *pm1, float *pm2, float *px) {
+  const float gi = pg[i];
+  const float m1i = beta1 * pm1[i] + (1 - beta1) * gi;
+  const float m2i = beta2 * pm2[i] + (1 - beta2) * gi * gi;
+  pm1[i] = m1i;
+  pm2[i] = m2i;
+  px[i] -= alpha * (m1i / c1) / (::__fsqrt_rn(m2i / c2) + eps);
+}
+
+__global__ void sgd_update_dev(
+    float eta, const float *pg, unsigned size, float *px) {
+  const unsigned i = IDX;
+  if (i < size) ::sgd_update_element(i, eta, pg, px);
+}
+
+__global__ void momentum_sgd_update_dev(
+    float eta, float momentum, const float *pg, unsigned size,
+    float *pm, float *px) {
+  const unsigned i = IDX;
+  if (i < size) ::momentum_sgd_update_element(i, eta, momentum, pg, pm, px);
+}
+
+__global__ void adam_update_dev(
+    float alpha, float beta1, float beta2, float eps, float c1, float c2,
+    const float *pg, unsigned size, float *pm1, float *pm2, float *px) {
+  const unsigned i = IDX;
+  if (i < size) {
+    ::adam_update_element(
+        i, alpha, beta1, beta2, eps, c1, c2, pg, pm1, pm2, px);
+  }
+}
+
+/*
+ * Accessor of the table used by multi-tensor kernels.
+ * The table consists of following arrays:
+ *   float *ptrs[k * n]: `ptrs[j * n + t]` is the `j`-th operand of the `t`-th
+ *                       tensor.
+ *   unsigned sizes[n]: Number of elements of each tensor.
+ *   unsigned blocks[2 * #blocks]: Tensor ID and the first element processed
+ *                                 by each thread block.
+ */
+struct MultiTensorTable {
+  __device__ MultiTensorTable(
+      const void *table, unsigned k, unsigned n, unsigned m = 0)
+    : ptrs(static_cast<float *const *>(table))
+    , sizes(reinterpret_cast<const unsigned *>(ptrs + k * n))
+    , params(sizes + n)
+    , blocks(params + m * n)
+    , n(n) {}
+
+  // Retrieves the tensor ID and the element processed by the current thread.
+  __device__ bool element(unsigned &t, unsigned &i) const {
+    t = blocks[2 * blockIdx.x];
+    i = blocks[2 * blockIdx.x + 1] + threadIdx.x;
+    return i < sizes[t];
+  }
+
+  // Retrieves the `j`-th operand of the `t`-th tensor.
+  __device__ float *operand(unsigned j, unsigned t) const {
+    return ptrs[j * n + t];
+  }
+
+  // Retrieves the `j`-th parameter of the `t`-th tensor.
+  __device__ unsigned param(unsigned j, unsigned t) const {
+    return params[j * n + t];
+  }
+
+  float *const *ptrs;
+  const unsigned *sizes;
+  const unsigned *params;
+  const unsigned *blocks;
+  unsigned n;
+};
+
+// Copies every source of concat_fw by one launch. Operands of each tensor are
+// the source and the first element of its part in the result, and parameters
+// are the number of contiguous elements and the size of the source.
+__global__ void multi_concat_fw_dev(
+    const void *table, unsigned n, unsigned skip) {
+  const ::MultiTensorTable tab(table, 2, n, 2);
+  unsigned t, i;
+  if (tab.element(t, i)) {
+    const unsigned span = tab.param(0, t);
+    tab.operand(1, t)[(i / span) * skip + (i % span)] =
+      tab.operand(0, t)[i % tab.param(1, t)];
+  }
+}
+
+__global__ void multi_sgd_update_dev(float eta, const void *table, unsigned n) {
+  const ::MultiTensorTable tab(table, 2, n);
+  unsigned t, i;
+  if (tab.element(t, i)) {
+    ::sgd_update_element(i, eta, tab.operand(0, t), tab.operand(1, t));
+  }
+}
+
+__global__ void multi_momentum_sgd_update_dev(
+    float eta, float momentum, const void *table, unsigned n) {
+  const ::MultiTensorTable tab(table, 3, n);
+  unsigned t, i;
+  if (tab.element(t, i)) {
+    ::momentum_sgd_update_element(
+        i, eta, momentum,
+        tab.operand(0, t), tab.operand(1, t), tab.operand(2, t));
+  }
+}
+
+__global__ void multi_adam_update_dev(
+    float alpha, float beta1, float beta2, float eps, float c1, float c2,
+    const void *table, unsigned n) {
+  const ::MultiTensorTable tab(table, 4, n);
+  unsigned t, i;
+  if (tab.element(t, i)) {
+    ::adam_update_element(
+        i, alpha, beta1, beta2, eps, c1, c2,
+        tab.operand(0, t), tab.operand(1, t), tab.operand(2, t),
+        tab.operand(3, t));
+  }
+}
+
+// Writes the sum of squares of the elements processed by each block into
+// `pp[blockIdx.x]`. The block size should be a multiple of the warp size.
+__global__ void multi_squared_norm_dev(
+    const void *table, unsigned n, float *pp) {
+  __shared__ float temp[::WARP_SIZE];
+  const ::MultiTensorTable tab(table, 1, n);
+  unsigned t, i;
+  float v = 0;
+  if (tab.element(t, i)) {
+    const float x = tab.operand(0, t)[i];
+    v = x * x;
+  }
+  const unsigned warp = threadIdx.x / ::WARP_SIZE;
+  const unsigned lane = threadIdx.x % ::WARP_SIZE;
+  v = ::warp_sum_dev(v);
+  if (lane == 0) temp[warp] = v;
+  __syncthreads();
+  if (warp == 0) {
+    v = lane < blockDim.x / ::WARP_SIZE ? temp[lane] : 0;
+    v = ::warp_sum_dev(v);
+    if (lane == 0) pp[blockIdx.x] = v;
+  }
+}
+
+// Reads the squared norm from the device memory so that the host need not
+// wait for the reduction.
+__global__ void multi_clip_by_norm_dev(
+    float max_norm, const float *pn, const void *table, unsigned n) {
+  const ::MultiTensorTable tab(table, 1, n);
+  unsigned t, i;
+  if (tab.element(t, i)) {
+    const float norm = ::sqrt(*pn);
+    if (norm > max_norm) tab.operand(0, t)[i] *= max_norm / norm;
+  }
+}
+
+// Number of threads of each block of top_k_dev().
+const unsigned TOP_K_BLOCK_SIZE = 256;
+
+// Whether the element (va, ia) follows (vb, ib) in the order of top_k().
+__device__ bool top_k_follows_dev(
+    float va, unsigned ia, float vb, unsigned ib) {
+  return va < vb || (va == vb && ia > ib);
+}
+
+// Selects the k largest elements of each sample by one block. The j-th
+// iteration finds the largest element which follows the (j-1)-th result, and
+// no temporary memory is required except the shared memory.
+__global__ void top_k_dev(
+    const float *px, unsigned n, unsigned k, unsigned *pi, float *pv) {
+  __shared__ float temp_v[::TOP_K_BLOCK_SIZE];
+  __shared__ unsigned temp_i[::TOP_K_BLOCK_SIZE];
+  const unsigned tid = threadIdx.x;
+  px += blockIdx.x * n;
+  pi += blockIdx.x * k;
+  pv += blockIdx.x * k;
+  // `n` represents no element.
+  float last_v = 0;
+  unsigned last_i = n;
+  for (unsigned j = 0; j < k; ++j) {
+    float best_v = 0;
+    unsigned best_i = n;
+    for (unsigned i = tid; i < n; i += ::TOP_K_BLOCK_SIZE) {
+      const float v = px[i];
+      if ((last_i == n || ::top_k_follows_dev(v, i, last_v, last_i)) &&
+          (best_i == n || ::top_k_follows_dev(best_v, best_i, v, i))) {
+        best_v = v;
+        best_i = i;
+      }
+    }
+    temp_v[tid] = best_v;
+    temp_i[tid] = best_i;
+    __syncthreads();
+    for (unsigned m = ::TOP_K_BLOCK_SIZE >> 1; m > 0; m >>= 1) {
+      if (tid < m) {
+        const float v = temp_v[tid + m];
+        const unsigned i = temp_i[tid + m];
+        if (i != n &&
+            (temp_i[tid] == n ||
+             ::top_k_follows_dev(temp_v[tid], temp_i[tid], v, i))) {
+          temp_v[tid] = v;
+          temp_i[tid] = i;
+        }
+      }
+      __syncthreads();
+    }
+    last_v = temp_v[0];
+    last_i = temp_i[0];
+    if (tid == 0) {
+      pv[j] = last_v;
+      pi[j] = last_i;
+    }
+    __syncthreads();
+  }
+}
+
 #undef IDX
 #undef IDY
 
@@ -380,6 +1054,153 @@ __global__ void inplace_subtract_dev(
 static const int MIN_CC_MAJOR = 3;
 static const int MIN_CC_MINOR = 0;
 
+// Host-to-device copies up to this size are staged in page-locked memory.
+static const std::size_t MAX_STAGING_SIZE = 1 << 24;
+
+// Number of staging buffers used in turn.
+static const unsigned NUM_STAGING_BUFFERS = 2;
+
+/*
+ * Kinds of reduction kernels.
+ */
+enum ReductionStrategy {
+  // One block reduces each row.
+  REDUCTION_BLOCK,
+  // One warp reduces each row, and each block reduces multiple rows.
+  REDUCTION_WARP,
+  // Multiple blocks reduce parts of each row, and the second pass merges them.
+  REDUCTION_SPLIT,
+};
+
+/*
+ * Launch configuration of reductions.
+ */
+struct ReductionConfig {
+  ReductionStrategy strategy;
+  unsigned splits;
+};
+
+// Rows up to this length are reduced by warps.
+static const unsigned MAX_WARP_REDUCTION_SIZE = 256;
+
+// Minimum number of elements of each part in split reductions.
+static const unsigned MIN_SPLIT_REDUCTION_CHUNK = 1024;
+
+// Maximum number of parts of each row in split reductions.
+static const unsigned MAX_REDUCTION_SPLITS = 64;
+
+// Number of launches of each candidate measured by the autotuning.
+static const unsigned NUM_AUTOTUNING_TRIALS = 3;
+
+// Largest power of 2 which is at most `max` and less than 2 * n.
+unsigned reduction_block_size(unsigned n, unsigned max) {
+  unsigned ret = max;
+  while (ret >> 1 >= n) ret >>= 1;
+  return ret;
+}
+
+// Chooses the reduction kernel without measurements.
+// Blocks are underused by short rows, and few rows can not use all
+// multiprocessors without splitting.
+ReductionConfig heuristic_reduction(
+    unsigned n, unsigned rows, unsigned num_sms) {
+  if (n <= ::MAX_WARP_REDUCTION_SIZE) return {::REDUCTION_WARP, 1};
+  if (rows < num_sms && n >= 2 * ::MIN_SPLIT_REDUCTION_CHUNK) {
+    const unsigned splits = std::min(
+        std::min(::MAX_REDUCTION_SPLITS, n / ::MIN_SPLIT_REDUCTION_CHUNK),
+        std::max(2u, 2 * num_sms / rows));
+    return {::REDUCTION_SPLIT, splits};
+  }
+  return {::REDUCTION_BLOCK, 1};
+}
+
+// Candidate kernels measured by the autotuning.
+std::vector<ReductionConfig> reduction_candidates(unsigned n) {
+  std::vector<ReductionConfig> ret {
+    {::REDUCTION_BLOCK, 1}, {::REDUCTION_WARP, 1},
+  };
+  for (unsigned splits = 4; splits <= ::MAX_REDUCTION_SPLITS; splits <<= 2) {
+    if (n >= splits * ::MAX_WARP_REDUCTION_SIZE) {
+      ret.push_back({::REDUCTION_SPLIT, splits});
+    }
+  }
+  return ret;
+}
+
+/*
+ * CUDA stream initializer/finalizer.
+ */
+class CUDAStream {
+private:
+  CUDAStream(const CUDAStream &) = delete;
+  CUDAStream(CUDAStream &&) = delete;
+  CUDAStream &operator=(const CUDAStream &) = delete;
+  CUDAStream &operator=(CUDAStream &&) = delete;
+
+public:
+  explicit CUDAStream(unsigned dev_id) {
+    CUDA_CALL(::cudaSetDevice(dev_id));
+    CUDA_CALL(::cudaStreamCreate(&stream_));
+  }
+
+  ~CUDAStream() {
+    CUDA_CALL(::cudaStreamDestroy(stream_));
+  }
+
+  ::cudaStream_t get() const { return stream_; }
+
+private:
+  ::cudaStream_t stream_;
+};
+
+/*
+ * Page-locked host memory to stage asynchronous host-to-device copies.
+ */
+class CUDAStagingBuffer {
+private:
+  CUDAStagingBuffer(const CUDAStagingBuffer &) = delete;
+  CUDAStagingBuffer(CUDAStagingBuffer &&) = delete;
+  CUDAStagingBuffer &operator=(const CUDAStagingBuffer &) = delete;
+  CUDAStagingBuffer &operator=(CUDAStagingBuffer &&) = delete;
+
+public:
+  explicit CUDAStagingBuffer(unsigned dev_id) : data_(nullptr), capacity_(0) {
+    CUDA_CALL(::cudaSetDevice(dev_id));
+    CUDA_CALL(::cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+  }
+
+  ~CUDAStagingBuffer() {
+    CUDA_CALL(::cudaEventSynchronize(event_));
+    if (data_) CUDA_CALL(::cudaFreeHost(data_));
+    CUDA_CALL(::cudaEventDestroy(event_));
+  }
+
+  // Waits for the last copy from this buffer and returns the memory with at
+  // least `size` bytes.
+  void *acquire(std::size_t size) {
+    CUDA_CALL(::cudaEventSynchronize(event_));
+    if (capacity_ < size) {
+      if (data_) CUDA_CALL(::cudaFreeHost(data_));
+      data_ = nullptr;
+      capacity_ = 0;
+      CUDA_CALL(::cudaHostAlloc(&data_, size, cudaHostAllocDefault));
+      capacity_ = size;
+    }
+    return data_;
+  }
+
+  // Marks that the buffer is used until all preceding operations on `stream`
+  // finish.
+  void release(::cudaStream_t stream) {
+    CUDA_CALL(::cudaEventRecord(event_, stream));
+  }
+
+private:
+  void *data_;
+  std::size_t capacity_;
+  ::cudaEvent_t event_;
+};
+
 /*
  * CUBLAS initializer/finalizer.
  */
@@ -431,11 +1252,69 @@ public:
     //cerr << "CURAND finalized." << endl;
   }
 
-  ::curandGenerator_t get() const { return handle_; }
+  ::curandGenerator_t get() const { return handle_; }
+
+private:
+  ::curandGenerator_t handle_;
+};
+
+#if CUDART_VERSION >= 10010
+/*
+ * Operations captured into a CUDA graph and resources used by them.
+ */
+class CUDAGraphCapture {
+private:
+  CUDAGraphCapture(const CUDAGraphCapture &) = delete;
+  CUDAGraphCapture(CUDAGraphCapture &&) = delete;
+  CUDAGraphCapture &operator=(const CUDAGraphCapture &) = delete;
+  CUDAGraphCapture &operator=(CUDAGraphCapture &&) = delete;
+
+public:
+  CUDAGraphCapture() : graph_(nullptr), exec_(nullptr) {}
+
+  ~CUDAGraphCapture() {
+    if (exec_) CUDA_CALL(::cudaGraphExecDestroy(exec_));
+    if (graph_) CUDA_CALL(::cudaGraphDestroy(graph_));
+    for (void *buf : host_buffers_) CUDA_CALL(::cudaFreeHost(buf));
+  }
+
+  // Builds the executable graph from the captured operations.
+  void instantiate(::cudaGraph_t graph) {
+    graph_ = graph;
+#if CUDART_VERSION >= 12000
+    CUDA_CALL(::cudaGraphInstantiate(&exec_, graph_, 0));
+#else
+    CUDA_CALL(::cudaGraphInstantiate(&exec_, graph_, nullptr, nullptr, 0));
+#endif  // CUDART_VERSION
+  }
+
+  ::cudaGraphExec_t exec() const { return exec_; }
+
+  // Keeps the device memory so that no other tensors use it.
+  void keep(const std::shared_ptr<void> &block) { blocks_.emplace_back(block); }
+
+  // Copies host data to a page-locked memory which is read by every replay.
+  void *copy_to_host_buffer(const void *src, std::size_t size) {
+    void *buf;
+    CUDA_CALL(::cudaHostAlloc(&buf, size, cudaHostAllocDefault));
+    host_buffers_.emplace_back(buf);
+    std::memcpy(buf, src, size);
+    return buf;
+  }
 
 private:
-  ::curandGenerator_t handle_;
+  ::cudaGraph_t graph_;
+  ::cudaGraphExec_t exec_;
+  std::vector<std::shared_ptr<void>> blocks_;
+  std::vector<void *> host_buffers_;
+};
+#else
+class CUDAGraphCapture {
+public:
+  void keep(const std::shared_ptr<void> &) {}
+  void *copy_to_host_buffer(const void *, std::size_t) { return nullptr; }
 };
+#endif  // CUDART_VERSION
 
 }  // namespace
 
@@ -446,9 +1325,127 @@ namespace primitiv {
  */
 struct CUDAInternalState {
   CUDAInternalState(unsigned dev_id, unsigned rng_seed)
-    : cublas(dev_id) , curand(dev_id, rng_seed) {}
+    : stream(dev_id), cublas(dev_id) , curand(dev_id, rng_seed)
+    , matmul_precision(CUDADevice::MATMUL_PRECISION_FLOAT32)
+    , reduction_autotuning(false)
+    , next_staging(0) {
+    CUBLAS_CALL(::cublasSetStream(cublas.get(), stream.get()));
+    CURAND_CALL(::curandSetStream(curand.get(), stream.get()));
+    for (unsigned i = 0; i < ::NUM_STAGING_BUFFERS; ++i) {
+      staging.emplace_back(new ::CUDAStagingBuffer(dev_id));
+    }
+  }
+
+  /*
+   * Copies host memory to the device without blocking the host.
+   * Small data is copied to one of the staging buffers at first, so that the
+   * caller can reuse `src` immediately and the transfer of the next data can
+   * be prepared while this transfer is running.
+   */
+  void copy_to_device(void *dst, const void *src, std::size_t size) {
+    if (capture) {
+      // Staging buffers are reused by following transfers, but replays read
+      // the captured source address again.
+      CUDA_CALL(::cudaMemcpyAsync(
+            dst, capture->copy_to_host_buffer(src, size), size,
+            cudaMemcpyHostToDevice, stream.get()));
+      return;
+    }
+    if (size > ::MAX_STAGING_SIZE) {
+      CUDA_CALL(::cudaMemcpyAsync(
+            dst, src, size, cudaMemcpyHostToDevice, stream.get()));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    ::CUDAStagingBuffer &buf = *staging[next_staging];
+    next_staging = (next_staging + 1) % ::NUM_STAGING_BUFFERS;
+    void *staged = buf.acquire(size);
+    std::memcpy(staged, src, size);
+    CUDA_CALL(::cudaMemcpyAsync(
+          dst, staged, size, cudaMemcpyHostToDevice, stream.get()));
+    buf.release(stream.get());
+  }
+
+  /*
+   * Calculates C := alpha * op(A) . op(B) + beta * C with the current
+   * precision of the matrix multiplication.
+   * Arguments are same as cublasSgemm().
+   */
+  void gemm(
+      ::cublasOperation_t trans_a, ::cublasOperation_t trans_b,
+      int m, int n, int k,
+      const float *alpha, const float *a, int lda, const float *b, int ldb,
+      const float *beta, float *c, int ldc) {
+    if (matmul_precision == CUDADevice::MATMUL_PRECISION_FLOAT32) {
+      CUBLAS_CALL(::cublasSgemm(
+            cublas.get(), trans_a, trans_b, m, n, k,
+            alpha, a, lda, b, ldb, beta, c, ldc));
+      return;
+    }
+#if CUDART_VERSION >= 11000
+    // Inputs are rounded by cuBLAS to use tensor cores, and the results are
+    // accumulated in single precision.
+    const ::cublasComputeType_t compute_type =
+      matmul_precision == CUDADevice::MATMUL_PRECISION_FLOAT16
+      ? ::CUBLAS_COMPUTE_32F_FAST_16F : ::CUBLAS_COMPUTE_32F_FAST_16BF;
+    CUBLAS_CALL(::cublasGemmEx(
+          cublas.get(), trans_a, trans_b, m, n, k,
+          alpha, a, ::CUDA_R_32F, lda, b, ::CUDA_R_32F, ldb,
+          beta, c, ::CUDA_R_32F, ldc,
+          compute_type, ::CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+#endif  // CUDART_VERSION
+  }
+
+  // All operations of the device are issued to this stream.
+  ::CUDAStream stream;
   ::CUBLASHandle cublas;
   ::CURANDHandle curand;
+
+  // Precision used by gemm().
+  CUDADevice::MatmulPrecision matmul_precision;
+
+  // cuRAND generators can not be used by multiple threads at once.
+  std::mutex curand_mutex;
+
+  // Launch configurations of reductions for each (logsumexp, n, skip, rows).
+  bool reduction_autotuning;
+  std::map<std::tuple<bool, unsigned, unsigned, unsigned>, ::ReductionConfig>
+    reduction_configs;
+  std::mutex reduction_mutex;
+
+  /*
+   * Enables the direct access from this device to the memory of another GPU
+   * if supported.
+   * The result is cached for each peer because the check is expensive.
+   */
+  void enable_peer_access(unsigned dev_id, unsigned peer_id) {
+    if (dev_id == peer_id) return;
+    std::lock_guard<std::mutex> lock(peer_mutex);
+    if (!checked_peers.emplace(peer_id).second) return;
+    int can_access;
+    CUDA_CALL(::cudaDeviceCanAccessPeer(&can_access, dev_id, peer_id));
+    if (!can_access) return;
+    CUDA_CALL(::cudaSetDevice(dev_id));
+    const ::cudaError_t err = ::cudaDeviceEnablePeerAccess(peer_id, 0);
+    if (err == ::cudaErrorPeerAccessAlreadyEnabled) {
+      // Another object on the same GPU already enabled the access.
+      // Clears the error state of the runtime.
+      ::cudaGetLastError();
+    } else {
+      CUDA_CALL(err);
+    }
+  }
+
+  std::vector<std::unique_ptr<::CUDAStagingBuffer>> staging;
+  unsigned next_staging;
+  std::mutex staging_mutex;
+
+  std::unordered_set<unsigned> checked_peers;
+  std::mutex peer_mutex;
+
+  // Current capture, or nullptr if the device is not capturing.
+  std::unique_ptr<::CUDAGraphCapture> capture;
+  std::vector<std::unique_ptr<::CUDAGraphCapture>> captures;
 };
 
 unsigned CUDADevice::num_devices() {
@@ -500,6 +1497,7 @@ void CUDADevice::initialize() {
     dim2_y_ >>= 1;
   }
   max_batch_ = prop.maxGridSize[1];
+  num_sms_ = prop.multiProcessorCount;
 
   cerr << "Configurations:" << endl;
   cerr << "  1 dim ........... " << dim1_x_ << " threads" << endl;
@@ -509,9 +1507,6 @@ void CUDADevice::initialize() {
 
   // Initializes additional libraries
   state_.reset(new CUDAInternalState(dev_id_, rng_seed_));
-
-  // Initializes the device pointer for integer IDs.
-  ids_ptr_ = pool_.allocate(sizeof(unsigned) * max_batch_);
 }
 
 CUDADevice::CUDADevice(unsigned device_id)
@@ -528,39 +1523,193 @@ CUDADevice::CUDADevice(unsigned device_id, unsigned rng_seed)
   initialize();
 }
 
+CUDADevice::CUDADevice(
+    unsigned device_id, unsigned rng_seed,
+    CUDAMemoryPool::AllocationStrategy strategy)
+: dev_id_(device_id)
+, rng_seed_(rng_seed)
+, pool_(device_id, strategy) {
+  initialize();
+}
+
 CUDADevice::~CUDADevice() {
-  // Nothing to do for now.
+  // The workspace should be returned before the memory pool is destroyed.
+  release_workspace();
+}
+
+void CUDADevice::synchronize() {
+  check_not_capturing("synchronize()");
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaStreamSynchronize(state_->stream.get()));
+}
+
+CUDADevice::MatmulPrecision CUDADevice::matmul_precision() const {
+  return state_->matmul_precision;
+}
+
+void CUDADevice::set_matmul_precision(MatmulPrecision precision) {
+  switch (precision) {
+    case MATMUL_PRECISION_FLOAT32:
+      break;
+    case MATMUL_PRECISION_FLOAT16:
+    case MATMUL_PRECISION_BFLOAT16:
+#if CUDART_VERSION < 11000
+      THROW_ERROR(
+          "Reduced precision of the matrix multiplication requires CUDA 11 "
+          "or later.");
+#endif  // CUDART_VERSION
+      break;
+    default:
+      THROW_ERROR("Invalid precision: " << static_cast<int>(precision));
+  }
+  state_->matmul_precision = precision;
+}
+
+bool CUDADevice::reduction_autotuning() const {
+  return state_->reduction_autotuning;
+}
+
+void CUDADevice::set_reduction_autotuning(bool enabled) {
+  state_->reduction_autotuning = enabled;
+}
+
+void CUDADevice::wait_for(const CUDADevice &other) {
+  check_not_capturing("wait_for()");
+  other.check_not_capturing("wait_for()");
+  ::cudaEvent_t event;
+  CUDA_CALL(::cudaSetDevice(other.dev_id_));
+  CUDA_CALL(::cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+  CUDA_CALL(::cudaEventRecord(event, other.state_->stream.get()));
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaStreamWaitEvent(state_->stream.get(), event, 0));
+  // The event is released after the waiting finishes.
+  CUDA_CALL(::cudaEventDestroy(event));
+}
+
+void CUDADevice::begin_capture() {
+#if CUDART_VERSION >= 10010
+  if (state_->capture) THROW_ERROR("The device is already capturing.");
+  // The workspace is renewed so that captured kernels only use the memory
+  // kept by the capture.
+  release_workspace();
+  state_->capture.reset(new ::CUDAGraphCapture());
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  // NOTE(odashi):
+  // The memory pool may call cudaMalloc() while capturing, which is
+  // prohibited in other modes.
+  const ::cudaError_t err = ::cudaStreamBeginCapture(
+      state_->stream.get(), ::cudaStreamCaptureModeRelaxed);
+  if (err != ::cudaSuccess) state_->capture.reset();
+  CUDA_CALL(err);
+#else
+  THROW_ERROR("Capturing CUDA graphs requires CUDA 10.1 or later.");
+#endif  // CUDART_VERSION
+}
+
+unsigned CUDADevice::end_capture() {
+#if CUDART_VERSION >= 10010
+  if (!state_->capture) THROW_ERROR("The device is not capturing.");
+  std::unique_ptr<::CUDAGraphCapture> capture = std::move(state_->capture);
+  release_workspace();
+  ::cudaGraph_t graph;
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaStreamEndCapture(state_->stream.get(), &graph));
+  capture->instantiate(graph);
+  state_->captures.emplace_back(std::move(capture));
+  return state_->captures.size() - 1;
+#else
+  THROW_ERROR("Capturing CUDA graphs requires CUDA 10.1 or later.");
+#endif  // CUDART_VERSION
+}
+
+void CUDADevice::replay(unsigned id) {
+#if CUDART_VERSION >= 10010
+  check_not_capturing("replay()");
+  if (id >= state_->captures.size()) {
+    THROW_ERROR("Invalid ID of the captured graph: " << id);
+  }
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaGraphLaunch(
+        state_->captures[id]->exec(), state_->stream.get()));
+#else
+  THROW_ERROR("Capturing CUDA graphs requires CUDA 10.1 or later.");
+#endif  // CUDART_VERSION
+}
+
+bool CUDADevice::capturing() const {
+  return static_cast<bool>(state_->capture);
+}
+
+unsigned CUDADevice::num_captures() const {
+  return state_->captures.size();
+}
+
+void CUDADevice::clear_captures() {
+  check_not_capturing("clear_captures()");
+  // Operations issued before may still use the memories.
+  synchronize();
+  state_->captures.clear();
+}
+
+std::shared_ptr<void> CUDADevice::allocate(std::uint64_t size) {
+  std::shared_ptr<void> ret = pool_.allocate(size);
+  if (state_->capture) state_->capture->keep(ret);
+  return ret;
+}
+
+void CUDADevice::check_not_capturing(const char *operation) const {
+  if (state_->capture) {
+    THROW_ERROR(
+        "CUDADevice " << dev_id_ << " can not capture " << operation << '.');
+  }
 }
 
 std::shared_ptr<void> CUDADevice::new_handle(const Shape &shape) {
-  return pool_.allocate(sizeof(float) * shape.size());
+  return allocate(sizeof(float) * shape.size());
 }
 
 #define GRID_SIZE(x, threads) (((x) + (threads) - 1) / (threads))
+
+// Number of blocks for grid-stride elementwise kernels. Blocks more than the
+// resident capacity of all SMs (2048 threads each) only add scheduling costs.
+#define ELEMENTWISE_GRID_SIZE(x) \
+  std::min(GRID_SIZE(x, dim1_x_), num_sms_ * (2048 / dim1_x_))
 #define DATA(x) static_cast<float *>((x).data())
 #define CDATA(x) static_cast<const float *>((x).data())
+#define STREAM state_->stream.get()
 
 std::vector<float> CUDADevice::tensor_to_vector_impl(const Tensor &x) {
+  check_not_capturing("transfers to the host");
   const unsigned size = x.shape().size();
   std::vector<float> ret(size);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  CUDA_CALL(::cudaMemcpy(
-        &ret[0], x.data(), sizeof(float) * size, cudaMemcpyDeviceToHost));
+  CUDA_CALL(::cudaMemcpyAsync(
+        &ret[0], x.data(), sizeof(float) * size, cudaMemcpyDeviceToHost,
+        state_->stream.get()));
+  CUDA_CALL(::cudaStreamSynchronize(state_->stream.get()));
   return ret;
 }
 
+void CUDADevice::tensor_to_array_impl(const Tensor &x, float values[]) {
+  check_not_capturing("transfers to the host");
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaMemcpyAsync(
+        values, x.data(), sizeof(float) * x.shape().size(),
+        cudaMemcpyDeviceToHost, state_->stream.get()));
+  CUDA_CALL(::cudaStreamSynchronize(state_->stream.get()));
+}
+
 void CUDADevice::reset_tensor_impl(float k, Tensor &x) {
   const unsigned size = x.shape().size();
   const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::set_const_dev<<<num_blocks, dim1_x_>>>(k, size, DATA(x));
+  ::set_const_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(k, size, DATA(x));
 }
 
 void CUDADevice::reset_tensor_by_array_impl(const float values[], Tensor &x) {
   const unsigned size = x.shape().size();
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  CUDA_CALL(::cudaMemcpy(
-        x.data(), values, sizeof(float) * size, cudaMemcpyHostToDevice));
+  state_->copy_to_device(x.data(), values, sizeof(float) * size);
 }
 
 void CUDADevice::copy_tensor_impl(const Tensor &x, Tensor &y) {
@@ -569,14 +1718,20 @@ void CUDADevice::copy_tensor_impl(const Tensor &x, Tensor &y) {
       reset_tensor_by_array(CDATA(x), y);
       break;
     case Device::DEVICE_TYPE_CUDA:
-      CUDA_CALL(::cudaSetDevice(dev_id_));
-      // NOTE(odashi):
-      // If source/destination devices use the unified memory space on the 64
-      // bits machine, we can perform ::cudaMemcpy to copy data beyond devices.
-      CUDA_CALL(::cudaMemcpyAsync(
-            DATA(y), CDATA(x),
-            sizeof(float) * x.shape().size(),
-            cudaMemcpyDeviceToDevice, 0));
+      {
+        CUDADevice &src = static_cast<CUDADevice &>(*x.device());
+        // The copy should wait for the source device to finish writing `x`, and
+        // the source device should not reuse `x` until the copy finishes.
+        if (&src != this) wait_for(src);
+        // The copy between different GPUs goes through the peer-to-peer link
+        // if available, and is staged by the driver otherwise.
+        state_->enable_peer_access(dev_id_, src.dev_id_);
+        CUDA_CALL(::cudaSetDevice(dev_id_));
+        CUDA_CALL(::cudaMemcpyPeerAsync(
+              DATA(y), dev_id_, CDATA(x), src.dev_id_,
+              sizeof(float) * x.shape().size(), state_->stream.get()));
+        if (&src != this) src.wait_for(*this);
+      }
       break;
     default:
       reset_tensor_by_vector(x.to_vector(), y);
@@ -587,8 +1742,9 @@ void CUDADevice::random_bernoulli_impl(float p, Tensor &y) {
   const unsigned size = y.shape().size();
   const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
+  std::lock_guard<std::mutex> lock(state_->curand_mutex);
   CURAND_CALL(::curandGenerateUniform(state_->curand.get(), DATA(y), size));
-  ::rand_bernoulli_dev<<<num_blocks, dim1_x_>>>(p, size, DATA(y));
+  ::rand_bernoulli_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(p, size, DATA(y));
 }
 
 void CUDADevice::random_uniform_impl(float lower, float upper, Tensor &y) {
@@ -596,18 +1752,22 @@ void CUDADevice::random_uniform_impl(float lower, float upper, Tensor &y) {
   const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
   const float scale = upper - lower;
   CUDA_CALL(::cudaSetDevice(dev_id_));
+  std::lock_guard<std::mutex> lock(state_->curand_mutex);
   CURAND_CALL(::curandGenerateUniform(state_->curand.get(), DATA(y), size));
-  ::rand_affine_dev<<<num_blocks, dim1_x_>>>(lower, scale, size, DATA(y));
+  ::rand_affine_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(
+      lower, scale, size, DATA(y));
 }
 
 void CUDADevice::random_normal_impl(float mean, float sd, Tensor &y) {
   CUDA_CALL(::cudaSetDevice(dev_id_));
+  std::lock_guard<std::mutex> lock(state_->curand_mutex);
   CURAND_CALL(::curandGenerateNormal(
         state_->curand.get(), DATA(y), y.shape().size(), mean, sd));
 }
 
 void CUDADevice::random_log_normal_impl(float mean, float sd, Tensor &y) {
   CUDA_CALL(::cudaSetDevice(dev_id_));
+  std::lock_guard<std::mutex> lock(state_->curand_mutex);
   CURAND_CALL(::curandGenerateLogNormal(
         state_->curand.get(), DATA(y), y.shape().size(), mean, sd));
 }
@@ -620,17 +1780,37 @@ void CUDADevice::pick_fw_impl(
   const unsigned g1 = GRID_SIZE(sy, dim1_x_);
   const unsigned bs = y.shape().batch();
 
+  // The buffer is allocated for each call so that multiple threads can launch
+  // this kernel at once. It can be released just after the launch because the
+  // next user of the block is also serialized on the stream of this device.
+  std::shared_ptr<void> ids_ptr = allocate(sizeof(unsigned) * ids.size());
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  CUDA_CALL(::cudaMemcpy(
-        ids_ptr_.get(), ids.data(), sizeof(unsigned) * ids.size(),
-        cudaMemcpyHostToDevice));
-  ::pick_fw_dev<<<dim3(g1, bs), dim1_x_>>>(
-      CDATA(x), static_cast<const unsigned *>(ids_ptr_.get()),
+  state_->copy_to_device(
+      ids_ptr.get(), ids.data(), sizeof(unsigned) * ids.size());
+  ::pick_fw_dev<<<dim3(g1, bs), dim1_x_, 0, STREAM>>>(
+      CDATA(x), static_cast<const unsigned *>(ids_ptr.get()),
       wy * x.shape()[dim], wy,
       x.shape().has_batch() * x.shape().volume(), ids.size() > 1, sy,
       DATA(y));
 }
 
+void CUDADevice::gather_fw_impl(
+    const Tensor &x, unsigned dim, const std::vector<unsigned> &ids,
+    Tensor &y) {
+  const unsigned wy = y.shape().lower_volume(dim);
+  const unsigned size = y.shape().size();
+  const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
+
+  // Same as pick_fw_impl, the table can be released just after the launch.
+  std::shared_ptr<void> ids_ptr = allocate(sizeof(unsigned) * ids.size());
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  state_->copy_to_device(
+      ids_ptr.get(), ids.data(), sizeof(unsigned) * ids.size());
+  ::gather_fw_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(
+      CDATA(x), static_cast<const unsigned *>(ids_ptr.get()),
+      wy, x.shape()[dim], ids.size(), size, DATA(y));
+}
+
 void CUDADevice::slice_fw_impl(
     const Tensor &x, unsigned dim, unsigned offset, Tensor &y) {
   const unsigned base = y.shape().lower_volume(dim);
@@ -639,7 +1819,7 @@ void CUDADevice::slice_fw_impl(
   const unsigned size = y.shape().size();
   const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::slice_fw_dev<<<num_blocks, dim1_x_>>>(
+  ::slice_fw_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(
       CDATA(x) + base * offset, span, skip, size, DATA(y));
 }
 
@@ -648,18 +1828,24 @@ void CUDADevice::concat_fw_impl(
   const unsigned new_bs = y.shape().batch();
   const unsigned base = y.shape().lower_volume(dim);
   const unsigned skip = base * y.shape()[dim];
-  unsigned repeat = y.shape().volume() / skip;
-  CUDA_CALL(::cudaSetDevice(dev_id_));
+  const unsigned repeat = y.shape().volume() / skip;
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(2 * n);
+  std::vector<unsigned> sizes(n), params(2 * n);
   unsigned offset = 0;
-  for (const Tensor *x : xs) {
-    const unsigned span = base * x->shape()[dim];
-    const unsigned x_size = span * repeat * x->shape().batch();
-    const unsigned y_size = span * repeat * new_bs;
-    const unsigned num_blocks = GRID_SIZE(y_size, dim1_x_);
-    ::concat_fw_dev<<<num_blocks, dim1_x_>>>(
-       CDATA(*x), span, skip, x_size, y_size, DATA(y) + offset);
+  for (unsigned t = 0; t < n; ++t) {
+    const unsigned span = base * xs[t]->shape()[dim];
+    ptrs[t] = const_cast<float *>(CDATA(*xs[t]));
+    ptrs[n + t] = DATA(y) + offset;
+    sizes[t] = span * repeat * new_bs;
+    params[t] = span;
+    params[n + t] = span * repeat * xs[t]->shape().batch();
     offset += span;
   }
+  unsigned g1;
+  std::shared_ptr<void> table =
+    upload_multi_tensor_table(ptrs, sizes, params, g1);
+  ::multi_concat_fw_dev<<<g1, dim1_x_, 0, STREAM>>>(table.get(), n, skip);
 }
 
 void CUDADevice::pick_bw_impl(
@@ -670,17 +1856,52 @@ void CUDADevice::pick_bw_impl(
   const unsigned g1 = GRID_SIZE(sy, dim1_x_);
   const unsigned bs = gy.shape().batch();
 
+  std::shared_ptr<void> ids_ptr = allocate(sizeof(unsigned) * ids.size());
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  CUDA_CALL(::cudaMemcpy(
-        ids_ptr_.get(), ids.data(), sizeof(unsigned) * ids.size(),
-        cudaMemcpyHostToDevice));
-  ::pick_bw_dev<<<dim3(g1, bs), dim1_x_>>>(
-      CDATA(gy), static_cast<const unsigned *>(ids_ptr_.get()),
+  state_->copy_to_device(
+      ids_ptr.get(), ids.data(), sizeof(unsigned) * ids.size());
+  ::pick_bw_dev<<<dim3(g1, bs), dim1_x_, 0, STREAM>>>(
+      CDATA(gy), static_cast<const unsigned *>(ids_ptr.get()),
       wy *gx.shape()[dim], wy,
       gx.shape().has_batch() * gx.shape().volume(), ids.size() > 1, sy,
       DATA(gx));
 }
 
+void CUDADevice::pick_assign_impl(
+    const Tensor &y, unsigned dim, const std::vector<unsigned>& ids,
+    Tensor &x) {
+  const unsigned wy = y.shape().lower_volume(dim);
+  const unsigned sy = y.shape().volume();
+  const unsigned g1 = GRID_SIZE(sy, dim1_x_);
+  const unsigned bs = y.shape().batch();
+
+  std::shared_ptr<void> ids_ptr = allocate(sizeof(unsigned) * ids.size());
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  state_->copy_to_device(
+      ids_ptr.get(), ids.data(), sizeof(unsigned) * ids.size());
+  ::pick_assign_dev<<<dim3(g1, bs), dim1_x_, 0, STREAM>>>(
+      CDATA(y), static_cast<const unsigned *>(ids_ptr.get()),
+      wy * x.shape()[dim], wy,
+      x.shape().has_batch() * x.shape().volume(), ids.size() > 1, sy,
+      DATA(x));
+}
+
+void CUDADevice::gather_bw_impl(
+    const Tensor &gy, unsigned dim, const std::vector<unsigned>& ids,
+    Tensor &gx) {
+  const unsigned wy = gy.shape().lower_volume(dim);
+  const unsigned size = gy.shape().size();
+  const unsigned num_blocks = GRID_SIZE(size, dim1_x_);
+
+  std::shared_ptr<void> ids_ptr = allocate(sizeof(unsigned) * ids.size());
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  state_->copy_to_device(
+      ids_ptr.get(), ids.data(), sizeof(unsigned) * ids.size());
+  ::gather_bw_dev<<<num_blocks, dim1_x_, 0, STREAM>>>(
+      CDATA(gy), static_cast<const unsigned *>(ids_ptr.get()),
+      wy, gx.shape()[dim], ids.size(), size, DATA(gx));
+}
+
 void CUDADevice::slice_bw_impl(
     const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx) {
   const Shape &sx = gx.shape();
@@ -694,139 +1915,158 @@ void CUDADevice::slice_bw_impl(
   const unsigned ny = repeat * sy.batch();
   const unsigned g1 = GRID_SIZE(wy * std::max(nx, ny), dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::slice_bw_dev<<<g1, dim1_x_>>>(CDATA(gy), wx, wy, nx, ny, DATA(gx) + ox);
+  ::slice_bw_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      CDATA(gy), wx, wy, nx, ny, DATA(gx) + ox);
 }
 
-#define CUDADEV_FW_X(name) \
-void CUDADevice::name##_fw_impl(const Tensor &x, Tensor &y) { \
+// Launches unary_fw_dev() for the functor `op`.
+#define CUDADEV_FW_X_CONST(name, op) \
+void CUDADevice::name##_fw_impl(const Tensor &x, float k, Tensor &y) { \
   const unsigned size = x.shape().size(); \
-  const unsigned num_blocks = GRID_SIZE(size, dim1_x_); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_fw_dev<<<num_blocks, dim1_x_>>>(CDATA(x), size, DATA(y)); \
+  ::unary_fw_dev<E::op<float>> \
+    <<<ELEMENTWISE_GRID_SIZE(size), dim1_x_, 0, STREAM>>>( \
+      CDATA(x), k, size, DATA(y)); \
 }
 
-#define CUDADEV_BW_X(name) \
+// Launches unary_bw_dev() for the functor `op`.
+#define CUDADEV_BW_X_CONST(name, op) \
 void CUDADevice::name##_bw_impl( \
-    const Tensor &x, const Tensor &y, const Tensor &gy, Tensor &gx) { \
+    const Tensor &x, const Tensor &y, const Tensor &gy, float k, Tensor &gx) { \
   const unsigned size = x.shape().size(); \
-  const unsigned num_blocks = GRID_SIZE(size, dim1_x_); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_bw_dev<<<num_blocks, dim1_x_>>>( \
-      CDATA(x), CDATA(y), CDATA(gy), size, DATA(gx)); \
+  ::unary_bw_dev<E::op<float>> \
+    <<<ELEMENTWISE_GRID_SIZE(size), dim1_x_, 0, STREAM>>>( \
+      CDATA(x), CDATA(y), CDATA(gy), k, size, DATA(gx)); \
 }
 
-#define CUDADEV_FW_X_CONST(name) \
-void CUDADevice::name##_fw_impl(const Tensor &x, float k, Tensor &y) { \
+// Same as CUDADEV_FW_X_CONST and CUDADEV_BW_X_CONST, but without `k`.
+#define CUDADEV_FW_X(name, op) \
+void CUDADevice::name##_fw_impl(const Tensor &x, Tensor &y) { \
   const unsigned size = x.shape().size(); \
-  const unsigned num_blocks = GRID_SIZE(size,dim1_x_); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_fw_dev<<<num_blocks, dim1_x_>>>(CDATA(x), k, size, DATA(y)); \
+  ::unary_fw_dev<E::op<float>> \
+    <<<ELEMENTWISE_GRID_SIZE(size), dim1_x_, 0, STREAM>>>( \
+      CDATA(x), 0, size, DATA(y)); \
 }
 
-#define CUDADEV_BW_X_CONST(name) \
+#define CUDADEV_BW_X(name, op) \
 void CUDADevice::name##_bw_impl( \
-    const Tensor &x, const Tensor &y, const Tensor &gy, float k, Tensor &gx) { \
+    const Tensor &x, const Tensor &y, const Tensor &gy, Tensor &gx) { \
   const unsigned size = x.shape().size(); \
-  const unsigned num_blocks = GRID_SIZE(size, dim1_x_); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_bw_dev<<<num_blocks, dim1_x_>>>( \
-      CDATA(x), CDATA(y), CDATA(gy), k, size, DATA(gx)); \
+  ::unary_bw_dev<E::op<float>> \
+    <<<ELEMENTWISE_GRID_SIZE(size), dim1_x_, 0, STREAM>>>( \
+      CDATA(x), CDATA(y), CDATA(gy), 0, size, DATA(gx)); \
 }
 
-#define CUDADEV_FW_X_SCALAR(name) \
+// The scalar is the right (R) or left (L) operand of `op`.
+#define CUDADEV_FW_X_SCALAR_R(name, op) \
 void CUDADevice::name##_fw_impl(const Tensor &x, const Tensor &k, Tensor &y) { \
   const unsigned size = y.shape().volume(); \
-  const unsigned g1 = GRID_SIZE(size, dim1_x_); \
   const unsigned g2 = y.shape().batch(); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_fw_dev<<<dim3(g1, g2, 1), dim1_x_>>>( \
+  ::binary_fw_dev<E::op<float>, true, false> \
+    <<<dim3(ELEMENTWISE_GRID_SIZE(size), g2, 1), dim1_x_, 0, STREAM>>>( \
       CDATA(x), CDATA(k), size, \
-      x.shape().has_batch(), k.shape().has_batch(), DATA(y)); \
+      x.shape().has_batch() * size, k.shape().has_batch(), DATA(y)); \
 }
 
-#define CUDADEV_FW_AB(name) \
+#define CUDADEV_FW_X_SCALAR_L(name, op) \
+void CUDADevice::name##_fw_impl(const Tensor &x, const Tensor &k, Tensor &y) { \
+  const unsigned size = y.shape().volume(); \
+  const unsigned g2 = y.shape().batch(); \
+  CUDA_CALL(::cudaSetDevice(dev_id_)); \
+  ::binary_fw_dev<E::op<float>, false, true> \
+    <<<dim3(ELEMENTWISE_GRID_SIZE(size), g2, 1), dim1_x_, 0, STREAM>>>( \
+      CDATA(k), CDATA(x), size, \
+      k.shape().has_batch(), x.shape().has_batch() * size, DATA(y)); \
+}
+
+#define CUDADEV_FW_AB(name, op) \
 void CUDADevice::name##_fw_impl(const Tensor &a, const Tensor &b, Tensor &y) { \
   const unsigned size = y.shape().volume(); \
-  const unsigned g1 = GRID_SIZE(size, dim1_x_); \
   const unsigned g2 = y.shape().batch(); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_fw_dev<<<dim3(g1, g2, 1), dim1_x_>>>( \
+  ::binary_fw_dev<E::op<float>, true, true> \
+    <<<dim3(ELEMENTWISE_GRID_SIZE(size), g2, 1), dim1_x_, 0, STREAM>>>( \
       CDATA(a), CDATA(b), size, \
-      a.shape().has_batch(), b.shape().has_batch(), DATA(y)); \
+      a.shape().has_batch() * size, b.shape().has_batch() * size, DATA(y)); \
 }
 
-#define CUDADEV_BW_AB(name) \
+#define CUDADEV_BW_AB(name, op) \
 void CUDADevice::name##_bw_impl( \
     const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy, \
     Tensor &ga, Tensor &gb) { \
   const unsigned size = y.shape().volume(); \
-  const unsigned g1 = GRID_SIZE(size, dim1_x_); \
   const unsigned g2 = y.shape().batch(); \
   CUDA_CALL(::cudaSetDevice(dev_id_)); \
-  ::name##_bw_dev<<<dim3(g1, g2, 1), dim1_x_>>>( \
+  ::binary_bw_dev<E::op<float>> \
+    <<<dim3(ELEMENTWISE_GRID_SIZE(size), g2, 1), dim1_x_, 0, STREAM>>>( \
       CDATA(a), CDATA(b), CDATA(y), CDATA(gy), size, \
       a.shape().has_batch(), b.shape().has_batch(), DATA(ga), DATA(gb)); \
 }
 
-CUDADEV_FW_X(negate);
-CUDADEV_FW_X(sqrt);
-CUDADEV_FW_X(exp);
-CUDADEV_FW_X(tanh);
-CUDADEV_FW_X(sigmoid);
-CUDADEV_FW_X(softplus);
-CUDADEV_FW_X(sin);
-CUDADEV_FW_X(cos);
-CUDADEV_FW_X(tan);
-
-CUDADEV_BW_X(sqrt);
-CUDADEV_BW_X(exp);
-CUDADEV_BW_X(tanh);
-CUDADEV_BW_X(sigmoid);
-CUDADEV_BW_X(softplus);
-CUDADEV_BW_X(sin);
-CUDADEV_BW_X(cos);
-CUDADEV_BW_X(tan);
-
-CUDADEV_FW_X_CONST(add_const);
-CUDADEV_FW_X_CONST(subtract_const_r);
-CUDADEV_FW_X_CONST(subtract_const_l);
-CUDADEV_FW_X_CONST(multiply_const);
-CUDADEV_FW_X_CONST(divide_const_r);
-CUDADEV_FW_X_CONST(divide_const_l);
-CUDADEV_FW_X_CONST(prelu);
-CUDADEV_FW_X_CONST(elu);
-
-CUDADEV_BW_X_CONST(add_const);
-CUDADEV_BW_X_CONST(subtract_const_r);
-CUDADEV_BW_X_CONST(subtract_const_l);
-CUDADEV_BW_X_CONST(multiply_const);
-CUDADEV_BW_X_CONST(divide_const_r);
-CUDADEV_BW_X_CONST(divide_const_l);
-CUDADEV_BW_X_CONST(prelu);
-CUDADEV_BW_X_CONST(elu);
-
-CUDADEV_FW_X_SCALAR(add_scalar);
-CUDADEV_FW_X_SCALAR(subtract_scalar_r);
-CUDADEV_FW_X_SCALAR(subtract_scalar_l);
-CUDADEV_FW_X_SCALAR(multiply_scalar);
-CUDADEV_FW_X_SCALAR(divide_scalar_r);
-CUDADEV_FW_X_SCALAR(divide_scalar_l);
-
-CUDADEV_FW_AB(add);
-CUDADEV_FW_AB(subtract);
-CUDADEV_FW_AB(multiply);
-CUDADEV_FW_AB(divide);
-
-CUDADEV_BW_AB(add);
-CUDADEV_BW_AB(subtract);
-CUDADEV_BW_AB(multiply);
-CUDADEV_BW_AB(divide);
+CUDADEV_FW_X(negate, Negate);
+CUDADEV_FW_X(sqrt, Sqrt);
+CUDADEV_FW_X(exp, Exp);
+CUDADEV_FW_X(tanh, Tanh);
+CUDADEV_FW_X(sigmoid, Sigmoid);
+CUDADEV_FW_X(softplus, Softplus);
+CUDADEV_FW_X(sin, Sin);
+CUDADEV_FW_X(cos, Cos);
+CUDADEV_FW_X(tan, Tan);
+
+CUDADEV_BW_X(sqrt, Sqrt);
+CUDADEV_BW_X(exp, Exp);
+CUDADEV_BW_X(tanh, Tanh);
+CUDADEV_BW_X(sigmoid, Sigmoid);
+CUDADEV_BW_X(softplus, Softplus);
+CUDADEV_BW_X(sin, Sin);
+CUDADEV_BW_X(cos, Cos);
+CUDADEV_BW_X(tan, Tan);
+
+CUDADEV_FW_X_CONST(add_const, AddConst);
+CUDADEV_FW_X_CONST(subtract_const_r, SubtractConstR);
+CUDADEV_FW_X_CONST(subtract_const_l, SubtractConstL);
+CUDADEV_FW_X_CONST(multiply_const, MultiplyConst);
+CUDADEV_FW_X_CONST(divide_const_r, DivideConstR);
+CUDADEV_FW_X_CONST(divide_const_l, DivideConstL);
+CUDADEV_FW_X_CONST(prelu, PReLU);
+CUDADEV_FW_X_CONST(elu, ELU);
+
+CUDADEV_BW_X_CONST(add_const, AddConst);
+CUDADEV_BW_X_CONST(subtract_const_r, SubtractConstR);
+CUDADEV_BW_X_CONST(subtract_const_l, SubtractConstL);
+CUDADEV_BW_X_CONST(multiply_const, MultiplyConst);
+CUDADEV_BW_X_CONST(divide_const_r, DivideConstR);
+CUDADEV_BW_X_CONST(divide_const_l, DivideConstL);
+CUDADEV_BW_X_CONST(prelu, PReLU);
+CUDADEV_BW_X_CONST(elu, ELU);
+
+CUDADEV_FW_X_SCALAR_R(add_scalar, Add);
+CUDADEV_FW_X_SCALAR_R(subtract_scalar_r, Subtract);
+CUDADEV_FW_X_SCALAR_L(subtract_scalar_l, Subtract);
+CUDADEV_FW_X_SCALAR_R(multiply_scalar, Multiply);
+CUDADEV_FW_X_SCALAR_R(divide_scalar_r, Divide);
+CUDADEV_FW_X_SCALAR_L(divide_scalar_l, Divide);
+
+CUDADEV_FW_AB(add, Add);
+CUDADEV_FW_AB(subtract, Subtract);
+CUDADEV_FW_AB(multiply, Multiply);
+CUDADEV_FW_AB(divide, Divide);
+
+CUDADEV_BW_AB(add, Add);
+CUDADEV_BW_AB(subtract, Subtract);
+CUDADEV_BW_AB(multiply, Multiply);
+CUDADEV_BW_AB(divide, Divide);
 
-#undef CUDADEV_FW_X
-#undef CUDADEV_BW_X
 #undef CUDADEV_FW_X_CONST
 #undef CUDADEV_BW_X_CONST
-#undef CUDADEV_FW_X_SCALAR
+#undef CUDADEV_FW_X
+#undef CUDADEV_BW_X
+#undef CUDADEV_FW_X_SCALAR_R
+#undef CUDADEV_FW_X_SCALAR_L
 #undef CUDADEV_FW_AB
 #undef CUDADEV_BW_AB
 
@@ -837,7 +2077,8 @@ void CUDADevice::transpose_fw_impl(const Tensor &x, Tensor &y) {
   const unsigned g1 = GRID_SIZE(rows, dim2_x_);
   const unsigned g2 = GRID_SIZE(cols, dim2_y_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::transpose_fw_dev<<<dim3(g1, g2, bs), dim3(dim2_x_, dim2_y_, 1)>>>(
+  ::transpose_fw_dev<<<
+    dim3(g1, g2, bs), dim3(dim2_x_, dim2_y_, 1), 0, STREAM>>>(
       CDATA(x), rows, cols, DATA(y));
 }
 
@@ -855,19 +2096,19 @@ void CUDADevice::matmul_fw_impl(const Tensor &a, const Tensor &b, Tensor &y) {
     const unsigned y_skip = di * dk;
     const unsigned bs = a.shape().batch();
     for (unsigned n = 0; n < bs; ++n) {
-      CUBLAS_CALL(::cublasSgemm(
-            state_->cublas.get(), ::CUBLAS_OP_N, ::CUBLAS_OP_N,
+      state_->gemm(
+            ::CUBLAS_OP_N, ::CUBLAS_OP_N,
             di, dk, dj,
             &alpha, CDATA(a) + n * a_skip, di, CDATA(b) + n * b_skip, dj,
-            &beta, DATA(y) + n * y_skip, di));
+            &beta, DATA(y) + n * y_skip, di);
     }
   } else {
     // Do gemm only once to calculate the product with a combined matrix.
-    CUBLAS_CALL(::cublasSgemm(
-          state_->cublas.get(), ::CUBLAS_OP_N, ::CUBLAS_OP_N,
+    state_->gemm(
+          ::CUBLAS_OP_N, ::CUBLAS_OP_N,
           di, dk * b.shape().batch(), dj,
           &alpha, CDATA(a), di, CDATA(b), dj,
-          &beta, DATA(y), di));
+          &beta, DATA(y), di);
   }
 }
 
@@ -879,7 +2120,8 @@ void CUDADevice::transpose_bw_impl(
   const unsigned g1 = GRID_SIZE(rows, dim2_x_);
   const unsigned g2 = GRID_SIZE(cols, dim2_y_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::transpose_bw_dev<<<dim3(g1, g2, bs), dim3(dim2_x_, dim2_y_, 1)>>>(
+  ::transpose_bw_dev<<<
+    dim3(g1, g2, bs), dim3(dim2_x_, dim2_y_, 1), 0, STREAM>>>(
       CDATA(gy), rows, cols, DATA(gx));
 }
 
@@ -901,82 +2143,466 @@ void CUDADevice::matmul_bw_impl(
     const unsigned y_skip = di * dk;
     const unsigned bs = a.shape().batch();
     for (unsigned n = 0; n < bs; ++n) {
-      CUBLAS_CALL(::cublasSgemm(
-            state_->cublas.get(), ::CUBLAS_OP_N, ::CUBLAS_OP_T,
+      state_->gemm(
+            ::CUBLAS_OP_N, ::CUBLAS_OP_T,
             di, dj, dk,
             &alpha, CDATA(gy) + n * y_skip, di, CDATA(b) + n * b_skip, dj,
-            &beta, DATA(ga) + n * a_skip, di));
-      CUBLAS_CALL(::cublasSgemm(
-            state_->cublas.get(), ::CUBLAS_OP_T, ::CUBLAS_OP_N,
+            &beta, DATA(ga) + n * a_skip, di);
+      state_->gemm(
+            ::CUBLAS_OP_T, ::CUBLAS_OP_N,
             dj, dk, di,
             &alpha, CDATA(a) + n * a_skip, di, CDATA(gy) + n * y_skip, di,
-            &beta, DATA(gb) + n * b_skip, dj));
+            &beta, DATA(gb) + n * b_skip, dj);
     }
   } else {
     // Do gemm only once to calculate the product with a combined matrix.
-    CUBLAS_CALL(::cublasSgemm(
-          state_->cublas.get(), ::CUBLAS_OP_N, ::CUBLAS_OP_T,
+    state_->gemm(
+          ::CUBLAS_OP_N, ::CUBLAS_OP_T,
           di, dj, dk * b.shape().batch(),
           &alpha, CDATA(gy), di, CDATA(b), dj,
-          &beta, DATA(ga), di));
-    CUBLAS_CALL(::cublasSgemm(
-          state_->cublas.get(), ::CUBLAS_OP_T, ::CUBLAS_OP_N,
+          &beta, DATA(ga), di);
+    state_->gemm(
+          ::CUBLAS_OP_T, ::CUBLAS_OP_N,
           dj, dk * b.shape().batch(), di,
           &alpha, CDATA(a), di, CDATA(gy), di,
-          &beta, DATA(gb), dj));
+          &beta, DATA(gb), dj);
   }
 }
 
-void CUDADevice::sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+void CUDADevice::affine_fw_impl(
+    const Tensor &w, const Tensor &x, const Tensor &b, Activation act,
+    Tensor &y) {
+  const unsigned di = w.shape()[0];
+  const unsigned dj = w.shape()[1];
+  const unsigned dk = x.shape()[1];
+  const unsigned size = y.shape().volume();
+  const unsigned bs = y.shape().batch();
+  float alpha = 1.;
+  float beta = 1.;
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+
+  // Initializes y by the bias and accumulates the matrix product onto it.
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  ::affine_bias_dev<<<dim3(g1, bs, 1), dim1_x_, 0, STREAM>>>(
+      CDATA(b), di, size, b.shape().has_batch(), DATA(y));
+  if (w.shape().has_batch() || b.shape().has_batch()) {
+    // Do gemm multiple times.
+    const unsigned w_skip = w.shape().has_batch() * di * dj;
+    const unsigned x_skip = x.shape().has_batch() * dj * dk;
+    const unsigned y_skip = di * dk;
+    for (unsigned n = 0; n < bs; ++n) {
+      state_->gemm(
+            ::CUBLAS_OP_N, ::CUBLAS_OP_N,
+            di, dk, dj,
+            &alpha, CDATA(w) + n * w_skip, di, CDATA(x) + n * x_skip, dj,
+            &beta, DATA(y) + n * y_skip, di);
+    }
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    state_->gemm(
+          ::CUBLAS_OP_N, ::CUBLAS_OP_N,
+          di, dk * x.shape().batch(), dj,
+          &alpha, CDATA(w), di, CDATA(x), dj,
+          &beta, DATA(y), di);
+  }
+
+  if (act != ACTIVATION_IDENTITY) {
+    const unsigned total = y.shape().size();
+    ::affine_epilogue_dev<<<GRID_SIZE(total, dim1_x_), dim1_x_, 0, STREAM>>>(
+        act, total, DATA(y));
+  }
+}
+
+void CUDADevice::affine_bw_impl(
+    const Tensor &w, const Tensor &x, const Tensor &b,
+    const Tensor &y, const Tensor &gy, Activation act,
+    Tensor &gw, Tensor &gx, Tensor &gb) {
+  // g := gy * act'(y)
+  // gw += g . x^T
+  // gx += w^T . g
+  // gb += sum_j g[:, j]
+  const unsigned di = w.shape()[0];
+  const unsigned dj = w.shape()[1];
+  const unsigned dk = x.shape()[1];
+  const unsigned bs = y.shape().batch();
+  float alpha = 1.;
+  float beta = 1.;
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+
+  Tensor g_act;
+  if (act != ACTIVATION_IDENTITY) {
+    g_act = new_workspace_tensor(y.shape());
+    const unsigned total = y.shape().size();
+    ::affine_act_bw_dev<<<GRID_SIZE(total, dim1_x_), dim1_x_, 0, STREAM>>>(
+        CDATA(y), CDATA(gy), act, total, DATA(g_act));
+  }
+  const Tensor &g = g_act.valid() ? g_act : gy;
+
+  if (w.shape().has_batch() || b.shape().has_batch()) {
+    // Do gemm multiple times.
+    const unsigned w_skip = w.shape().has_batch() * di * dj;
+    const unsigned x_skip = x.shape().has_batch() * dj * dk;
+    const unsigned y_skip = di * dk;
+    for (unsigned n = 0; n < bs; ++n) {
+      state_->gemm(
+            ::CUBLAS_OP_N, ::CUBLAS_OP_T,
+            di, dj, dk,
+            &alpha, CDATA(g) + n * y_skip, di, CDATA(x) + n * x_skip, dj,
+            &beta, DATA(gw) + n * w_skip, di);
+      state_->gemm(
+            ::CUBLAS_OP_T, ::CUBLAS_OP_N,
+            dj, dk, di,
+            &alpha, CDATA(w) + n * w_skip, di, CDATA(g) + n * y_skip, di,
+            &beta, DATA(gx) + n * x_skip, dj);
+    }
+  } else {
+    // Do gemm only once to calculate the product with a combined matrix.
+    state_->gemm(
+          ::CUBLAS_OP_N, ::CUBLAS_OP_T,
+          di, dj, dk * x.shape().batch(),
+          &alpha, CDATA(g), di, CDATA(x), dj,
+          &beta, DATA(gw), di);
+    state_->gemm(
+          ::CUBLAS_OP_T, ::CUBLAS_OP_N,
+          dj, dk * x.shape().batch(), di,
+          &alpha, CDATA(w), di, CDATA(g), di,
+          &beta, DATA(gx), dj);
+  }
+
+  ::affine_bias_bw_dev<<<GRID_SIZE(di, dim1_x_), dim1_x_, 0, STREAM>>>(
+      CDATA(g), di, dk, bs, b.shape().has_batch(), DATA(gb));
+}
+
+void CUDADevice::lstm_cell_fw_impl(
+    const Tensor &u, const Tensor &c, Tensor &y) {
+  const unsigned n = c.shape()[0];
+  const unsigned size = c.shape().volume();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  const unsigned g2 = y.shape().batch();
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::lstm_cell_fw_dev<<<dim3(g1, g2, 1), dim1_x_, 0, STREAM>>>(
+      CDATA(u), CDATA(c), n, size,
+      u.shape().has_batch(), c.shape().has_batch(), DATA(y));
+}
+
+void CUDADevice::lstm_cell_bw_impl(
+    const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+    Tensor &gu, Tensor &gc) {
+  const unsigned n = c.shape()[0];
+  const unsigned size = c.shape().volume();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::lstm_cell_bw_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      CDATA(u), CDATA(c), CDATA(y), CDATA(gy), n, size, y.shape().batch(),
+      u.shape().has_batch(), c.shape().has_batch(), DATA(gu), DATA(gc));
+}
+
+// Makes arguments of persistent LSTM kernels, and calculates the size of the
+// shared memory used by each block.
+#define CUDADEV_LSTM_ARGS(num_vectors) \
+  const unsigned n = h0.shape()[0]; \
+  const unsigned steps = xu.shape()[1]; \
+  const unsigned bs = std::max( \
+      xu.shape().batch(), std::max(h0.shape().batch(), c0.shape().batch())); \
+  const unsigned vec_bytes = sizeof(float) * (num_vectors) * n; \
+  const unsigned wh_bytes = sizeof(float) * 4 * n * n; \
+  const bool cache_wh = vec_bytes + wh_bytes <= ::LSTM_MAX_SHARED_BYTES; \
+  if (vec_bytes > ::LSTM_MAX_SHARED_BYTES) { \
+    THROW_ERROR("Too large hidden size of the LSTM: " << n); \
+  } \
+  const ::LSTMArgs args { \
+    n, steps, xu.shape().has_batch() * 4 * n * steps, \
+    h0.shape().has_batch() * n, c0.shape().has_batch() * n, cache_wh, \
+    CDATA(xu), CDATA(wh), CDATA(h0), CDATA(c0), \
+  }; \
+  const unsigned smem = vec_bytes + cache_wh * wh_bytes; \
+  const unsigned block_size = std::min( \
+      dim1_x_, GRID_SIZE(4 * n, ::WARP_SIZE) * ::WARP_SIZE);
+
+void CUDADevice::lstm_fw_impl(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+    Tensor &y) {
+  CUDADEV_LSTM_ARGS(5);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::lstm_fw_dev<<<bs, block_size, smem, STREAM>>>(args, DATA(y));
+}
+
+void CUDADevice::lstm_bw_impl(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+    const Tensor &y, const Tensor &gy,
+    Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) {
+  CUDADEV_LSTM_ARGS(11);
+  // Gradients of preactivations and previous hidden states of all steps.
+  // Same as pick_fw_impl, they can be released just after the launches.
+  std::shared_ptr<void> buf = allocate(sizeof(float) * 5 * n * steps * bs);
+  float *pgu = static_cast<float *>(buf.get());
+  float *php = pgu + 4 * n * steps * bs;
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::lstm_bw_dev<<<bs, block_size, smem, STREAM>>>(
+      args, CDATA(y), CDATA(gy), pgu, php, DATA(gh0), DATA(gc0));
+
+  // gxu += gu
+  const unsigned size = 4 * n * steps;
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  ::inplace_add_dev<<<dim3(g1, bs, 1), dim1_x_, 0, STREAM>>>(
+      pgu, size, 1, xu.shape().has_batch(), DATA(gxu));
+
+  // gwh += gu . hp^T over all steps and samples.
+  float alpha = 1.;
+  float beta = 1.;
+  state_->gemm(
+      ::CUBLAS_OP_N, ::CUBLAS_OP_T,
+      4 * n, n, steps * bs,
+      &alpha, pgu, 4 * n, php, n,
+      &beta, DATA(gwh), 4 * n);
+}
+
+#undef CUDADEV_LSTM_ARGS
+
+void CUDADevice::quantized_matmul_fw_impl(
+    const QuantizedParameter &, const Tensor &, Tensor &) {
+  THROW_ERROR("Quantized matrix multiplication is not supported by CUDA.");
+}
+
+void CUDADevice::batch_moments_fw_impl(
+    const Tensor &x, Tensor &mean, Tensor &var) {
+  const unsigned size = mean.shape().size();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::batch_moments_fw_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      CDATA(x), size, x.shape().batch(), DATA(mean), DATA(var));
+}
+
+void CUDADevice::batch_normalize_fw_impl(
+    const Tensor &x, const Tensor &mean, const Tensor &var, float eps,
+    Tensor &y) {
+  const unsigned size = mean.shape().size();
+  const unsigned total = y.shape().size();
+  const unsigned g1 = GRID_SIZE(total, dim1_x_);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::batch_normalize_fw_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      CDATA(x), CDATA(mean), CDATA(var), eps, size, total, DATA(y));
+}
+
+void CUDADevice::elementwise_fw_impl(
+    const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs,
+    Tensor &y) {
+  ::ElementwiseArgs args;
+  args.num_insts = prog.instructions.size();
+  std::copy(
+      prog.instructions.begin(), prog.instructions.end(), args.insts);
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    args.px[i] = CDATA(*xs[i]);
+    args.mbx[i] = xs[i]->shape().has_batch();
+  }
+  const unsigned size = y.shape().volume();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  const unsigned g2 = y.shape().batch();
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::elementwise_fw_dev<<<dim3(g1, g2, 1), dim1_x_, 0, STREAM>>>(
+      args, size, DATA(y));
+}
+
+// Launches `kernel<k>` with the block size `k` chosen at runtime.
+#define CUDADEV_BLOCK_SWITCH(block_size, kernel, grid, ...) { \
+  switch (block_size) { \
+    case 1024: ::kernel<1024><<<grid, 1024, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 512: ::kernel<512><<<grid, 512, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 256: ::kernel<256><<<grid, 256, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 128: ::kernel<128><<<grid, 128, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 64: ::kernel<64><<<grid, 64, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 32: ::kernel<32><<<grid, 32, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 16: ::kernel<16><<<grid, 16, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 8: ::kernel<8><<<grid, 8, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 4: ::kernel<4><<<grid, 4, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 2: ::kernel<2><<<grid, 2, 0, STREAM>>>(__VA_ARGS__); break; \
+    case 1: ::kernel<1><<<grid, 1, 0, STREAM>>>(__VA_ARGS__); break; \
+  } \
+}
+
+void CUDADevice::launch_reduction(
+    bool logsumexp, const Tensor &x, unsigned dim, unsigned strategy,
+    unsigned splits, Tensor &y) {
   const unsigned n = x.shape()[dim];
-  const unsigned r = y.shape().size();
-  const unsigned s = y.shape().lower_volume(dim);
-  unsigned block_size = dim1_x_;
-  while (block_size >> 1 >= n) block_size >>= 1;
-  CUDA_CALL(::cudaSetDevice(dev_id_));
-  switch (block_size) {
-#define CASE(k) \
-    case k: ::sum_fw_dev<k><<<r, k>>>(CDATA(x), s, n, DATA(y)); break
-    CASE(1024);
-    CASE(512);
-    CASE(256);
-    CASE(128);
-    CASE(64);
-    CASE(32);
-    CASE(16);
-    CASE(8);
-    CASE(4);
-    CASE(2);
-    CASE(1);
-#undef CASE
+  const unsigned s = x.shape().lower_volume(dim);
+  const unsigned rows = y.shape().size();
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  switch (strategy) {
+    case ::REDUCTION_WARP:
+      {
+        const unsigned g1 = GRID_SIZE(rows, ::WARPS_PER_BLOCK);
+        const unsigned bs = ::WARPS_PER_BLOCK * ::WARP_SIZE;
+        if (logsumexp) {
+          ::logsumexp_warp_fw_dev<<<g1, bs, 0, STREAM>>>(
+              CDATA(x), s, n, rows, DATA(y));
+        } else {
+          ::sum_warp_fw_dev<<<g1, bs, 0, STREAM>>>(
+              CDATA(x), s, n, rows, DATA(y));
+        }
+      }
+      break;
+    case ::REDUCTION_SPLIT:
+      {
+        // Empty parts are not launched.
+        const unsigned chunk = GRID_SIZE(n, splits);
+        splits = GRID_SIZE(n, chunk);
+        const unsigned block_size = ::reduction_block_size(chunk, dim1_x_);
+        const unsigned g1 = GRID_SIZE(rows, dim1_x_);
+        const dim3 grid(rows, splits);
+        // Same as pick_fw_impl, partial results can be released just after
+        // the launch.
+        std::shared_ptr<void> partial = allocate(
+            sizeof(float) * rows * splits * (logsumexp ? 2 : 1));
+        float *pp = static_cast<float *>(partial.get());
+        if (logsumexp) {
+          float *ps = pp + rows * splits;
+          CUDADEV_BLOCK_SWITCH(
+              block_size, logsumexp_split_fw_dev, grid,
+              CDATA(x), s, n, chunk, pp, ps);
+          ::logsumexp_merge_dev<<<g1, dim1_x_, 0, STREAM>>>(
+              pp, ps, splits, rows, DATA(y));
+        } else {
+          CUDADEV_BLOCK_SWITCH(
+              block_size, sum_split_fw_dev, grid, CDATA(x), s, n, chunk, pp);
+          ::sum_merge_dev<<<g1, dim1_x_, 0, STREAM>>>(
+              pp, splits, rows, DATA(y));
+        }
+      }
+      break;
+    default:
+      {
+        const unsigned block_size = ::reduction_block_size(n, dim1_x_);
+        if (logsumexp) {
+          CUDADEV_BLOCK_SWITCH(
+              block_size, logsumexp_fw_dev, rows, CDATA(x), s, n, DATA(y));
+        } else {
+          CUDADEV_BLOCK_SWITCH(
+              block_size, sum_fw_dev, rows, CDATA(x), s, n, DATA(y));
+        }
+      }
   }
 }
 
-void CUDADevice::logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+#undef CUDADEV_BLOCK_SWITCH
+
+void CUDADevice::reduction_fw(
+    bool logsumexp, const Tensor &x, unsigned dim, Tensor &y) {
   const unsigned n = x.shape()[dim];
-  const unsigned r = y.shape().size();
-  const unsigned s = y.shape().lower_volume(dim);
-  unsigned block_size = dim1_x_;
-  while (block_size >> 1 >= n) block_size >>= 1;
-  CUDA_CALL(::cudaSetDevice(dev_id_));
-  switch (block_size) {
-#define CASE(k) \
-    case k: ::logsumexp_fw_dev<k><<<r, k>>>(CDATA(x), s, n, DATA(y)); break
-    CASE(1024);
-    CASE(512);
-    CASE(256);
-    CASE(128);
-    CASE(64);
-    CASE(32);
-    CASE(16);
-    CASE(8);
-    CASE(4);
-    CASE(2);
-    CASE(1);
-#undef CASE
+  const unsigned rows = y.shape().size();
+  const auto key = std::make_tuple(
+      logsumexp, n, x.shape().lower_volume(dim), rows);
+  {
+    std::lock_guard<std::mutex> lock(state_->reduction_mutex);
+    const auto it = state_->reduction_configs.find(key);
+    if (it != state_->reduction_configs.end()) {
+      const ::ReductionConfig &c = it->second;
+      launch_reduction(logsumexp, x, dim, c.strategy, c.splits, y);
+      return;
+    }
+  }
+  if (!state_->reduction_autotuning || state_->capture) {
+    const ::ReductionConfig c = ::heuristic_reduction(n, rows, num_sms_);
+    launch_reduction(logsumexp, x, dim, c.strategy, c.splits, y);
+    return;
+  }
+
+  // Measures all candidates. Every candidate writes the same result to `y`.
+  ::cudaEvent_t begin, end;
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  CUDA_CALL(::cudaEventCreate(&begin));
+  CUDA_CALL(::cudaEventCreate(&end));
+  ::ReductionConfig best {::REDUCTION_BLOCK, 1};
+  float best_time = -1;
+  for (const ::ReductionConfig &c : ::reduction_candidates(n)) {
+    // The first launch is not measured because it may load the kernel.
+    launch_reduction(logsumexp, x, dim, c.strategy, c.splits, y);
+    CUDA_CALL(::cudaEventRecord(begin, STREAM));
+    for (unsigned i = 0; i < ::NUM_AUTOTUNING_TRIALS; ++i) {
+      launch_reduction(logsumexp, x, dim, c.strategy, c.splits, y);
+    }
+    CUDA_CALL(::cudaEventRecord(end, STREAM));
+    CUDA_CALL(::cudaEventSynchronize(end));
+    float time;
+    CUDA_CALL(::cudaEventElapsedTime(&time, begin, end));
+    if (best_time < 0 || time < best_time) {
+      best = c;
+      best_time = time;
+    }
   }
+  CUDA_CALL(::cudaEventDestroy(begin));
+  CUDA_CALL(::cudaEventDestroy(end));
+
+  // The result of the chosen kernel is kept for consistency with later calls.
+  launch_reduction(logsumexp, x, dim, best.strategy, best.splits, y);
+  std::lock_guard<std::mutex> lock(state_->reduction_mutex);
+  state_->reduction_configs.emplace(key, best);
+}
+
+void CUDADevice::sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+  reduction_fw(false, x, dim, y);
+}
+
+// Launches a kernel which processes each row along `dim` by one block.
+#define CUDADEV_ROW_KERNEL(kernel, x, dim, rows, y) { \
+  const unsigned n = (x).shape()[dim]; \
+  const unsigned s = (x).shape().lower_volume(dim); \
+  unsigned block_size = dim1_x_; \
+  while (block_size >> 1 >= n) block_size >>= 1; \
+  CUDA_CALL(::cudaSetDevice(dev_id_)); \
+  switch (block_size) { \
+    case 1024: \
+      ::kernel<1024><<<rows, 1024, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 512: \
+      ::kernel<512><<<rows, 512, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 256: \
+      ::kernel<256><<<rows, 256, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 128: \
+      ::kernel<128><<<rows, 128, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 64: \
+      ::kernel<64><<<rows, 64, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 32: \
+      ::kernel<32><<<rows, 32, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 16: \
+      ::kernel<16><<<rows, 16, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 8: \
+      ::kernel<8><<<rows, 8, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 4: \
+      ::kernel<4><<<rows, 4, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 2: \
+      ::kernel<2><<<rows, 2, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+    case 1: \
+      ::kernel<1><<<rows, 1, 0, STREAM>>>(CDATA(x), s, n, DATA(y)); \
+      break; \
+  } \
+}
+
+void CUDADevice::logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+  reduction_fw(true, x, dim, y);
+}
+
+void CUDADevice::softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) {
+  const unsigned rows = x.shape().size() / x.shape()[dim];
+  CUDADEV_ROW_KERNEL(softmax_fw_dev, x, dim, rows, y);
 }
 
+void CUDADevice::log_softmax_fw_impl(
+    const Tensor &x, unsigned dim, Tensor &y) {
+  const unsigned rows = x.shape().size() / x.shape()[dim];
+  CUDADEV_ROW_KERNEL(log_softmax_fw_dev, x, dim, rows, y);
+}
+
+#undef CUDADEV_ROW_KERNEL
+
 void CUDADevice::broadcast_fw_impl(
     const Tensor &x, unsigned dim, unsigned size, Tensor &y) {
   const unsigned skip1 = y.shape().lower_volume(dim);
@@ -984,14 +2610,15 @@ void CUDADevice::broadcast_fw_impl(
   const unsigned total = y.shape().size();
   const unsigned g1 = GRID_SIZE(total, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::broadcast_fw_dev<<<g1, dim1_x_>>>(CDATA(x), skip1, skip2, total, DATA(y));
+  ::broadcast_fw_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      CDATA(x), skip1, skip2, total, DATA(y));
 }
 
 void CUDADevice::batch_sum_fw_impl(const Tensor &x, Tensor &y) {
   const unsigned size = y.shape().size();
   const unsigned g1 = GRID_SIZE(size, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::batch_sum_fw_dev<<<g1, dim1_x_>>>(
+  ::batch_sum_fw_dev<<<g1, dim1_x_, 0, STREAM>>>(
       CDATA(x), size, x.shape().batch(), DATA(y));
 }
 
@@ -999,7 +2626,7 @@ void CUDADevice::inplace_multiply_const_impl(float k, Tensor &x) {
   const unsigned size = x.shape().size();
   const unsigned g1 = GRID_SIZE(size, dim1_x_);
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::inplace_multiply_const_dev<<<g1, dim1_x_>>>(k, size, DATA(x));
+  ::inplace_multiply_const_dev<<<g1, dim1_x_, 0, STREAM>>>(k, size, DATA(x));
 }
 
 void CUDADevice::inplace_add_impl(const Tensor &x, Tensor &y) {
@@ -1007,7 +2634,7 @@ void CUDADevice::inplace_add_impl(const Tensor &x, Tensor &y) {
   const unsigned g1 = GRID_SIZE(size, dim1_x_);
   const unsigned bs = std::max(x.shape().batch(), y.shape().batch());
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::inplace_add_dev<<<dim3(g1, bs, 1), dim1_x_>>>(
+  ::inplace_add_dev<<<dim3(g1, bs, 1), dim1_x_, 0, STREAM>>>(
       CDATA(x), size, x.shape().has_batch(), y.shape().has_batch(), DATA(y));
 }
 
@@ -1016,8 +2643,182 @@ void CUDADevice::inplace_subtract_impl(const Tensor &x, Tensor &y) {
   const unsigned g1 = GRID_SIZE(size, dim1_x_);
   const unsigned bs = std::max(x.shape().batch(), y.shape().batch());
   CUDA_CALL(::cudaSetDevice(dev_id_));
-  ::inplace_subtract_dev<<<dim3(g1, bs, 1), dim1_x_>>>(
+  ::inplace_subtract_dev<<<dim3(g1, bs, 1), dim1_x_, 0, STREAM>>>(
       CDATA(x), size, x.shape().has_batch(), y.shape().has_batch(), DATA(y));
 }
 
+void CUDADevice::sgd_update_impl(float eta, const Tensor &g, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::sgd_update_dev<<<g1, dim1_x_, 0, STREAM>>>(eta, CDATA(g), size, DATA(x));
+}
+
+void CUDADevice::momentum_sgd_update_impl(
+    float eta, float momentum, const Tensor &g, Tensor &m, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::momentum_sgd_update_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      eta, momentum, CDATA(g), size, DATA(m), DATA(x));
+}
+
+void CUDADevice::adam_update_impl(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) {
+  const unsigned size = x.shape().size();
+  const unsigned g1 = GRID_SIZE(size, dim1_x_);
+  const float c1 = 1 - std::pow(beta1, epoch);
+  const float c2 = 1 - std::pow(beta2, epoch);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::adam_update_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      alpha, beta1, beta2, eps, c1, c2,
+      CDATA(g), size, DATA(m1), DATA(m2), DATA(x));
+}
+
+std::shared_ptr<void> CUDADevice::upload_multi_tensor_table(
+    const std::vector<float *> &ptrs, const std::vector<unsigned> &sizes,
+    const std::vector<unsigned> &params, unsigned &num_blocks) {
+  std::vector<unsigned> blocks;
+  for (unsigned t = 0; t < sizes.size(); ++t) {
+    for (unsigned i = 0; i < sizes[t]; i += dim1_x_) {
+      blocks.emplace_back(t);
+      blocks.emplace_back(i);
+    }
+  }
+  num_blocks = blocks.size() / 2;
+
+  const std::size_t ptrs_size = sizeof(float *) * ptrs.size();
+  const std::size_t sizes_size = sizeof(unsigned) * sizes.size();
+  const std::size_t params_size = sizeof(unsigned) * params.size();
+  const std::size_t blocks_size = sizeof(unsigned) * blocks.size();
+  std::vector<char> host(ptrs_size + sizes_size + params_size + blocks_size);
+  std::memcpy(&host[0], ptrs.data(), ptrs_size);
+  std::memcpy(&host[ptrs_size], sizes.data(), sizes_size);
+  if (!params.empty()) {
+    std::memcpy(&host[ptrs_size + sizes_size], params.data(), params_size);
+  }
+  std::memcpy(
+      &host[ptrs_size + sizes_size + params_size], blocks.data(), blocks_size);
+
+  // Same as pick_fw_impl, the table can be released just after the launch.
+  std::shared_ptr<void> table = allocate(host.size());
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  state_->copy_to_device(table.get(), host.data(), host.size());
+  return table;
+}
+
+void CUDADevice::sgd_update_multi_impl(
+    float eta,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(2 * n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    ptrs[t] = const_cast<float *>(CDATA(*gs[t]));
+    ptrs[n + t] = DATA(*xs[t]);
+    sizes[t] = xs[t]->shape().size();
+  }
+  unsigned g1;
+  std::shared_ptr<void> table = upload_multi_tensor_table(ptrs, sizes, {}, g1);
+  ::multi_sgd_update_dev<<<g1, dim1_x_, 0, STREAM>>>(eta, table.get(), n);
+}
+
+void CUDADevice::momentum_sgd_update_multi_impl(
+    float eta, float momentum,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+    const std::vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(3 * n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    ptrs[t] = const_cast<float *>(CDATA(*gs[t]));
+    ptrs[n + t] = DATA(*ms[t]);
+    ptrs[2 * n + t] = DATA(*xs[t]);
+    sizes[t] = xs[t]->shape().size();
+  }
+  unsigned g1;
+  std::shared_ptr<void> table = upload_multi_tensor_table(ptrs, sizes, {}, g1);
+  ::multi_momentum_sgd_update_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      eta, momentum, table.get(), n);
+}
+
+void CUDADevice::adam_update_multi_impl(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+    const std::vector<Tensor *> &m2s, const std::vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(4 * n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    ptrs[t] = const_cast<float *>(CDATA(*gs[t]));
+    ptrs[n + t] = DATA(*m1s[t]);
+    ptrs[2 * n + t] = DATA(*m2s[t]);
+    ptrs[3 * n + t] = DATA(*xs[t]);
+    sizes[t] = xs[t]->shape().size();
+  }
+  const float c1 = 1 - std::pow(beta1, epoch);
+  const float c2 = 1 - std::pow(beta2, epoch);
+  unsigned g1;
+  std::shared_ptr<void> table = upload_multi_tensor_table(ptrs, sizes, {}, g1);
+  ::multi_adam_update_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      alpha, beta1, beta2, eps, c1, c2, table.get(), n);
+}
+
+void CUDADevice::squared_norm_multi_impl(
+    const std::vector<const Tensor *> &xs, Tensor &y) {
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    ptrs[t] = const_cast<float *>(CDATA(*xs[t]));
+    sizes[t] = xs[t]->shape().size();
+  }
+  unsigned g1;
+  std::shared_ptr<void> table = upload_multi_tensor_table(ptrs, sizes, {}, g1);
+  if (g1 == 0) return;
+
+  // Partial sums of blocks are added by one warp in order, and the result
+  // does not depend on the scheduling of blocks.
+  std::shared_ptr<void> partials = allocate(g1 * sizeof(float));
+  float *pp = static_cast<float *>(partials.get());
+  ::multi_squared_norm_dev<<<g1, dim1_x_, 0, STREAM>>>(table.get(), n, pp);
+  ::sum_warp_fw_dev<<<1, ::WARP_SIZE, 0, STREAM>>>(pp, 1, g1, 1, DATA(y));
+}
+
+void CUDADevice::clip_by_norm_multi_impl(
+    float max_norm, const Tensor &sq_norm, const std::vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  std::vector<float *> ptrs(n);
+  std::vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    ptrs[t] = DATA(*xs[t]);
+    sizes[t] = xs[t]->shape().size();
+  }
+  unsigned g1;
+  std::shared_ptr<void> table = upload_multi_tensor_table(ptrs, sizes, {}, g1);
+  if (g1 == 0) return;
+  ::multi_clip_by_norm_dev<<<g1, dim1_x_, 0, STREAM>>>(
+      max_norm, CDATA(sq_norm), table.get(), n);
+}
+
+void CUDADevice::top_k_impl(
+    const Tensor &x, unsigned k, unsigned ids[], float values[]) {
+  check_not_capturing("transfers to the host");
+  const unsigned bs = x.shape().batch();
+  const unsigned size = k * bs;
+  std::shared_ptr<void> buf = allocate(
+      (sizeof(unsigned) + sizeof(float)) * size);
+  unsigned *pi = static_cast<unsigned *>(buf.get());
+  float *pv = reinterpret_cast<float *>(pi + size);
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  ::top_k_dev<<<bs, ::TOP_K_BLOCK_SIZE, 0, STREAM>>>(
+      CDATA(x), x.shape().volume(), k, pi, pv);
+  CUDA_CALL(::cudaMemcpyAsync(
+        ids, pi, sizeof(unsigned) * size, cudaMemcpyDeviceToHost, STREAM));
+  CUDA_CALL(::cudaMemcpyAsync(
+        values, pv, sizeof(float) * size, cudaMemcpyDeviceToHost, STREAM));
+  CUDA_CALL(::cudaStreamSynchronize(STREAM));
+}
+
 }  // namespace primitiv
@@ -41,14 +41,190 @@ public:
    */
   CUDADevice(unsigned device_id, unsigned rng_seed);
 
+  /**
+   * Creates a new CUDA device.
+   * @param device_id ID of the physical GPU.
+   * @param rng_seed The seed value of the random number generator.
+   * @param strategy Strategy of the memory pool. Other constructors use
+   *                 `CUDAMemoryPool::ALLOCATION_STRATEGY_POWER_OF_TWO`.
+   * @remarks `CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT` wastes less memory
+   *          for tensors whose sizes are not powers of 2.
+   */
+  CUDADevice(
+      unsigned device_id, unsigned rng_seed,
+      CUDAMemoryPool::AllocationStrategy strategy);
+
   ~CUDADevice() override;
 
   Device::DeviceType type() const override { return Device::DEVICE_TYPE_CUDA; }
 
+  /**
+   * Retrieves the ID of the physical GPU.
+   * @return Device ID.
+   */
+  unsigned device_id() const { return dev_id_; }
+
+  MemoryPoolStats memory_pool_stats() const override { return pool_.stats(); }
+  void release_reserved_memory() override { pool_.release_reserved_blocks(); }
+  void synchronize() override;
+
+  /**
+   * Precision of inputs of matrix multiplications.
+   */
+  enum MatmulPrecision {
+    /**
+     * Calculates all products in single precision.
+     */
+    MATMUL_PRECISION_FLOAT32,
+
+    /**
+     * Rounds inputs to half precision and accumulates products in single
+     * precision using tensor cores.
+     */
+    MATMUL_PRECISION_FLOAT16,
+
+    /**
+     * Rounds inputs to bfloat16 and accumulates products in single precision
+     * using tensor cores.
+     */
+    MATMUL_PRECISION_BFLOAT16,
+  };
+
+  /**
+   * Retrieves the precision of matrix multiplications.
+   * @return Current precision.
+   */
+  MatmulPrecision matmul_precision() const;
+
+  /**
+   * Sets the precision of matrix multiplications used by `matmul` and
+   * `affine`. Tensors are always stored in single precision.
+   * @param precision New precision.
+   * @remarks Reduced precisions require CUDA 11 or later. Gradients passed
+   *          through them may underflow without the loss scaling of
+   *          `Trainer`.
+   */
+  void set_matmul_precision(MatmulPrecision precision);
+
+  /**
+   * Checks whether launch configurations of reductions are autotuned or not.
+   * @return true if autotuning is enabled, false otherwise.
+   */
+  bool reduction_autotuning() const;
+
+  /**
+   * Enables or disables autotuning of launch configurations of reductions
+   * used by `sum` and `logsumexp`.
+   * @param enabled If true, the first reduction for each combination of the
+   *                shape and the dimension measures all candidate kernels
+   *                and caches the fastest one in this device. If false
+   *                (default), kernels are chosen by a heuristic based on the
+   *                length and the number of rows.
+   * @remarks The measurement blocks the host until candidates finish, and is
+   *          skipped while capturing. Different kernels may add elements in
+   *          different orders.
+   */
+  void set_reduction_autotuning(bool enabled);
+
+  /**
+   * Makes operations issued to this device after this call wait for all
+   * operations issued to `other` before this call.
+   * The host is not blocked.
+   * @param other Device to be waited.
+   */
+  void wait_for(const CUDADevice &other);
+
+  /**
+   * Starts capturing operations issued to this device into a CUDA graph.
+   * Captured operations are not calculated until `replay()` is called.
+   * @remarks Capturing requires CUDA 10.1 or later, and the caller should
+   *          issue all operations of the capture from one thread.
+   *          Following operations can not be captured and throw `Error`:
+   *          transfers to the host, `synchronize()`, `wait_for()` and
+   *          copies between devices.
+   *          It is recommended to run the same operations once before the
+   *          capture, so that the memory pool and libraries do not need to
+   *          allocate new resources while capturing.
+   */
+  void begin_capture();
+
+  /**
+   * Finishes capturing and builds an executable graph.
+   * @return ID of the captured graph.
+   * @remarks All memories allocated by the captured operations are kept by
+   *          the graph until `clear_captures()` is called, so that replays
+   *          always access the same addresses. Values transferred from the
+   *          host (e.g., inputs made by `new_tensor_by_vector()` and indices
+   *          of `pick_fw()`) and random numbers are replayed as constants.
+   *          To give new inputs to replays, update tensors made before the
+   *          capture in place.
+   */
+  unsigned end_capture();
+
+  /**
+   * Issues all operations of a captured graph by one launch.
+   * @param id ID of the graph returned by `end_capture()`.
+   * @remarks Tensors made before the capture and used by captured operations
+   *          (e.g., parameters, gradients and inputs) should be alive and
+   *          should not be moved to other memories.
+   */
+  void replay(unsigned id);
+
+  /**
+   * Checks whether this device is capturing operations or not.
+   * @return true if `begin_capture()` was called and `end_capture()` is not
+   *         called yet, false otherwise.
+   */
+  bool capturing() const;
+
+  /**
+   * Retrieves the number of captured graphs.
+   * @return Number of graphs.
+   */
+  unsigned num_captures() const;
+
+  /**
+   * Releases all captured graphs and their memories.
+   * IDs returned by `end_capture()` become invalid.
+   */
+  void clear_captures();
+
 private:
+  /**
+   * Allocates a memory from the pool.
+   * @param size Size of the memory in bytes.
+   * @return Shared pointer of the memory, which is also kept by the current
+   *         capture if exists.
+   */
+  std::shared_ptr<void> allocate(std::uint64_t size);
+
+  /**
+   * Throws `Error` if this device is capturing operations.
+   * @param operation Name of the operation which can not be captured.
+   */
+  void check_not_capturing(const char *operation) const;
+
+  /**
+   * Internal method to calculate `sum_fw()` or `logsumexp_fw()` using the
+   * cached, autotuned or heuristic launch configuration.
+   * @param logsumexp Calculates logsumexp if true, or sum otherwise.
+   */
+  void reduction_fw(bool logsumexp, const Tensor &x, unsigned dim, Tensor &y);
+
+  /**
+   * Internal method to launch reduction kernels.
+   * @param logsumexp Calculates logsumexp if true, or sum otherwise.
+   * @param strategy Kind of kernels defined in the implementation.
+   * @param splits Number of parts of each row used by split reductions.
+   */
+  void launch_reduction(
+      bool logsumexp, const Tensor &x, unsigned dim, unsigned strategy,
+      unsigned splits, Tensor &y);
+
   std::shared_ptr<void> new_handle(const Shape &shape) override;
 
   std::vector<float> tensor_to_vector_impl(const Tensor &x) override;
+  void tensor_to_array_impl(const Tensor &x, float values[]) override;
 
   void reset_tensor_impl(float k, Tensor &x) override;
   void reset_tensor_by_array_impl(const float values[], Tensor &x) override;
@@ -61,10 +237,13 @@ private:
   void random_log_normal_impl(float mean, float sd, Tensor &y) override;
 
   void pick_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) override;
+  void gather_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) override;
   void slice_fw_impl(const Tensor &x, unsigned dim, unsigned offset, Tensor &y) override;
   void concat_fw_impl(const std::vector<const Tensor *> &xs, unsigned dim, Tensor &y) override;
 
   void pick_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) override;
+  void pick_assign_impl(const Tensor &y, unsigned dim, const std::vector<unsigned> &ids, Tensor &x) override;
+  void gather_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) override;
   void slice_bw_impl(const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx) override;
 
   void negate_fw_impl(const Tensor &x, Tensor &y) override;
@@ -135,8 +314,43 @@ private:
       const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy,
       Tensor &ga, Tensor &gb) override;
 
+  void affine_fw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b, Activation act,
+      Tensor &y) override;
+  void affine_bw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b,
+      const Tensor &y, const Tensor &gy, Activation act,
+      Tensor &gw, Tensor &gx, Tensor &gb) override;
+
+  void lstm_cell_fw_impl(
+      const Tensor &u, const Tensor &c, Tensor &y) override;
+  void lstm_cell_bw_impl(
+      const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+      Tensor &gu, Tensor &gc) override;
+  void lstm_fw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      Tensor &y) override;
+  void lstm_bw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      const Tensor &y, const Tensor &gy,
+      Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) override;
+
+  void quantized_matmul_fw_impl(
+      const QuantizedParameter &w, const Tensor &x, Tensor &y) override;
+  void batch_moments_fw_impl(
+      const Tensor &x, Tensor &mean, Tensor &var) override;
+  void batch_normalize_fw_impl(
+      const Tensor &x, const Tensor &mean, const Tensor &var, float eps,
+      Tensor &y) override;
+
+  void elementwise_fw_impl(
+      const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs,
+      Tensor &y) override;
+
   void sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
   void logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
+  void softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
+  void log_softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) override;
   void broadcast_fw_impl(const Tensor &x, unsigned dim, unsigned size, Tensor &y) override;
   void batch_sum_fw_impl(const Tensor &x, Tensor &y) override;
 
@@ -145,6 +359,35 @@ private:
   void inplace_add_impl(const Tensor &x, Tensor &y) override;
   void inplace_subtract_impl(const Tensor &x, Tensor &y) override;
 
+  void sgd_update_impl(float eta, const Tensor &g, Tensor &x) override;
+  void momentum_sgd_update_impl(
+      float eta, float momentum, const Tensor &g, Tensor &m,
+      Tensor &x) override;
+  void adam_update_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) override;
+  void sgd_update_multi_impl(
+      float eta,
+      const std::vector<const Tensor *> &gs,
+      const std::vector<Tensor *> &xs) override;
+  void momentum_sgd_update_multi_impl(
+      float eta, float momentum,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+      const std::vector<Tensor *> &xs) override;
+  void adam_update_multi_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+      const std::vector<Tensor *> &m2s,
+      const std::vector<Tensor *> &xs) override;
+  void squared_norm_multi_impl(
+      const std::vector<const Tensor *> &xs, Tensor &y) override;
+  void clip_by_norm_multi_impl(
+      float max_norm, const Tensor &sq_norm,
+      const std::vector<Tensor *> &xs) override;
+
+  void top_k_impl(
+      const Tensor &x, unsigned k, unsigned ids[], float values[]) override;
+
 private:
   unsigned dev_id_;
   unsigned rng_seed_;
@@ -152,18 +395,28 @@ private:
   unsigned dim2_x_;
   unsigned dim2_y_;
   unsigned max_batch_;
+  unsigned num_sms_;
   CUDAMemoryPool pool_;
   std::unique_ptr<CUDAInternalState> state_;
 
-  // Reserved pointer to store integer IDs.
-  // This member holds a pointer provided from `pool_`, and should be declared
-  // after `pool_` due to the order of member destruction.
-  std::shared_ptr<void> ids_ptr_;
-
   /**
    * Internal method to initialize the object.
    */
   void initialize();
+
+  /**
+   * Internal method to transfer the table used by multi-tensor kernels.
+   * @param ptrs Pointers to the operands. `ptrs[j * n + t]` is the `j`-th
+   *             operand of the `t`-th tensor.
+   * @param sizes Number of elements of each tensor.
+   * @param params Additional parameters. `params[j * n + t]` is the `j`-th
+   *               parameter of the `t`-th tensor.
+   * @param num_blocks Number of thread blocks to be launched.
+   * @return Device memory of the table.
+   */
+  std::shared_ptr<void> upload_multi_tensor_table(
+      const std::vector<float *> &ptrs, const std::vector<unsigned> &sizes,
+      const std::vector<unsigned> &params, unsigned &num_blocks);
 };
 
 }  // namespace primitiv
@@ -1,20 +1,56 @@
 #include <config.h>
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <thread>
 #include <primitiv/cuda_memory_pool.h>
 #include <primitiv/cuda_utils.h>
 #include <primitiv/error.h>
 
 using std::cerr;
 using std::endl;
-using std::make_pair;
+
+namespace {
+
+// Available maximum size of the memory is 2^MAX_SCALE bytes.
+const unsigned MAX_SCALE = 63;
+
+}  // namespace
 
 namespace primitiv {
 
+const std::uint64_t CUDAMemoryPool::SEGMENT_SIZE;
+const std::uint64_t CUDAMemoryPool::BLOCK_ALIGNMENT;
+const unsigned CUDAMemoryPool::NUM_THREAD_CACHES;
+const unsigned CUDAMemoryPool::MAX_CACHED_SCALE;
+const unsigned CUDAMemoryPool::MAX_CACHED_BLOCKS;
+
+/**
+ * Reserved blocks used by a subset of threads.
+ */
+struct CUDAMemoryPool::ThreadCache {
+  std::mutex mutex;
+  std::vector<std::vector<void *>> blocks;
+  ThreadCache() : blocks(MAX_CACHED_SCALE + 1) {}
+};
+
 CUDAMemoryPool::CUDAMemoryPool(unsigned device_id)
+: CUDAMemoryPool(device_id, ALLOCATION_STRATEGY_POWER_OF_TWO) {}
+
+CUDAMemoryPool::CUDAMemoryPool(
+    unsigned device_id, AllocationStrategy strategy)
 : dev_id_(device_id)
-, reserved_(64)
-, supplied_() {
+, strategy_(strategy)
+, caches_()
+, reserved_(::MAX_SCALE + 1)
+, arena_(BLOCK_ALIGNMENT)
+, bytes_in_use_(0)
+, peak_bytes_in_use_(0)
+, num_requests_(0)
+, num_hits_(0)
+, num_system_allocs_(0)
+, num_oom_retries_(0) {
   // Retrieves device properties.
   int max_devs;
   CUDA_CALL(::cudaGetDeviceCount(&max_devs));
@@ -23,69 +59,214 @@ CUDAMemoryPool::CUDAMemoryPool(unsigned device_id)
         "Invalid CUDA device ID. given: " << dev_id_
         << " >= #devices: " << max_devs);
   }
+  for (unsigned i = 0; i < NUM_THREAD_CACHES; ++i) {
+    caches_.emplace_back(new ThreadCache());
+  }
 }
 
 CUDAMemoryPool::~CUDAMemoryPool() {
-  if (!supplied_.empty()) {
+  if (bytes_in_use_ > 0) {
     cerr << "FATAL ERROR: Detected memory leak on CUDA device!" << endl;
-    cerr << "Leaked blocks (handle: size):" << endl;
-    for (const auto &kv : supplied_) {
-      cerr << "  " << kv.first << ": " << kv.second << endl;
-    }
+    cerr << "  Leaked: " << bytes_in_use_ << " bytes" << endl;
     std::abort();
   }
   release_reserved_blocks();
 }
 
+CUDAMemoryPool::ThreadCache &CUDAMemoryPool::local_cache() {
+  const std::size_t h = std::hash<std::thread::id>()(
+      std::this_thread::get_id());
+  return *caches_[h % NUM_THREAD_CACHES];
+}
+
+void CUDAMemoryPool::add_bytes_in_use(std::uint64_t size) {
+  const std::uint64_t cur = bytes_in_use_ += size;
+  std::uint64_t peak = peak_bytes_in_use_;
+  while (peak < cur && !peak_bytes_in_use_.compare_exchange_weak(peak, cur));
+}
+
 void CUDAMemoryPool::release_reserved_blocks() {
-  for (auto &ptrs : reserved_) {
-    while (!ptrs.empty()) {
-      CUDA_CALL(::cudaFree(ptrs.back()));
-      ptrs.pop_back();
+  for (auto &cache : caches_) {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    for (auto &ptrs : cache->blocks) {
+      while (!ptrs.empty()) {
+        CUDA_CALL(::cudaFree(ptrs.back()));
+        ptrs.pop_back();
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    for (auto &ptrs : reserved_) {
+      while (!ptrs.empty()) {
+        CUDA_CALL(::cudaFree(ptrs.back()));
+        ptrs.pop_back();
+      }
     }
   }
+  {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    release_free_segments_unsafe();
+  }
+}
+
+void CUDAMemoryPool::release_free_segments_unsafe() {
+  for (void *ptr : arena_.remove_free_segments()) {
+    CUDA_CALL(::cudaFree(ptr));
+  }
+}
+
+MemoryPoolStats CUDAMemoryPool::stats() const {
+  MemoryPoolStats ret;
+  ret.num_requests = num_requests_;
+  ret.num_hits = num_hits_;
+  ret.num_system_allocs = num_system_allocs_;
+  ret.num_oom_retries = num_oom_retries_;
+  ret.peak_bytes_in_use = peak_bytes_in_use_;
+  if (strategy_ == ALLOCATION_STRATEGY_BEST_FIT) {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    ret.bytes_in_use = arena_.bytes_in_use();
+    ret.bytes_reserved = arena_.bytes_total() - arena_.bytes_in_use();
+  } else {
+    ret.bytes_in_use = bytes_in_use_;
+    ret.reserved_bytes_by_scale.assign(reserved_.size(), 0);
+    for (const auto &cache : caches_) {
+      std::lock_guard<std::mutex> lock(cache->mutex);
+      for (unsigned i = 0; i < cache->blocks.size(); ++i) {
+        ret.reserved_bytes_by_scale[i] +=
+          static_cast<std::uint64_t>(cache->blocks[i].size()) << i;
+      }
+    }
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    ret.bytes_reserved = 0;
+    for (unsigned i = 0; i < reserved_.size(); ++i) {
+      ret.reserved_bytes_by_scale[i] +=
+        static_cast<std::uint64_t>(reserved_[i].size()) << i;
+      ret.bytes_reserved += ret.reserved_bytes_by_scale[i];
+    }
+  }
+  return ret;
 }
 
 std::shared_ptr<void> CUDAMemoryPool::allocate(std::uint64_t size) {
-  static const unsigned MAX_SCALE = 63;
+  if (strategy_ == ALLOCATION_STRATEGY_BEST_FIT) {
+    void *ptr = allocate_best_fit(size);
+    ++num_requests_;
+    return std::shared_ptr<void>(ptr, CUDAMemoryDeleter(*this, 0));
+  }
+
   unsigned scale = 0;
   while (1ull << scale < size) {
-    if (scale == MAX_SCALE) {
+    if (scale == ::MAX_SCALE) {
       THROW_ERROR(
-          "Attempted to allocate more than 2^" << MAX_SCALE << " bytes.");
+          "Attempted to allocate more than 2^" << ::MAX_SCALE << " bytes.");
     }
     ++scale;
   }
+  void *ptr = allocate_power_of_two(scale);
+  ++num_requests_;
+  add_bytes_in_use(1ull << scale);
+  return std::shared_ptr<void>(ptr, CUDAMemoryDeleter(*this, scale));
+}
+
+void *CUDAMemoryPool::allocate_power_of_two(unsigned scale) {
+  void *ptr = nullptr;
 
-  void *ptr;
-  if (reserved_[scale].empty()) {
-    // Allocates a new block.
+  // Looks up the thread-local cache at first, and the shared list next.
+  if (scale <= MAX_CACHED_SCALE) {
+    ThreadCache &cache = local_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto &ptrs = cache.blocks[scale];
+    if (!ptrs.empty()) {
+      ptr = ptrs.back();
+      ptrs.pop_back();
+    }
+  }
+  if (!ptr) {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    auto &ptrs = reserved_[scale];
+    if (!ptrs.empty()) {
+      ptr = ptrs.back();
+      ptrs.pop_back();
+    }
+  }
+  if (ptr) {
+    ++num_hits_;
+    return ptr;
+  }
+
+  // Allocates a new block.
+  CUDA_CALL(::cudaSetDevice(dev_id_));
+  if (::cudaMalloc(&ptr, 1ull << scale) != ::cudaSuccess) {
+    // Maybe out-of-memory.
+    // Release other blocks and try allocation again.
+    ++num_oom_retries_;
+    release_reserved_blocks();
+    CUDA_CALL(::cudaMalloc(&ptr, 1ull << scale));
+  }
+  ++num_system_allocs_;
+  return ptr;
+}
+
+void *CUDAMemoryPool::allocate_best_fit(std::uint64_t size) {
+  static const std::uint64_t MAX_SIZE = 1ull << ::MAX_SCALE;
+  if (size > MAX_SIZE) {
+    THROW_ERROR("Attempted to allocate more than 2^63 bytes.");
+  }
+
+  std::lock_guard<std::mutex> lock(arena_mutex_);
+  void *ptr = arena_.allocate(size);
+  if (!ptr) {
+    // Adds a new segment which is large enough to store the block.
+    const std::uint64_t min_size = arena_.round_up(size);
+    std::uint64_t seg_size = std::max(SEGMENT_SIZE, min_size);
+    void *seg;
     CUDA_CALL(::cudaSetDevice(dev_id_));
-    if (::cudaMalloc(&ptr, 1ull << scale) != ::cudaSuccess) {
+    if (::cudaMalloc(&seg, seg_size) != ::cudaSuccess) {
       // Maybe out-of-memory.
-      // Release other blocks and try allocation again.
-      release_reserved_blocks();
-      CUDA_CALL(::cudaMalloc(&ptr, 1ull << scale));
+      // Release unused segments and try allocation again with the minimum
+      // size.
+      ++num_oom_retries_;
+      release_free_segments_unsafe();
+      seg_size = min_size;
+      CUDA_CALL(::cudaMalloc(&seg, seg_size));
     }
-    supplied_.insert(make_pair(ptr, scale));
+    ++num_system_allocs_;
+    arena_.add_segment(seg, seg_size);
+    ptr = arena_.allocate(size);
   } else {
-    // Returns an existing block.
-    ptr = reserved_[scale].back();
-    reserved_[scale].pop_back();
-    supplied_.insert(make_pair(ptr, scale));
+    ++num_hits_;
   }
 
-  return std::shared_ptr<void>(ptr, CUDAMemoryDeleter(*this));
+  bytes_in_use_ = arena_.bytes_in_use();
+  std::uint64_t peak = peak_bytes_in_use_;
+  peak_bytes_in_use_ = std::max(peak, arena_.bytes_in_use());
+  return ptr;
 }
 
-void CUDAMemoryPool::free(void *ptr) {
-  auto it = supplied_.find(ptr);
-  if (it == supplied_.end()) {
-    THROW_ERROR("Detected to dispose unknown handle: " << ptr);
+void CUDAMemoryPool::free(void *ptr, unsigned scale) {
+  if (strategy_ == ALLOCATION_STRATEGY_BEST_FIT) {
+    std::lock_guard<std::mutex> lock(arena_mutex_);
+    arena_.free(ptr);
+    bytes_in_use_ = arena_.bytes_in_use();
+    return;
   }
 
-  reserved_[it->second].emplace_back(ptr);
-  supplied_.erase(it);
+  bytes_in_use_ -= 1ull << scale;
+
+  // Keeps the block in the thread-local cache if possible, otherwise spills
+  // it to the shared list.
+  if (scale <= MAX_CACHED_SCALE) {
+    ThreadCache &cache = local_cache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto &ptrs = cache.blocks[scale];
+    if (ptrs.size() < MAX_CACHED_BLOCKS) {
+      ptrs.emplace_back(ptr);
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(shared_mutex_);
+  reserved_[scale].emplace_back(ptr);
 }
 
-}  // namespace
+}  // namespace primitiv
@@ -1,10 +1,13 @@
 #ifndef PRIMITIV_CUDA_MEMORY_POOL_H_
 #define PRIMITIV_CUDA_MEMORY_POOL_H_
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
 #include <vector>
+#include <primitiv/arena_allocator.h>
+#include <primitiv/memory_pool_stats.h>
 
 namespace primitiv {
 
@@ -12,6 +15,9 @@ class CUDAMemoryDeleter;
 
 /**
  * Memory manager on the CUDA devices.
+ * All public member functions are thread-safe.
+ * In `ALLOCATION_STRATEGY_POWER_OF_TWO`, small blocks are cached for each
+ * thread, and exceeded blocks are spilled to the list shared by all threads.
  */
 class CUDAMemoryPool {
   friend CUDAMemoryDeleter;
@@ -23,12 +29,37 @@ class CUDAMemoryPool {
   CUDAMemoryPool &operator=(CUDAMemoryPool &&) = delete;
 
 public:
+  /**
+   * Strategies to manage memory blocks.
+   */
+  enum AllocationStrategy {
+    /**
+     * Rounds up each request to the power of 2 and reuses blocks with the
+     * same size.
+     */
+    ALLOCATION_STRATEGY_POWER_OF_TWO,
+
+    /**
+     * Carves variable-size blocks out of large segments using best-fit with
+     * block splitting and coalescing.
+     */
+    ALLOCATION_STRATEGY_BEST_FIT,
+  };
+
   /**
    * Creates a memory pool.
    * @param device_id CUDA Device ID on which memories are stored.
+   * @remarks This constructor uses `ALLOCATION_STRATEGY_POWER_OF_TWO`.
    */
   explicit CUDAMemoryPool(unsigned device_id);
 
+  /**
+   * Creates a memory pool.
+   * @param device_id CUDA Device ID on which memories are stored.
+   * @param strategy Strategy to manage memory blocks.
+   */
+  CUDAMemoryPool(unsigned device_id, AllocationStrategy strategy);
+
   ~CUDAMemoryPool();
 
   /**
@@ -38,21 +69,112 @@ public:
    */
   std::shared_ptr<void> allocate(std::uint64_t size);
 
+  /**
+   * Retrieves the allocation strategy of this pool.
+   * @return Strategy to manage memory blocks.
+   */
+  AllocationStrategy strategy() const { return strategy_; }
+
+  /**
+   * Releases all reserved memory blocks.
+   * @remarks Memories which are currently used are not affected.
+   */
+  void release_reserved_blocks();
+
+  /**
+   * Retrieves the current usage of the pool.
+   * @return Statistics of this pool. `reserved_bytes_by_scale` is empty if the
+   *         strategy is `ALLOCATION_STRATEGY_BEST_FIT`.
+   */
+  MemoryPoolStats stats() const;
+
+  /**
+   * Minimum size of each segment allocated in `ALLOCATION_STRATEGY_BEST_FIT`.
+   */
+  static const std::uint64_t SEGMENT_SIZE = 1ull << 26;
+
+  /**
+   * Alignment of blocks allocated in `ALLOCATION_STRATEGY_BEST_FIT`.
+   */
+  static const std::uint64_t BLOCK_ALIGNMENT = 256;
+
+  /**
+   * Number of thread-local caches. Threads are assigned to caches by the
+   * hash value of their IDs.
+   */
+  static const unsigned NUM_THREAD_CACHES = 16;
+
+  /**
+   * Blocks with at most 2^MAX_CACHED_SCALE bytes are cached for each thread.
+   */
+  static const unsigned MAX_CACHED_SCALE = 22;
+
+  /**
+   * Maximum number of blocks with the same size in each thread-local cache.
+   */
+  static const unsigned MAX_CACHED_BLOCKS = 16;
+
 private:
+  struct ThreadCache;
+
   /**
    * Disposes the memory.
    * @param ptr Handle of the memory to be disposed.
+   * @param scale Size of the memory in log2, or undefined in
+   *              `ALLOCATION_STRATEGY_BEST_FIT`.
    */
-  void free(void *ptr);
+  void free(void *ptr, unsigned scale);
 
   /**
-   * Releases all reserved memory blocks.
+   * Retrieves the cache assigned to the current thread.
+   * @return Cache object.
    */
-  void release_reserved_blocks();
+  ThreadCache &local_cache();
+
+  /**
+   * Updates `bytes_in_use_` and `peak_bytes_in_use_`.
+   * @param size Size of the supplied memory.
+   */
+  void add_bytes_in_use(std::uint64_t size);
+
+  /**
+   * Releases all segments with no allocated blocks.
+   * @remarks `arena_mutex_` should be locked by the caller.
+   */
+  void release_free_segments_unsafe();
+
+  /**
+   * Allocates a memory using `ALLOCATION_STRATEGY_POWER_OF_TWO`.
+   * @param scale Size of the resulting memory in log2.
+   * @return Pointer to the allocated memory.
+   */
+  void *allocate_power_of_two(unsigned scale);
+
+  /**
+   * Allocates a memory using `ALLOCATION_STRATEGY_BEST_FIT`.
+   * @param size Size of the resulting memory.
+   * @return Pointer to the allocated memory.
+   */
+  void *allocate_best_fit(std::uint64_t size);
 
   unsigned dev_id_;
+  AllocationStrategy strategy_;
+
+  // Blocks for ALLOCATION_STRATEGY_POWER_OF_TWO.
+  std::vector<std::unique_ptr<ThreadCache>> caches_;
+  mutable std::mutex shared_mutex_;
   std::vector<std::vector<void *>> reserved_;
-  std::unordered_map<void *, unsigned> supplied_;
+
+  // Segments for ALLOCATION_STRATEGY_BEST_FIT.
+  mutable std::mutex arena_mutex_;
+  ArenaAllocator arena_;
+
+  std::atomic<std::uint64_t> bytes_in_use_;
+  std::atomic<std::uint64_t> peak_bytes_in_use_;
+  std::atomic<std::uint64_t> num_requests_;
+  std::atomic<std::uint64_t> num_hits_;
+  std::atomic<std::uint64_t> num_system_allocs_;
+  std::atomic<std::uint64_t> num_oom_retries_;
 };
 
 /**
@@ -61,10 +183,12 @@ private:
 class CUDAMemoryDeleter {
   CUDAMemoryDeleter() = delete;
 public:
-  explicit CUDAMemoryDeleter(CUDAMemoryPool &pool) : pool_(pool) {}
-  void operator()(void *ptr) { pool_.free(ptr); }
+  CUDAMemoryDeleter(CUDAMemoryPool &pool, unsigned scale)
+    : pool_(pool), scale_(scale) {}
+  void operator()(void *ptr) { pool_.free(ptr, scale_); }
 private:
   CUDAMemoryPool &pool_;
+  unsigned scale_;
 };
 
 }  // namespace primitiv
@@ -0,0 +1,186 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <primitiv/binary_io.h>
+#include <primitiv/data_loader.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+
+using std::string;
+using std::vector;
+
+namespace primitiv {
+
+DataLoader::DataLoader(
+    const vector<string> &paths, const vector<Shape> &fields,
+    Device &device, unsigned batch_size, bool shuffle, unsigned seed,
+    unsigned num_threads, unsigned capacity, std::uint64_t header_size)
+: fields_(fields)
+, device_(device)
+, batch_size_(batch_size)
+, shuffle_(shuffle)
+, seed_(seed)
+, capacity_(capacity)
+, header_size_(header_size)
+, record_size_(0)
+, num_samples_(0)
+, num_batches_(0)
+, next_claim_(0)
+, next_deliver_(0)
+, epoch_finished_(false)
+, stop_(false) {
+  if (fields.empty()) THROW_ERROR("No fields are specified.");
+  if (batch_size == 0 || num_threads == 0 || capacity == 0) {
+    THROW_ERROR(
+        "Invalid DataLoader settings. batch_size: " << batch_size
+        << ", num_threads: " << num_threads << ", capacity: " << capacity);
+  }
+  for (const Shape &s : fields) {
+    if (s.has_batch()) {
+      THROW_ERROR("Shape of each field should not have the batch: "
+          << s.to_string());
+    }
+    record_size_ += sizeof(float) * s.size();
+  }
+
+  shard_offsets_.emplace_back(0);
+  for (const string &path : paths) {
+    files_.emplace_back(new MappedFile(path));
+    const std::uint64_t size = files_.back()->size();
+    if (size < header_size || (size - header_size) % record_size_ != 0) {
+      THROW_ERROR(
+          "Invalid size of shard: " << path << ", size: " << size
+          << ", header_size: " << header_size
+          << ", record_size: " << record_size_);
+    }
+    num_samples_ += (size - header_size) / record_size_;
+    shard_offsets_.emplace_back(num_samples_);
+  }
+  if (num_samples_ == 0) THROW_ERROR("Shards have no samples.");
+  num_batches_ = (num_samples_ + batch_size - 1) / batch_size;
+
+  for (unsigned i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&DataLoader::worker_loop, this);
+  }
+}
+
+DataLoader::~DataLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_claim_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+bool DataLoader::next(vector<Tensor> &batch) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (next_deliver_ > 0 && next_deliver_ % num_batches_ == 0 &&
+      !epoch_finished_) {
+    epoch_finished_ = true;
+    return false;
+  }
+  epoch_finished_ = false;
+  cv_ready_.wait(lock, [this] {
+      return error_ || ready_.find(next_deliver_) != ready_.end();
+  });
+  const auto it = ready_.find(next_deliver_);
+  if (it == ready_.end()) std::rethrow_exception(error_);
+  batch = std::move(it->second);
+  ready_.erase(it);
+  ++next_deliver_;
+
+  // No worker uses the order of epochs that all minibatches are delivered.
+  while (!epochs_.empty() &&
+      (epochs_.front().id + 1) * num_batches_ <= next_deliver_) {
+    epochs_.pop_front();
+  }
+  lock.unlock();
+  cv_claim_.notify_all();
+  return true;
+}
+
+const vector<std::uint64_t> &DataLoader::epoch_order(std::uint64_t epoch) {
+  for (const Epoch &e : epochs_) {
+    if (e.id == epoch) return e.order;
+  }
+  // Epochs are always requested in the ascending order.
+  epochs_.push_back(Epoch {epoch, vector<std::uint64_t>(num_samples_)});
+  vector<std::uint64_t> &order = epochs_.back().order;
+  for (std::uint64_t i = 0; i < num_samples_; ++i) order[i] = i;
+  if (shuffle_) {
+    std::seed_seq seq {
+      seed_,
+      static_cast<unsigned>(epoch),
+      static_cast<unsigned>(epoch >> 32),
+    };
+    std::mt19937_64 rng(seq);
+    std::shuffle(order.begin(), order.end(), rng);
+  }
+  return order;
+}
+
+const char *DataLoader::record(std::uint64_t sample) const {
+  const auto it = std::upper_bound(
+      shard_offsets_.begin(), shard_offsets_.end(), sample);
+  const unsigned shard = it - shard_offsets_.begin() - 1;
+  return files_[shard]->data() + header_size_ +
+    (sample - shard_offsets_[shard]) * record_size_;
+}
+
+vector<Tensor> DataLoader::assemble(
+    const vector<std::uint64_t> &order, std::uint64_t batch) const {
+  const std::uint64_t begin = batch * batch_size_;
+  const std::uint64_t end =
+    std::min<std::uint64_t>(begin + batch_size_, num_samples_);
+  const unsigned n = end - begin;
+
+  vector<const char *> records(n);
+  for (unsigned j = 0; j < n; ++j) records[j] = record(order[begin + j]);
+
+  vector<Tensor> ret;
+  ret.reserve(fields_.size());
+  vector<float> buf;
+  unsigned offset = 0;
+  for (const Shape &s : fields_) {
+    const unsigned size = s.size();
+    buf.resize(n * size);
+    for (unsigned j = 0; j < n; ++j) {
+      std::memcpy(
+          &buf[j * size], records[j] + offset, sizeof(float) * size);
+    }
+    // CUDADevice uploads small tensors through its pinned staging buffers.
+    ret.emplace_back(device_.new_tensor_by_array(s.resize_batch(n), &buf[0]));
+    offset += sizeof(float) * size;
+  }
+  return ret;
+}
+
+void DataLoader::worker_loop() {
+  for (;;) {
+    std::uint64_t id;
+    const vector<std::uint64_t> *order;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_claim_.wait(lock, [this] {
+          return stop_ || next_claim_ < next_deliver_ + capacity_;
+      });
+      if (stop_ || error_) return;
+      id = next_claim_++;
+      order = &epoch_order(id / num_batches_);
+    }
+    try {
+      vector<Tensor> batch = assemble(*order, id % num_batches_);
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.emplace(id, std::move(batch));
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+    cv_ready_.notify_all();
+  }
+}
+
+}  // namespace primitiv
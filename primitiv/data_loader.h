@@ -0,0 +1,151 @@
+#ifndef PRIMITIV_DATA_LOADER_H_
+#define PRIMITIV_DATA_LOADER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <primitiv/shape.h>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class Device;
+class MappedFile;
+
+/**
+ * Reader of minibatches from binary shard files, which assembles batches on
+ * background threads.
+ *
+ * Each shard consists of an optional header of `header_size` bytes followed by
+ * fixed-size records. A record is the concatenation of the values of all
+ * fields as 32-bit floats in the native byte order, where the i-th field has
+ * `fields[i].size()` values in the column-major order.
+ * Shards are memory-mapped, so that only the records in use are loaded.
+ */
+class DataLoader {
+  DataLoader() = delete;
+  DataLoader(const DataLoader &) = delete;
+  DataLoader(DataLoader &&) = delete;
+  DataLoader &operator=(const DataLoader &) = delete;
+  DataLoader &operator=(DataLoader &&) = delete;
+
+public:
+  /**
+   * Creates a new DataLoader object and starts background threads.
+   * @param paths List of shard files.
+   * @param fields Shapes of one sample of each field. The batch sizes of
+   *               these shapes should be 1.
+   * @param device Device of resulting tensors.
+   * @param batch_size Number of samples in each minibatch. The last minibatch
+   *                   of each epoch may have less samples.
+   * @param shuffle Whether to visit samples in a different random order for
+   *                each epoch or not.
+   * @param seed Seed of the random order.
+   * @param num_threads Number of threads to assemble minibatches.
+   * @param capacity Maximum number of minibatches which are assembled or
+   *                 ready in advance.
+   * @param header_size Number of bytes skipped at the head of each shard.
+   */
+  DataLoader(
+      const std::vector<std::string> &paths, const std::vector<Shape> &fields,
+      Device &device, unsigned batch_size, bool shuffle, unsigned seed = 0,
+      unsigned num_threads = 1, unsigned capacity = 4,
+      std::uint64_t header_size = 0);
+
+  ~DataLoader();
+
+  /**
+   * Retrieves the number of samples in all shards.
+   * @return Number of samples.
+   */
+  std::uint64_t num_samples() const { return num_samples_; }
+
+  /**
+   * Retrieves the number of minibatches in each epoch.
+   * @return Number of minibatches.
+   */
+  std::uint64_t num_batches() const { return num_batches_; }
+
+  /**
+   * Retrieves the next minibatch.
+   * @param batch Output list of tensors. `batch[i]` holds the i-th field of
+   *              all samples in the minibatch.
+   * @return true if a minibatch is retrieved, false if the current epoch has
+   *         finished. The next call retrieves the first minibatch of the next
+   *         epoch.
+   * @remarks This function blocks until the minibatch becomes ready, and
+   *          rethrows errors occurred in background threads.
+   */
+  bool next(std::vector<Tensor> &batch);
+
+private:
+  /**
+   * Samples of one epoch in the visiting order.
+   */
+  struct Epoch {
+    std::uint64_t id;
+    std::vector<std::uint64_t> order;
+  };
+
+  /**
+   * Obtains the order of samples of the given epoch.
+   * Must be called while holding `mutex_`.
+   * @param epoch Epoch ID.
+   * @return Order of samples, which is valid until the epoch finishes.
+   */
+  const std::vector<std::uint64_t> &epoch_order(std::uint64_t epoch);
+
+  /**
+   * Retrieves the head of the given record.
+   * @param sample Index of the sample over all shards.
+   * @return Pointer to the first byte of the record.
+   */
+  const char *record(std::uint64_t sample) const;
+
+  /**
+   * Assembles one minibatch.
+   * @param order Order of samples of the epoch.
+   * @param batch Index of the minibatch in the epoch.
+   * @return List of tensors of each field.
+   */
+  std::vector<Tensor> assemble(
+      const std::vector<std::uint64_t> &order, std::uint64_t batch) const;
+
+  void worker_loop();
+
+  std::vector<std::unique_ptr<MappedFile>> files_;
+  std::vector<std::uint64_t> shard_offsets_;
+  std::vector<Shape> fields_;
+  Device &device_;
+  unsigned batch_size_;
+  bool shuffle_;
+  unsigned seed_;
+  unsigned capacity_;
+  std::uint64_t header_size_;
+  unsigned record_size_;
+  std::uint64_t num_samples_;
+  std::uint64_t num_batches_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable cv_claim_;
+  std::condition_variable cv_ready_;
+  std::deque<Epoch> epochs_;
+  std::map<std::uint64_t, std::vector<Tensor>> ready_;
+  std::uint64_t next_claim_;
+  std::uint64_t next_deliver_;
+  bool epoch_finished_;
+  bool stop_;
+  std::exception_ptr error_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_DATA_LOADER_H_
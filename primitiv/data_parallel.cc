@@ -0,0 +1,297 @@
+#include <config.h>
+
+#include <algorithm>
+#include <utility>
+#include <primitiv/data_parallel.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+#include <primitiv/parameter.h>
+#include <primitiv/thread_pool.h>
+
+#ifdef PRIMITIV_USE_NCCL
+#include <nccl.h>
+#include <primitiv/cuda_device.h>
+#include <primitiv/cuda_utils.h>
+
+#define NCCL_CALL(f) { \
+  ::ncclResult_t err = (f); \
+  if (err != ::ncclSuccess) { \
+    THROW_ERROR( \
+        "NCCL function failed. statement: " << #f \
+        << ", error: " << err \
+        << ": " << ::ncclGetErrorString(err)); \
+  } \
+}
+#endif  // PRIMITIV_USE_NCCL
+
+using std::vector;
+
+namespace primitiv {
+
+/*
+ * Backend to reduce buffers over devices.
+ */
+struct DataParallelReducer {
+  virtual ~DataParallelReducer() = default;
+
+  /*
+   * Replaces `buffers[b][d]` with the sum of `buffers[b][*]` multiplied by
+   * `scale` for every bucket `b`, where `d` is the index of the device.
+   */
+  virtual void allreduce(
+      const vector<vector<Tensor *>> &buffers, float scale) = 0;
+};
+
+}  // namespace primitiv
+
+namespace {
+
+using primitiv::DataParallelReducer;
+using primitiv::Device;
+using primitiv::Tensor;
+
+// Minimum number of elements processed by each thread.
+const unsigned PARALLEL_GRAIN = 1 << 14;
+
+// Reduces buffers through the host memory. This works with any devices.
+struct HostReducer : public DataParallelReducer {
+  void allreduce(
+      const vector<vector<Tensor *>> &buffers, float scale) override {
+    for (const vector<Tensor *> &xs : buffers) {
+      vector<float> sum = xs[0]->to_vector();
+      for (unsigned d = 1; d < xs.size(); ++d) {
+        const vector<float> src = xs[d]->to_vector();
+        for (unsigned i = 0; i < sum.size(); ++i) sum[i] += src[i];
+      }
+      for (float &x : sum) x *= scale;
+      for (Tensor *x : xs) x->reset_by_vector(sum);
+    }
+  }
+};
+
+// Reduces buffers on CPU devices directly in the shared memory.
+// Each thread reduces a different range of elements over all devices and
+// writes the result back to all devices, which is equivalent to the
+// reduce-scatter and all-gather steps of the ring algorithm.
+struct SharedMemoryReducer : public DataParallelReducer {
+  explicit SharedMemoryReducer(unsigned num_devices) : pool(num_devices) {}
+
+  void allreduce(
+      const vector<vector<Tensor *>> &buffers, float scale) override {
+    for (const vector<Tensor *> &xs : buffers) {
+      vector<float *> ptrs;
+      for (Tensor *x : xs) ptrs.emplace_back(static_cast<float *>(x->data()));
+      pool.parallel_for(
+          xs[0]->shape().size(), ::PARALLEL_GRAIN,
+          [&](unsigned begin, unsigned end) {
+            for (unsigned i = begin; i < end; ++i) {
+              float sum = 0;
+              for (const float *p : ptrs) sum += p[i];
+              sum *= scale;
+              for (float *p : ptrs) p[i] = sum;
+            }
+          });
+    }
+  }
+
+  primitiv::ThreadPool pool;
+};
+
+#ifdef PRIMITIV_USE_NCCL
+// Reduces buffers on CUDA devices using NCCL.
+struct NCCLReducer : public DataParallelReducer {
+  explicit NCCLReducer(const vector<Device *> &devices)
+    : devices(devices), comms(devices.size()), streams(devices.size()) {
+    vector<int> ids;
+    for (Device *dev : devices) {
+      ids.emplace_back(static_cast<primitiv::CUDADevice *>(dev)->device_id());
+    }
+    NCCL_CALL(::ncclCommInitAll(&comms[0], ids.size(), &ids[0]));
+    for (unsigned d = 0; d < ids.size(); ++d) {
+      CUDA_CALL(::cudaSetDevice(ids[d]));
+      CUDA_CALL(::cudaStreamCreate(&streams[d]));
+    }
+  }
+
+  ~NCCLReducer() override {
+    for (unsigned d = 0; d < devices.size(); ++d) {
+      ::cudaStreamDestroy(streams[d]);
+      ::ncclCommDestroy(comms[d]);
+    }
+  }
+
+  void allreduce(
+      const vector<vector<Tensor *>> &buffers, float scale) override {
+    // Gradients should be calculated before the reduction.
+    for (Device *dev : devices) dev->synchronize();
+    NCCL_CALL(::ncclGroupStart());
+    for (const vector<Tensor *> &xs : buffers) {
+      for (unsigned d = 0; d < xs.size(); ++d) {
+        float *ptr = static_cast<float *>(xs[d]->data());
+        NCCL_CALL(::ncclAllReduce(
+              ptr, ptr, xs[d]->shape().size(), ::ncclFloat, ::ncclSum,
+              comms[d], streams[d]));
+      }
+    }
+    NCCL_CALL(::ncclGroupEnd());
+    for (unsigned d = 0; d < devices.size(); ++d) {
+      CUDA_CALL(::cudaStreamSynchronize(streams[d]));
+    }
+    for (const vector<Tensor *> &xs : buffers) {
+      for (Tensor *x : xs) *x *= scale;
+    }
+  }
+
+  vector<Device *> devices;
+  vector<::ncclComm_t> comms;
+  vector<::cudaStream_t> streams;
+};
+#endif  // PRIMITIV_USE_NCCL
+
+// Selects the fastest backend available for the devices.
+std::unique_ptr<DataParallelReducer> make_reducer(
+    const vector<Device *> &devices) {
+  auto all_of_type = [&](Device::DeviceType type) {
+    return std::all_of(
+        devices.begin(), devices.end(),
+        [type](Device *dev) { return dev->type() == type; });
+  };
+  if (all_of_type(Device::DEVICE_TYPE_CPU)) {
+    return std::unique_ptr<DataParallelReducer>(
+        new ::SharedMemoryReducer(devices.size()));
+  }
+#ifdef PRIMITIV_USE_NCCL
+  if (all_of_type(Device::DEVICE_TYPE_CUDA)) {
+    return std::unique_ptr<DataParallelReducer>(new ::NCCLReducer(devices));
+  }
+#endif  // PRIMITIV_USE_NCCL
+  return std::unique_ptr<DataParallelReducer>(new ::HostReducer());
+}
+
+}  // namespace
+
+namespace primitiv {
+
+DataParallel::DataParallel(
+    const vector<Device *> &devices, std::uint64_t bucket_size)
+: devices_(devices)
+, bucket_size_(bucket_size) {
+  if (devices_.empty()) {
+    THROW_ERROR("DataParallel requires at least one device.");
+  }
+  for (unsigned i = 0; i < devices_.size(); ++i) {
+    for (unsigned j = 0; j < i; ++j) {
+      if (devices_[i] == devices_[j]) {
+        THROW_ERROR("Device " << devices_[i] << " is given more than once.");
+      }
+    }
+  }
+  reducer_ = ::make_reducer(devices_);
+}
+
+DataParallel::~DataParallel() {}
+
+void DataParallel::add_parameter(const vector<Parameter *> &replicas) {
+  if (replicas.size() != devices_.size()) {
+    THROW_ERROR(
+        "Number of replicas mismatched. replicas.size(): " << replicas.size()
+        << " != devices.size(): " << devices_.size());
+  }
+  for (unsigned d = 0; d < replicas.size(); ++d) {
+    Parameter &param = *replicas[d];
+    if (param.device() != devices_[d]) {
+      THROW_ERROR(
+          "Device mismatched. replicas[" << d << "].device(): "
+          << param.device() << " != devices[" << d << "]: " << devices_[d]);
+    }
+    if (param.shape() != replicas[0]->shape()) {
+      THROW_ERROR(
+          "Shape mismatched. replicas[" << d << "].shape(): "
+          << param.shape().to_string() << " != replicas[0].shape(): "
+          << replicas[0]->shape().to_string());
+    }
+    for (const vector<Parameter *> &registered : params_) {
+      if (registered[d] == &param) {
+        THROW_ERROR(
+            "Parameter '" << param.name() << "' is already registered.");
+      }
+    }
+  }
+  params_.emplace_back(replicas);
+  buckets_.clear();
+}
+
+void DataParallel::broadcast_values() {
+  for (const vector<Parameter *> &replicas : params_) {
+    const Tensor &src = replicas[0]->value();
+    for (unsigned d = 1; d < replicas.size(); ++d) {
+      // Updates values in place to keep views of them.
+      Tensor &dest = replicas[d]->value();
+      dest.reset(0);
+      dest += devices_[d]->copy_tensor(src);
+    }
+  }
+}
+
+void DataParallel::allreduce_gradients() {
+  if (params_.empty()) return;
+  if (!check_buckets()) make_buckets();
+  vector<vector<Tensor *>> buffers;
+  for (Bucket &bucket : buckets_) {
+    buffers.emplace_back();
+    for (Tensor &buf : bucket.buffers) buffers.back().emplace_back(&buf);
+  }
+  reducer_->allreduce(buffers, 1.f / devices_.size());
+}
+
+bool DataParallel::check_buckets() const {
+  if (buckets_.empty()) return false;
+  for (const Bucket &bucket : buckets_) {
+    for (unsigned d = 0; d < devices_.size(); ++d) {
+      const float *base = static_cast<const float *>(bucket.buffers[d].data());
+      for (unsigned i = 0; i < bucket.params.size(); ++i) {
+        const Parameter &param = *params_[bucket.params[i]][d];
+        if (param.gradient().data() != base + bucket.offsets[i]) return false;
+      }
+    }
+  }
+  return true;
+}
+
+void DataParallel::make_buckets() {
+  const std::uint64_t max_elements =
+    std::max<std::uint64_t>(1, bucket_size_ / sizeof(float));
+  buckets_.clear();
+  std::uint64_t total = 0;
+  for (unsigned p = 0; p < params_.size(); ++p) {
+    const unsigned size = params_[p][0]->shape().size();
+    if (buckets_.empty() || total + size > max_elements) {
+      buckets_.emplace_back();
+      total = 0;
+    }
+    buckets_.back().params.emplace_back(p);
+    buckets_.back().offsets.emplace_back(total);
+    total += size;
+  }
+
+  for (Bucket &bucket : buckets_) {
+    const Parameter &last = *params_[bucket.params.back()][0];
+    const Shape shape({bucket.offsets.back() + last.shape().size()});
+    // Reserves the space not to copy aliased tensors by reallocation.
+    bucket.buffers.reserve(devices_.size());
+    for (unsigned d = 0; d < devices_.size(); ++d) {
+      Tensor buf = devices_[d]->new_tensor(shape);
+      for (unsigned i = 0; i < bucket.params.size(); ++i) {
+        // Moves the gradient into the bucket without changing its values.
+        Tensor &grad = params_[bucket.params[i]][d]->gradient();
+        Tensor view = buf.view(grad.shape(), bucket.offsets[i]);
+        view.reset(0);
+        view += grad;
+        grad = std::move(view);
+      }
+      bucket.buffers.emplace_back(std::move(buf));
+    }
+  }
+}
+
+}  // namespace primitiv
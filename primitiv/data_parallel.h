@@ -0,0 +1,99 @@
+#ifndef PRIMITIV_DATA_PARALLEL_H_
+#define PRIMITIV_DATA_PARALLEL_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class Device;
+class Parameter;
+struct DataParallelReducer;
+
+/**
+ * Synchronizer of parameters replicated over multiple devices.
+ * Each device processes a different part of the minibatch using its own
+ * replicas, and `allreduce_gradients()` averages gradients of all replicas
+ * before updating them by the same trainer.
+ */
+class DataParallel {
+  DataParallel() = delete;
+  DataParallel(const DataParallel &) = delete;
+  DataParallel(DataParallel &&) = delete;
+  DataParallel &operator=(const DataParallel &) = delete;
+  DataParallel &operator=(DataParallel &&) = delete;
+
+public:
+  /**
+   * Creates a new DataParallel object.
+   * @param devices List of devices which hold replicas.
+   * @param bucket_size Maximum number of bytes of gradients which are reduced
+   *                    at once.
+   * @remarks The reduction uses NCCL if all devices are `CUDADevice` and the
+   *          library is built with `PRIMITIV_USE_NCCL`, the shared memory if
+   *          all devices are `CPUDevice`, and the host memory otherwise.
+   */
+  explicit DataParallel(
+      const std::vector<Device *> &devices,
+      std::uint64_t bucket_size = 1ull << 22);
+
+  ~DataParallel();
+
+  /**
+   * Retrieves the list of devices.
+   * @return List of devices.
+   */
+  const std::vector<Device *> &devices() const { return devices_; }
+
+  /**
+   * Registers replicas of a parameter.
+   * @param replicas List of replicas. `replicas[i]` should be on `devices()[i]`
+   *                 and all replicas should have the same shape.
+   */
+  void add_parameter(const std::vector<Parameter *> &replicas);
+
+  /**
+   * Copies values of the first replicas to other replicas.
+   */
+  void broadcast_values();
+
+  /**
+   * Replaces gradients of all replicas with their average.
+   * @remarks Gradients of replicas in the same bucket become views of a
+   *          contiguous buffer at the first call.
+   */
+  void allreduce_gradients();
+
+private:
+  /**
+   * Gradients of consecutive parameters which are reduced at once.
+   */
+  struct Bucket {
+    std::vector<unsigned> params;
+    std::vector<unsigned> offsets;
+    std::vector<Tensor> buffers;
+  };
+
+  /**
+   * Checks whether gradients of all replicas refer their buckets or not.
+   * @return true if buckets are available, false otherwise.
+   */
+  bool check_buckets() const;
+
+  /**
+   * Makes buckets and moves gradients of replicas into them.
+   */
+  void make_buckets();
+
+  std::vector<Device *> devices_;
+  std::uint64_t bucket_size_;
+  std::vector<std::vector<Parameter *>> params_;
+  std::vector<Bucket> buckets_;
+  std::unique_ptr<DataParallelReducer> reducer_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_DATA_PARALLEL_H_
@@ -1,7 +1,12 @@
 #include <config.h>
 
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <primitiv/device.h>
 #include <primitiv/error.h>
+#include <primitiv/quantized_parameter.h>
 #include <primitiv/shape_ops.h>
 
 using std::vector;
@@ -15,27 +20,207 @@ using std::vector;
         << " != this: " << this); \
   }
 
+// Calls the implementation, and notifies the observer if it is set.
+// Arguments except `call` are evaluated only if the observer is set.
+#define OBSERVE(call, name, flops, ...) \
+  do { \
+    if (!observer_) { \
+      call; \
+    } else { \
+      const double start_us = observer_clock(); \
+      call; \
+      notify_kernel(name, {__VA_ARGS__}, flops, start_us); \
+    } \
+  } while (false)
+
+namespace {
+
+// Deleter of the memory which is a part of another memory.
+struct MemoryPart {
+  // Whole memory which is kept alive while the part is used.
+  std::shared_ptr<void> whole;
+
+  // Memories of other tensors which are kept alive.
+  std::vector<std::shared_ptr<void>> refs;
+
+  void operator()(void *) const {}
+};
+
+// Memory specified by Device::place_next_tensor() on the current thread.
+struct Placement {
+  const primitiv::Device *device;
+  std::shared_ptr<void> handle;
+  unsigned size;
+};
+
+thread_local Placement placement {nullptr, nullptr, 0};
+
+}  // namespace
+
 namespace primitiv {
 
+const unsigned ElementwiseProgram::MAX_INSTRUCTIONS;
+
+std::shared_ptr<void> Device::allocate_handle(const Shape &shape) {
+  ::Placement &p = ::placement;
+  if (p.device == this && shape.size() == p.size) {
+    std::shared_ptr<void> ret = std::move(p.handle);
+    p = {nullptr, nullptr, 0};
+    return ret;
+  }
+  return new_handle(shape);
+}
+
+double Device::observer_clock() {
+  synchronize();
+  return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Device::notify_kernel(
+    const char *name, vector<const Shape *> &&shapes, double flops,
+    double start_us) {
+  const double end_us = observer_clock();
+  double bytes = 0;
+  for (const Shape *s : shapes) bytes += sizeof(float) * s->size();
+  DeviceObserver::KernelInfo info {
+    name, std::move(shapes), flops, bytes, end_us - start_us,
+  };
+  observer_->on_kernel(*this, info);
+}
+
+void Device::place_next_tensor(std::shared_ptr<void> handle, unsigned size) {
+  ::placement = {this, std::move(handle), size};
+}
+
+void Device::cancel_placement() {
+  if (::placement.device == this) ::placement = {nullptr, nullptr, 0};
+}
+
+void Device::place_next_tensor(
+    const Tensor &dest, unsigned offset, unsigned size) {
+  CHECK_DEVICE(dest);
+  if (offset + size > dest.shape().size()) {
+    THROW_ERROR(
+        "Placement out of range. offset: " << offset << ", size: " << size
+        << ", dest.shape: " << dest.shape().to_string());
+  }
+  // NOTE(odashi):
+  // The part has its own owner so that the new tensor is not copied on write.
+  // The owner of `dest` is shared with `dest` if `dest` is also a part.
+  const MemoryPart *p = std::get_deleter<MemoryPart>(dest.data_);
+  ::placement = {
+    this,
+    std::shared_ptr<void>(
+        static_cast<float *>(dest.data_.get()) + offset,
+        MemoryPart {p ? p->whole : dest.data_, {}}),
+    size,
+  };
+}
+
+Tensor Device::new_workspace_tensor(const Shape &shape) {
+  std::lock_guard<std::mutex> lock(workspace_mutex_);
+  // NOTE(odashi):
+  // Workspace tensors refer the memory with shared ownership, and the
+  // workspace is busy while any of them is alive.
+  if (workspace_ && workspace_.use_count() > 1) {
+    return Tensor(shape, this, new_handle(shape));
+  }
+  if (!workspace_ || workspace_size_ < shape.size()) {
+    // Releases the old memory at first so that the pool can reuse it.
+    workspace_.reset();
+    workspace_ = new_handle(shape);
+    workspace_size_ = shape.size();
+  }
+  Tensor ret(shape, this, workspace_);
+  ret.aliased_ = true;
+  return ret;
+}
+
+unsigned Device::workspace_size() const {
+  std::lock_guard<std::mutex> lock(workspace_mutex_);
+  return workspace_ ? workspace_size_ : 0;
+}
+
+void Device::release_workspace() {
+  std::lock_guard<std::mutex> lock(workspace_mutex_);
+  workspace_.reset();
+  workspace_size_ = 0;
+}
+
+Tensor Device::concat_in_memory(
+    const vector<const Tensor *> &xs, const Shape &shape) {
+  const auto owner = [](const Tensor &x) {
+    const MemoryPart *p = std::get_deleter<MemoryPart>(x.data_);
+    return p ? p->whole : x.data_;
+  };
+  const auto same_owner = [](
+      const std::shared_ptr<void> &a, const std::shared_ptr<void> &b) {
+    return !a.owner_before(b) && !b.owner_before(a);
+  };
+
+  // Views are excluded because they are updated without copy-on-write.
+  if (xs.empty() || xs[0]->aliased_) return Tensor();
+  const std::shared_ptr<void> whole = owner(*xs[0]);
+  bool shared = true;
+  for (unsigned i = 1; i < xs.size(); ++i) {
+    const Tensor &prev = *xs[i - 1];
+    const Tensor &x = *xs[i];
+    if (x.aliased_ || !same_owner(whole, owner(x)) ||
+        static_cast<const float *>(prev.data_.get()) + prev.shape().size() !=
+        x.data_.get()) {
+      return Tensor();
+    }
+    shared = shared && same_owner(xs[0]->data_, x.data_);
+  }
+  if (shared) return share_tensor(*xs[0], shape, 0);
+
+  // The result keeps all parts so that they are copied on write.
+  MemoryPart part {whole, {}};
+  for (const Tensor *x : xs) part.refs.emplace_back(x->data_);
+  return Tensor(
+      shape, this, std::shared_ptr<void>(xs[0]->data_.get(), std::move(part)));
+}
+
 Tensor Device::new_tensor(const Shape &shape) {
-  return Tensor(shape, this, new_handle(shape));
+  return Tensor(shape, this, allocate_handle(shape));
+}
+
+Tensor Device::share_tensor(
+    const Tensor &x, const Shape &shape, unsigned offset) {
+  // Aliased memory may be updated in place after returning.
+  if (x.aliased_) return copy_tensor(alias_tensor(x, shape, offset));
+  return Tensor(
+      shape, this,
+      std::shared_ptr<void>(
+        x.data_, static_cast<float *>(x.data_.get()) + offset));
+}
+
+Tensor Device::alias_tensor(
+    const Tensor &x, const Shape &shape, unsigned offset) {
+  Tensor ret(
+      shape, this,
+      std::shared_ptr<void>(
+        x.data_, static_cast<float *>(x.data_.get()) + offset));
+  ret.aliased_ = true;
+  return ret;
 }
 
 Tensor Device::new_tensor(const Shape &shape, float k) {
-  Tensor ret(shape, this, new_handle(shape));
+  Tensor ret(shape, this, allocate_handle(shape));
   reset_tensor(k, ret);
   return ret;
 }
 
 Tensor Device::new_tensor_by_array(const Shape &shape, const float values[]) {
-  Tensor ret(shape, this, new_handle(shape));
+  Tensor ret(shape, this, allocate_handle(shape));
   reset_tensor_by_array(values, ret);
   return ret;
 }
 
 Tensor Device::new_tensor_by_vector(
     const Shape &shape, const vector<float> &values) {
-  Tensor ret(shape, this, new_handle(shape));
+  Tensor ret(shape, this, allocate_handle(shape));
   reset_tensor_by_vector(values, ret);
   return ret;
 }
@@ -45,6 +230,11 @@ vector<float> Device::tensor_to_vector(const Tensor &x) {
   return tensor_to_vector_impl(x);
 }
 
+void Device::tensor_to_array(const Tensor &x, float values[]) {
+  CHECK_DEVICE(x);
+  tensor_to_array_impl(x, values);
+}
+
 void Device::reset_tensor(float k, Tensor &x) {
   CHECK_DEVICE(x);
   reset_tensor_impl(k, x);
@@ -73,7 +263,7 @@ Tensor Device::copy_tensor(const Tensor &x) {
   // This function should return always different memory with x.
   if (!x.valid()) THROW_ERROR("Attempted to copy an invalid tensor.");
   Tensor y = new_tensor(x.shape());
-  copy_tensor_impl(x, y);
+  OBSERVE(copy_tensor_impl(x, y), "copy_tensor", 0, &x.shape(), &y.shape());
   return y;
 }
 
@@ -82,7 +272,7 @@ Tensor Device::random_bernoulli(const Shape &shape, float p) {
     THROW_ERROR("Invalid Bernoulli probability: " << p);
   }
   Tensor y = new_tensor(shape);
-  random_bernoulli_impl(p, y);
+  OBSERVE(random_bernoulli_impl(p, y), "random_bernoulli", 0, &y.shape());
   return y;
 }
 
@@ -94,7 +284,8 @@ Tensor Device::random_uniform(
         << ", upper: " << upper);
   }
   Tensor y = new_tensor(shape);
-  random_uniform_impl(lower, upper, y);
+  OBSERVE(
+      random_uniform_impl(lower, upper, y), "random_uniform", 0, &y.shape());
   return y;
 }
 
@@ -105,7 +296,7 @@ Tensor Device::random_normal(const Shape &shape, float mean, float sd) {
         << ", SD: " << sd);
   }
   Tensor y = new_tensor(shape);
-  random_normal_impl(mean, sd, y);
+  OBSERVE(random_normal_impl(mean, sd, y), "random_normal", 0, &y.shape());
   return y;
 }
 
@@ -116,7 +307,8 @@ Tensor Device::random_log_normal(const Shape &shape, float mean, float sd) {
         << ", SD: " << sd);
   }
   Tensor y = new_tensor(shape);
-  random_log_normal_impl(mean, sd, y);
+  OBSERVE(
+      random_log_normal_impl(mean, sd, y), "random_log_normal", 0, &y.shape());
   return y;
 }
 
@@ -124,15 +316,34 @@ Tensor Device::pick_fw(
     const Tensor &x, unsigned dim, const vector<unsigned> &ids) {
   CHECK_DEVICE(x);
   Tensor y = new_tensor(shape_ops::pick(x.shape(), dim, ids));
-  pick_fw_impl(x, dim, ids, y);
+  OBSERVE(pick_fw_impl(x, dim, ids, y), "pick_fw", 0, &x.shape(), &y.shape());
+  return y;
+}
+
+Tensor Device::gather_fw(
+    const Tensor &x, unsigned dim, const vector<unsigned> &ids) {
+  CHECK_DEVICE(x);
+  Tensor y = new_tensor(shape_ops::gather(x.shape(), dim, ids));
+  OBSERVE(
+      gather_fw_impl(x, dim, ids, y), "gather_fw", 0, &x.shape(), &y.shape());
   return y;
 }
 
 Tensor Device::slice_fw(
     const Tensor &x, unsigned dim, unsigned lower, unsigned upper) {
   CHECK_DEVICE(x);
-  Tensor y = new_tensor(shape_ops::slice(x.shape(), dim, lower, upper));
-  slice_fw_impl(x, dim, lower, y);
+  const Shape &sx = x.shape();
+  const Shape sy = shape_ops::slice(sx, dim, lower, upper);
+  // Memory of the slice is contiguous if no dimension above `dim` (including
+  // the minibatch) has more than one element. Such slices share the memory of
+  // `x` until either of them is updated.
+  if ((lower == 0 && upper == sx[dim]) ||
+      sx.size() == sx.lower_volume(dim + 1)) {
+    return share_tensor(x, sy, lower * sx.lower_volume(dim));
+  }
+  Tensor y = new_tensor(sy);
+  OBSERVE(
+      slice_fw_impl(x, dim, lower, y), "slice_fw", 0, &sx, &y.shape());
   return y;
 }
 
@@ -143,8 +354,73 @@ Tensor Device::concat_fw(const vector<const Tensor *> &xs, unsigned dim) {
     CHECK_DEVICE(*xs[i]);
     shapes[i] = &xs[i]->shape();
   }
-  Tensor y = new_tensor(shape_ops::concat(shapes, dim));
-  concat_fw_impl(xs, dim, y);
+  const Shape sy = shape_ops::concat(shapes, dim);
+  // Each source is a contiguous part of the result if no dimension above
+  // `dim` (including the minibatch) has more than one element.
+  if (sy.size() == sy.lower_volume(dim + 1)) {
+    Tensor y = concat_in_memory(xs, sy);
+    if (y.valid()) return y;
+  }
+  Tensor y = new_tensor(sy);
+  if (!observer_) {
+    concat_fw_impl(xs, dim, y);
+  } else {
+    const double start_us = observer_clock();
+    concat_fw_impl(xs, dim, y);
+    shapes.emplace_back(&y.shape());
+    notify_kernel("concat_fw", std::move(shapes), 0, start_us);
+  }
+  return y;
+}
+
+Tensor Device::batch_slice_fw(
+    const Tensor &x, unsigned lower, unsigned upper) {
+  CHECK_DEVICE(x);
+  const Shape sy = shape_ops::batch_slice(x.shape(), lower, upper);
+  // Samples in the minibatch are always contiguous.
+  return share_tensor(x, sy, lower * sy.volume());
+}
+
+Tensor Device::batch_concat_fw(const vector<const Tensor *> &xs) {
+  vector<const Shape *> shapes(xs.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    CHECK_DEVICE(*xs[i]);
+    shapes[i] = &xs[i]->shape();
+  }
+  const Shape sy = shape_ops::batch_concat(shapes);
+  // Samples in the minibatch are always contiguous.
+  {
+    Tensor y = concat_in_memory(xs, sy);
+    if (y.valid()) return y;
+  }
+  Tensor y = new_tensor(sy);
+  const double start_us = observer_ ? observer_clock() : 0;
+  unsigned offset = 0;
+  for (const Tensor *x : xs) {
+    // Writes values through a temporary alias to avoid copy-on-write.
+    Tensor dest = alias_tensor(y, x->shape(), offset);
+    copy_tensor_impl(*x, dest);
+    offset += x->shape().size();
+  }
+  if (observer_) {
+    shapes.emplace_back(&y.shape());
+    notify_kernel("batch_concat_fw", std::move(shapes), 0, start_us);
+  }
+  return y;
+}
+
+Tensor Device::batch_pick_fw(const Tensor &x, const vector<unsigned> &ids) {
+  CHECK_DEVICE(x);
+  const Shape &sx = x.shape();
+  const Shape sy = shape_ops::batch_pick(sx, ids);
+  // Each sample is a column of the matrix with the shape
+  // {volume, batch size}, and picking samples is the same as `pick()` along
+  // the second dimension of the matrix.
+  const unsigned volume = sx.volume();
+  const Tensor xm = alias_tensor(x, Shape({volume, sx.batch()}), 0);
+  Tensor y = new_tensor(sy);
+  Tensor ym = alias_tensor(y, Shape({volume}, ids.size()), 0);
+  OBSERVE(pick_fw_impl(xm, 1, ids, ym), "batch_pick_fw", 0, &sx, &sy);
   return y;
 }
 
@@ -159,7 +435,41 @@ void Device::pick_bw(
         "Shape mismatched. gy.shape(): " << gy.shape().to_string()
         << " != expected shape: " << sy.to_string());
   }
-  pick_bw_impl(gy, dim, ids, gx);
+  OBSERVE(
+      pick_bw_impl(gy, dim, ids, gx), "pick_bw", gy.shape().size(),
+      &gy.shape(), &gx.shape());
+}
+
+void Device::pick_assign(
+    const Tensor &y, unsigned dim, const std::vector<unsigned> &ids,
+    Tensor &x) {
+  CHECK_DEVICE(y);
+  CHECK_DEVICE(x);
+  const Shape sy = shape_ops::pick(x.shape(), dim, ids);
+  if (y.shape() != sy) {
+    THROW_ERROR(
+        "Shape mismatched. y.shape(): " << y.shape().to_string()
+        << " != expected shape: " << sy.to_string());
+  }
+  OBSERVE(
+      pick_assign_impl(y, dim, ids, x), "pick_assign", 0,
+      &y.shape(), &x.shape());
+}
+
+void Device::gather_bw(
+    const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids,
+    Tensor &gx) {
+  CHECK_DEVICE(gy);
+  CHECK_DEVICE(gx);
+  const Shape sy = shape_ops::gather(gx.shape(), dim, ids);
+  if (gy.shape() != sy) {
+    THROW_ERROR(
+        "Shape mismatched. gy.shape(): " << gy.shape().to_string()
+        << " != expected shape: " << sy.to_string());
+  }
+  OBSERVE(
+      gather_bw_impl(gy, dim, ids, gx), "gather_bw", gy.shape().size(),
+      &gy.shape(), &gx.shape());
 }
 
 void Device::slice_bw(
@@ -175,15 +485,45 @@ void Device::slice_bw(
         << sy.to_string() << ", dim " << dim << ", offset " << offset
         << " to shape" << sx.to_string() << '.');
   }
-  if (dim >= sx.depth()) inplace_add_impl(gy, gx);
-  else slice_bw_impl(gy, dim, offset, gx);
+  if (dim >= sx.depth()) {
+    OBSERVE(inplace_add_impl(gy, gx), "slice_bw", sy.size(), &sy, &sx, &sx);
+  } else {
+    OBSERVE(
+        slice_bw_impl(gy, dim, offset, gx), "slice_bw", sy.size(),
+        &sy, &sx, &sx);
+  }
+}
+
+void Device::batch_pick_bw(
+    const Tensor &gy, const std::vector<unsigned> &ids, Tensor &gx) {
+  CHECK_DEVICE(gy);
+  CHECK_DEVICE(gx);
+  const Shape &sy = gy.shape();
+  const Shape &sx = gx.shape();
+  const Shape expected = shape_ops::batch_pick(sx, ids);
+  if (sy != expected) {
+    THROW_ERROR(
+        "Shape mismatched. gy.shape(): " << sy.to_string()
+        << " != expected shape: " << expected.to_string());
+  }
+  // Same as batch_pick_fw(). `gx` is updated through a temporary alias after
+  // its memory is made unique.
+  const unsigned volume = sx.volume();
+  const Tensor gym = alias_tensor(gy, Shape({volume}, ids.size()), 0);
+  gx.data();
+  Tensor gxm = alias_tensor(gx, Shape({volume, sx.batch()}), 0);
+  OBSERVE(
+      pick_bw_impl(gym, 1, ids, gxm), "batch_pick_bw", sy.size(),
+      &sy, &sx, &sx);
 }
 
 #define DEV_FW_X(name, sop) \
 Tensor Device::name##_fw(const Tensor &x) { \
   CHECK_DEVICE(x); \
   Tensor y = new_tensor(sop(x.shape())); \
-  name##_fw_impl(x, y); \
+  OBSERVE( \
+      name##_fw_impl(x, y), #name "_fw", y.shape().size(), \
+      &x.shape(), &y.shape()); \
   return y; \
 }
 
@@ -204,14 +544,18 @@ void Device::name##_bw( \
         << ", gy.shape: " << gy.shape().to_string() \
         << ", gx.shape: " << gx.shape().to_string()); \
   } \
-  name##_bw_impl(x, y, gy, gx); \
+  OBSERVE( \
+      name##_bw_impl(x, y, gy, gx), #name "_bw", 2. * gx.shape().size(), \
+      &x.shape(), &y.shape(), &gy.shape(), &gx.shape(), &gx.shape()); \
 }
 
 #define DEV_FW_X_CONST(name) \
 Tensor Device::name##_fw(const Tensor &x, float k) { \
   CHECK_DEVICE(x); \
   Tensor y = new_tensor(x.shape()); \
-  name##_fw_impl(x, k, y); \
+  OBSERVE( \
+      name##_fw_impl(x, k, y), #name "_fw", y.shape().size(), \
+      &x.shape(), &y.shape()); \
   return y; \
 }
 
@@ -231,19 +575,23 @@ void Device::name##_bw( \
         << ", gy.shape: " << gy.shape().to_string() \
         << ", gx.shape: " << gx.shape().to_string()); \
   } \
-  name##_bw_impl(x, y, gy, k, gx); \
+  OBSERVE( \
+      name##_bw_impl(x, y, gy, k, gx), #name "_bw", 2. * s.size(), \
+      &s, &y.shape(), &gy.shape(), &gx.shape(), &gx.shape()); \
 }
 
-#define DEV_FW_AB(name, sop) \
+#define DEV_FW_AB(name, sop, flops) \
 Tensor Device::name##_fw(const Tensor &a, const Tensor &b) { \
   CHECK_DEVICE(a); \
   CHECK_DEVICE(b); \
   Tensor y = new_tensor(sop(a.shape(), b.shape())); \
-  name##_fw_impl(a, b, y); \
+  OBSERVE( \
+      name##_fw_impl(a, b, y), #name "_fw", (flops), \
+      &a.shape(), &b.shape(), &y.shape()); \
   return y; \
 }
 
-#define DEV_BW_AB(name, sop) \
+#define DEV_BW_AB(name, sop, flops) \
 void Device::name##_bw( \
     const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy, \
     Tensor &ga, Tensor &gb) { \
@@ -266,7 +614,10 @@ void Device::name##_bw( \
         << ", ga.shape: " << ga.shape().to_string() \
         << ", gb.shape: " << gb.shape().to_string()); \
   } \
-  name##_bw_impl(a, b, y, gy, ga, gb); \
+  OBSERVE( \
+      name##_bw_impl(a, b, y, gy, ga, gb), #name "_bw", (flops), \
+      &a.shape(), &b.shape(), &y.shape(), &gy.shape(), \
+      &ga.shape(), &gb.shape(), &ga.shape(), &gb.shape()); \
 }
 
 DEV_FW_X(negate, static_cast<const Shape &>);
@@ -278,7 +629,6 @@ DEV_FW_X(softplus, static_cast<const Shape &>);
 DEV_FW_X(sin, static_cast<const Shape &>);
 DEV_FW_X(cos, static_cast<const Shape &>);
 DEV_FW_X(tan, static_cast<const Shape &>);
-DEV_FW_X(transpose, shape_ops::transpose);
 
 DEV_BW_X(sqrt, static_cast<const Shape &>);
 DEV_BW_X(exp, static_cast<const Shape &>);
@@ -308,24 +658,24 @@ DEV_BW_X_CONST(divide_const_l);
 DEV_BW_X_CONST(prelu);
 DEV_BW_X_CONST(elu);
 
-DEV_FW_AB(add_scalar, shape_ops::scalar_op);
-DEV_FW_AB(subtract_scalar_r, shape_ops::scalar_op);
-DEV_FW_AB(subtract_scalar_l, shape_ops::scalar_op);
-DEV_FW_AB(multiply_scalar, shape_ops::scalar_op);
-DEV_FW_AB(divide_scalar_r, shape_ops::scalar_op);
-DEV_FW_AB(divide_scalar_l, shape_ops::scalar_op);
-
-DEV_FW_AB(add, shape_ops::elementwise);
-DEV_FW_AB(subtract, shape_ops::elementwise);
-DEV_FW_AB(multiply, shape_ops::elementwise);
-DEV_FW_AB(divide, shape_ops::elementwise);
-DEV_FW_AB(matmul, shape_ops::matmul);
-
-DEV_BW_AB(add, shape_ops::elementwise);
-DEV_BW_AB(subtract, shape_ops::elementwise);
-DEV_BW_AB(multiply, shape_ops::elementwise);
-DEV_BW_AB(divide, shape_ops::elementwise);
-DEV_BW_AB(matmul, shape_ops::matmul);
+DEV_FW_AB(add_scalar, shape_ops::scalar_op, y.shape().size());
+DEV_FW_AB(subtract_scalar_r, shape_ops::scalar_op, y.shape().size());
+DEV_FW_AB(subtract_scalar_l, shape_ops::scalar_op, y.shape().size());
+DEV_FW_AB(multiply_scalar, shape_ops::scalar_op, y.shape().size());
+DEV_FW_AB(divide_scalar_r, shape_ops::scalar_op, y.shape().size());
+DEV_FW_AB(divide_scalar_l, shape_ops::scalar_op, y.shape().size());
+
+DEV_FW_AB(add, shape_ops::elementwise, y.shape().size());
+DEV_FW_AB(subtract, shape_ops::elementwise, y.shape().size());
+DEV_FW_AB(multiply, shape_ops::elementwise, y.shape().size());
+DEV_FW_AB(divide, shape_ops::elementwise, y.shape().size());
+DEV_FW_AB(matmul, shape_ops::matmul, 2. * a.shape()[1] * y.shape().size());
+
+DEV_BW_AB(add, shape_ops::elementwise, 4. * y.shape().size());
+DEV_BW_AB(subtract, shape_ops::elementwise, 4. * y.shape().size());
+DEV_BW_AB(multiply, shape_ops::elementwise, 4. * y.shape().size());
+DEV_BW_AB(divide, shape_ops::elementwise, 4. * y.shape().size());
+DEV_BW_AB(matmul, shape_ops::matmul, 4. * a.shape()[1] * y.shape().size());
 
 #undef DEV_FW_X
 #undef DEV_BW_X
@@ -334,37 +684,326 @@ DEV_BW_AB(matmul, shape_ops::matmul);
 #undef DEV_FW_AB
 #undef DEV_BW_AB
 
+Tensor Device::affine_fw(
+    const Tensor &w, const Tensor &x, const Tensor &b, Activation act) {
+  CHECK_DEVICE(w);
+  CHECK_DEVICE(x);
+  CHECK_DEVICE(b);
+  Tensor y = new_tensor(shape_ops::affine(w.shape(), x.shape(), b.shape()));
+  OBSERVE(
+      affine_fw_impl(w, x, b, act, y), "affine_fw",
+      (2. * w.shape()[1] + 2) * y.shape().size(),
+      &w.shape(), &x.shape(), &b.shape(), &y.shape());
+  return y;
+}
+
+void Device::affine_bw(
+    const Tensor &w, const Tensor &x, const Tensor &b,
+    const Tensor &y, const Tensor &gy, Activation act,
+    Tensor &gw, Tensor &gx, Tensor &gb) {
+  CHECK_DEVICE(w);
+  CHECK_DEVICE(x);
+  CHECK_DEVICE(b);
+  CHECK_DEVICE(y);
+  CHECK_DEVICE(gy);
+  CHECK_DEVICE(gw);
+  CHECK_DEVICE(gx);
+  CHECK_DEVICE(gb);
+  if (w.shape() != gw.shape() ||
+      x.shape() != gx.shape() ||
+      b.shape() != gb.shape() ||
+      y.shape() != gy.shape() ||
+      y.shape() != shape_ops::affine(w.shape(), x.shape(), b.shape())) {
+    THROW_ERROR(
+        "Shape mismatched at affine_bw"
+        << ". w.shape: " << w.shape().to_string()
+        << ", x.shape: " << x.shape().to_string()
+        << ", b.shape: " << b.shape().to_string()
+        << ", y.shape: " << y.shape().to_string()
+        << ", gy.shape: " << gy.shape().to_string()
+        << ", gw.shape: " << gw.shape().to_string()
+        << ", gx.shape: " << gx.shape().to_string()
+        << ", gb.shape: " << gb.shape().to_string());
+  }
+  OBSERVE(
+      affine_bw_impl(w, x, b, y, gy, act, gw, gx, gb), "affine_bw",
+      (4. * w.shape()[1] + 3) * y.shape().size(),
+      &w.shape(), &x.shape(), &b.shape(), &y.shape(), &gy.shape(),
+      &gw.shape(), &gx.shape(), &gb.shape(),
+      &gw.shape(), &gx.shape(), &gb.shape());
+}
+
+Tensor Device::lstm_cell_fw(const Tensor &u, const Tensor &c) {
+  CHECK_DEVICE(u);
+  CHECK_DEVICE(c);
+  Tensor y = new_tensor(shape_ops::lstm_cell(u.shape(), c.shape()));
+  OBSERVE(
+      lstm_cell_fw_impl(u, c, y), "lstm_cell_fw", 4. * u.shape().size(),
+      &u.shape(), &c.shape(), &y.shape());
+  return y;
+}
+
+void Device::lstm_cell_bw(
+    const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+    Tensor &gu, Tensor &gc) {
+  CHECK_DEVICE(u);
+  CHECK_DEVICE(c);
+  CHECK_DEVICE(y);
+  CHECK_DEVICE(gy);
+  CHECK_DEVICE(gu);
+  CHECK_DEVICE(gc);
+  if (u.shape() != gu.shape() ||
+      c.shape() != gc.shape() ||
+      y.shape() != gy.shape() ||
+      y.shape() != shape_ops::lstm_cell(u.shape(), c.shape())) {
+    THROW_ERROR(
+        "Shape mismatched at lstm_cell_bw"
+        << ". u.shape: " << u.shape().to_string()
+        << ", c.shape: " << c.shape().to_string()
+        << ", y.shape: " << y.shape().to_string()
+        << ", gy.shape: " << gy.shape().to_string()
+        << ", gu.shape: " << gu.shape().to_string()
+        << ", gc.shape: " << gc.shape().to_string());
+  }
+  OBSERVE(
+      lstm_cell_bw_impl(u, c, y, gy, gu, gc), "lstm_cell_bw",
+      8. * u.shape().size(),
+      &u.shape(), &c.shape(), &y.shape(), &gy.shape(),
+      &gu.shape(), &gc.shape(), &gu.shape(), &gc.shape());
+}
+
+Tensor Device::lstm_fw(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0) {
+  CHECK_DEVICE(xu);
+  CHECK_DEVICE(wh);
+  CHECK_DEVICE(h0);
+  CHECK_DEVICE(c0);
+  Tensor y = new_tensor(
+      shape_ops::lstm(xu.shape(), wh.shape(), h0.shape(), c0.shape()));
+  OBSERVE(
+      lstm_fw_impl(xu, wh, h0, c0, y), "lstm_fw",
+      (2. * wh.shape()[1] + 4) * xu.shape().size(),
+      &xu.shape(), &wh.shape(), &h0.shape(), &c0.shape(), &y.shape());
+  return y;
+}
+
+void Device::lstm_bw(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+    const Tensor &y, const Tensor &gy,
+    Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) {
+  CHECK_DEVICE(xu);
+  CHECK_DEVICE(wh);
+  CHECK_DEVICE(h0);
+  CHECK_DEVICE(c0);
+  CHECK_DEVICE(y);
+  CHECK_DEVICE(gy);
+  CHECK_DEVICE(gxu);
+  CHECK_DEVICE(gwh);
+  CHECK_DEVICE(gh0);
+  CHECK_DEVICE(gc0);
+  if (xu.shape() != gxu.shape() ||
+      wh.shape() != gwh.shape() ||
+      h0.shape() != gh0.shape() ||
+      c0.shape() != gc0.shape() ||
+      y.shape() != gy.shape() ||
+      y.shape() != shape_ops::lstm(
+        xu.shape(), wh.shape(), h0.shape(), c0.shape())) {
+    THROW_ERROR(
+        "Shape mismatched at lstm_bw"
+        << ". xu.shape: " << xu.shape().to_string()
+        << ", wh.shape: " << wh.shape().to_string()
+        << ", h0.shape: " << h0.shape().to_string()
+        << ", c0.shape: " << c0.shape().to_string()
+        << ", y.shape: " << y.shape().to_string()
+        << ", gy.shape: " << gy.shape().to_string()
+        << ", gxu.shape: " << gxu.shape().to_string()
+        << ", gwh.shape: " << gwh.shape().to_string()
+        << ", gh0.shape: " << gh0.shape().to_string()
+        << ", gc0.shape: " << gc0.shape().to_string());
+  }
+  OBSERVE(
+      lstm_bw_impl(xu, wh, h0, c0, y, gy, gxu, gwh, gh0, gc0), "lstm_bw",
+      (6. * wh.shape()[1] + 12) * xu.shape().size(),
+      &xu.shape(), &wh.shape(), &h0.shape(), &c0.shape(), &y.shape(),
+      &gy.shape(), &gxu.shape(), &gwh.shape(), &gh0.shape(), &gc0.shape(),
+      &gxu.shape(), &gwh.shape(), &gh0.shape(), &gc0.shape());
+}
+
+Tensor Device::quantized_matmul_fw(
+    const QuantizedParameter &w, const Tensor &x) {
+  CHECK_DEVICE(w);
+  CHECK_DEVICE(x);
+  Tensor y = new_tensor(shape_ops::matmul(w.shape(), x.shape()));
+  OBSERVE(
+      quantized_matmul_fw_impl(w, x, y), "quantized_matmul_fw",
+      2. * w.shape()[1] * y.shape().size(),
+      &w.shape(), &x.shape(), &y.shape());
+  return y;
+}
+
+void Device::batch_moments_fw(const Tensor &x, Tensor &mean, Tensor &var) {
+  CHECK_DEVICE(x);
+  if (x.shape().batch() <= 1) {
+    THROW_ERROR(
+        "Batch size should be greater than 1 at batch_moments_fw"
+        << ". x.shape: " << x.shape().to_string());
+  }
+  const Shape sy = x.shape().resize_batch(1);
+  mean = new_tensor(sy);
+  var = new_tensor(sy);
+  OBSERVE(
+      batch_moments_fw_impl(x, mean, var), "batch_moments_fw",
+      4. * x.shape().size(), &x.shape(), &mean.shape(), &var.shape());
+}
+
+Tensor Device::batch_normalize_fw(
+    const Tensor &x, const Tensor &mean, const Tensor &var, float eps) {
+  CHECK_DEVICE(x);
+  CHECK_DEVICE(mean);
+  CHECK_DEVICE(var);
+  const Shape sm = x.shape().resize_batch(1);
+  if (mean.shape() != sm || var.shape() != sm) {
+    THROW_ERROR(
+        "Shape mismatched at batch_normalize_fw"
+        << ". x.shape: " << x.shape().to_string()
+        << ", mean.shape: " << mean.shape().to_string()
+        << ", var.shape: " << var.shape().to_string());
+  }
+  Tensor y = new_tensor(x.shape());
+  OBSERVE(
+      batch_normalize_fw_impl(x, mean, var, eps, y), "batch_normalize_fw",
+      2. * y.shape().size(),
+      &x.shape(), &mean.shape(), &var.shape(), &y.shape());
+  return y;
+}
+
+Tensor Device::elementwise_fw(
+    const ElementwiseProgram &prog, const vector<const Tensor *> &xs) {
+  const auto &insts = prog.instructions;
+  if (insts.empty()) THROW_ERROR("Empty elementwise program.");
+  if (insts.size() > ElementwiseProgram::MAX_INSTRUCTIONS) {
+    THROW_ERROR(
+        "Too many instructions in the elementwise program. size: "
+        << insts.size() << " > max: " << ElementwiseProgram::MAX_INSTRUCTIONS);
+  }
+  if (xs.empty()) THROW_ERROR("No input tensors of the elementwise program.");
+  if (xs.size() > ElementwiseProgram::MAX_INSTRUCTIONS) {
+    THROW_ERROR(
+        "Too many input tensors of the elementwise program. size: "
+        << xs.size() << " > max: " << ElementwiseProgram::MAX_INSTRUCTIONS);
+  }
+  CHECK_DEVICE(*xs[0]);
+  Shape ys = xs[0]->shape();
+  for (unsigned i = 1; i < xs.size(); ++i) {
+    CHECK_DEVICE(*xs[i]);
+    ys = shape_ops::elementwise(ys, xs[i]->shape());
+  }
+  for (unsigned i = 0; i < insts.size(); ++i) {
+    const ElementwiseProgram::Instruction &inst = insts[i];
+    bool valid;
+    if (inst.opcode == ElementwiseProgram::OPCODE_INPUT) {
+      valid = inst.a < xs.size();
+    } else if (inst.opcode >= ElementwiseProgram::OPCODE_ADD) {
+      valid = inst.a < i && inst.b < i;
+    } else {
+      valid = inst.a < i;
+    }
+    if (!valid) {
+      THROW_ERROR(
+          "Invalid operand of the elementwise program. instruction: " << i
+          << ", opcode: " << inst.opcode
+          << ", a: " << inst.a << ", b: " << inst.b);
+    }
+  }
+  Tensor y = new_tensor(ys);
+  if (!observer_) {
+    elementwise_fw_impl(prog, xs, y);
+  } else {
+    const double start_us = observer_clock();
+    elementwise_fw_impl(prog, xs, y);
+    vector<const Shape *> shapes;
+    for (const Tensor *x : xs) shapes.emplace_back(&x->shape());
+    shapes.emplace_back(&y.shape());
+    notify_kernel(
+        "elementwise_fw", std::move(shapes),
+        static_cast<double>(insts.size()) * ys.size(), start_us);
+  }
+  return y;
+}
+
 Tensor Device::sum_fw(const Tensor &x, unsigned dim) {
   CHECK_DEVICE(x);
   Tensor y = new_tensor(x.shape().resize_dim(dim, 1));
-  sum_fw_impl(x, dim, y);
+  OBSERVE(
+      sum_fw_impl(x, dim, y), "sum_fw", 1. * x.shape().size(),
+      &x.shape(), &y.shape());
   return y;
 }
 
 Tensor Device::logsumexp_fw(const Tensor &x, unsigned dim) {
   CHECK_DEVICE(x);
   Tensor y = new_tensor(x.shape().resize_dim(dim, 1));
-  logsumexp_fw_impl(x, dim, y);
+  OBSERVE(
+      logsumexp_fw_impl(x, dim, y), "logsumexp_fw", 3. * x.shape().size(),
+      &x.shape(), &y.shape());
+  return y;
+}
+
+Tensor Device::softmax_fw(const Tensor &x, unsigned dim) {
+  CHECK_DEVICE(x);
+  Tensor y = new_tensor(x.shape());
+  OBSERVE(
+      softmax_fw_impl(x, dim, y), "softmax_fw", 4. * x.shape().size(),
+      &x.shape(), &y.shape());
+  return y;
+}
+
+Tensor Device::log_softmax_fw(const Tensor &x, unsigned dim) {
+  CHECK_DEVICE(x);
+  Tensor y = new_tensor(x.shape());
+  OBSERVE(
+      log_softmax_fw_impl(x, dim, y), "log_softmax_fw", 4. * x.shape().size(),
+      &x.shape(), &y.shape());
   return y;
 }
 
 Tensor Device::broadcast_fw(const Tensor &x, unsigned dim, unsigned size) {
   CHECK_DEVICE(x);
-  Tensor y = new_tensor(shape_ops::broadcast(x.shape(), dim, size));
-  broadcast_fw_impl(x, dim, size, y);
+  const Shape sy = shape_ops::broadcast(x.shape(), dim, size);
+  // Broadcasting to one element does not change the memory layout.
+  if (size == 1) return share_tensor(x, sy, 0);
+  Tensor y = new_tensor(sy);
+  OBSERVE(
+      broadcast_fw_impl(x, dim, size, y), "broadcast_fw", 0,
+      &x.shape(), &y.shape());
+  return y;
+}
+
+Tensor Device::transpose_fw(const Tensor &x) {
+  CHECK_DEVICE(x);
+  const Shape sy = shape_ops::transpose(x.shape());
+  // Transposing vectors does not change the memory layout.
+  if (sy[0] == 1 || sy[1] == 1) return share_tensor(x, sy, 0);
+  Tensor y = new_tensor(sy);
+  OBSERVE(
+      transpose_fw_impl(x, y), "transpose_fw", 0, &x.shape(), &y.shape());
   return y;
 }
 
 Tensor Device::batch_sum_fw(const Tensor &x) {
   CHECK_DEVICE(x);
   Tensor y = new_tensor(x.shape().resize_batch(1));
-  batch_sum_fw_impl(x, y);
+  OBSERVE(
+      batch_sum_fw_impl(x, y), "batch_sum_fw", x.shape().size(),
+      &x.shape(), &y.shape());
   return y;
 }
 
 void Device::inplace_multiply_const(float k, Tensor &x) {
   CHECK_DEVICE(x);
-  inplace_multiply_const_impl(k, x);
+  OBSERVE(
+      inplace_multiply_const_impl(k, x), "inplace_multiply_const",
+      x.shape().size(), &x.shape(), &x.shape());
 }
 
 void Device::inplace_add(const Tensor &x, Tensor &y) {
@@ -377,7 +1016,9 @@ void Device::inplace_add(const Tensor &x, Tensor &y) {
         "Attempted to add values of shape "
         << sx.to_string() << " to " << sy.to_string() << '.');
   }
-  inplace_add_impl(x, y);
+  OBSERVE(
+      inplace_add_impl(x, y), "inplace_add", x.shape().size(),
+      &sx, &sy, &sy);
 }
 
 void Device::inplace_subtract(const Tensor &x, Tensor &y) {
@@ -390,7 +1031,232 @@ void Device::inplace_subtract(const Tensor &x, Tensor &y) {
         "Attempted to subtract values of shape "
         << sx.to_string() << " from " << sy.to_string() << '.');
   }
-  inplace_subtract_impl(x, y);
+  OBSERVE(
+      inplace_subtract_impl(x, y), "inplace_subtract", x.shape().size(),
+      &sx, &sy, &sy);
 }
 
+#define CHECK_SAME_SHAPE(x, y) \
+  if ((x).shape() != (y).shape()) { \
+    THROW_ERROR( \
+        "Shape mismatched. (" #x ").shape(): " << (x).shape().to_string() \
+        << " != (" #y ").shape(): " << (y).shape().to_string()); \
+  }
+
+void Device::sgd_update(float eta, const Tensor &g, Tensor &x) {
+  CHECK_DEVICE(g);
+  CHECK_DEVICE(x);
+  CHECK_SAME_SHAPE(g, x);
+  OBSERVE(
+      sgd_update_impl(eta, g, x), "sgd_update", 2. * x.shape().size(),
+      &g.shape(), &x.shape(), &x.shape());
+}
+
+void Device::momentum_sgd_update(
+    float eta, float momentum, const Tensor &g, Tensor &m, Tensor &x) {
+  CHECK_DEVICE(g);
+  CHECK_DEVICE(m);
+  CHECK_DEVICE(x);
+  CHECK_SAME_SHAPE(g, x);
+  CHECK_SAME_SHAPE(m, x);
+  OBSERVE(
+      momentum_sgd_update_impl(eta, momentum, g, m, x), "momentum_sgd_update",
+      4. * x.shape().size(),
+      &g.shape(), &m.shape(), &m.shape(), &x.shape(), &x.shape());
+}
+
+void Device::adam_update(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) {
+  CHECK_DEVICE(g);
+  CHECK_DEVICE(m1);
+  CHECK_DEVICE(m2);
+  CHECK_DEVICE(x);
+  CHECK_SAME_SHAPE(g, x);
+  CHECK_SAME_SHAPE(m1, x);
+  CHECK_SAME_SHAPE(m2, x);
+  if (epoch == 0) {
+    THROW_ERROR("Invalid epoch of the Adam update: " << epoch);
+  }
+  OBSERVE(
+      adam_update_impl(alpha, beta1, beta2, eps, epoch, g, m1, m2, x),
+      "adam_update", 12. * x.shape().size(),
+      &g.shape(), &m1.shape(), &m1.shape(), &m2.shape(), &m2.shape(),
+      &x.shape(), &x.shape());
+}
+
+void Device::sgd_update(
+    float eta,
+    const vector<const Tensor *> &gs, const vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  if (gs.size() != n) {
+    THROW_ERROR(
+        "Number of tensors mismatched. gs.size(): " << gs.size()
+        << " != xs.size(): " << n);
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    CHECK_DEVICE(*gs[i]);
+    CHECK_DEVICE(*xs[i]);
+    CHECK_SAME_SHAPE(*gs[i], *xs[i]);
+  }
+  if (n == 0) return;
+  if (!observer_) {
+    sgd_update_multi_impl(eta, gs, xs);
+  } else {
+    const double start_us = observer_clock();
+    sgd_update_multi_impl(eta, gs, xs);
+    vector<const Shape *> shapes;
+    double size = 0;
+    for (const Tensor *g : gs) shapes.emplace_back(&g->shape());
+    for (const Tensor *x : xs) {
+      shapes.insert(shapes.end(), 2, &x->shape());
+      size += x->shape().size();
+    }
+    notify_kernel("sgd_update", std::move(shapes), 2. * size, start_us);
+  }
+}
+
+void Device::momentum_sgd_update(
+    float eta, float momentum,
+    const vector<const Tensor *> &gs, const vector<Tensor *> &ms,
+    const vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  if (gs.size() != n || ms.size() != n) {
+    THROW_ERROR(
+        "Number of tensors mismatched. gs.size(): " << gs.size()
+        << ", ms.size(): " << ms.size() << ", xs.size(): " << n);
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    CHECK_DEVICE(*gs[i]);
+    CHECK_DEVICE(*ms[i]);
+    CHECK_DEVICE(*xs[i]);
+    CHECK_SAME_SHAPE(*gs[i], *xs[i]);
+    CHECK_SAME_SHAPE(*ms[i], *xs[i]);
+  }
+  if (n == 0) return;
+  if (!observer_) {
+    momentum_sgd_update_multi_impl(eta, momentum, gs, ms, xs);
+  } else {
+    const double start_us = observer_clock();
+    momentum_sgd_update_multi_impl(eta, momentum, gs, ms, xs);
+    vector<const Shape *> shapes;
+    double size = 0;
+    for (const Tensor *g : gs) shapes.emplace_back(&g->shape());
+    for (const Tensor *m : ms) shapes.insert(shapes.end(), 2, &m->shape());
+    for (const Tensor *x : xs) {
+      shapes.insert(shapes.end(), 2, &x->shape());
+      size += x->shape().size();
+    }
+    notify_kernel(
+        "momentum_sgd_update", std::move(shapes), 4. * size, start_us);
+  }
+}
+
+void Device::adam_update(
+    float alpha, float beta1, float beta2, float eps, unsigned epoch,
+    const vector<const Tensor *> &gs, const vector<Tensor *> &m1s,
+    const vector<Tensor *> &m2s, const vector<Tensor *> &xs) {
+  const unsigned n = xs.size();
+  if (gs.size() != n || m1s.size() != n || m2s.size() != n) {
+    THROW_ERROR(
+        "Number of tensors mismatched. gs.size(): " << gs.size()
+        << ", m1s.size(): " << m1s.size() << ", m2s.size(): " << m2s.size()
+        << ", xs.size(): " << n);
+  }
+  for (unsigned i = 0; i < n; ++i) {
+    CHECK_DEVICE(*gs[i]);
+    CHECK_DEVICE(*m1s[i]);
+    CHECK_DEVICE(*m2s[i]);
+    CHECK_DEVICE(*xs[i]);
+    CHECK_SAME_SHAPE(*gs[i], *xs[i]);
+    CHECK_SAME_SHAPE(*m1s[i], *xs[i]);
+    CHECK_SAME_SHAPE(*m2s[i], *xs[i]);
+  }
+  if (epoch == 0) {
+    THROW_ERROR("Invalid epoch of the Adam update: " << epoch);
+  }
+  if (n == 0) return;
+  if (!observer_) {
+    adam_update_multi_impl(alpha, beta1, beta2, eps, epoch, gs, m1s, m2s, xs);
+  } else {
+    const double start_us = observer_clock();
+    adam_update_multi_impl(alpha, beta1, beta2, eps, epoch, gs, m1s, m2s, xs);
+    vector<const Shape *> shapes;
+    double size = 0;
+    for (const Tensor *g : gs) shapes.emplace_back(&g->shape());
+    for (const Tensor *m1 : m1s) shapes.insert(shapes.end(), 2, &m1->shape());
+    for (const Tensor *m2 : m2s) shapes.insert(shapes.end(), 2, &m2->shape());
+    for (const Tensor *x : xs) {
+      shapes.insert(shapes.end(), 2, &x->shape());
+      size += x->shape().size();
+    }
+    notify_kernel("adam_update", std::move(shapes), 12. * size, start_us);
+  }
+}
+
+Tensor Device::squared_norm(const vector<const Tensor *> &xs) {
+  for (const Tensor *x : xs) CHECK_DEVICE(*x);
+  Tensor y = new_tensor({}, 0);
+  if (xs.empty()) return y;
+  if (!observer_) {
+    squared_norm_multi_impl(xs, y);
+  } else {
+    const double start_us = observer_clock();
+    squared_norm_multi_impl(xs, y);
+    vector<const Shape *> shapes;
+    double size = 0;
+    for (const Tensor *x : xs) {
+      shapes.emplace_back(&x->shape());
+      size += x->shape().size();
+    }
+    shapes.emplace_back(&y.shape());
+    notify_kernel("squared_norm", std::move(shapes), 2. * size, start_us);
+  }
+  return y;
+}
+
+void Device::clip_by_norm(
+    float max_norm, const Tensor &sq_norm, const vector<Tensor *> &xs) {
+  CHECK_DEVICE(sq_norm);
+  for (const Tensor *x : xs) CHECK_DEVICE(*x);
+  if (sq_norm.shape() != Shape()) {
+    THROW_ERROR(
+        "sq_norm should be a scalar. shape: " << sq_norm.shape().to_string());
+  }
+  if (!(max_norm > 0)) {
+    THROW_ERROR("Invalid threshold of the norm: " << max_norm);
+  }
+  if (xs.empty()) return;
+  if (!observer_) {
+    clip_by_norm_multi_impl(max_norm, sq_norm, xs);
+  } else {
+    const double start_us = observer_clock();
+    clip_by_norm_multi_impl(max_norm, sq_norm, xs);
+    vector<const Shape *> shapes {&sq_norm.shape()};
+    double size = 0;
+    for (const Tensor *x : xs) {
+      shapes.insert(shapes.end(), 2, &x->shape());
+      size += x->shape().size();
+    }
+    notify_kernel("clip_by_norm", std::move(shapes), 1. * size, start_us);
+  }
+}
+
+void Device::top_k(
+    const Tensor &x, unsigned k, vector<unsigned> &ids, vector<float> &values) {
+  CHECK_DEVICE(x);
+  const Shape &sx = x.shape();
+  if (k == 0 || k > sx.volume()) {
+    THROW_ERROR(
+        "Invalid number of elements to select. shape: " << sx.to_string()
+        << ", k: " << k);
+  }
+  ids.resize(k * sx.batch());
+  values.resize(k * sx.batch());
+  OBSERVE(top_k_impl(x, k, ids.data(), values.data()), "top_k", 0, &sx);
+}
+
+#undef CHECK_SAME_SHAPE
+#undef OBSERVE
+
 }  // namespace primitiv
@@ -2,11 +2,17 @@
 #define PRIMITIV_DEVICE_H_
 
 #include <memory>
+#include <mutex>
+#include <primitiv/device_observer.h>
+#include <primitiv/elementwise_program.h>
+#include <primitiv/memory_pool_stats.h>
 #include <primitiv/shape.h>
 #include <primitiv/tensor.h>
 
 namespace primitiv {
 
+class QuantizedParameter;
+
 /**
  * Interface of the Tensor provider.
  */
@@ -27,7 +33,17 @@ public:
     DEVICE_TYPE_CUDA = 0x10000,
   };
 
-  Device() = default;
+  /**
+   * Activation functions which can be fused into other operations.
+   */
+  enum Activation {
+    ACTIVATION_IDENTITY,
+    ACTIVATION_RELU,
+    ACTIVATION_TANH,
+    ACTIVATION_SIGMOID,
+  };
+
+  Device() : observer_(nullptr), workspace_size_(0) {}
   virtual ~Device() = default;
 
   /**
@@ -36,6 +52,98 @@ public:
    */
   virtual DeviceType type() const = 0;
 
+  /**
+   * Retrieves the usage of the memory pool of this device.
+   * @return Statistics of the memory pool.
+   */
+  virtual MemoryPoolStats memory_pool_stats() const = 0;
+
+  /**
+   * Releases all memory blocks which are reserved in the memory pool and
+   * not used by any tensor.
+   */
+  virtual void release_reserved_memory() = 0;
+
+  /**
+   * Blocks the caller until all operations issued to this device finish.
+   * @remarks Operations on some devices run asynchronously with the host.
+   *          Functions which return values to the host (e.g.
+   *          `tensor_to_vector()`) always wait for pending operations, and
+   *          this function is needed only to measure or bound the execution.
+   */
+  virtual void synchronize() = 0;
+
+  /**
+   * Sets the observer which receives every kernel called by this device.
+   * @param observer Pointer to the observer, or nullptr to remove the
+   *                 current observer. The device does not take the ownership.
+   * @remarks While the observer is set, the device is synchronized before and
+   *          after each kernel to measure its duration. Without the observer,
+   *          each method only checks the null pointer.
+   */
+  void set_observer(DeviceObserver *observer) { observer_ = observer; }
+
+  /**
+   * Retrieves the current observer.
+   * @return Pointer to the observer, or nullptr if it is not set.
+   */
+  DeviceObserver *observer() const { return observer_; }
+
+  /**
+   * Makes the next new tensor use the given memory instead of the memory pool.
+   * @param handle Memory which can store at least `size` elements.
+   * @param size Number of elements of the tensor which uses `handle`.
+   * @remarks Only the first tensor with exactly `size` elements uses `handle`,
+   *          and other tensors are allocated as usual. The placement remains
+   *          until it is used or `cancel_placement()` is called.
+   *          The placement only affects tensors made by the calling thread,
+   *          and each thread can place one tensor at a time. This function
+   *          is mainly used by `Graph` and `InferencePlan` to execute their
+   *          memory plans.
+   */
+  void place_next_tensor(std::shared_ptr<void> handle, unsigned size);
+
+  /**
+   * Makes the next new tensor use a part of the memory of another tensor.
+   * @param dest Tensor whose memory is used, e.g. the preallocated result of
+   *             `concat_fw()`.
+   * @param offset Number of elements of `dest` before the part.
+   * @param size Number of elements of the part.
+   * @remarks Same as `place_next_tensor(handle, size)`, the placement is
+   *          used by the first tensor with exactly `size` elements.
+   *          Tensors which are adjacent parts of the same memory in order are
+   *          concatenated by `concat_fw()` and `batch_concat_fw()` without
+   *          copy if the layout of the result allows it. Arguments of such
+   *          concatenations are copied on write as usual, but updating the
+   *          result in place also changes their values.
+   */
+  void place_next_tensor(const Tensor &dest, unsigned offset, unsigned size);
+
+  /**
+   * Cancels the placement specified by `place_next_tensor()` if it is not
+   * used yet.
+   */
+  void cancel_placement();
+
+  /**
+   * Provides a temporary tensor for intermediate values of an operation,
+   * e.g., gradients which are calculated and discarded by backward kernels.
+   * @param shape Shape of the tensor.
+   * @return A new tensor with uninitialized values.
+   * @remarks The memory is taken from the workspace of this device if no other
+   *          workspace tensor is alive, otherwise it is allocated as usual.
+   *          The workspace grows to the largest shape requested so far, and
+   *          is reused after the returned tensor is released. The tensor is
+   *          aliased and should not live beyond the current operation.
+   */
+  Tensor new_workspace_tensor(const Shape &shape);
+
+  /**
+   * Retrieves the capacity of the workspace.
+   * @return Number of elements of the workspace.
+   */
+  unsigned workspace_size() const;
+
   /**
    * Provides a new Tensor object on the device.
    * @param shape Shape of the tensor.
@@ -86,11 +194,18 @@ public:
 
   // Tensor manipulations.
   Tensor pick_fw(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids);
+  Tensor gather_fw(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids);
   Tensor slice_fw(const Tensor &x, unsigned dim, unsigned lower, unsigned upper);
   Tensor concat_fw(const std::vector<const Tensor *> &xs, unsigned dim);
+  Tensor batch_slice_fw(const Tensor &x, unsigned lower, unsigned upper);
+  Tensor batch_concat_fw(const std::vector<const Tensor *> &xs);
+  Tensor batch_pick_fw(const Tensor &x, const std::vector<unsigned> &ids);
 
   void pick_bw(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx);
+  void pick_assign(const Tensor &y, unsigned dim, const std::vector<unsigned> &ids, Tensor &x);
+  void gather_bw(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx);
   void slice_bw(const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx);
+  void batch_pick_bw(const Tensor &gy, const std::vector<unsigned> &ids, Tensor &gx);
 
   // Unary operations.
   Tensor negate_fw(const Tensor &x);
@@ -164,9 +279,147 @@ public:
       const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy,
       Tensor &ga, Tensor &gb);
 
+  /**
+   * Calculates `act(w . x + b)` by one fused operation.
+   * @param w Left hand side of the matrix product.
+   * @param x Right hand side of the matrix product.
+   * @param b Bias vector which is added to every column of `w . x`.
+   * @param act Activation function.
+   * @return Resulting tensor.
+   * @remarks The bias and the activation are applied to the result of the
+   *          matrix product directly, and `b` is never broadcasted to a
+   *          temporary matrix.
+   */
+  Tensor affine_fw(
+      const Tensor &w, const Tensor &x, const Tensor &b, Activation act);
+
+  /**
+   * Calculates gradients of `affine_fw()`.
+   * @param w Left hand side of the matrix product.
+   * @param x Right hand side of the matrix product.
+   * @param b Bias vector.
+   * @param y Result of `affine_fw()`.
+   * @param gy Gradient of `y`.
+   * @param act Activation function used in `affine_fw()`.
+   * @param gw Gradient of `w` which is updated.
+   * @param gx Gradient of `x` which is updated.
+   * @param gb Gradient of `b` which is updated.
+   */
+  void affine_bw(
+      const Tensor &w, const Tensor &x, const Tensor &b,
+      const Tensor &y, const Tensor &gy, Activation act,
+      Tensor &gw, Tensor &gx, Tensor &gb);
+
+  /**
+   * Calculates one step of the LSTM cell by one kernel:
+   *   i = sigmoid(u[0:n]), f = sigmoid(u[n:2n]), o = sigmoid(u[2n:3n]),
+   *   j = tanh(u[3n:4n]), c' = i * j + f * c, h = o * tanh(c').
+   * @param u Preactivations of all gates concatenated along the first
+   *          dimension, e.g. the result of one gemm with stacked weights.
+   * @param c Cell state of the previous step.
+   * @return Concatenation of `h` and `c'` along the first dimension.
+   */
+  Tensor lstm_cell_fw(const Tensor &u, const Tensor &c);
+
+  /**
+   * Calculates gradients of `lstm_cell_fw()` by one kernel.
+   * @param u Preactivations of all gates.
+   * @param c Cell state of the previous step.
+   * @param y Result of `lstm_cell_fw()`.
+   * @param gy Gradient of `y`.
+   * @param gu Gradient of `u` which is updated.
+   * @param gc Gradient of `c` which is updated.
+   */
+  void lstm_cell_bw(
+      const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+      Tensor &gu, Tensor &gc);
+
+  /**
+   * Calculates all steps of the LSTM by one persistent kernel:
+   *   u_t = xu[:, t] + wh . h_{t-1},
+   *   (h_t, c_t) = lstm_cell(u_t, c_{t-1}),
+   * where h_{-1} = h0 and c_{-1} = c0.
+   * @param xu Input preactivations of all gates with the shape [4n, T],
+   *           e.g. the result of one gemm over inputs of all steps.
+   * @param wh Recurrent weight matrix with the shape [4n, n], which should
+   *           not have the minibatch.
+   * @param h0 Initial hidden state with the shape [n].
+   * @param c0 Initial cell state with the shape [n].
+   * @return Concatenation of h_t and c_t along the first dimension for each
+   *         step, with the shape [2n, T].
+   */
+  Tensor lstm_fw(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0);
+
+  /**
+   * Calculates gradients of `lstm_fw()` through all steps.
+   * @param xu Input preactivations of all gates.
+   * @param wh Recurrent weight matrix.
+   * @param h0 Initial hidden state.
+   * @param c0 Initial cell state.
+   * @param y Result of `lstm_fw()`.
+   * @param gy Gradient of `y`.
+   * @param gxu Gradient of `xu` which is updated.
+   * @param gwh Gradient of `wh` which is updated.
+   * @param gh0 Gradient of `h0` which is updated.
+   * @param gc0 Gradient of `c0` which is updated.
+   */
+  void lstm_bw(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      const Tensor &y, const Tensor &gy,
+      Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0);
+
+  /**
+   * Calculates the matrix product of a quantized matrix and a float tensor.
+   * @param w Quantized left hand side, which should be made on this device.
+   * @param x Right hand side.
+   * @return Resulting tensor.
+   * @remarks Each column of `x` is quantized to int8 on the fly, and the
+   *          result is an approximation of `matmul_fw(w', x)` where `w'` is
+   *          the original matrix.
+   */
+  Tensor quantized_matmul_fw(const QuantizedParameter &w, const Tensor &x);
+
+  /**
+   * Calculates the mean and the unbiased variance of each element over the
+   * minibatch by one pass.
+   * @param x A tensor whose batch size is greater than 1.
+   * @param mean Tensor which is replaced by the resulting mean.
+   * @param var Tensor which is replaced by the resulting variance.
+   * @remarks Statistics are accumulated by Welford's algorithm, which does not
+   *          lose precision when the mean is far from 0.
+   */
+  void batch_moments_fw(const Tensor &x, Tensor &mean, Tensor &var);
+
+  /**
+   * Normalizes each sample in the minibatch by one kernel:
+   *   y = (x - mean) / sqrt(var + eps).
+   * @param x A tensor to be normalized.
+   * @param mean Mean of each element, without the minibatch.
+   * @param var Variance of each element, without the minibatch.
+   * @param eps Small constant added to the variance.
+   * @return Resulting tensor.
+   */
+  Tensor batch_normalize_fw(
+      const Tensor &x, const Tensor &mean, const Tensor &var, float eps);
+
+  /**
+   * Calculates a sequence of elementwise operations by one kernel.
+   * @param prog Program to be calculated.
+   * @param xs Input tensors. All tensors should have the same dimensions, and
+   *           their batch sizes should be the same or 1.
+   * @return Resulting tensor.
+   * @remarks Each element of the result is calculated without storing
+   *          intermediate values to memory.
+   */
+  Tensor elementwise_fw(
+      const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs);
+
   // Dimension operations.
   Tensor sum_fw(const Tensor &x, unsigned dim);
   Tensor logsumexp_fw(const Tensor &x, unsigned dim);
+  Tensor softmax_fw(const Tensor &x, unsigned dim);
+  Tensor log_softmax_fw(const Tensor &x, unsigned dim);
   Tensor broadcast_fw(const Tensor &x, unsigned dim, unsigned size);
   Tensor batch_sum_fw(const Tensor &x);
 
@@ -199,6 +452,141 @@ public:
    */
   void inplace_subtract(const Tensor &x, Tensor &y);
 
+  /**
+   * Directly updates a parameter using the SGD rule: x -= eta * g
+   * @param eta Learning rate.
+   * @param g Gradient of the parameter.
+   * @param x Value of the parameter to be updated.
+   * @remarks All tensors should have the same shape.
+   */
+  void sgd_update(float eta, const Tensor &g, Tensor &x);
+
+  /**
+   * Directly updates a parameter and its velocity using SGD with momentum:
+   *   m = momentum * m - eta * g
+   *   x += m
+   * @param eta Learning rate.
+   * @param momentum Decay factor of the velocity.
+   * @param g Gradient of the parameter.
+   * @param m Velocity of the parameter to be updated.
+   * @param x Value of the parameter to be updated.
+   * @remarks All tensors should have the same shape.
+   */
+  void momentum_sgd_update(
+      float eta, float momentum, const Tensor &g, Tensor &m, Tensor &x);
+
+  /**
+   * Directly updates a parameter and its moments using the Adam rule:
+   *   m1 = beta1 * m1 + (1 - beta1) * g
+   *   m2 = beta2 * m2 + (1 - beta2) * g^2
+   *   x -= alpha * (m1 / (1 - beta1^epoch))
+   *        / (sqrt(m2 / (1 - beta2^epoch)) + eps)
+   * @param alpha Learning rate.
+   * @param beta1 Decay factor of the 1st moment.
+   * @param beta2 Decay factor of the 2nd moment.
+   * @param eps Bias of the denominator.
+   * @param epoch Current epoch (starts from 1) used by the bias correction.
+   * @param g Gradient of the parameter.
+   * @param m1 1st moment of the parameter to be updated.
+   * @param m2 2nd moment of the parameter to be updated.
+   * @param x Value of the parameter to be updated.
+   * @remarks All tensors should have the same shape. Each element is read
+   *          and written only once.
+   */
+  void adam_update(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x);
+
+  /**
+   * Applies `sgd_update` to multiple parameters at once.
+   * @param eta Learning rate.
+   * @param gs Gradients of the parameters.
+   * @param xs Values of the parameters to be updated.
+   * @remarks `gs[i]` and `xs[i]` should have the same shape. Devices may
+   *          process all parameters by a few kernel launches.
+   */
+  void sgd_update(
+      float eta,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &xs);
+
+  /**
+   * Applies `momentum_sgd_update` to multiple parameters at once.
+   * @param eta Learning rate.
+   * @param momentum Decay factor of the velocity.
+   * @param gs Gradients of the parameters.
+   * @param ms Velocities of the parameters to be updated.
+   * @param xs Values of the parameters to be updated.
+   * @remarks `gs[i]`, `ms[i]` and `xs[i]` should have the same shape.
+   *          Devices may process all parameters by a few kernel launches.
+   */
+  void momentum_sgd_update(
+      float eta, float momentum,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+      const std::vector<Tensor *> &xs);
+
+  /**
+   * Applies `adam_update` to multiple parameters at once.
+   * @param alpha Learning rate.
+   * @param beta1 Decay factor of the 1st moment.
+   * @param beta2 Decay factor of the 2nd moment.
+   * @param eps Bias of the denominator.
+   * @param epoch Current epoch (starts from 1) used by the bias correction.
+   * @param gs Gradients of the parameters.
+   * @param m1s 1st moments of the parameters to be updated.
+   * @param m2s 2nd moments of the parameters to be updated.
+   * @param xs Values of the parameters to be updated.
+   * @remarks `gs[i]`, `m1s[i]`, `m2s[i]` and `xs[i]` should have the same
+   *          shape. Devices may process all parameters by a few kernel
+   *          launches.
+   */
+  void adam_update(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+      const std::vector<Tensor *> &m2s, const std::vector<Tensor *> &xs);
+
+  /**
+   * Calculates the sum of squares of all elements in multiple tensors:
+   *   y = sum_i sum_j xs[i][j]^2
+   * @param xs Tensors.
+   * @return A new scalar tensor on this device.
+   * @remarks Devices may process all tensors by a few kernel launches, and the
+   *          result is not transferred to the host.
+   */
+  Tensor squared_norm(const std::vector<const Tensor *> &xs);
+
+  /**
+   * Scales multiple tensors so that their global L2 norm does not exceed the
+   * threshold:
+   *   xs[i] *= min(1, max_norm / sqrt(sq_norm))
+   * @param max_norm Threshold of the norm.
+   * @param sq_norm A scalar tensor holding the squared global norm of `xs`,
+   *                e.g., the result of `squared_norm()`.
+   * @param xs Tensors to be scaled.
+   * @remarks The scaling factor is calculated on the device, i.e., this
+   *          function does not wait for `sq_norm`.
+   */
+  void clip_by_norm(
+      float max_norm, const Tensor &sq_norm, const std::vector<Tensor *> &xs);
+
+  /**
+   * Selects the `k` largest elements of each sample in the minibatch.
+   * @param x A tensor. Elements of each sample are treated as one vector in
+   *          the column-major order.
+   * @param k Number of elements to be selected. This should be in the range
+   *          [1, x.shape().volume()].
+   * @param ids List which is replaced by the indices of selected elements:
+   *            `ids[b * k + i]` is the index of the `i`-th largest element of
+   *            the `b`-th sample.
+   * @param values List which is replaced by the values of selected elements
+   *               in the same order as `ids`.
+   * @remarks Equal values are ordered by their indices. Only the resulting
+   *          `k * x.shape().batch()` indices and values are transferred to
+   *          the host.
+   */
+  void top_k(
+      const Tensor &x, unsigned k,
+      std::vector<unsigned> &ids, std::vector<float> &values);
+
 private:
   /**
    * Retrieves internal values of the tensor as a vector.
@@ -209,6 +597,76 @@ private:
    */
   std::vector<float> tensor_to_vector(const Tensor &x);
 
+  /**
+   * Retrieves internal values of the tensor into the host memory.
+   * @param x A tensor.
+   * @param values Array to store `x.shape().size()` values.
+   * @remarks Each resulting values are ordered by the column-major order, and
+   *          the batch size is assumed as the last dimension of the tensor.
+   */
+  void tensor_to_array(const Tensor &x, float values[]);
+
+  /**
+   * Makes a tensor which refers a contiguous part of the memory of `x`.
+   * @param x A tensor.
+   * @param shape Shape of the resulting tensor.
+   * @param offset Number of elements before the first element of the result.
+   * @return A new tensor.
+   * @remarks Unlike `Tensor::view()`, the resulting tensor is not aliased, and
+   *          the memory is duplicated when either tensor is updated. If `x` is
+   *          aliased, the result obtains a copy of the part immediately.
+   */
+  Tensor share_tensor(const Tensor &x, const Shape &shape, unsigned offset);
+
+  /**
+   * Makes an aliased tensor which refers a contiguous part of the memory of
+   * `x` without changing `x`.
+   * @param x A tensor.
+   * @param shape Shape of the resulting tensor.
+   * @param offset Number of elements before the first element of the result.
+   * @return A new tensor.
+   * @remarks Updating the result writes into the memory of `x` without the
+   *          copy-on-write behavior. The result should not live beyond the
+   *          current operation.
+   */
+  Tensor alias_tensor(const Tensor &x, const Shape &shape, unsigned offset);
+
+  /**
+   * Concatenates tensors without copy if they are adjacent parts of the same
+   * memory in order.
+   * @param xs List of tensors.
+   * @param shape Shape of the result.
+   * @return A tensor which refers the memory of all tensors, or an invalid
+   *         tensor if the memory of some tensor does not just follow the
+   *         previous one.
+   */
+  Tensor concat_in_memory(
+      const std::vector<const Tensor *> &xs, const Shape &shape);
+
+  /**
+   * Provides the memory of a new tensor, using the placement if available.
+   * @param shape Shape of the tensor.
+   * @return Handle of the memory.
+   */
+  std::shared_ptr<void> allocate_handle(const Shape &shape);
+
+  /**
+   * Synchronizes the device and returns the current time for the observer.
+   * @return Current time in microseconds.
+   */
+  double observer_clock();
+
+  /**
+   * Notifies the observer of a finished kernel.
+   * @param name Name of the kernel.
+   * @param shapes Shapes of arguments and results.
+   * @param flops Estimated number of floating point operations.
+   * @param start_us Return value of `observer_clock()` before the call.
+   */
+  void notify_kernel(
+      const char *name, std::vector<const Shape *> &&shapes, double flops,
+      double start_us);
+
 protected:
   /**
    * Reset internal values of the tensor using a constant.
@@ -237,12 +695,19 @@ protected:
    */
   void reset_tensor_by_vector(const std::vector<float> &values, Tensor &x);
 
+  /**
+   * Forgets the current workspace. The memory is released when no tensor
+   * refers to it, and the next workspace tensor allocates a new one.
+   */
+  void release_workspace();
+
 private:
   // device-specific implementations.
 
   virtual std::shared_ptr<void> new_handle(const Shape &shape) = 0;
 
   virtual std::vector<float> tensor_to_vector_impl(const Tensor &x) = 0;
+  virtual void tensor_to_array_impl(const Tensor &x, float values[]) = 0;
 
   virtual void reset_tensor_impl(float k, Tensor &x) = 0;
   virtual void reset_tensor_by_array_impl(const float values[], Tensor &x) = 0;
@@ -255,10 +720,13 @@ private:
   virtual void random_log_normal_impl(float mean, float sd, Tensor &y) = 0;
 
   virtual void pick_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) = 0;
+  virtual void gather_fw_impl(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids, Tensor &y) = 0;
   virtual void slice_fw_impl(const Tensor &x, unsigned dim, unsigned offset, Tensor &y) = 0;
   virtual void concat_fw_impl(const std::vector<const Tensor *> &xs, unsigned dim, Tensor &y) = 0;
 
   virtual void pick_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) = 0;
+  virtual void pick_assign_impl(const Tensor &y, unsigned dim, const std::vector<unsigned> &ids, Tensor &x) = 0;
+  virtual void gather_bw_impl(const Tensor &gy, unsigned dim, const std::vector<unsigned> &ids, Tensor &gx) = 0;
   virtual void slice_bw_impl(const Tensor &gy, unsigned dim, unsigned offset, Tensor &gx) = 0;
 
   virtual void negate_fw_impl(const Tensor &x, Tensor &y) = 0;
@@ -329,8 +797,43 @@ private:
       const Tensor &a, const Tensor &b, const Tensor &y, const Tensor &gy,
       Tensor &ga, Tensor &gb) = 0;
 
+  virtual void affine_fw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b, Activation act,
+      Tensor &y) = 0;
+  virtual void affine_bw_impl(
+      const Tensor &w, const Tensor &x, const Tensor &b,
+      const Tensor &y, const Tensor &gy, Activation act,
+      Tensor &gw, Tensor &gx, Tensor &gb) = 0;
+
+  virtual void lstm_cell_fw_impl(
+      const Tensor &u, const Tensor &c, Tensor &y) = 0;
+  virtual void lstm_cell_bw_impl(
+      const Tensor &u, const Tensor &c, const Tensor &y, const Tensor &gy,
+      Tensor &gu, Tensor &gc) = 0;
+  virtual void lstm_fw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      Tensor &y) = 0;
+  virtual void lstm_bw_impl(
+      const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0,
+      const Tensor &y, const Tensor &gy,
+      Tensor &gxu, Tensor &gwh, Tensor &gh0, Tensor &gc0) = 0;
+
+  virtual void quantized_matmul_fw_impl(
+      const QuantizedParameter &w, const Tensor &x, Tensor &y) = 0;
+  virtual void batch_moments_fw_impl(
+      const Tensor &x, Tensor &mean, Tensor &var) = 0;
+  virtual void batch_normalize_fw_impl(
+      const Tensor &x, const Tensor &mean, const Tensor &var, float eps,
+      Tensor &y) = 0;
+
+  virtual void elementwise_fw_impl(
+      const ElementwiseProgram &prog, const std::vector<const Tensor *> &xs,
+      Tensor &y) = 0;
+
   virtual void sum_fw_impl(const Tensor &x, unsigned dim, Tensor &y) = 0;
   virtual void logsumexp_fw_impl(const Tensor &x, unsigned dim, Tensor &y) = 0;
+  virtual void softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) = 0;
+  virtual void log_softmax_fw_impl(const Tensor &x, unsigned dim, Tensor &y) = 0;
   virtual void broadcast_fw_impl(const Tensor &x, unsigned dim, unsigned size, Tensor &y) = 0;
   virtual void batch_sum_fw_impl(const Tensor &x, Tensor &y) = 0;
 
@@ -338,6 +841,43 @@ private:
 
   virtual void inplace_add_impl(const Tensor &x, Tensor &y) = 0;
   virtual void inplace_subtract_impl(const Tensor &x, Tensor &y) = 0;
+
+  virtual void sgd_update_impl(float eta, const Tensor &g, Tensor &x) = 0;
+  virtual void momentum_sgd_update_impl(
+      float eta, float momentum, const Tensor &g, Tensor &m, Tensor &x) = 0;
+  virtual void adam_update_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const Tensor &g, Tensor &m1, Tensor &m2, Tensor &x) = 0;
+
+  virtual void sgd_update_multi_impl(
+      float eta,
+      const std::vector<const Tensor *> &gs,
+      const std::vector<Tensor *> &xs) = 0;
+  virtual void momentum_sgd_update_multi_impl(
+      float eta, float momentum,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &ms,
+      const std::vector<Tensor *> &xs) = 0;
+  virtual void adam_update_multi_impl(
+      float alpha, float beta1, float beta2, float eps, unsigned epoch,
+      const std::vector<const Tensor *> &gs, const std::vector<Tensor *> &m1s,
+      const std::vector<Tensor *> &m2s, const std::vector<Tensor *> &xs) = 0;
+
+  virtual void squared_norm_multi_impl(
+      const std::vector<const Tensor *> &xs, Tensor &y) = 0;
+  virtual void clip_by_norm_multi_impl(
+      float max_norm, const Tensor &sq_norm,
+      const std::vector<Tensor *> &xs) = 0;
+
+  virtual void top_k_impl(
+      const Tensor &x, unsigned k, unsigned ids[], float values[]) = 0;
+
+  // Receiver of kernel calls, or nullptr.
+  DeviceObserver *observer_;
+
+  // Memory reused by `new_workspace_tensor()`.
+  mutable std::mutex workspace_mutex_;
+  std::shared_ptr<void> workspace_;
+  unsigned workspace_size_;
 };
 
 }  // namespace primitiv
@@ -0,0 +1,64 @@
+#ifndef PRIMITIV_DEVICE_OBSERVER_H_
+#define PRIMITIV_DEVICE_OBSERVER_H_
+
+#include <vector>
+#include <primitiv/shape.h>
+
+namespace primitiv {
+
+class Device;
+
+/**
+ * Interface to receive every kernel called through the public methods of
+ * `Device`.
+ */
+class DeviceObserver {
+public:
+  /**
+   * Information of one kernel call.
+   */
+  struct KernelInfo {
+    /**
+     * Name of the method of `Device`, e.g. "matmul_fw".
+     */
+    const char *name;
+
+    /**
+     * Shapes of arguments followed by shapes of results. Tensors updated in
+     * place appear in both. Pointers are valid only while the callback.
+     */
+    std::vector<const Shape *> shapes;
+
+    /**
+     * Estimated number of floating point operations.
+     */
+    double flops;
+
+    /**
+     * Estimated size of memory transfers in bytes, which assumes that each
+     * tensor in `shapes` is read or written once.
+     */
+    double bytes;
+
+    /**
+     * Wall time of the call in microseconds, including the time to wait for
+     * asynchronous operations of the device.
+     */
+    double duration_us;
+  };
+
+  virtual ~DeviceObserver() = default;
+
+  /**
+   * Called after each kernel finishes.
+   * @param device Device which calculated the kernel.
+   * @param info Information of the call.
+   * @remarks This function is called by the thread which called the method of
+   *          the device.
+   */
+  virtual void on_kernel(Device &device, const KernelInfo &info) = 0;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_DEVICE_OBSERVER_H_
@@ -0,0 +1,121 @@
+#ifndef PRIMITIV_ELEMENTWISE_OPS_H_
+#define PRIMITIV_ELEMENTWISE_OPS_H_
+
+#include <cmath>
+
+#ifdef __CUDACC__
+#define PRIMITIV_ELEMENTWISE_FN __host__ __device__ inline
+#else
+#define PRIMITIV_ELEMENTWISE_FN inline
+#endif  // __CUDACC__
+
+// NOTE(odashi):
+// Rounding intrinsics prevent the device compiler from contracting binary
+// operations of fused programs into FMA instructions.
+#ifdef __CUDA_ARCH__
+#define PRIMITIV_ELEMENTWISE_ADD(a, b) ::__fadd_rn((a), (b))
+#define PRIMITIV_ELEMENTWISE_SUB(a, b) ::__fsub_rn((a), (b))
+#define PRIMITIV_ELEMENTWISE_MUL(a, b) ::__fmul_rn((a), (b))
+#define PRIMITIV_ELEMENTWISE_DIV(a, b) ::__fdiv_rn((a), (b))
+#else
+#define PRIMITIV_ELEMENTWISE_ADD(a, b) ((a) + (b))
+#define PRIMITIV_ELEMENTWISE_SUB(a, b) ((a) - (b))
+#define PRIMITIV_ELEMENTWISE_MUL(a, b) ((a) * (b))
+#define PRIMITIV_ELEMENTWISE_DIV(a, b) ((a) / (b))
+#endif  // __CUDA_ARCH__
+
+namespace primitiv {
+
+/**
+ * Definitions of elementwise operations shared by all devices.
+ *
+ * Each unary functor provides:
+ *   static float fw(float x, float k): the result `y` of the operation.
+ *   static float bw(float x, float y, float gy, float k): the gradient of `x`.
+ * and each binary functor provides:
+ *   static float fw(float a, float b): the result `y` of the operation.
+ *   static void bw(float a, float b, float y, float gy, float &ga, float &gb):
+ *     gradients of `a` and `b`.
+ * `k` is the constant of the operation and is ignored by other operations.
+ * Devices apply these functors by their own loops, and a new operation only
+ * requires a new functor and one line of each device.
+ *
+ * Transcendental functions and polynomials are calculated using the type `R`:
+ * CPUDevice uses `double` and CUDADevice uses `float`.
+ */
+namespace elementwise {
+
+#define PRIMITIV_ELEMENTWISE_UNARY(name, fw_expr, bw_expr) \
+  template<typename R> \
+  struct name { \
+    PRIMITIV_ELEMENTWISE_FN static float fw(float x, float k) { \
+      static_cast<void>(k); \
+      return (fw_expr); \
+    } \
+    PRIMITIV_ELEMENTWISE_FN static float bw( \
+        float x, float y, float gy, float k) { \
+      static_cast<void>(x); \
+      static_cast<void>(y); \
+      static_cast<void>(k); \
+      return (bw_expr); \
+    } \
+  }
+
+PRIMITIV_ELEMENTWISE_UNARY(Negate, -x, -gy);
+PRIMITIV_ELEMENTWISE_UNARY(Sqrt, ::sqrt(R(x)), R(.5) * gy / y);
+PRIMITIV_ELEMENTWISE_UNARY(Exp, ::exp(R(x)), y * gy);
+PRIMITIV_ELEMENTWISE_UNARY(Tanh, ::tanh(R(x)), (R(1) - R(y) * y) * gy);
+PRIMITIV_ELEMENTWISE_UNARY(
+    Sigmoid, R(.5) + R(.5) * ::tanh(R(.5) * x), R(y) * (R(1) - y) * gy);
+PRIMITIV_ELEMENTWISE_UNARY(
+    Softplus, (x > 0 ? R(x) : R(0)) + ::log(R(1) + ::exp(-::fabs(R(x)))),
+    (R(.5) + R(.5) * ::tanh(R(.5) * x)) * gy);
+PRIMITIV_ELEMENTWISE_UNARY(Sin, ::sin(R(x)), ::cos(R(x)) * gy);
+PRIMITIV_ELEMENTWISE_UNARY(Cos, ::cos(R(x)), -::sin(R(x)) * gy);
+PRIMITIV_ELEMENTWISE_UNARY(Tan, ::tan(R(x)), (R(1) + R(y) * y) * gy);
+
+PRIMITIV_ELEMENTWISE_UNARY(AddConst, x + k, gy);
+PRIMITIV_ELEMENTWISE_UNARY(SubtractConstR, x - k, gy);
+PRIMITIV_ELEMENTWISE_UNARY(SubtractConstL, k - x, -gy);
+PRIMITIV_ELEMENTWISE_UNARY(MultiplyConst, x * k, k * gy);
+PRIMITIV_ELEMENTWISE_UNARY(DivideConstR, x / k, gy / k);
+PRIMITIV_ELEMENTWISE_UNARY(DivideConstL, k / x, -y * gy / x);
+// NOTE(odashi): Selections keep NaNs of `x` unlike fmax() and fmin() if the
+// compiler respects IEEE semantics.
+PRIMITIV_ELEMENTWISE_UNARY(
+    PReLU, x > 0 ? x : k * x, gy * ((x > 0) + k * (x <= 0)));
+PRIMITIV_ELEMENTWISE_UNARY(
+    ELU, x > 0 ? R(x) : k * (::exp(R(x)) - R(1)),
+    gy * ((x > 0) + (y + k) * (x <= 0)));
+
+#undef PRIMITIV_ELEMENTWISE_UNARY
+
+#define PRIMITIV_ELEMENTWISE_BINARY(name, fw_expr, ga_expr, gb_expr) \
+  template<typename R> \
+  struct name { \
+    PRIMITIV_ELEMENTWISE_FN static float fw(float a, float b) { \
+      return (fw_expr); \
+    } \
+    PRIMITIV_ELEMENTWISE_FN static void bw( \
+        float a, float b, float y, float gy, float &ga, float &gb) { \
+      static_cast<void>(a); \
+      static_cast<void>(b); \
+      static_cast<void>(y); \
+      ga = (ga_expr); \
+      gb = (gb_expr); \
+    } \
+  }
+
+PRIMITIV_ELEMENTWISE_BINARY(Add, PRIMITIV_ELEMENTWISE_ADD(a, b), gy, gy);
+PRIMITIV_ELEMENTWISE_BINARY(Subtract, PRIMITIV_ELEMENTWISE_SUB(a, b), gy, -gy);
+PRIMITIV_ELEMENTWISE_BINARY(
+    Multiply, PRIMITIV_ELEMENTWISE_MUL(a, b), gy * b, gy * a);
+PRIMITIV_ELEMENTWISE_BINARY(
+    Divide, PRIMITIV_ELEMENTWISE_DIV(a, b), gy / b, -(gy / b) * y);
+
+#undef PRIMITIV_ELEMENTWISE_BINARY
+
+}  // namespace elementwise
+}  // namespace primitiv
+
+#endif  // PRIMITIV_ELEMENTWISE_OPS_H_
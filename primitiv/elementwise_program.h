@@ -0,0 +1,75 @@
+#ifndef PRIMITIV_ELEMENTWISE_PROGRAM_H_
+#define PRIMITIV_ELEMENTWISE_PROGRAM_H_
+
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Sequence of elementwise operations which is evaluated by one kernel.
+ * Each instruction calculates one temporary value for every element, and the
+ * value of the last instruction becomes the result.
+ */
+struct ElementwiseProgram {
+  /**
+   * Operations of each instruction.
+   */
+  enum Opcode {
+    /**
+     * Loads the `a`-th input tensor.
+     */
+    OPCODE_INPUT,
+
+    // Unary operations of the `a`-th value.
+    OPCODE_NEGATE,
+    OPCODE_SQRT,
+    OPCODE_EXP,
+    OPCODE_TANH,
+    OPCODE_SIGMOID,
+    OPCODE_SOFTPLUS,
+    OPCODE_SIN,
+    OPCODE_COS,
+    OPCODE_TAN,
+
+    // Operations between the `a`-th value and the constant `k`.
+    OPCODE_ADD_CONST,
+    OPCODE_SUBTRACT_CONST_R,
+    OPCODE_SUBTRACT_CONST_L,
+    OPCODE_MULTIPLY_CONST,
+    OPCODE_DIVIDE_CONST_R,
+    OPCODE_DIVIDE_CONST_L,
+    OPCODE_PRELU,
+    OPCODE_ELU,
+
+    // Operations between the `a`-th and the `b`-th values.
+    OPCODE_ADD,
+    OPCODE_SUBTRACT,
+    OPCODE_MULTIPLY,
+    OPCODE_DIVIDE,
+  };
+
+  /**
+   * One step of the program.
+   */
+  struct Instruction {
+    Opcode opcode;
+    unsigned a;
+    unsigned b;
+    float k;
+  };
+
+  /**
+   * Maximum number of instructions in a program.
+   */
+  static const unsigned MAX_INSTRUCTIONS = 32;
+
+  /**
+   * Instructions ordered by the evaluation order. Operands of each
+   * instruction should point to preceding instructions.
+   */
+  std::vector<Instruction> instructions;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_ELEMENTWISE_PROGRAM_H_
@@ -3,12 +3,15 @@
 
 #include <string>
 #include <vector>
+#include <primitiv/elementwise_program.h>
 #include <primitiv/shape.h>
 #include <primitiv/tensor.h>
 
 namespace primitiv {
 
+class BinaryWriter;
 class Device;
+class Parameter;
 
 /**
  * Interface of the function on the computation graph.
@@ -38,6 +41,70 @@ public:
    */
   virtual Device *get_device() const { return nullptr; }
 
+  /**
+   * Checks whether the function propagates gradients to parameters.
+   * @return true if `backward()` updates gradients of some parameters, false
+   *         otherwise.
+   */
+  virtual bool has_parameters() const { return false; }
+
+  /**
+   * Checks whether the function calculates each sample in the minibatch
+   * independently.
+   * @return true if `forward()` with arguments concatenated along the
+   *         minibatch returns the concatenation of results of each call,
+   *         false otherwise.
+   * @remarks Arguments with the minibatch size 1 are broadcasted as usual.
+   *          `Graph` uses this property to merge calls of the same function
+   *          with the same shapes into one call. Such functions should not
+   *          hold any state updated by `forward()`.
+   */
+  virtual bool batchable() const { return false; }
+
+  /**
+   * Retrieves the elementwise operation calculated by this function.
+   * @param inst Instruction to store the opcode and the constant. Operands are
+   *             not set by this function.
+   * @return true if the function is an elementwise operation which can be
+   *         fused with others, false otherwise.
+   */
+  virtual bool get_elementwise_op(ElementwiseProgram::Instruction &inst) const {
+    static_cast<void>(inst);
+    return false;
+  }
+
+  /**
+   * Retrieves the dimension concatenated by this function.
+   * @param dim Variable to store the dimension.
+   * @return true if `forward()` concatenates all arguments along `dim` in
+   *         order, false otherwise.
+   * @remarks `Graph` uses this property to calculate arguments directly into
+   *          the memory of the result.
+   */
+  virtual bool get_concat_dim(unsigned &dim) const {
+    static_cast<void>(dim);
+    return false;
+  }
+
+  /**
+   * Writes the type and attributes of the function, which are used by
+   * `InferencePlan` to make the same function.
+   * @param writer Writer of attributes.
+   * @param params Parameters used by the plan. Parameters used by this
+   *               function are appended if they are not in the list yet, and
+   *               are written by their indices.
+   * @return true if the function is written, false if the function is not
+   *         supported by `InferencePlan`. Nothing is written in this case.
+   * @remarks Exported functions should not hold any state updated by
+   *          `forward()` so that the plan can be calculated concurrently.
+   */
+  virtual bool write_attributes(
+      BinaryWriter &writer, std::vector<const Parameter *> &params) const {
+    static_cast<void>(writer);
+    static_cast<void>(params);
+    return false;
+  }
+
   /**
    * Calculates the forward path.
    * @param args argument tensors.
@@ -54,6 +121,13 @@ public:
    * @param arg_values Values of the argument nodes.
    * @param arg_grads Gradients of the argument nodes. These values are updated
    *                  by this method.
+   * @remarks Each element of `arg_grads` may be an invalid tensor if no
+   *          gradient was propagated to the argument yet. In this case, the
+   *          implementation should initialize it by the resulting gradient
+   *          (or by 0 before accumulating it).
+   *          Each element of `arg_grads` may also be nullptr if the gradient
+   *          of the argument is not required. The implementation should skip
+   *          calculating such gradients if possible.
    */
   virtual void backward(
       const Tensor &cur_value,
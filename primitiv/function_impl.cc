@@ -1,6 +1,7 @@
 #include <config.h>
 
 #include <algorithm>
+#include <primitiv/binary_io.h>
 #include <primitiv/error.h>
 #include <primitiv/function_impl.h>
 #include <primitiv/parameter.h>
@@ -10,6 +11,72 @@
 using std::vector;
 namespace T = primitiv::tensor_ops;
 
+namespace {
+
+using primitiv::Tensor;
+
+// Retrieves the gradient `gx` of `x`.
+// If `gx` is not allocated yet, it is initialized by 0.
+Tensor &grad_of(const Tensor &x, Tensor &gx) {
+  if (!gx.valid()) gx = x.device()->new_tensor(x.shape(), 0);
+  return gx;
+}
+
+// Adds `a` to the gradient `gx` of `x`.
+// If `gx` is not allocated yet, `a` is assigned to `gx` without the
+// accumulation if possible.
+void add_gradient(const Tensor &x, const Tensor &a, Tensor &gx) {
+  if (!gx.valid() && a.shape() == x.shape() && a.device() == x.device()) {
+    gx = a;
+  } else {
+    ::grad_of(x, gx) += a;
+  }
+}
+
+// Subtracts `a` from the gradient `gx` of `x`.
+void subtract_gradient(const Tensor &x, const Tensor &a, Tensor &gx) {
+  if (!gx.valid() && a.shape() == x.shape() && a.device() == x.device()) {
+    gx = -a;
+  } else {
+    ::grad_of(x, gx) -= a;
+  }
+}
+
+// Retrieves the gradient `*gx` of `x`, or `dummy` if the gradient is not
+// required. Values of `dummy` are discarded, and it is taken from the
+// workspace without initialization.
+Tensor &grad_or_dummy(const Tensor &x, Tensor *gx, Tensor &dummy) {
+  if (gx) return ::grad_of(x, *gx);
+  dummy = x.device()->new_workspace_tensor(x.shape());
+  return dummy;
+}
+
+// Writes the index of the parameter in the table, appending it if needed.
+void write_parameter(
+    const primitiv::Parameter *param,
+    primitiv::BinaryWriter &writer,
+    vector<const primitiv::Parameter *> &params) {
+  const auto it = std::find(params.begin(), params.end(), param);
+  writer.write<std::uint32_t>(it - params.begin());
+  if (it == params.end()) params.emplace_back(param);
+}
+
+// Writes a list of indices with its length.
+void write_ids(primitiv::BinaryWriter &writer, const vector<unsigned> &ids) {
+  writer.write<std::uint32_t>(ids.size());
+  for (const unsigned id : ids) writer.write<std::uint32_t>(id);
+}
+
+// Writes a shape followed by its values.
+void write_values(
+    primitiv::BinaryWriter &writer, const primitiv::Shape &shape,
+    const float *values) {
+  writer.write_shape(shape);
+  writer.write_block(values, sizeof(float) * shape.size());
+}
+
+}  // namespace
+
 namespace primitiv {
 namespace functions {
 
@@ -51,6 +118,53 @@ void Input::backward(
   // Nothing to do.
 }
 
+TensorInput::TensorInput(const Tensor &value) : value_(value) {
+  if (!value_.valid()) THROW_ERROR("Invalid tensor. function: TensorInput");
+}
+
+Shape TensorInput::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 0);
+  return value_.shape();
+}
+
+Tensor TensorInput::forward(const vector<const Tensor *> &args) {
+  CHECK_ARGNUM(args, 0);
+  // The memory is shared with the caller and copied only if it is updated.
+  return value_;
+}
+
+void TensorInput::backward(
+    const Tensor &, const Tensor &cur_grad,
+    const vector<const Tensor *> &, const vector<Tensor *> &) const {
+  // Nothing to do.
+}
+
+HostInput::HostInput(
+    const Shape &shape, const float *data, std::shared_ptr<const void> guard,
+    Device *device)
+: shape_(shape)
+, data_(data)
+, guard_(std::move(guard))
+, device_(device) {
+  if (!data_) THROW_ERROR("Null data. function: HostInput");
+}
+
+Shape HostInput::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 0);
+  return shape_;
+}
+
+Tensor HostInput::forward(const vector<const Tensor *> &args) {
+  CHECK_ARGNUM(args, 0);
+  return device_->new_tensor_by_array(shape_, data_);
+}
+
+void HostInput::backward(
+    const Tensor &, const Tensor &cur_grad,
+    const vector<const Tensor *> &, const vector<Tensor *> &) const {
+  // Nothing to do.
+}
+
 Shape ParameterInput::forward_shape(const vector<const Shape *> &args) const {
   CHECK_ARGNUM(args, 0);
   return param_->shape();
@@ -64,7 +178,23 @@ Tensor ParameterInput::forward(const vector<const Tensor *> &args) {
 void ParameterInput::backward(
     const Tensor &, const Tensor &cur_grad,
     const vector<const Tensor *> &, const vector<Tensor *> &) const {
-  param_->gradient() += cur_grad;
+  param_->add_gradient(cur_grad);
+}
+
+Shape Lookup::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 0);
+  return shape_ops::pick(param_->shape(), dim_, ids_);
+}
+
+Tensor Lookup::forward(const vector<const Tensor *> &args) {
+  CHECK_ARGNUM(args, 0);
+  return T::pick(param_->value(), dim_, ids_);
+}
+
+void Lookup::backward(
+    const Tensor &, const Tensor &cur_grad,
+    const vector<const Tensor *> &, const vector<Tensor *> &) const {
+  param_->add_gradient_rows(dim_, ids_, cur_grad);
 }
 
 Shape Copy::forward_shape(const vector<const Shape *> &args) const {
@@ -80,7 +210,7 @@ Tensor Copy::forward(const vector<const Tensor *> &args) {
 void Copy::backward(
     const Tensor &y, const Tensor &gy,
     const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
-  *gx[0] += T::copy(gy, gx[0]->device());
+  ::add_gradient(*x[0], T::copy(gy, x[0]->device()), *gx[0]);
 }
 
 Shape Constant::forward_shape(const vector<const Shape *> &args) const {
@@ -176,7 +306,39 @@ Tensor Pick::forward(const vector<const Tensor *> &args) {
 void Pick::backward(
     const Tensor &y, const Tensor &gy,
     const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
-  gy.device()->pick_bw(gy, dim_, ids_, *gx[0]);
+  gy.device()->pick_bw(gy, dim_, ids_, ::grad_of(*x[0], *gx[0]));
+}
+
+Shape Gather::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  return shape_ops::gather(*args[0], dim_, ids_);
+}
+
+Tensor Gather::forward(const vector<const Tensor *> &args) {
+  CHECK_ARGNUM(args, 1);
+  return tensor_ops::gather(*args[0], dim_, ids_);
+}
+
+void Gather::backward(
+    const Tensor &y, const Tensor &gy,
+    const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
+  gy.device()->gather_bw(gy, dim_, ids_, ::grad_of(*x[0], *gx[0]));
+}
+
+Shape BatchPick::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  return shape_ops::batch_pick(*args[0], ids_);
+}
+
+Tensor BatchPick::forward(const vector<const Tensor *> &args) {
+  CHECK_ARGNUM(args, 1);
+  return tensor_ops::batch_pick(*args[0], ids_);
+}
+
+void BatchPick::backward(
+    const Tensor &y, const Tensor &gy,
+    const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
+  gy.device()->batch_pick_bw(gy, ids_, ::grad_of(*x[0], *gx[0]));
 }
 
 Shape Slice::forward_shape(const vector<const Shape *> &args) const {
@@ -192,7 +354,7 @@ Tensor Slice::forward(const std::vector<const Tensor *> &args) {
 void Slice::backward(
     const Tensor &y, const Tensor &gy,
     const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
-  gy.device()->slice_bw(gy, dim_, lower_, *gx[0]);
+  gy.device()->slice_bw(gy, dim_, lower_, ::grad_of(*x[0], *gx[0]));
 }
 
 Shape Concat::forward_shape(const vector<const Shape *> &args) const {
@@ -207,9 +369,11 @@ void Concat::backward(
     const Tensor &y, const Tensor &gy,
     const vector<const Tensor *> &x, const vector<Tensor *> &gx) const {
   unsigned offset = 0;
-  for (Tensor *gxi : gx) {
-    const unsigned span = gxi->shape()[dim_];
-    *gxi += T::slice(gy, dim_, offset, offset + span);
+  for (unsigned i = 0; i < x.size(); ++i) {
+    const unsigned span = x[i]->shape()[dim_];
+    if (gx[i]) {
+      ::add_gradient(*x[i], T::slice(gy, dim_, offset, offset + span), *gx[i]);
+    }
     offset += span;
   }
 }
@@ -276,6 +440,21 @@ FWD_SHAPE_ELEMENTWISE(Divide);
 #undef FWD_SHAPE_UNARY
 #undef FWD_SHAPE_ELEMENTWISE
 
+Shape FusedElementwise::forward_shape(
+    const vector<const Shape *> &args) const {
+  if (args.empty()) {
+    THROW_ERROR(
+        "Number of arguments mismatched."
+        << " function: " << name()
+        << ", required: > 0 != actual: 0");
+  }
+  Shape y = *args[0];
+  for (unsigned i = 1; i < args.size(); ++i) {
+    y = shape_ops::elementwise(y, *args[i]);
+  }
+  return y;
+}
+
 Shape Transpose::forward_shape(const vector<const Shape *> &args) const {
   CHECK_ARGNUM(args, 1);
   return shape_ops::transpose(*args[0]);
@@ -286,6 +465,27 @@ Shape MatrixMultiply::forward_shape(const vector<const Shape *> &args) const {
   return shape_ops::matmul(*args[0], *args[1]);
 }
 
+Shape Affine::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 3);
+  return shape_ops::affine(*args[0], *args[1], *args[2]);
+}
+
+Shape QuantizedMatrixMultiply::forward_shape(
+    const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  return shape_ops::matmul(w_->shape(), *args[0]);
+}
+
+Shape LSTMCell::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 2);
+  return shape_ops::lstm_cell(*args[0], *args[1]);
+}
+
+Shape LSTM::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 4);
+  return shape_ops::lstm(*args[0], *args[1], *args[2], *args[3]);
+}
+
 Shape Sum::forward_shape(const vector<const Shape *> &args) const {
   CHECK_ARGNUM(args, 1);
   return args[0]->resize_dim(dim_, 1);
@@ -296,6 +496,16 @@ Shape LogSumExp::forward_shape(const vector<const Shape *> &args) const {
   return args[0]->resize_dim(dim_, 1);
 }
 
+Shape LogSoftmax::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  return *args[0];
+}
+
+Shape Softmax::forward_shape(const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  return *args[0];
+}
+
 Shape Broadcast::forward_shape(const vector<const Shape *> &args) const {
   CHECK_ARGNUM(args, 1);
   return shape_ops::broadcast(*args[0], dim_, size_);
@@ -306,6 +516,29 @@ Shape BatchSum::forward_shape(const vector<const Shape *> &args) const {
   return args[0]->resize_batch(1);
 }
 
+Shape BatchNormalize::forward_shape(
+    const vector<const Shape *> &args) const {
+  CHECK_ARGNUM(args, 1);
+  const Shape &x = *args[0];
+  if (!train_ && !stats_) {
+    THROW_ERROR(
+        "Running statistics are required to normalize without training.");
+  }
+  if (train_ && x.batch() <= 1) {
+    THROW_ERROR(
+        "Batch size should be greater than 1 to calculate statistics"
+        << ". x.shape: " << x.to_string());
+  }
+  if (stats_ && stats_->has_stats("batch_mean") &&
+      stats_->stats("batch_mean").shape() != x.resize_batch(1)) {
+    THROW_ERROR(
+        "Shape mismatched. x.shape: " << x.to_string()
+        << ", batch_mean.shape: "
+        << stats_->stats("batch_mean").shape().to_string());
+  }
+  return x;
+}
+
 Shape SoftmaxCrossEntropy::forward_shape(
     const vector<const Shape *> &args) const {
   CHECK_ARGNUM(args, 2);
@@ -360,11 +593,21 @@ FORWARD(Subtract) { return *x[0] - *x[1]; }
 FORWARD(Multiply) { return *x[0] * *x[1]; }
 FORWARD(Divide) { return *x[0] / *x[1]; }
 
+FORWARD(FusedElementwise) { return x[0]->device()->elementwise_fw(prog_, x); }
+
 FORWARD(Transpose) { return T::transpose(*x[0]); }
 FORWARD(MatrixMultiply) { return T::matmul(*x[0], *x[1]); }
+FORWARD(QuantizedMatrixMultiply) {
+  return x[0]->device()->quantized_matmul_fw(*w_, *x[0]);
+}
+FORWARD(LSTMCell) { return T::lstm_cell(*x[0], *x[1]); }
+FORWARD(LSTM) { return T::lstm(*x[0], *x[1], *x[2], *x[3]); }
+FORWARD(Affine) { return T::affine(*x[0], *x[1], *x[2], act_); }
 
 FORWARD(Sum) { return T::sum(*x[0], dim_); }
 FORWARD(LogSumExp) { return T::logsumexp(*x[0], dim_); }
+FORWARD(LogSoftmax) { return T::log_softmax(*x[0], dim_); }
+FORWARD(Softmax) { return T::softmax(*x[0], dim_); }
 FORWARD(Broadcast) { return T::broadcast(*x[0], dim_, size_); }
 
 FORWARD(BatchSum) { return T::batch_sum(*x[0]); }
@@ -381,6 +624,37 @@ FORWARD(SparseSoftmaxCrossEntropy) {
 #endif  // PRIMITIV_USE_CACHE
 }
 
+FORWARD(BatchNormalize) {
+  const Tensor &a = *x[0];
+  if (stats_ && !stats_->has_stats("batch_mean")) {
+    const Shape s = a.shape().resize_batch(1);
+    stats_->add_stats("batch_mean", s);
+    stats_->add_stats("batch_var", s);
+    stats_->stats("batch_mean").reset(0);
+    stats_->stats("batch_var").reset(1);
+  }
+  if (train_) {
+    a.device()->batch_moments_fw(a, mean_, var_);
+    // NOTE(odashi):
+    // Running statistics are updated only once even if this function is
+    // recalculated by the graph.
+    if (stats_ && !updated_) {
+      Tensor &rm = stats_->stats("batch_mean");
+      Tensor &rv = stats_->stats("batch_var");
+      rm *= 1 - momentum_;
+      rm += momentum_ * mean_;
+      rv *= 1 - momentum_;
+      rv += momentum_ * var_;
+      updated_ = true;
+    }
+    return a.device()->batch_normalize_fw(a, mean_, var_, eps_);
+  }
+  // Running statistics are used directly so that concurrent calls share no
+  // state.
+  return a.device()->batch_normalize_fw(
+      a, stats_->stats("batch_mean"), stats_->stats("batch_var"), eps_);
+}
+
 #undef FORWARD
 
 #define BACKWARD(name) \
@@ -391,97 +665,435 @@ FORWARD(SparseSoftmaxCrossEntropy) {
       const vector<Tensor *> &gx) const
 
 
-BACKWARD(Reshape) { *gx[0] += gy.reshape(x[0]->shape()); }
-BACKWARD(Flatten) { *gx[0] += gy.reshape(x[0]->shape()); }
-
-BACKWARD(Positive) { *gx[0] += gy; }
-BACKWARD(Negative) { *gx[0] -= gy; }
-BACKWARD(Sqrt) { gy.device()->sqrt_bw(*x[0], y, gy, *gx[0]); }
-BACKWARD(Exp) {  gy.device()->exp_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Tanh) {  gy.device()->tanh_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Sigmoid) {  gy.device()->sigmoid_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Softplus) {  gy.device()->softplus_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Sin) {  gy.device()->sin_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Cos) {  gy.device()->cos_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(Tan) {  gy.device()->tan_bw(*x[0], y, gy, *gx[0]);}
-BACKWARD(ReLU) { gy.device()->prelu_bw(*x[0], y, gy, 0, *gx[0]); }
-BACKWARD(LReLU) { gy.device()->prelu_bw(*x[0], y, gy, .01, *gx[0]); }
-BACKWARD(Transpose) { gy.device()->transpose_bw(*x[0], y, gy, *gx[0]); }
-
-BACKWARD(AddConst) { gy.device()->add_const_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(SubtractConstR) { gy.device()->subtract_const_r_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(SubtractConstL) { gy.device()->subtract_const_l_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(MultiplyConst) { gy.device()->multiply_const_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(DivideConstR) { gy.device()->divide_const_r_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(DivideConstL) { gy.device()->divide_const_l_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(PReLU) { gy.device()->prelu_bw(*x[0], y, gy, k_, *gx[0]); }
-BACKWARD(ELU) { gy.device()->elu_bw(*x[0], y, gy, k_, *gx[0]); }
+BACKWARD(Reshape) { ::add_gradient(*x[0], gy.reshape(x[0]->shape()), *gx[0]); }
+BACKWARD(Flatten) { ::add_gradient(*x[0], gy.reshape(x[0]->shape()), *gx[0]); }
+
+BACKWARD(Positive) { ::add_gradient(*x[0], gy, *gx[0]); }
+BACKWARD(Negative) { ::subtract_gradient(*x[0], gy, *gx[0]); }
+
+#define BACKWARD_DEV_X(name, op) \
+  BACKWARD(name) { gy.device()->op(*x[0], y, gy, ::grad_of(*x[0], *gx[0])); }
+BACKWARD_DEV_X(Sqrt, sqrt_bw);
+BACKWARD_DEV_X(Exp, exp_bw);
+BACKWARD_DEV_X(Tanh, tanh_bw);
+BACKWARD_DEV_X(Sigmoid, sigmoid_bw);
+BACKWARD_DEV_X(Softplus, softplus_bw);
+BACKWARD_DEV_X(Sin, sin_bw);
+BACKWARD_DEV_X(Cos, cos_bw);
+BACKWARD_DEV_X(Tan, tan_bw);
+BACKWARD_DEV_X(Transpose, transpose_bw);
+#undef BACKWARD_DEV_X
+
+#define BACKWARD_DEV_X_CONST(name, op, k) \
+  BACKWARD(name) { \
+    gy.device()->op(*x[0], y, gy, k, ::grad_of(*x[0], *gx[0])); \
+  }
+BACKWARD_DEV_X_CONST(ReLU, prelu_bw, 0);
+BACKWARD_DEV_X_CONST(LReLU, prelu_bw, .01);
+BACKWARD_DEV_X_CONST(AddConst, add_const_bw, k_);
+BACKWARD_DEV_X_CONST(SubtractConstR, subtract_const_r_bw, k_);
+BACKWARD_DEV_X_CONST(SubtractConstL, subtract_const_l_bw, k_);
+BACKWARD_DEV_X_CONST(MultiplyConst, multiply_const_bw, k_);
+BACKWARD_DEV_X_CONST(DivideConstR, divide_const_r_bw, k_);
+BACKWARD_DEV_X_CONST(DivideConstL, divide_const_l_bw, k_);
+BACKWARD_DEV_X_CONST(PReLU, prelu_bw, k_);
+BACKWARD_DEV_X_CONST(ELU, elu_bw, k_);
+#undef BACKWARD_DEV_X_CONST
 
 BACKWARD(AddScalar) {
-  *gx[0] += gy;
-  *gx[1] += T::sum(gy.flatten(), 0);
+  if (gx[0]) ::add_gradient(*x[0], gy, *gx[0]);
+  if (gx[1]) ::add_gradient(*x[1], T::sum(gy.flatten(), 0), *gx[1]);
 }
 BACKWARD(SubtractScalarR) {
-  *gx[0] += gy;
-  *gx[1] -= T::sum(gy.flatten(), 0);
+  if (gx[0]) ::add_gradient(*x[0], gy, *gx[0]);
+  if (gx[1]) ::subtract_gradient(*x[1], T::sum(gy.flatten(), 0), *gx[1]);
 }
 BACKWARD(SubtractScalarL) {
-  *gx[0] -= gy;
-  *gx[1] += T::sum(gy.flatten(), 0);
+  if (gx[0]) ::subtract_gradient(*x[0], gy, *gx[0]);
+  if (gx[1]) ::add_gradient(*x[1], T::sum(gy.flatten(), 0), *gx[1]);
 }
 BACKWARD(MultiplyScalar) {
-  *gx[0] += *x[1] * gy;
-  *gx[1] += T::sum((*x[0] * gy).flatten(), 0);
+  if (gx[0]) ::add_gradient(*x[0], *x[1] * gy, *gx[0]);
+  if (gx[1]) ::add_gradient(*x[1], T::sum((*x[0] * gy).flatten(), 0), *gx[1]);
 }
 BACKWARD(DivideScalarR) {
   const Tensor a = gy / *x[1];
-  *gx[0] += a;
-  *gx[1] -= T::sum((a * y).flatten(), 0);
+  if (gx[0]) ::add_gradient(*x[0], a, *gx[0]);
+  if (gx[1]) ::subtract_gradient(*x[1], T::sum((a * y).flatten(), 0), *gx[1]);
 }
 BACKWARD(DivideScalarL) {
   const Tensor a = gy / *x[0];
-  *gx[0] -= a * y;
-  *gx[1] += T::sum(a.flatten(), 0);
+  if (gx[0]) ::subtract_gradient(*x[0], a * y, *gx[0]);
+  if (gx[1]) ::add_gradient(*x[1], T::sum(a.flatten(), 0), *gx[1]);
+}
+
+#define BACKWARD_DEV_AB(name, op) \
+  BACKWARD(name) { \
+    Tensor dummy_a, dummy_b; \
+    gy.device()->op( \
+        *x[0], *x[1], y, gy, \
+        ::grad_or_dummy(*x[0], gx[0], dummy_a), \
+        ::grad_or_dummy(*x[1], gx[1], dummy_b)); \
+  }
+BACKWARD_DEV_AB(Add, add_bw);
+BACKWARD_DEV_AB(Subtract, subtract_bw);
+BACKWARD_DEV_AB(Multiply, multiply_bw);
+BACKWARD_DEV_AB(Divide, divide_bw);
+BACKWARD_DEV_AB(MatrixMultiply, matmul_bw);
+BACKWARD_DEV_AB(LSTMCell, lstm_cell_bw);
+#undef BACKWARD_DEV_AB
+
+BACKWARD(Affine) {
+  Tensor dummy_w, dummy_x, dummy_b;
+  gy.device()->affine_bw(
+      *x[0], *x[1], *x[2], y, gy, act_,
+      ::grad_or_dummy(*x[0], gx[0], dummy_w),
+      ::grad_or_dummy(*x[1], gx[1], dummy_x),
+      ::grad_or_dummy(*x[2], gx[2], dummy_b));
+}
+
+BACKWARD(LSTM) {
+  Tensor dummy_xu, dummy_wh, dummy_h0, dummy_c0;
+  gy.device()->lstm_bw(
+      *x[0], *x[1], *x[2], *x[3], y, gy,
+      ::grad_or_dummy(*x[0], gx[0], dummy_xu),
+      ::grad_or_dummy(*x[1], gx[1], dummy_wh),
+      ::grad_or_dummy(*x[2], gx[2], dummy_h0),
+      ::grad_or_dummy(*x[3], gx[3], dummy_c0));
+}
+
+BACKWARD(BatchNormalize) {
+  const Tensor &var = train_ ? var_ : stats_->stats("batch_var");
+  const Tensor s = T::sqrt(var + eps_);
+  if (train_) {
+    // y is equal to the normalized input, and the gradient of the unbiased
+    // variance is folded into the second term.
+    const float b = x[0]->shape().batch();
+    ::add_gradient(
+        *x[0],
+        (gy - T::batch_sum(gy) / b - y * (T::batch_sum(gy * y) / (b - 1))) / s,
+        *gx[0]);
+  } else {
+    ::add_gradient(*x[0], gy / s, *gx[0]);
+  }
 }
 
-BACKWARD(Add) { gy.device()->add_bw(*x[0], *x[1], y, gy, *gx[0], *gx[1]); }
-BACKWARD(Subtract) { gy.device()->subtract_bw(*x[0], *x[1], y, gy, *gx[0], *gx[1]); }
-BACKWARD(Multiply) { gy.device()->multiply_bw(*x[0], *x[1], y, gy, *gx[0], *gx[1]); }
-BACKWARD(Divide) { gy.device()->divide_bw(*x[0], *x[1], y, gy, *gx[0], *gx[1]); }
-BACKWARD(MatrixMultiply) { gy.device()->matmul_bw(*x[0], *x[1], y, gy, *gx[0], *gx[1]); }
+BACKWARD(QuantizedMatrixMultiply) {
+  // Quantized values are not trained, and only the gradient of `x` is
+  // calculated using the dequantized matrix.
+  ::add_gradient(
+      *x[0], T::matmul(T::transpose(w_->dequantize()), gy), *gx[0]);
+}
+
+BACKWARD(FusedElementwise) {
+  typedef ElementwiseProgram P;
+  const vector<P::Instruction> &insts = prog_.instructions;
+  const unsigned n = insts.size();
+  vector<Tensor> values(n);
+  vector<Tensor> grads(n);
+  vector<const Tensor *> args;
+  vector<Tensor *> arg_grads;
+
+  // Gathers arguments of the `j`-th instruction.
+  // Values and gradients of OPCODE_INPUT are taken from `x` and `gx`.
+  auto gather = [&](unsigned j) {
+    const P::Instruction &inst = insts[j];
+    const unsigned num_args = inst.opcode >= P::OPCODE_ADD ? 2 : 1;
+    const unsigned operands[] { inst.a, inst.b };
+    args.resize(num_args);
+    arg_grads.resize(num_args);
+    for (unsigned i = 0; i < num_args; ++i) {
+      const unsigned r = operands[i];
+      if (insts[r].opcode == P::OPCODE_INPUT) {
+        args[i] = x[insts[r].a];
+        arg_grads[i] = gx[insts[r].a];
+      } else {
+        args[i] = &values[r];
+        arg_grads[i] = &grads[r];
+      }
+    }
+  };
+
+  // Recalculates intermediate values by the original functions.
+  for (unsigned j = 0; j + 1 < n; ++j) {
+    if (insts[j].opcode == P::OPCODE_INPUT) continue;
+    gather(j);
+    values[j] = funcs_[j]->forward(args);
+  }
+  values[n - 1] = y;
+  grads[n - 1] = gy;
+
+  // Propagates gradients in the inverse order.
+  for (int j = n - 1; j >= 0; --j) {
+    if (insts[j].opcode == P::OPCODE_INPUT || !grads[j].valid()) continue;
+    gather(j);
+    bool propagate = false;
+    for (const Tensor *g : arg_grads) propagate = propagate || g;
+    if (propagate) funcs_[j]->backward(values[j], grads[j], args, arg_grads);
+    values[j] = Tensor();
+    grads[j] = Tensor();
+  }
+}
 
-BACKWARD(Sum) { *gx[0] += T::broadcast(gy, dim_, x[0]->shape()[dim_]); }
+BACKWARD(Sum) {
+  ::add_gradient(*x[0], T::broadcast(gy, dim_, x[0]->shape()[dim_]), *gx[0]);
+}
 BACKWARD(LogSumExp) {
   // NOTE(odashi): dy/dx = softmax(x) = exp(x - y)
   const unsigned n = x[0]->shape()[dim_];
-  *gx[0] +=
-    T::exp(*x[0] - T::broadcast(y, dim_, n)) * T::broadcast(gy, dim_, n);
+  ::add_gradient(
+      *x[0],
+      T::exp(*x[0] - T::broadcast(y, dim_, n)) * T::broadcast(gy, dim_, n),
+      *gx[0]);
+}
+BACKWARD(LogSoftmax) {
+  // dx = gy - exp(y) * sum(gy)
+  const unsigned n = x[0]->shape()[dim_];
+  ::add_gradient(
+      *x[0], gy - T::exp(y) * T::broadcast(T::sum(gy, dim_), dim_, n),
+      *gx[0]);
 }
-BACKWARD(Broadcast) { *gx[0] += T::sum(gy, dim_); }
+BACKWARD(Softmax) {
+  // dx = y * (gy - sum(y * gy))
+  const unsigned n = x[0]->shape()[dim_];
+  ::add_gradient(
+      *x[0], y * (gy - T::broadcast(T::sum(y * gy, dim_), dim_, n)), *gx[0]);
+}
+BACKWARD(Broadcast) { ::add_gradient(*x[0], T::sum(gy, dim_), *gx[0]); }
 
-BACKWARD(BatchSum) { *gx[0] += gy; }
+BACKWARD(BatchSum) { ::add_gradient(*x[0], gy, *gx[0]); }
 
 BACKWARD(SoftmaxCrossEntropy) {
   const Tensor log_softmax_x = T::log_softmax(*x[0], dim_);
   const Tensor bcast_gy = T::broadcast(gy, dim_, x[0]->shape()[dim_]);
-  *gx[0] += (T::exp(log_softmax_x) - *x[1]) * bcast_gy;
-  *gx[1] -= log_softmax_x * bcast_gy;
+  if (gx[0]) {
+    ::add_gradient(
+        *x[0], (T::exp(log_softmax_x) - *x[1]) * bcast_gy, *gx[0]);
+  }
+  if (gx[1]) ::subtract_gradient(*x[1], log_softmax_x * bcast_gy, *gx[1]);
 }
 
 BACKWARD(SparseSoftmaxCrossEntropy) {
   // dE/dx = gy * (softmax(x) - delta(x, i))
   //       = gy * softmax(x) - gy * delta(x, i)
+  const Tensor bcast_gy = T::broadcast(gy, dim_, x[0]->shape()[dim_]);
 #ifdef PRIMITIV_USE_CACHE
-  *gx[0] +=
-    T::exp(log_softmax_x_) * T::broadcast(gy, dim_, x[0]->shape()[dim_]);
+  ::add_gradient(*x[0], T::exp(log_softmax_x_) * bcast_gy, *gx[0]);
 #else
-  *gx[0] +=
-    T::softmax(*x[0], dim_) * T::broadcast(gy, dim_, x[0]->shape()[dim_]);
+  ::add_gradient(*x[0], T::softmax(*x[0], dim_) * bcast_gy, *gx[0]);
 #endif  // PRIMITIV_USE_CACHE
-  gy.device()->pick_bw(-gy, dim_, ids_, *gx[0]);
+  gy.device()->pick_bw(-gy, dim_, ids_, ::grad_of(*x[0], *gx[0]));
 }
 
 #undef BACKWARD
 
+#define ELEMENTWISE_OP(name, op, val) \
+  bool name::get_elementwise_op(ElementwiseProgram::Instruction &inst) const { \
+    inst.opcode = ElementwiseProgram::op; \
+    inst.k = val; \
+    return true; \
+  }
+
+ELEMENTWISE_OP(Negative, OPCODE_NEGATE, 0);
+ELEMENTWISE_OP(Sqrt, OPCODE_SQRT, 0);
+ELEMENTWISE_OP(Exp, OPCODE_EXP, 0);
+ELEMENTWISE_OP(Tanh, OPCODE_TANH, 0);
+ELEMENTWISE_OP(Sigmoid, OPCODE_SIGMOID, 0);
+ELEMENTWISE_OP(Softplus, OPCODE_SOFTPLUS, 0);
+ELEMENTWISE_OP(Sin, OPCODE_SIN, 0);
+ELEMENTWISE_OP(Cos, OPCODE_COS, 0);
+ELEMENTWISE_OP(Tan, OPCODE_TAN, 0);
+ELEMENTWISE_OP(ReLU, OPCODE_PRELU, 0);
+ELEMENTWISE_OP(LReLU, OPCODE_PRELU, .01);
+ELEMENTWISE_OP(AddConst, OPCODE_ADD_CONST, k_);
+ELEMENTWISE_OP(SubtractConstR, OPCODE_SUBTRACT_CONST_R, k_);
+ELEMENTWISE_OP(SubtractConstL, OPCODE_SUBTRACT_CONST_L, k_);
+ELEMENTWISE_OP(MultiplyConst, OPCODE_MULTIPLY_CONST, k_);
+ELEMENTWISE_OP(DivideConstR, OPCODE_DIVIDE_CONST_R, k_);
+ELEMENTWISE_OP(DivideConstL, OPCODE_DIVIDE_CONST_L, k_);
+ELEMENTWISE_OP(PReLU, OPCODE_PRELU, k_);
+ELEMENTWISE_OP(ELU, OPCODE_ELU, k_);
+ELEMENTWISE_OP(Add, OPCODE_ADD, 0);
+ELEMENTWISE_OP(Subtract, OPCODE_SUBTRACT, 0);
+ELEMENTWISE_OP(Multiply, OPCODE_MULTIPLY, 0);
+ELEMENTWISE_OP(Divide, OPCODE_DIVIDE, 0);
+
+#undef ELEMENTWISE_OP
+
+#define WRITE_ATTRIBUTES(name) \
+  bool name::write_attributes( \
+      BinaryWriter &writer, vector<const Parameter *> &params) const
+
+WRITE_ATTRIBUTES(Input) {
+  writer.write_string("Input");
+  ::write_values(writer, shape_, data_.data());
+  return true;
+}
+
+WRITE_ATTRIBUTES(TensorInput) {
+  // Values are exported as constants.
+  writer.write_string("Input");
+  ::write_values(writer, value_.shape(), value_.to_vector().data());
+  return true;
+}
+
+WRITE_ATTRIBUTES(HostInput) {
+  writer.write_string("Input");
+  ::write_values(writer, shape_, data_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(ParameterInput) {
+  writer.write_string("ParameterInput");
+  ::write_parameter(param_, writer, params);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Lookup) {
+  writer.write_string("Lookup");
+  ::write_parameter(param_, writer, params);
+  writer.write<std::uint32_t>(dim_);
+  ::write_ids(writer, ids_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Constant) {
+  writer.write_string("Constant");
+  writer.write_shape(shape_);
+  writer.write<float>(k_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Pick) {
+  writer.write_string("Pick");
+  writer.write<std::uint32_t>(dim_);
+  ::write_ids(writer, ids_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Gather) {
+  writer.write_string("Gather");
+  writer.write<std::uint32_t>(dim_);
+  ::write_ids(writer, ids_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(BatchPick) {
+  writer.write_string("BatchPick");
+  ::write_ids(writer, ids_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Slice) {
+  writer.write_string("Slice");
+  writer.write<std::uint32_t>(dim_);
+  writer.write<std::uint32_t>(lower_);
+  writer.write<std::uint32_t>(upper_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Reshape) {
+  writer.write_string("Reshape");
+  writer.write_shape(shape_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Broadcast) {
+  writer.write_string("Broadcast");
+  writer.write<std::uint32_t>(dim_);
+  writer.write<std::uint32_t>(size_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(Affine) {
+  writer.write_string("Affine");
+  writer.write<std::uint32_t>(act_);
+  return true;
+}
+
+WRITE_ATTRIBUTES(BatchNormalize) {
+  // Only the normalization by running statistics is exported.
+  if (train_ || !stats_ || !stats_->has_stats("batch_mean")) return false;
+  writer.write_string("BatchNormalize");
+  ::write_parameter(stats_, writer, params);
+  writer.write<float>(eps_);
+  return true;
+}
+
+#define WRITE_DIM(name) \
+  WRITE_ATTRIBUTES(name) { \
+    static_cast<void>(params); \
+    writer.write_string(#name); \
+    writer.write<std::uint32_t>(dim_); \
+    return true; \
+  }
+
+WRITE_DIM(Concat);
+WRITE_DIM(Sum);
+WRITE_DIM(LogSumExp);
+WRITE_DIM(LogSoftmax);
+WRITE_DIM(Softmax);
+WRITE_DIM(SoftmaxCrossEntropy);
+
+#undef WRITE_DIM
+
+#define WRITE_CONST(name) \
+  WRITE_ATTRIBUTES(name) { \
+    static_cast<void>(params); \
+    writer.write_string(#name); \
+    writer.write<float>(k_); \
+    return true; \
+  }
+
+WRITE_CONST(AddConst);
+WRITE_CONST(SubtractConstR);
+WRITE_CONST(SubtractConstL);
+WRITE_CONST(MultiplyConst);
+WRITE_CONST(DivideConstR);
+WRITE_CONST(DivideConstL);
+WRITE_CONST(PReLU);
+WRITE_CONST(ELU);
+
+#undef WRITE_CONST
+
+#define WRITE_TYPE(name) \
+  WRITE_ATTRIBUTES(name) { \
+    static_cast<void>(params); \
+    writer.write_string(#name); \
+    return true; \
+  }
+
+WRITE_TYPE(Flatten);
+WRITE_TYPE(Positive);
+WRITE_TYPE(Negative);
+WRITE_TYPE(AddScalar);
+WRITE_TYPE(SubtractScalarR);
+WRITE_TYPE(SubtractScalarL);
+WRITE_TYPE(MultiplyScalar);
+WRITE_TYPE(DivideScalarR);
+WRITE_TYPE(DivideScalarL);
+WRITE_TYPE(Add);
+WRITE_TYPE(Subtract);
+WRITE_TYPE(Multiply);
+WRITE_TYPE(Divide);
+WRITE_TYPE(Transpose);
+WRITE_TYPE(MatrixMultiply);
+WRITE_TYPE(LSTMCell);
+WRITE_TYPE(LSTM);
+WRITE_TYPE(Sqrt);
+WRITE_TYPE(Exp);
+WRITE_TYPE(Tanh);
+WRITE_TYPE(Sigmoid);
+WRITE_TYPE(Softplus);
+WRITE_TYPE(Sin);
+WRITE_TYPE(Cos);
+WRITE_TYPE(Tan);
+WRITE_TYPE(ReLU);
+WRITE_TYPE(LReLU);
+WRITE_TYPE(BatchSum);
+
+#undef WRITE_TYPE
+#undef WRITE_ATTRIBUTES
+
 }  // namespace functions
 }  // namespace primitive
@@ -1,8 +1,11 @@
 #ifndef PRIMITIV_FUNCTION_IMPL_H_
 #define PRIMITIV_FUNCTION_IMPL_H_
 
+#include <memory>
+#include <primitiv/device.h>
 #include <primitiv/function.h>
 #include <primitiv/parameter.h>
+#include <primitiv/quantized_parameter.h>
 #include <primitiv/shape.h>
 
 namespace primitiv {
@@ -31,9 +34,18 @@ public: \
 private: \
   name_() = delete;
 
+#define DECL_BATCHABLE \
+  bool batchable() const override { return true; }
+
+#define DECL_WRITE_ATTRIBUTES \
+  bool write_attributes( \
+      BinaryWriter &writer, \
+      std::vector<const Parameter *> &params) const override
+
 class Input : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Input);
 public:
+  DECL_WRITE_ATTRIBUTES;
   Input(const Shape &shape, const std::vector<float> &data, Device *device);
   Device *get_device() const override { return device_; }
   std::string name() const override { return "Input"; }
@@ -43,16 +55,62 @@ private:
   Device *device_;
 };
 
+class TensorInput : public primitiv::Function {
+  NO_CTOR_CLASS_DECL(TensorInput);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  explicit TensorInput(const Tensor &value);
+  Device *get_device() const override { return value_.device(); }
+  std::string name() const override { return "TensorInput"; }
+private:
+  Tensor value_;
+};
+
+class HostInput : public primitiv::Function {
+  NO_CTOR_CLASS_DECL(HostInput);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  HostInput(
+      const Shape &shape, const float *data, std::shared_ptr<const void> guard,
+      Device *device);
+  Device *get_device() const override { return device_; }
+  std::string name() const override { return "HostInput"; }
+private:
+  Shape shape_;
+  const float *data_;
+  std::shared_ptr<const void> guard_;
+  Device *device_;
+};
+
 class ParameterInput : public primitiv::Function {
   NO_CTOR_CLASS_DECL(ParameterInput);
 public:
+  DECL_WRITE_ATTRIBUTES;
   explicit ParameterInput(Parameter *param) : param_(param) {}
   Device *get_device() const override { return param_->device(); }
+  bool has_parameters() const override { return true; }
   std::string name() const override { return "ParameterInput"; }
 private:
   primitiv::Parameter *param_;
 };
 
+class Lookup : public primitiv::Function {
+  NO_CTOR_CLASS_DECL(Lookup);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  Lookup(Parameter *param, unsigned dim, const std::vector<unsigned> &ids)
+    : param_(param), dim_(dim), ids_(ids) {}
+  Device *get_device() const override { return param_->device(); }
+  bool has_parameters() const override { return true; }
+  std::string name() const override {
+    return "Lookup(" + std::to_string(dim_) + ')';
+  }
+private:
+  primitiv::Parameter *param_;
+  unsigned dim_;
+  std::vector<unsigned> ids_;
+};
+
 class Copy : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Copy);
 public:
@@ -66,6 +124,7 @@ private:
 class Constant : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Constant);
 public:
+  DECL_WRITE_ATTRIBUTES;
   Constant(const Shape &shape, float k, Device *device)
     : shape_(shape), k_(k), device_(device) {}
   Device *get_device() const override { return device_; }
@@ -150,6 +209,7 @@ private:
 class Pick : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Pick);
 public:
+  DECL_WRITE_ATTRIBUTES;
   Pick(unsigned dim, const std::vector<unsigned> &ids)
     : dim_(dim), ids_(ids) {}
   std::string name() const override {
@@ -160,9 +220,35 @@ private:
   std::vector<unsigned> ids_;
 };
 
+class Gather : public primitiv::Function {
+  NO_CTOR_CLASS_DECL(Gather);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  Gather(unsigned dim, const std::vector<unsigned> &ids)
+    : dim_(dim), ids_(ids) {}
+  std::string name() const override {
+    return "Gather(" + std::to_string(dim_) + ')';
+  };
+private:
+  unsigned dim_;
+  std::vector<unsigned> ids_;
+};
+
+class BatchPick : public primitiv::Function {
+  NO_CTOR_CLASS_DECL(BatchPick);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  explicit BatchPick(const std::vector<unsigned> &ids) : ids_(ids) {}
+  std::string name() const override { return "BatchPick"; }
+private:
+  std::vector<unsigned> ids_;
+};
+
 class Slice : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Slice);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   Slice(unsigned dim, unsigned lower, unsigned upper)
     : dim_(dim), lower_(lower), upper_(upper) {}
   std::string name() const override {
@@ -178,10 +264,16 @@ private:
 class Concat : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Concat);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   Concat(unsigned dim) : dim_(dim) {}
   std::string name() const override {
     return "Concat(" + std::to_string(dim_) + ')';
   }
+  bool get_concat_dim(unsigned &dim) const override {
+    dim = dim_;
+    return true;
+  }
 private:
   unsigned dim_;
 };
@@ -189,6 +281,7 @@ private:
 class Reshape : public primitiv::Function {
   NO_CTOR_CLASS_DECL(Reshape);
 public:
+  DECL_WRITE_ATTRIBUTES;
   explicit Reshape(const Shape &shape) : shape_(shape) {}
   std::string name() const override {
     return "Reshape(" + shape_.to_string() + ')';
@@ -200,6 +293,8 @@ private:
 class Sum : public Function {
   NO_CTOR_CLASS_DECL(Sum);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   explicit Sum(unsigned dim) : dim_(dim) {}
   std::string name() const override {
     return "Sum(" + std::to_string(dim_) + ')';
@@ -211,6 +306,8 @@ private:
 class LogSumExp : public Function {
   NO_CTOR_CLASS_DECL(LogSumExp);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   explicit LogSumExp(unsigned dim) : dim_(dim) {}
   std::string name() const override {
     return "LogSumExp(" + std::to_string(dim_) + ')';
@@ -219,9 +316,37 @@ private:
   unsigned dim_;
 };
 
+class LogSoftmax : public Function {
+  NO_CTOR_CLASS_DECL(LogSoftmax);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
+  explicit LogSoftmax(unsigned dim) : dim_(dim) {}
+  std::string name() const override {
+    return "LogSoftmax(" + std::to_string(dim_) + ')';
+  }
+private:
+  unsigned dim_;
+};
+
+class Softmax : public Function {
+  NO_CTOR_CLASS_DECL(Softmax);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
+  explicit Softmax(unsigned dim) : dim_(dim) {}
+  std::string name() const override {
+    return "Softmax(" + std::to_string(dim_) + ')';
+  }
+private:
+  unsigned dim_;
+};
+
 class Broadcast : public Function {
   NO_CTOR_CLASS_DECL(Broadcast);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   Broadcast(unsigned dim, unsigned size) : dim_(dim), size_(size) {}
   std::string name() const override {
     return "Broadcast(" + std::to_string(dim_)
@@ -235,6 +360,8 @@ private:
 class SoftmaxCrossEntropy : public Function {
   NO_CTOR_CLASS_DECL(SoftmaxCrossEntropy);
 public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
   explicit SoftmaxCrossEntropy(unsigned dim) : dim_(dim) {}
   std::string name() const override {
     return "SoftmaxCrossEntropy(" + std::to_string(dim_) + ')';
@@ -257,21 +384,127 @@ private:
   Tensor log_softmax_x_;  // Only used when PRIMITIV_USE_CACHE=ON
 };
 
+/**
+ * Function which calculates `act(w . x + b)` by one fused operation.
+ * Arguments are `w`, `x` and `b` in this order.
+ */
+class Affine : public Function {
+  NO_CTOR_CLASS_DECL(Affine);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  DECL_BATCHABLE;
+  explicit Affine(Device::Activation act) : act_(act) {}
+  std::string name() const override {
+    return "Affine(" + std::to_string(act_) + ')';
+  }
+private:
+  Device::Activation act_;
+};
+
+class QuantizedMatrixMultiply : public Function {
+  NO_CTOR_CLASS_DECL(QuantizedMatrixMultiply);
+public:
+  explicit QuantizedMatrixMultiply(const QuantizedParameter *w) : w_(w) {}
+  Device *get_device() const override { return w_->device(); }
+  std::string name() const override { return "QuantizedMatrixMultiply"; }
+private:
+  const QuantizedParameter *w_;
+};
+
+/**
+ * Function which calculates a chain of elementwise functions by one kernel.
+ * `funcs[i]` is the original function of `prog.instructions[i]`, or nullptr
+ * for `OPCODE_INPUT`. This object does not own the original functions, and
+ * `backward()` recalculates intermediate values using them.
+ */
+class FusedElementwise : public Function {
+  NO_CTOR_CLASS_DECL(FusedElementwise);
+public:
+  FusedElementwise(
+      const ElementwiseProgram &prog, const std::vector<Function *> &funcs)
+    : prog_(prog), funcs_(funcs) {}
+  std::string name() const override {
+    return
+      "FusedElementwise(" + std::to_string(prog_.instructions.size()) + ')';
+  }
+private:
+  ElementwiseProgram prog_;
+  std::vector<Function *> funcs_;
+};
+
+/**
+ * Function which normalizes each element over the minibatch.
+ * If `train` is true, statistics are calculated from the minibatch by one
+ * pass, and running statistics `batch_mean` and `batch_var` in `stats` are
+ * updated by `momentum` if `stats` is not nullptr. Otherwise, the running
+ * statistics are used directly and no reduction is calculated.
+ */
+class BatchNormalize : public Function {
+  NO_CTOR_CLASS_DECL(BatchNormalize);
+public:
+  DECL_WRITE_ATTRIBUTES;
+  BatchNormalize(Parameter *stats, bool train, float momentum, float eps)
+    : stats_(stats), train_(train), momentum_(momentum), eps_(eps)
+    , updated_(false) {}
+  std::string name() const override {
+    return std::string("BatchNormalize(") + (train_ ? "train" : "eval") + ')';
+  }
+private:
+  Parameter *stats_;
+  bool train_;
+  float momentum_;
+  float eps_;
+  bool updated_;
+  Tensor mean_;
+  Tensor var_;
+};
+
+#define DECL_ELEMENTWISE_OP \
+  bool get_elementwise_op( \
+      ElementwiseProgram::Instruction &inst) const override
+
 // Function with no parameter.
 #define DECL_FUNC(name_) \
   class name_ : public Function { \
     DEFAULT_CLASS_DECL(name_); \
   public: \
     name_() {} \
+    DECL_WRITE_ATTRIBUTES; \
+    std::string name() const override { return #name_; } \
+  }
+
+// Function with no parameter, which can be batched.
+#define DECL_FUNC_B(name_) \
+  class name_ : public Function { \
+    DEFAULT_CLASS_DECL(name_); \
+  public: \
+    name_() {} \
+    DECL_BATCHABLE; \
+    DECL_WRITE_ATTRIBUTES; \
+    std::string name() const override { return #name_; } \
+  }
+
+// Elementwise function with no parameter.
+#define DECL_FUNC_E(name_) \
+  class name_ : public Function { \
+    DEFAULT_CLASS_DECL(name_); \
+  public: \
+    name_() {} \
+    DECL_BATCHABLE; \
+    DECL_ELEMENTWISE_OP; \
+    DECL_WRITE_ATTRIBUTES; \
     std::string name() const override { return #name_; } \
   }
 
-// Function with a constant.
+// Elementwise function with a constant.
 #define DECL_FUNC_K(name_) \
   class name_ : public Function { \
     NO_CTOR_CLASS_DECL(name_); \
   public: \
     explicit name_(float  k) : k_(k) {} \
+    DECL_BATCHABLE; \
+    DECL_ELEMENTWISE_OP; \
+    DECL_WRITE_ATTRIBUTES; \
     std::string name() const override { \
       return #name_"(" + std::to_string(k_) + ')'; \
     } \
@@ -282,7 +515,7 @@ private:
 DECL_FUNC(Flatten);
 
 DECL_FUNC(Positive);
-DECL_FUNC(Negative);
+DECL_FUNC_E(Negative);
 
 DECL_FUNC_K(AddConst);
 DECL_FUNC_K(SubtractConstR);
@@ -293,36 +526,43 @@ DECL_FUNC_K(DivideConstL);
 DECL_FUNC_K(PReLU);
 DECL_FUNC_K(ELU);
 
-DECL_FUNC(AddScalar);
-DECL_FUNC(SubtractScalarR);
-DECL_FUNC(SubtractScalarL);
-DECL_FUNC(MultiplyScalar);
-DECL_FUNC(DivideScalarR);
-DECL_FUNC(DivideScalarL);
-
-DECL_FUNC(Add);
-DECL_FUNC(Subtract);
-DECL_FUNC(Multiply);
-DECL_FUNC(Divide);
-
-DECL_FUNC(Transpose);
-DECL_FUNC(MatrixMultiply);
-
-DECL_FUNC(Sqrt);
-DECL_FUNC(Exp);
-DECL_FUNC(Tanh);
-DECL_FUNC(Sigmoid);
-DECL_FUNC(Softplus);
-DECL_FUNC(Sin);
-DECL_FUNC(Cos);
-DECL_FUNC(Tan);
-DECL_FUNC(ReLU);
-DECL_FUNC(LReLU);
+DECL_FUNC_B(AddScalar);
+DECL_FUNC_B(SubtractScalarR);
+DECL_FUNC_B(SubtractScalarL);
+DECL_FUNC_B(MultiplyScalar);
+DECL_FUNC_B(DivideScalarR);
+DECL_FUNC_B(DivideScalarL);
+
+DECL_FUNC_E(Add);
+DECL_FUNC_E(Subtract);
+DECL_FUNC_E(Multiply);
+DECL_FUNC_E(Divide);
+
+DECL_FUNC_B(Transpose);
+DECL_FUNC_B(MatrixMultiply);
+DECL_FUNC_B(LSTMCell);
+DECL_FUNC(LSTM);
+
+DECL_FUNC_E(Sqrt);
+DECL_FUNC_E(Exp);
+DECL_FUNC_E(Tanh);
+DECL_FUNC_E(Sigmoid);
+DECL_FUNC_E(Softplus);
+DECL_FUNC_E(Sin);
+DECL_FUNC_E(Cos);
+DECL_FUNC_E(Tan);
+DECL_FUNC_E(ReLU);
+DECL_FUNC_E(LReLU);
 
 DECL_FUNC(BatchSum);
 
 #undef DECL_FUNC
+#undef DECL_FUNC_B
+#undef DECL_FUNC_E
 #undef DECL_FUNC_K
+#undef DECL_ELEMENTWISE_OP
+#undef DECL_WRITE_ATTRIBUTES
+#undef DECL_BATCHABLE
 #undef NO_CTOR_CLASS_DECL
 #undef DEFAULT_CLASS_DECL
 
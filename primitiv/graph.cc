@@ -1,11 +1,25 @@
 #include <config.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
-#include <functional>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
+#include <primitiv/arena_allocator.h>
 #include <primitiv/device.h>
 #include <primitiv/error.h>
+#include <primitiv/function_impl.h>
 #include <primitiv/graph.h>
 
 using std::cerr;
@@ -16,15 +30,235 @@ using std::vector;
 
 namespace primitiv {
 
+const std::uint64_t Graph::PLAN_ALIGNMENT;
+
 Graph::~Graph() {
+  delete_functions();
+}
+
+void Graph::delete_functions() {
   // Removes all allocated objects.
   for (FunctionInfo &f : funcs_) {
-    delete f.func;
+    delete_function(f.func, f.in_arena);
+    delete_function(f.fused, true);
+    for (NodeInfo &n : f.rets) release_node(n);
+  }
+}
+
+void Graph::delete_function(Function *func, bool in_arena) {
+  if (!in_arena) delete func;
+  else if (func) func->~Function();
+}
+
+void Graph::delete_tensor(Tensor *&x) {
+  // NOTE(odashi):
+  // Tensor objects are stored in `arena_`, and only their destructors are
+  // called here. The memory of the objects is recycled by `clear()`.
+  if (x) x->~Tensor();
+  x = nullptr;
+}
+
+void Graph::release_node(NodeInfo &n) {
+  delete_tensor(n.value);
+  delete_tensor(n.grad);
+}
+
+bool Graph::release_argument(const Address &arg) {
+  const FunctionInfo &f = funcs_[arg.fid];
+  NodeInfo &n = funcs_[arg.fid].rets[arg.vid];
+  // NOTE(odashi):
+  // `sinks` has one entry for each occurrence in arguments.
+  if (++n.num_calculated_sinks != n.sinks.size()) return false;
+  if (policy_ == RELEASE_POLICY_INFERENCE) {
+    release_node(n);
+    return true;
+  }
+  // Values of functions without arguments (e.g., inputs and random values)
+  // are always kept because they can not be recalculated.
+  if (checkpointing_ && !n.checkpoint &&
+      !(f.fused ? f.fused_args : f.args).empty()) {
+    delete_tensor(n.value);
+    n.dropped = true;
+    return true;
+  }
+  return false;
+}
+
+void Graph::recalculate(unsigned fid) {
+  // Collects dropped values required by the node. Collection stops at
+  // checkpoints and other nodes which still have values.
+  vector<bool> required(fid + 1, false);
+  vector<unsigned> targets;
+  required[fid] = true;
+  for (int i = fid; i >= 0; --i) {
+    const FunctionInfo &f = funcs_[i];
+    if (!required[i] || f.rets[0].value) continue;
+    targets.emplace_back(i);
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+    for (const Address &arg : args) required[arg.fid] = true;
+  }
+
+  vector<const Tensor *> arg_values;
+  for (auto it = targets.rbegin(); it != targets.rend(); ++it) {
+    FunctionInfo &f = funcs_[*it];
+    Function *func = f.fused ? f.fused : f.func;
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+    arg_values.resize(args.size());
+    for (unsigned i = 0; i < args.size(); ++i) {
+      const Address &arg = args[i];
+      arg_values[i] = funcs_[arg.fid].rets[arg.vid].value;
+    }
+    Device *device = f.rets[0].device;
+    const double start_us = profiling_ ? profile_clock(device) : 0;
+    f.rets[0].value = new_tensor(func->forward(arg_values));
+    f.rets[0].dropped = false;
+    if (profiling_) {
+      add_profile_record(
+          func, PROFILE_PHASE_FORWARD, device, start_us,
+          profile_clock(device), f.rets[0].shape.size() * sizeof(float));
+    }
+  }
+}
+
+bool Graph::place_in_concat(
+    unsigned fid, const vector<bool> &scheduled, vector<Tensor> &buffers) {
+  const NodeInfo &n = funcs_[fid].rets[0];
+  if (n.sinks.size() != 1) return false;
+  const unsigned sink_fid = n.sinks[0];
+  if (sink_fid >= scheduled.size() || !scheduled[sink_fid]) return false;
+  const FunctionInfo &sink = funcs_[sink_fid];
+  const NodeInfo &y = sink.rets[0];
+  unsigned dim;
+  if (sink.fused || !sink.func->get_concat_dim(dim) ||
+      y.device != n.device || y.shape.size() != y.shape.lower_volume(dim + 1)) {
+    return false;
+  }
+
+  // Arguments are stored in order.
+  unsigned offset = 0;
+  for (const Address &arg : sink.args) {
+    if (arg.fid == fid) break;
+    offset += funcs_[arg.fid].rets[arg.vid].shape.size();
+  }
+  Tensor &buffer = buffers[sink_fid];
+  if (!buffer.valid()) buffer = y.device->new_tensor(y.shape);
+  n.device->place_next_tensor(buffer, offset, n.shape.size());
+  return true;
+}
+
+void Graph::clear() {
+  delete_functions();
+  funcs_.clear();
+  arena_.reset();
+  fusion_checked_ = 0;
+}
+
+void Graph::truncate(unsigned num_functions) {
+  if (num_functions > funcs_.size()) {
+    THROW_ERROR(
+        "Invalid number of functions to be kept: " << num_functions
+        << " > " << funcs_.size());
+  }
+  if (num_functions == funcs_.size()) return;
+  const BumpArena::Position pos = funcs_[num_functions].position;
+
+  // Unfuses chains whose fused functions are removed. The first sink of each
+  // absorbed function is the function absorbing it.
+  for (int fid = num_functions - 1; fid >= 0; --fid) {
+    FunctionInfo &f = funcs_[fid];
+    if (!f.absorbed) continue;
+    const unsigned sink_fid = f.rets[0].sinks[0];
+    if (sink_fid < num_functions &&
+        (funcs_[sink_fid].absorbed || funcs_[sink_fid].fused)) continue;
+    f.absorbed = false;
+    fusion_checked_ = std::min<unsigned>(fusion_checked_, fid);
+    const unsigned f_fid = fid;
+
+    // Inputs of the program obtain this function as a sink again instead of
+    // the removed fused function.
+    for (unsigned i = 0; i < f.args.size(); ++i) {
+      const Address &arg = f.args[i];
+      unsigned num_prev = 0;
+      for (unsigned j = 0; j < i; ++j) {
+        if (f.args[j].fid == arg.fid && f.args[j].vid == arg.vid) ++num_prev;
+      }
+      ArenaVector<unsigned> &sinks = funcs_[arg.fid].rets[arg.vid].sinks;
+      if (static_cast<unsigned>(
+            std::count(sinks.begin(), sinks.end(), f_fid)) > num_prev) {
+        continue;
+      }
+      unsigned *removed = std::find_if(
+          sinks.begin(), sinks.end(),
+          [num_functions](unsigned sink) { return sink >= num_functions; });
+      if (removed != sinks.end()) *removed = f_fid;
+    }
+  }
+
+  // Removes functions. Calculated functions are no longer counted by their
+  // arguments.
+  for (unsigned fid = num_functions; fid < funcs_.size(); ++fid) {
+    FunctionInfo &f = funcs_[fid];
+    if (f.calculated) {
+      for (const Address &arg : f.fused ? f.fused_args : f.args) {
+        if (arg.fid < num_functions) {
+          --funcs_[arg.fid].rets[arg.vid].num_calculated_sinks;
+        }
+      }
+    }
+    delete_function(f.func, f.in_arena);
+    delete_function(f.fused, true);
+    for (NodeInfo &n : f.rets) release_node(n);
+  }
+  funcs_.erase(funcs_.begin() + num_functions, funcs_.end());
+  fusion_checked_ = std::min(fusion_checked_, num_functions);
+
+  // NOTE(odashi):
+  // Remaining functions may also have memory after `pos`, e.g., values
+  // calculated after adding removed functions. Such memory is moved out of
+  // `arena_` before rewinding it.
+  vector<NodeInfo *> sink_nodes;
+  vector<vector<unsigned>> sinks;
+  vector<Tensor **> tensor_ptrs;
+  vector<Tensor> tensors;
+  vector<unsigned> fused_fids;
+  for (unsigned fid = 0; fid < num_functions; ++fid) {
+    FunctionInfo &f = funcs_[fid];
+    if (f.fused && arena_.allocated_after(f.fused, pos)) {
+      delete_function(f.fused, true);
+      f.fused = nullptr;
+      fused_fids.emplace_back(fid);
+    }
     for (NodeInfo &n : f.rets) {
-      delete n.value;
-      delete n.grad;
+      vector<unsigned> kept;
+      for (const unsigned sink : n.sinks) {
+        if (sink < num_functions) kept.emplace_back(sink);
+      }
+      if (kept.size() != n.sinks.size() ||
+          arena_.allocated_after(n.sinks.begin(), pos)) {
+        sink_nodes.emplace_back(&n);
+        sinks.emplace_back(move(kept));
+      }
+      for (Tensor **x : { &n.value, &n.grad }) {
+        if (*x && arena_.allocated_after(*x, pos)) {
+          tensor_ptrs.emplace_back(x);
+          tensors.emplace_back(move(**x));
+          delete_tensor(*x);
+        }
+      }
     }
   }
+
+  arena_.rewind(pos);
+
+  for (unsigned i = 0; i < sink_nodes.size(); ++i) {
+    ArenaVector<unsigned> &dest = sink_nodes[i]->sinks;
+    dest = ArenaVector<unsigned>();
+    dest.assign(sinks[i].data(), sinks[i].data() + sinks[i].size(), arena_);
+  }
+  for (unsigned i = 0; i < tensor_ptrs.size(); ++i) {
+    *tensor_ptrs[i] = new_tensor(move(tensors[i]));
+  }
+  for (const unsigned fid : fused_fids) make_fused(fid);
 }
 
 #define CHECK_NODE(n) { \
@@ -48,121 +282,718 @@ Graph::~Graph() {
 #define ACCESS(n) (funcs_[n.fid_].rets[n.vid_])
 
 Node Graph::add_function(Function *func, const std::vector<Node> &args) {
-  // Gathers information of args.
-  vector<Address> arg_addrs(args.size());
-  vector<const Shape *> arg_shapes(args.size());
-  for (unsigned i = 0; i < args.size(); ++i) {
-    const Node &arg = args[i];
-    CHECK_NODE(arg);
-    arg_addrs[i] = { arg.fid_, arg.vid_ };
-    arg_shapes[i] = &ACCESS(arg).shape;
-  }
-
-  // Calculates the shape of the resulting value.
-  // This may throw an exception when trying an invalid operation.
-  // TODO(odashi): fix this
-  vector<Shape> ret_shapes { func->forward_shape(arg_shapes) };
-
-  // Retrieves the device object which manages return values itself.
-  Device *ret_device = func->get_device();
-  if (!ret_device) {
-    // If nullptr, the device object is inherited from `args[0]`.
-    ret_device = args.size() > 0 ? ACCESS(args[0]).device : nullptr;
+  return register_function(func, args, false, arena_.position());
+}
+
+Node Graph::register_function(
+    Function *func, const std::vector<Node> &args, bool in_arena,
+    const BumpArena::Position &position) {
+  ArenaVector<Address> arg_addrs;
+  ArenaVector<NodeInfo> rets;
+  try {
+    // Gathers information of args.
+    arg_shapes_.resize(args.size());
+    for (unsigned i = 0; i < args.size(); ++i) {
+      const Node &arg = args[i];
+      CHECK_NODE(arg);
+      arg_addrs.push_back({ arg.fid_, arg.vid_ }, arena_);
+      arg_shapes_[i] = &ACCESS(arg).shape;
+    }
+
+    // Calculates the shape of the resulting value.
+    // This may throw an exception when trying an invalid operation.
+    Shape ret_shape = func->forward_shape(arg_shapes_);
+
+    // Retrieves the device object which manages return values itself.
+    Device *ret_device = func->get_device();
     if (!ret_device) {
-      THROW_ERROR(
-          "Bad device forwarding of function '" << func->name()
-          << "' with " << args.size() << " argument(s).");
+      // If nullptr, the device object is inherited from `args[0]`.
+      ret_device = args.size() > 0 ? ACCESS(args[0]).device : nullptr;
+      if (!ret_device) {
+        THROW_ERROR(
+            "Bad device forwarding of function '" << func->name()
+            << "' with " << args.size() << " argument(s).");
+      }
     }
-  }
 
-  // Make nodes of return values.
-  const unsigned NUM_NODES = 1;  // TODO(odashi): fix this
-  vector<NodeInfo> rets(
-      NUM_NODES,
-      NodeInfo { Shape(), ret_device, nullptr, nullptr, vector<unsigned>() });
-  for (unsigned i = 0; i < NUM_NODES; ++i) {
-    rets[i].shape = move(ret_shapes[i]);
+    // Make nodes of return values.
+    // TODO(odashi): support multiple return values.
+    rets.push_back(
+        NodeInfo {
+          move(ret_shape), ret_device, nullptr, nullptr,
+          ArenaVector<unsigned>(), 0, false, false, false },
+        arena_);
+  } catch (...) {
+    delete_function(func, in_arena);
+    throw;
   }
 
   // Updates the graph.
   const unsigned ret_fid = funcs_.size();
   for (const Address &arg_addr : arg_addrs) {
-    funcs_[arg_addr.fid].rets[arg_addr.vid].sinks.emplace_back(ret_fid);
+    funcs_[arg_addr.fid].rets[arg_addr.vid].sinks.push_back(ret_fid, arena_);
   }
-  funcs_.emplace_back(FunctionInfo { func, move(arg_addrs), move(rets) });
+  funcs_.emplace_back(
+      FunctionInfo {
+        func, arg_addrs, rets, in_arena, nullptr, ArenaVector<Address>(),
+        false, false, position });
 
   return Node(this, ret_fid, 0);
 }
 
+void Graph::require_gradient(const Node &node) {
+  CHECK_NODE(node);
+  ACCESS(node).grad_requested = true;
+}
+
+void Graph::mark_checkpoint(const Node &node) {
+  CHECK_NODE(node);
+  ACCESS(node).checkpoint = true;
+}
+
+void Graph::fuse_elementwise(unsigned last_fid) {
+  ElementwiseProgram::Instruction inst;
+  vector<Address> queue;
+
+  // NOTE(odashi):
+  // Sinks always have larger IDs than their arguments. Examining functions in
+  // the descending order makes each chain as long as possible.
+  for (int root_fid = last_fid;
+      root_fid >= static_cast<int>(fusion_checked_); --root_fid) {
+    FunctionInfo &root = funcs_[root_fid];
+    if (root.rets[0].value || root.fused || root.absorbed ||
+        !root.func->get_elementwise_op(inst)) continue;
+
+    // Selects arguments to be absorbed. `cost` is the upper bound of the
+    // number of instructions.
+    const Device *device = root.rets[0].device;
+    unsigned cost = 1 + root.args.size();
+    unsigned num_absorbed = 0;
+    queue.assign(root.args.begin(), root.args.end());
+    while (!queue.empty()) {
+      const Address addr = queue.back();
+      queue.pop_back();
+      FunctionInfo &f = funcs_[addr.fid];
+      const NodeInfo &n = f.rets[addr.vid];
+      if (n.value || f.fused || f.absorbed || n.sinks.size() != 1 ||
+          n.device != device || !f.func->get_elementwise_op(inst) ||
+          cost + f.args.size() > ElementwiseProgram::MAX_INSTRUCTIONS) {
+        continue;
+      }
+      f.absorbed = true;
+      cost += f.args.size();
+      ++num_absorbed;
+      queue.insert(queue.end(), f.args.begin(), f.args.end());
+    }
+    if (num_absorbed > 0) make_fused(root_fid);
+  }
+
+  if (last_fid >= fusion_checked_) fusion_checked_ = last_fid + 1;
+}
+
+void Graph::make_fused(unsigned root_fid) {
+  ElementwiseProgram prog;
+  vector<Function *> funcs;
+  vector<Address> inputs;
+  emit_elementwise(
+      Address { root_fid, 0 }, root_fid, root_fid, prog, funcs, inputs);
+  FunctionInfo &root = funcs_[root_fid];
+  root.fused = arena_.create<functions::FusedElementwise>(prog, funcs);
+  root.fused_args = ArenaVector<Address>();
+  root.fused_args.assign(
+      inputs.data(), inputs.data() + inputs.size(), arena_);
+}
+
+unsigned Graph::emit_elementwise(
+    const Address &addr, unsigned root_fid, unsigned sink_fid,
+    ElementwiseProgram &prog, vector<Function *> &funcs,
+    vector<Address> &inputs) {
+  FunctionInfo &f = funcs_[addr.fid];
+  ElementwiseProgram::Instruction inst {
+    ElementwiseProgram::OPCODE_INPUT, 0, 0, 0 };
+
+  if (addr.fid == root_fid || f.absorbed) {
+    unsigned operands[] { 0, 0 };
+    for (unsigned i = 0; i < f.args.size(); ++i) {
+      operands[i] = emit_elementwise(
+          f.args[i], root_fid, addr.fid, prog, funcs, inputs);
+    }
+    f.func->get_elementwise_op(inst);
+    inst.a = operands[0];
+    inst.b = operands[1];
+    funcs.emplace_back(f.func);
+  } else {
+    // The node becomes an input of the program, and the fused function
+    // becomes a sink of the node instead of the absorbed function.
+    if (sink_fid != root_fid) {
+      for (unsigned &sink : f.rets[addr.vid].sinks) {
+        if (sink == sink_fid) {
+          sink = root_fid;
+          break;
+        }
+      }
+    }
+    inst.a = inputs.size();
+    inputs.emplace_back(addr);
+    funcs.emplace_back(nullptr);
+  }
+
+  prog.instructions.emplace_back(inst);
+  return prog.instructions.size() - 1;
+}
+
+void Graph::make_schedule(unsigned last_fid) {
+  // NOTE(odashi):
+  // In the current implementation, the node ID corresponds to the inverse
+  // topological order of the computation graph.
+
+  // Makes the schedule: uncalculated functions required by the target node,
+  // in the inverse topological order.
+  schedule_.clear();
+  required_.assign(last_fid + 1, false);
+  required_[last_fid] = true;
+  for (int fid = last_fid; fid >= 0; --fid) {
+    const FunctionInfo &f = funcs_[fid];
+    // Calculated functions never require their arguments again.
+    if (!required_[fid] || f.rets[0].value) continue;
+    schedule_.emplace_back(fid);
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+    for (const Address &arg : args) required_[arg.fid] = true;
+  }
+}
+
+Graph::MemoryPlan Graph::make_memory_plan() const {
+  MemoryPlan plan;
+  if (schedule_.empty()) return plan;
+
+  // Offsets are assigned by the best-fit allocation over lifetimes of values.
+  // A fake segment with the total size of all blocks makes every allocation
+  // succeed.
+  std::uint64_t total = 0;
+  for (const unsigned fid : schedule_) {
+    const std::uint64_t size = sizeof(float) * funcs_[fid].rets[0].shape.size();
+    total += (size + PLAN_ALIGNMENT - 1) & ~(PLAN_ALIGNMENT - 1);
+  }
+  void *const base = reinterpret_cast<void *>(PLAN_ALIGNMENT);
+  const auto offset_of = [base](void *ptr) {
+    return static_cast<std::uint64_t>(
+        static_cast<char *>(ptr) - static_cast<char *>(base));
+  };
+  vector<std::unique_ptr<ArenaAllocator>> arenas;
+
+  // Block index of each node, or -1 if the node is not in the workspace.
+  // NOTE(odashi): schedule_.front() is the last node.
+  vector<int> block_ids(schedule_.front() + 1, -1);
+  vector<unsigned> num_sinks(block_ids.size(), 0);
+
+  for (auto it = schedule_.rbegin(); it != schedule_.rend(); ++it) {
+    const FunctionInfo &f = funcs_[*it];
+    const NodeInfo &n = f.rets[0];
+
+    unsigned dev_id = 0;
+    while (dev_id < plan.devices.size() && plan.devices[dev_id] != n.device) {
+      ++dev_id;
+    }
+    if (dev_id == plan.devices.size()) {
+      plan.devices.emplace_back(n.device);
+      plan.workspace_sizes.emplace_back(0);
+      arenas.emplace_back(new ArenaAllocator(PLAN_ALIGNMENT));
+      arenas.back()->add_segment(base, total);
+    }
+
+    const std::uint64_t size = arenas[dev_id]->round_up(
+        sizeof(float) * n.shape.size());
+    const std::uint64_t offset = offset_of(arenas[dev_id]->allocate(size));
+    plan.workspace_sizes[dev_id] = std::max(
+        plan.workspace_sizes[dev_id], offset + size);
+    block_ids[*it] = plan.blocks.size();
+    plan.blocks.push_back({ Node(const_cast<Graph *>(this), *it, 0),
+        dev_id, offset, size });
+
+    if (policy_ == RELEASE_POLICY_INFERENCE) {
+      // Follows the release rule of forward().
+      const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+      for (const Address &arg : args) {
+        const NodeInfo &arg_n = funcs_[arg.fid].rets[arg.vid];
+        if (arg_n.num_calculated_sinks + ++num_sinks[arg.fid]
+            == arg_n.sinks.size() && block_ids[arg.fid] >= 0) {
+          const MemoryPlan::Block &b = plan.blocks[block_ids[arg.fid]];
+          arenas[b.device_index]->free(static_cast<char *>(base) + b.offset);
+          block_ids[arg.fid] = -1;
+        }
+      }
+    }
+  }
+
+  return plan;
+}
+
+Graph::MemoryPlan Graph::plan_memory(const Node &node) {
+  CHECK_NODE(node);
+  if (fusion_) fuse_elementwise(node.fid_);
+  make_schedule(node.fid_);
+  return make_memory_plan();
+}
+
+void Graph::forward_batched() {
+  // Groups functions by the distance from the inputs of the schedule.
+  // Functions with the same distance never depend on each other.
+  vector<int> depths(schedule_.front() + 1, -1);
+  vector<vector<unsigned>> levels;
+  for (auto it = schedule_.rbegin(); it != schedule_.rend(); ++it) {
+    const FunctionInfo &f = funcs_[*it];
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+    int depth = 0;
+    for (const Address &arg : args) {
+      depth = std::max(depth, depths[arg.fid] + 1);
+    }
+    depths[*it] = depth;
+    if (static_cast<unsigned>(depth) == levels.size()) levels.emplace_back();
+    levels[depth].emplace_back(*it);
+  }
+
+  std::unordered_map<std::string, unsigned> group_ids;
+  vector<vector<unsigned>> groups;
+  for (const vector<unsigned> &level : levels) {
+    // Makes groups of functions which can be merged.
+    group_ids.clear();
+    groups.clear();
+    for (const unsigned fid : level) {
+      const FunctionInfo &f = funcs_[fid];
+      const Function *func = f.fused ? f.fused : f.func;
+      if (!func->batchable()) {
+        groups.emplace_back(1, fid);
+        continue;
+      }
+      // NOTE(odashi):
+      // Names do not distinguish constants of elementwise functions exactly,
+      // and raw bits of constants are added to the key.
+      const NodeInfo &n = f.rets[0];
+      std::string key = func->name();
+      key += ';' + std::to_string(reinterpret_cast<std::uintptr_t>(n.device));
+      ElementwiseProgram::Instruction inst;
+      if (func->get_elementwise_op(inst)) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &inst.k, sizeof(bits));
+        key += ';' + std::to_string(bits);
+      }
+      // Arguments which are broadcasted should be shared by all calls.
+      const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+      for (const Address &arg : args) {
+        const Shape &s = funcs_[arg.fid].rets[arg.vid].shape;
+        key += ';' + s.to_string();
+        if (s.batch() != n.shape.batch()) {
+          key += '@' + std::to_string(arg.fid) + ',' + std::to_string(arg.vid);
+        }
+      }
+      const auto res = group_ids.emplace(key, groups.size());
+      if (res.second) groups.emplace_back();
+      groups[res.first->second].emplace_back(fid);
+    }
+
+    // Calculates each group.
+    for (const vector<unsigned> &group : groups) {
+      if (group.size() == 1 || !forward_merged(group)) {
+        for (const unsigned fid : group) {
+          FunctionInfo &f = funcs_[fid];
+          Function *func = f.fused ? f.fused : f.func;
+          const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+          arg_values_.resize(args.size());
+          for (unsigned i = 0; i < args.size(); ++i) {
+            const Address &arg = args[i];
+            arg_values_[i] = funcs_[arg.fid].rets[arg.vid].value;
+          }
+          Device *device = f.rets[0].device;
+          const double start_us = profiling_ ? profile_clock(device) : 0;
+          f.rets[0].value = new_tensor(func->forward(arg_values_));
+          if (profiling_) {
+            add_profile_record(
+                func, PROFILE_PHASE_FORWARD, device, start_us,
+                profile_clock(device),
+                f.rets[0].shape.size() * sizeof(float));
+          }
+        }
+      }
+
+      // Releases arguments which are no longer used.
+      for (const unsigned fid : group) {
+        FunctionInfo &f = funcs_[fid];
+        if (f.calculated) continue;
+        const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+        for (const Address &arg : args) release_argument(arg);
+        f.calculated = true;
+      }
+    }
+  }
+}
+
+bool Graph::forward_merged(const vector<unsigned> &fids) {
+  const FunctionInfo &f0 = funcs_[fids[0]];
+  Function *func = f0.fused ? f0.fused : f0.func;
+  const ArenaVector<Address> &args0 = f0.fused ? f0.fused_args : f0.args;
+  const unsigned batch = f0.rets[0].shape.batch();
+
+  // Arguments with the minibatch size 1 shared by all calls are used as-is,
+  // and others are concatenated.
+  vector<Tensor> merged_args;
+  merged_args.reserve(args0.size());
+  vector<const Tensor *> xs(fids.size());
+  arg_values_.resize(args0.size());
+  for (unsigned i = 0; i < args0.size(); ++i) {
+    const Address &a0 = args0[i];
+    bool shared = funcs_[a0.fid].rets[a0.vid].shape.batch() == 1;
+    for (unsigned j = 0; j < fids.size(); ++j) {
+      const FunctionInfo &f = funcs_[fids[j]];
+      const Address &arg = (f.fused ? f.fused_args : f.args)[i];
+      shared = shared && arg.fid == a0.fid && arg.vid == a0.vid;
+      xs[j] = funcs_[arg.fid].rets[arg.vid].value;
+    }
+    if (shared) {
+      arg_values_[i] = xs[0];
+    } else {
+      merged_args.emplace_back(xs[0]->device()->batch_concat_fw(xs));
+      arg_values_[i] = &merged_args.back();
+    }
+  }
+  if (merged_args.empty()) return false;
+
+  // Each value shares the memory of the merged result.
+  Device *dev = f0.rets[0].device;
+  const double start_us = profiling_ ? profile_clock(dev) : 0;
+  const Tensor y = func->forward(arg_values_);
+  if (profiling_) {
+    add_profile_record(
+        func, PROFILE_PHASE_FORWARD, dev, start_us, profile_clock(dev),
+        y.shape().size() * sizeof(float));
+  }
+  for (unsigned j = 0; j < fids.size(); ++j) {
+    funcs_[fids[j]].rets[0].value = new_tensor(
+        dev->batch_slice_fw(y, j * batch, (j + 1) * batch));
+  }
+  return true;
+}
+
+void Graph::forward_parallel() {
+  // Builds dependencies between scheduled functions, and assigns them to
+  // devices.
+  const unsigned last_fid = schedule_.front();
+  vector<bool> scheduled(last_fid + 1, false);
+  for (const unsigned fid : schedule_) scheduled[fid] = true;
+  vector<Device *> devices;
+  vector<unsigned> device_ids(last_fid + 1);
+  vector<unsigned> num_waiting(last_fid + 1, 0);
+  vector<vector<unsigned>> consumers(last_fid + 1);
+  vector<std::deque<unsigned>> ready;
+  for (auto it = schedule_.rbegin(); it != schedule_.rend(); ++it) {
+    const FunctionInfo &f = funcs_[*it];
+    const unsigned dev_id = std::find(
+        devices.begin(), devices.end(), f.rets[0].device) - devices.begin();
+    if (dev_id == devices.size()) {
+      devices.emplace_back(f.rets[0].device);
+      ready.emplace_back();
+    }
+    device_ids[*it] = dev_id;
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+    for (const Address &arg : args) {
+      if (scheduled[arg.fid]) {
+        consumers[arg.fid].emplace_back(*it);
+        ++num_waiting[*it];
+      }
+    }
+    if (num_waiting[*it] == 0) ready[dev_id].emplace_back(*it);
+  }
+
+  // NOTE(odashi):
+  // Only function calls run without the lock. All other states of the graph
+  // (including arena_) are updated by the thread which holds the lock.
+  std::mutex mutex;
+  std::condition_variable cv;
+  unsigned num_remaining = schedule_.size();
+  std::exception_ptr error;
+
+  const auto run = [&](unsigned dev_id) {
+    vector<const Tensor *> arg_values;
+    std::unique_lock<std::mutex> lock(mutex);
+    try {
+      while (true) {
+        cv.wait(lock, [&] {
+            return !ready[dev_id].empty() || num_remaining == 0 || error;
+        });
+        if (num_remaining == 0 || error) return;
+        const unsigned fid = ready[dev_id].front();
+        ready[dev_id].pop_front();
+        FunctionInfo &f = funcs_[fid];
+        Function *func = f.fused ? f.fused : f.func;
+        const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
+        arg_values.resize(args.size());
+        for (unsigned i = 0; i < args.size(); ++i) {
+          const Address &arg = args[i];
+          arg_values[i] = funcs_[arg.fid].rets[arg.vid].value;
+        }
+
+        Device *device = f.rets[0].device;
+        lock.unlock();
+        const double start_us = profiling_ ? profile_clock(device) : 0;
+        Tensor y = func->forward(arg_values);
+        const double end_us = profiling_ ? profile_clock(device) : 0;
+        lock.lock();
+
+        if (profiling_) {
+          add_profile_record(
+              func, PROFILE_PHASE_FORWARD, device, start_us, end_us,
+              y.shape().size() * sizeof(float));
+        }
+
+        f.rets[0].value = new_tensor(move(y));
+        --num_remaining;
+        for (const unsigned sink : consumers[fid]) {
+          if (--num_waiting[sink] == 0) {
+            ready[device_ids[sink]].emplace_back(sink);
+          }
+        }
+        // Releases arguments which are no longer used.
+        if (!f.calculated) {
+          for (const Address &arg : args) release_argument(arg);
+          f.calculated = true;
+        }
+        cv.notify_all();
+      }
+    } catch (...) {
+      // Stops all threads.
+      if (!lock.owns_lock()) lock.lock();
+      if (!error) error = std::current_exception();
+      cv.notify_all();
+    }
+  };
+
+  // The current thread calculates functions of the first device.
+  vector<std::thread> workers;
+  try {
+    for (unsigned i = 1; i < devices.size(); ++i) workers.emplace_back(run, i);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex);
+    error = std::current_exception();
+    cv.notify_all();
+  }
+  run(0);
+  for (std::thread &worker : workers) worker.join();
+  if (error) std::rethrow_exception(error);
+}
+
 const Tensor &Graph::forward(const Node &node) {
   CHECK_NODE(node);
 
-  std::function<void(unsigned)> forward_recursive = [&](unsigned fid) {
-    FunctionInfo &f = funcs_[fid];
+  if (fusion_) fuse_elementwise(node.fid_);
+  make_schedule(node.fid_);
 
-    // Check whether the function is already calculated or not.
-    if (f.rets[0].value) return;
+  if (batching_) {
+    if (!schedule_.empty()) forward_batched();
+    return *ACCESS(node).value;
+  }
+  if (parallel_) {
+    if (!schedule_.empty()) forward_parallel();
+    return *ACCESS(node).value;
+  }
+
+  // Allocates workspaces at once before the calculation.
+  const MemoryPlan plan = planning_ ? make_memory_plan() : MemoryPlan();
+  vector<Tensor> workspaces;
+  vector<char *> bases;
+  for (unsigned i = 0; i < plan.devices.size(); ++i) {
+    const std::uint64_t size = plan.workspace_sizes[i] / sizeof(float);
+    if (size > std::numeric_limits<unsigned>::max()) {
+      THROW_ERROR(
+          "Workspace exceeds the size limit of Shape. size: " << size);
+    }
+    workspaces.emplace_back(
+        plan.devices[i]->new_tensor(Shape({static_cast<unsigned>(size)})));
+    bases.emplace_back(static_cast<char *>(workspaces.back().data()));
+  }
+  // NOTE(odashi):
+  // Only weak references are kept here, because tensors are copied on write
+  // if their memory is shared.
+  vector<std::weak_ptr<void>> handles(plan.blocks.size());
+  vector<int> block_ids(plan.blocks.empty() ? 0 : node.fid_ + 1, -1);
+  for (unsigned i = 0; i < plan.blocks.size(); ++i) {
+    block_ids[plan.blocks[i].node.fid_] = i;
+  }
+  bool placing = !plan.blocks.empty();
+
+  // Results of concatenations allocated before their arguments.
+  vector<bool> scheduled;
+  vector<Tensor> concat_buffers;
+  if (concat_placement_) {
+    scheduled.assign(node.fid_ + 1, false);
+    for (const unsigned fid : schedule_) scheduled[fid] = true;
+    concat_buffers.resize(node.fid_ + 1);
+  }
+
+  // Performs the schedule.
+  unsigned step = 0;
+  for (auto it = schedule_.rbegin(); it != schedule_.rend(); ++it, ++step) {
+    FunctionInfo &f = funcs_[*it];
+    Function *func = f.fused ? f.fused : f.func;
+    const ArenaVector<Address> &args = f.fused ? f.fused_args : f.args;
 
     // Gathers arguments.
-    vector<const Tensor *> arg_values(f.args.size());
-    for (unsigned i = 0; i < f.args.size(); ++i) {
-      const Address &arg = f.args[i];
-      forward_recursive(arg.fid);
-      arg_values[i] = funcs_[arg.fid].rets[arg.vid].value;
+    arg_values_.resize(args.size());
+    for (unsigned i = 0; i < args.size(); ++i) {
+      const Address &arg = args[i];
+      arg_values_[i] = funcs_[arg.fid].rets[arg.vid].value;
+    }
+
+    Device *device = f.rets[0].device;
+    if (placing) {
+      // Each handle keeps the whole workspace alive.
+      const MemoryPlan::Block &b = plan.blocks[step];
+      const Tensor ws = workspaces[b.device_index];
+      std::shared_ptr<void> handle(
+          bases[b.device_index] + b.offset, [ws](void *) {});
+      handles[step] = handle;
+      device->place_next_tensor(move(handle), f.rets[0].shape.size());
     }
+    const bool placed = placing ||
+      (concat_placement_ && place_in_concat(*it, scheduled, concat_buffers));
 
     // Calculates results.
     // TODO(odashi): fix this.
-    vector<Tensor *> ret_values { new Tensor(f.func->forward(arg_values)) };
-    const unsigned NUM_NODES = 1;
-    for (unsigned i = 0; i < NUM_NODES; ++i) {
-      f.rets[i].value = ret_values[i];
-      f.rets[i].grad = new Tensor(
-          ret_values[i]->device()->new_tensor(ret_values[i]->shape(), 0));
+    // NOTE(odashi):
+    // Gradients are allocated by backward() if they are required.
+    const double start_us = profiling_ ? profile_clock(device) : 0;
+    try {
+      f.rets[0].value = new_tensor(func->forward(arg_values_));
+    } catch (...) {
+      if (placed) device->cancel_placement();
+      throw;
+    }
+    if (placed) device->cancel_placement();
+    if (profiling_) {
+      add_profile_record(
+          func, PROFILE_PHASE_FORWARD, device, start_us, profile_clock(device),
+          f.rets[0].shape.size() * sizeof(float));
     }
-  };
 
-  forward_recursive(node.fid_);
+    // Releases arguments which are no longer used. Arguments of
+    // recalculated functions were already counted.
+    if (f.calculated) continue;
+    f.calculated = true;
+    for (const Address &arg : args) {
+      // If the memory is still used by others (e.g., a result of reshape()),
+      // the block can not be reused by subsequent values and the memory plan
+      // is abandoned.
+      if (release_argument(arg) && placing && block_ids[arg.fid] >= 0 &&
+          !handles[block_ids[arg.fid]].expired()) {
+        placing = false;
+      }
+    }
+  }
+
   return *ACCESS(node).value;
 }
 
 void Graph::backward(const Node &node) {
   CHECK_NODE(node);
 
+  if (policy_ == RELEASE_POLICY_INFERENCE) {
+    THROW_ERROR("backward() is not available in RELEASE_POLICY_INFERENCE.");
+  }
+
   FunctionInfo &last_f = funcs_[node.fid_];
-  if (!last_f.rets[0].value) {
+  NodeInfo &last_n = last_f.rets[node.vid_];
+  if (last_n.dropped) recalculate(node.fid_);
+  if (!last_n.value) {
     THROW_ERROR("Node is still not calculated in the forward path.");
   }
 
   // Make the identity gradient (dx/dx = 1) at the last node.
-  last_f.rets[node.vid_].grad->reset(1);
+  if (!last_n.grad) last_n.grad = new_tensor(Tensor());
+  *last_n.grad = last_n.value->device()->new_tensor(last_n.shape, 1);
 
   // NOTE(odashi):
   // In the current implementation, the node ID corresponds to the inverse
   // topological order of the computation graph.
 
+  // Marks nodes which should obtain gradients.
+  // If pruning is enabled, only nodes depending on parameters or requested
+  // nodes are marked.
+  required_.assign(node.fid_ + 1, !pruning_);
+  if (pruning_) {
+    for (unsigned fid = 0; fid <= node.fid_; ++fid) {
+      const FunctionInfo &f = funcs_[fid];
+      bool req = f.func->has_parameters() || f.rets[0].grad_requested;
+      for (const Address &arg : f.args) {
+        if (req) break;
+        req = required_[arg.fid];
+      }
+      required_[fid] = req;
+    }
+  }
+
   // Performs backpropagation.
   for (int fid = node.fid_; fid >= 0; --fid) {
     const FunctionInfo &cur_f = funcs_[fid];
 
     // If the value is nullptr, the function is out of the forward path.
-    if (!cur_f.rets[0].value) continue;
+    // If the gradient is not allocated, the function is out of the backward
+    // path.
+    // Dropped values are recalculated from the nearest checkpoints.
+    const NodeInfo &cur_n = cur_f.rets[0];
+    if (!cur_n.grad || !cur_n.grad->valid()) continue;
+    if (cur_n.dropped) recalculate(fid);
+    if (!cur_n.value) continue;
 
     // Gather argument value/gradient tensors.
-    const unsigned arg_size = cur_f.args.size();
-    vector<const Tensor *> arg_values(arg_size);
-    vector<Tensor *> arg_grads(arg_size);
+    // Gradients of unmarked arguments are nullptr.
+    Function *func = cur_f.fused ? cur_f.fused : cur_f.func;
+    const ArenaVector<Address> &args =
+      cur_f.fused ? cur_f.fused_args : cur_f.args;
+    const unsigned arg_size = args.size();
+    arg_values_.resize(arg_size);
+    arg_grads_.resize(arg_size);
+    bool propagate = func->has_parameters();
     for (unsigned i = 0; i < arg_size; ++i) {
-      const Address &arg = cur_f.args[i];
+      const Address &arg = args[i];
       NodeInfo &arg_n = funcs_[arg.fid].rets[arg.vid];
-      arg_values[i] = arg_n.value;
-      arg_grads[i] = arg_n.grad;
+      if (arg_n.dropped) recalculate(arg.fid);
+      if (!arg_n.value) {
+        THROW_ERROR("Values required by backward() are already released.");
+      }
+      arg_values_[i] = arg_n.value;
+      if (required_[arg.fid]) {
+        // The gradient tensor itself is initialized by the function.
+        if (!arg_n.grad) arg_n.grad = new_tensor(Tensor());
+        arg_grads_[i] = arg_n.grad;
+        propagate = true;
+      } else {
+        arg_grads_[i] = nullptr;
+      }
     }
 
     // Propagetes the gradient from this node.
     // TODO(odashi): fix this.
-    const NodeInfo &cur_n = cur_f.rets[0];
-    cur_f.func->backward(*cur_n.value, *cur_n.grad, arg_values, arg_grads);
+    if (propagate) {
+      const double start_us = profiling_ ? profile_clock(cur_n.device) : 0;
+      func->backward(*cur_n.value, *cur_n.grad, arg_values_, arg_grads_);
+      if (profiling_) {
+        std::uint64_t bytes = 0;
+        for (unsigned i = 0; i < arg_size; ++i) {
+          if (arg_grads_[i]) bytes += arg_values_[i]->shape().size();
+        }
+        add_profile_record(
+            func, PROFILE_PHASE_BACKWARD, cur_n.device, start_us,
+            profile_clock(cur_n.device), bytes * sizeof(float));
+      }
+    }
+
+    if (policy_ == RELEASE_POLICY_TRAINING) {
+      // Remaining steps use only nodes with smaller IDs.
+      NodeInfo &n = funcs_[fid].rets[0];
+      if (static_cast<unsigned>(fid) == node.fid_) {
+        delete_tensor(n.grad);
+      } else {
+        release_node(n);
+      }
+    }
   }
 }
 
@@ -179,14 +1010,16 @@ Device *Graph::get_device(const Node &node) const {
 const Tensor &Graph::get_value(const Node &node) const {
   CHECK_NODE(node);
   const Tensor *ret = ACCESS(node).value;
-  if (!ret) THROW_ERROR("Node is still not calculated.");
+  if (!ret) THROW_ERROR("Node is still not calculated or already released.");
   return *ret;
 }
 
 const Tensor &Graph::get_gradient(const Node &node) const {
   CHECK_NODE(node);
   const Tensor *ret = ACCESS(node).grad;
-  if (!ret) THROW_ERROR("Node is still not calculated.");
+  if (!ret || !ret->valid()) {
+    THROW_ERROR("Node is still not calculated or already released.");
+  }
   return *ret;
 }
 
@@ -216,4 +1049,95 @@ void Graph::dump() const {
   }
 }
 
+void Graph::set_profiling(bool enabled) {
+  if (enabled && !profiling_ && profile_.empty()) {
+    profile_origin_ = std::chrono::steady_clock::now();
+  }
+  profiling_ = enabled;
+}
+
+double Graph::profile_clock(Device *device) const {
+  device->synchronize();
+  return std::chrono::duration<double, std::micro>(
+      std::chrono::steady_clock::now() - profile_origin_).count();
+}
+
+void Graph::add_profile_record(
+    const Function *func, ProfilePhase phase, Device *device,
+    double start_us, double end_us, std::uint64_t bytes) {
+  profile_.emplace_back(ProfileRecord {
+      func->name(), phase, device, start_us, end_us - start_us, bytes});
+}
+
+vector<Graph::ProfileSummary> Graph::profile_summary() const {
+  vector<ProfileSummary> ret;
+  std::unordered_map<std::string, unsigned> ids;
+  for (const ProfileRecord &r : profile_) {
+    const std::string key = std::to_string(r.phase) + ';' + r.name;
+    const auto res = ids.emplace(key, ret.size());
+    if (res.second) ret.emplace_back(ProfileSummary {r.name, r.phase, 0, 0, 0});
+    ProfileSummary &s = ret[res.first->second];
+    ++s.count;
+    s.total_us += r.duration_us;
+    s.total_bytes += r.bytes;
+  }
+  std::stable_sort(
+      ret.begin(), ret.end(),
+      [](const ProfileSummary &a, const ProfileSummary &b) {
+        return a.total_us > b.total_us;
+      });
+  return ret;
+}
+
+void Graph::dump_profile(std::ostream &os) const {
+  const vector<ProfileSummary> summary = profile_summary();
+  double total_us = 0;
+  for (const ProfileSummary &s : summary) total_us += s.total_us;
+  const std::ios::fmtflags flags = os.flags();
+  os << std::left << std::setw(32) << "function" << std::setw(10) << "phase"
+     << std::right << std::setw(8) << "calls" << std::setw(14) << "total[us]"
+     << std::setw(12) << "avg[us]" << std::setw(8) << "%"
+     << std::setw(14) << "bytes" << '\n';
+  os << std::fixed << std::setprecision(1);
+  for (const ProfileSummary &s : summary) {
+    os << std::left << std::setw(32) << s.name << std::setw(10)
+       << (s.phase == PROFILE_PHASE_FORWARD ? "forward" : "backward")
+       << std::right << std::setw(8) << s.count
+       << std::setw(14) << s.total_us
+       << std::setw(12) << s.total_us / s.count
+       << std::setw(8) << (total_us > 0 ? 100 * s.total_us / total_us : 0)
+       << std::setw(14) << s.total_bytes << '\n';
+  }
+  os.flags(flags);
+}
+
+void Graph::dump_profile_chrome_trace(std::ostream &os) const {
+  const auto escape = [](const std::string &src) {
+    std::string ret;
+    for (const char c : src) {
+      if (c == '"' || c == '\\') ret += '\\';
+      ret += c;
+    }
+    return ret;
+  };
+  vector<Device *> devices;
+  const std::ios::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(3);
+  os << "{\"traceEvents\":[";
+  for (unsigned i = 0; i < profile_.size(); ++i) {
+    const ProfileRecord &r = profile_[i];
+    const unsigned tid = std::find(
+        devices.begin(), devices.end(), r.device) - devices.begin();
+    if (tid == devices.size()) devices.emplace_back(r.device);
+    if (i > 0) os << ',';
+    os << "\n{\"name\":\"" << escape(r.name) << "\",\"cat\":\""
+       << (r.phase == PROFILE_PHASE_FORWARD ? "forward" : "backward")
+       << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+       << ",\"ts\":" << r.start_us << ",\"dur\":" << r.duration_us
+       << ",\"args\":{\"bytes\":" << r.bytes << "}}";
+  }
+  os << "\n]}\n";
+  os.flags(flags);
+}
+
 }  // namespace primitiv
@@ -1,7 +1,13 @@
 #ifndef PRIMITIV_GRAPH_H_
 #define PRIMITIV_GRAPH_H_
 
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
 #include <vector>
+#include <primitiv/bump_arena.h>
 #include <primitiv/function.h>
 #include <primitiv/node.h>
 #include <primitiv/shape.h>
@@ -9,20 +15,355 @@
 namespace primitiv {
 
 class Device;
+class InferencePlan;
 
 /**
  * Computation graph.
  */
 class Graph {
+  friend InferencePlan;
   Graph(const Graph &) = delete;
   Graph(Graph &&) = delete;
   Graph &operator=(const Graph &) = delete;
   Graph &operator=(Graph &&) = delete;
 
 public:
-  Graph() = default;
+  /**
+   * Policies to release values and gradients held by the graph.
+   */
+  enum ReleasePolicy {
+    /**
+     * Keeps all values and gradients until the graph is cleared or destroyed.
+     * Values of parameters are also kept, and updating the parameters while
+     * the graph is alive duplicates their memory.
+     */
+    RELEASE_POLICY_NONE,
+
+    /**
+     * Releases the value of each node in `forward()` as soon as all functions
+     * using the node are calculated. `backward()` is not available.
+     */
+    RELEASE_POLICY_INFERENCE,
+
+    /**
+     * Releases the value and the gradient of each node in `backward()` as
+     * soon as the gradient of the node is propagated to its arguments.
+     * Only the value of the output node is kept, and parameters can be updated
+     * after `backward()` without duplicating their memory.
+     */
+    RELEASE_POLICY_TRAINING,
+  };
+
+  /**
+   * Creates a new graph which keeps all values and gradients.
+   */
+  Graph()
+    : policy_(RELEASE_POLICY_NONE), pruning_(false), fusion_(false),
+      planning_(false), concat_placement_(false), batching_(false),
+      parallel_(false), checkpointing_(false), profiling_(false),
+      fusion_checked_(0) {}
+
+  /**
+   * Creates a new graph.
+   * @param policy Policy to release values and gradients.
+   */
+  explicit Graph(ReleasePolicy policy)
+    : policy_(policy), pruning_(false), fusion_(false), planning_(false),
+      concat_placement_(false), batching_(false), parallel_(false),
+      checkpointing_(false), profiling_(false), fusion_checked_(0) {}
+
   ~Graph();
 
+  /**
+   * Retrieves the release policy of this graph.
+   * @return Policy to release values and gradients.
+   */
+  ReleasePolicy release_policy() const { return policy_; }
+
+  /**
+   * Enables or disables pruning of the backward path.
+   * @param enabled If true, `backward()` propagates gradients only to nodes
+   *                which have a parameter or a node specified by
+   *                `require_gradient()` in their ancestors.
+   * @remarks Pruning is disabled by default, i.e., gradients of all nodes in
+   *          the backward path are calculated.
+   */
+  void set_backward_pruning(bool enabled) { pruning_ = enabled; }
+
+  /**
+   * Retrieves whether the backward path is pruned or not.
+   * @return true if pruning is enabled, false otherwise.
+   */
+  bool backward_pruning() const { return pruning_; }
+
+  /**
+   * Enables or disables fusion of elementwise functions.
+   * @param enabled If true, `forward()` merges each chain of uncalculated
+   *                elementwise functions into one function which is
+   *                calculated by one kernel of the device.
+   * @remarks Fusion is disabled by default. Intermediate nodes in fused chains
+   *          have no values after `forward()` unless they are calculated
+   *          explicitly, and they obtain no gradients by `backward()`.
+   *          Only nodes used by exactly one function are merged.
+   */
+  void set_elementwise_fusion(bool enabled) { fusion_ = enabled; }
+
+  /**
+   * Retrieves whether elementwise functions are fused or not.
+   * @return true if fusion is enabled, false otherwise.
+   */
+  bool elementwise_fusion() const { return fusion_; }
+
+  /**
+   * Enables or disables the memory planning.
+   * @param enabled If true, `forward()` makes the memory plan of uncalculated
+   *                functions before the calculation, allocates one workspace
+   *                for each device, and stores values in the workspaces.
+   * @remarks Planning is disabled by default. Values share workspaces only if
+   *          their lifetimes never overlap, i.e., only with
+   *          `RELEASE_POLICY_INFERENCE`. If some function returns a tensor
+   *          which shares the memory of another planned tensor, the remaining
+   *          functions in the same call use the memory pool as usual.
+   */
+  void set_memory_planning(bool enabled) { planning_ = enabled; }
+
+  /**
+   * Retrieves whether the memory planning is enabled or not.
+   * @return true if planning is enabled, false otherwise.
+   */
+  bool memory_planning() const { return planning_; }
+
+  /**
+   * Enables or disables the placement of arguments of concatenations.
+   * @param enabled If true, `forward()` allocates the result of each
+   *                uncalculated concatenation before its arguments, and
+   *                calculates each argument used only by the concatenation
+   *                directly into its part of the result, so that the
+   *                concatenation requires no copy.
+   * @remarks Placement is disabled by default. Only concatenations along the
+   *          last dimension of results without the minibatch (e.g., columns
+   *          of a matrix) are placed because each argument must be a
+   *          contiguous part of the result. If some function does not store
+   *          its value in the specified memory, the concatenation copies
+   *          values as usual. This option is ignored for functions placed by
+   *          the memory planning, and while auto-batching or parallel
+   *          execution is enabled.
+   */
+  void set_concat_placement(bool enabled) { concat_placement_ = enabled; }
+
+  /**
+   * Retrieves whether arguments of concatenations are placed or not.
+   * @return true if placement is enabled, false otherwise.
+   */
+  bool concat_placement() const { return concat_placement_; }
+
+  /**
+   * Enables or disables automatic batching of independent functions.
+   * @param enabled If true, `forward()` merges uncalculated functions which
+   *                have the same type, the same parameters and the same
+   *                argument shapes, and which do not depend on each other,
+   *                into one call with arguments concatenated along the
+   *                minibatch.
+   * @remarks Batching is disabled by default. Only functions whose
+   *          `Function::batchable()` returns true are merged, and arguments
+   *          with the minibatch size 1 which are shared by all merged calls
+   *          (e.g., parameters) are not concatenated. Values of merged nodes
+   *          share the memory of the merged result, and `backward()`
+   *          calculates each node separately as usual.
+   *          Functions are merged only if they have the same distance from
+   *          the inputs of the schedule. The memory planning is not applied
+   *          while batching is enabled.
+   */
+  void set_auto_batching(bool enabled) { batching_ = enabled; }
+
+  /**
+   * Retrieves whether independent functions are batched or not.
+   * @return true if batching is enabled, false otherwise.
+   */
+  bool auto_batching() const { return batching_; }
+
+  /**
+   * Enables or disables parallel execution of functions on different
+   * devices.
+   * @param enabled If true, `forward()` runs one thread for each device used
+   *                by uncalculated functions, and each thread calculates
+   *                functions of its device as soon as all their arguments
+   *                are calculated.
+   * @remarks Parallel execution is disabled by default. Functions on the same
+   *          device are calculated sequentially, so using multiple Device
+   *          objects (e.g., multiple CPUDevice objects) is required to
+   *          calculate independent branches concurrently. Devices should not
+   *          be used by other threads during `forward()`.
+   *          `backward()` is always calculated sequentially, and this option
+   *          is ignored while auto-batching is enabled. The memory planning is
+   *          not applied while parallel execution is enabled.
+   */
+  void set_parallel_execution(bool enabled) { parallel_ = enabled; }
+
+  /**
+   * Retrieves whether functions are calculated in parallel or not.
+   * @return true if parallel execution is enabled, false otherwise.
+   */
+  bool parallel_execution() const { return parallel_; }
+
+  /**
+   * Enables or disables gradient checkpointing.
+   * @param enabled If true, `forward()` drops the value of each node as soon
+   *                as all functions using the node are calculated, except
+   *                nodes marked by `mark_checkpoint()` and nodes calculated by
+   *                functions without arguments. `backward()` recalculates
+   *                dropped values from the nearest calculated nodes when they
+   *                are required.
+   * @remarks Checkpointing is disabled by default. Marking every k-th step of
+   *          a sequence of length n keeps O(n/k + k) values at once with
+   *          `RELEASE_POLICY_TRAINING`, at the cost of calculating the forward
+   *          path about twice. Values of functions with random numbers are
+   *          not changed by recalculation as long as random numbers are
+   *          generated by functions without arguments.
+   *          This option has no effect with `RELEASE_POLICY_INFERENCE`.
+   */
+  void set_gradient_checkpointing(bool enabled) { checkpointing_ = enabled; }
+
+  /**
+   * Retrieves whether gradient checkpointing is enabled or not.
+   * @return true if checkpointing is enabled, false otherwise.
+   */
+  bool gradient_checkpointing() const { return checkpointing_; }
+
+  /**
+   * Phases of function calls recorded by the profiler.
+   */
+  enum ProfilePhase {
+    PROFILE_PHASE_FORWARD,
+    PROFILE_PHASE_BACKWARD,
+  };
+
+  /**
+   * Record of one function call.
+   */
+  struct ProfileRecord {
+    // Result of `Function::name()`.
+    std::string name;
+    ProfilePhase phase;
+
+    // Device of the resulting node.
+    Device *device;
+
+    // Start time in microseconds from the profiling is enabled, and the
+    // duration of the call in microseconds.
+    double start_us;
+    double duration_us;
+
+    // Size of values (forward) or gradients (backward) calculated by the call
+    // in bytes.
+    std::uint64_t bytes;
+  };
+
+  /**
+   * Aggregated records of functions with the same name and phase.
+   */
+  struct ProfileSummary {
+    std::string name;
+    ProfilePhase phase;
+    unsigned count;
+    double total_us;
+    std::uint64_t total_bytes;
+  };
+
+  /**
+   * Enables or disables profiling of function calls.
+   * @param enabled If true, `forward()` and `backward()` record the wall time
+   *                and the size of results of each function call.
+   * @remarks Profiling is disabled by default. The device is synchronized
+   *          before and after each call to measure asynchronous kernels,
+   *          which slows down the calculation. Records are kept across
+   *          `clear()` until `clear_profile()` is called. Recalculations by
+   *          gradient checkpointing are recorded as forward calls, and merged
+   *          calls of auto-batching are recorded as one call.
+   */
+  void set_profiling(bool enabled);
+
+  /**
+   * Retrieves whether function calls are profiled or not.
+   * @return true if profiling is enabled, false otherwise.
+   */
+  bool profiling() const { return profiling_; }
+
+  /**
+   * Retrieves all records in the order of calls.
+   * @return List of records.
+   */
+  const std::vector<ProfileRecord> &profile_records() const {
+    return profile_;
+  }
+
+  /**
+   * Aggregates records by the name and the phase.
+   * @return List of summaries in descending order of the total time.
+   */
+  std::vector<ProfileSummary> profile_summary() const;
+
+  /**
+   * Removes all records.
+   */
+  void clear_profile() { profile_.clear(); }
+
+  /**
+   * Writes the aggregated records as a text table.
+   * @param os Output stream.
+   */
+  void dump_profile(std::ostream &os) const;
+
+  /**
+   * Writes all records in the Chrome trace event format, which can be
+   * opened by chrome://tracing or Perfetto.
+   * @param os Output stream.
+   * @remarks Each device is shown as one thread.
+   */
+  void dump_profile_chrome_trace(std::ostream &os) const;
+
+  /**
+   * Memory layout of values calculated by one `forward()` call.
+   */
+  struct MemoryPlan {
+    /**
+     * Location of the value of a node.
+     */
+    struct Block {
+      Node node;
+      unsigned device_index;
+      std::uint64_t offset;
+      std::uint64_t size;
+    };
+
+    // Devices used by the calculation.
+    std::vector<Device *> devices;
+
+    // Size of the workspace of each device in bytes.
+    std::vector<std::uint64_t> workspace_sizes;
+
+    // Blocks of uncalculated nodes in the order of the calculation.
+    std::vector<Block> blocks;
+  };
+
+  /**
+   * Alignment of each block in the memory plan.
+   */
+  static const std::uint64_t PLAN_ALIGNMENT = 256;
+
+  /**
+   * Makes the memory plan to calculate the node.
+   * @param node Node object specifying the target node.
+   * @return Memory plan of functions which would be calculated by
+   *         `forward(node)`.
+   * @remarks Sizes in the plan are determined only by shapes of nodes, and
+   *          the peak memory of the calculation is known without running it.
+   *          Temporary tensors used inside each function are not included.
+   *          If fusion is enabled, this function fuses functions as same as
+   *          `forward()`.
+   */
+  MemoryPlan plan_memory(const Node &node);
+
   /**
    * Adds a function subgraph.
    * @param func Interface of the new function.
@@ -32,6 +373,64 @@ public:
    */
   Node add_function(Function *func, const std::vector<Node> &args);
 
+  /**
+   * Constructs a new function in the memory of the graph and adds it.
+   * @param args List of arguments. Each node should point a node in the same
+   *        computation graph.
+   * @param params Arguments of the constructor of `FunctionT`.
+   * @return A new Node object of the resulting value.
+   * @remarks Unlike `add_function()`, this function requires no heap
+   *          allocation for each function in most cases.
+   */
+  template <typename FunctionT, typename... Params>
+  Node emplace_function(const std::vector<Node> &args, Params &&... params) {
+    const BumpArena::Position position = arena_.position();
+    return register_function(
+        arena_.create<FunctionT>(std::forward<Params>(params)...), args, true,
+        position);
+  }
+
+  /**
+   * Removes all functions in the graph.
+   * @remarks All Node objects pointing to this graph become invalid.
+   *          Internal buffers, including the memory of functions made by
+   *          `emplace_function()`, are kept and reused by the succeeding
+   *          construction, so that it is cheaper than making a new Graph
+   *          object for each minibatch.
+   */
+  void clear();
+
+  /**
+   * Removes functions added after the specified number of functions.
+   * @param num_functions Number of functions to be kept, i.e., the return
+   *                      value of `num_functions()` when the first function to
+   *                      be removed was added.
+   * @remarks Node objects pointing to removed functions become invalid, and
+   *          the other nodes keep their values. The memory of removed
+   *          functions, their values and their gradients is reused by
+   *          succeeding functions, so that repeating a step of an
+   *          autoregressive decoder by `truncate()` and adding functions
+   *          keeps the memory of the graph constant. Values to be carried by
+   *          succeeding steps can be passed again by `input(tensor)`.
+   *          Fused functions whose chains were partly removed are unfused,
+   *          and fused again by the next `forward()` if possible.
+   */
+  void truncate(unsigned num_functions);
+
+  /**
+   * Requests the gradient of the node even if the backward path is pruned.
+   * @param node Node object specifying the target node.
+   * @remarks Descendant nodes of `node` also obtain their gradients.
+   */
+  void require_gradient(const Node &node);
+
+  /**
+   * Marks the node as a checkpoint whose value is kept by gradient
+   * checkpointing.
+   * @param node Node object specifying the target node.
+   */
+  void mark_checkpoint(const Node &node);
+
   /**
    * Calculates the value of given node.
    * @param node Node object specifying the target node.
@@ -41,6 +440,10 @@ public:
    *          the corresponding node in the subgraph and they are re-used for
    *          future calculation. I.e., each node is calculated only once while
    *          the lifetime of the Graph object.
+   *          If the policy is `RELEASE_POLICY_INFERENCE`, values of
+   *          intermediate nodes may be released by this function, and
+   *          references returned by previous calls may be invalidated.
+   *          Released nodes are calculated again if they are required.
    */
   const Tensor &forward(const Node &node);
 
@@ -50,6 +453,11 @@ public:
    * @remarks `node` should point to a node in the forward path, i.e., the same
    *          node used to call `forward()`, or an ancestor node of that.
    *          Descendant nodes of `node` are removed from the backward path.
+   *          If the policy is `RELEASE_POLICY_TRAINING`, this function can be
+   *          called only once for each forward path, and gradients of the
+   *          nodes are not available after calling this function.
+   *          If pruning is enabled, gradients of nodes which do not depend on
+   *          any parameters or requested nodes are not calculated.
    */
   void backward(const Node &node);
 
@@ -96,6 +504,13 @@ public:
    */
   unsigned num_functions() const { return funcs_.size(); }
 
+  /**
+   * Returns the size of the internal memory used by functions, values and
+   * their informations.
+   * @return Size in bytes. This does not include the memory of devices.
+   */
+  std::size_t internal_bytes_in_use() const { return arena_.bytes_in_use(); }
+
 private:
   /**
    * Tuple of values to determine the location of the node.
@@ -107,13 +522,18 @@ private:
 
   /**
    * Informations of each node.
+   * Tensors and arrays are stored in `arena_`.
    */
   struct NodeInfo {
     Shape shape;
     Device *device;
     Tensor *value;
     Tensor *grad;
-    std::vector<unsigned> sinks;
+    ArenaVector<unsigned> sinks;
+    unsigned num_calculated_sinks;
+    bool grad_requested;
+    bool checkpoint;
+    bool dropped;
   };
 
   /**
@@ -122,11 +542,209 @@ private:
    */
   struct FunctionInfo {
     Function *func;
-    std::vector<Address> args;
-    std::vector<NodeInfo> rets;
+    ArenaVector<Address> args;
+    ArenaVector<NodeInfo> rets;
+
+    // Whether `func` is stored in `arena_` or allocated by the user.
+    bool in_arena;
+
+    // Function which calculates this function and its absorbed arguments at
+    // once, and its arguments. `fused` is nullptr if not fused, and is always
+    // stored in `arena_`.
+    Function *fused;
+    ArenaVector<Address> fused_args;
+
+    // Whether this function is absorbed by the fused function of its sink.
+    bool absorbed;
+
+    // Whether arguments already counted this function as a calculated sink.
+    bool calculated;
+
+    // Position of `arena_` before all memory of this function is allocated.
+    BumpArena::Position position;
   };
 
+  /**
+   * Adds a function subgraph.
+   * @param func Interface of the new function.
+   * @param args List of arguments.
+   * @param in_arena Whether `func` is stored in `arena_` or not.
+   * @param position Position of `arena_` before `func` is stored.
+   * @return A new Node object of the resulting value.
+   * @remarks `func` is destroyed if this function throws.
+   */
+  Node register_function(
+      Function *func, const std::vector<Node> &args, bool in_arena,
+      const BumpArena::Position &position);
+
+  /**
+   * Releases values, gradients and functions held by the graph.
+   */
+  void delete_functions();
+
+  /**
+   * Destroys the function.
+   * @param func Target function.
+   * @param in_arena Whether `func` is stored in `arena_` or not.
+   */
+  static void delete_function(Function *func, bool in_arena);
+
+  /**
+   * Destroys the tensor object made by `new_tensor()`.
+   * @param x Pointer to the target tensor, or nullptr. `x` becomes nullptr.
+   */
+  static void delete_tensor(Tensor *&x);
+
+  /**
+   * Makes a new tensor object in `arena_`.
+   * @param src Source tensor.
+   * @return Pointer to the new object.
+   */
+  Tensor *new_tensor(Tensor &&src) {
+    return arena_.create<Tensor>(std::move(src));
+  }
+
+  /**
+   * Stores uncalculated functions required by the target function into
+   * `schedule_` in the inverse topological order.
+   * @param last_fid ID of the target function.
+   */
+  void make_schedule(unsigned last_fid);
+
+  /**
+   * Makes the memory plan of functions in `schedule_`.
+   * @return Memory plan.
+   */
+  MemoryPlan make_memory_plan() const;
+
+  /**
+   * Calculates functions in `schedule_` with merging independent calls.
+   */
+  void forward_batched();
+
+  /**
+   * Calculates functions by one call with concatenated arguments.
+   * @param fids IDs of functions to be merged. All functions should have the
+   *             same batching key.
+   * @return true if the functions are calculated, false if there is no
+   *         argument to be concatenated.
+   */
+  bool forward_merged(const std::vector<unsigned> &fids);
+
+  /**
+   * Calculates functions in `schedule_` with one thread for each device.
+   */
+  void forward_parallel();
+
+  /**
+   * Merges chains of elementwise functions into fused functions.
+   * @param last_fid The last function ID to be examined.
+   */
+  void fuse_elementwise(unsigned last_fid);
+
+  /**
+   * Makes the fused function of the chain whose other functions are already
+   * absorbed.
+   * @param root_fid ID of the root function of the chain.
+   */
+  void make_fused(unsigned root_fid);
+
+  /**
+   * Appends instructions to calculate the node to the fused program.
+   * @param addr Address of the node.
+   * @param root_fid ID of the root function of the fused chain.
+   * @param sink_fid ID of the function using the node.
+   * @param prog Program to be updated.
+   * @param funcs Original functions of each instruction.
+   * @param inputs Addresses of input nodes of the program.
+   * @return Index of the instruction which calculates the node.
+   */
+  unsigned emit_elementwise(
+      const Address &addr, unsigned root_fid, unsigned sink_fid,
+      ElementwiseProgram &prog, std::vector<Function *> &funcs,
+      std::vector<Address> &inputs);
+
+  /**
+   * Releases the value and the gradient of the node.
+   * @param n Target node.
+   */
+  static void release_node(NodeInfo &n);
+
+  /**
+   * Counts a calculated function using the argument, and releases or drops
+   * its value if no more functions use it.
+   * @param arg Address of the argument.
+   * @return true if the value is released or dropped, false otherwise.
+   */
+  bool release_argument(const Address &arg);
+
+  /**
+   * Recalculates the dropped value of the node and its dropped ancestors.
+   * @param fid ID of the function calculating the node.
+   */
+  void recalculate(unsigned fid);
+
+  /**
+   * Makes the next value of the device use the part of the result of its
+   * sink if the sink is a concatenation which can be placed.
+   * @param fid ID of the function to be calculated.
+   * @param scheduled Whether each function is scheduled or not.
+   * @param buffers Preallocated results of concatenations, indexed by
+   *                function IDs.
+   * @return true if the placement is specified, false otherwise.
+   */
+  bool place_in_concat(
+      unsigned fid, const std::vector<bool> &scheduled,
+      std::vector<Tensor> &buffers);
+
+  /**
+   * Synchronizes the device and returns the current time for profiling.
+   * @param device Device to be synchronized.
+   * @return Microseconds from the profiling is enabled.
+   */
+  double profile_clock(Device *device) const;
+
+  /**
+   * Appends a record of the function call.
+   * @param func Called function.
+   * @param phase Phase of the call.
+   * @param device Device of the call.
+   * @param start_us Return value of `profile_clock()` before the call.
+   * @param end_us Return value of `profile_clock()` after the call.
+   * @param bytes Size of calculated tensors.
+   */
+  void add_profile_record(
+      const Function *func, ProfilePhase phase, Device *device,
+      double start_us, double end_us, std::uint64_t bytes);
+
+  // Memory of functions, tensors and arrays owned by the graph.
+  BumpArena arena_;
+
+  ReleasePolicy policy_;
+  bool pruning_;
+  bool fusion_;
+  bool planning_;
+  bool concat_placement_;
+  bool batching_;
+  bool parallel_;
+  bool checkpointing_;
+  bool profiling_;
   std::vector<FunctionInfo> funcs_;
+
+  // Records of the profiler, and the origin of their times.
+  std::vector<ProfileRecord> profile_;
+  std::chrono::steady_clock::time_point profile_origin_;
+
+  // Functions with smaller IDs are already examined by fuse_elementwise().
+  unsigned fusion_checked_;
+
+  // Work spaces of add_function(), forward() and backward(), reused across
+  // calls to avoid allocations for every function.
+  std::vector<const Shape *> arg_shapes_;
+  std::vector<bool> required_;
+  std::vector<unsigned> schedule_;
+  std::vector<const Tensor *> arg_values_;
+  std::vector<Tensor *> arg_grads_;
 };
 
 }  // namespace primitiv
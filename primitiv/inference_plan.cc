@@ -0,0 +1,547 @@
+#include <config.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <primitiv/binary_io.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+#include <primitiv/function_impl.h>
+#include <primitiv/graph.h>
+#include <primitiv/inference_plan.h>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char *const PLAN_MAGIC = "primitiv.InferencePlan";
+const std::uint32_t PLAN_VERSION = 1;
+
+// Writes a shape followed by values of the tensor.
+void write_tensor(primitiv::BinaryWriter &writer, const primitiv::Tensor &x) {
+  const vector<float> values = x.to_vector();
+  writer.write_shape(x.shape());
+  writer.write_block(values.data(), sizeof(float) * values.size());
+}
+
+// Reads values written by the function with their shape.
+vector<float> read_values(
+    primitiv::BinaryReader &reader, const primitiv::Shape &shape) {
+  vector<float> ret(shape.size());
+  const char *src = reader.read_block(sizeof(float) * ret.size());
+  std::copy(src, src + sizeof(float) * ret.size(),
+      reinterpret_cast<char *>(ret.data()));
+  return ret;
+}
+
+// Reads a list of indices written with its length.
+vector<unsigned> read_ids(primitiv::BinaryReader &reader) {
+  vector<unsigned> ret(reader.read<std::uint32_t>());
+  for (unsigned &id : ret) id = reader.read<std::uint32_t>();
+  return ret;
+}
+
+}  // namespace
+
+namespace primitiv {
+
+namespace F = functions;
+
+InferencePlan::InferencePlan(
+    const vector<Node> &inputs, const vector<Node> &outputs, Device *device)
+: device_(device) {
+  if (outputs.empty()) THROW_ERROR("No outputs are specified.");
+  const Graph *g = outputs[0].graph();
+  for (const vector<Node> *nodes : {&inputs, &outputs}) {
+    for (const Node &node : *nodes) {
+      if (!g || node.graph() != g) {
+        THROW_ERROR("Nodes should be valid and belong to the same graph.");
+      }
+    }
+  }
+
+  // Marks inputs and functions required by outputs.
+  const unsigned num_funcs = g->funcs_.size();
+  vector<int> ids(num_funcs, -1);
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    int &id = ids[inputs[i].function_id()];
+    if (id >= 0) {
+      THROW_ERROR("Input nodes should be different. index: " << i);
+    }
+    id = i;
+  }
+  vector<bool> required(num_funcs, false);
+  vector<unsigned> stack;
+  for (const Node &node : outputs) stack.emplace_back(node.function_id());
+  while (!stack.empty()) {
+    const unsigned fid = stack.back();
+    stack.pop_back();
+    if (ids[fid] >= 0 || required[fid]) continue;
+    required[fid] = true;
+    for (const Graph::Address &arg : g->funcs_[fid].args) {
+      stack.emplace_back(arg.fid);
+    }
+  }
+
+  // Writes functions in the order of IDs, which is a topological order.
+  vector<const Parameter *> params;
+  std::ostringstream funcs_os;
+  BinaryWriter funcs(funcs_os);
+  unsigned num_steps = 0;
+  for (unsigned fid = 0; fid < num_funcs; ++fid) {
+    if (!required[fid]) continue;
+    const Graph::FunctionInfo &f = g->funcs_[fid];
+    if (!f.func->write_attributes(funcs, params)) {
+      THROW_ERROR(
+          "Function can not be exported to the plan: " << f.func->name());
+    }
+    funcs.write<std::uint32_t>(f.args.size());
+    for (const Graph::Address &arg : f.args) {
+      funcs.write<std::uint32_t>(ids[arg.fid]);
+    }
+    ids[fid] = inputs.size() + num_steps++;
+  }
+
+  std::ostringstream os;
+  BinaryWriter writer(os);
+  writer.write_string(::PLAN_MAGIC);
+  writer.write<std::uint32_t>(::PLAN_VERSION);
+  writer.write<std::uint32_t>(params.size());
+  for (const Parameter *p : params) {
+    writer.write_string(p->name());
+    ::write_tensor(writer, p->value());
+    const vector<string> names = p->stats_names();
+    writer.write<std::uint32_t>(names.size());
+    for (const string &name : names) {
+      writer.write_string(name);
+      ::write_tensor(writer, p->stats(name));
+    }
+  }
+  writer.write<std::uint32_t>(inputs.size());
+  for (const Node &node : inputs) writer.write_shape(node.shape());
+  writer.write<std::uint32_t>(num_steps);
+  const string funcs_data = funcs_os.str();
+  writer.write_block(funcs_data.data(), funcs_data.size());
+  writer.write<std::uint32_t>(outputs.size());
+  for (const Node &node : outputs) {
+    writer.write<std::uint32_t>(ids[node.function_id()]);
+  }
+
+  data_ = os.str();
+  parse();
+}
+
+InferencePlan::InferencePlan(const string &path, Device *device)
+: device_(device) {
+  const MappedFile file(path);
+  data_.assign(file.data(), file.size());
+  parse();
+}
+
+InferencePlan::~InferencePlan() {
+  // Functions are destroyed before parameters referred by them.
+  steps_.clear();
+}
+
+void InferencePlan::save(const string &path) const {
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs.is_open()) THROW_ERROR("Could not open file: " << path);
+  BinaryWriter writer(ofs);
+  writer.write_block(data_.data(), data_.size());
+}
+
+void InferencePlan::parse() {
+  BinaryReader reader(data_.data(), data_.size());
+  if (reader.read_string() != ::PLAN_MAGIC) {
+    THROW_ERROR("Data is not an inference plan.");
+  }
+  const std::uint32_t version = reader.read<std::uint32_t>();
+  if (version != ::PLAN_VERSION) {
+    THROW_ERROR("Unsupported version of the inference plan: " << version);
+  }
+
+  // NOTE(odashi):
+  // All parameters are made before functions because functions refer them
+  // by pointers.
+  const unsigned num_params = reader.read<std::uint32_t>();
+  params_.reserve(num_params);
+  for (unsigned i = 0; i < num_params; ++i) {
+    const string name = reader.read_string();
+    const Shape shape = reader.read_shape();
+    params_.emplace_back(name, shape, ::read_values(reader, shape), device_);
+    const unsigned num_stats = reader.read<std::uint32_t>();
+    for (unsigned j = 0; j < num_stats; ++j) {
+      const string key = reader.read_string();
+      const Shape s = reader.read_shape();
+      params_.back().add_stats(key, s);
+      params_.back().stats(key).reset_by_vector(::read_values(reader, s));
+    }
+  }
+
+  const unsigned num_inputs = reader.read<std::uint32_t>();
+  for (unsigned i = 0; i < num_inputs; ++i) {
+    input_shapes_.emplace_back(reader.read_shape());
+  }
+
+  const unsigned num_steps = reader.read<std::uint32_t>();
+  steps_.reserve(num_steps);
+  for (unsigned i = 0; i < num_steps; ++i) {
+    std::unique_ptr<Function> func(read_function(reader));
+    vector<unsigned> args(reader.read<std::uint32_t>());
+    for (unsigned &arg : args) {
+      arg = reader.read<std::uint32_t>();
+      if (arg >= num_inputs + i) {
+        THROW_ERROR("Invalid argument of the function in the plan: " << arg);
+      }
+    }
+    steps_.push_back(Step {std::move(func), std::move(args)});
+  }
+
+  outputs_.resize(reader.read<std::uint32_t>());
+  for (unsigned &output : outputs_) {
+    output = reader.read<std::uint32_t>();
+    if (output >= num_inputs + num_steps) {
+      THROW_ERROR("Invalid output of the plan: " << output);
+    }
+  }
+  if (reader.position() != data_.size()) {
+    THROW_ERROR("Unexpected data at the end of the plan.");
+  }
+}
+
+Function *InferencePlan::read_function(BinaryReader &reader) const {
+  const string type = reader.read_string();
+  const auto param = [&]() -> Parameter * {
+    const std::uint32_t index = reader.read<std::uint32_t>();
+    if (index >= params_.size()) {
+      THROW_ERROR("Invalid parameter index in the plan: " << index);
+    }
+    // The plan never updates parameters.
+    return const_cast<Parameter *>(&params_[index]);
+  };
+  const auto u32 = [&] { return reader.read<std::uint32_t>(); };
+
+  if (type == "Input") {
+    const Shape shape = reader.read_shape();
+    return new F::Input(shape, ::read_values(reader, shape), device_);
+  }
+  if (type == "ParameterInput") return new F::ParameterInput(param());
+  if (type == "Lookup") {
+    Parameter *p = param();
+    const unsigned dim = u32();
+    return new F::Lookup(p, dim, ::read_ids(reader));
+  }
+  if (type == "Constant") {
+    const Shape shape = reader.read_shape();
+    return new F::Constant(shape, reader.read<float>(), device_);
+  }
+  if (type == "Pick" || type == "Gather") {
+    const unsigned dim = u32();
+    const vector<unsigned> ids = ::read_ids(reader);
+    if (type == "Pick") return new F::Pick(dim, ids);
+    return new F::Gather(dim, ids);
+  }
+  if (type == "BatchPick") return new F::BatchPick(::read_ids(reader));
+  if (type == "Slice") {
+    const unsigned dim = u32();
+    const unsigned lower = u32();
+    return new F::Slice(dim, lower, u32());
+  }
+  if (type == "Reshape") return new F::Reshape(reader.read_shape());
+  if (type == "Broadcast") {
+    const unsigned dim = u32();
+    return new F::Broadcast(dim, u32());
+  }
+  if (type == "Affine") {
+    return new F::Affine(static_cast<Device::Activation>(u32()));
+  }
+  if (type == "BatchNormalize") {
+    Parameter *p = param();
+    return new F::BatchNormalize(p, false, 0, reader.read<float>());
+  }
+
+#define READ_DIM(name) \
+  if (type == #name) return new F::name(u32())
+  READ_DIM(Concat);
+  READ_DIM(Sum);
+  READ_DIM(LogSumExp);
+  READ_DIM(LogSoftmax);
+  READ_DIM(Softmax);
+  READ_DIM(SoftmaxCrossEntropy);
+#undef READ_DIM
+
+#define READ_CONST(name) \
+  if (type == #name) return new F::name(reader.read<float>())
+  READ_CONST(AddConst);
+  READ_CONST(SubtractConstR);
+  READ_CONST(SubtractConstL);
+  READ_CONST(MultiplyConst);
+  READ_CONST(DivideConstR);
+  READ_CONST(DivideConstL);
+  READ_CONST(PReLU);
+  READ_CONST(ELU);
+#undef READ_CONST
+
+#define READ_TYPE(name) \
+  if (type == #name) return new F::name()
+  READ_TYPE(Flatten);
+  READ_TYPE(Positive);
+  READ_TYPE(Negative);
+  READ_TYPE(AddScalar);
+  READ_TYPE(SubtractScalarR);
+  READ_TYPE(SubtractScalarL);
+  READ_TYPE(MultiplyScalar);
+  READ_TYPE(DivideScalarR);
+  READ_TYPE(DivideScalarL);
+  READ_TYPE(Add);
+  READ_TYPE(Subtract);
+  READ_TYPE(Multiply);
+  READ_TYPE(Divide);
+  READ_TYPE(Transpose);
+  READ_TYPE(MatrixMultiply);
+  READ_TYPE(LSTMCell);
+  READ_TYPE(LSTM);
+  READ_TYPE(Sqrt);
+  READ_TYPE(Exp);
+  READ_TYPE(Tanh);
+  READ_TYPE(Sigmoid);
+  READ_TYPE(Softplus);
+  READ_TYPE(Sin);
+  READ_TYPE(Cos);
+  READ_TYPE(Tan);
+  READ_TYPE(ReLU);
+  READ_TYPE(LReLU);
+  READ_TYPE(BatchSum);
+#undef READ_TYPE
+
+  THROW_ERROR("Unknown function in the plan: " << type);
+}
+
+std::unique_ptr<InferencePlan::Layout> InferencePlan::make_layout(
+    Context &ctx) const {
+  const unsigned num_inputs = input_shapes_.size();
+  const unsigned num_steps = steps_.size();
+  std::unique_ptr<Layout> layout(new Layout());
+  for (unsigned i = 0; i < num_inputs; ++i) {
+    layout->input_shapes.emplace_back(ctx.values[i].shape());
+  }
+
+  // Outputs are never released.
+  vector<unsigned> &last_uses = layout->last_uses;
+  last_uses.assign(num_inputs + num_steps, 0);
+  for (unsigned i = 0; i < num_steps; ++i) {
+    last_uses[num_inputs + i] = i;
+    for (const unsigned arg : steps_[i].args) last_uses[arg] = i;
+  }
+  for (const unsigned output : outputs_) last_uses[output] = num_steps;
+
+  // Calculates all steps, and finds the value owning the memory of each
+  // result, because some functions return views of their arguments.
+  vector<unsigned> owners(num_inputs + num_steps);
+  for (unsigned i = 0; i < num_inputs; ++i) owners[i] = i;
+  layout->sizes.resize(num_steps);
+  for (unsigned i = 0; i < num_steps; ++i) {
+    const Step &step = steps_[i];
+    const unsigned id = num_inputs + i;
+    ctx.args.clear();
+    for (const unsigned arg : step.args) {
+      ctx.args.emplace_back(&ctx.values[arg]);
+    }
+    Tensor &y = ctx.values[id] = step.func->forward(ctx.args);
+    layout->sizes[i] = y.shape().size();
+    owners[id] = id;
+    const char *p = static_cast<const char *>(
+        static_cast<const Tensor &>(y).data());
+    for (const unsigned arg : step.args) {
+      const Tensor &x = ctx.values[arg];
+      const char *begin = static_cast<const char *>(x.data());
+      if (begin <= p && p < begin + sizeof(float) * x.shape().size()) {
+        owners[id] = owners[arg];
+        break;
+      }
+    }
+    for (const unsigned arg : step.args) {
+      if (last_uses[arg] == i) ctx.values[arg] = Tensor();
+    }
+  }
+
+  // The memory of each owner is used until all its views are released.
+  vector<unsigned> owner_last_uses(num_inputs + num_steps, 0);
+  for (unsigned i = 0; i < num_inputs + num_steps; ++i) {
+    unsigned &u = owner_last_uses[owners[i]];
+    u = std::max(u, last_uses[i]);
+  }
+
+  // Assigns memory blocks by the first fit.
+  struct Block { std::uint64_t offset, size; unsigned last_use; };
+  vector<Block> used, unused;
+  std::uint64_t top = 0;
+  layout->offsets.assign(num_steps, -1);
+  for (unsigned i = 0; i < num_steps; ++i) {
+    for (auto it = used.begin(); it != used.end(); ) {
+      if (it->last_use < i) {
+        unused.push_back(*it);
+        it = used.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    const unsigned id = num_inputs + i;
+    if (owners[id] != id || owner_last_uses[id] >= num_steps) continue;
+    const std::uint64_t a = Graph::PLAN_ALIGNMENT;
+    const std::uint64_t size =
+      (sizeof(float) * layout->sizes[i] + a - 1) / a * a;
+
+    // Merges adjacent unused blocks before searching.
+    std::sort(unused.begin(), unused.end(),
+        [](const Block &l, const Block &r) { return l.offset < r.offset; });
+    vector<Block> merged;
+    for (const Block &u : unused) {
+      if (!merged.empty() &&
+          merged.back().offset + merged.back().size == u.offset) {
+        merged.back().size += u.size;
+      } else {
+        merged.push_back(u);
+      }
+    }
+    unused.swap(merged);
+
+    Block b {top, size, owner_last_uses[id]};
+    const auto it = std::find_if(unused.begin(), unused.end(),
+        [size](const Block &u) { return u.size >= size; });
+    if (it != unused.end()) {
+      b.offset = it->offset;
+      it->offset += size;
+      it->size -= size;
+      if (it->size == 0) unused.erase(it);
+    } else {
+      top += size;
+    }
+    layout->offsets[i] = b.offset / sizeof(float);
+    used.push_back(b);
+  }
+  layout->workspace_size = top;
+  return layout;
+}
+
+void InferencePlan::calculate(const Layout &layout, Context &ctx) const {
+  const unsigned num_inputs = input_shapes_.size();
+  const Tensor &ws = ctx.workspace;
+  float *base = ws.valid()
+    ? static_cast<float *>(const_cast<void *>(ws.data())) : nullptr;
+  for (unsigned i = 0; i < steps_.size(); ++i) {
+    const Step &step = steps_[i];
+    ctx.args.clear();
+    for (const unsigned arg : step.args) {
+      ctx.args.emplace_back(&ctx.values[arg]);
+    }
+    const bool placed = layout.offsets[i] >= 0;
+    if (placed) {
+      // NOTE(odashi):
+      // Each handle has its own owner so that the result is not copied on
+      // write.
+      device_->place_next_tensor(
+          std::shared_ptr<void>(base + layout.offsets[i], [ws](void *) {}),
+          layout.sizes[i]);
+    }
+    try {
+      ctx.values[num_inputs + i] = step.func->forward(ctx.args);
+    } catch (...) {
+      if (placed) device_->cancel_placement();
+      throw;
+    }
+    if (placed) device_->cancel_placement();
+    for (const unsigned arg : step.args) {
+      if (layout.last_uses[arg] == i) ctx.values[arg] = Tensor();
+    }
+  }
+}
+
+vector<Tensor> InferencePlan::run(const vector<Tensor> &inputs) {
+  if (inputs.size() != input_shapes_.size()) {
+    THROW_ERROR(
+        "Number of inputs mismatched. required: " << input_shapes_.size()
+        << " != actual: " << inputs.size());
+  }
+  for (const Tensor &x : inputs) {
+    if (!x.valid() || x.device() != device_) {
+      THROW_ERROR("Inputs should be valid tensors on the device of the plan.");
+    }
+  }
+
+  // Finds the layout for the input shapes and one of its unused contexts.
+  const auto matches = [&](const Layout &layout) {
+    for (unsigned i = 0; i < inputs.size(); ++i) {
+      if (layout.input_shapes[i] != inputs[i].shape()) return false;
+    }
+    return true;
+  };
+  const Layout *layout = nullptr;
+  unsigned layout_id = 0;
+  std::unique_ptr<Context> ctx;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (unsigned i = 0; i < layouts_.size(); ++i) {
+      if (matches(*layouts_[i])) {
+        layout = layouts_[i].get();
+        layout_id = i;
+        vector<std::unique_ptr<Context>> &free = free_contexts_[i];
+        if (!free.empty()) {
+          ctx = std::move(free.back());
+          free.pop_back();
+        }
+        break;
+      }
+    }
+  }
+  if (!ctx) ctx.reset(new Context());
+  ctx->values.assign(inputs.begin(), inputs.end());
+  ctx->values.resize(inputs.size() + steps_.size());
+
+  if (layout) {
+    if (!ctx->workspace.valid() && layout->workspace_size > 0) {
+      const std::uint64_t size = layout->workspace_size / sizeof(float);
+      if (size > std::numeric_limits<unsigned>::max()) {
+        THROW_ERROR(
+            "Workspace exceeds the size limit of Shape. size: " << size);
+      }
+      ctx->workspace = device_->new_tensor(
+          Shape({static_cast<unsigned>(size)}));
+    }
+    calculate(*layout, *ctx);
+  } else {
+    std::unique_ptr<Layout> new_layout = make_layout(*ctx);
+    std::lock_guard<std::mutex> lock(mutex_);
+    layout_id = std::find_if(layouts_.begin(), layouts_.end(),
+        [&](const std::unique_ptr<Layout> &l) { return matches(*l); })
+      - layouts_.begin();
+    if (layout_id == layouts_.size()) {
+      layouts_.emplace_back(std::move(new_layout));
+      free_contexts_.emplace_back();
+    }
+  }
+
+  vector<Tensor> ret;
+  ret.reserve(outputs_.size());
+  for (const unsigned output : outputs_) ret.emplace_back(ctx->values[output]);
+  for (Tensor &x : ctx->values) x = Tensor();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_contexts_[layout_id].emplace_back(std::move(ctx));
+  }
+  return ret;
+}
+
+std::uint64_t InferencePlan::workspace_size(
+    const vector<Shape> &shapes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::unique_ptr<Layout> &layout : layouts_) {
+    if (layout->input_shapes == shapes) return layout->workspace_size;
+  }
+  return 0;
+}
+
+}  // namespace primitiv
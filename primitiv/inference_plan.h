@@ -0,0 +1,198 @@
+#ifndef PRIMITIV_INFERENCE_PLAN_H_
+#define PRIMITIV_INFERENCE_PLAN_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <primitiv/function.h>
+#include <primitiv/node.h>
+#include <primitiv/parameter.h>
+#include <primitiv/shape.h>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class BinaryReader;
+class Device;
+
+/**
+ * Forward computation traced from a graph, which can be saved to a file and
+ * calculated without constructing `Graph`.
+ *
+ * The plan owns copies of all functions and parameters. Shapes and the memory
+ * layout of intermediate values are calculated by the first call of `run()`
+ * for each combination of input shapes, and succeeding calls with the same
+ * shapes store intermediate values in a preallocated workspace.
+ */
+class InferencePlan {
+  InferencePlan() = delete;
+  InferencePlan(const InferencePlan &) = delete;
+  InferencePlan(InferencePlan &&) = delete;
+  InferencePlan &operator=(const InferencePlan &) = delete;
+  InferencePlan &operator=(InferencePlan &&) = delete;
+
+public:
+  /**
+   * Traces the functions required to calculate `outputs` from `inputs`.
+   * @param inputs Nodes whose values are given to `run()`. Functions
+   *               calculating these nodes are not traced.
+   * @param outputs Nodes whose values are returned by `run()`. All nodes
+   *                should belong to the same graph.
+   * @param device Device to calculate the plan.
+   * @remarks Values of parameters and constant inputs (e.g., nodes made by
+   *          `node_ops::input()`) are copied into the plan. Functions which
+   *          do not support `Function::write_attributes()` (e.g., random
+   *          numbers, copies between devices and normalizations in the
+   *          training mode) can not be traced.
+   */
+  InferencePlan(
+      const std::vector<Node> &inputs, const std::vector<Node> &outputs,
+      Device *device);
+
+  /**
+   * Loads the plan saved by `save()`.
+   * @param path File path of the plan.
+   * @param device Device to calculate the plan.
+   */
+  InferencePlan(const std::string &path, Device *device);
+
+  ~InferencePlan();
+
+  /**
+   * Saves the plan.
+   * @param path File path to write the plan.
+   */
+  void save(const std::string &path) const;
+
+  /**
+   * Retrieves the number of inputs.
+   * @return Number of inputs.
+   */
+  unsigned num_inputs() const { return input_shapes_.size(); }
+
+  /**
+   * Retrieves the number of outputs.
+   * @return Number of outputs.
+   */
+  unsigned num_outputs() const { return outputs_.size(); }
+
+  /**
+   * Retrieves the number of functions in the plan.
+   * @return Number of functions.
+   */
+  unsigned num_functions() const { return steps_.size(); }
+
+  /**
+   * Retrieves the shape of an input when the plan was traced.
+   * @param index Index of the input.
+   * @return Shape of the input.
+   * @remarks `run()` accepts other shapes (e.g., other minibatch sizes) if
+   *          all functions accept them.
+   */
+  const Shape &input_shape(unsigned index) const {
+    return input_shapes_.at(index);
+  }
+
+  /**
+   * Retrieves the device of the plan.
+   * @return Device object.
+   */
+  Device *device() const { return device_; }
+
+  /**
+   * Calculates the outputs.
+   * @param inputs Values of inputs on `device()`.
+   * @return Values of outputs, which never share the memory with the
+   *         workspaces of the plan.
+   * @remarks This function can be called by multiple threads concurrently.
+   *          Each concurrent call uses its own workspace, and kernels of calls
+   *          are issued to the device in any order.
+   */
+  std::vector<Tensor> run(const std::vector<Tensor> &inputs);
+
+  /**
+   * Retrieves the size of the workspace used by `run()` with given inputs.
+   * @param shapes Shapes of inputs.
+   * @return Size of each workspace in bytes, or 0 if no call of `run()` with
+   *         these shapes has finished yet.
+   */
+  std::uint64_t workspace_size(const std::vector<Shape> &shapes) const;
+
+private:
+  /**
+   * Function in the plan. Arguments are indices of values, where the first
+   * `num_inputs()` values are inputs and the (num_inputs() + i)-th value is
+   * the result of the i-th step.
+   */
+  struct Step {
+    std::unique_ptr<Function> func;
+    std::vector<unsigned> args;
+  };
+
+  /**
+   * Memory layout for a combination of input shapes.
+   */
+  struct Layout {
+    std::vector<Shape> input_shapes;
+
+    // Last step using each value.
+    std::vector<unsigned> last_uses;
+
+    // Offset of each step in elements, or -1 if the result is not placed.
+    std::vector<std::int64_t> offsets;
+    std::vector<unsigned> sizes;
+    std::uint64_t workspace_size;
+  };
+
+  /**
+   * Resources used by one call of `run()`.
+   */
+  struct Context {
+    Tensor workspace;
+    std::vector<Tensor> values;
+    std::vector<const Tensor *> args;
+  };
+
+  /**
+   * Reads the plan from `data_`.
+   */
+  void parse();
+
+  /**
+   * Reads a function from the plan.
+   * @param reader Reader of the plan.
+   * @return A new function object.
+   */
+  Function *read_function(BinaryReader &reader) const;
+
+  /**
+   * Calculates all steps without the workspace and makes the layout.
+   * @param ctx Context of the call. `ctx.values` holds inputs.
+   * @return Layout of the calculation.
+   */
+  std::unique_ptr<Layout> make_layout(Context &ctx) const;
+
+  /**
+   * Calculates all steps using the layout.
+   * @param layout Layout of the calculation.
+   * @param ctx Context of the call. `ctx.values` holds inputs.
+   */
+  void calculate(const Layout &layout, Context &ctx) const;
+
+  Device *device_;
+  std::string data_;
+  std::vector<Parameter> params_;
+  std::vector<Shape> input_shapes_;
+  std::vector<Step> steps_;
+  std::vector<unsigned> outputs_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Layout>> layouts_;
+  std::vector<std::vector<std::unique_ptr<Context>>> free_contexts_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_INFERENCE_PLAN_H_
@@ -0,0 +1,69 @@
+#ifndef PRIMITIV_MEMORY_POOL_STATS_H_
+#define PRIMITIV_MEMORY_POOL_STATS_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Snapshot of the usage of a memory pool.
+ */
+struct MemoryPoolStats {
+  /**
+   * Total size of the blocks currently supplied to users, in bytes.
+   */
+  std::uint64_t bytes_in_use;
+
+  /**
+   * Maximum value of `bytes_in_use` since the pool was created.
+   */
+  std::uint64_t peak_bytes_in_use;
+
+  /**
+   * Total size of the blocks kept in the pool for reuse, in bytes.
+   */
+  std::uint64_t bytes_reserved;
+
+  /**
+   * Number of calls of `allocate()`.
+   */
+  std::uint64_t num_requests;
+
+  /**
+   * Number of requests satisfied by reserved blocks.
+   */
+  std::uint64_t num_hits;
+
+  /**
+   * Number of memory allocations requested to the system (e.g. `cudaMalloc`).
+   */
+  std::uint64_t num_system_allocs;
+
+  /**
+   * Number of times that the pool released reserved blocks and retried the
+   * allocation after the system could not provide memories.
+   */
+  std::uint64_t num_oom_retries;
+
+  /**
+   * `reserved_bytes_by_scale[n]` is the total size of reserved blocks with
+   * 2^n bytes. This value is empty if the pool does not manage blocks by
+   * powers of 2.
+   */
+  std::vector<std::uint64_t> reserved_bytes_by_scale;
+
+  /**
+   * Calculates the ratio of requests satisfied by reserved blocks.
+   * @return Hit rate in [0, 1], or 0 if there were no requests.
+   */
+  double hit_rate() const {
+    return num_requests > 0
+      ? static_cast<double>(num_hits) / num_requests
+      : 0;
+  }
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_MEMORY_POOL_STATS_H_
@@ -1,5 +1,6 @@
 #include <config.h>
 
+#include <algorithm>
 #include <vector>
 #include <primitiv/error.h>
 #include <primitiv/function_impl.h>
@@ -11,138 +12,176 @@
 
 namespace F = primitiv::functions;
 
-#define REG(x) (x).graph()->add_function
+#define REG(x) (x).graph()->emplace_function
 
 namespace primitiv {
 
-Node operator+(const Node &x) { return REG(x)(new F::Positive(), {x}); }
-Node operator-(const Node &x) { return REG(x)(new F::Negative(), {x}); }
-Node operator+(const Node &x, float k) { return REG(x)(new F::AddConst(k), {x}); }
-Node operator+(float k, const Node &x) { return REG(x)(new F::AddConst(k), {x}); }
+Node operator+(const Node &x) { return REG(x)<F::Positive>({x}); }
+Node operator-(const Node &x) { return REG(x)<F::Negative>({x}); }
+Node operator+(const Node &x, float k) { return REG(x)<F::AddConst>({x}, k); }
+Node operator+(float k, const Node &x) { return REG(x)<F::AddConst>({x}, k); }
 
 Node operator+(const Node &a, const Node &b) {
-  if (a.shape().is_scalar()) return REG(a)(new F::AddScalar(), {b, a});
-  else if (b.shape().is_scalar()) return REG(a)(new F::AddScalar(), {a, b});
-  else return REG(a)(new F::Add(), {a, b});
+  if (a.shape().is_scalar()) return REG(a)<F::AddScalar>({b, a});
+  else if (b.shape().is_scalar()) return REG(a)<F::AddScalar>({a, b});
+  else return REG(a)<F::Add>({a, b});
 }
 
-Node operator-(const Node &x, float k) { return REG(x)(new F::SubtractConstR(k), {x}); }
-Node operator-(float k, const Node &x) { return REG(x)(new F::SubtractConstL(k), {x}); }
+Node operator-(const Node &x, float k) { return REG(x)<F::SubtractConstR>({x}, k); }
+Node operator-(float k, const Node &x) { return REG(x)<F::SubtractConstL>({x}, k); }
 
 Node operator-(const Node &a, const Node &b) {
-  if (a.shape().is_scalar()) return REG(a)(new F::SubtractScalarL(), {b, a});
-  else if (b.shape().is_scalar()) return REG(a)(new F::SubtractScalarR(), {a, b});
-  else return REG(a)(new F::Subtract(), {a, b});
+  if (a.shape().is_scalar()) return REG(a)<F::SubtractScalarL>({b, a});
+  else if (b.shape().is_scalar()) return REG(a)<F::SubtractScalarR>({a, b});
+  else return REG(a)<F::Subtract>({a, b});
 }
 
-Node operator*(const Node &x, float k) { return REG(x)(new F::MultiplyConst(k), {x}); }
-Node operator*(float k, const Node &x) { return REG(x)(new F::MultiplyConst(k), {x}); }
+Node operator*(const Node &x, float k) { return REG(x)<F::MultiplyConst>({x}, k); }
+Node operator*(float k, const Node &x) { return REG(x)<F::MultiplyConst>({x}, k); }
 
 Node operator*(const Node &a, const Node &b) {
-  if (a.shape().is_scalar()) return REG(a)(new F::MultiplyScalar(), {b, a});
-  else if (b.shape().is_scalar()) return REG(a)(new F::MultiplyScalar(), {a, b});
-  else return REG(a)(new F::Multiply(), {a, b});
+  if (a.shape().is_scalar()) return REG(a)<F::MultiplyScalar>({b, a});
+  else if (b.shape().is_scalar()) return REG(a)<F::MultiplyScalar>({a, b});
+  else return REG(a)<F::Multiply>({a, b});
 }
 
 
-Node operator/(const Node &x, float k) { return REG(x)(new F::DivideConstR(k), {x}); }
-Node operator/(float k, const Node &x) { return REG(x)(new F::DivideConstL(k), {x}); }
+Node operator/(const Node &x, float k) { return REG(x)<F::DivideConstR>({x}, k); }
+Node operator/(float k, const Node &x) { return REG(x)<F::DivideConstL>({x}, k); }
 
 Node operator/(const Node &a, const Node &b) {
-  if (a.shape().is_scalar()) return REG(a)(new F::DivideScalarL(), {b, a});
-  else if (b.shape().is_scalar()) return REG(a)(new F::DivideScalarR(), {a, b});
-  else return REG(a)(new F::Divide(), {a, b});
+  if (a.shape().is_scalar()) return REG(a)<F::DivideScalarL>({b, a});
+  else if (b.shape().is_scalar()) return REG(a)<F::DivideScalarR>({a, b});
+  else return REG(a)<F::Divide>({a, b});
 }
 
 namespace node_ops {
 
 Node input(const Shape &shape, const std::vector<float> &data, Device *dev, Graph *g) {
-  return g->add_function(new F::Input(shape, data, dev), {});
+  return g->emplace_function<F::Input>({}, shape, data, dev);
 }
 
 Node input(Parameter *param, Graph *g) {
-  return g->add_function(new F::ParameterInput(param), {});
+  return g->emplace_function<F::ParameterInput>({}, param);
+}
+
+Node input(const Tensor &x, Graph *g) {
+  return g->emplace_function<F::TensorInput>({}, x);
+}
+
+Node input(
+    const Shape &shape, const float *data, std::shared_ptr<const void> guard,
+    Device *dev, Graph *g) {
+  return g->emplace_function<F::HostInput>(
+      {}, shape, data, std::move(guard), dev);
+}
+
+Node lookup(
+    Parameter *param, unsigned dim, const std::vector<unsigned> &ids,
+    Graph *g) {
+  return g->emplace_function<F::Lookup>({}, param, dim, ids);
 }
 
 Node copy(const Node &x, Device *dev) {
-  return REG(x)(new F::Copy(dev), {x});
+  return REG(x)<F::Copy>({x}, dev);
 }
 
 Node pick(const Node &x, unsigned dim, const std::vector<unsigned> &ids) {
-  return REG(x)(new F::Pick(dim, ids), {x});
+  return REG(x)<F::Pick>({x}, dim, ids);
+}
+
+Node gather(const Node &x, unsigned dim, const std::vector<unsigned> &ids) {
+  return REG(x)<F::Gather>({x}, dim, ids);
 }
 
 Node slice(const Node &x, unsigned dim, unsigned lower, unsigned upper) {
-  return REG(x)(new F::Slice(dim, lower, upper), {x});
+  return REG(x)<F::Slice>({x}, dim, lower, upper);
 }
 
 Node concat(const std::vector<Node> &xs, unsigned dim) {
   if (xs.empty()) THROW_ERROR("No nodes to concat.");
-  return REG(xs[0])(new F::Concat(dim), xs);
+  return REG(xs[0])<F::Concat>(xs, dim);
 }
 
 Node reshape(const Node &x, const Shape &shape) {
-  return REG(x)(new F::Reshape(shape), {x});
+  return REG(x)<F::Reshape>({x}, shape);
 }
 
 Node flatten(const Node &x) {
-  return REG(x)(new F::Flatten(), {x});
+  return REG(x)<F::Flatten>({x});
 }
 
 Node transpose(const Node &x) {
-  return REG(x)(new F::Transpose(), {x});
+  return REG(x)<F::Transpose>({x});
 }
 
 Node matmul(const Node &a, const Node &b) {
-  return REG(a)(new F::MatrixMultiply(), {a, b});
+  return REG(a)<F::MatrixMultiply>({a, b});
+}
+
+Node matmul(const QuantizedParameter &w, const Node &x) {
+  return REG(x)<F::QuantizedMatrixMultiply>({x}, &w);
+}
+
+Node affine(
+    const Node &w, const Node &x, const Node &b, Device::Activation act) {
+  return REG(w)<F::Affine>({w, x, b}, act);
+}
+
+Node lstm_cell(const Node &u, const Node &c) {
+  return REG(u)<F::LSTMCell>({u, c});
+}
+
+Node lstm(const Node &xu, const Node &wh, const Node &h0, const Node &c0) {
+  return REG(xu)<F::LSTM>({xu, wh, h0, c0});
 }
 
 Node sqrt(const Node &x) {
-  return REG(x)(new F::Sqrt(), {x});
+  return REG(x)<F::Sqrt>({x});
 }
 
 Node exp(const Node &x) {
-  return REG(x)(new F::Exp(), {x});
+  return REG(x)<F::Exp>({x});
 }
 
 Node tanh(const Node &x) {
-  return REG(x)(new F::Tanh(), {x});
+  return REG(x)<F::Tanh>({x});
 }
 
 Node sigmoid(const Node &x) {
-  return REG(x)(new F::Sigmoid(), {x});
+  return REG(x)<F::Sigmoid>({x});
 }
 
 Node softplus(const Node &x) {
-  return REG(x)(new F::Softplus(), {x});
+  return REG(x)<F::Softplus>({x});
 }
 
 Node sin(const Node &x) {
-  return REG(x)(new F::Sin(), {x});
+  return REG(x)<F::Sin>({x});
 }
 
 Node cos(const Node &x) {
-  return REG(x)(new F::Cos(), {x});
+  return REG(x)<F::Cos>({x});
 }
 
 Node tan(const Node &x) {
-  return REG(x)(new F::Tan(), {x});
+  return REG(x)<F::Tan>({x});
 }
 
 Node relu(const Node &x) {
-  return REG(x)(new F::ReLU(), {x});
+  return REG(x)<F::ReLU>({x});
 }
 
 Node lrelu(const Node &x) {
-  return REG(x)(new F::LReLU(), {x});
+  return REG(x)<F::LReLU>({x});
 }
 
 Node prelu(const Node &x, float a) {
-  return REG(x)(new F::PReLU(a), {x});
+  return REG(x)<F::PReLU>({x}, a);
 }
 
 Node elu(const Node &x, float a) {
-  return REG(x)(new F::ELU(a), {x});
+  return REG(x)<F::ELU>({x}, a);
 }
 
 Node selu(const Node &x, float a, float s) {
@@ -150,7 +189,7 @@ Node selu(const Node &x, float a, float s) {
 }
 
 Node sum(const Node &x, unsigned dim) {
-  return REG(x)(new F::Sum(dim), {x});
+  return REG(x)<F::Sum>({x}, dim);
 }
 
 Node sum(const std::vector<Node> &xs) {
@@ -169,27 +208,45 @@ Node mean(const std::vector<Node> &xs) {
 }
 
 Node logsumexp(const Node &x, unsigned dim) {
-  return REG(x)(new F::LogSumExp(dim), {x});
+  return REG(x)<F::LogSumExp>({x}, dim);
 }
 
 Node log_softmax(const Node &x, unsigned dim) {
-  return x - broadcast(logsumexp(x, dim), dim, x.shape()[dim]);
+  return REG(x)<F::LogSoftmax>({x}, dim);
 }
 
 Node softmax(const Node &x, unsigned dim) {
-  return exp(log_softmax(x, dim));
+  return REG(x)<F::Softmax>({x}, dim);
 }
 
 Node broadcast(const Node &x, unsigned dim, unsigned size) {
-  return REG(x)(new F::Broadcast(dim, size), {x});
+  return REG(x)<F::Broadcast>({x}, dim, size);
 }
 
 Node softmax_cross_entropy(const Node &x, const Node &t, unsigned dim) {
-  return REG(x)(new F::SoftmaxCrossEntropy(dim), {x, t});
+  return REG(x)<F::SoftmaxCrossEntropy>({x, t}, dim);
 }
 
 Node softmax_cross_entropy(const Node &x, unsigned dim, const std::vector<unsigned> &ids) {
-  return REG(x)(new F::SparseSoftmaxCrossEntropy(dim, ids), {x});
+  return REG(x)<F::SparseSoftmaxCrossEntropy>({x}, dim, ids);
+}
+
+Node sampled_softmax_cross_entropy(
+    const Node &w, const Node &b, const Node &h,
+    const std::vector<unsigned> &ids, const std::vector<unsigned> &samples) {
+  // Logits are calculated only for the union of targets and samples, and each
+  // target is located in the candidates.
+  std::vector<unsigned> cands(ids);
+  cands.insert(cands.end(), samples.begin(), samples.end());
+  std::sort(cands.begin(), cands.end());
+  cands.erase(std::unique(cands.begin(), cands.end()), cands.end());
+  std::vector<unsigned> pos;
+  for (const unsigned id : ids) {
+    pos.emplace_back(
+        std::lower_bound(cands.begin(), cands.end(), id) - cands.begin());
+  }
+  const Node logits = matmul(gather(w, 0, cands), h) + gather(b, 0, cands);
+  return softmax_cross_entropy(logits, 0, pos);
 }
 
 Node dropout(const Node &x, float rate, bool enabled) {
@@ -202,52 +259,57 @@ Node dropout(const Node &x, float rate, bool enabled) {
 namespace batch {
 
 Node sum(const Node &x) {
-  return REG(x)(new F::BatchSum(), {x});
+  return REG(x)<F::BatchSum>({x});
 }
 
 Node mean(const Node &x) {
   return (1. / x.shape().batch()) * sum(x);
 }
 
+Node pick(const Node &x, const std::vector<unsigned> &ids) {
+  return REG(x)<F::BatchPick>({x}, ids);
+}
+
 Node normalize(const Node &x) {
   if (!x.shape().has_batch()) return x;  // No meaning of normalization.
-  const unsigned b = x.shape().batch();
-  const float scale = b / (b - 1.);
-  const Node m = mean(x);
-  const Node v = scale * (mean(x * x) - m * m);
-  return (x - m) / sqrt(v + 1e-8);
+  return REG(x)<F::BatchNormalize>({x}, nullptr, true, 0, 1e-8);
+}
+
+Node normalize(
+    const Node &x, Parameter *stats, bool train, float momentum, float eps) {
+  return REG(x)<F::BatchNormalize>({x}, stats, train, momentum, eps);
 }
 
 }  // namespace batch
 
 Node zeros(const Shape &shape, Device *dev, Graph *g) {
-  return g->add_function(new F::Constant(shape, 0, dev), {});
+  return g->emplace_function<F::Constant>({}, shape, 0, dev);
 }
 
 Node ones(const Shape &shape, Device *dev, Graph *g) {
-  return g->add_function(new F::Constant(shape, 1, dev), {});
+  return g->emplace_function<F::Constant>({}, shape, 1, dev);
 }
 
 Node constant(const Shape &shape, float k, Device *dev, Graph *g) {
-  return g->add_function(new F::Constant(shape, k, dev), {});
+  return g->emplace_function<F::Constant>({}, shape, k, dev);
 }
 
 namespace random {
 
 Node bernoulli(const Shape &shape, float p, Device *dev, Graph *g) {
-  return g->add_function(new F::RandomBernoulli(shape, p, dev), {});
+  return g->emplace_function<F::RandomBernoulli>({}, shape, p, dev);
 }
 
 Node uniform(const Shape &shape, float lower, float upper, Device *dev, Graph *g) {
-  return g->add_function(new F::RandomUniform(shape, lower, upper, dev), {});
+  return g->emplace_function<F::RandomUniform>({}, shape, lower, upper, dev);
 }
 
 Node normal(const Shape &shape, float mean, float sd, Device *dev, Graph *g) {
-  return g->add_function(new F::RandomNormal(shape, mean, sd, dev), {});
+  return g->emplace_function<F::RandomNormal>({}, shape, mean, sd, dev);
 }
 
 Node log_normal(const Shape &shape, float mean, float sd, Device *dev, Graph *g) {
-  return g->add_function(new F::RandomLogNormal(shape, mean, sd, dev), {});
+  return g->emplace_function<F::RandomLogNormal>({}, shape, mean, sd, dev);
 }
 
 }  // namespace random
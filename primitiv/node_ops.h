@@ -1,14 +1,16 @@
 #ifndef PRIMITIV_NODE_OPS_H_
 #define PRIMITIV_NODE_OPS_H_
 
+#include <memory>
 #include <vector>
+#include <primitiv/device.h>
 
 namespace primitiv {
 
-class Device;
 class Graph;
 class Node;
 class Parameter;
+class QuantizedParameter;
 
 Node operator+(const Node &x);
 Node operator-(const Node &x);
@@ -29,9 +31,17 @@ namespace node_ops {
 
 Node input(const Shape &shape, const std::vector<float> &data, Device *dev, Graph *g);
 Node input(Parameter *param, Graph *g);
+Node input(const Tensor &x, Graph *g);
+Node input(
+    const Shape &shape, const float *data, std::shared_ptr<const void> guard,
+    Device *dev, Graph *g);
+Node lookup(
+    Parameter *param, unsigned dim, const std::vector<unsigned> &ids,
+    Graph *g);
 
 Node copy(const Node &x, Device *dev);
 Node pick(const Node &x, unsigned dim, const std::vector<unsigned> &ids);
+Node gather(const Node &x, unsigned dim, const std::vector<unsigned> &ids);
 Node slice(const Node &x, unsigned dim, unsigned lower, unsigned upper);
 Node concat(const std::vector<Node> &xs, unsigned dim);
 
@@ -40,6 +50,12 @@ Node flatten(const Node &x);
 
 Node transpose(const Node &x);
 Node matmul(const Node &a, const Node &b);
+Node matmul(const QuantizedParameter &w, const Node &x);
+Node affine(
+    const Node &w, const Node &x, const Node &b,
+    Device::Activation act = Device::ACTIVATION_IDENTITY);
+Node lstm_cell(const Node &u, const Node &c);
+Node lstm(const Node &xu, const Node &wh, const Node &h0, const Node &c0);
 
 Node sqrt(const Node &x);
 Node exp(const Node &x);
@@ -69,13 +85,20 @@ Node broadcast(const Node &x, unsigned dim, unsigned size);
 
 Node softmax_cross_entropy(const Node &x, const Node &t, unsigned dim);
 Node softmax_cross_entropy(const Node &x, unsigned dim, const std::vector<unsigned> &ids);
+Node sampled_softmax_cross_entropy(
+    const Node &w, const Node &b, const Node &h,
+    const std::vector<unsigned> &ids, const std::vector<unsigned> &samples);
 
 Node dropout(const Node &x, float rate, bool enabled);
 
 namespace batch {
 Node sum(const Node &x);
 Node mean(const Node &x);
+Node pick(const Node &x, const std::vector<unsigned> &ids);
 Node normalize(const Node &x);
+Node normalize(
+    const Node &x, Parameter *stats, bool train,
+    float momentum = 0.1, float eps = 1e-8);
 }  // namespace batch
 
 Node zeros(const Shape &shape, Device *dev, Graph *g);
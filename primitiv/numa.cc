@@ -0,0 +1,156 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <primitiv/error.h>
+#include <primitiv/numa.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+using std::string;
+using std::vector;
+
+namespace {
+
+#ifdef __linux__
+
+// Memory policy of mbind(2) which prefers the given node.
+const int MPOL_PREFERRED_MODE = 1;
+
+// Flag of mbind(2) to move pages which are already allocated.
+const unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+
+const char SYSFS_NODE_DIR[] = "/sys/devices/system/node/";
+
+// Reads the first line of a file, or returns an empty string.
+string read_line(const string &path) {
+  std::ifstream ifs(path);
+  string line;
+  if (ifs) std::getline(ifs, line);
+  return line;
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+namespace primitiv {
+namespace numa {
+
+vector<unsigned> parse_id_list(const string &list) {
+  vector<unsigned> ret;
+  std::stringstream ss(list);
+  string item;
+  while (std::getline(ss, item, ',')) {
+    item.erase(
+        std::remove_if(
+          item.begin(), item.end(), [](char c) { return std::isspace(c); }),
+        item.end());
+    if (item.empty()) continue;
+    const std::size_t dash = item.find('-');
+    char *end;
+    const unsigned long first = std::strtoul(item.c_str(), &end, 10);
+    unsigned long last = first;
+    bool valid = end != item.c_str();
+    if (dash != string::npos) {
+      const char *second = item.c_str() + dash + 1;
+      valid = valid && end == item.c_str() + dash;
+      last = std::strtoul(second, &end, 10);
+      valid = valid && end != second;
+    }
+    if (!valid || *end != '\0' || last < first) {
+      THROW_ERROR("Invalid ID list: '" << list << "'");
+    }
+    for (unsigned long i = first; i <= last; ++i) ret.emplace_back(i);
+  }
+  std::sort(ret.begin(), ret.end());
+  ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+  return ret;
+}
+
+unsigned num_nodes() {
+#ifdef __linux__
+  const string online = ::read_line(string(::SYSFS_NODE_DIR) + "online");
+  if (!online.empty()) {
+    const vector<unsigned> nodes = parse_id_list(online);
+    if (!nodes.empty()) return nodes.back() + 1;
+  }
+#endif  // __linux__
+  return 1;
+}
+
+vector<unsigned> node_cpus(unsigned node) {
+  if (node >= num_nodes()) {
+    THROW_ERROR(
+        "Invalid NUMA node: " << node << ", number of nodes: "
+        << num_nodes());
+  }
+#ifdef __linux__
+  const string cpulist = ::read_line(
+      string(::SYSFS_NODE_DIR) + "node" + std::to_string(node) + "/cpulist");
+  if (!cpulist.empty()) return parse_id_list(cpulist);
+  if (num_nodes() > 1) {
+    THROW_ERROR("Could not obtain processors of the NUMA node: " << node);
+  }
+#endif  // __linux__
+  vector<unsigned> ret(std::max(std::thread::hardware_concurrency(), 1u));
+  for (unsigned i = 0; i < ret.size(); ++i) ret[i] = i;
+  return ret;
+}
+
+bool bind_current_thread(const vector<unsigned> &cpus) {
+#ifdef __linux__
+  ::cpu_set_t mask;
+  CPU_ZERO(&mask);
+  bool any = false;
+  for (const unsigned cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &mask);
+      any = true;
+    }
+  }
+  return any && ::sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif  // __linux__
+}
+
+bool bind_memory(void *ptr, std::uint64_t size, unsigned node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  const unsigned bits = 8 * sizeof(unsigned long);
+  vector<unsigned long> mask(node / bits + 1, 0);
+  mask[node / bits] = 1ul << (node % bits);
+  // NOTE(odashi):
+  // The kernel reads `maxnode - 1` bits of the mask.
+  return ::syscall(
+      SYS_mbind, ptr, static_cast<unsigned long>(size),
+      ::MPOL_PREFERRED_MODE, mask.data(),
+      static_cast<unsigned long>(mask.size() * bits + 1),
+      ::MPOL_MF_MOVE_FLAG) == 0;
+#else
+  static_cast<void>(ptr);
+  static_cast<void>(size);
+  static_cast<void>(node);
+  return false;
+#endif  // defined(__linux__) && defined(SYS_mbind)
+}
+
+std::uint64_t page_size() {
+#ifdef __linux__
+  const long ret = ::sysconf(_SC_PAGESIZE);
+  if (ret > 0) return ret;
+#endif  // __linux__
+  return 4096;
+}
+
+}  // namespace numa
+}  // namespace primitiv
@@ -0,0 +1,67 @@
+#ifndef PRIMITIV_NUMA_H_
+#define PRIMITIV_NUMA_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Utilities to place threads and memories on NUMA nodes.
+ * The topology is obtained from sysfs on Linux. Other systems are treated as
+ * one node which has all processors of the host.
+ */
+namespace numa {
+
+/**
+ * Retrieves the number of NUMA nodes.
+ * @return Number of nodes. Nodes are numbered from 0.
+ */
+unsigned num_nodes();
+
+/**
+ * Retrieves the logical processors which belong to a node.
+ * @param node Node ID.
+ * @return IDs of processors in ascending order.
+ */
+std::vector<unsigned> node_cpus(unsigned node);
+
+/**
+ * Parses a list of IDs written in the sysfs format, e.g., "0-3,8,10-11".
+ * @param list List of IDs.
+ * @return IDs in the list.
+ */
+std::vector<unsigned> parse_id_list(const std::string &list);
+
+/**
+ * Restricts the current thread to run on given processors.
+ * @param cpus IDs of processors.
+ * @return true if the affinity was changed, false otherwise, e.g., the
+ *         system does not support affinities or all processors are
+ *         unavailable for this process.
+ */
+bool bind_current_thread(const std::vector<unsigned> &cpus);
+
+/**
+ * Asks the system to place pages of a memory on a node.
+ * @param ptr Head of the memory. This should be aligned to the page size.
+ * @param size Size of the memory in bytes.
+ * @param node Node ID.
+ * @return true if the policy was applied, false otherwise.
+ * @remarks This is a hint: pages are allocated on other nodes if the node
+ *          has no free memory.
+ */
+bool bind_memory(void *ptr, std::uint64_t size, unsigned node);
+
+/**
+ * Retrieves the page size of the system.
+ * @return Page size in bytes.
+ */
+std::uint64_t page_size();
+
+}  // namespace numa
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_NUMA_H_
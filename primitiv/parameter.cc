@@ -1,10 +1,16 @@
 #include <config.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+#include <utility>
+#include <primitiv/binary_io.h>
 #include <primitiv/device.h>
 #include <primitiv/error.h>
 #include <primitiv/initializer.h>
 #include <primitiv/parameter.h>
+#include <primitiv/shape_ops.h>
 #include <yaml-cpp/yaml.h>
 
 using std::string;
@@ -121,6 +127,65 @@ std::unordered_map<std::string, primitiv::Tensor> parse_tensor_map(
   return tensors;
 }
 
+// Binary format of parameters:
+//   char[8] magic
+//   uint32 version
+//   uint32 dtype (0: float32)
+//   string name
+//   uint32 number of tensors
+//   for each tensor (the value, followed by statistics in the name order):
+//     string key (empty for the value)
+//     uint8 valid
+//     shape
+//     uint64 offset of the data from the head of the file
+//   data blocks, each of them is aligned to BINARY_ALIGNMENT bytes
+const char BINARY_MAGIC[8] = {'P', 'R', 'M', 'T', 'V', 'P', 'R', 'M'};
+const std::uint32_t BINARY_VERSION = 1;
+const std::uint32_t BINARY_DTYPE_FLOAT32 = 0;
+const std::uint64_t BINARY_ALIGNMENT = 64;
+
+// Entry of a tensor in the binary format.
+struct BinaryEntry {
+  string key;
+  const primitiv::Tensor *tensor;
+  std::uint64_t offset;
+};
+
+// Writes the header of the binary format.
+void write_binary_header(
+    primitiv::BinaryWriter &writer,
+    const string &name, const vector<BinaryEntry> &entries) {
+  writer.write_block(::BINARY_MAGIC, sizeof(::BINARY_MAGIC));
+  writer.write<std::uint32_t>(::BINARY_VERSION);
+  writer.write<std::uint32_t>(::BINARY_DTYPE_FLOAT32);
+  writer.write_string(name);
+  writer.write<std::uint32_t>(entries.size());
+  for (const BinaryEntry &entry : entries) {
+    writer.write_string(entry.key);
+    writer.write<std::uint8_t>(entry.tensor->valid());
+    writer.write_shape(
+        entry.tensor->valid() ? entry.tensor->shape() : primitiv::Shape());
+    writer.write<std::uint64_t>(entry.offset);
+  }
+}
+
+// Function to load a Tensor object from the binary format.
+primitiv::Tensor parse_binary_tensor(
+    primitiv::BinaryReader &reader, const primitiv::MappedFile &file,
+    primitiv::Device *device) {
+  const bool valid = reader.read<std::uint8_t>();
+  const primitiv::Shape shape = reader.read_shape();
+  const std::uint64_t offset = reader.read<std::uint64_t>();
+  if (!valid) return primitiv::Tensor();  // Returns invalid (empty) tensor.
+
+  // Values are copied from the mapped memory to the device directly.
+  primitiv::BinaryReader data(file.data(), file.size());
+  data.seek(offset);
+  const char *ptr = data.read_block(sizeof(float) * shape.size());
+  return device->new_tensor_by_array(
+      shape, reinterpret_cast<const float *>(ptr));
+}
+
 }  // namespace
 
 namespace primitiv {
@@ -151,7 +216,9 @@ Parameter::Parameter(
 , shape_(shape)
 , device_(device)
 , value_(device->new_tensor(shape))
-, grad_(device->new_tensor(shape)) {
+, grad_(device->new_tensor(shape))
+, grad_state_(GRADIENT_DENSE)
+, grad_dim_(0) {
   check_shape();
 }
 
@@ -163,7 +230,9 @@ Parameter::Parameter(
 , shape_(shape)
 , device_(device)
 , value_(device->new_tensor(shape))
-, grad_(device->new_tensor(shape)) {
+, grad_(device->new_tensor(shape))
+, grad_state_(GRADIENT_DENSE)
+, grad_dim_(0) {
   check_shape();
   reset_value(value);
 }
@@ -176,7 +245,9 @@ Parameter::Parameter(
 , shape_(shape)
 , device_(device)
 , value_(device->new_tensor(shape))
-, grad_(device->new_tensor(shape)) {
+, grad_(device->new_tensor(shape))
+, grad_state_(GRADIENT_DENSE)
+, grad_dim_(0) {
   check_shape();
   reset_value(init);
 }
@@ -188,11 +259,20 @@ Parameter::Parameter(
 , shape_(value.shape())
 , device_(value.device())
 , grad_(value.device()->new_tensor(value.shape()))
+, grad_state_(GRADIENT_DENSE)
+, grad_dim_(0)
 , stats_(std::move(stats)) {
   value_ = std::move(value);
   check_shape();
 }
 
+vector<string> Parameter::stats_names() const {
+  vector<string> ret;
+  for (const auto &kv : stats_) ret.emplace_back(kv.first);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
 void Parameter::reset_value(const vector<float> &value) {
   value_.reset_by_vector(value);
 }
@@ -202,7 +282,46 @@ void Parameter::reset_value(const Initializer &init) {
 }
 
 void Parameter::reset_gradient() {
-  grad_.reset(0);
+  // Sparse gradients are reset by overwriting only their slices with 0, which
+  // also clears non-finite values.
+  if (grad_state_ == GRADIENT_SPARSE &&
+      2 * grad_rows_.size() < shape_[grad_dim_]) {
+    device_->pick_assign(
+        device_->new_tensor(
+          shape_ops::pick(grad_.shape(), grad_dim_, grad_rows_), 0),
+        grad_dim_, grad_rows_, grad_);
+  } else {
+    grad_.reset(0);
+  }
+  grad_state_ = GRADIENT_ZERO;
+  grad_rows_.clear();
+}
+
+void Parameter::add_gradient(const Tensor &gy) {
+  grad_ += gy;
+  grad_state_ = GRADIENT_DENSE;
+  grad_rows_.clear();
+}
+
+void Parameter::add_gradient_rows(
+    unsigned dim, const vector<unsigned> &ids, const Tensor &gy) {
+  if (!device_) {
+    THROW_ERROR("Attempted to add gradients to an invalid Parameter object.");
+  }
+  device_->pick_bw(gy, dim, ids, grad_);
+  if (grad_state_ == GRADIENT_ZERO) {
+    grad_state_ = GRADIENT_SPARSE;
+    grad_dim_ = dim;
+  } else if (grad_state_ == GRADIENT_SPARSE && grad_dim_ != dim) {
+    grad_state_ = GRADIENT_DENSE;
+    grad_rows_.clear();
+  }
+  if (grad_state_ == GRADIENT_SPARSE) {
+    grad_rows_.insert(grad_rows_.end(), ids.begin(), ids.end());
+    std::sort(grad_rows_.begin(), grad_rows_.end());
+    grad_rows_.erase(
+        std::unique(grad_rows_.begin(), grad_rows_.end()), grad_rows_.end());
+  }
 }
 
 void Parameter::add_stats(const std::string &name, const Shape &shape) {
@@ -215,7 +334,12 @@ void Parameter::add_stats(const std::string &name, const Shape &shape) {
   stats_.emplace(std::make_pair(name, device_->new_tensor(shape)));
 }
 
-void Parameter::save(const string &path) const  {
+void Parameter::save(const string &path, bool binary) const  {
+  if (binary) {
+    save_binary(path);
+    return;
+  }
+
   std::ofstream ofs(path);
   if (!ofs.is_open()) {
     THROW_ERROR("Could not open file: " << path);
@@ -229,20 +353,51 @@ void Parameter::save(const string &path) const  {
   em << YAML::EndMap;
 }
 
-Parameter Parameter::load(const string &path, Device *device) {
-  std::ifstream ifs(path);
-  if (!ifs.is_open()) {
+void Parameter::save_binary(const string &path) const {
+  vector<::BinaryEntry> entries {{"", &value_, 0}};
+  for (const string &key : stats_names()) {
+    entries.push_back({key, &stats_.at(key), 0});
+  }
+
+  // Calculates offsets of data blocks using a dummy header.
+  std::ostringstream dummy;
+  BinaryWriter dummy_writer(dummy);
+  ::write_binary_header(dummy_writer, name_, entries);
+  std::uint64_t offset = dummy_writer.position();
+  for (::BinaryEntry &entry : entries) {
+    offset = (offset + ::BINARY_ALIGNMENT - 1)
+      / ::BINARY_ALIGNMENT * ::BINARY_ALIGNMENT;
+    entry.offset = offset;
+    if (entry.tensor->valid()) {
+      offset += sizeof(float) * entry.tensor->shape().size();
+    }
+  }
+
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs.is_open()) {
     THROW_ERROR("Could not open file: " << path);
   }
-  ifs.seekg(0, std::ios::end);
-  const size_t size = ifs.tellg();
-  ifs.seekg(0, std::ios::beg);
+  BinaryWriter writer(ofs);
+  ::write_binary_header(writer, name_, entries);
+
+  // Each tensor is transferred to the host one by one.
+  for (const ::BinaryEntry &entry : entries) {
+    writer.pad(::BINARY_ALIGNMENT);
+    if (entry.tensor->valid()) {
+      const vector<float> values = entry.tensor->to_vector();
+      writer.write_block(&values[0], sizeof(float) * values.size());
+    }
+  }
+}
 
-  std::unique_ptr<char[]> data(new char[size + 1]);
-  ifs.read(data.get(), size);
-  data[size] = '\0';
+Parameter Parameter::load(const string &path, Device *device) {
+  const MappedFile file(path);
+  if (file.size() >= sizeof(::BINARY_MAGIC) &&
+      !std::memcmp(file.data(), ::BINARY_MAGIC, sizeof(::BINARY_MAGIC))) {
+    return load_binary(file, device);
+  }
 
-  YAML::Node node = YAML::Load(data.get());
+  YAML::Node node = YAML::Load(string(file.data(), file.size()));
   string name;
   Tensor value;
   std::unordered_map<std::string, Tensor> stats;
@@ -258,4 +413,32 @@ Parameter Parameter::load(const string &path, Device *device) {
   return Parameter(std::move(name), std::move(value), std::move(stats));
 }
 
+Parameter Parameter::load_binary(const MappedFile &file, Device *device) {
+  BinaryReader reader(file.data(), file.size());
+  reader.read_block(sizeof(::BINARY_MAGIC));
+  const std::uint32_t version = reader.read<std::uint32_t>();
+  if (version != ::BINARY_VERSION) {
+    THROW_ERROR("Unsupported version of the binary format: " << version);
+  }
+  const std::uint32_t dtype = reader.read<std::uint32_t>();
+  if (dtype != ::BINARY_DTYPE_FLOAT32) {
+    THROW_ERROR("Unsupported data type of the binary format: " << dtype);
+  }
+
+  string name = reader.read_string();
+  const std::uint32_t num_tensors = reader.read<std::uint32_t>();
+  if (num_tensors == 0) THROW_ERROR("The binary data has no value.");
+  Tensor value;
+  std::unordered_map<std::string, Tensor> stats;
+
+  for (std::uint32_t i = 0; i < num_tensors; ++i) {
+    const string key = reader.read_string();
+    Tensor tensor = ::parse_binary_tensor(reader, file, device);
+    if (i == 0) value = std::move(tensor);
+    else stats.emplace(key, std::move(tensor));
+  }
+
+  return Parameter(std::move(name), std::move(value), std::move(stats));
+}
+
 }  // namespace primitiv
@@ -10,6 +10,7 @@
 namespace primitiv {
 
 class Initializer;
+class MappedFile;
 
 /**
  * Class to manage a trainable tensor parameter.
@@ -25,7 +26,9 @@ public:
   /**
    * Creates an invalid parameter object.
    */
-  Parameter() : name_(), shape_(), device_(nullptr), value_(), grad_() {}
+  Parameter()
+    : name_(), shape_(), device_(nullptr), value_(), grad_()
+    , grad_state_(GRADIENT_DENSE), grad_dim_(0) {}
 
   /**
    * Creates a new Parameter object.
@@ -75,9 +78,50 @@ public:
 
   /**
    * Set all gradients to 0.
+   * @remarks If the gradient is sparse, only slices which have been added are
+   *          reset.
    */
   void reset_gradient();
 
+  /**
+   * Adds a gradient to the whole parameter.
+   * @param gy Gradient with the same shape as the parameter.
+   */
+  void add_gradient(const Tensor &gy);
+
+  /**
+   * Adds gradients to some slices of the parameter, and remembers the slices
+   * so that trainers can update only them.
+   * @param dim Dimension to pick slices.
+   * @param ids List of slice IDs. Duplicated IDs are allowed.
+   * @param gy Gradients of slices, which has the same shape as
+   *           `tensor_ops::pick(value(), dim, ids)`.
+   */
+  void add_gradient_rows(
+      unsigned dim, const std::vector<unsigned> &ids, const Tensor &gy);
+
+  /**
+   * Checks whether only some slices of the gradient may have nonzero values.
+   * @return true if only `add_gradient_rows()` with the same `dim` has been
+   *         called after the last `reset_gradient()`, false otherwise.
+   * @remarks Modifications through `gradient()` are not tracked.
+   */
+  bool has_sparse_gradient() const { return grad_state_ == GRADIENT_SPARSE; }
+
+  /**
+   * Returns the dimension of slices of the sparse gradient.
+   * @return Dimension given to `add_gradient_rows()`.
+   * @remarks This value is meaningful only if `has_sparse_gradient()` is true.
+   */
+  unsigned gradient_dim() const { return grad_dim_; }
+
+  /**
+   * Returns IDs of slices of the sparse gradient.
+   * @return Sorted list of unique IDs.
+   * @remarks This value is meaningful only if `has_sparse_gradient()` is true.
+   */
+  const std::vector<unsigned> &gradient_rows() const { return grad_rows_; }
+
   /**
    * Adds a new optional statistics tensor.
    * @param name Name of the statistics.
@@ -94,6 +138,12 @@ public:
     return stats_.find(name) != stats_.end();
   }
 
+  /**
+   * Retrieves names of all optional statistics.
+   * @return List of names in the ascending order.
+   */
+  std::vector<std::string> stats_names() const;
+
   /**
    * Returns the name of the parameter.
    * @return Name of the parameter.
@@ -155,16 +205,31 @@ public:
    * @param path File path to load parameters.
    * @param device Device object to manage internal memories.
    * @return A new Parameter object.
+   * @remarks The format of the file is detected automatically. Binary files
+   *          are mapped into the memory and values are copied to the device
+   *          directly.
    */
   static Parameter load(const std::string &path, Device *device);
 
   /**
-   * Saves current parameters into specified file with YAML format.
+   * Saves current parameters into specified file.
    * @param path File path to write parameters.
+   * @param binary If true, uses the binary format which stores raw values
+   *               aligned for the memory mapping. Otherwise, uses the YAML
+   *               format.
    */
-  void save(const std::string &path) const;
+  void save(const std::string &path, bool binary = false) const;
 
 private:
+  /**
+   * Known structure of the gradient.
+   */
+  enum GradientState {
+    GRADIENT_DENSE,
+    GRADIENT_ZERO,
+    GRADIENT_SPARSE,
+  };
+
   /**
    * Makes a Parameter object directly from its values.
    * @param name Name of the parameter.
@@ -175,6 +240,20 @@ private:
       std::string &&name, Tensor &&value,
       std::unordered_map<std::string, Tensor> &&stats);
 
+  /**
+   * Saves current parameters with the binary format.
+   * @param path File path to write parameters.
+   */
+  void save_binary(const std::string &path) const;
+
+  /**
+   * Loads parameters from the binary format.
+   * @param file Mapped file.
+   * @param device Device object to manage internal memories.
+   * @return A new Parameter object.
+   */
+  static Parameter load_binary(const MappedFile &file, Device *device);
+
   /**
    * Checks the shape of the parameter.
    */
@@ -185,6 +264,9 @@ private:
   Device *device_;
   Tensor value_;
   Tensor grad_;
+  GradientState grad_state_;
+  unsigned grad_dim_;
+  std::vector<unsigned> grad_rows_;
   std::unordered_map<std::string, Tensor> stats_;
 };
 
@@ -3,13 +3,20 @@
 
 // This header file describes some include directives and may help users to use
 // the primitiv library.
+#include <primitiv/beam_search.h>
+#include <primitiv/checkpoint.h>
 #include <primitiv/cpu_device.h>
+#include <primitiv/data_loader.h>
+#include <primitiv/data_parallel.h>
 #include <primitiv/error.h>
 #include <primitiv/graph.h>
+#include <primitiv/inference_plan.h>
 #include <primitiv/initializer_impl.h>
 #include <primitiv/node.h>
 #include <primitiv/node_ops.h>
 #include <primitiv/parameter.h>
+#include <primitiv/quantized_parameter.h>
+#include <primitiv/request_batcher.h>
 #include <primitiv/shape.h>
 #include <primitiv/tensor.h>
 #include <primitiv/trainer_impl.h>
@@ -0,0 +1,51 @@
+#include <config.h>
+
+#include <primitiv/cpu_qgemm.h>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+#include <primitiv/parameter.h>
+#include <primitiv/quantized_parameter.h>
+
+using std::vector;
+
+namespace primitiv {
+
+QuantizedParameter::QuantizedParameter(const Parameter &param)
+: name_(param.name())
+, shape_(param.shape())
+, device_(param.device()) {
+  if (!device_) {
+    THROW_ERROR("Attempted to quantize an invalid Parameter object.");
+  }
+  if (!shape_.is_matrix()) {
+    THROW_ERROR(
+        "Only matrices can be quantized. Given shape: "
+        << shape_.to_string());
+  }
+  const unsigned m = shape_[0];
+  const unsigned k = shape_[1];
+  values_.resize(m * cpu::qgemm_padded_depth(k));
+  scales_.resize(m);
+  sums_.resize(m);
+  const vector<float> src = param.value().to_vector();
+  cpu::quantize_rows(
+      m, k, src.data(), m, values_.data(), scales_.data(), sums_.data());
+}
+
+Tensor QuantizedParameter::dequantize() const {
+  if (!valid()) {
+    THROW_ERROR("Attempted to dequantize an invalid QuantizedParameter.");
+  }
+  const unsigned m = shape_[0];
+  const unsigned k = shape_[1];
+  const unsigned kp = cpu::qgemm_padded_depth(k);
+  vector<float> dest(m * k);
+  for (unsigned l = 0; l < k; ++l) {
+    for (unsigned i = 0; i < m; ++i) {
+      dest[i + l * m] = scales_[i] * values_[i * kp + l];
+    }
+  }
+  return device_->new_tensor_by_vector(shape_, dest);
+}
+
+}  // namespace primitiv
@@ -0,0 +1,102 @@
+#ifndef PRIMITIV_QUANTIZED_PARAMETER_H_
+#define PRIMITIV_QUANTIZED_PARAMETER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <primitiv/shape.h>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class Device;
+class Parameter;
+
+/**
+ * Read-only copy of a matrix parameter whose values are quantized to int8
+ * with one scale for each row (output channel).
+ * This object is used as the left hand side of `node_ops::matmul()` to run
+ * the inference with a quarter of the memory traffic of the original weights.
+ */
+class QuantizedParameter {
+  QuantizedParameter(const QuantizedParameter &) = delete;
+  QuantizedParameter &operator=(const QuantizedParameter &) = delete;
+
+public:
+  QuantizedParameter(QuantizedParameter &&) = default;
+  QuantizedParameter &operator=(QuantizedParameter &&) = default;
+
+  /**
+   * Creates an invalid object.
+   */
+  QuantizedParameter() : name_(), shape_(), device_(nullptr) {}
+
+  /**
+   * Quantizes values of a parameter.
+   * @param param Parameter to be quantized. The shape should be a matrix.
+   * @remarks Values are copied at this call, and later updates of `param` are
+   *          not reflected.
+   */
+  explicit QuantizedParameter(const Parameter &param);
+
+  /**
+   * Checks whether the object is valid or not.
+   * @return true if the object is valid, false otherwise.
+   */
+  bool valid() const { return device_ != nullptr; }
+
+  /**
+   * Returns the name of the original parameter.
+   * @return Name of the parameter.
+   */
+  const std::string &name() const { return name_; }
+
+  /**
+   * Returns the shape of the original parameter.
+   * @return Shape object.
+   */
+  const Shape &shape() const { return shape_; }
+
+  /**
+   * Returns the device of the original parameter.
+   * @return Pointer of the Device object.
+   */
+  Device *device() const { return device_; }
+
+  /**
+   * Returns quantized values.
+   * @return Values stored row by row. Each row has
+   *         `cpu::qgemm_padded_depth(shape()[1])` elements.
+   */
+  const std::vector<std::int8_t> &values() const { return values_; }
+
+  /**
+   * Returns scales of rows.
+   * @return List of scales.
+   */
+  const std::vector<float> &scales() const { return scales_; }
+
+  /**
+   * Returns sums of quantized values of rows.
+   * @return List of sums.
+   */
+  const std::vector<std::int32_t> &sums() const { return sums_; }
+
+  /**
+   * Restores approximated float values.
+   * @return A new tensor on `device()`.
+   */
+  Tensor dequantize() const;
+
+private:
+  std::string name_;
+  Shape shape_;
+  Device *device_;
+  std::vector<std::int8_t> values_;
+  std::vector<float> scales_;
+  std::vector<std::int32_t> sums_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_QUANTIZED_PARAMETER_H_
@@ -0,0 +1,192 @@
+#include <config.h>
+
+#include <exception>
+#include <utility>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
+#include <primitiv/inference_plan.h>
+#include <primitiv/request_batcher.h>
+
+using std::vector;
+
+namespace primitiv {
+
+RequestBatcher::RequestBatcher(
+    InferencePlan &plan, unsigned max_batch_size,
+    std::chrono::microseconds max_delay, unsigned num_threads)
+: plan_(plan)
+, max_batch_size_(max_batch_size)
+, max_delay_(max_delay)
+, num_waiting_samples_(0)
+, num_batches_(0)
+, num_samples_(0)
+, stop_(false) {
+  if (max_batch_size == 0 || num_threads == 0) {
+    THROW_ERROR(
+        "Invalid RequestBatcher settings. max_batch_size: " << max_batch_size
+        << ", num_threads: " << num_threads);
+  }
+  for (unsigned i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&RequestBatcher::worker_loop, this);
+  }
+}
+
+RequestBatcher::~RequestBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+std::future<vector<Tensor>> RequestBatcher::submit(
+    const vector<Tensor> &inputs) {
+  if (inputs.size() != plan_.num_inputs()) {
+    THROW_ERROR(
+        "Number of inputs mismatched. required: " << plan_.num_inputs()
+        << " != actual: " << inputs.size());
+  }
+  for (const Tensor &x : inputs) {
+    if (!x.valid() || x.device() != plan_.device()) {
+      THROW_ERROR("Inputs should be valid tensors on the device of the plan.");
+    }
+    if (x.shape().batch() != inputs[0].shape().batch()) {
+      THROW_ERROR(
+          "Batch sizes of inputs mismatched: "
+          << inputs[0].shape().to_string() << ", " << x.shape().to_string());
+    }
+  }
+  const unsigned batch_size = inputs.empty() ? 1 : inputs[0].shape().batch();
+
+  Request req {
+    inputs, batch_size, std::chrono::steady_clock::now(),
+    std::promise<vector<Tensor>>(),
+  };
+  std::future<vector<Tensor>> ret = req.result.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.emplace_back(std::move(req));
+    num_waiting_samples_ += batch_size;
+  }
+  cv_.notify_all();
+  return ret;
+}
+
+std::uint64_t RequestBatcher::num_batches() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_batches_;
+}
+
+std::uint64_t RequestBatcher::num_samples() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_samples_;
+}
+
+bool RequestBatcher::compatible(const Request &a, const Request &b) {
+  for (unsigned i = 0; i < a.inputs.size(); ++i) {
+    const Shape &sa = a.inputs[i].shape();
+    const Shape &sb = b.inputs[i].shape();
+    if (sa.resize_batch(1) != sb.resize_batch(1)) return false;
+  }
+  return true;
+}
+
+void RequestBatcher::calculate(vector<Request> &requests) {
+  try {
+    vector<Tensor> inputs;
+    unsigned total = 0;
+    for (const Request &req : requests) total += req.batch_size;
+    if (requests.size() == 1) {
+      inputs = requests[0].inputs;
+    } else {
+      Device &dev = *plan_.device();
+      vector<const Tensor *> xs(requests.size());
+      for (unsigned i = 0; i < plan_.num_inputs(); ++i) {
+        for (unsigned j = 0; j < requests.size(); ++j) {
+          xs[j] = &requests[j].inputs[i];
+        }
+        inputs.emplace_back(dev.batch_concat_fw(xs));
+      }
+    }
+
+    const vector<Tensor> ys = plan_.run(inputs);
+    for (const Tensor &y : ys) {
+      const unsigned bs = y.shape().batch();
+      if (bs != 1 && bs != total) {
+        THROW_ERROR(
+            "Batch size of the output mismatched. required: " << total
+            << " != actual: " << bs);
+      }
+    }
+
+    // Outputs without the minibatch are shared by all requests.
+    vector<vector<Tensor>> results(requests.size());
+    if (requests.size() == 1) {
+      results[0] = ys;
+    } else {
+      Device &dev = *plan_.device();
+      unsigned offset = 0;
+      for (unsigned j = 0; j < requests.size(); ++j) {
+        const unsigned n = requests[j].batch_size;
+        for (const Tensor &y : ys) {
+          results[j].emplace_back(
+              y.shape().has_batch()
+              ? dev.batch_slice_fw(y, offset, offset + n) : y);
+        }
+        offset += n;
+      }
+    }
+    for (unsigned j = 0; j < requests.size(); ++j) {
+      requests[j].result.set_value(std::move(results[j]));
+    }
+  } catch (...) {
+    for (Request &req : requests) {
+      req.result.set_exception(std::current_exception());
+    }
+  }
+}
+
+void RequestBatcher::worker_loop() {
+  for (;;) {
+    vector<Request> requests;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+        if (queue_.empty()) {
+          if (stop_) return;
+          cv_.wait(lock);
+          continue;
+        }
+        // NOTE(odashi):
+        // The deadline is always calculated from the current front, because
+        // other workers may take requests while waiting.
+        const auto deadline = queue_.front().arrival + max_delay_;
+        if (stop_ || num_waiting_samples_ >= max_batch_size_ ||
+            std::chrono::steady_clock::now() >= deadline) {
+          break;
+        }
+        cv_.wait_until(lock, deadline);
+      }
+
+      // Takes consecutive compatible requests. The first request is always
+      // taken even if it exceeds the limit by itself.
+      unsigned n = 0;
+      do {
+        n += queue_.front().batch_size;
+        requests.emplace_back(std::move(queue_.front()));
+        queue_.pop_front();
+      } while (!queue_.empty() &&
+          n + queue_.front().batch_size <= max_batch_size_ &&
+          compatible(requests[0], queue_.front()));
+      num_waiting_samples_ -= n;
+      ++num_batches_;
+      num_samples_ += n;
+    }
+    // Other workers may take the remaining requests.
+    cv_.notify_all();
+    calculate(requests);
+  }
+}
+
+}  // namespace primitiv
@@ -0,0 +1,125 @@
+#ifndef PRIMITIV_REQUEST_BATCHER_H_
+#define PRIMITIV_REQUEST_BATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class InferencePlan;
+
+/**
+ * Collector of small inference requests from multiple threads, which
+ * concatenates them along the minibatch and calculates them by one call of
+ * `InferencePlan::run()`.
+ *
+ * A minibatch is issued when the number of waiting samples reaches
+ * `max_batch_size`, or when the oldest waiting request has waited for
+ * `max_delay`. Each caller receives the slices of the outputs corresponding
+ * to its own samples.
+ */
+class RequestBatcher {
+  RequestBatcher() = delete;
+  RequestBatcher(const RequestBatcher &) = delete;
+  RequestBatcher(RequestBatcher &&) = delete;
+  RequestBatcher &operator=(const RequestBatcher &) = delete;
+  RequestBatcher &operator=(RequestBatcher &&) = delete;
+
+public:
+  /**
+   * Creates a new RequestBatcher object and starts background threads.
+   * @param plan Plan to calculate minibatches. All outputs of the plan should
+   *             have the same batch size as the inputs, or the batch size 1.
+   * @param max_batch_size Maximum number of samples in each minibatch.
+   * @param max_delay Maximum time to wait for other requests.
+   * @param num_threads Number of threads issuing minibatches. Values larger
+   *                    than 1 overlap the assembly of a minibatch with the
+   *                    calculation of the previous one.
+   */
+  RequestBatcher(
+      InferencePlan &plan, unsigned max_batch_size,
+      std::chrono::microseconds max_delay, unsigned num_threads = 1);
+
+  ~RequestBatcher();
+
+  /**
+   * Enqueues a request.
+   * @param inputs Values of inputs of the plan on the device of the plan. All
+   *               inputs should have the same batch size, which is usually 1.
+   * @return Future of the values of outputs for the samples of `inputs`.
+   * @remarks Requests are gathered in the arrival order, and consecutive
+   *          requests whose inputs have the same shapes except the batch
+   *          size are batched together. Errors during the calculation are
+   *          delivered to all requests of the minibatch through the future.
+   */
+  std::future<std::vector<Tensor>> submit(const std::vector<Tensor> &inputs);
+
+  /**
+   * Enqueues a request and waits for its outputs.
+   * @param inputs Values of inputs of the plan.
+   * @return Values of outputs for the samples of `inputs`.
+   */
+  std::vector<Tensor> run(const std::vector<Tensor> &inputs) {
+    return submit(inputs).get();
+  }
+
+  /**
+   * Retrieves the number of minibatches calculated so far.
+   * @return Number of minibatches.
+   */
+  std::uint64_t num_batches() const;
+
+  /**
+   * Retrieves the number of samples calculated so far.
+   * @return Number of samples.
+   */
+  std::uint64_t num_samples() const;
+
+private:
+  /**
+   * A waiting request.
+   */
+  struct Request {
+    std::vector<Tensor> inputs;
+    unsigned batch_size;
+    std::chrono::steady_clock::time_point arrival;
+    std::promise<std::vector<Tensor>> result;
+  };
+
+  /**
+   * Checks whether the inputs of two requests can be concatenated or not.
+   */
+  static bool compatible(const Request &a, const Request &b);
+
+  /**
+   * Calculates a minibatch and delivers its outputs.
+   * @param requests Requests in the minibatch.
+   */
+  void calculate(std::vector<Request> &requests);
+
+  void worker_loop();
+
+  InferencePlan &plan_;
+  unsigned max_batch_size_;
+  std::chrono::microseconds max_delay_;
+
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> queue_;
+  unsigned num_waiting_samples_;
+  std::uint64_t num_batches_;
+  std::uint64_t num_samples_;
+  bool stop_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_REQUEST_BATCHER_H_
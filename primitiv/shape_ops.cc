@@ -74,6 +74,51 @@ Shape concat(const std::vector<const Shape *> &xs, unsigned dim) {
   return s0;
 }
 
+Shape batch_slice(const Shape &x, unsigned lower, unsigned upper) {
+  if (lower >= upper || upper > x.batch()) {
+    THROW_ERROR(
+        "Invalid batch slice operation. shape: " << x.to_string()
+        << ", lower: " << lower << ", upper: " << upper);
+  }
+  return x.resize_batch(upper - lower);
+}
+
+Shape batch_concat(const std::vector<const Shape *> &xs) {
+  if (xs.empty()) {
+    THROW_ERROR("No tensors to be concatenated.");
+  }
+
+  unsigned sum = xs[0]->batch();
+  for (unsigned i = 1; i < xs.size(); ++i) {
+    if (!xs[0]->has_same_dims(*xs[i])) {
+      std::string dims_str = xs[0]->to_string();
+      for (unsigned i = 1; i < xs.size(); ++i) {
+        dims_str += ", " + xs[i]->to_string();
+      }
+      THROW_ERROR("Invalid shapes to concatenate minibatches: " << dims_str);
+    }
+    sum += xs[i]->batch();
+  }
+
+  return xs[0]->resize_batch(sum);
+}
+
+Shape batch_pick(const Shape &x, const std::vector<unsigned> &ids) {
+  if (ids.empty()) {
+    THROW_ERROR(
+        "Invalid IDs to pick from the minibatch. shape: " << x.to_string()
+        << ", ids: {}");
+  }
+  for (unsigned i = 0; i < ids.size(); ++i) {
+    if (ids[i] >= x.batch()) {
+      THROW_ERROR(
+          "Invalid IDs to pick from the minibatch. shape: " << x.to_string()
+          << ", ids[" << i << "]: " << ids[i]);
+    }
+  }
+  return x.resize_batch(ids.size());
+}
+
 Shape broadcast(const Shape &x, unsigned dim, unsigned size) {
   if (x[dim] != 1 || size == 0) {
     THROW_ERROR(
@@ -104,6 +149,22 @@ Shape pick(const Shape &x, unsigned dim, const std::vector<unsigned> &ids) {
   return ret;
 }
 
+Shape gather(const Shape &x, unsigned dim, const std::vector<unsigned> &ids) {
+  const unsigned n = x[dim];
+  if (ids.empty()) {
+    THROW_ERROR(
+        "Invalid IDs to gather. shape: " << x.to_string() << ", ids: {}");
+  }
+  for (unsigned i = 0; i < ids.size(); ++i) {
+    if (ids[i] >= n) {
+      THROW_ERROR(
+          "Invalid IDs to gather. shape: " << x.to_string()
+          << ", ids[" << i << "]: " << ids[i]);
+    }
+  }
+  return x.resize_dim(dim, ids.size());
+}
+
 Shape transpose(const Shape &x) {
   if (!x.is_matrix()) {
     THROW_ERROR("Invalid shape to transpose: " << x.to_string());
@@ -121,5 +182,41 @@ Shape matmul(const Shape &l, const Shape &r) {
   return Shape({l[0], r[1]}, std::max(l.batch(), r.batch()));
 }
 
+Shape affine(const Shape &w, const Shape &x, const Shape &b) {
+  const Shape y = matmul(w, x);
+  if (!b.is_row_vector() || b[0] != y[0] || !y.has_compatible_batch(b)) {
+    THROW_ERROR(
+        "Invalid shapes to calculate the affine transform: "
+        << w.to_string() << ", " << x.to_string() << ", " << b.to_string());
+  }
+  return y.resize_batch(std::max(y.batch(), b.batch()));
+}
+
+Shape lstm_cell(const Shape &u, const Shape &c) {
+  if (!u.is_matrix() || !c.is_matrix() || u[0] != 4 * c[0] ||
+      u[1] != c[1] || !u.has_compatible_batch(c)) {
+    THROW_ERROR(
+        "Invalid shapes to calculate the LSTM cell: "
+        << u.to_string() << ", " << c.to_string());
+  }
+  return Shape({2 * c[0], c[1]}, std::max(u.batch(), c.batch()));
+}
+
+Shape lstm(const Shape &xu, const Shape &wh, const Shape &h0, const Shape &c0) {
+  const unsigned n = h0[0];
+  if (!xu.is_matrix() || !wh.is_matrix() || wh.has_batch() ||
+      !h0.is_row_vector() || !h0.has_same_dims(c0) ||
+      xu[0] != 4 * n || wh[0] != 4 * n || wh[1] != n ||
+      !xu.has_compatible_batch(h0) || !xu.has_compatible_batch(c0) ||
+      !h0.has_compatible_batch(c0)) {
+    THROW_ERROR(
+        "Invalid shapes to calculate the LSTM: "
+        << xu.to_string() << ", " << wh.to_string() << ", "
+        << h0.to_string() << ", " << c0.to_string());
+  }
+  const unsigned bs = std::max(xu.batch(), std::max(h0.batch(), c0.batch()));
+  return Shape({2 * n, xu[1]}, bs);
+}
+
 }  // namespace shape_ops
 }  // namespace primitiv
@@ -57,6 +57,31 @@ Shape slice(const Shape &x, unsigned dim, unsigned lower, unsigned upper);
  */
 Shape concat(const std::vector<const Shape *> &xs, unsigned dim);
 
+/**
+ * Calculates the shape of the slice of the minibatch.
+ * @param x A shape.
+ * @param lower Lower bound of the minibatch.
+ * @param upper Upper bound of the minibatch.
+ * @return A shape.
+ */
+Shape batch_slice(const Shape &x, unsigned lower, unsigned upper);
+
+/**
+ * Calculates the shape of concatenated minibatches.
+ * @param xs A list of shapes. All shapes should have the same dims.
+ * @return A shape.
+ */
+Shape batch_concat(const std::vector<const Shape *> &xs);
+
+/**
+ * Calculates the shape of samples picked from the minibatch.
+ * @param x A shape.
+ * @param ids Indices of samples to be picked. Each index may appear any
+ *            number of times.
+ * @return A shape with dims of `x` and the batch size `ids.size()`.
+ */
+Shape batch_pick(const Shape &x, const std::vector<unsigned> &ids);
+
 /**
  * Calculates the broadcasted shape.
  * @param x A shape.
@@ -75,6 +100,16 @@ Shape broadcast(const Shape &x, unsigned dim, unsigned size);
  */
 Shape pick(const Shape &x, unsigned dim, const std::vector<unsigned> &ids);
 
+/**
+ * Calculates the gathered shape.
+ * @param x A shape.
+ * @param dim Dimension to gather.
+ * @param ids Label IDs to be gathered from the dimension `dim`. Unlike
+ *            `pick()`, the batch size is not changed.
+ * @return A shape.
+ */
+Shape gather(const Shape &x, unsigned dim, const std::vector<unsigned> &ids);
+
 /**
  * Calculates the transposed shape.
  * @param x A shape.
@@ -89,6 +124,30 @@ Shape transpose(const Shape &x);
  */
 Shape matmul(const Shape &l, const Shape &r);
 
+/** Calculates the shape of affine transforms `w . x + b`.
+ * @param w Shape of the left hand side of the matrix product.
+ * @param x Shape of the right hand side of the matrix product.
+ * @param b Shape of the bias vector.
+ * @return A shape.
+ */
+Shape affine(const Shape &w, const Shape &x, const Shape &b);
+
+/** Calculates the shape of LSTM cells.
+ * @param u Shape of the concatenated preactivations of all gates.
+ * @param c Shape of the previous cell state.
+ * @return A shape.
+ */
+Shape lstm_cell(const Shape &u, const Shape &c);
+
+/** Calculates the shape of multi-step LSTMs.
+ * @param xu Shape of the input preactivations of all steps.
+ * @param wh Shape of the recurrent weight matrix.
+ * @param h0 Shape of the initial hidden state.
+ * @param c0 Shape of the initial cell state.
+ * @return A shape.
+ */
+Shape lstm(const Shape &xu, const Shape &wh, const Shape &h0, const Shape &c0);
+
 }  // namespace shape_ops
 }  // namespace primitiv
 
@@ -1,12 +1,21 @@
 #include <config.h>
 
+#include <atomic>
 #include <utility>
 #include <primitiv/device.h>
+#include <primitiv/error.h>
 #include <primitiv/shape_ops.h>
 #include <primitiv/tensor.h>
 
 using std::move;
 
+namespace {
+
+std::atomic<std::uint64_t> num_copy_on_writes(0);
+std::atomic<primitiv::Tensor::CopyOnWriteHook> copy_on_write_hook(nullptr);
+
+}  // namespace
+
 namespace primitiv {
 
 Tensor &Tensor::operator=(Tensor &&src) {
@@ -14,24 +23,73 @@ Tensor &Tensor::operator=(Tensor &&src) {
     shape_ = move(src.shape_);
     device_ = src.device_;
     data_ = move(src.data_);
+    aliased_ = src.aliased_;
     src.device_ = nullptr;
+    src.aliased_ = false;
   }
   return *this;
 }
 
+Tensor::Tensor(const Tensor &src)
+: shape_(src.shape_)
+, device_(src.device_)
+, data_(src.shared_data())
+, aliased_(false) {}
+
+Tensor &Tensor::operator=(const Tensor &src) {
+  if (this != &src) {
+    shape_ = src.shape_;
+    device_ = src.device_;
+    data_ = src.shared_data();
+    aliased_ = false;
+  }
+  return *this;
+}
+
+std::shared_ptr<void> Tensor::shared_data() const {
+  // NOTE(odashi):
+  // Aliased memory is updated without copy-on-write, and only views can share
+  // it. Other tensors obtain a copy of the current values.
+  return aliased_ ? device_->copy_tensor(*this).data_ : data_;
+}
+
 std::vector<float> Tensor::to_vector() const {
   return device_->tensor_to_vector(*this);
 }
 
+void Tensor::to_array(float *values) const {
+  device_->tensor_to_array(*this, values);
+}
+
 void *Tensor::data() {
   // If the internal memory is shared with other objects, the memory will be
-  // duplicated to maintain the safety of other objects.
-  if (data_.use_count() > 1) {
+  // duplicated to maintain the safety of other objects, except that the memory
+  // is intentionally shared with views.
+  if (!aliased_ && data_.use_count() > 1) {
+    ::num_copy_on_writes.fetch_add(1, std::memory_order_relaxed);
+    const CopyOnWriteHook hook = ::copy_on_write_hook.load();
+    if (hook) hook(*this);
     *this = device_->copy_tensor(*this);
   }
   return data_.get();
 }
 
+Tensor &Tensor::make_unique() {
+  if (!valid()) THROW_ERROR("Attempted to own an invalid tensor.");
+  if (aliased_ || data_.use_count() > 1) {
+    *this = device_->copy_tensor(*this);
+  }
+  return *this;
+}
+
+std::uint64_t Tensor::num_copy_on_writes() {
+  return ::num_copy_on_writes.load(std::memory_order_relaxed);
+}
+
+void Tensor::set_copy_on_write_hook(CopyOnWriteHook hook) {
+  ::copy_on_write_hook.store(hook);
+}
+
 void Tensor::reset(const float k) {
   device_->reset_tensor(k, *this);
 }
@@ -45,11 +103,29 @@ void Tensor::reset_by_vector(const std::vector<float> &values) {
 }
 
 Tensor Tensor::reshape(const Shape &new_shape) const {
-  return Tensor(shape_ops::reshape(shape_, new_shape), device_, data_);
+  return Tensor(shape_ops::reshape(shape_, new_shape), device_, shared_data());
 }
 
 Tensor Tensor::flatten() const {
-  return Tensor(shape_ops::flatten(shape_), device_, data_);
+  return Tensor(shape_ops::flatten(shape_), device_, shared_data());
+}
+
+Tensor Tensor::view(const Shape &new_shape, unsigned offset) {
+  if (!valid()) THROW_ERROR("Attempted to make a view of an invalid tensor.");
+  if (offset + new_shape.size() > shape_.size()) {
+    THROW_ERROR(
+        "View out of range. offset: " << offset
+        << ", new_shape: " << new_shape.to_string()
+        << ", shape: " << shape_.to_string());
+  }
+  // Duplicates the memory at first if it is implicitly shared.
+  data();
+  aliased_ = true;
+  Tensor ret(
+      new_shape, device_,
+      std::shared_ptr<void>(data_, static_cast<float *>(data_.get()) + offset));
+  ret.aliased_ = true;
+  return ret;
 }
 
 Tensor &Tensor::operator*=(float k) {
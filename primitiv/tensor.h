@@ -1,6 +1,7 @@
 #ifndef PRIMITIV_TENSOR_H_
 #define PRIMITIV_TENSOR_H_
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <primitiv/shape.h>
@@ -16,15 +17,38 @@ class Tensor {
   friend Device;
 
 public:
-  Tensor(const Tensor &) = default;
+  /**
+   * Callback which is called before every implicit duplication of the memory.
+   * @param x The tensor to be duplicated.
+   */
+  typedef void (*CopyOnWriteHook)(const Tensor &x);
+
   Tensor(Tensor &&) = default;
-  Tensor &operator=(const Tensor &) = default;
   Tensor &operator=(Tensor &&);
 
+  /**
+   * Creates a copy of the tensor which shares the internal memory until either
+   * one is updated.
+   * @param src Source tensor.
+   * @remarks The copied tensor never becomes aliased. If `src` is aliased, its
+   *          memory may be updated in place, and the copied tensor obtains its
+   *          own memory immediately.
+   */
+  Tensor(const Tensor &src);
+
+  /**
+   * Copies the tensor.
+   * @param src Source tensor.
+   * @return `*this`
+   * @remarks Same as the copy constructor, `*this` becomes non-aliased, and
+   *          the memory of an aliased `src` is duplicated.
+   */
+  Tensor &operator=(const Tensor &src);
+
   /**
    * Creates an invalid Tensor.
    */
-  Tensor() : shape_(), device_(nullptr), data_() {}
+  Tensor() : shape_(), device_(nullptr), data_(), aliased_(false) {}
 
   /**
    * Returns the shape of the Tensor.
@@ -58,6 +82,15 @@ public:
    */
   std::vector<float> to_vector() const;
 
+  /**
+   * Retrieves internal values of the tensor into an array.
+   * @param values Array to store `shape().size()` values.
+   * @remarks Same as `to_vector()`, values are ordered by the column-major
+   *          order, and the batch size is assumed as the last dimension.
+   *          This function does not allocate any intermediate memory.
+   */
+  void to_array(float *values) const;
+
   /**
    * Reset internal values using a constant.
    * @param k A value to be used to initialize each element.
@@ -90,19 +123,71 @@ public:
    */
   bool valid() const { return static_cast<bool>(data_); }
 
+  /**
+   * Check whether the internal memory is directly shared with views or not.
+   * @return true if the object is aliased, false otherwise.
+   * @remarks Updating an aliased tensor writes into the shared memory without
+   *          the copy-on-write behavior.
+   */
+  bool aliased() const { return aliased_; }
+
+  /**
+   * Check whether the internal memory is owned only by this object or not.
+   * @return true if the object is valid and no other objects share the memory,
+   *         false otherwise.
+   * @remarks Updating a non-unique and non-aliased tensor duplicates the memory
+   *          implicitly (copy-on-write).
+   */
+  bool unique() const { return data_.use_count() == 1; }
+
+  /**
+   * Makes the internal memory owned only by this object.
+   * @return `*this`
+   * @remarks The memory is duplicated explicitly if it is shared with other
+   *          objects. This function does not invoke the copy-on-write hook, and
+   *          aliased tensors are also duplicated and become non-aliased.
+   */
+  Tensor &make_unique();
+
+  /**
+   * Returns the number of implicit duplications caused by copy-on-write.
+   * @return Number of duplications in all threads since the program started.
+   */
+  static std::uint64_t num_copy_on_writes();
+
+  /**
+   * Registers a callback to observe implicit duplications.
+   * @param hook Callback function, or nullptr to remove the current one.
+   * @remarks The hook is shared by all threads and should be thread-safe.
+   */
+  static void set_copy_on_write_hook(CopyOnWriteHook hook);
+
   /**
    * Returns a tensor which have the same values and different shape.
    * @param new_shape New shape with batch size 1.
    * @return A new tensor.
+   * @remarks Same as the copy constructor, the result is not aliased.
    */
   Tensor reshape(const Shape &new_shape) const;
 
   /**
    * Returns a flattened tensor.
    * @return A new tensor.
+   * @remarks Same as the copy constructor, the result is not aliased.
    */
   Tensor flatten() const;
 
+  /**
+   * Returns a tensor which refers a contiguous part of the internal memory.
+   * @param new_shape Shape of the resulting tensor.
+   * @param offset Number of elements before the first element of the view.
+   * @return A new tensor.
+   * @remarks Both `*this` and the resulting tensor become aliased, and updates
+   *          of either tensor are visible through the other one. Copies of
+   *          these tensors are not aliased and have their own memory.
+   */
+  Tensor view(const Shape &new_shape, unsigned offset);
+
   /**
    * Directly multiplies a constant.
    * @param k A constant to multiply.
@@ -135,11 +220,20 @@ private:
   Tensor(ShapeT &&shape, Device *device, SharedPtrT &&data)
     : shape_(std::forward<ShapeT>(shape))
     , device_(device)
-    , data_(std::forward<SharedPtrT>(data)) {}
+    , data_(std::forward<SharedPtrT>(data))
+    , aliased_(false) {}
+
+  /**
+   * Retrieves the memory to be shared with a non-aliased tensor.
+   * @return `data_` if this tensor is not aliased, or a copy of the memory
+   *         otherwise.
+   */
+  std::shared_ptr<void> shared_data() const;
 
   Shape shape_;
   Device *device_;
   std::shared_ptr<void> data_;
+  bool aliased_;
 };
 
 }  // namespace primitiv
@@ -79,6 +79,10 @@ Tensor pick(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids) {
   return x.device()->pick_fw(x, dim, ids);
 }
 
+Tensor gather(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids) {
+  return x.device()->gather_fw(x, dim, ids);
+}
+
 Tensor slice(const Tensor &x, unsigned dim, unsigned lower, unsigned upper) {
   return x.device()->slice_fw(x, dim, lower, upper);
 }
@@ -104,6 +108,21 @@ Tensor matmul(const Tensor &a, const Tensor &b) {
   return a.device()->matmul_fw(a, b);
 }
 
+Tensor affine(
+    const Tensor &w, const Tensor &x, const Tensor &b,
+    Device::Activation act) {
+  return w.device()->affine_fw(w, x, b, act);
+}
+
+Tensor lstm_cell(const Tensor &u, const Tensor &c) {
+  return u.device()->lstm_cell_fw(u, c);
+}
+
+Tensor lstm(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0) {
+  return xu.device()->lstm_fw(xu, wh, h0, c0);
+}
+
 Tensor sqrt(const Tensor &x) {
   return x.device()->sqrt_fw(x);
 }
@@ -165,11 +184,11 @@ Tensor logsumexp(const Tensor &x, unsigned dim) {
 }
 
 Tensor log_softmax(const Tensor &x, unsigned dim) {
-  return x - broadcast(logsumexp(x, dim), dim, x.shape()[dim]);
+  return x.device()->log_softmax_fw(x, dim);
 }
 
 Tensor softmax(const Tensor &x, unsigned dim) {
-  return exp(log_softmax(x, dim));
+  return x.device()->softmax_fw(x, dim);
 }
 
 Tensor broadcast(const Tensor &x, unsigned dim, unsigned size) {
@@ -180,6 +199,10 @@ Tensor batch_sum(const Tensor &x) {
   return x.device()->batch_sum_fw(x);
 }
 
+Tensor batch_pick(const Tensor &x, const std::vector<unsigned> &ids) {
+  return x.device()->batch_pick_fw(x, ids);
+}
+
 Tensor softmax_cross_entropy(const Tensor &x, const Tensor &t, unsigned dim) {
   return -sum(t * log_softmax(x, dim), dim);
 }
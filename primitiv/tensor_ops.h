@@ -28,6 +28,7 @@ namespace tensor_ops {
 Tensor copy(const Tensor &x, Device *dev);
 
 Tensor pick(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids);
+Tensor gather(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids);
 Tensor slice(const Tensor &x, unsigned dim, unsigned lower, unsigned upper);
 Tensor concat(const std::vector<const Tensor *> &xs, unsigned dim);
 
@@ -36,6 +37,12 @@ Tensor flatten(const Tensor &x);
 
 Tensor transpose(const Tensor &x);
 Tensor matmul(const Tensor &a, const Tensor &b);
+Tensor affine(
+    const Tensor &w, const Tensor &x, const Tensor &b,
+    Device::Activation act = Device::ACTIVATION_IDENTITY);
+Tensor lstm_cell(const Tensor &u, const Tensor &c);
+Tensor lstm(
+    const Tensor &xu, const Tensor &wh, const Tensor &h0, const Tensor &c0);
 Tensor sqrt(const Tensor &x);
 Tensor exp(const Tensor &x);
 Tensor tanh(const Tensor &x);
@@ -60,6 +67,7 @@ Tensor softmax(const Tensor &x, unsigned dim);
 Tensor broadcast(const Tensor &x, unsigned dim, unsigned size);
 
 Tensor batch_sum(const Tensor &x);
+Tensor batch_pick(const Tensor &x, const std::vector<unsigned> &ids);
 
 Tensor softmax_cross_entropy(const Tensor &x, const Tensor &t, unsigned dim);
 Tensor softmax_cross_entropy(const Tensor &x, unsigned dim, const std::vector<unsigned> &ids);
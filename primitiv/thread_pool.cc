@@ -0,0 +1,117 @@
+#include <config.h>
+
+#include <algorithm>
+#include <primitiv/numa.h>
+#include <primitiv/thread_pool.h>
+
+namespace {
+
+// Whether the current thread is processing a range of some ThreadPool.
+thread_local bool in_parallel_region = false;
+
+// Maximum number of subranges assigned to each thread.
+const unsigned CHUNKS_PER_THREAD = 4;
+
+}  // namespace
+
+namespace primitiv {
+
+ThreadPool::ThreadPool(
+    unsigned num_threads, const std::vector<unsigned> &cpus)
+: fn_(nullptr)
+, size_(0)
+, chunk_size_(0)
+, num_chunks_(0)
+, next_chunk_(0)
+, num_running_(0)
+, generation_(0)
+, stop_(false) {
+  for (unsigned i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this, cpus);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_start_.notify_all();
+  for (std::thread &th : workers_) th.join();
+}
+
+void ThreadPool::parallel_for(
+    unsigned size, unsigned grain, const RangeFunction &fn) {
+  if (size == 0) return;
+  grain = std::max(grain, 1u);
+  if (workers_.empty() || size <= grain || ::in_parallel_region) {
+    fn(0, size);
+    return;
+  }
+
+  std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+  const unsigned max_chunks = num_threads() * ::CHUNKS_PER_THREAD;
+  const unsigned num_chunks = std::min((size + grain - 1) / grain, max_chunks);
+  const unsigned chunk_size = (size + num_chunks - 1) / num_chunks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    size_ = size;
+    chunk_size_ = chunk_size;
+    num_chunks_ = (size + chunk_size - 1) / chunk_size;
+    next_chunk_ = 0;
+    num_running_ = workers_.size();
+    error_ = nullptr;
+    ++generation_;
+  }
+  cv_start_.notify_all();
+
+  run_chunks();
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_done_.wait(lock, [this] { return num_running_ == 0; });
+    fn_ = nullptr;
+    std::swap(error, error_);
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::run_chunks() {
+  ::in_parallel_region = true;
+  try {
+    while (true) {
+      const unsigned chunk = next_chunk_++;
+      if (chunk >= num_chunks_) break;
+      const unsigned begin = chunk * chunk_size_;
+      (*fn_)(begin, std::min(begin + chunk_size_, size_));
+    }
+  } catch (...) {
+    // Skips remaining chunks and propagates the error to the caller.
+    next_chunk_ = num_chunks_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = std::current_exception();
+  }
+  ::in_parallel_region = false;
+}
+
+void ThreadPool::worker_loop(const std::vector<unsigned> &cpus) {
+  if (!cpus.empty()) numa::bind_current_thread(cpus);
+  unsigned generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_start_.wait(lock, [&] { return stop_ || generation_ != generation; });
+      if (stop_) return;
+      generation = generation_;
+    }
+    run_chunks();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--num_running_ == 0) cv_done_.notify_one();
+    }
+  }
+}
+
+}  // namespace primitiv
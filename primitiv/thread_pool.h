@@ -0,0 +1,94 @@
+#ifndef PRIMITIV_THREAD_POOL_H_
+#define PRIMITIV_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace primitiv {
+
+/**
+ * Persistent pool of worker threads to run data-parallel loops.
+ */
+class ThreadPool {
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+
+public:
+  /**
+   * Function to process the range [begin, end).
+   */
+  using RangeFunction = std::function<void(unsigned begin, unsigned end)>;
+
+  /**
+   * Creates a new ThreadPool object.
+   * @param num_threads Number of threads used by parallel_for(), including
+   *                    the calling thread. Values less than 2 create no
+   *                    worker threads.
+   */
+  explicit ThreadPool(unsigned num_threads)
+    : ThreadPool(num_threads, std::vector<unsigned>()) {}
+
+  /**
+   * Creates a new ThreadPool object whose workers run on given processors.
+   * @param num_threads Number of threads used by parallel_for(), including
+   *                    the calling thread. Values less than 2 create no
+   *                    worker threads.
+   * @param cpus IDs of processors on which worker threads run. If empty,
+   *             workers are not bound.
+   * @remarks The affinity does not affect the calling thread. Workers run
+   *          without the affinity if the system does not accept it.
+   */
+  ThreadPool(unsigned num_threads, const std::vector<unsigned> &cpus);
+
+  ~ThreadPool();
+
+  /**
+   * Retrieves the number of threads used by parallel_for().
+   * @return Number of threads including the calling thread.
+   */
+  unsigned num_threads() const { return workers_.size() + 1; }
+
+  /**
+   * Calls `fn` for disjoint subranges which cover [0, size).
+   * @param size Size of the whole range.
+   * @param grain Minimum size of each subrange. The range is not split if
+   *              `size <= grain`.
+   * @param fn Function to process each subrange. The function may be called
+   *           concurrently by different threads.
+   * @remarks This function blocks until all subranges are processed.
+   *          Subranges are dynamically distributed to the threads.
+   *          Calling this function from the function running on this pool
+   *          processes the whole range on the current thread.
+   */
+  void parallel_for(unsigned size, unsigned grain, const RangeFunction &fn);
+
+private:
+  void worker_loop(const std::vector<unsigned> &cpus);
+  void run_chunks();
+
+  std::vector<std::thread> workers_;
+  std::mutex submit_mutex_;
+  std::mutex mutex_;
+  std::condition_variable cv_start_;
+  std::condition_variable cv_done_;
+  const RangeFunction *fn_;
+  unsigned size_;
+  unsigned chunk_size_;
+  unsigned num_chunks_;
+  std::atomic<unsigned> next_chunk_;
+  unsigned num_running_;
+  unsigned generation_;
+  bool stop_;
+  std::exception_ptr error_;
+};
+
+}  // namespace primitiv
+
+#endif  // PRIMITIV_THREAD_POOL_H_
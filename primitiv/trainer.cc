@@ -1,9 +1,109 @@
 #include <config.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <primitiv/device.h>
 #include <primitiv/error.h>
 #include <primitiv/parameter.h>
+#include <primitiv/tensor_ops.h>
 #include <primitiv/trainer.h>
 
+namespace {
+
+// Replaces a tensor with a view of the buffer which keeps the same values.
+void move_to_view(
+    primitiv::Tensor &buffer, unsigned offset, primitiv::Tensor &x) {
+  primitiv::Tensor view = buffer.view(x.shape(), offset);
+  view.reset(0);
+  view += x;
+  x = std::move(view);
+}
+
+// Checks whether the value is finite by its bits, because the library may be
+// compiled with options which assume all values are finite.
+bool is_finite(float x) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return (bits & 0x7f800000u) != 0x7f800000u;
+}
+
+// Checks whether all gradients have only finite values.
+// Multiplying by 0 keeps only NaNs produced by non-finite values, so that the
+// sum over each device becomes finite if and only if all values are finite.
+bool has_finite_gradients(
+    const std::vector<std::vector<primitiv::Parameter *>> &groups) {
+  namespace T = primitiv::tensor_ops;
+  for (const auto &group : groups) {
+    primitiv::Tensor total = group.front()->device()->new_tensor({}, 0);
+    for (primitiv::Parameter *param : group) {
+      total += T::sum(T::flatten(param->gradient() * 0), 0);
+    }
+    if (!::is_finite(total.to_vector()[0])) return false;
+  }
+  return true;
+}
+
+// Groups parameters by their devices.
+std::vector<std::vector<primitiv::Parameter *>> group_by_device(
+    const std::unordered_map<std::string, primitiv::Parameter *> &params) {
+  std::vector<primitiv::Device *> devices;
+  std::vector<std::vector<primitiv::Parameter *>> groups;
+  for (const auto &kv : params) {
+    primitiv::Device *dev = kv.second->device();
+    const auto it = std::find(devices.begin(), devices.end(), dev);
+    if (it == devices.end()) {
+      devices.emplace_back(dev);
+      groups.emplace_back(1, kv.second);
+    } else {
+      groups[it - devices.begin()].emplace_back(kv.second);
+    }
+  }
+  return groups;
+}
+
+// Calculates the squared norm of gradients on each device.
+std::vector<primitiv::Tensor> squared_gradient_norms(
+    const std::vector<std::vector<primitiv::Parameter *>> &groups) {
+  std::vector<primitiv::Tensor> ret;
+  for (const auto &group : groups) {
+    std::vector<const primitiv::Tensor *> gs;
+    for (primitiv::Parameter *param : group) {
+      gs.emplace_back(&param->gradient());
+    }
+    ret.emplace_back(group.front()->device()->squared_norm(gs));
+  }
+  return ret;
+}
+
+// Clips gradients by their global norm. Partial norms are copied to each
+// device and the global norm is never transferred to the host.
+void clip_gradients(
+    const std::vector<std::vector<primitiv::Parameter *>> &groups,
+    float max_norm) {
+  namespace T = primitiv::tensor_ops;
+  const std::vector<primitiv::Tensor> sq_norms =
+    ::squared_gradient_norms(groups);
+  for (const auto &group : groups) {
+    primitiv::Device &dev = *group.front()->device();
+    primitiv::Tensor total;
+    for (const primitiv::Tensor &sq_norm : sq_norms) {
+      const primitiv::Tensor part =
+        sq_norm.device() == &dev ? sq_norm : T::copy(sq_norm, &dev);
+      total = total.valid() ? total + part : part;
+    }
+    std::vector<primitiv::Tensor *> gs;
+    for (primitiv::Parameter *param : group) {
+      gs.emplace_back(&param->gradient());
+    }
+    dev.clip_by_norm(max_norm, total, gs);
+  }
+}
+
+}  // namespace
+
 namespace primitiv {
 
 void Trainer::add_parameter(Parameter *param) {
@@ -14,17 +114,206 @@ void Trainer::add_parameter(Parameter *param) {
   configure_parameter(*param);
 }
 
+std::vector<Parameter *> Trainer::parameters() const {
+  std::vector<Parameter *> ret;
+  for (const auto &kv : params_) ret.emplace_back(kv.second);
+  std::sort(
+      ret.begin(), ret.end(),
+      [](const Parameter *a, const Parameter *b) {
+        return a->name() < b->name();
+      });
+  return ret;
+}
+
+std::unordered_map<std::string, unsigned> Trainer::get_states() const {
+  return {};
+}
+
+void Trainer::set_states(const std::unordered_map<std::string, unsigned> &) {}
+
 void Trainer::reset_gradients() {
+  for (PackedBuffer &buf : packed_) {
+    buf.gradients.reset(0);
+    const float *base = static_cast<const float *>(buf.gradients.data());
+    for (unsigned i = 0; i < buf.params.size(); ++i) {
+      // Falls back to the individual reset if the gradient had been replaced.
+      // Sparse gradients are also reset individually to forget their slices.
+      Parameter &param = *buf.params[i];
+      const Tensor &grad = param.gradient();
+      if (grad.data() != base + buf.offsets[i] ||
+          param.has_sparse_gradient()) {
+        param.reset_gradient();
+      }
+    }
+  }
   for (const auto &kv : params_) {
-    kv.second->reset_gradient();
+    if (packed_params_.find(kv.second) == packed_params_.end()) {
+      kv.second->reset_gradient();
+    }
   }
 }
 
 void Trainer::update(float scale) {
-  for (const auto &kv : params_) {
-    update_parameter(scale, *kv.second);
+  const std::vector<std::vector<Parameter *>> groups =
+    ::group_by_device(params_);
+
+  if (loss_scaling_) {
+    if (!::has_finite_gradients(groups)) {
+      // Skips this update and retries with the smaller scale.
+      loss_scale_ = std::max(1.f, loss_scale_ / 2);
+      num_finite_updates_ = 0;
+      return;
+    }
+    const float inv_scale = 1.f / loss_scale_;
+    for (const auto &group : groups) {
+      for (Parameter *param : group) param->gradient() *= inv_scale;
+    }
+    if (++num_finite_updates_ >= growth_interval_) {
+      loss_scale_ *= 2;
+      num_finite_updates_ = 0;
+    }
+  }
+
+  if (max_gradient_norm_ > 0) ::clip_gradients(groups, max_gradient_norm_);
+
+  for (const auto &group : groups) {
+    // Parameters with sparse gradients are updated separately.
+    std::vector<Parameter *> dense;
+    for (Parameter *param : group) {
+      if (param->has_sparse_gradient()) update_parameter_rows(scale, *param);
+      else dense.emplace_back(param);
+    }
+    if (!dense.empty()) update_parameters(scale, dense);
   }
   update_epoch();
 }
 
+void Trainer::enable_loss_scaling(
+    float initial_scale, unsigned growth_interval) {
+  if (!::is_finite(initial_scale) || initial_scale < 1) {
+    THROW_ERROR("Invalid initial scale: " << initial_scale);
+  }
+  if (growth_interval == 0) {
+    THROW_ERROR("growth_interval should be greater than 0.");
+  }
+  loss_scaling_ = true;
+  loss_scale_ = initial_scale;
+  growth_interval_ = growth_interval;
+  num_finite_updates_ = 0;
+}
+
+void Trainer::disable_loss_scaling() {
+  loss_scaling_ = false;
+  loss_scale_ = 1;
+  num_finite_updates_ = 0;
+}
+
+void Trainer::enable_gradient_clipping(float max_norm) {
+  if (!::is_finite(max_norm) || !(max_norm > 0)) {
+    THROW_ERROR("Invalid threshold of the gradient norm: " << max_norm);
+  }
+  max_gradient_norm_ = max_norm;
+}
+
+void Trainer::disable_gradient_clipping() {
+  max_gradient_norm_ = 0;
+}
+
+float Trainer::gradient_norm() const {
+  double sum = 0;
+  for (const Tensor &sq_norm : ::squared_gradient_norms(
+        ::group_by_device(params_))) {
+    sum += sq_norm.to_vector()[0];
+  }
+  return std::sqrt(sum);
+}
+
+void Trainer::update_parameters(
+    float scale, const std::vector<Parameter *> &params) {
+  for (Parameter *param : params) {
+    update_parameter(scale, *param);
+  }
+}
+
+void Trainer::update_parameter_rows(float scale, Parameter &param) {
+  update_parameter(scale, param);
+}
+
+
+void Trainer::pack_parameters(bool pack_values) {
+  // Groups parameters by their devices.
+  std::vector<PackedBuffer> packed;
+  for (const auto &kv : params_) {
+    Device *dev = kv.second->device();
+    auto it = std::find_if(
+        packed.begin(), packed.end(),
+        [dev](const PackedBuffer &buf) { return buf.device == dev; });
+    if (it == packed.end()) {
+      packed.emplace_back();
+      it = packed.end() - 1;
+      it->device = dev;
+    }
+    it->params.emplace_back(kv.second);
+  }
+
+  for (PackedBuffer &buf : packed) {
+    unsigned total = 0;
+    for (Parameter *param : buf.params) {
+      buf.offsets.emplace_back(total);
+      total += param->shape().size();
+    }
+    const Shape shape({total});
+
+    buf.gradients = buf.device->new_tensor(shape);
+    for (unsigned i = 0; i < buf.params.size(); ++i) {
+      ::move_to_view(buf.gradients, buf.offsets[i], buf.params[i]->gradient());
+    }
+    if (!pack_values) continue;
+
+    buf.values = buf.device->new_tensor(shape);
+    for (unsigned i = 0; i < buf.params.size(); ++i) {
+      ::move_to_view(buf.values, buf.offsets[i], buf.params[i]->value());
+    }
+
+    // Packs statistics which all parameters have.
+    std::vector<std::string> names;
+    for (const std::string &name : buf.params.front()->stats_names()) {
+      if (std::all_of(
+            buf.params.begin(), buf.params.end(),
+            [&name](Parameter *p) { return p->has_stats(name); })) {
+        names.emplace_back(name);
+      }
+    }
+    for (const std::string &name : names) {
+      Tensor &stats = buf.stats[name] = buf.device->new_tensor(shape);
+      for (unsigned i = 0; i < buf.params.size(); ++i) {
+        ::move_to_view(stats, buf.offsets[i], buf.params[i]->stats(name));
+      }
+    }
+  }
+
+  packed_ = std::move(packed);
+  packed_params_.clear();
+  for (const auto &kv : params_) packed_params_.emplace(kv.second);
+}
+
+Trainer::PackedBuffer &Trainer::packed_buffer(Device *device) {
+  for (PackedBuffer &buf : packed_) {
+    if (buf.device == device) return buf;
+  }
+  THROW_ERROR("No parameters on the device are packed: " << device);
+}
+
+Tensor &Trainer::packed_gradients(Device *device) {
+  return packed_buffer(device).gradients;
+}
+
+Tensor &Trainer::packed_values(Device *device) {
+  PackedBuffer &buf = packed_buffer(device);
+  if (!buf.values.valid()) {
+    THROW_ERROR("Values of parameters on the device are not packed.");
+  }
+  return buf.values;
+}
+
 }  // namespace primitiv
@@ -1,10 +1,15 @@
 #ifndef PRIMITIV_TRAINER_H_
 #define PRIMITIV_TRAINER_H_
 
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <primitiv/tensor.h>
 
 namespace primitiv {
 
+class Device;
 class Parameter;
 
 /**
@@ -12,7 +17,9 @@ class Parameter;
  */
 class Trainer {
 public:
-  Trainer() = default;
+  Trainer()
+    : loss_scaling_(false), loss_scale_(1), growth_interval_(0)
+    , num_finite_updates_(0), max_gradient_norm_(0) {}
   Trainer(const Trainer &) = default;
   Trainer(Trainer &&) = default;
   Trainer &operator=(const Trainer &) = default;
@@ -25,6 +32,28 @@ public:
    */
   void add_parameter(Parameter *param);
 
+  /**
+   * Retrieves registered parameters.
+   * @return List of parameters in the ascending order of their names.
+   */
+  std::vector<Parameter *> parameters() const;
+
+  /**
+   * Retrieves internal states of the trainer, e.g., epoch counters.
+   * @return Map from names to values of states.
+   * @remarks States held by parameters (statistics) are not included.
+   *          The default implementation returns an empty map.
+   */
+  virtual std::unordered_map<std::string, unsigned> get_states() const;
+
+  /**
+   * Restores internal states of the trainer.
+   * @param states Map returned by `get_states()` of the same kind of trainer.
+   * @remarks The default implementation does nothing.
+   */
+  virtual void set_states(
+      const std::unordered_map<std::string, unsigned> &states);
+
   /**
    * Resets all gradients of registered parameters.
    */
@@ -33,11 +62,129 @@ public:
   /**
    * Updates parameter values.
    * @param scale Additional learning rate scaling factor.
+   * @remarks If the loss scaling is enabled, gradients are divided by
+   *          `loss_scale()` before the update. If any gradient has non-finite
+   *          values, the update is skipped and the scale is halved.
+   *          If the gradient clipping is enabled, gradients are clipped
+   *          after the loss scaling.
+   *          Values are updated in place only if their memory is not shared.
+   *          A Graph keeps copies of parameter values used by
+   *          `node_ops::input()`, and each of them is duplicated here while
+   *          the graph holds it (see `Tensor::num_copy_on_writes()`).
+   *          To avoid the duplication, destroy or clear the graph before this
+   *          function, or use `Graph::RELEASE_POLICY_TRAINING`, which
+   *          releases the values in `backward()`.
    */
   void update(float scale);
 
+  /**
+   * Enables the dynamic loss scaling for reduced precision calculations.
+   * The loss should be multiplied by `loss_scale()` before the backward
+   * calculation so that small gradients do not underflow.
+   * @param initial_scale Initial value of the scale.
+   * @param growth_interval Number of consecutive successful updates to double
+   *                        the scale.
+   */
+  void enable_loss_scaling(
+      float initial_scale = 65536, unsigned growth_interval = 2000);
+
+  /**
+   * Disables the loss scaling.
+   */
+  void disable_loss_scaling();
+
+  /**
+   * Retrieves the current scale of the loss.
+   * @return The scale, or 1 if the loss scaling is disabled.
+   */
+  float loss_scale() const { return loss_scale_; }
+
+  /**
+   * Enables the clipping of gradients by their global L2 norm. Before each
+   * update, all gradients are multiplied by `min(1, max_norm / norm)`, where
+   * `norm` is the L2 norm of all gradients of registered parameters.
+   * @param max_norm Threshold of the global norm.
+   * @remarks The norm is calculated and applied on the devices. If parameters
+   *          are distributed to multiple devices, only the partial norm of
+   *          each device is exchanged.
+   */
+  void enable_gradient_clipping(float max_norm);
+
+  /**
+   * Disables the gradient clipping.
+   */
+  void disable_gradient_clipping();
+
+  /**
+   * Retrieves the threshold of the gradient clipping.
+   * @return The threshold, or 0 if the gradient clipping is disabled.
+   */
+  float max_gradient_norm() const { return max_gradient_norm_; }
+
+  /**
+   * Calculates the global L2 norm of current gradients.
+   * @return The norm of all gradients of registered parameters.
+   * @remarks This function waits for gradients and transfers one value from
+   *          each device.
+   */
+  float gradient_norm() const;
+
+  /**
+   * Packs registered parameters into contiguous buffers for each device.
+   * @param pack_values If true, values and statistics of parameters are also
+   *                    packed in addition to gradients.
+   * @remarks After this call, packed tensors of each parameter become views
+   *          of the buffer, and `reset_gradients()` resets all gradients on
+   *          the same device by one operation. Parameters registered after
+   *          this call are not packed until this method is called again.
+   *          Statistics are packed only if all parameters on the device have
+   *          them.
+   */
+  void pack_parameters(bool pack_values = false);
+
+  /**
+   * Retrieves the packed gradients of parameters on the device.
+   * @param device Device of parameters.
+   * @return Flat tensor whose parts are shared with gradients of parameters.
+   */
+  Tensor &packed_gradients(Device *device);
+
+  /**
+   * Retrieves the packed values of parameters on the device.
+   * @param device Device of parameters.
+   * @return Flat tensor whose parts are shared with values of parameters.
+   * @remarks This method throws if values are not packed.
+   */
+  Tensor &packed_values(Device *device);
+
 private:
+  /**
+   * Contiguous buffers of parameters on the same device.
+   */
+  struct PackedBuffer {
+    Device *device;
+    std::vector<Parameter *> params;
+    std::vector<unsigned> offsets;
+    Tensor gradients;
+    Tensor values;
+    std::unordered_map<std::string, Tensor> stats;
+  };
+
+  /**
+   * Retrieves the packed buffer of the device.
+   * @param device Device of parameters.
+   * @return Packed buffer.
+   */
+  PackedBuffer &packed_buffer(Device *device);
+
   std::unordered_map<std::string, Parameter *> params_;
+  std::vector<PackedBuffer> packed_;
+  std::unordered_set<Parameter *> packed_params_;
+  bool loss_scaling_;
+  float loss_scale_;
+  unsigned growth_interval_;
+  unsigned num_finite_updates_;
+  float max_gradient_norm_;
 
   /**
    * Event handler on adding a new parameter.
@@ -52,6 +199,28 @@ private:
    */
   virtual void update_parameter(float scale, Parameter &param) = 0;
 
+  /**
+   * Updates multiple parameters on the same device.
+   * @param scale Additional learning rate scaling factor.
+   * @param params Parameters to be updated.
+   * @remarks The default implementation calls `update_parameter()` for each
+   *          parameter. Subclasses may override this method to update all
+   *          parameters by a few device operations.
+   */
+  virtual void update_parameters(
+      float scale, const std::vector<Parameter *> &params);
+
+  /**
+   * Updates only slices of a parameter which have the sparse gradient.
+   * @param scale Additional learning rate scaling factor.
+   * @param param Parameter to be updated. `param.has_sparse_gradient()` is
+   *              always true.
+   * @remarks The default implementation calls `update_parameter()`, which
+   *          updates the whole parameter. Subclasses may override this method
+   *          to update only `param.gradient_rows()` lazily.
+   */
+  virtual void update_parameter_rows(float scale, Parameter &param);
+
   /**
    * Updates internal states of the trainer.
    */
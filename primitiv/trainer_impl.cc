@@ -1,7 +1,7 @@
 #include <config.h>
 
-#include <algorithm>
-#include <cmath>
+#include <primitiv/device.h>
+#include <primitiv/error.h>
 #include <primitiv/parameter.h>
 #include <primitiv/tensor_ops.h>
 #include <primitiv/trainer_impl.h>
@@ -12,11 +12,62 @@ namespace trainers {
 void SGD::configure_parameter(Parameter &param) {}
 
 void SGD::update_parameter(float scale, Parameter &param) {
-  param.value() -= (scale * eta_) * param.gradient();
+  Tensor &x = param.value();
+  x.device()->sgd_update(scale * eta_, param.gradient(), x);
+}
+
+void SGD::update_parameters(
+    float scale, const std::vector<Parameter *> &params) {
+  std::vector<const Tensor *> gs;
+  std::vector<Tensor *> xs;
+  for (Parameter *param : params) {
+    gs.emplace_back(&param->gradient());
+    xs.emplace_back(&param->value());
+  }
+  params.front()->device()->sgd_update(scale * eta_, gs, xs);
+}
+
+void SGD::update_parameter_rows(float scale, Parameter &param) {
+  const unsigned dim = param.gradient_dim();
+  const std::vector<unsigned> &rows = param.gradient_rows();
+  Tensor &x = param.value();
+  x.device()->pick_bw(
+      tensor_ops::pick(param.gradient(), dim, rows) * (-scale * eta_),
+      dim, rows, x);
 }
 
 void SGD::update_epoch() {}
 
+void MomentumSGD::configure_parameter(Parameter &param) {
+  const char *name = "momentumsgd-m";
+  if (!param.has_stats(name)) {
+    param.add_stats(name, param.shape());
+    param.stats(name).reset(0);
+  }
+}
+
+void MomentumSGD::update_parameter(float scale, Parameter &param) {
+  Tensor &x = param.value();
+  x.device()->momentum_sgd_update(
+      scale * eta_, momentum_, param.gradient(),
+      param.stats("momentumsgd-m"), x);
+}
+
+void MomentumSGD::update_parameters(
+    float scale, const std::vector<Parameter *> &params) {
+  std::vector<const Tensor *> gs;
+  std::vector<Tensor *> ms, xs;
+  for (Parameter *param : params) {
+    gs.emplace_back(&param->gradient());
+    ms.emplace_back(&param->stats("momentumsgd-m"));
+    xs.emplace_back(&param->value());
+  }
+  params.front()->device()->momentum_sgd_update(
+      scale * eta_, momentum_, gs, ms, xs);
+}
+
+void MomentumSGD::update_epoch() {}
+
 void Adam::configure_parameter(Parameter &param) {
   for (const char *name : {"adam-m1", "adam-m2"}) {
     if (!param.has_stats(name)) {
@@ -27,19 +78,60 @@ void Adam::configure_parameter(Parameter &param) {
 }
 
 void Adam::update_parameter(float scale, Parameter &param) {
-  const Tensor &g = param.gradient();
+  Tensor &x = param.value();
+  x.device()->adam_update(
+      scale * alpha_, beta1_, beta2_, eps_, epoch_, param.gradient(),
+      param.stats("adam-m1"), param.stats("adam-m2"), x);
+}
+
+void Adam::update_parameters(
+    float scale, const std::vector<Parameter *> &params) {
+  std::vector<const Tensor *> gs;
+  std::vector<Tensor *> m1s, m2s, xs;
+  for (Parameter *param : params) {
+    gs.emplace_back(&param->gradient());
+    m1s.emplace_back(&param->stats("adam-m1"));
+    m2s.emplace_back(&param->stats("adam-m2"));
+    xs.emplace_back(&param->value());
+  }
+  params.front()->device()->adam_update(
+      scale * alpha_, beta1_, beta2_, eps_, epoch_, gs, m1s, m2s, xs);
+}
+
+void Adam::update_parameter_rows(float scale, Parameter &param) {
+  // Statistics of slices without gradients are not decayed (lazy Adam).
+  const unsigned dim = param.gradient_dim();
+  const std::vector<unsigned> &rows = param.gradient_rows();
+  Tensor &x = param.value();
   Tensor &m1 = param.stats("adam-m1");
   Tensor &m2 = param.stats("adam-m2");
-  m1 = beta1_ * m1 + (1 - beta1_) * g;
-  m2 = beta2_ * m2 + (1 - beta2_) * g * g;
-  const Tensor mm1 = m1 / (1 - std::pow(beta1_, epoch_));
-  const Tensor mm2 = m2 / (1 - std::pow(beta2_, epoch_));
-  param.value() -= (scale * alpha_) * mm1 / (tensor_ops::sqrt(mm2) + eps_);
+  const Tensor g = tensor_ops::pick(param.gradient(), dim, rows);
+  const Tensor x0 = tensor_ops::pick(x, dim, rows);
+  const Tensor m10 = tensor_ops::pick(m1, dim, rows);
+  const Tensor m20 = tensor_ops::pick(m2, dim, rows);
+  // NOTE: Copies share the memory until adam_update() writes them.
+  Tensor x1 = x0, m11 = m10, m21 = m20;
+  x.device()->adam_update(
+      scale * alpha_, beta1_, beta2_, eps_, epoch_, g, m11, m21, x1);
+  x.device()->pick_assign(x1, dim, rows, x);
+  x.device()->pick_assign(m11, dim, rows, m1);
+  x.device()->pick_assign(m21, dim, rows, m2);
 }
 
 void Adam::update_epoch() {
   ++epoch_;
 }
 
+std::unordered_map<std::string, unsigned> Adam::get_states() const {
+  return {{"epoch", epoch_}};
+}
+
+void Adam::set_states(const std::unordered_map<std::string, unsigned> &states) {
+  const auto it = states.find("epoch");
+  if (it == states.end()) THROW_ERROR("Adam requires the state 'epoch'.");
+  if (it->second == 0) THROW_ERROR("The epoch of Adam should be positive.");
+  epoch_ = it->second;
+}
+
 }  // namespace trainers
 }  // namespace primitiv
@@ -10,10 +10,14 @@ namespace trainers {
 private: \
   void configure_parameter(Parameter &param) override; \
   void update_parameter(float scale, Parameter &param) override; \
+  void update_parameters( \
+      float scale, const std::vector<Parameter *> &params) override; \
   void update_epoch() override;
 
 /**
  * Simple stochastic gradient descent.
+ * @remarks For sparse gradients, only the slices which have gradients are
+ *          updated.
  */
 class SGD : public primitiv::Trainer {
   DECL_DEFAULTS(SGD);
@@ -32,12 +36,48 @@ public:
   float eta() const { return eta_; }
 
 private:
+  void update_parameter_rows(float scale, Parameter &param) override;
+
   float eta_;
 };
 
+/**
+ * Stochastic gradient descent with momentum.
+ */
+class MomentumSGD : public primitiv::Trainer {
+  DECL_DEFAULTS(MomentumSGD);
+
+public:
+  /**
+   * Creates a new MomentumSGD object.
+   * @param eta Learning rate.
+   * @param momentum Decay factor of the velocity.
+   */
+  MomentumSGD(float eta = 0.01, float momentum = 0.9)
+    : eta_(eta), momentum_(momentum) {}
+
+  /**
+   * Returns the learning rate.
+   * @return Learning rate.
+   */
+  float eta() const { return eta_; }
+
+  /**
+   * Returns the momentum.
+   * @return Decay factor of the velocity.
+   */
+  float momentum() const { return momentum_; }
+
+private:
+  float eta_;
+  float momentum_;
+};
+
 /**
  * Adam optimizer.
  * https://arxiv.org/abs/1412.6980
+ * @remarks For sparse gradients, only the slices which have gradients and
+ *          their statistics are updated (lazy Adam).
  */
 class Adam : public primitiv::Trainer {
   DECL_DEFAULTS(Adam);
@@ -85,7 +125,22 @@ public:
    */
   unsigned epoch() const { return epoch_; }
 
+  /**
+   * Retrieves internal states.
+   * @return Map with the key "epoch".
+   */
+  std::unordered_map<std::string, unsigned> get_states() const override;
+
+  /**
+   * Restores internal states.
+   * @param states Map with the key "epoch".
+   */
+  void set_states(
+      const std::unordered_map<std::string, unsigned> &states) override;
+
 private:
+  void update_parameter_rows(float scale, Parameter &param) override;
+
   float alpha_;
   float beta1_;
   float beta2_;
@@ -0,0 +1,161 @@
+#include <config.h>
+
+#include <cstdint>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/arena_allocator.h>
+#include <primitiv/error.h>
+
+using std::vector;
+
+namespace primitiv {
+
+class ArenaAllocatorTest : public testing::Test {
+protected:
+  // NOTE: ArenaAllocator never touches the memory, so that fake addresses are
+  //       sufficient.
+  static void *addr(std::uintptr_t x) { return reinterpret_cast<void *>(x); }
+};
+
+TEST_F(ArenaAllocatorTest, CheckNew) {
+  ArenaAllocator arena(256);
+  EXPECT_EQ(256u, arena.alignment());
+  EXPECT_EQ(0u, arena.bytes_in_use());
+  EXPECT_EQ(0u, arena.bytes_total());
+  EXPECT_EQ(0u, arena.num_segments());
+  EXPECT_EQ(0u, arena.largest_free_block());
+  EXPECT_EQ(nullptr, arena.allocate(1));
+}
+
+TEST_F(ArenaAllocatorTest, CheckInvalidNew) {
+  EXPECT_THROW(ArenaAllocator(0), Error);
+  EXPECT_THROW(ArenaAllocator(3), Error);
+  EXPECT_THROW(ArenaAllocator(96), Error);
+}
+
+TEST_F(ArenaAllocatorTest, CheckRoundUp) {
+  ArenaAllocator arena(256);
+  EXPECT_EQ(0u, arena.round_up(0));
+  EXPECT_EQ(256u, arena.round_up(1));
+  EXPECT_EQ(256u, arena.round_up(256));
+  EXPECT_EQ(512u, arena.round_up(257));
+}
+
+TEST_F(ArenaAllocatorTest, CheckInvalidSegment) {
+  ArenaAllocator arena(256);
+  EXPECT_THROW(arena.add_segment(addr(0x1080), 0x1000), Error);
+  EXPECT_THROW(arena.add_segment(addr(0x1000), 0x1080), Error);
+  EXPECT_THROW(arena.add_segment(addr(0x1000), 0), Error);
+  EXPECT_NO_THROW(arena.add_segment(addr(0x1000), 0x1000));
+  EXPECT_THROW(arena.add_segment(addr(0x1000), 0x1000), Error);
+}
+
+TEST_F(ArenaAllocatorTest, CheckSplit) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x1000);
+  EXPECT_EQ(addr(0x10000), arena.allocate(1));
+  EXPECT_EQ(addr(0x10100), arena.allocate(0x200));
+  EXPECT_EQ(addr(0x10300), arena.allocate(0x100));
+  EXPECT_EQ(0x400u, arena.bytes_in_use());
+  EXPECT_EQ(0x1000u, arena.bytes_total());
+  EXPECT_EQ(0xc00u, arena.largest_free_block());
+  EXPECT_EQ(addr(0x10400), arena.allocate(0xc00));
+  EXPECT_EQ(0u, arena.largest_free_block());
+  EXPECT_EQ(nullptr, arena.allocate(1));
+}
+
+TEST_F(ArenaAllocatorTest, CheckBestFit) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x1000);
+  vector<void *> ptrs;
+  for (unsigned i = 0; i < 16; ++i) ptrs.emplace_back(arena.allocate(0x100));
+  // Makes holes: [0x300] [0x100] [0x200]
+  EXPECT_EQ(0x100u, arena.free(ptrs[1]));
+  EXPECT_EQ(0x100u, arena.free(ptrs[2]));
+  EXPECT_EQ(0x100u, arena.free(ptrs[3]));
+  EXPECT_EQ(0x100u, arena.free(ptrs[6]));
+  EXPECT_EQ(0x100u, arena.free(ptrs[9]));
+  EXPECT_EQ(0x100u, arena.free(ptrs[10]));
+  EXPECT_EQ(0x300u, arena.largest_free_block());
+  // The smallest hole which fits is selected.
+  EXPECT_EQ(ptrs[6], arena.allocate(0x100));
+  EXPECT_EQ(ptrs[9], arena.allocate(0x200));
+  EXPECT_EQ(ptrs[1], arena.allocate(0x100));
+  EXPECT_EQ(ptrs[2], arena.allocate(0x200));
+  EXPECT_EQ(nullptr, arena.allocate(0x100));
+}
+
+TEST_F(ArenaAllocatorTest, CheckCoalesce) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x400);
+  void *p0 = arena.allocate(0x100);
+  void *p1 = arena.allocate(0x100);
+  void *p2 = arena.allocate(0x100);
+  void *p3 = arena.allocate(0x100);
+  arena.free(p0);
+  arena.free(p2);
+  EXPECT_EQ(0x100u, arena.largest_free_block());
+  // p1 is merged with both neighbors.
+  arena.free(p1);
+  EXPECT_EQ(0x300u, arena.largest_free_block());
+  arena.free(p3);
+  EXPECT_EQ(0x400u, arena.largest_free_block());
+  EXPECT_EQ(0u, arena.bytes_in_use());
+  EXPECT_EQ(addr(0x10000), arena.allocate(0x400));
+}
+
+TEST_F(ArenaAllocatorTest, CheckNoCoalesceOverSegments) {
+  ArenaAllocator arena(256);
+  // Two adjacent segments.
+  arena.add_segment(addr(0x10000), 0x200);
+  arena.add_segment(addr(0x10200), 0x200);
+  EXPECT_EQ(2u, arena.num_segments());
+  EXPECT_EQ(0x200u, arena.largest_free_block());
+  EXPECT_EQ(nullptr, arena.allocate(0x300));
+  void *p0 = arena.allocate(0x200);
+  void *p1 = arena.allocate(0x200);
+  arena.free(p0);
+  arena.free(p1);
+  EXPECT_EQ(0x200u, arena.largest_free_block());
+}
+
+TEST_F(ArenaAllocatorTest, CheckInvalidFree) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x1000);
+  void *p = arena.allocate(0x100);
+  EXPECT_THROW(arena.free(addr(0x10080)), Error);
+  EXPECT_THROW(arena.free(addr(0x20000)), Error);
+  arena.free(p);
+  EXPECT_THROW(arena.free(p), Error);
+}
+
+TEST_F(ArenaAllocatorTest, CheckRemoveFreeSegments) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x1000);
+  arena.add_segment(addr(0x20000), 0x1000);
+  arena.add_segment(addr(0x30000), 0x1000);
+  void *p1 = arena.allocate(0x1000);
+  void *p2 = arena.allocate(0x800);
+  EXPECT_EQ(addr(0x10000), p1);
+  EXPECT_EQ(addr(0x20000), p2);
+  arena.free(p1);
+  const vector<void *> removed = arena.remove_free_segments();
+  EXPECT_EQ((vector<void *> {addr(0x10000), addr(0x30000)}), removed);
+  EXPECT_EQ(1u, arena.num_segments());
+  EXPECT_EQ(0x1000u, arena.bytes_total());
+  EXPECT_EQ(0x800u, arena.bytes_in_use());
+  EXPECT_EQ(nullptr, arena.allocate(0x1000));
+  arena.free(p2);
+  EXPECT_EQ(vector<void *> {addr(0x20000)}, arena.remove_free_segments());
+  EXPECT_EQ(0u, arena.num_segments());
+  EXPECT_EQ(0u, arena.bytes_total());
+}
+
+TEST_F(ArenaAllocatorTest, CheckTooLarge) {
+  ArenaAllocator arena(256);
+  arena.add_segment(addr(0x10000), 0x1000);
+  EXPECT_EQ(nullptr, arena.allocate(~0ull));
+  EXPECT_EQ(nullptr, arena.allocate(0x1001));
+}
+
+}  // namespace primitiv
@@ -0,0 +1,174 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/beam_search.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
+#include <primitiv/graph.h>
+#include <primitiv/node_ops.h>
+#include <test_utils.h>
+
+using std::vector;
+
+namespace primitiv {
+
+namespace {
+
+const unsigned BOS = 3;
+const unsigned EOS = 0;
+const unsigned VOCAB = 4;
+
+}  // namespace
+
+class BeamSearchTest : public testing::Test {
+protected:
+  CPUDevice dev;
+  Graph g;
+
+  // Logits of the next token given the last token.
+  const vector<float> table {
+    0, 0, 0, 0,
+    .3, .2, -.7, 0,
+    -.3, .5, .1, 0,
+    -2, .1, .4, -1,
+  };
+
+  // Log-probabilities of the model with the history of tokens: the logits
+  // depend on the last token and the sum of all tokens.
+  vector<float> host_scores(const vector<unsigned> &history) const {
+    float sum = 0;
+    for (const unsigned id : history) sum += id;
+    vector<float> ret(VOCAB);
+    float z = 0;
+    for (unsigned v = 0; v < VOCAB; ++v) {
+      ret[v] = table[history.back() * VOCAB + v] + .1 * sum * v;
+      z += std::exp(ret[v]);
+    }
+    for (float &r : ret) r -= std::log(z);
+    return ret;
+  }
+
+  // Calculates the same model by the graph. The sum of tokens is kept as a
+  // state of each hypothesis.
+  BeamSearch::StepFunction make_step(Node &state) {
+    namespace F = node_ops;
+    return [this, &state](
+        const vector<unsigned> &ids, const vector<unsigned> &parents) {
+      const unsigned bs = ids.size();
+      vector<float> logits, tokens;
+      for (const unsigned id : ids) {
+        logits.insert(
+            logits.end(),
+            table.begin() + id * VOCAB, table.begin() + (id + 1) * VOCAB);
+        tokens.emplace_back(id);
+      }
+      state = F::batch::pick(state, parents) +
+        F::input(Shape({1}, bs), tokens, &dev, &g);
+      const Node c = F::input(Shape({VOCAB}), {0, .1, .2, .3}, &dev, &g);
+      const Node t = F::input(Shape({VOCAB}, bs), logits, &dev, &g);
+      return F::log_softmax(t + F::broadcast(state, 0, VOCAB) * c, 0);
+    };
+  }
+
+  // Enumerates all sequences up to `max_length` tokens.
+  void enumerate(
+      vector<unsigned> &history, float score, unsigned max_length,
+      vector<BeamSearch::Hypothesis> &hyps) const {
+    const vector<float> scores = host_scores(history);
+    for (unsigned v = 0; v < VOCAB; ++v) {
+      history.emplace_back(v);
+      if (v == EOS || history.size() == max_length + 1) {
+        hyps.push_back(
+            {vector<unsigned>(history.begin() + 1, history.end()),
+             score + scores[v]});
+      } else {
+        enumerate(history, score + scores[v], max_length, hyps);
+      }
+      history.pop_back();
+    }
+  }
+};
+
+TEST_F(BeamSearchTest, CheckExhaustive) {
+  // Beam search with a large beam is the same as the exhaustive search.
+  const unsigned max_length = 3;
+  vector<unsigned> history {BOS};
+  vector<BeamSearch::Hypothesis> expected;
+  enumerate(history, 0, max_length, expected);
+  std::stable_sort(
+      expected.begin(), expected.end(),
+      [](const BeamSearch::Hypothesis &a, const BeamSearch::Hypothesis &b) {
+        return a.score > b.score;
+      });
+  ASSERT_EQ(40u, expected.size());
+
+  Node state = node_ops::zeros({1}, &dev, &g);
+  const BeamSearch bs(27, BOS, EOS, max_length);
+  EXPECT_EQ(27u, bs.beam_size());
+  EXPECT_EQ(max_length, bs.max_length());
+  const vector<BeamSearch::Hypothesis> hyps = bs.decode(make_step(state));
+  ASSERT_EQ(27u, hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i) {
+    EXPECT_EQ(expected[i].ids, hyps[i].ids);
+    EXPECT_NEAR(expected[i].score, hyps[i].score, 1e-5);
+  }
+}
+
+TEST_F(BeamSearchTest, CheckGreedy) {
+  // Beam size 1 selects the best token at every step.
+  const unsigned max_length = 6;
+  vector<unsigned> history {BOS};
+  float score = 0;
+  while (history.size() <= max_length && history.back() != EOS) {
+    const vector<float> scores = host_scores(history);
+    const unsigned best =
+      std::max_element(scores.begin(), scores.end()) - scores.begin();
+    history.emplace_back(best);
+    score += scores[best];
+  }
+
+  Node state = node_ops::zeros({1}, &dev, &g);
+  const vector<BeamSearch::Hypothesis> hyps =
+    BeamSearch(1, BOS, EOS, max_length).decode(make_step(state));
+  ASSERT_EQ(1u, hyps.size());
+  EXPECT_EQ(vector<unsigned>(history.begin() + 1, history.end()), hyps[0].ids);
+  EXPECT_NEAR(score, hyps[0].score, 1e-5);
+}
+
+TEST_F(BeamSearchTest, CheckEarlyStop) {
+  // The terminal token is always the best, and the second step is required
+  // only to confirm that no live hypothesis is better.
+  unsigned num_steps = 0;
+  const auto step = [&](
+      const vector<unsigned> &ids, const vector<unsigned> &) {
+    ++num_steps;
+    const unsigned bs = ids.size();
+    vector<float> data;
+    for (unsigned b = 0; b < bs; ++b) {
+      data.insert(data.end(), {-.1, -3, -4, -5});
+    }
+    return node_ops::input(Shape({VOCAB}, bs), data, &dev, &g);
+  };
+  const vector<BeamSearch::Hypothesis> hyps =
+    BeamSearch(2, BOS, EOS, 100).decode(step);
+  EXPECT_EQ(2u, num_steps);
+  ASSERT_EQ(2u, hyps.size());
+  EXPECT_EQ(vector<unsigned> {0}, hyps[0].ids);
+  EXPECT_EQ((vector<unsigned> {1, 0}), hyps[1].ids);
+  EXPECT_FLOAT_EQ(-.1, hyps[0].score);
+  EXPECT_FLOAT_EQ(-3.1, hyps[1].score);
+}
+
+TEST_F(BeamSearchTest, CheckInvalid) {
+  EXPECT_THROW(BeamSearch(0, BOS, EOS, 10), Error);
+  EXPECT_THROW(BeamSearch(2, BOS, EOS, 0), Error);
+  const auto step = [&](const vector<unsigned> &, const vector<unsigned> &) {
+    return node_ops::zeros(Shape({VOCAB}, 2), &dev, &g);
+  };
+  EXPECT_THROW(BeamSearch(2, BOS, EOS, 10).decode(step), Error);
+}
+
+}  // namespace primitiv
@@ -0,0 +1,78 @@
+#include <config.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include <primitiv/binary_io.h>
+#include <primitiv/error.h>
+
+using std::string;
+
+namespace primitiv {
+
+class BinaryIOTest : public testing::Test {};
+
+TEST_F(BinaryIOTest, CheckReadWrite) {
+  std::ostringstream oss;
+  BinaryWriter writer(oss);
+  writer.write<std::uint32_t>(42);
+  writer.write_string("hello");
+  writer.write_shape(Shape({2, 3}, 4));
+  EXPECT_EQ(4u + 4u + 5u + 16u, writer.position());
+  writer.pad(16);
+  EXPECT_EQ(32u, writer.position());
+  writer.write<float>(1.5f);
+  EXPECT_EQ(36u, writer.position());
+
+  const string data = oss.str();
+  ASSERT_EQ(36u, data.size());
+  BinaryReader reader(data.data(), data.size());
+  EXPECT_EQ(42u, reader.read<std::uint32_t>());
+  EXPECT_EQ("hello", reader.read_string());
+  EXPECT_EQ(Shape({2, 3}, 4), reader.read_shape());
+  reader.seek(32);
+  EXPECT_EQ(1.5f, reader.read<float>());
+  EXPECT_EQ(36u, reader.position());
+}
+
+TEST_F(BinaryIOTest, CheckInvalidRead) {
+  const char data[6] = {1, 0, 0, 0, 0, 0};
+  BinaryReader reader(data, sizeof(data));
+  EXPECT_EQ(1u, reader.read<std::uint32_t>());
+  EXPECT_THROW(reader.read<std::uint32_t>(), Error);
+  EXPECT_EQ(4u, reader.position());
+  EXPECT_THROW(reader.seek(7), Error);
+  reader.seek(6);
+  EXPECT_THROW(reader.read<std::uint8_t>(), Error);
+  reader.seek(4);
+  EXPECT_THROW(reader.read_string(), Error);
+}
+
+TEST_F(BinaryIOTest, CheckMappedFile) {
+  const string path = "/tmp/primitiv_BinaryIOTest_CheckMappedFile.bin";
+  {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << "primitiv";
+  }
+  const MappedFile file(path);
+  ASSERT_EQ(8u, file.size());
+  EXPECT_EQ("primitiv", string(file.data(), file.size()));
+}
+
+TEST_F(BinaryIOTest, CheckMappedEmptyFile) {
+  const string path = "/tmp/primitiv_BinaryIOTest_CheckMappedEmptyFile.bin";
+  {
+    std::ofstream ofs(path, std::ios::binary);
+  }
+  const MappedFile file(path);
+  EXPECT_EQ(0u, file.size());
+  EXPECT_EQ(nullptr, file.data());
+}
+
+TEST_F(BinaryIOTest, CheckInvalidMappedFile) {
+  EXPECT_THROW(MappedFile("/tmp/primitiv_BinaryIOTest_no_such_file"), Error);
+}
+
+}  // namespace primitiv
@@ -0,0 +1,146 @@
+#include <config.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/bump_arena.h>
+#include <primitiv/error.h>
+
+using std::vector;
+
+namespace primitiv {
+
+class BumpArenaTest : public testing::Test {
+protected:
+  static std::uintptr_t addr(const void *ptr) {
+    return reinterpret_cast<std::uintptr_t>(ptr);
+  }
+};
+
+TEST_F(BumpArenaTest, CheckNew) {
+  BumpArena arena(1024);
+  EXPECT_EQ(0u, arena.bytes_in_use());
+  EXPECT_EQ(0u, arena.bytes_total());
+  EXPECT_EQ(0u, arena.num_chunks());
+}
+
+TEST_F(BumpArenaTest, CheckAllocate) {
+  BumpArena arena(1024);
+  char *p1 = static_cast<char *>(arena.allocate(3, 1));
+  EXPECT_EQ(1u, arena.num_chunks());
+  EXPECT_EQ(1024u, arena.bytes_total());
+  EXPECT_EQ(3u, arena.bytes_in_use());
+
+  // Blocks are placed contiguously with paddings for the alignment.
+  void *p2 = arena.allocate(8, 8);
+  EXPECT_EQ(p1 + 8, p2);
+  EXPECT_EQ(16u, arena.bytes_in_use());
+  void *p3 = arena.allocate(1, 2);
+  EXPECT_EQ(p1 + 16, p3);
+  void *p4 = arena.allocate(0, 4);
+  EXPECT_EQ(p1 + 20, p4);
+  EXPECT_EQ(21u, arena.bytes_in_use());
+  EXPECT_EQ(1u, arena.num_chunks());
+}
+
+TEST_F(BumpArenaTest, CheckInvalidAllocate) {
+  BumpArena arena(1024);
+  EXPECT_THROW(arena.allocate(1, 0), Error);
+  EXPECT_THROW(arena.allocate(1, 3), Error);
+  EXPECT_THROW(arena.allocate(1, 2 * alignof(std::max_align_t)), Error);
+}
+
+TEST_F(BumpArenaTest, CheckNewChunks) {
+  BumpArena arena(1024);
+  arena.allocate(1000, 8);
+  EXPECT_EQ(1u, arena.num_chunks());
+  arena.allocate(100, 8);
+  EXPECT_EQ(2u, arena.num_chunks());
+  EXPECT_EQ(2048u, arena.bytes_total());
+
+  // Large blocks obtain dedicated chunks.
+  void *large = arena.allocate(4000, 8);
+  EXPECT_EQ(0u, addr(large) % alignof(std::max_align_t));
+  EXPECT_EQ(3u, arena.num_chunks());
+  EXPECT_EQ(6048u, arena.bytes_total());
+}
+
+TEST_F(BumpArenaTest, CheckReset) {
+  BumpArena arena(1024);
+  void *p1 = arena.allocate(8, 8);
+  arena.reset();
+  EXPECT_EQ(0u, arena.bytes_in_use());
+  EXPECT_EQ(1u, arena.num_chunks());
+  EXPECT_EQ(p1, arena.allocate(8, 8));
+
+  // Multiple chunks are merged by the reset.
+  arena.allocate(2000, 8);
+  EXPECT_EQ(2u, arena.num_chunks());
+  arena.reset();
+  EXPECT_EQ(1u, arena.num_chunks());
+  EXPECT_EQ(3024u, arena.bytes_total());
+  arena.allocate(2000, 8);
+  arena.allocate(1000, 8);
+  EXPECT_EQ(1u, arena.num_chunks());
+}
+
+TEST_F(BumpArenaTest, CheckRewind) {
+  BumpArena arena(1024);
+  const BumpArena::Position pos0 = arena.position();
+  void *p1 = arena.allocate(8, 8);
+  const BumpArena::Position pos1 = arena.position();
+  void *p2 = arena.allocate(1000, 8);
+  void *p3 = arena.allocate(100, 8);
+  EXPECT_EQ(2u, arena.num_chunks());
+  EXPECT_TRUE(arena.allocated_after(p1, pos0));
+  EXPECT_FALSE(arena.allocated_after(p1, pos1));
+  EXPECT_TRUE(arena.allocated_after(p2, pos1));
+  EXPECT_TRUE(arena.allocated_after(p3, pos1));
+  EXPECT_FALSE(arena.allocated_after(&pos1, pos0));
+
+  // Chunks are kept and reused in the same order.
+  arena.rewind(pos1);
+  EXPECT_EQ(8u, arena.bytes_in_use());
+  EXPECT_EQ(2u, arena.num_chunks());
+  EXPECT_EQ(p2, arena.allocate(1000, 8));
+  EXPECT_EQ(p3, arena.allocate(100, 8));
+  EXPECT_EQ(2u, arena.num_chunks());
+  EXPECT_EQ(2048u, arena.bytes_total());
+
+  arena.rewind(pos0);
+  EXPECT_EQ(0u, arena.bytes_in_use());
+  EXPECT_EQ(p1, arena.allocate(8, 8));
+  EXPECT_THROW(arena.rewind(BumpArena::Position {1, 100, 1100}), Error);
+}
+
+TEST_F(BumpArenaTest, CheckCreate) {
+  BumpArena arena(1024);
+  std::string *s = arena.create<std::string>(3, 'a');
+  EXPECT_EQ("aaa", *s);
+  EXPECT_EQ(0u, addr(s) % alignof(std::string));
+  s->~basic_string();
+}
+
+TEST_F(BumpArenaTest, CheckArenaVector) {
+  BumpArena arena(1024);
+  ArenaVector<unsigned> v;
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(0u, v.size());
+  for (unsigned i = 0; i < 10; ++i) v.push_back(i, arena);
+  EXPECT_FALSE(v.empty());
+  EXPECT_EQ(10u, v.size());
+  EXPECT_EQ(vector<unsigned>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}),
+      vector<unsigned>(v.begin(), v.end()));
+
+  // Copies share elements.
+  ArenaVector<unsigned> copied = v;
+  copied[3] = 42;
+  EXPECT_EQ(42u, v[3]);
+
+  const vector<unsigned> src {5, 6, 7};
+  v.assign(src.data(), src.data() + src.size(), arena);
+  EXPECT_EQ(src, vector<unsigned>(v.begin(), v.end()));
+}
+
+}  // namespace primitiv
@@ -0,0 +1,201 @@
+#include <config.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/checkpoint.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
+#include <primitiv/parameter.h>
+#include <primitiv/trainer_impl.h>
+#include <test_utils.h>
+
+using std::string;
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+
+class CheckpointTest : public testing::Test {
+protected:
+  CPUDevice dev0;
+  CPUDevice dev1;
+  const string path = "/tmp/primitiv_CheckpointTest.ckpt";
+};
+
+TEST_F(CheckpointTest, CheckSaveRestore) {
+  Parameter pa("a", {2, 2}, {1, 2, 3, 4}, &dev0);
+  Parameter pb("b", {3}, {5, 6, 7}, &dev1);
+  trainers::Adam trainer;
+  trainer.add_parameter(&pa);
+  trainer.add_parameter(&pb);
+  pa.gradient().reset(1);
+  pb.gradient().reset(-1);
+  trainer.update(1);
+  trainer.update(1);
+  ASSERT_EQ(3u, trainer.epoch());
+
+  const vector<float> a_value = pa.value().to_vector();
+  const vector<float> a_m1 = pa.stats("adam-m1").to_vector();
+  const vector<float> a_m2 = pa.stats("adam-m2").to_vector();
+  const vector<float> b_value = pb.value().to_vector();
+  const vector<float> b_m1 = pb.stats("adam-m1").to_vector();
+  const vector<float> b_m2 = pb.stats("adam-m2").to_vector();
+
+  Checkpoint::save(path, trainer);
+
+  Parameter qa("a", {2, 2}, vector<float>(4, 0), &dev0);
+  Parameter qb("b", {3}, vector<float>(3, 0), &dev1);
+  trainers::Adam restored;
+  restored.add_parameter(&qa);
+  restored.add_parameter(&qb);
+
+  Checkpoint ckpt(path);
+  EXPECT_EQ(vector<string>({"a", "b"}), ckpt.parameter_names());
+  EXPECT_EQ(3u, ckpt.states().at("epoch"));
+  ckpt.restore(restored);
+
+  EXPECT_EQ(3u, restored.epoch());
+  EXPECT_TRUE(vector_match(a_value, qa.value().to_vector()));
+  EXPECT_TRUE(vector_match(a_m1, qa.stats("adam-m1").to_vector()));
+  EXPECT_TRUE(vector_match(a_m2, qa.stats("adam-m2").to_vector()));
+  EXPECT_TRUE(vector_match(b_value, qb.value().to_vector()));
+  EXPECT_TRUE(vector_match(b_m1, qb.stats("adam-m1").to_vector()));
+  EXPECT_TRUE(vector_match(b_m2, qb.stats("adam-m2").to_vector()));
+  EXPECT_EQ(&dev0, qa.value().device());
+  EXPECT_EQ(&dev1, qb.value().device());
+}
+
+TEST_F(CheckpointTest, CheckLoadParameter) {
+  Parameter pa("a", {2}, {1, 2}, &dev0);
+  Parameter pb("b", {2, 2}, {3, 4, 5, 6}, &dev0);
+  pb.add_stats("x", {3});
+  pb.stats("x").reset_by_vector({7, 8, 9});
+  trainers::SGD trainer;
+  trainer.add_parameter(&pa);
+  trainer.add_parameter(&pb);
+  Checkpoint::save(path, trainer);
+
+  const Checkpoint ckpt(path);
+  EXPECT_TRUE(ckpt.has_parameter("a"));
+  EXPECT_TRUE(ckpt.has_parameter("b"));
+  EXPECT_FALSE(ckpt.has_parameter("c"));
+  EXPECT_TRUE(ckpt.states().empty());
+
+  const Parameter qb = ckpt.load_parameter("b", &dev1);
+  EXPECT_EQ("b", qb.name());
+  EXPECT_EQ(Shape({2, 2}), qb.shape());
+  EXPECT_EQ(&dev1, qb.device());
+  EXPECT_TRUE(vector_match(vector<float> {3, 4, 5, 6}, qb.value().to_vector()));
+  ASSERT_TRUE(qb.has_stats("x"));
+  EXPECT_TRUE(vector_match(vector<float> {7, 8, 9}, qb.stats("x").to_vector()));
+  EXPECT_THROW(ckpt.load_parameter("c", &dev1), Error);
+}
+
+TEST_F(CheckpointTest, CheckInvalidRestore) {
+  Parameter pa("a", {2}, {1, 2}, &dev0);
+  trainers::SGD trainer;
+  trainer.add_parameter(&pa);
+  Checkpoint::save(path, trainer);
+  const Checkpoint ckpt(path);
+
+  {
+    // Shape mismatched.
+    Parameter qa("a", {3}, {0, 0, 0}, &dev0);
+    trainers::SGD restored;
+    restored.add_parameter(&qa);
+    EXPECT_THROW(ckpt.restore(restored), Error);
+    EXPECT_TRUE(vector_match(vector<float> {0, 0, 0}, qa.value().to_vector()));
+  }
+  {
+    // Unknown parameter.
+    Parameter qa("a", {2}, {0, 0}, &dev0);
+    Parameter qb("b", {2}, {0, 0}, &dev0);
+    trainers::SGD restored;
+    restored.add_parameter(&qa);
+    restored.add_parameter(&qb);
+    EXPECT_THROW(ckpt.restore(restored), Error);
+    EXPECT_TRUE(vector_match(vector<float> {0, 0}, qa.value().to_vector()));
+  }
+  {
+    // Missing states.
+    Parameter qa("a", {2}, {0, 0}, &dev0);
+    trainers::Adam restored;
+    restored.add_parameter(&qa);
+    EXPECT_THROW(ckpt.restore(restored), Error);
+  }
+}
+
+TEST_F(CheckpointTest, CheckInvalidStatsRestore) {
+  Parameter pa("a", {2}, {1, 2}, &dev0);
+  Parameter pb("b", {2}, {3, 4}, &dev0);
+  trainers::MomentumSGD trainer;
+  trainer.add_parameter(&pa);
+  trainer.add_parameter(&pb);
+  Checkpoint::save(path, trainer);
+  const Checkpoint ckpt(path);
+
+  // Stats shape mismatched in the last parameter.
+  Parameter qa("a", {2}, {0, 0}, &dev0);
+  Parameter qb("b", {2}, {0, 0}, &dev0);
+  qb.add_stats("momentumsgd-m", {3});
+  trainers::MomentumSGD restored;
+  restored.add_parameter(&qa);
+  restored.add_parameter(&qb);
+  EXPECT_THROW(ckpt.restore(restored), Error);
+  EXPECT_TRUE(vector_match(vector<float> {0, 0}, qa.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {0, 0}, qb.value().to_vector()));
+}
+
+TEST_F(CheckpointTest, CheckSaveInvalidStats) {
+  Parameter pa("a", {2}, {1, 2}, &dev0);
+  trainers::MomentumSGD trainer;
+  trainer.add_parameter(&pa);
+  pa.stats("momentumsgd-m") = Tensor();
+  ASSERT_NO_THROW(Checkpoint::save(path, trainer));
+
+  const Checkpoint ckpt(path);
+  const Parameter qa = ckpt.load_parameter("a", &dev0);
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, qa.value().to_vector()));
+  EXPECT_FALSE(qa.has_stats("momentumsgd-m"));
+
+  // Invalid statistics are also overwritten by the checkpoint.
+  pa.stats("momentumsgd-m") = dev0.new_tensor_by_vector({2}, {5, 6});
+  Checkpoint::save(path, trainer);
+  pa.stats("momentumsgd-m") = Tensor();
+  const Checkpoint ckpt2(path);
+  EXPECT_NO_THROW(ckpt2.restore(trainer));
+  ASSERT_TRUE(pa.stats("momentumsgd-m").valid());
+  EXPECT_TRUE(vector_match(
+        vector<float> {5, 6}, pa.stats("momentumsgd-m").to_vector()));
+}
+
+TEST_F(CheckpointTest, CheckInvalidFile) {
+  {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << "name: a";
+  }
+  EXPECT_THROW(Checkpoint ckpt(path), Error);
+
+  Parameter pa("a", {256}, vector<float>(256, 1), &dev0);
+  trainers::SGD trainer;
+  trainer.add_parameter(&pa);
+  Checkpoint::save(path, trainer);
+  string data;
+  {
+    std::ifstream ifs(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(ifs), {});
+  }
+  {
+    // Truncates the data block.
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(data.data(), data.size() - 4);
+  }
+  EXPECT_THROW(Checkpoint ckpt(path), Error);
+
+  EXPECT_THROW(Checkpoint ckpt("/tmp/primitiv_CheckpointTest_no_file"), Error);
+}
+
+}  // namespace primitiv
@@ -1,17 +1,25 @@
 #include <config.h>
 
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
+#include <primitiv/device_observer.h>
+#include <primitiv/error.h>
 #include <primitiv/shape.h>
 #include <primitiv/tensor.h>
+#include <primitiv/tensor_ops.h>
 #include <test_utils.h>
 
 using std::vector;
 using test_utils::vector_match;
+using test_utils::vector_near;
 
 namespace primitiv {
 
@@ -22,6 +30,437 @@ TEST_F(CPUDeviceTest, CheckDeviceType) {
   EXPECT_EQ(Device::DEVICE_TYPE_CPU, dev.type());
 }
 
+TEST_F(CPUDeviceTest, CheckNumThreads) {
+  {
+    CPUDevice dev;
+    EXPECT_EQ(1u, dev.num_threads());
+  }
+  {
+    CPUDevice dev(12345);
+    EXPECT_EQ(1u, dev.num_threads());
+  }
+  for (unsigned n : {0u, 1u, 2u, 4u}) {
+    CPUDevice dev(12345, n);
+    EXPECT_EQ(std::max(1u, n), dev.num_threads());
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckMultithreadedOperations) {
+  namespace T = tensor_ops;
+  CPUDevice dev1(12345, 1);
+  CPUDevice dev4(12345, 4);
+  const Shape sa({256, 130}, 3);
+  const Shape sb({130, 70}, 3);
+  vector<float> a_data(sa.size()), b_data(sb.size());
+  for (unsigned i = 0; i < a_data.size(); ++i) a_data[i] = (i % 17) * .125 - 1;
+  for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = (i % 13) * .25 - 1.5;
+
+  const auto run = [&](Device &dev) {
+    const Tensor a = dev.new_tensor_by_vector(sa, a_data);
+    const Tensor b = dev.new_tensor_by_vector(sb, b_data);
+    const Tensor a1 = T::batch_sum(a);
+    const Tensor y = T::matmul(a, b) + T::matmul(a1, b);
+    Tensor z = T::tanh(y) * T::exp(-y * y) + y / 4 - T::batch_sum(y);
+    z += T::broadcast(T::sum(y, 0), 0, 256);
+    z -= T::broadcast(T::logsumexp(a * .5, 1), 1, 70) * 3;
+    z *= 2;
+    return z.to_vector();
+  };
+  EXPECT_TRUE(vector_match(run(dev1), run(dev4)));
+}
+
+TEST_F(CPUDeviceTest, CheckMultithreadedBackward) {
+  CPUDevice dev1(12345, 1);
+  CPUDevice dev4(12345, 4);
+  const Shape sa({300, 200}, 4);
+  const Shape sb({300, 200});
+  vector<float> a_data(sa.size()), b_data(sb.size());
+  for (unsigned i = 0; i < a_data.size(); ++i) a_data[i] = (i % 17) * .125 - 1;
+  for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = (i % 13) * .25 - 1.5;
+
+  const auto run = [&](Device &dev) {
+    const Tensor a = dev.new_tensor_by_vector(sa, a_data);
+    const Tensor b = dev.new_tensor_by_vector(sb, b_data);
+    const Tensor y = a * b;
+    const Tensor gy = dev.new_tensor(sa, 1);
+    Tensor ga = dev.new_tensor(sa, 0);
+    Tensor gb = dev.new_tensor(sb, 0);
+    // gb is broadcasted over the minibatch.
+    dev.multiply_bw(a, b, y, gy, ga, gb);
+    dev.add_bw(a, b, y, gy, ga, gb);
+    dev.exp_bw(a, y, gy, ga);
+    vector<float> ret = ga.to_vector();
+    const vector<float> gb_val = gb.to_vector();
+    ret.insert(ret.end(), gb_val.begin(), gb_val.end());
+    return ret;
+  };
+  EXPECT_TRUE(vector_match(run(dev1), run(dev4)));
+}
+
+TEST_F(CPUDeviceTest, CheckMultithreadedConcat) {
+  namespace T = tensor_ops;
+  CPUDevice dev1(12345, 1);
+  CPUDevice dev4(12345, 4);
+  const Shape sa({3, 130}, 3);
+  const Shape sb({200, 130});
+  vector<float> a_data(sa.size()), b_data(sb.size());
+  for (unsigned i = 0; i < a_data.size(); ++i) a_data[i] = i;
+  for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = -1. * i;
+
+  const auto run = [&](Device &dev) {
+    const Tensor a = dev.new_tensor_by_vector(sa, a_data);
+    const Tensor b = dev.new_tensor_by_vector(sb, b_data);
+    // b is broadcasted over the minibatch.
+    vector<float> ret = T::concat({&a, &b, &a}, 0).to_vector();
+    const vector<float> y1 = T::concat({&b, &b}, 1).to_vector();
+    ret.insert(ret.end(), y1.begin(), y1.end());
+    return ret;
+  };
+  const vector<float> y1 = run(dev1);
+  EXPECT_EQ(206u * 130 * 3 + 200u * 260, y1.size());
+  EXPECT_EQ(a_data[0], y1[0]);
+  EXPECT_EQ(b_data[0], y1[3]);
+  EXPECT_EQ(a_data[0], y1[203]);
+  EXPECT_EQ(a_data[3], y1[206]);
+  EXPECT_TRUE(vector_match(y1, run(dev4)));
+}
+
+TEST_F(CPUDeviceTest, CheckFastMath) {
+  CPUDevice dev(12345);
+  EXPECT_FALSE(dev.fast_math());
+  const Shape shape({7, 5}, 3);
+  vector<float> x_data(shape.size());
+  for (unsigned i = 0; i < x_data.size(); ++i) x_data[i] = .1f * i - 5;
+  const Tensor x = dev.new_tensor_by_vector(shape, x_data);
+  const Tensor gy = dev.new_tensor(shape, 1);
+  auto run = [&]() {
+    vector<vector<float>> ret;
+    Tensor gx = dev.new_tensor(shape, 0);
+    ret.emplace_back(dev.exp_fw(x).to_vector());
+    ret.emplace_back(dev.tanh_fw(x).to_vector());
+    ret.emplace_back(dev.sigmoid_fw(x).to_vector());
+    const Tensor y = dev.softplus_fw(x);
+    ret.emplace_back(y.to_vector());
+    dev.softplus_bw(x, y, gy, gx);
+    ret.emplace_back(gx.to_vector());
+    return ret;
+  };
+  const vector<vector<float>> expected = run();
+  dev.set_fast_math(true);
+  EXPECT_TRUE(dev.fast_math());
+  const vector<vector<float>> observed = run();
+  ASSERT_EQ(expected.size(), observed.size());
+  for (unsigned i = 0; i < expected.size(); ++i) {
+    for (unsigned j = 0; j < expected[i].size(); ++j) {
+      // NOTE: The standard implementation of softplus loses some digits
+      //       around log(1 + small).
+      EXPECT_NEAR(
+          expected[i][j], observed[i][j], 1e-5 * std::fabs(expected[i][j]))
+        << "function " << i << ", element " << j;
+    }
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckElementwiseFw) {
+  typedef ElementwiseProgram P;
+  namespace T = tensor_ops;
+  const Shape sa({300, 7}, 3);
+  const Shape sb({300, 7});
+  vector<float> a_data(sa.size()), b_data(sb.size());
+  for (unsigned i = 0; i < a_data.size(); ++i) a_data[i] = (i % 17) * .25 - 2;
+  for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = (i % 13) * .25 + .5;
+
+  for (const unsigned num_threads : {1u, 4u}) {
+    CPUDevice dev(12345, num_threads);
+    const Tensor a = dev.new_tensor_by_vector(sa, a_data);
+    const Tensor b = dev.new_tensor_by_vector(sb, b_data);
+    // y = elu(tanh(a * b + .5) - sigmoid(-a) / b, 2)
+    P prog;
+    prog.instructions = vector<P::Instruction> {
+      { P::OPCODE_INPUT, 0, 0, 0 },
+      { P::OPCODE_INPUT, 1, 0, 0 },
+      { P::OPCODE_MULTIPLY, 0, 1, 0 },
+      { P::OPCODE_ADD_CONST, 2, 0, .5 },
+      { P::OPCODE_TANH, 3, 0, 0 },
+      { P::OPCODE_NEGATE, 0, 0, 0 },
+      { P::OPCODE_SIGMOID, 5, 0, 0 },
+      { P::OPCODE_DIVIDE, 6, 1, 0 },
+      { P::OPCODE_SUBTRACT, 4, 7, 0 },
+      { P::OPCODE_ELU, 8, 0, 2 },
+    };
+    const Tensor y = dev.elementwise_fw(prog, {&a, &b});
+    EXPECT_EQ(sa, y.shape());
+    const Tensor expected = T::elu(T::tanh(a * b + .5) - T::sigmoid(-a) / b, 2);
+    EXPECT_TRUE(vector_match(expected.to_vector(), y.to_vector()));
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckElementwiseFwEachOp) {
+  typedef ElementwiseProgram P;
+  namespace T = tensor_ops;
+  CPUDevice dev;
+  const Tensor a = dev.new_tensor_by_vector(
+      Shape({2, 2}, 2), {.5, -1, 2, -.25, .125, 3, -2, .75});
+  const Tensor b = dev.new_tensor_by_vector(Shape({2, 2}), {1, 2, -.5, 4});
+  const vector<std::pair<P::Opcode, Tensor>> unary {
+    { P::OPCODE_NEGATE, -a },
+    { P::OPCODE_SQRT, T::sqrt(b) },
+    { P::OPCODE_EXP, T::exp(a) },
+    { P::OPCODE_TANH, T::tanh(a) },
+    { P::OPCODE_SIGMOID, T::sigmoid(a) },
+    { P::OPCODE_SOFTPLUS, T::softplus(a) },
+    { P::OPCODE_SIN, T::sin(a) },
+    { P::OPCODE_COS, T::cos(a) },
+    { P::OPCODE_TAN, T::tan(a) },
+    { P::OPCODE_ADD_CONST, a + 3 },
+    { P::OPCODE_SUBTRACT_CONST_R, a - 3 },
+    { P::OPCODE_SUBTRACT_CONST_L, 3 - a },
+    { P::OPCODE_MULTIPLY_CONST, a * 3 },
+    { P::OPCODE_DIVIDE_CONST_R, a / 3 },
+    { P::OPCODE_DIVIDE_CONST_L, 3 / a },
+    { P::OPCODE_PRELU, T::prelu(a, 3) },
+    { P::OPCODE_ELU, T::elu(a, 3) },
+  };
+  for (const auto &kv : unary) {
+    const Tensor &x = kv.first == P::OPCODE_SQRT ? b : a;
+    P prog;
+    prog.instructions = vector<P::Instruction> {
+      { P::OPCODE_INPUT, 0, 0, 0 },
+      { kv.first, 0, 0, 3 },
+    };
+    EXPECT_TRUE(vector_match(
+          kv.second.to_vector(), dev.elementwise_fw(prog, {&x}).to_vector()))
+      << "opcode: " << kv.first;
+  }
+  const vector<std::pair<P::Opcode, Tensor>> binary {
+    { P::OPCODE_ADD, a + b },
+    { P::OPCODE_SUBTRACT, a - b },
+    { P::OPCODE_MULTIPLY, a * b },
+    { P::OPCODE_DIVIDE, a / b },
+  };
+  for (const auto &kv : binary) {
+    P prog;
+    prog.instructions = vector<P::Instruction> {
+      { P::OPCODE_INPUT, 1, 0, 0 },
+      { P::OPCODE_INPUT, 0, 0, 0 },
+      { kv.first, 0, 1, 0 },
+    };
+    const Tensor y = dev.elementwise_fw(prog, {&b, &a});
+    EXPECT_EQ(a.shape(), y.shape());
+    EXPECT_TRUE(vector_match(kv.second.to_vector(), y.to_vector()))
+      << "opcode: " << kv.first;
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckInvalidElementwiseFw) {
+  typedef ElementwiseProgram P;
+  CPUDevice dev;
+  CPUDevice dev2;
+  const Tensor a = dev.new_tensor(Shape({2, 2}, 2), 1);
+  const Tensor b = dev.new_tensor(Shape({2, 3}), 1);
+  const Tensor c = dev2.new_tensor(Shape({2, 2}), 1);
+  P prog;
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a}), Error);
+  prog.instructions = vector<P::Instruction> {
+    { P::OPCODE_INPUT, 0, 0, 0 },
+  };
+  EXPECT_NO_THROW(dev.elementwise_fw(prog, {&a}));
+  EXPECT_THROW(dev.elementwise_fw(prog, {}), Error);
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a, &b}), Error);
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a, &c}), Error);
+  prog.instructions = vector<P::Instruction> {
+    { P::OPCODE_INPUT, 1, 0, 0 },
+  };
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a}), Error);
+  prog.instructions = vector<P::Instruction> {
+    { P::OPCODE_INPUT, 0, 0, 0 },
+    { P::OPCODE_ADD, 0, 1, 0 },
+  };
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a}), Error);
+  prog.instructions.assign(
+      P::MAX_INSTRUCTIONS + 1, P::Instruction { P::OPCODE_INPUT, 0, 0, 0 });
+  EXPECT_THROW(dev.elementwise_fw(prog, {&a}), Error);
+}
+
+TEST_F(CPUDeviceTest, CheckInvalidParameterUpdates) {
+  CPUDevice dev;
+  CPUDevice dev2;
+  const Tensor g = dev.new_tensor({2, 2}, 1);
+  const Tensor g2 = dev2.new_tensor({2, 2}, 1);
+  Tensor x = dev.new_tensor({2, 2}, 1);
+  Tensor m1 = dev.new_tensor({2, 2}, 0);
+  Tensor m2 = dev.new_tensor({2, 2}, 0);
+  Tensor bad = dev.new_tensor(Shape({2, 2}, 2), 0);
+  EXPECT_NO_THROW(dev.sgd_update(.1, g, x));
+  EXPECT_THROW(dev.sgd_update(.1, g2, x), Error);
+  EXPECT_THROW(dev.sgd_update(.1, g, bad), Error);
+  EXPECT_NO_THROW(dev.momentum_sgd_update(.1, .9, g, m1, x));
+  EXPECT_THROW(dev.momentum_sgd_update(.1, .9, g, bad, x), Error);
+  EXPECT_NO_THROW(dev.adam_update(.1, .9, .999, 1e-8, 1, g, m1, m2, x));
+  EXPECT_THROW(dev.adam_update(.1, .9, .999, 1e-8, 0, g, m1, m2, x), Error);
+  EXPECT_THROW(dev.adam_update(.1, .9, .999, 1e-8, 1, g, m1, bad, x), Error);
+  EXPECT_THROW(dev.adam_update(.1, .9, .999, 1e-8, 1, g2, m1, m2, x), Error);
+}
+
+TEST_F(CPUDeviceTest, CheckMultiParameterUpdates) {
+  CPUDevice dev;
+  const vector<Shape> shapes {{3}, {2, 2}, {40000}, {5, 7}};
+  vector<Tensor> g, x1, m11, m21, x2, m12, m22;
+  for (const Shape &s : shapes) {
+    vector<float> data(s.size());
+    for (unsigned i = 0; i < data.size(); ++i) data[i] = .01 * (i % 17) - .05;
+    g.emplace_back(dev.new_tensor_by_vector(s, data));
+    x1.emplace_back(dev.new_tensor(s, 1));
+    x2.emplace_back(dev.new_tensor(s, 1));
+    m11.emplace_back(dev.new_tensor(s, .1));
+    m12.emplace_back(dev.new_tensor(s, .1));
+    m21.emplace_back(dev.new_tensor(s, .2));
+    m22.emplace_back(dev.new_tensor(s, .2));
+  }
+  vector<const Tensor *> gs;
+  vector<Tensor *> xs, m1s, m2s;
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    gs.emplace_back(&g[t]);
+    xs.emplace_back(&x2[t]);
+    m1s.emplace_back(&m12[t]);
+    m2s.emplace_back(&m22[t]);
+  }
+
+  for (unsigned t = 0; t < shapes.size(); ++t) dev.sgd_update(.1, g[t], x1[t]);
+  dev.sgd_update(.1, gs, xs);
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    EXPECT_TRUE(vector_match(x1[t].to_vector(), x2[t].to_vector()));
+  }
+
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    dev.momentum_sgd_update(.1, .9, g[t], m11[t], x1[t]);
+  }
+  dev.momentum_sgd_update(.1, .9, gs, m1s, xs);
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    EXPECT_TRUE(vector_match(m11[t].to_vector(), m12[t].to_vector()));
+    EXPECT_TRUE(vector_match(x1[t].to_vector(), x2[t].to_vector()));
+  }
+
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    dev.adam_update(.1, .9, .999, 1e-8, 3, g[t], m11[t], m21[t], x1[t]);
+  }
+  dev.adam_update(.1, .9, .999, 1e-8, 3, gs, m1s, m2s, xs);
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    EXPECT_TRUE(vector_match(m11[t].to_vector(), m12[t].to_vector()));
+    EXPECT_TRUE(vector_match(m21[t].to_vector(), m22[t].to_vector()));
+    EXPECT_TRUE(vector_match(x1[t].to_vector(), x2[t].to_vector()));
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckInvalidMultiParameterUpdates) {
+  CPUDevice dev;
+  CPUDevice dev2;
+  const Tensor g = dev.new_tensor({2, 2}, 1);
+  const Tensor g2 = dev2.new_tensor({2, 2}, 1);
+  Tensor x = dev.new_tensor({2, 2}, 1);
+  Tensor m = dev.new_tensor({2, 2}, 0);
+  Tensor bad = dev.new_tensor({3}, 0);
+  EXPECT_NO_THROW(dev.sgd_update(.1, {}, {}));
+  EXPECT_NO_THROW(dev.sgd_update(.1, {&g}, {&x}));
+  EXPECT_THROW(dev.sgd_update(.1, {&g, &g}, {&x}), Error);
+  EXPECT_THROW(dev.sgd_update(.1, {&g2}, {&x}), Error);
+  EXPECT_THROW(dev.sgd_update(.1, {&g}, {&bad}), Error);
+  EXPECT_NO_THROW(dev.momentum_sgd_update(.1, .9, {&g}, {&m}, {&x}));
+  EXPECT_THROW(dev.momentum_sgd_update(.1, .9, {&g}, {}, {&x}), Error);
+  EXPECT_THROW(dev.momentum_sgd_update(.1, .9, {&g}, {&bad}, {&x}), Error);
+  EXPECT_NO_THROW(
+      dev.adam_update(.1, .9, .999, 1e-8, 1, {&g}, {&m}, {&m}, {&x}));
+  EXPECT_THROW(
+      dev.adam_update(.1, .9, .999, 1e-8, 0, {&g}, {&m}, {&m}, {&x}), Error);
+  EXPECT_THROW(
+      dev.adam_update(.1, .9, .999, 1e-8, 1, {&g}, {&m}, {}, {&x}), Error);
+  EXPECT_THROW(
+      dev.adam_update(.1, .9, .999, 1e-8, 1, {&g}, {&m}, {&bad}, {&x}),
+      Error);
+}
+
+TEST_F(CPUDeviceTest, CheckWorkspace) {
+  CPUDevice dev;
+  EXPECT_EQ(0u, dev.workspace_size());
+  const void *data;
+  {
+    Tensor a = dev.new_workspace_tensor({2, 2});
+    EXPECT_EQ(Shape({2, 2}), a.shape());
+    EXPECT_TRUE(a.aliased());
+    EXPECT_EQ(4u, dev.workspace_size());
+    data = a.data();
+    // The workspace is busy.
+    const Tensor b = dev.new_workspace_tensor({3});
+    EXPECT_NE(data, b.data());
+    EXPECT_EQ(4u, dev.workspace_size());
+  }
+  {
+    // The same memory is reused without copy-on-write.
+    const std::uint64_t cows = Tensor::num_copy_on_writes();
+    Tensor a = dev.new_workspace_tensor({3});
+    EXPECT_EQ(data, a.data());
+    EXPECT_EQ(cows, Tensor::num_copy_on_writes());
+  }
+  {
+    const Tensor a = dev.new_workspace_tensor(Shape({3}, 3));
+    EXPECT_EQ(9u, dev.workspace_size());
+  }
+}
+
+TEST_F(CPUDeviceTest, CheckClipByNorm) {
+  CPUDevice dev(0, 4);
+  const vector<Shape> shapes {{3}, {}, {1 << 20}, {5, 7}};
+  vector<Tensor> x;
+  double expected = 0;
+  for (const Shape &s : shapes) {
+    vector<float> data(s.size());
+    for (unsigned i = 0; i < data.size(); ++i) {
+      data[i] = .01 * (i % 17) - .05;
+      expected += data[i] * data[i];
+    }
+    x.emplace_back(dev.new_tensor_by_vector(s, data));
+  }
+  vector<const Tensor *> cxs;
+  vector<Tensor *> xs;
+  for (Tensor &t : x) {
+    cxs.emplace_back(&t);
+    xs.emplace_back(&t);
+  }
+  const Tensor sq_norm = dev.squared_norm(cxs);
+  EXPECT_EQ(Shape(), sq_norm.shape());
+  EXPECT_FLOAT_EQ(expected, sq_norm.to_vector()[0]);
+  EXPECT_EQ(0, dev.squared_norm({}).to_vector()[0]);
+
+  // The threshold larger than the norm keeps values.
+  const vector<float> before = x[2].to_vector();
+  dev.clip_by_norm(100, sq_norm, xs);
+  EXPECT_TRUE(vector_match(before, x[2].to_vector()));
+
+  // Copies sharing the memory keep old values.
+  const Tensor copied = x[2];
+  dev.clip_by_norm(.5, sq_norm, xs);
+  EXPECT_FLOAT_EQ(.25, dev.squared_norm(cxs).to_vector()[0]);
+  const float k = .5 / std::sqrt(expected);
+  vector<float> expected_after = before;
+  for (float &v : expected_after) v *= k;
+  EXPECT_TRUE(vector_near(expected_after, x[2].to_vector(), 1e-7));
+  EXPECT_TRUE(vector_match(before, copied.to_vector()));
+}
+
+TEST_F(CPUDeviceTest, CheckInvalidClipByNorm) {
+  CPUDevice dev;
+  CPUDevice dev2;
+  const Tensor x2 = dev2.new_tensor({2}, 1);
+  Tensor x = dev.new_tensor({2}, 1);
+  const Tensor sq_norm = dev.new_tensor({}, 2);
+  const Tensor bad = dev.new_tensor({2}, 2);
+  EXPECT_THROW(dev.squared_norm({&x2}), Error);
+  EXPECT_NO_THROW(dev.clip_by_norm(1, sq_norm, {&x}));
+  EXPECT_THROW(dev.clip_by_norm(1, bad, {&x}), Error);
+  EXPECT_THROW(dev.clip_by_norm(0, sq_norm, {&x}), Error);
+  EXPECT_THROW(dev.clip_by_norm(1, dev2.new_tensor({}, 2), {&x}), Error);
+}
+
 TEST_F(CPUDeviceTest, CheckRandomBernoulli) {
   vector<vector<float>> history;
   for (unsigned i = 0; i < 10; ++i) {
@@ -156,4 +595,98 @@ TEST_F(CPUDeviceTest, CheckRandomLogNormalWithSeed) {
   EXPECT_TRUE(vector_match(expected, x.to_vector()));
 }
 
+TEST_F(CPUDeviceTest, CheckCounterBasedRandom) {
+  const Shape shape({100, 100}, 3);
+  CPUDevice dev1(12345);
+  CPUDevice dev4(12345, 4);
+  EXPECT_FALSE(dev1.counter_based_rng());
+  dev1.set_counter_based_rng(true);
+  dev4.set_counter_based_rng(true);
+  EXPECT_TRUE(dev1.counter_based_rng());
+
+  // Results do not depend on the number of threads.
+  const vector<float> u1 = dev1.random_uniform(shape, -2, 3).to_vector();
+  const vector<float> u4 = dev4.random_uniform(shape, -2, 3).to_vector();
+  EXPECT_TRUE(vector_match(u1, u4));
+  for (float x : u1) {
+    EXPECT_LT(-2.f, x);
+    EXPECT_GE(3.f, x);
+  }
+  const vector<float> n1 = dev1.random_normal(shape, 1, 2).to_vector();
+  const vector<float> n4 = dev4.random_normal(shape, 1, 2).to_vector();
+  EXPECT_TRUE(vector_match(n1, n4));
+  const vector<float> b1 = dev1.random_bernoulli(shape, .3).to_vector();
+  const vector<float> b4 = dev4.random_bernoulli(shape, .3).to_vector();
+  EXPECT_TRUE(vector_match(b1, b4));
+  const vector<float> l1 = dev1.random_log_normal(shape, 0, 1).to_vector();
+  const vector<float> l4 = dev4.random_log_normal(shape, 0, 1).to_vector();
+  EXPECT_TRUE(vector_match(l1, l4));
+
+  double u_sum = 0, n_sum = 0, b_sum = 0;
+  for (unsigned i = 0; i < u1.size(); ++i) {
+    u_sum += u1[i];
+    n_sum += n1[i];
+    b_sum += b1[i];
+    EXPECT_TRUE(b1[i] == 0 || b1[i] == 1);
+    EXPECT_LT(0.f, l1[i]);
+  }
+  EXPECT_NEAR(.5, u_sum / u1.size(), .02);
+  EXPECT_NEAR(1, n_sum / n1.size(), .02);
+  EXPECT_NEAR(.3, b_sum / b1.size(), .02);
+
+  // Each operation consumes different counters.
+  EXPECT_FALSE(vector_match(u1, dev1.random_uniform(shape, -2, 3).to_vector()));
+}
+
+TEST_F(CPUDeviceTest, CheckObserver) {
+  struct Recorder : public DeviceObserver {
+    Device *device = nullptr;
+    vector<std::string> names;
+    vector<vector<Shape>> shapes;
+    vector<double> flops, bytes, durations;
+    void on_kernel(Device &dev, const KernelInfo &info) override {
+      device = &dev;
+      names.emplace_back(info.name);
+      shapes.emplace_back();
+      for (const Shape *s : info.shapes) shapes.back().emplace_back(*s);
+      flops.emplace_back(info.flops);
+      bytes.emplace_back(info.bytes);
+      durations.emplace_back(info.duration_us);
+    }
+  } recorder;
+
+  CPUDevice dev;
+  EXPECT_EQ(nullptr, dev.observer());
+  const Tensor a = dev.new_tensor_by_vector({2, 3}, {1, 2, 3, 4, 5, 6});
+  const Tensor b = dev.new_tensor_by_vector(
+      Shape({3, 4}, 2), vector<float>(24, 1));
+  dev.matmul_fw(a, b);
+  EXPECT_TRUE(recorder.names.empty());
+
+  dev.set_observer(&recorder);
+  EXPECT_EQ(&recorder, dev.observer());
+  const Tensor y = dev.matmul_fw(a, b);
+  const Tensor z = dev.exp_fw(y);
+  Tensor gz = dev.new_tensor(z.shape(), 0);
+  dev.exp_bw(y, z, z, gz);
+  dev.set_observer(nullptr);
+  dev.exp_fw(y);
+
+  EXPECT_EQ(&dev, recorder.device);
+  ASSERT_EQ(3u, recorder.names.size());
+  EXPECT_EQ("matmul_fw", recorder.names[0]);
+  EXPECT_EQ("exp_fw", recorder.names[1]);
+  EXPECT_EQ("exp_bw", recorder.names[2]);
+  const vector<Shape> matmul_shapes {
+    Shape({2, 3}), Shape({3, 4}, 2), Shape({2, 4}, 2),
+  };
+  EXPECT_EQ(matmul_shapes, recorder.shapes[0]);
+  EXPECT_EQ(5u, recorder.shapes[2].size());
+  EXPECT_DOUBLE_EQ(2 * 3 * 16, recorder.flops[0]);
+  EXPECT_DOUBLE_EQ(4 * (6 + 24 + 16), recorder.bytes[0]);
+  EXPECT_DOUBLE_EQ(16, recorder.flops[1]);
+  EXPECT_DOUBLE_EQ(4 * (16 + 16), recorder.bytes[1]);
+  for (double d : recorder.durations) EXPECT_LE(0, d);
+}
+
 }  // namespace primitiv
@@ -0,0 +1,186 @@
+#include <config.h>
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_gemm.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+using test_utils::vector_near;
+
+namespace primitiv {
+namespace cpu {
+
+class CPUGemmTest : public testing::Test {
+protected:
+  // Generates small integers to obtain exact results in any summation order.
+  static vector<float> make_data(unsigned size, unsigned seed) {
+    vector<float> ret(size);
+    for (unsigned i = 0; i < size; ++i) {
+      ret[i] = static_cast<int>((i * 7 + seed * 13) % 5) - 2;
+    }
+    return ret;
+  }
+
+  static vector<float> naive_gemm(
+      bool trans_a, bool trans_b, unsigned m, unsigned n, unsigned k,
+      float alpha, const vector<float> &a, const vector<float> &b,
+      float beta, const vector<float> &c) {
+    vector<float> ret(c);
+    for (unsigned j = 0; j < n; ++j) {
+      for (unsigned i = 0; i < m; ++i) {
+        float tmp = 0;
+        for (unsigned l = 0; l < k; ++l) {
+          const float va = trans_a ? a[l + i * k] : a[i + l * m];
+          const float vb = trans_b ? b[j + l * n] : b[l + j * k];
+          tmp += va * vb;
+        }
+        ret[i + j * m] = alpha * tmp + beta * c[i + j * m];
+      }
+    }
+    return ret;
+  }
+
+  static const vector<GemmKernelType> &kernels() {
+    static const vector<GemmKernelType> ret {
+      GEMM_KERNEL_AUTO, GEMM_KERNEL_GENERIC,
+      GEMM_KERNEL_AVX2, GEMM_KERNEL_AVX512,
+    };
+    return ret;
+  }
+};
+
+TEST_F(CPUGemmTest, CheckKernelName) {
+  EXPECT_STREQ("generic", gemm_kernel_name(GEMM_KERNEL_GENERIC));
+  for (GemmKernelType type : kernels()) {
+    if (gemm_kernel_supported(type)) {
+      EXPECT_STRNE("", gemm_kernel_name(type));
+    } else {
+      // Unsupported kernels fall back to the generic one.
+      EXPECT_STREQ("generic", gemm_kernel_name(type));
+    }
+  }
+  EXPECT_TRUE(gemm_kernel_supported(GEMM_KERNEL_AUTO));
+  EXPECT_TRUE(gemm_kernel_supported(GEMM_KERNEL_GENERIC));
+}
+
+TEST_F(CPUGemmTest, CheckSmall) {
+  const vector<float> a {1, 2, 3, 4, 5, 6};
+  const vector<float> b {1, 0, -1, 2, 1, 0};
+  const vector<float> y {-4, -4, 5, 8};
+  for (GemmKernelType type : kernels()) {
+    vector<float> c(4, 100);
+    gemm(false, false, 2, 2, 3, 1, a.data(), 2, b.data(), 3, 0, c.data(), 2, type);
+    EXPECT_TRUE(vector_match(y, c)) << gemm_kernel_name(type);
+  }
+}
+
+TEST_F(CPUGemmTest, CheckVariousShapes) {
+  struct TestCase { unsigned m, n, k; };
+  const vector<TestCase> test_cases {
+    {1, 1, 1}, {7, 5, 3}, {16, 6, 8}, {33, 13, 17},
+    {64, 64, 64}, {130, 47, 300}, {300, 20, 513}, {5, 300, 9},
+  };
+  for (GemmKernelType type : kernels()) {
+    for (const TestCase &tc : test_cases) {
+      for (unsigned ta = 0; ta < 2; ++ta) {
+        for (unsigned tb = 0; tb < 2; ++tb) {
+          const vector<float> a = make_data(tc.m * tc.k, 1);
+          const vector<float> b = make_data(tc.k * tc.n, 2);
+          const vector<float> c = make_data(tc.m * tc.n, 3);
+          for (float beta : {0.f, 1.f, -2.f}) {
+            const vector<float> expected = naive_gemm(
+                ta, tb, tc.m, tc.n, tc.k, 2, a, b, beta, c);
+            vector<float> actual(c);
+            gemm(
+                ta, tb, tc.m, tc.n, tc.k,
+                2, a.data(), ta ? tc.k : tc.m, b.data(), tb ? tc.n : tc.k,
+                beta, actual.data(), tc.m, type);
+            EXPECT_TRUE(vector_match(expected, actual))
+              << "kernel=" << gemm_kernel_name(type)
+              << ", m=" << tc.m << ", n=" << tc.n << ", k=" << tc.k
+              << ", trans_a=" << ta << ", trans_b=" << tb
+              << ", beta=" << beta;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_F(CPUGemmTest, CheckLeadingDimensions) {
+  // Uses the top-left 3x2 submatrices of larger matrices.
+  const vector<float> a {1, 2, 3, 0, 4, 5, 6, 0};  // 4x2, lda=4
+  const vector<float> b {1, 2, 0, 3, 4, 0};  // 3x2, ldb=3 (uses 2x2)
+  vector<float> c(10, -1);  // 5x2, ldc=5
+  const vector<float> y {9, 12, 15, -1, -1, 19, 26, 33, -1, -1};
+  gemm(false, false, 3, 2, 2, 1, a.data(), 4, b.data(), 3, 0, c.data(), 5);
+  EXPECT_TRUE(vector_match(y, c));
+}
+
+TEST_F(CPUGemmTest, CheckEpilogue) {
+  struct TestCase { unsigned m, n, k; };
+  const vector<TestCase> test_cases {
+    {1, 1, 1}, {7, 5, 3}, {33, 13, 17}, {130, 47, 300}, {300, 20, 513},
+  };
+  const vector<GemmActivation> activations {
+    GEMM_ACTIVATION_IDENTITY, GEMM_ACTIVATION_RELU,
+    GEMM_ACTIVATION_TANH, GEMM_ACTIVATION_SIGMOID,
+  };
+  for (GemmKernelType type : kernels()) {
+    for (const TestCase &tc : test_cases) {
+      const vector<float> a = make_data(tc.m * tc.k, 1);
+      const vector<float> b = make_data(tc.k * tc.n, 2);
+      const vector<float> c = make_data(tc.m * tc.n, 3);
+      const vector<float> bias = make_data(tc.m, 4);
+      const vector<float> y = naive_gemm(
+          false, false, tc.m, tc.n, tc.k, 1, a, b, 1, c);
+      for (GemmActivation act : activations) {
+        vector<float> expected(y);
+        for (unsigned i = 0; i < expected.size(); ++i) {
+          const float x = expected[i] + bias[i % tc.m];
+          switch (act) {
+            case GEMM_ACTIVATION_RELU: expected[i] = x > 0 ? x : 0; break;
+            case GEMM_ACTIVATION_TANH: expected[i] = std::tanh(x); break;
+            case GEMM_ACTIVATION_SIGMOID:
+              expected[i] = .5 + .5 * std::tanh(.5 * x);
+              break;
+            default: expected[i] = x;
+          }
+        }
+        vector<float> actual(c);
+        gemm(
+            false, false, tc.m, tc.n, tc.k,
+            1, a.data(), tc.m, b.data(), tc.k,
+            1, actual.data(), tc.m, GemmEpilogue { bias.data(), act }, type);
+        EXPECT_TRUE(vector_near(expected, actual, 1e-6))
+          << "kernel=" << gemm_kernel_name(type)
+          << ", m=" << tc.m << ", n=" << tc.n << ", k=" << tc.k
+          << ", activation=" << act;
+      }
+    }
+  }
+}
+
+TEST_F(CPUGemmTest, CheckEpilogueWithoutBias) {
+  const vector<float> a {1, 2, 3, 4, 5, 6};
+  const vector<float> b {1, 0, -1, 2, 1, 0};
+  const vector<float> y {0, 0, 5, 8};
+  vector<float> c(4, 100);
+  gemm(
+      false, false, 2, 2, 3, 1, a.data(), 2, b.data(), 3, 0, c.data(), 2,
+      GemmEpilogue { nullptr, GEMM_ACTIVATION_RELU });
+  EXPECT_TRUE(vector_match(y, c));
+}
+
+TEST_F(CPUGemmTest, CheckZeroDepth) {
+  vector<float> c {1, 2, 3, 4};
+  const vector<float> y {3, 6, 9, 12};
+  gemm(false, false, 2, 2, 0, 1, nullptr, 2, nullptr, 1, 3, c.data(), 2);
+  EXPECT_TRUE(vector_match(y, c));
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,209 @@
+#include <config.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_math.h>
+
+using std::vector;
+
+namespace primitiv {
+namespace cpu {
+
+class CPUMathTest : public testing::Test {
+protected:
+  typedef void (*ArrayFunction)(
+      const float *, float *, unsigned, MathKernelType);
+
+  static const vector<MathKernelType> &kernels() {
+    static const vector<MathKernelType> ret {
+      MATH_KERNEL_AUTO, MATH_KERNEL_GENERIC,
+      MATH_KERNEL_AVX2, MATH_KERNEL_AVX512,
+    };
+    return ret;
+  }
+
+  // SIMD implementations available on the running CPU.
+  static vector<MathKernelType> simd_kernels() {
+    vector<MathKernelType> ret;
+    for (MathKernelType type : {MATH_KERNEL_AVX2, MATH_KERNEL_AVX512}) {
+      if (math_kernel_supported(type)) ret.emplace_back(type);
+    }
+    return ret;
+  }
+
+  // NOTE: std::isnan() may not work with -ffast-math.
+  static bool is_nan(float x) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits & 0x7fffffff) > 0x7f800000;
+  }
+
+  // Maps floats to integers which are monotonic and adjacent floats differ
+  // by 1.
+  static std::int64_t ordinal(float x) {
+    std::int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits < 0
+      ? static_cast<std::int64_t>(INT32_MIN) - bits
+      : static_cast<std::int64_t>(bits);
+  }
+
+  static std::int64_t ulp_diff(float a, float b) {
+    const std::int64_t d = ordinal(a) - ordinal(b);
+    return d < 0 ? -d : d;
+  }
+
+  // Evaluates fn over evenly spaced values in [lower, upper] and returns the
+  // maximum ULP error of normalized results.
+  static std::int64_t max_ulp(
+      ArrayFunction fn, const std::function<double(double)> &ref,
+      float lower, float upper, MathKernelType type) {
+    const unsigned N = 100003;  // Not a multiple of the SIMD width.
+    vector<float> x(N), y(N);
+    for (unsigned i = 0; i < N; ++i) {
+      x[i] = lower + (upper - lower) * i / (N - 1);
+    }
+    fn(x.data(), y.data(), N, type);
+    std::int64_t ret = 0;
+    for (unsigned i = 0; i < N; ++i) {
+      const float expected = ref(x[i]);
+      if (std::fabs(expected) < FLT_MIN) continue;
+      ret = std::max(ret, ulp_diff(expected, y[i]));
+    }
+    return ret;
+  }
+};
+
+TEST_F(CPUMathTest, CheckKernelName) {
+  EXPECT_STREQ("generic", math_kernel_name(MATH_KERNEL_GENERIC));
+  for (MathKernelType type : kernels()) {
+    if (math_kernel_supported(type)) {
+      EXPECT_STRNE("", math_kernel_name(type));
+    } else {
+      // Unsupported kernels fall back to the generic one.
+      EXPECT_STREQ("generic", math_kernel_name(type));
+    }
+  }
+  EXPECT_TRUE(math_kernel_supported(MATH_KERNEL_AUTO));
+  EXPECT_TRUE(math_kernel_supported(MATH_KERNEL_GENERIC));
+}
+
+TEST_F(CPUMathTest, CheckExp) {
+  for (MathKernelType type : simd_kernels()) {
+    const auto ref = [](double x) { return std::exp(x); };
+    EXPECT_GE(1, max_ulp(fast_exp, ref, -87.f, 88.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(1, max_ulp(fast_exp, ref, -1.f, 1.f, type))
+      << math_kernel_name(type);
+  }
+}
+
+TEST_F(CPUMathTest, CheckLog) {
+  for (MathKernelType type : simd_kernels()) {
+    const auto ref = [](double x) { return std::log(x); };
+    EXPECT_GE(1, max_ulp(fast_log, ref, 1e-30f, 1e-20f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(1, max_ulp(fast_log, ref, 1e-3f, 10.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(1, max_ulp(fast_log, ref, 1.f, 1e30f, type))
+      << math_kernel_name(type);
+  }
+}
+
+TEST_F(CPUMathTest, CheckTanh) {
+  for (MathKernelType type : simd_kernels()) {
+    const auto ref = [](double x) { return std::tanh(x); };
+    EXPECT_GE(2, max_ulp(fast_tanh, ref, -20.f, 20.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(2, max_ulp(fast_tanh, ref, -1.f, 1.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(2, max_ulp(fast_tanh, ref, -1e-3f, 1e-3f, type))
+      << math_kernel_name(type);
+  }
+}
+
+TEST_F(CPUMathTest, CheckSigmoid) {
+  for (MathKernelType type : simd_kernels()) {
+    const auto ref = [](double x) { return 1. / (1. + std::exp(-x)); };
+    EXPECT_GE(4, max_ulp(fast_sigmoid, ref, -80.f, 30.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(4, max_ulp(fast_sigmoid, ref, -1.f, 1.f, type))
+      << math_kernel_name(type);
+  }
+}
+
+TEST_F(CPUMathTest, CheckSoftplus) {
+  for (MathKernelType type : simd_kernels()) {
+    const auto ref = [](double x) { return std::log1p(std::exp(x)); };
+    EXPECT_GE(4, max_ulp(fast_softplus, ref, -80.f, 80.f, type))
+      << math_kernel_name(type);
+    EXPECT_GE(4, max_ulp(fast_softplus, ref, -1.f, 1.f, type))
+      << math_kernel_name(type);
+  }
+}
+
+TEST_F(CPUMathTest, CheckSpecialValues) {
+  const float inf = HUGE_VALF;
+  const vector<float> x {0, -0.f, inf, -inf, 200, -200, 1, -1};
+  for (MathKernelType type : kernels()) {
+    vector<float> y(x.size());
+    fast_exp(x.data(), y.data(), x.size(), type);
+    EXPECT_EQ(1, y[0]);
+    EXPECT_EQ(1, y[1]);
+    EXPECT_EQ(inf, y[2]);
+    EXPECT_EQ(0, y[3]);
+    EXPECT_EQ(inf, y[4]);
+    EXPECT_EQ(0, y[5]);
+
+    fast_log(x.data(), y.data(), x.size(), type);
+    EXPECT_EQ(-inf, y[0]);
+    EXPECT_EQ(-inf, y[1]);
+    EXPECT_EQ(inf, y[2]);
+    EXPECT_TRUE(is_nan(y[3]));
+    EXPECT_TRUE(is_nan(y[5]));
+    EXPECT_EQ(0, y[6]);
+    EXPECT_TRUE(is_nan(y[7]));
+
+    fast_tanh(x.data(), y.data(), x.size(), type);
+    EXPECT_EQ(0, y[0]);
+    EXPECT_EQ(1, y[2]);
+    EXPECT_EQ(-1, y[3]);
+    EXPECT_EQ(1, y[4]);
+    EXPECT_EQ(-1, y[5]);
+
+    fast_sigmoid(x.data(), y.data(), x.size(), type);
+    EXPECT_FLOAT_EQ(.5, y[0]);
+    EXPECT_FLOAT_EQ(1, y[2]);
+    EXPECT_GE(FLT_MIN, y[3]);
+    EXPECT_FLOAT_EQ(1, y[4]);
+    EXPECT_GE(FLT_MIN, y[5]);
+
+    fast_softplus(x.data(), y.data(), x.size(), type);
+    EXPECT_FLOAT_EQ(std::log(2.f), y[0]);
+    EXPECT_EQ(inf, y[2]);
+    EXPECT_EQ(0, y[3]);
+    EXPECT_EQ(200, y[4]);
+    EXPECT_EQ(0, y[5]);
+  }
+}
+
+TEST_F(CPUMathTest, CheckInplace) {
+  for (MathKernelType type : kernels()) {
+    for (unsigned size : {1u, 7u, 8u, 15u, 16u, 33u}) {
+      vector<float> x(size), expected(size);
+      for (unsigned i = 0; i < size; ++i) x[i] = .25f * i - 2;
+      fast_tanh(x.data(), expected.data(), size, type);
+      fast_tanh(x.data(), x.data(), size, type);
+      EXPECT_EQ(expected, x) << math_kernel_name(type) << ", size=" << size;
+    }
+  }
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,192 @@
+#include <config.h>
+
+#include <cstdint>
+#include <memory>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/cpu_memory_pool.h>
+#include <primitiv/error.h>
+#include <primitiv/shape.h>
+#include <primitiv/tensor.h>
+
+namespace primitiv {
+
+class CPUMemoryPoolTest : public testing::Test {};
+
+TEST_F(CPUMemoryPoolTest, CheckNew) {
+  {
+    CPUMemoryPool pool;
+  }  // pool is destroyed at the end of scope.
+  SUCCEED();
+}
+
+TEST_F(CPUMemoryPoolTest, CheckAllocate) {
+  CPUMemoryPool pool;
+  void *p1, *p2, *p3, *p4;
+  {
+    // Allocates new pointers.
+    const auto sp1 = pool.allocate(1llu);
+    const auto sp2 = pool.allocate(1llu << 8);
+    const auto sp3 = pool.allocate(1llu << 16);
+    const auto sp4 = pool.allocate(1llu << 24);
+    p1 = sp1.get();
+    p2 = sp2.get();
+    p3 = sp3.get();
+    p4 = sp4.get();
+  }
+  // sp1-4 are released at the end of above scope, but the raw pointer is kept
+  // in the pool object.
+  {
+    // Allocates existing pointers.
+    const auto sp1 = pool.allocate(1llu);
+    const auto sp2 = pool.allocate(1llu << 8);
+    const auto sp3 = pool.allocate(1llu << 16);
+    const auto sp4 = pool.allocate(1llu << 24);
+    EXPECT_EQ(p1, sp1.get());
+    EXPECT_EQ(p2, sp2.get());
+    EXPECT_EQ(p3, sp3.get());
+    EXPECT_EQ(p4, sp4.get());
+    // Allocates other pointers.
+    const auto sp11 = pool.allocate(1llu);
+    const auto sp22 = pool.allocate(1llu << 8);
+    const auto sp33 = pool.allocate(1llu << 16);
+    const auto sp44 = pool.allocate(1llu << 24);
+    EXPECT_NE(p1, sp11.get());
+    EXPECT_NE(p2, sp22.get());
+    EXPECT_NE(p3, sp33.get());
+    EXPECT_NE(p4, sp44.get());
+  }
+}
+
+TEST_F(CPUMemoryPoolTest, CheckInvalidAllocate) {
+  CPUMemoryPool pool;
+  // Available maximum size of the memory: 2^63 bytes.
+  EXPECT_THROW(pool.allocate((1llu << 63) + 1), Error);
+}
+
+TEST_F(CPUMemoryPoolTest, CheckAlignment) {
+  CPUMemoryPool pool;
+  for (std::uint64_t size : {1llu, 3llu, 64llu, 100llu, 4097llu}) {
+    const auto sp1 = pool.allocate(size);
+    const auto sp2 = pool.allocate(size);
+    EXPECT_EQ(
+        0u, reinterpret_cast<std::uintptr_t>(sp1.get()) % pool.ALIGNMENT);
+    EXPECT_EQ(
+        0u, reinterpret_cast<std::uintptr_t>(sp2.get()) % pool.ALIGNMENT);
+  }
+}
+
+TEST_F(CPUMemoryPoolTest, CheckStats) {
+  CPUMemoryPool pool;
+  MemoryPoolStats st = pool.stats();
+  EXPECT_EQ(0u, st.bytes_in_use);
+  EXPECT_EQ(0u, st.bytes_reserved);
+  EXPECT_EQ(0u, st.num_requests);
+  EXPECT_EQ(0u, st.num_hits);
+  EXPECT_EQ(0, st.hit_rate());
+  {
+    // Sizes are rounded up to the power of 2, at least 64 bytes.
+    const auto sp1 = pool.allocate(1llu);
+    const auto sp2 = pool.allocate(100llu);
+    st = pool.stats();
+    EXPECT_EQ(64u + 128u, st.bytes_in_use);
+    EXPECT_EQ(0u, st.bytes_reserved);
+    EXPECT_EQ(2u, st.num_requests);
+    EXPECT_EQ(0u, st.num_hits);
+  }
+  st = pool.stats();
+  EXPECT_EQ(0u, st.bytes_in_use);
+  EXPECT_EQ(64u + 128u, st.bytes_reserved);
+  {
+    const auto sp1 = pool.allocate(64llu);
+    const auto sp2 = pool.allocate(1024llu);
+    st = pool.stats();
+    EXPECT_EQ(64u + 1024u, st.bytes_in_use);
+    EXPECT_EQ(128u, st.bytes_reserved);
+    EXPECT_EQ(4u, st.num_requests);
+    EXPECT_EQ(1u, st.num_hits);
+    EXPECT_DOUBLE_EQ(.25, st.hit_rate());
+  }
+}
+
+TEST_F(CPUMemoryPoolTest, CheckDetailedStats) {
+  CPUMemoryPool pool;
+  MemoryPoolStats st = pool.stats();
+  EXPECT_EQ(0u, st.peak_bytes_in_use);
+  EXPECT_EQ(0u, st.num_system_allocs);
+  EXPECT_EQ(0u, st.num_oom_retries);
+  {
+    const auto sp1 = pool.allocate(256llu);
+    const auto sp2 = pool.allocate(256llu);
+    const auto sp3 = pool.allocate(1024llu);
+  }
+  {
+    const auto sp1 = pool.allocate(256llu);
+  }
+  st = pool.stats();
+  EXPECT_EQ(0u, st.bytes_in_use);
+  EXPECT_EQ(256u + 256u + 1024u, st.peak_bytes_in_use);
+  EXPECT_EQ(256u + 256u + 1024u, st.bytes_reserved);
+  EXPECT_EQ(3u, st.num_system_allocs);
+  EXPECT_EQ(0u, st.num_oom_retries);
+  ASSERT_EQ(64u, st.reserved_bytes_by_scale.size());
+  for (unsigned i = 0; i < 64; ++i) {
+    const std::uint64_t expected = i == 8 ? 512 : i == 10 ? 1024 : 0;
+    EXPECT_EQ(expected, st.reserved_bytes_by_scale[i]) << "scale=" << i;
+  }
+  pool.release_reserved_blocks();
+  st = pool.stats();
+  EXPECT_EQ(256u + 256u + 1024u, st.peak_bytes_in_use);
+  for (std::uint64_t x : st.reserved_bytes_by_scale) EXPECT_EQ(0u, x);
+}
+
+TEST_F(CPUMemoryPoolTest, CheckReleaseReservedBlocks) {
+  CPUMemoryPool pool;
+  const auto sp1 = pool.allocate(256llu);
+  pool.allocate(512llu);
+  pool.allocate(1024llu);
+  EXPECT_EQ(256u, pool.stats().bytes_in_use);
+  EXPECT_EQ(512u + 1024u, pool.stats().bytes_reserved);
+  pool.release_reserved_blocks();
+  EXPECT_EQ(256u, pool.stats().bytes_in_use);
+  EXPECT_EQ(0u, pool.stats().bytes_reserved);
+}
+
+TEST_F(CPUMemoryPoolTest, CheckDeviceMemory) {
+  CPUDevice dev;
+  {
+    const Tensor x = dev.new_tensor(Shape({4, 4}, 2), 1);
+    const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(x.data());
+    EXPECT_EQ(0u, addr % CPUMemoryPool::ALIGNMENT);
+    EXPECT_EQ(128u, dev.memory_pool_stats().bytes_in_use);
+  }
+  EXPECT_EQ(0u, dev.memory_pool_stats().bytes_in_use);
+  EXPECT_EQ(128u, dev.memory_pool_stats().bytes_reserved);
+  dev.release_reserved_memory();
+  EXPECT_EQ(0u, dev.memory_pool_stats().bytes_reserved);
+}
+
+TEST_F(CPUMemoryPoolTest, CheckOrphanedBlocks) {
+  std::shared_ptr<void> p1, p2;
+  {
+    CPUMemoryPool pool;
+    p1 = pool.allocate(1);
+    p2 = pool.allocate(1 << 10);
+    p2.reset();
+  }
+  // The block should be returned to the system without the pool.
+  EXPECT_NO_THROW(p1.reset());
+}
+
+TEST_F(CPUMemoryPoolTest, CheckTensorOutlivesDevice) {
+  Tensor x;
+  {
+    CPUDevice dev;
+    x = dev.new_tensor(Shape({4, 4}, 2), 1);
+  }
+  EXPECT_TRUE(x.valid());
+  EXPECT_NO_THROW(x = Tensor());
+  EXPECT_FALSE(x.valid());
+}
+
+}  // namespace primitiv
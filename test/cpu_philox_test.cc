@@ -0,0 +1,100 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_philox.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+namespace cpu {
+
+class CPUPhiloxTest : public testing::Test {};
+
+TEST_F(CPUPhiloxTest, CheckKnownAnswers) {
+  // Known answers of Philox4x32-10 from the Random123 library.
+  struct TestCase {
+    std::uint32_t counter[4];
+    std::uint32_t key[2];
+    std::uint32_t expected[4];
+  };
+  const vector<TestCase> test_cases {
+    {{0, 0, 0, 0}, {0, 0},
+      {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+    {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+      {0xffffffff, 0xffffffff},
+      {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+    {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+      {0xa4093822, 0x299f31d0},
+      {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+  };
+  for (const TestCase &tc : test_cases) {
+    std::uint32_t result[4];
+    philox4x32_10(tc.counter, tc.key, result);
+    for (unsigned i = 0; i < 4; ++i) {
+      EXPECT_EQ(tc.expected[i], result[i]);
+    }
+  }
+}
+
+TEST_F(CPUPhiloxTest, CheckUniformMatchesBlocks) {
+  const std::uint64_t seed = 0x123456789abcdefull;
+  const std::uint64_t offset = 0xfffffffeull;
+  const std::uint32_t key[2] {0x89abcdef, 0x1234567};
+  const unsigned size = 1000;
+  vector<float> y(size);
+  philox_uniform(seed, offset, 0, size, y.data());
+  for (unsigned i = 0; i < size; i += 4) {
+    const std::uint64_t c = offset + i / 4;
+    const std::uint32_t counter[4] {
+      static_cast<std::uint32_t>(c), static_cast<std::uint32_t>(c >> 32), 0, 0,
+    };
+    std::uint32_t bits[4];
+    philox4x32_10(counter, key, bits);
+    for (unsigned j = 0; j < 4; ++j) {
+      const float expected = bits[j] * 2.3283064e-10f + 2.3283064e-10f / 2;
+      EXPECT_EQ(expected, y[i + j]);
+      EXPECT_LT(0.f, y[i + j]);
+      EXPECT_GE(1.f, y[i + j]);
+    }
+  }
+}
+
+TEST_F(CPUPhiloxTest, CheckSplitInvariance) {
+  const unsigned size = 1001;
+  vector<float> u_all(size), n_all(size);
+  philox_uniform(42, 7, 0, size, u_all.data());
+  philox_normal(42, 7, 0, size, n_all.data());
+  for (unsigned split : {1u, 3u, 63u, 64u, 65u, 500u}) {
+    vector<float> u(size), n(size);
+    for (unsigned begin = 0; begin < size; begin += split) {
+      const unsigned end = std::min(size, begin + split);
+      philox_uniform(42, 7, begin, end, u.data());
+      philox_normal(42, 7, begin, end, n.data());
+    }
+    EXPECT_TRUE(vector_match(u_all, u));
+    EXPECT_TRUE(vector_match(n_all, n));
+  }
+}
+
+TEST_F(CPUPhiloxTest, CheckNormalMoments) {
+  const unsigned size = 1 << 16;
+  vector<float> y(size);
+  philox_normal(12345, 0, 0, size, y.data());
+  double sum = 0, sq_sum = 0;
+  for (float y_i : y) {
+    sum += y_i;
+    sq_sum += y_i * y_i;
+  }
+  const double mean = sum / size;
+  EXPECT_NEAR(0, mean, .02);
+  EXPECT_NEAR(1, sq_sum / size - mean * mean, .02);
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -0,0 +1,137 @@
+#include <config.h>
+
+#include <cstdint>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_qgemm.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+using test_utils::vector_near;
+
+namespace primitiv {
+namespace cpu {
+
+class CPUQGemmTest : public testing::Test {
+protected:
+  // Generates integers in [-127, 127].
+  static vector<float> make_data(unsigned size, unsigned seed) {
+    vector<float> ret(size);
+    for (unsigned i = 0; i < size; ++i) {
+      ret[i] = static_cast<int>((i * 37 + seed * 91) % 255) - 127;
+    }
+    return ret;
+  }
+
+  static vector<float> naive_matmul(
+      unsigned m, unsigned n, unsigned k,
+      const vector<float> &a, const vector<float> &b) {
+    vector<float> ret(m * n, 0);
+    for (unsigned j = 0; j < n; ++j) {
+      for (unsigned i = 0; i < m; ++i) {
+        for (unsigned l = 0; l < k; ++l) {
+          ret[i + j * m] += a[i + l * m] * b[l + j * k];
+        }
+      }
+    }
+    return ret;
+  }
+
+  static const vector<QGemmKernelType> &kernels() {
+    static const vector<QGemmKernelType> ret {
+      QGEMM_KERNEL_AUTO, QGEMM_KERNEL_GENERIC,
+      QGEMM_KERNEL_AVX2, QGEMM_KERNEL_VNNI,
+    };
+    return ret;
+  }
+};
+
+TEST_F(CPUQGemmTest, CheckKernelName) {
+  EXPECT_STREQ("generic", qgemm_kernel_name(QGEMM_KERNEL_GENERIC));
+  for (QGemmKernelType type : kernels()) {
+    if (qgemm_kernel_supported(type)) {
+      EXPECT_STRNE("", qgemm_kernel_name(type));
+    } else {
+      EXPECT_STREQ("generic", qgemm_kernel_name(type));
+    }
+  }
+}
+
+TEST_F(CPUQGemmTest, CheckPaddedDepth) {
+  EXPECT_EQ(0u, qgemm_padded_depth(0));
+  EXPECT_EQ(32u, qgemm_padded_depth(1));
+  EXPECT_EQ(32u, qgemm_padded_depth(32));
+  EXPECT_EQ(64u, qgemm_padded_depth(33));
+}
+
+TEST_F(CPUQGemmTest, CheckQuantizeRows) {
+  // W = [[1, -2, 4], [0, 0, 0]] in the column-major order.
+  const vector<float> w {1, 0, -2, 0, 4, 0};
+  vector<std::int8_t> q(2 * 32, 99);
+  vector<float> scales(2);
+  vector<std::int32_t> sums(2);
+  quantize_rows(2, 3, w.data(), 2, q.data(), scales.data(), sums.data());
+  EXPECT_FLOAT_EQ(4.f / 127, scales[0]);
+  EXPECT_EQ(32, q[0]);
+  EXPECT_EQ(-64, q[1]);
+  EXPECT_EQ(127, q[2]);
+  EXPECT_EQ(95, sums[0]);
+  EXPECT_FLOAT_EQ(1, scales[1]);
+  EXPECT_EQ(0, sums[1]);
+  for (unsigned l = 3; l < 32; ++l) EXPECT_EQ(0, q[l]);
+  for (unsigned l = 32; l < 64; ++l) EXPECT_EQ(0, q[l]);
+}
+
+TEST_F(CPUQGemmTest, CheckExactProducts) {
+  // Values and scales are chosen to be represented exactly.
+  const unsigned m = 70, n = 5, k = 45;
+  // Every row of A and column of B has 127 so that all scales become 1.
+  vector<float> a = make_data(m * k, 1);
+  vector<float> b = make_data(k * n, 2);
+  for (unsigned i = 0; i < m; ++i) a[i] = 127;
+  for (unsigned j = 0; j < n; ++j) b[j * k] = 127;
+  const unsigned kp = qgemm_padded_depth(k);
+  vector<std::int8_t> q(m * kp);
+  vector<float> scales(m);
+  vector<std::int32_t> sums(m);
+  quantize_rows(m, k, a.data(), m, q.data(), scales.data(), sums.data());
+
+  const vector<float> expected = naive_matmul(m, n, k, a, b);
+  for (QGemmKernelType type : kernels()) {
+    vector<float> c(m * n, -1);
+    qgemm(m, n, k, q.data(), scales.data(), sums.data(), b.data(), k,
+          c.data(), m, type);
+    EXPECT_TRUE(vector_match(expected, c))
+      << "kernel: " << qgemm_kernel_name(type);
+  }
+}
+
+TEST_F(CPUQGemmTest, CheckApproximateProducts) {
+  const unsigned m = 16, n = 3, k = 100;
+  vector<float> a(m * k), b(k * n);
+  for (unsigned i = 0; i < a.size(); ++i) a[i] = .01f * ((i * 17) % 23) - .1f;
+  for (unsigned i = 0; i < b.size(); ++i) b[i] = .1f * ((i * 7) % 11) - .5f;
+  const unsigned kp = qgemm_padded_depth(k);
+  vector<std::int8_t> q(m * kp);
+  vector<float> scales(m);
+  vector<std::int32_t> sums(m);
+  quantize_rows(m, k, a.data(), m, q.data(), scales.data(), sums.data());
+
+  const vector<float> expected = naive_matmul(m, n, k, a, b);
+  vector<float> generic(m * n);
+  qgemm(m, n, k, q.data(), scales.data(), sums.data(), b.data(), k,
+        generic.data(), m, QGEMM_KERNEL_GENERIC);
+  EXPECT_TRUE(vector_near(expected, generic, 2e-2));
+  for (QGemmKernelType type : kernels()) {
+    // All kernels calculate the same integer products.
+    vector<float> c(m * n);
+    qgemm(m, n, k, q.data(), scales.data(), sums.data(), b.data(), k,
+          c.data(), m, type);
+    EXPECT_TRUE(vector_match(generic, c))
+      << "kernel: " << qgemm_kernel_name(type);
+  }
+}
+
+}  // namespace cpu
+}  // namespace primitiv
@@ -1,9 +1,11 @@
 #include <config.h>
 
 #include <chrono>
+#include <cmath>
 #include <thread>
 #include <vector>
 #include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
 #include <primitiv/cuda_device.h>
 #include <primitiv/error.h>
 #include <primitiv/shape.h>
@@ -12,6 +14,7 @@
 
 using std::vector;
 using test_utils::vector_match;
+using test_utils::vector_near;
 
 namespace primitiv {
 
@@ -27,6 +30,245 @@ TEST_F(CUDADeviceTest, CheckInvalidInit) {
   EXPECT_THROW(CUDADevice dev(12345678), Error);
 }
 
+TEST_F(CUDADeviceTest, CheckSynchronize) {
+  CUDADevice dev(0);
+  Tensor x = dev.new_tensor(Shape({256, 256}, 4), 1);
+  for (unsigned i = 0; i < 10; ++i) dev.inplace_add(x, x);
+  EXPECT_NO_THROW(dev.synchronize());
+  EXPECT_TRUE(vector_match(vector<float>(256 * 256 * 4, 1024), x.to_vector()));
+}
+
+TEST_F(CUDADeviceTest, CheckWaitFor) {
+  CUDADevice dev1(0);
+  CUDADevice dev2(0);
+  Tensor x = dev1.new_tensor(Shape({256, 256}, 4), 1);
+  for (unsigned i = 0; i < 10; ++i) dev1.inplace_add(x, x);
+  EXPECT_NO_THROW(dev2.wait_for(dev1));
+  // Copies the result of dev1 on the stream of dev2.
+  const Tensor y = dev2.copy_tensor(x);
+  EXPECT_TRUE(vector_match(vector<float>(256 * 256 * 4, 1024), y.to_vector()));
+}
+
+TEST_F(CUDADeviceTest, CheckCaptureReplay) {
+  CUDADevice dev(0);
+  Tensor x = dev.new_tensor_by_vector({3}, {1, 2, 3});
+  Tensor acc = dev.new_tensor({2}, 0);
+  EXPECT_FALSE(dev.capturing());
+  dev.begin_capture();
+  EXPECT_TRUE(dev.capturing());
+  EXPECT_THROW(dev.begin_capture(), Error);
+  // Indices of pick_fw() are transferred from the host while capturing.
+  const Tensor y = dev.pick_fw(dev.multiply_const_fw(x, 2), 0, {2, 0});
+  dev.inplace_add(y, acc);
+  EXPECT_THROW(y.to_vector(), Error);
+  EXPECT_THROW(dev.synchronize(), Error);
+  EXPECT_THROW(dev.replay(0), Error);
+  const unsigned id = dev.end_capture();
+  EXPECT_FALSE(dev.capturing());
+  EXPECT_EQ(1u, dev.num_captures());
+  EXPECT_THROW(dev.end_capture(), Error);
+
+  dev.replay(id);
+  EXPECT_TRUE(vector_match(vector<float> {6, 2}, y.to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {6, 2}, acc.to_vector()));
+  x.reset_by_vector({4, 5, 6});
+  dev.replay(id);
+  EXPECT_TRUE(vector_match(vector<float> {12, 8}, y.to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {18, 10}, acc.to_vector()));
+
+  EXPECT_THROW(dev.replay(id + 1), Error);
+  dev.clear_captures();
+  EXPECT_EQ(0u, dev.num_captures());
+  EXPECT_THROW(dev.replay(id), Error);
+}
+
+TEST_F(CUDADeviceTest, CheckMatmulPrecision) {
+  CUDADevice dev(0);
+  EXPECT_EQ(CUDADevice::MATMUL_PRECISION_FLOAT32, dev.matmul_precision());
+  const Tensor a = dev.new_tensor_by_vector({2, 2}, {1, 2, 3, 4});
+  const Tensor b = dev.new_tensor_by_vector({2, 2}, {.5, .25, -1, 2});
+  const vector<float> expected {1.25, 2, 5, 6};
+  for (const auto precision : {
+      CUDADevice::MATMUL_PRECISION_FLOAT16,
+      CUDADevice::MATMUL_PRECISION_BFLOAT16,
+      CUDADevice::MATMUL_PRECISION_FLOAT32}) {
+    dev.set_matmul_precision(precision);
+    EXPECT_EQ(precision, dev.matmul_precision());
+    EXPECT_TRUE(vector_near(expected, dev.matmul_fw(a, b).to_vector(), 1e-2));
+  }
+  EXPECT_THROW(
+      dev.set_matmul_precision(static_cast<CUDADevice::MatmulPrecision>(-1)),
+      Error);
+  EXPECT_EQ(CUDADevice::MATMUL_PRECISION_FLOAT32, dev.matmul_precision());
+}
+
+TEST_F(CUDADeviceTest, CheckReductionKernels) {
+  CPUDevice cpu;
+  CUDADevice dev(0);
+  EXPECT_FALSE(dev.reduction_autotuning());
+  // Short rows, long rows, few rows and strided rows.
+  const vector<Shape> shapes {
+    Shape({7, 300}), Shape({5000, 3}), Shape({100000}), Shape({3, 9000}, 2),
+  };
+  for (const bool autotuning : {false, true}) {
+    dev.set_reduction_autotuning(autotuning);
+    EXPECT_EQ(autotuning, dev.reduction_autotuning());
+    for (const Shape &shape : shapes) {
+      vector<float> data(shape.size());
+      for (unsigned i = 0; i < data.size(); ++i) data[i] = (i % 17) * .125 - 1;
+      const Tensor x_cpu = cpu.new_tensor_by_vector(shape, data);
+      const Tensor x = dev.new_tensor_by_vector(shape, data);
+      for (unsigned dim : {0u, 1u}) {
+        // Results of cached configurations are also checked.
+        for (unsigned trial = 0; trial < 2; ++trial) {
+          EXPECT_TRUE(vector_near(
+                cpu.sum_fw(x_cpu, dim).to_vector(),
+                dev.sum_fw(x, dim).to_vector(), 1e-2));
+          EXPECT_TRUE(vector_near(
+                cpu.logsumexp_fw(x_cpu, dim).to_vector(),
+                dev.logsumexp_fw(x, dim).to_vector(), 1e-4));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckClipByNorm) {
+  // Results should match the CPU implementation.
+  CUDADevice dev(0);
+  CPUDevice cpu;
+  const vector<Shape> shapes {{3}, {}, {40000}, {5, 7}};
+  vector<Tensor> x, y;
+  for (const Shape &s : shapes) {
+    vector<float> data(s.size());
+    for (unsigned i = 0; i < data.size(); ++i) data[i] = .01 * (i % 17) - .05;
+    x.emplace_back(dev.new_tensor_by_vector(s, data));
+    y.emplace_back(cpu.new_tensor_by_vector(s, data));
+  }
+  vector<const Tensor *> cxs, cys;
+  vector<Tensor *> xs, ys;
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    cxs.emplace_back(&x[t]);
+    cys.emplace_back(&y[t]);
+    xs.emplace_back(&x[t]);
+    ys.emplace_back(&y[t]);
+  }
+  const Tensor sx = dev.squared_norm(cxs);
+  const Tensor sy = cpu.squared_norm(cys);
+  EXPECT_FLOAT_EQ(sy.to_vector()[0], sx.to_vector()[0]);
+  dev.clip_by_norm(.5, sx, xs);
+  cpu.clip_by_norm(.5, sy, ys);
+  for (unsigned t = 0; t < shapes.size(); ++t) {
+    EXPECT_TRUE(vector_near(y[t].to_vector(), x[t].to_vector(), 1e-6));
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckLSTM) {
+  // Results should match the CPU implementation with and without recurrent
+  // weights in the shared memory.
+  CUDADevice dev(0);
+  CPUDevice cpu;
+  const unsigned steps = 6;
+  for (const unsigned n : {3u, 40u, 100u}) {
+    const vector<Shape> shapes {
+      Shape({4 * n, steps}, 2), {4 * n, n}, {n}, Shape({n}, 2),
+      Shape({2 * n, steps}, 2),
+    };
+    vector<Tensor> x, y, gx, gy;
+    for (const Shape &s : shapes) {
+      vector<float> data(s.size());
+      for (unsigned i = 0; i < data.size(); ++i) {
+        data[i] = .3 * (i % 11) / std::sqrt(n) - .1;
+      }
+      x.emplace_back(dev.new_tensor_by_vector(s, data));
+      y.emplace_back(cpu.new_tensor_by_vector(s, data));
+      gx.emplace_back(dev.new_tensor(s, 0));
+      gy.emplace_back(cpu.new_tensor(s, 0));
+    }
+    const Tensor hx = dev.lstm_fw(x[0], x[1], x[2], x[3]);
+    const Tensor hy = cpu.lstm_fw(y[0], y[1], y[2], y[3]);
+    EXPECT_TRUE(vector_near(hy.to_vector(), hx.to_vector(), 1e-5));
+    dev.lstm_bw(x[0], x[1], x[2], x[3], hx, x[4], gx[0], gx[1], gx[2], gx[3]);
+    cpu.lstm_bw(y[0], y[1], y[2], y[3], hy, y[4], gy[0], gy[1], gy[2], gy[3]);
+    for (unsigned i = 0; i < 4; ++i) {
+      EXPECT_TRUE(vector_near(gy[i].to_vector(), gx[i].to_vector(), 1e-4))
+        << "n=" << n << ", i=" << i;
+    }
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckTopK) {
+  // Samples larger than the block contain many equal values.
+  CUDADevice dev(0);
+  CPUDevice cpu;
+  const Shape s({3000}, 5);
+  vector<float> data(s.size());
+  for (unsigned i = 0; i < data.size(); ++i) data[i] = (i * 7919) % 1009;
+  const Tensor x = dev.new_tensor_by_vector(s, data);
+  const Tensor y = cpu.new_tensor_by_vector(s, data);
+  for (const unsigned k : {1u, 10u, 300u}) {
+    vector<unsigned> dev_ids, cpu_ids;
+    vector<float> dev_values, cpu_values;
+    dev.top_k(x, k, dev_ids, dev_values);
+    cpu.top_k(y, k, cpu_ids, cpu_values);
+    EXPECT_EQ(cpu_ids, dev_ids);
+    EXPECT_TRUE(vector_match(cpu_values, dev_values));
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckCopyTensorToCPU) {
+  CUDADevice dev(0);
+  CPUDevice cpu;
+  vector<float> data(1000);
+  for (unsigned i = 0; i < data.size(); ++i) data[i] = i;
+  const Tensor x = dev.new_tensor_by_vector(Shape({10, 10}, 10), data);
+  const Tensor y = cpu.copy_tensor(x);
+  EXPECT_EQ(&cpu, y.device());
+  EXPECT_TRUE(vector_match(data, y.to_vector()));
+  const Tensor z = dev.copy_tensor(y);
+  EXPECT_TRUE(vector_match(data, z.to_vector()));
+}
+
+TEST_F(CUDADeviceTest, CheckCopyTensorBetweenGPUs) {
+  if (CUDADevice::num_devices() < 2) return;
+  CUDADevice dev0(0);
+  CUDADevice dev1(1);
+  Tensor x = dev0.new_tensor(Shape({256, 256}, 4), 1);
+  for (unsigned i = 0; i < 10; ++i) dev0.inplace_add(x, x);
+  // The second copy uses the cached state of the peer access.
+  for (unsigned i = 0; i < 2; ++i) {
+    const Tensor y = dev1.copy_tensor(x);
+    EXPECT_EQ(&dev1, y.device());
+    EXPECT_TRUE(
+        vector_match(vector<float>(256 * 256 * 4, 1024), y.to_vector()));
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckResetTensorByVectorStaging) {
+  CUDADevice dev(0);
+  // The host buffer is overwritten just after each upload.
+  vector<float> values(1000);
+  vector<Tensor> xs;
+  for (unsigned i = 0; i < 5; ++i) {
+    for (unsigned j = 0; j < values.size(); ++j) values[j] = i * 1000 + j;
+    xs.emplace_back(dev.new_tensor_by_vector(Shape({10, 10}, 10), values));
+  }
+  for (unsigned i = 0; i < 5; ++i) {
+    for (unsigned j = 0; j < values.size(); ++j) values[j] = i * 1000 + j;
+    EXPECT_TRUE(vector_match(values, xs[i].to_vector()));
+  }
+}
+
+TEST_F(CUDADeviceTest, CheckResetTensorByVectorLarge) {
+  CUDADevice dev(0);
+  // Larger than the staging buffer.
+  const unsigned size = 1 << 23;
+  vector<float> values(size);
+  for (unsigned i = 0; i < size; ++i) values[i] = i & 0xff;
+  const Tensor x = dev.new_tensor_by_vector(Shape({size}), values);
+  EXPECT_TRUE(vector_match(values, x.to_vector()));
+}
+
 TEST_F(CUDADeviceTest, CheckRandomBernoulli) {
   vector<vector<float>> history;
   for (unsigned i = 0; i < 10; ++i) {
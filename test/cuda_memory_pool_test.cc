@@ -1,5 +1,8 @@
 #include <config.h>
 
+#include <set>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cuda_memory_pool.h>
 #include <primitiv/cuda_device.h>
@@ -7,6 +10,8 @@
 #include <primitiv/error.h>
 #include <primitiv/shape.h>
 
+using std::vector;
+
 namespace primitiv {
 
 class CUDAMemoryPoolTest : public testing::Test {};
@@ -112,4 +117,183 @@ TEST_F(CUDAMemoryPoolTest, CheckReleaseReservedBlocks) {
   EXPECT_NO_THROW(pool.allocate(size));  // 2/4 of all
 }
 
+TEST_F(CUDAMemoryPoolTest, CheckStrategy) {
+  {
+    CUDAMemoryPool pool(0);
+    EXPECT_EQ(
+        CUDAMemoryPool::ALLOCATION_STRATEGY_POWER_OF_TWO, pool.strategy());
+  }
+  {
+    CUDAMemoryPool pool(0, CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT);
+    EXPECT_EQ(CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT, pool.strategy());
+  }
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckBestFitAllocate) {
+  CUDAMemoryPool pool(0, CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT);
+  const std::uint64_t size = sizeof(float) * 800 * 784;
+  void *p1, *p2;
+  {
+    const auto sp1 = pool.allocate(size);
+    const auto sp2 = pool.allocate(size);
+    p1 = sp1.get();
+    p2 = sp2.get();
+    // Blocks are carved out of the same segment without padding to 2^n.
+    EXPECT_EQ(
+        pool.BLOCK_ALIGNMENT * ((size + pool.BLOCK_ALIGNMENT - 1) /
+          pool.BLOCK_ALIGNMENT),
+        static_cast<char *>(p2) - static_cast<char *>(p1));
+  }
+  {
+    // Freed blocks are coalesced and reused.
+    const auto sp = pool.allocate(2 * size);
+    EXPECT_EQ(p1, sp.get());
+  }
+  {
+    // Blocks larger than the segment size.
+    const auto sp1 = pool.allocate(CUDAMemoryPool::SEGMENT_SIZE + 1);
+    const auto sp2 = pool.allocate(1);
+    EXPECT_NE(nullptr, sp1.get());
+    EXPECT_NE(nullptr, sp2.get());
+  }
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckBestFitInvalidAllocate) {
+  CUDAMemoryPool pool(0, CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT);
+
+  // Available maximum size of the memory: 2^63 bytes.
+  EXPECT_THROW(pool.allocate((1llu << 63) + 1), Error);
+
+  ::cudaDeviceProp prop;
+  CUDA_CALL(::cudaGetDeviceProperties(&prop, 0));
+
+  // Binds more than half of the whole memory to an lvalue.
+  std::shared_ptr<void> sp;
+  const std::uint64_t size = (prop.totalGlobalMem >> 1) + (1llu << 20);
+  ASSERT_NO_THROW(sp = pool.allocate(size));
+  EXPECT_THROW(pool.allocate(size), Error);  // Out of memory
+  sp.reset();
+  EXPECT_NO_THROW(pool.allocate(size));
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckStats) {
+  CUDAMemoryPool pool(0);
+  {
+    const auto sp1 = pool.allocate(1000llu);
+    const auto sp2 = pool.allocate(1024llu);
+    const MemoryPoolStats st = pool.stats();
+    EXPECT_EQ(2048u, st.bytes_in_use);
+    EXPECT_EQ(0u, st.bytes_reserved);
+  }
+  {
+    const auto sp1 = pool.allocate(1024llu);
+  }
+  const MemoryPoolStats st = pool.stats();
+  EXPECT_EQ(0u, st.bytes_in_use);
+  EXPECT_EQ(2048u, st.peak_bytes_in_use);
+  EXPECT_EQ(2048u, st.bytes_reserved);
+  EXPECT_EQ(3u, st.num_requests);
+  EXPECT_EQ(1u, st.num_hits);
+  EXPECT_EQ(2u, st.num_system_allocs);
+  EXPECT_EQ(0u, st.num_oom_retries);
+  ASSERT_EQ(64u, st.reserved_bytes_by_scale.size());
+  EXPECT_EQ(2048u, st.reserved_bytes_by_scale[10]);
+  pool.release_reserved_blocks();
+  EXPECT_EQ(0u, pool.stats().bytes_reserved);
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckBestFitStats) {
+  CUDAMemoryPool pool(0, CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT);
+  {
+    const auto sp1 = pool.allocate(1000llu);
+    const auto sp2 = pool.allocate(1024llu);
+    const MemoryPoolStats st = pool.stats();
+    EXPECT_EQ(1024u + 1024u, st.bytes_in_use);
+    EXPECT_EQ(CUDAMemoryPool::SEGMENT_SIZE - 2048u, st.bytes_reserved);
+  }
+  const MemoryPoolStats st = pool.stats();
+  EXPECT_EQ(0u, st.bytes_in_use);
+  EXPECT_EQ(2048u, st.peak_bytes_in_use);
+  EXPECT_EQ(CUDAMemoryPool::SEGMENT_SIZE, st.bytes_reserved);
+  EXPECT_EQ(2u, st.num_requests);
+  EXPECT_EQ(1u, st.num_hits);
+  EXPECT_EQ(1u, st.num_system_allocs);
+  EXPECT_TRUE(st.reserved_bytes_by_scale.empty());
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckOOMRetryCount) {
+  CUDAMemoryPool pool(0, CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT);
+
+  ::cudaDeviceProp prop;
+  CUDA_CALL(::cudaGetDeviceProperties(&prop, 0));
+
+  // More than half of the whole memory.
+  const std::uint64_t size = (prop.totalGlobalMem >> 1) + (1llu << 20);
+
+  pool.allocate(size);  // The segment is kept in the pool.
+  EXPECT_EQ(0u, pool.stats().num_oom_retries);
+  // The reserved segment is too small and should be released to allocate
+  // another one.
+  EXPECT_NO_THROW(pool.allocate(size + CUDAMemoryPool::BLOCK_ALIGNMENT));
+  EXPECT_EQ(1u, pool.stats().num_oom_retries);
+  EXPECT_EQ(2u, pool.stats().num_system_allocs);
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckSpillToSharedList) {
+  CUDAMemoryPool pool(0);
+  const unsigned n = CUDAMemoryPool::MAX_CACHED_BLOCKS + 4;
+  std::set<void *> ptrs;
+  {
+    vector<std::shared_ptr<void>> sps;
+    for (unsigned i = 0; i < n; ++i) {
+      sps.emplace_back(pool.allocate(1024llu));
+      ptrs.insert(sps.back().get());
+    }
+  }
+  // All blocks are kept in either the thread-local cache or the shared list.
+  EXPECT_EQ(n * 1024u, pool.stats().bytes_reserved);
+  {
+    vector<std::shared_ptr<void>> sps;
+    for (unsigned i = 0; i < n; ++i) {
+      sps.emplace_back(pool.allocate(1024llu));
+      EXPECT_EQ(1u, ptrs.count(sps.back().get()));
+    }
+  }
+  EXPECT_EQ(n, pool.stats().num_hits);
+  EXPECT_EQ(n, pool.stats().num_system_allocs);
+}
+
+TEST_F(CUDAMemoryPoolTest, CheckConcurrentAllocate) {
+  const CUDAMemoryPool::AllocationStrategy strategies[] {
+    CUDAMemoryPool::ALLOCATION_STRATEGY_POWER_OF_TWO,
+    CUDAMemoryPool::ALLOCATION_STRATEGY_BEST_FIT,
+  };
+  const unsigned NUM_THREADS = 8;
+  const unsigned NUM_ITERATIONS = 200;
+
+  for (const auto strategy : strategies) {
+    CUDAMemoryPool pool(0, strategy);
+    vector<std::thread> threads;
+    for (unsigned t = 0; t < NUM_THREADS; ++t) {
+      threads.emplace_back([&pool, t]() {
+        vector<std::shared_ptr<void>> sps;
+        for (unsigned i = 0; i < NUM_ITERATIONS; ++i) {
+          sps.emplace_back(pool.allocate(1llu << ((t + i) % 24)));
+          // Blocks may also be released by the other thread.
+          if (i % 3 == 0) sps.erase(sps.begin());
+        }
+      });
+    }
+    for (std::thread &th : threads) th.join();
+
+    const MemoryPoolStats st = pool.stats();
+    EXPECT_EQ(0u, st.bytes_in_use);
+    EXPECT_EQ(NUM_THREADS * NUM_ITERATIONS, st.num_requests);
+    EXPECT_EQ(st.num_requests, st.num_hits + st.num_system_allocs);
+    EXPECT_LT(0u, st.peak_bytes_in_use);
+    pool.release_reserved_blocks();
+    EXPECT_EQ(0u, pool.stats().bytes_reserved);
+  }
+}
+
 }  // namespace primitiv
@@ -0,0 +1,129 @@
+#include <config.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/data_loader.h>
+#include <primitiv/error.h>
+#include <test_utils.h>
+
+using std::string;
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+
+class DataLoaderTest : public testing::Test {
+protected:
+  // Writes samples [begin, end) to a shard. The i-th sample has the input
+  // {i, -i} and the label {i + .5}.
+  static string write_shard(
+      const string &name, unsigned begin, unsigned end,
+      unsigned header_size = 0) {
+    const string path = "/tmp/primitiv_DataLoaderTest_" + name + ".bin";
+    std::ofstream ofs(path, std::ios::binary);
+    const string header(header_size, 'h');
+    ofs.write(header.data(), header.size());
+    for (unsigned i = begin; i < end; ++i) {
+      const float values[] {
+        static_cast<float>(i), -static_cast<float>(i), i + .5f,
+      };
+      ofs.write(reinterpret_cast<const char *>(values), sizeof(values));
+    }
+    return path;
+  }
+
+  // Retrieves IDs of samples in each minibatch of one epoch.
+  static vector<vector<float>> read_epoch(DataLoader &loader) {
+    vector<vector<float>> ret;
+    vector<Tensor> batch;
+    while (loader.next(batch)) {
+      EXPECT_EQ(2u, batch.size());
+      const vector<float> x = batch[0].to_vector();
+      const vector<float> t = batch[1].to_vector();
+      const unsigned n = batch[0].shape().batch();
+      EXPECT_EQ(Shape({2}, n), batch[0].shape());
+      EXPECT_EQ(Shape({}, n), batch[1].shape());
+      vector<float> ids;
+      for (unsigned j = 0; j < n; ++j) {
+        EXPECT_EQ(-x[2 * j], x[2 * j + 1]);
+        EXPECT_EQ(x[2 * j] + .5f, t[j]);
+        ids.emplace_back(x[2 * j]);
+      }
+      ret.emplace_back(ids);
+    }
+    return ret;
+  }
+
+  CPUDevice dev;
+};
+
+TEST_F(DataLoaderTest, CheckSequential) {
+  const vector<string> paths {
+    write_shard("CheckSequential0", 0, 3, 8),
+    write_shard("CheckSequential1", 3, 7, 8),
+  };
+  for (unsigned num_threads : {1u, 3u}) {
+    DataLoader loader(
+        paths, {Shape({2}), Shape()}, dev, 3, false, 0, num_threads, 2, 8);
+    EXPECT_EQ(7u, loader.num_samples());
+    EXPECT_EQ(3u, loader.num_batches());
+    for (unsigned epoch = 0; epoch < 3; ++epoch) {
+      const vector<vector<float>> ids = read_epoch(loader);
+      ASSERT_EQ(3u, ids.size());
+      EXPECT_TRUE(vector_match(vector<float> {0, 1, 2}, ids[0]));
+      EXPECT_TRUE(vector_match(vector<float> {3, 4, 5}, ids[1]));
+      EXPECT_TRUE(vector_match(vector<float> {6}, ids[2]));
+    }
+  }
+}
+
+TEST_F(DataLoaderTest, CheckShuffle) {
+  const vector<string> paths {write_shard("CheckShuffle", 0, 20)};
+  DataLoader loader1(paths, {Shape({2}), Shape()}, dev, 4, true, 1, 2);
+  DataLoader loader2(paths, {Shape({2}), Shape()}, dev, 4, true, 1, 1, 1);
+  vector<float> prev;
+  for (unsigned epoch = 0; epoch < 3; ++epoch) {
+    const vector<vector<float>> ids1 = read_epoch(loader1);
+    const vector<vector<float>> ids2 = read_epoch(loader2);
+    ASSERT_EQ(5u, ids1.size());
+    // Same seeds give same orders regardless of the number of threads.
+    EXPECT_EQ(ids1, ids2);
+    vector<float> all;
+    for (const vector<float> &ids : ids1) {
+      all.insert(all.end(), ids.begin(), ids.end());
+    }
+    EXPECT_NE(prev, all);
+    prev = all;
+    std::sort(all.begin(), all.end());
+    for (unsigned i = 0; i < 20; ++i) EXPECT_EQ(i, all[i]);
+  }
+}
+
+TEST_F(DataLoaderTest, CheckInvalidShards) {
+  const string path = write_shard("CheckInvalidShards", 0, 2, 4);
+  EXPECT_THROW(
+      DataLoader(
+        {path}, {Shape({2}), Shape()}, dev, 2, false, 0, 1, 1, 0),
+      Error);
+  EXPECT_THROW(
+      DataLoader({path}, {Shape({2}, 2)}, dev, 2, false, 0, 1, 1, 4), Error);
+  EXPECT_THROW(
+      DataLoader({path}, {Shape({3})}, dev, 0, false, 0, 1, 1, 4), Error);
+  EXPECT_THROW(
+      DataLoader(
+        {path + ".none"}, {Shape({3})}, dev, 1, false, 0, 1, 1, 4),
+      Error);
+  EXPECT_THROW(
+      DataLoader(
+        {write_shard("CheckInvalidShardsEmpty", 0, 0)}, {Shape({3})}, dev,
+        1, false),
+      Error);
+  EXPECT_NO_THROW(
+      DataLoader({path}, {Shape({3})}, dev, 1, false, 0, 1, 1, 4));
+}
+
+}  // namespace primitiv
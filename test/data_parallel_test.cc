@@ -0,0 +1,117 @@
+#include <config.h>
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/data_parallel.h>
+#include <primitiv/error.h>
+#include <primitiv/parameter.h>
+#include <primitiv/trainer_impl.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+
+class DataParallelTest : public testing::Test {
+protected:
+  CPUDevice dev0;
+  CPUDevice dev1;
+  CPUDevice dev2;
+};
+
+TEST_F(DataParallelTest, CheckInvalidDevices) {
+  EXPECT_THROW(DataParallel dp(vector<Device *> {}), Error);
+  EXPECT_THROW(DataParallel dp({&dev0, &dev0}), Error);
+  EXPECT_THROW(DataParallel dp({&dev0, &dev1, &dev0}), Error);
+  EXPECT_NO_THROW(DataParallel dp({&dev0}));
+  EXPECT_NO_THROW(DataParallel dp({&dev0, &dev1, &dev2}));
+}
+
+TEST_F(DataParallelTest, CheckInvalidAddParameter) {
+  DataParallel dp({&dev0, &dev1});
+  Parameter p0("p0", {2, 2}, &dev0);
+  Parameter p1("p1", {2, 2}, &dev1);
+  Parameter q0("q0", {2, 2}, &dev0);
+  Parameter r1("r1", {3}, &dev1);
+  EXPECT_THROW(dp.add_parameter({&p0}), Error);
+  EXPECT_THROW(dp.add_parameter({&p0, &p1, &q0}), Error);
+  EXPECT_THROW(dp.add_parameter({&p0, &q0}), Error);
+  EXPECT_THROW(dp.add_parameter({&p1, &p0}), Error);
+  EXPECT_THROW(dp.add_parameter({&p0, &r1}), Error);
+  EXPECT_NO_THROW(dp.add_parameter({&p0, &p1}));
+  EXPECT_THROW(dp.add_parameter({&p0, &p1}), Error);
+}
+
+TEST_F(DataParallelTest, CheckBroadcastValues) {
+  DataParallel dp({&dev0, &dev1, &dev2});
+  Parameter p0("p", {2}, {1, 2}, &dev0);
+  Parameter p1("p", {2}, {3, 4}, &dev1);
+  Parameter p2("p", {2}, {5, 6}, &dev2);
+  dp.add_parameter({&p0, &p1, &p2});
+  dp.broadcast_values();
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, p0.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, p1.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, p2.value().to_vector()));
+}
+
+TEST_F(DataParallelTest, CheckAllreduceGradients) {
+  // Bucket size of 2 floats makes 2 buckets: {a}, {b, c}.
+  DataParallel dp({&dev0, &dev1}, 2 * sizeof(float));
+  Parameter a0("a", {2}, &dev0), a1("a", {2}, &dev1);
+  Parameter b0("b", {}, &dev0), b1("b", {}, &dev1);
+  Parameter c0("c", {}, &dev0), c1("c", {}, &dev1);
+  dp.add_parameter({&a0, &a1});
+  dp.add_parameter({&b0, &b1});
+  dp.add_parameter({&c0, &c1});
+  a0.gradient().reset_by_vector({1, 2});
+  a1.gradient().reset_by_vector({3, 6});
+  b0.gradient().reset(1);
+  b1.gradient().reset(2);
+  c0.gradient().reset(-4);
+  c1.gradient().reset(0);
+
+  dp.allreduce_gradients();
+  for (const Parameter *p : {&a0, &a1}) {
+    EXPECT_TRUE(vector_match(vector<float> {2, 4}, p->gradient().to_vector()));
+    EXPECT_TRUE(p->gradient().aliased());
+  }
+  for (const Parameter *p : {&b0, &b1}) {
+    EXPECT_TRUE(vector_match(vector<float> {1.5}, p->gradient().to_vector()));
+  }
+  for (const Parameter *p : {&c0, &c1}) {
+    EXPECT_TRUE(vector_match(vector<float> {-2}, p->gradient().to_vector()));
+  }
+
+  // Replaced gradients are moved into buckets again.
+  b1.gradient() = dev1.new_tensor({}, 5);
+  b0.gradient().reset(1);
+  dp.allreduce_gradients();
+  EXPECT_TRUE(b1.gradient().aliased());
+  EXPECT_TRUE(vector_match(vector<float> {3}, b0.gradient().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {3}, b1.gradient().to_vector()));
+}
+
+TEST_F(DataParallelTest, CheckTraining) {
+  // Both replicas should keep the same values.
+  DataParallel dp({&dev0, &dev1});
+  Parameter p0("p0", {3}, {1, 2, 3}, &dev0);
+  Parameter p1("p1", {3}, {0, 0, 0}, &dev1);
+  dp.add_parameter({&p0, &p1});
+  dp.broadcast_values();
+  trainers::Adam trainer;
+  trainer.add_parameter(&p0);
+  trainer.add_parameter(&p1);
+
+  for (unsigned i = 0; i < 3; ++i) {
+    trainer.reset_gradients();
+    p0.gradient().reset_by_vector({1, -1, 2});
+    p1.gradient().reset_by_vector({3, 1, -4});
+    dp.allreduce_gradients();
+    trainer.update(1);
+    EXPECT_TRUE(vector_match(p0.value().to_vector(), p1.value().to_vector()));
+  }
+}
+
+}  // namespace primitiv
@@ -1,8 +1,10 @@
 #include <config.h>
 
+#include <memory>
 #include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
 #include <primitiv/function_impl.h>
 #include <primitiv/initializer_impl.h>
 #include <primitiv/parameter.h>
@@ -189,6 +191,47 @@ TEST_F(FunctionImplTest, CheckInput) {
   EXPECT_TRUE(vector_match(ret_data, cur_value.to_vector()));
 }
 
+TEST_F(FunctionImplTest, CheckTensorInput) {
+  const Shape ret_shape({2, 2}, 3);
+  const vector<float> ret_data {1, 2, 3, 4, 0, 0, 0, 0, -1, -2, -3, -4};
+  const Tensor x = dev->new_tensor_by_vector(ret_shape, ret_data);
+  EXPECT_THROW(TensorInput {Tensor()}, Error);
+  TensorInput node(x);
+  const Shape cur_shape = node.forward_shape(arg_shapes);
+  const Tensor cur_value = node.forward(arg_values);
+  const Tensor cur_grad = dev->new_tensor(ret_shape, 1);
+  // backward() has no effect.
+  EXPECT_NO_THROW(node.backward(cur_value, cur_grad, arg_values, arg_grads));
+  EXPECT_EQ("TensorInput", node.name());
+  EXPECT_EQ(ret_shape, cur_shape);
+  EXPECT_EQ(dev, node.get_device());
+  EXPECT_TRUE(vector_match(ret_data, cur_value.to_vector()));
+  // The result shares the memory of `x`.
+  EXPECT_EQ(x.data(), cur_value.data());
+}
+
+TEST_F(FunctionImplTest, CheckHostInput) {
+  const Shape ret_shape({2, 2}, 3);
+  std::shared_ptr<vector<float>> data = std::make_shared<vector<float>>(
+      vector<float> {1, 2, 3, 4, 0, 0, 0, 0, -1, -2, -3, -4});
+  EXPECT_THROW(HostInput(ret_shape, nullptr, nullptr, dev), Error);
+  HostInput node(ret_shape, data->data(), data, dev);
+  const vector<float> ret_data = *data;
+  const float *ptr = data->data();
+  // The node keeps the buffer alive.
+  data.reset();
+  const Shape cur_shape = node.forward_shape(arg_shapes);
+  const Tensor cur_value = node.forward(arg_values);
+  const Tensor cur_grad = dev->new_tensor(ret_shape, 1);
+  // backward() has no effect.
+  EXPECT_NO_THROW(node.backward(cur_value, cur_grad, arg_values, arg_grads));
+  EXPECT_EQ("HostInput", node.name());
+  EXPECT_EQ(ret_shape, cur_shape);
+  EXPECT_EQ(dev, node.get_device());
+  EXPECT_TRUE(vector_match(ret_data, cur_value.to_vector()));
+  EXPECT_EQ(1, ptr[0]);
+}
+
 TEST_F(FunctionImplTest, CheckParameterInput) {
   const Shape ret_shape {2, 2};
   const initializers::Constant init(42);
@@ -212,6 +255,28 @@ TEST_F(FunctionImplTest, CheckParameterInput) {
   EXPECT_TRUE(vector_match(vector<float>(4, 1), param.gradient().to_vector()));
 }
 
+TEST_F(FunctionImplTest, CheckLookup) {
+  const Shape ret_shape({2}, 3);
+  Parameter param("param", {2, 3}, {1, 2, 3, 4, 5, 6}, dev);
+  param.reset_gradient();
+
+  Lookup node(&param, 1, {2, 0, 2});
+  const Shape cur_shape = node.forward_shape(arg_shapes);
+  const Tensor cur_value = node.forward(arg_values);
+  const Tensor cur_grad = dev->new_tensor(ret_shape, 1);
+  // backward() updates the gradient of `param`.
+  EXPECT_NO_THROW(node.backward(cur_value, cur_grad, arg_values, arg_grads));
+  EXPECT_EQ("Lookup(1)", node.name());
+  EXPECT_EQ(ret_shape, cur_shape);
+  EXPECT_EQ(dev, node.get_device());
+  EXPECT_TRUE(vector_match(
+        vector<float>({5, 6, 1, 2, 5, 6}), cur_value.to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float>({1, 1, 0, 0, 2, 2}), param.gradient().to_vector()));
+  EXPECT_TRUE(param.has_sparse_gradient());
+  EXPECT_EQ(vector<unsigned>({0, 2}), param.gradient_rows());
+}
+
 TEST_F(FunctionImplTest, CheckCopy) {
   CPUDevice dev2;
   const Shape ret_shape({2, 2}, 3);
@@ -430,6 +495,69 @@ TEST_F(FunctionImplTest, CheckPick) {
   }
 }
 
+TEST_F(FunctionImplTest, CheckGather) {
+  struct TestCase {
+    unsigned dim;
+    vector<unsigned> ids;
+    Shape ret_shape;
+    vector<float> ret_data;
+    vector<float> bw_grad;
+  };
+  const vector<TestCase> test_cases {
+    {0, {1, 1, 0}, Shape({3, 2}, 3),
+      {2, 2, 1, 4, 4, 3, 0, 0, 0, 0, 0, 0, -2, -2, -1, -4, -4, -3},
+      {1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2}},
+    {1, {1}, Shape({2, 1}, 3),
+      {3, 4, 0, 0, -3, -4},
+      {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1}},
+  };
+  setup_1arg();
+  for (const TestCase &tc : test_cases) {
+    Gather node(tc.dim, tc.ids);
+    const Shape cur_shape = node.forward_shape(arg_shapes);
+    const Tensor cur_value = node.forward(arg_values);
+    const Tensor cur_grad = dev->new_tensor(tc.ret_shape, 1);
+    reset_gradients();
+    node.backward(cur_value, cur_grad, arg_values, arg_grads);
+    EXPECT_EQ("Gather(" + std::to_string(tc.dim) + ')', node.name());
+    EXPECT_EQ(tc.ret_shape, cur_shape);
+    EXPECT_EQ(nullptr, node.get_device());
+    EXPECT_TRUE(vector_match(tc.ret_data, cur_value.to_vector()));
+    EXPECT_TRUE(vector_match(tc.bw_grad, arg_grads[0]->to_vector()));
+  }
+}
+
+TEST_F(FunctionImplTest, CheckBatchPick) {
+  struct TestCase {
+    vector<unsigned> ids;
+    Shape ret_shape;
+    vector<float> ret_data;
+    vector<float> bw_grad;
+  };
+  const vector<TestCase> test_cases {
+    {{2, 0, 2, 2}, Shape({2, 2}, 4),
+      {-1, -2, -3, -4, 1, 2, 3, 4, -1, -2, -3, -4, -1, -2, -3, -4},
+      {1, 1, 1, 1, 0, 0, 0, 0, 3, 3, 3, 3}},
+    {{1}, Shape({2, 2}),
+      {0, 0, 0, 0},
+      {0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0}},
+  };
+  setup_1arg();
+  for (const TestCase &tc : test_cases) {
+    BatchPick node(tc.ids);
+    const Shape cur_shape = node.forward_shape(arg_shapes);
+    const Tensor cur_value = node.forward(arg_values);
+    const Tensor cur_grad = dev->new_tensor(tc.ret_shape, 1);
+    reset_gradients();
+    node.backward(cur_value, cur_grad, arg_values, arg_grads);
+    EXPECT_EQ("BatchPick", node.name());
+    EXPECT_EQ(tc.ret_shape, cur_shape);
+    EXPECT_EQ(nullptr, node.get_device());
+    EXPECT_TRUE(vector_match(tc.ret_data, cur_value.to_vector()));
+    EXPECT_TRUE(vector_match(tc.bw_grad, arg_grads[0]->to_vector()));
+  }
+}
+
 TEST_F(FunctionImplTest, CheckSlice) {
   struct TestCase {
     unsigned dim, lower, upper;
@@ -1090,6 +1218,84 @@ TEST_F(FunctionImplTest, CheckLogSumExp) {
   }
 }
 
+TEST_F(FunctionImplTest, CheckLogSoftmax) {
+  // y = log_softmax(x, dim)
+  // dy/dx = gy - softmax(x, dim) * sum(gy, dim)
+  setup_1arg();
+  struct TestCase {
+    unsigned dim;
+    vector<float> ret_data;
+    vector<float> bw_grad;
+  };
+  const vector<TestCase> test_cases {
+    {0,
+      {-1.31326169, -0.31326169, -1.31326169, -0.31326169,
+        -0.69314718, -0.69314718, -0.69314718, -0.69314718,
+        -0.31326169, -1.31326169, -0.31326169, -1.31326169},
+      {0.46211716, -0.46211716, 0.46211716, -0.46211716,
+        0, 0, 0, 0,
+        -0.46211716, 0.46211716, -0.46211716, 0.46211716}},
+    {2,
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}},
+  };
+  for (const TestCase &tc : test_cases) {
+    LogSoftmax node(tc.dim);
+    const Shape cur_shape = node.forward_shape(arg_shapes);
+    const Tensor cur_value = node.forward(arg_values);
+    const Tensor cur_grad = dev->new_tensor(Shape({2, 2}, 3), 1);
+    reset_gradients();
+    node.backward(cur_value, cur_grad, arg_values, arg_grads);
+    EXPECT_EQ("LogSoftmax(" + std::to_string(tc.dim) + ')', node.name());
+    EXPECT_EQ(Shape({2, 2}, 3), cur_shape);
+    EXPECT_EQ(nullptr, node.get_device());
+    EXPECT_TRUE(vector_near(tc.ret_data, cur_value.to_vector(), 1e-6));
+    EXPECT_TRUE(vector_near(tc.bw_grad, arg_grads[0]->to_vector(), 1e-6));
+  }
+}
+
+TEST_F(FunctionImplTest, CheckSoftmax) {
+  // y = softmax(x, dim)
+  // dy/dx = y * (gy - sum(y * gy, dim))
+  setup_1arg();
+  struct TestCase {
+    unsigned dim;
+    vector<float> ret_data;
+    vector<float> gy_data;
+    vector<float> bw_grad;
+  };
+  const vector<TestCase> test_cases {
+    {0,
+      {0.26894142, 0.73105858, 0.26894142, 0.73105858,
+        .5, .5, .5, .5,
+        0.73105858, 0.26894142, 0.73105858, 0.26894142},
+      {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}},
+    {0,
+      {0.26894142, 0.73105858, 0.26894142, 0.73105858,
+        .5, .5, .5, .5,
+        0.73105858, 0.26894142, 0.73105858, 0.26894142},
+      {1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1},
+      {0.19661193, -0.19661193, -0.19661193, 0.19661193,
+        .25, -.25, -.25, .25,
+        0.19661193, -0.19661193, -0.19661193, 0.19661193}},
+  };
+  for (const TestCase &tc : test_cases) {
+    Softmax node(tc.dim);
+    const Shape cur_shape = node.forward_shape(arg_shapes);
+    const Tensor cur_value = node.forward(arg_values);
+    const Tensor cur_grad = dev->new_tensor_by_vector(
+        Shape({2, 2}, 3), tc.gy_data);
+    reset_gradients();
+    node.backward(cur_value, cur_grad, arg_values, arg_grads);
+    EXPECT_EQ("Softmax(" + std::to_string(tc.dim) + ')', node.name());
+    EXPECT_EQ(Shape({2, 2}, 3), cur_shape);
+    EXPECT_EQ(nullptr, node.get_device());
+    EXPECT_TRUE(vector_near(tc.ret_data, cur_value.to_vector(), 1e-6));
+    EXPECT_TRUE(vector_near(tc.bw_grad, arg_grads[0]->to_vector(), 1e-6));
+  }
+}
+
 TEST_F(FunctionImplTest, CheckBroadcast) {
   // y = broadcast(x, dim, size)
   // dy/dx = sum(1, dim)
@@ -1141,6 +1347,95 @@ TEST_F(FunctionImplTest, CheckBatchSum) {
   TEST_1ARG(BatchSum);
 }
 
+TEST_F(FunctionImplTest, CheckBatchNormalize) {
+  // y = (x - mean(x)) / sqrt(var(x) + eps)
+  // dy/dx = (gy - mean(gy) - y * sum(gy * y) / (B - 1)) / sqrt(var(x) + eps)
+  setup_1arg();
+  const Shape ret_shape {2, 2};
+  const initializers::Constant init(0);
+  Parameter param("param", ret_shape, dev);
+  param.reset_value(init);
+  BatchNormalize node(&param, true, .5, 0);
+  const Shape cur_shape = node.forward_shape(arg_shapes);
+  const Tensor cur_value = node.forward(arg_values);
+  const Tensor cur_grad = dev->new_tensor_by_vector(
+      *arg_shapes[0], {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 2, 1});
+  node.backward(cur_value, cur_grad, arg_values, arg_grads);
+  EXPECT_EQ("BatchNormalize(train)", node.name());
+  EXPECT_EQ(*arg_shapes[0], cur_shape);
+  EXPECT_EQ(nullptr, node.get_device());
+  EXPECT_TRUE(vector_near(
+        vector<float> {1, 1, 1, 1, 0, 0, 0, 0, -1, -1, -1, -1},
+        cur_value.to_vector(), 1e-6));
+  EXPECT_TRUE(vector_near(
+        vector<float> {
+          1./6, -1./6, 1./9, 1./24,
+          -1./3, 1./3, -2./9, -1./12,
+          1./6, -1./6, 1./9, 1./24},
+        arg_grads[0]->to_vector(), 1e-6));
+
+  // Running statistics are initialized by mean = 0 and var = 1.
+  EXPECT_TRUE(vector_match(
+        vector<float>(4, 0), param.stats("batch_mean").to_vector()));
+  EXPECT_TRUE(vector_near(
+        vector<float> {1, 2.5, 5, 8.5},
+        param.stats("batch_var").to_vector(), 1e-6));
+
+  // Recalculation does not update running statistics again.
+  node.forward(arg_values);
+  EXPECT_TRUE(vector_near(
+        vector<float> {1, 2.5, 5, 8.5},
+        param.stats("batch_var").to_vector(), 1e-6));
+}
+
+TEST_F(FunctionImplTest, CheckBatchNormalizeWithRunningStatistics) {
+  // y = (x - batch_mean) / sqrt(batch_var + eps)
+  // dy/dx = 1 / sqrt(batch_var + eps)
+  setup_1arg();
+  const Shape ret_shape {2, 2};
+  const initializers::Constant init(0);
+  Parameter param("param", ret_shape, dev);
+  param.reset_value(init);
+  param.add_stats("batch_mean", ret_shape);
+  param.add_stats("batch_var", ret_shape);
+  param.stats("batch_mean").reset_by_vector({1, 0, 0, 0});
+  param.stats("batch_var").reset_by_vector({1, 4, 16, 64});
+  BatchNormalize node(&param, false, .5, 0);
+  const Shape cur_shape = node.forward_shape(arg_shapes);
+  const Tensor cur_value = node.forward(arg_values);
+  const Tensor cur_grad = dev->new_tensor(*arg_shapes[0], 1);
+  node.backward(cur_value, cur_grad, arg_values, arg_grads);
+  EXPECT_EQ("BatchNormalize(eval)", node.name());
+  EXPECT_EQ(*arg_shapes[0], cur_shape);
+  EXPECT_TRUE(vector_match(
+        vector<float> {0, 1, .75, .5, -1, 0, 0, 0, -2, -1, -.75, -.5},
+        cur_value.to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float> {
+          1, .5, .25, .125, 1, .5, .25, .125, 1, .5, .25, .125},
+        arg_grads[0]->to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float> {1, 4, 16, 64}, param.stats("batch_var").to_vector()));
+}
+
+TEST_F(FunctionImplTest, CheckInvalidBatchNormalize) {
+  const Shape x_shape {2, 2};
+  const vector<const Shape *> args {&x_shape};
+  const initializers::Constant init(0);
+  Parameter param("param", {3}, dev);
+  param.reset_value(init);
+  param.add_stats("batch_mean", {3});
+  const Shape xb_shape({2, 2}, 3);
+  const vector<const Shape *> args_b {&xb_shape};
+  const BatchNormalize train(nullptr, true, .1, 0);
+  const BatchNormalize eval(nullptr, false, .1, 0);
+  const BatchNormalize train_with_stats(&param, true, .1, 0);
+  EXPECT_THROW(train.forward_shape(args), Error);
+  EXPECT_NO_THROW(train.forward_shape(args_b));
+  EXPECT_THROW(eval.forward_shape(args_b), Error);
+  EXPECT_THROW(train_with_stats.forward_shape(args_b), Error);
+}
+
 TEST_F(FunctionImplTest, CheckSoftmaxCrossEntropy) {
   // y = softmax_cross_entropy(x, t, dim)
   // dy/dx = softmax(x) - t
@@ -1,16 +1,27 @@
 #include <config.h>
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
 #include <primitiv/function_impl.h>
 #include <primitiv/graph.h>
 #include <primitiv/initializer_impl.h>
 #include <primitiv/node_ops.h>
 #include <primitiv/parameter.h>
+#include <primitiv/tensor_ops.h>
+#include <primitiv/trainer_impl.h>
 #include <test_utils.h>
 
+using std::move;
 using std::vector;
 using test_utils::vector_match;
 using test_utils::vector_near;
@@ -119,8 +130,8 @@ TEST_F(GraphTest, CheckForwardBackward) {
     ASSERT_TRUE(val1.valid());
     EXPECT_TRUE(vector_match(expected_values[i], val1.to_vector()));
 
-    // Gradients are also initialized.
-    EXPECT_NO_THROW(g.get_gradient(nodes[i]));
+    // Gradients are not allocated until backward().
+    EXPECT_THROW(g.get_gradient(nodes[i]), Error);
   }
 
   g.backward(nodes.back());
@@ -145,6 +156,678 @@ TEST_F(GraphTest, CheckForwardBackward) {
   }
 }
 
+TEST_F(GraphTest, CheckDeepForward) {
+  // Recursive implementations would overflow the stack for such graphs.
+  const unsigned DEPTH = 100000;
+  Graph g;
+  const Node x = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  Node y = x;
+  for (unsigned i = 0; i < DEPTH; ++i) y = y + 1;
+  EXPECT_TRUE(vector_match(
+        vector<float> {DEPTH + 1.f, DEPTH + 2.f}, g.forward(y).to_vector()));
+  g.backward(y);
+  EXPECT_TRUE(vector_match(
+        vector<float> {1, 1}, g.get_gradient(x).to_vector()));
+}
+
+TEST_F(GraphTest, CheckPartialForward) {
+  Graph g;
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = a + 1;
+  const Node c = a + 2;
+  const Node d = b * c;
+  EXPECT_TRUE(vector_match(vector<float> {2, 3}, g.forward(b).to_vector()));
+  // Unrequired nodes are not calculated.
+  EXPECT_THROW(g.get_value(c), Error);
+  EXPECT_THROW(g.get_value(d), Error);
+  // Calculated nodes are reused.
+  const Tensor *pb = &g.get_value(b);
+  EXPECT_TRUE(vector_match(vector<float> {6, 12}, g.forward(d).to_vector()));
+  EXPECT_EQ(pb, &g.get_value(b));
+  EXPECT_TRUE(vector_match(vector<float> {3, 4}, g.get_value(c).to_vector()));
+}
+
+TEST_F(GraphTest, CheckClear) {
+  Graph g;
+  for (unsigned i = 0; i < 3; ++i) {
+    const Node x = node_ops::input(Shape({2}), {1.f * i, 2.f * i}, &dev, &g);
+    const Node y = 2 * x;
+    EXPECT_EQ(2u, g.num_functions());
+    EXPECT_TRUE(vector_match(
+          vector<float> {2.f * i, 4.f * i}, g.forward(y).to_vector()));
+    g.clear();
+    EXPECT_EQ(0u, g.num_functions());
+  }
+}
+
+namespace {
+
+// Identity function which counts its destructions.
+class CountedIdentity : public Function {
+public:
+  explicit CountedIdentity(unsigned &num_deleted) : num_deleted_(num_deleted) {}
+  ~CountedIdentity() override { ++num_deleted_; }
+  Shape forward_shape(const vector<const Shape *> &args) const override {
+    if (args.size() != 1) THROW_ERROR("Invalid number of arguments.");
+    return *args[0];
+  }
+  Tensor forward(const vector<const Tensor *> &args) override {
+    return *args[0];
+  }
+  void backward(
+      const Tensor &, const Tensor &, const vector<const Tensor *> &,
+      const vector<Tensor *> &) const override {}
+  std::string name() const override { return "CountedIdentity"; }
+private:
+  unsigned &num_deleted_;
+};
+
+}  // namespace
+
+TEST_F(GraphTest, CheckFunctionOwnership) {
+  unsigned num_deleted = 0;
+  {
+    Graph g;
+    for (unsigned i = 0; i < 3; ++i) {
+      const Node x = node_ops::input(Shape({2}), {1.f * i, 2.f}, &dev, &g);
+      const Node y = g.emplace_function<CountedIdentity>({x}, num_deleted);
+      const Node z = g.add_function(new CountedIdentity(num_deleted), {y});
+      EXPECT_EQ(3u, g.num_functions());
+      EXPECT_TRUE(vector_match(
+            vector<float> {1.f * i, 2.f}, g.forward(z).to_vector()));
+
+      // Functions are destroyed even if they could not be added.
+      EXPECT_THROW(
+          g.emplace_function<CountedIdentity>({x, y}, num_deleted), Error);
+      EXPECT_THROW(
+          g.add_function(new CountedIdentity(num_deleted), {}), Error);
+      EXPECT_EQ(3u, g.num_functions());
+      EXPECT_EQ(4 * i + 2, num_deleted);
+
+      g.clear();
+      EXPECT_EQ(4 * i + 4, num_deleted);
+    }
+    const Node x = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+    g.emplace_function<CountedIdentity>({x}, num_deleted);
+  }
+  EXPECT_EQ(13u, num_deleted);
+}
+
+TEST_F(GraphTest, CheckTruncate) {
+  for (const auto policy : {
+      Graph::RELEASE_POLICY_NONE, Graph::RELEASE_POLICY_INFERENCE}) {
+    Graph g(policy);
+    const Node x = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+    const Node e = 2 * x;
+    const unsigned num_prefix = g.num_functions();
+    EXPECT_THROW(g.truncate(num_prefix + 1), Error);
+
+    // Each step carries the state by a tensor, and the graph keeps the same
+    // memory after the first step.
+    Tensor h = dev.new_tensor_by_vector(Shape({2}), {0, 0});
+    std::size_t step_bytes = 0;
+    for (unsigned i = 0; i < 10; ++i) {
+      const Node y = node_ops::input(h, &g) + e;
+      h = g.forward(y);
+      EXPECT_TRUE(vector_match(
+            vector<float> {2.f * i + 2, 4.f * i + 4}, h.to_vector()));
+      g.truncate(num_prefix);
+      EXPECT_EQ(num_prefix, g.num_functions());
+      if (i == 1) step_bytes = g.internal_bytes_in_use();
+      if (i >= 1) {
+        EXPECT_EQ(step_bytes, g.internal_bytes_in_use());
+      }
+    }
+    EXPECT_TRUE(vector_match(vector<float> {2, 4}, g.forward(e).to_vector()));
+    g.truncate(0);
+    EXPECT_EQ(0u, g.num_functions());
+    EXPECT_EQ(0u, g.internal_bytes_in_use());
+  }
+}
+
+TEST_F(GraphTest, CheckTruncateFunctions) {
+  unsigned num_deleted = 0;
+  Graph g;
+  const Node x = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node y = g.emplace_function<CountedIdentity>({x}, num_deleted);
+  for (unsigned i = 0; i < 3; ++i) {
+    g.emplace_function<CountedIdentity>({y}, num_deleted);
+    g.add_function(new CountedIdentity(num_deleted), {y});
+    EXPECT_EQ(4u, g.num_functions());
+    g.truncate(2);
+    EXPECT_EQ(2 * i + 2, num_deleted);
+  }
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, g.forward(y).to_vector()));
+  g.truncate(2);
+  EXPECT_EQ(6u, num_deleted);
+}
+
+TEST_F(GraphTest, CheckTruncateFusion) {
+  Graph g;
+  g.set_elementwise_fusion(true);
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = node_ops::input(Shape({2}), {3, 4}, &dev, &g);
+  const Node c = (a + b) * 2;
+  const Node d = node_ops::exp(a) * 2;
+  const unsigned num_prefix = g.num_functions();
+  for (unsigned i = 0; i < 3; ++i) {
+    // `c` is absorbed by the removed function, and `d` is fused after adding
+    // the removed function.
+    const Node e = c - a;
+    const Node f = d + e;
+    EXPECT_TRUE(vector_match(vector<float> {7, 10}, g.forward(e).to_vector()));
+    if (i == 0) {
+      EXPECT_THROW(g.get_value(c), Error);
+      EXPECT_TRUE(vector_near(
+            vector<float> {2 * std::exp(1.f), 2 * std::exp(2.f)},
+            g.forward(d).to_vector(), 1e-5));
+    }
+    EXPECT_TRUE(vector_near(
+          vector<float> {2 * std::exp(1.f) + 7, 2 * std::exp(2.f) + 10},
+          g.forward(f).to_vector(), 1e-5));
+    g.truncate(num_prefix);
+  }
+  EXPECT_TRUE(vector_match(vector<float> {8, 12}, g.forward(c).to_vector()));
+  const Node e = c + d;
+  EXPECT_TRUE(vector_near(
+        vector<float> {2 * std::exp(1.f) + 8, 2 * std::exp(2.f) + 12},
+        g.forward(e).to_vector(), 1e-5));
+}
+
+TEST_F(GraphTest, CheckLazyGradient) {
+  Graph g;
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = a + 1;
+  const Node c = 2 * a;
+  const Node d = c * c;
+  g.forward(b);
+  g.forward(d);
+  for (const Node *n : {&a, &b, &c, &d}) {
+    EXPECT_THROW(g.get_gradient(*n), Error);
+  }
+  g.backward(d);
+  // `b` is out of the backward path.
+  EXPECT_THROW(g.get_gradient(b), Error);
+  EXPECT_TRUE(vector_match(vector<float> {1, 1}, g.get_gradient(d).to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {4, 8}, g.get_gradient(c).to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {8, 16}, g.get_gradient(a).to_vector()));
+}
+
+TEST_F(GraphTest, CheckReleasePolicy) {
+  EXPECT_EQ(Graph::RELEASE_POLICY_NONE, Graph().release_policy());
+  EXPECT_EQ(
+      Graph::RELEASE_POLICY_INFERENCE,
+      Graph(Graph::RELEASE_POLICY_INFERENCE).release_policy());
+  EXPECT_EQ(
+      Graph::RELEASE_POLICY_TRAINING,
+      Graph(Graph::RELEASE_POLICY_TRAINING).release_policy());
+}
+
+TEST_F(GraphTest, CheckReleaseInference) {
+  Graph g(Graph::RELEASE_POLICY_INFERENCE);
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = a + a;
+  const Node c = b * b;
+  const Node d = c + b;
+  const Node e = 2 * d;
+  EXPECT_TRUE(vector_match(vector<float> {12, 40}, g.forward(e).to_vector()));
+  // Intermediate values are released after all their sinks are calculated.
+  EXPECT_THROW(g.get_value(a), Error);
+  EXPECT_THROW(g.get_value(b), Error);
+  EXPECT_THROW(g.get_value(c), Error);
+  EXPECT_THROW(g.get_value(d), Error);
+  EXPECT_NO_THROW(g.get_value(e));
+  EXPECT_THROW(g.backward(e), Error);
+  // Released nodes are calculated again.
+  EXPECT_TRUE(vector_match(vector<float> {6, 20}, g.forward(d).to_vector()));
+}
+
+TEST_F(GraphTest, CheckReleaseInferenceWithUncalculatedSinks) {
+  Graph g(Graph::RELEASE_POLICY_INFERENCE);
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = a + 1;
+  const Node c = a + 2;
+  g.forward(b);
+  // `c` still requires `a`.
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, g.get_value(a).to_vector()));
+  g.forward(c);
+  EXPECT_THROW(g.get_value(a), Error);
+  EXPECT_TRUE(vector_match(vector<float> {2, 3}, g.get_value(b).to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {3, 4}, g.get_value(c).to_vector()));
+}
+
+TEST_F(GraphTest, CheckReleaseTraining) {
+  for (const auto policy : {
+      Graph::RELEASE_POLICY_NONE, Graph::RELEASE_POLICY_TRAINING}) {
+    Parameter p("p", {2}, {1, 2}, &dev);
+    p.reset_gradient();
+    Graph g(policy);
+    const Node x = node_ops::input(&p, &g);
+    const Node y = x * x;
+    const Node z = node_ops::sum(y * x, 0);
+    EXPECT_TRUE(vector_match(vector<float> {9}, g.forward(z).to_vector()));
+    g.backward(z);
+    // dz/dp = 3p^2
+    EXPECT_TRUE(vector_match(vector<float> {3, 12}, p.gradient().to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {9}, g.get_value(z).to_vector()));
+    if (policy == Graph::RELEASE_POLICY_TRAINING) {
+      EXPECT_THROW(g.get_value(x), Error);
+      EXPECT_THROW(g.get_value(y), Error);
+      EXPECT_THROW(g.get_gradient(x), Error);
+      EXPECT_THROW(g.get_gradient(z), Error);
+      EXPECT_THROW(g.backward(z), Error);
+    } else {
+      EXPECT_NO_THROW(g.get_value(y));
+      EXPECT_NO_THROW(g.get_gradient(x));
+    }
+  }
+}
+
+TEST_F(GraphTest, CheckBackwardPruning) {
+  Parameter p("p", {2}, {1, 2}, &dev);
+  p.reset_gradient();
+  Graph g;
+  EXPECT_FALSE(g.backward_pruning());
+  g.set_backward_pruning(true);
+  EXPECT_TRUE(g.backward_pruning());
+  const Node x = node_ops::input(Shape({2}), {3, 4}, &dev, &g);
+  const Node h = 2 * x + 1;
+  const Node w = node_ops::input(&p, &g);
+  const Node y = w * h;
+  const Node z = node_ops::sum(y, 0);
+  g.forward(z);
+  g.backward(z);
+  // dz/dp = h
+  EXPECT_TRUE(vector_match(vector<float> {7, 9}, p.gradient().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {1, 1}, g.get_gradient(y).to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {7, 9}, g.get_gradient(w).to_vector()));
+  // Nodes without parameters in their ancestors are pruned.
+  EXPECT_THROW(g.get_gradient(h), Error);
+  EXPECT_THROW(g.get_gradient(x), Error);
+}
+
+TEST_F(GraphTest, CheckRequireGradient) {
+  Graph g;
+  g.set_backward_pruning(true);
+  const Node x = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node y = node_ops::input(Shape({2}), {3, 4}, &dev, &g);
+  const Node z = 3 * x * y;
+  g.require_gradient(x);
+  g.forward(z);
+  g.backward(z);
+  EXPECT_TRUE(vector_match(vector<float> {9, 12}, g.get_gradient(x).to_vector()));
+  EXPECT_THROW(g.get_gradient(y), Error);
+}
+
+TEST_F(GraphTest, CheckElementwiseFusion) {
+  Parameter pw("w", {2, 2}, {1, -2, .5, 3}, &dev);
+  Parameter pb("b", {2}, {.25, -.5}, &dev);
+  const vector<float> x_data {1, 2, -1, .5};
+
+  vector<vector<float>> results;
+  for (const bool fusion : {false, true}) {
+    pw.reset_gradient();
+    pb.reset_gradient();
+    Graph g;
+    EXPECT_FALSE(g.elementwise_fusion());
+    g.set_elementwise_fusion(fusion);
+    EXPECT_EQ(fusion, g.elementwise_fusion());
+    const Node x = node_ops::input(Shape({2}, 2), x_data, &dev, &g);
+    const Node w = node_ops::input(&pw, &g);
+    const Node b = node_ops::input(&pb, &g);
+    const Node h = node_ops::matmul(w, x);
+    const Node u = h + node_ops::broadcast(b, 1, 1);
+    const Node a = node_ops::tanh(u * 2 - 1);
+    // `a` is used twice and is not merged into its sinks.
+    const Node y = node_ops::sigmoid(a) * a + node_ops::exp(-a);
+    const Node z = node_ops::batch::sum(node_ops::sum(y, 0));
+    vector<float> result = g.forward(z).to_vector();
+    if (fusion) {
+      EXPECT_THROW(g.get_value(u), Error);
+      EXPECT_NO_THROW(g.get_value(a));
+      EXPECT_NO_THROW(g.get_value(h));
+    }
+    g.backward(z);
+    for (const Parameter *p : {&pw, &pb}) {
+      const vector<float> grad = p->gradient().to_vector();
+      result.insert(result.end(), grad.begin(), grad.end());
+    }
+    result.push_back(g.get_gradient(x).to_vector()[0]);
+    results.emplace_back(move(result));
+  }
+  EXPECT_TRUE(vector_near(results[0], results[1], 1e-5));
+}
+
+TEST_F(GraphTest, CheckElementwiseFusionInference) {
+  Graph g(Graph::RELEASE_POLICY_INFERENCE);
+  g.set_elementwise_fusion(true);
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = node_ops::input(Shape({2}), {3, 4}, &dev, &g);
+  const Node c = (a + b) * 2;
+  const Node d = c - a;
+  EXPECT_TRUE(vector_match(vector<float> {7, 10}, g.forward(d).to_vector()));
+  EXPECT_THROW(g.get_value(a), Error);
+  EXPECT_THROW(g.get_value(b), Error);
+  EXPECT_THROW(g.get_value(c), Error);
+  // Merged nodes can be calculated explicitly.
+  EXPECT_TRUE(vector_match(vector<float> {8, 12}, g.forward(c).to_vector()));
+}
+
+TEST_F(GraphTest, CheckMemoryPlan) {
+  for (const bool inference : {false, true}) {
+    Graph g(inference ?
+        Graph::RELEASE_POLICY_INFERENCE : Graph::RELEASE_POLICY_NONE);
+    const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+    const Node b = a + 1;
+    const Node c = b * 2;
+    const Node d = c - 1;
+    const Graph::MemoryPlan plan = g.plan_memory(d);
+    // Values are released only with the inference policy.
+    const vector<std::uint64_t> expected_offsets = inference ?
+      vector<std::uint64_t> {0, 256, 0, 256} :
+      vector<std::uint64_t> {0, 256, 512, 768};
+    ASSERT_EQ(1u, plan.devices.size());
+    EXPECT_EQ(&dev, plan.devices[0]);
+    EXPECT_EQ(inference ? 512u : 1024u, plan.workspace_sizes[0]);
+    ASSERT_EQ(4u, plan.blocks.size());
+    for (unsigned i = 0; i < 4; ++i) {
+      EXPECT_EQ((vector<Node> {a, b, c, d})[i].function_id(),
+          plan.blocks[i].node.function_id());
+      EXPECT_EQ(0u, plan.blocks[i].device_index);
+      EXPECT_EQ(expected_offsets[i], plan.blocks[i].offset);
+      EXPECT_EQ(Graph::PLAN_ALIGNMENT, plan.blocks[i].size);
+    }
+    // Planning does not calculate anything.
+    EXPECT_THROW(g.get_value(a), Error);
+    g.forward(b);
+    EXPECT_EQ(2u, g.plan_memory(d).blocks.size());
+    EXPECT_EQ(0u, g.plan_memory(b).blocks.size());
+  }
+}
+
+TEST_F(GraphTest, CheckMemoryPlanningForward) {
+  Graph g(Graph::RELEASE_POLICY_INFERENCE);
+  EXPECT_FALSE(g.memory_planning());
+  g.set_memory_planning(true);
+  EXPECT_TRUE(g.memory_planning());
+  for (unsigned i = 0; i < 3; ++i) {
+    const Node a = node_ops::input(Shape({2, 2}), {1, 2, 3, 4}, &dev, &g);
+    const Node b = a + 1;
+    // c shares the memory of b.
+    const Node c = node_ops::reshape(b, Shape({4}));
+    const Node d = c * 2;
+    const Node e = d + c;
+    const Node f = node_ops::sum(e, 0) - 1;
+    EXPECT_TRUE(vector_match(
+          vector<float> {6, 9, 12, 15}, g.forward(e).to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {41}, g.forward(f).to_vector()));
+    g.clear();
+  }
+}
+
+namespace {
+
+// Batchable function which calculates 2 * x and counts its calculations.
+class CountedDouble : public Function {
+public:
+  explicit CountedDouble(unsigned &num_calls) : num_calls_(num_calls) {}
+  Shape forward_shape(const vector<const Shape *> &args) const override {
+    if (args.size() != 1) THROW_ERROR("Invalid number of arguments.");
+    return *args[0];
+  }
+  bool batchable() const override { return true; }
+  Tensor forward(const vector<const Tensor *> &args) override {
+    ++num_calls_;
+    return 2.f * *args[0];
+  }
+  void backward(
+      const Tensor &, const Tensor &gy, const vector<const Tensor *> &,
+      const vector<Tensor *> &gx) const override {
+    if (!gx[0]) return;
+    if (gx[0]->valid()) *gx[0] += 2.f * gy;
+    else *gx[0] = 2.f * gy;
+  }
+  std::string name() const override { return "CountedDouble"; }
+private:
+  unsigned &num_calls_;
+};
+
+}  // namespace
+
+TEST_F(GraphTest, CheckAutoBatching) {
+  unsigned num_calls = 0;
+  Graph g;
+  EXPECT_FALSE(g.auto_batching());
+  g.set_auto_batching(true);
+  EXPECT_TRUE(g.auto_batching());
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = node_ops::input(Shape({2}, 2), {3, 4, 5, 6}, &dev, &g);
+  const Node c = node_ops::input(Shape({2}), {7, 8}, &dev, &g);
+  const Node d = node_ops::input(Shape({3}), {1, 2, 3}, &dev, &g);
+  const Node ya = g.emplace_function<CountedDouble>({a}, num_calls);
+  const Node yb = g.emplace_function<CountedDouble>({b}, num_calls);
+  const Node yc = g.emplace_function<CountedDouble>({c}, num_calls);
+  const Node yd = g.emplace_function<CountedDouble>({d}, num_calls);
+  const Node z = node_ops::concat({ya, yc, node_ops::sum(yb, 0)}, 0);
+  const Node w = node_ops::sum(yd, 0);
+  const Node u = node_ops::concat({z, w}, 0);
+  EXPECT_TRUE(vector_match(
+        vector<float> {2, 4, 14, 16, 14, 12, 2, 4, 14, 16, 22, 12},
+        g.forward(u).to_vector()));
+  // a and c are merged, and b and d have different shapes.
+  EXPECT_EQ(3u, num_calls);
+  EXPECT_TRUE(vector_match(vector<float> {2, 4}, g.forward(ya).to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float> {6, 8, 10, 12}, g.forward(yb).to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {14, 16}, g.forward(yc).to_vector()));
+
+  // Gradients are calculated separately.
+  const Node loss = node_ops::batch::sum(node_ops::sum(u, 0));
+  g.forward(loss);
+  g.backward(loss);
+  EXPECT_TRUE(vector_match(
+        vector<float> {4, 4}, g.get_gradient(a).to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float> {4, 4}, g.get_gradient(c).to_vector()));
+}
+
+TEST_F(GraphTest, CheckAutoBatchingMatchesSerialCalculation) {
+  // Two independent recurrences of different lengths with shared parameters.
+  vector<vector<float>> results;
+  for (const bool batching : {false, true}) {
+    Graph g(Graph::RELEASE_POLICY_INFERENCE);
+    g.set_auto_batching(batching);
+    const Node w = node_ops::input(Shape({2, 2}), {.1, -.2, .3, .4}, &dev, &g);
+    const Node bias = node_ops::input(Shape({2}), {.5, -.5}, &dev, &g);
+    vector<Node> outputs;
+    for (const unsigned len : {3, 5}) {
+      Node h = node_ops::input(Shape({2}), {1.f * len, 1}, &dev, &g);
+      for (unsigned t = 0; t < len; ++t) {
+        h = node_ops::tanh(node_ops::matmul(w, h) + bias) * 1.5f + .25f;
+      }
+      outputs.emplace_back(h);
+    }
+    // Constants which are different but have the same name are not merged.
+    outputs.emplace_back(outputs[0] + 1.f);
+    outputs.emplace_back(outputs[1] + 1.0000001f);
+    results.emplace_back(g.forward(node_ops::concat(outputs, 0)).to_vector());
+  }
+  EXPECT_TRUE(vector_match(results[0], results[1]));
+}
+
+namespace {
+
+// Identity function which waits until the given number of calls are running.
+class Rendezvous : public Function {
+public:
+  Rendezvous(
+      std::atomic<unsigned> &num_arrived, unsigned num_expected,
+      unsigned timeout_ms)
+    : num_arrived_(num_arrived)
+    , num_expected_(num_expected)
+    , timeout_ms_(timeout_ms) {}
+  Shape forward_shape(const vector<const Shape *> &args) const override {
+    if (args.size() != 1) THROW_ERROR("Invalid number of arguments.");
+    return *args[0];
+  }
+  Tensor forward(const vector<const Tensor *> &args) override {
+    ++num_arrived_;
+    const auto deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(timeout_ms_);
+    while (num_arrived_ < num_expected_) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        THROW_ERROR("Timed out.");
+      }
+      std::this_thread::yield();
+    }
+    return *args[0];
+  }
+  void backward(
+      const Tensor &, const Tensor &, const vector<const Tensor *> &,
+      const vector<Tensor *> &) const override {}
+  std::string name() const override { return "Rendezvous"; }
+private:
+  std::atomic<unsigned> &num_arrived_;
+  unsigned num_expected_;
+  unsigned timeout_ms_;
+};
+
+}  // namespace
+
+TEST_F(GraphTest, CheckParallelExecution) {
+  for (const auto policy : {
+      Graph::RELEASE_POLICY_NONE, Graph::RELEASE_POLICY_INFERENCE}) {
+    std::atomic<unsigned> num_arrived(0);
+    Graph g(policy);
+    EXPECT_FALSE(g.parallel_execution());
+    g.set_parallel_execution(true);
+    EXPECT_TRUE(g.parallel_execution());
+    const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+    const Node b = node_ops::input(Shape({2}), {3, 4}, &dev2, &g);
+    // Both functions never finish unless they run concurrently.
+    const Node c = g.emplace_function<Rendezvous>(
+        {2 * a}, num_arrived, 2, 10000);
+    const Node d = g.emplace_function<Rendezvous>(
+        {b + 1}, num_arrived, 2, 10000);
+    const Node e = c + node_ops::copy(d, &dev);
+    EXPECT_TRUE(vector_match(vector<float> {6, 9}, g.forward(e).to_vector()));
+    EXPECT_EQ(2u, num_arrived);
+  }
+}
+
+TEST_F(GraphTest, CheckParallelExecutionWithError) {
+  std::atomic<unsigned> num_arrived(0);
+  Graph g;
+  g.set_parallel_execution(true);
+  const Node a = node_ops::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node b = node_ops::input(Shape({2}), {3, 4}, &dev2, &g);
+  // The function on dev2 waits for the call which never runs.
+  const Node c = g.emplace_function<Rendezvous>({-a}, num_arrived, 1, 0);
+  const Node d = g.emplace_function<Rendezvous>({b}, num_arrived, 3, 0);
+  EXPECT_THROW(g.forward(c + node_ops::copy(d, &dev)), Error);
+  EXPECT_THROW(g.get_value(d), Error);
+  EXPECT_TRUE(vector_match(vector<float> {-1, -2}, g.forward(c).to_vector()));
+}
+
+TEST_F(GraphTest, CheckLSTMCell) {
+  // The fused cell should behave the same as the cell written with slices.
+  const unsigned n = 2;
+  vector<float> u_data(4 * n * 3 * 2), c_data(n * 3), k_data(2 * n * 3 * 2);
+  for (unsigned i = 0; i < u_data.size(); ++i) u_data[i] = i % 7 * .5 - 1.5;
+  for (unsigned i = 0; i < c_data.size(); ++i) c_data[i] = i % 3 * .5 - .5;
+  for (unsigned i = 0; i < k_data.size(); ++i) k_data[i] = i % 5 * .25 - .5;
+  Parameter pc("c", {n, 3}, c_data, &dev);
+
+  vector<vector<float>> results;
+  for (const bool fused : {false, true}) {
+    pc.reset_gradient();
+    Graph g;
+    const Node u = node_ops::input(Shape({4 * n, 3}, 2), u_data, &dev, &g);
+    const Node c = node_ops::input(&pc, &g);
+    const Node k = node_ops::input(Shape({2 * n, 3}, 2), k_data, &dev, &g);
+    Node hc;
+    if (fused) {
+      hc = node_ops::lstm_cell(u, c);
+    } else {
+      const Node i = node_ops::sigmoid(node_ops::slice(u, 0, 0, n));
+      const Node f = node_ops::sigmoid(node_ops::slice(u, 0, n, 2 * n));
+      const Node o = node_ops::sigmoid(node_ops::slice(u, 0, 2 * n, 3 * n));
+      const Node j = node_ops::tanh(node_ops::slice(u, 0, 3 * n, 4 * n));
+      const Node cc = i * j + f * c;
+      hc = node_ops::concat({o * node_ops::tanh(cc), cc}, 0);
+    }
+    EXPECT_EQ(Shape({2 * n, 3}, 2), hc.shape());
+    const Node z = node_ops::batch::sum(
+        node_ops::sum(node_ops::sum(hc * k, 0), 1));
+    vector<float> result = g.forward(hc).to_vector();
+    g.forward(z);
+    g.backward(z);
+    const vector<float> gu = g.get_gradient(u).to_vector();
+    const vector<float> gc = pc.gradient().to_vector();
+    result.insert(result.end(), gu.begin(), gu.end());
+    result.insert(result.end(), gc.begin(), gc.end());
+    results.emplace_back(move(result));
+  }
+  EXPECT_TRUE(vector_near(results[0], results[1], 1e-6));
+}
+
+TEST_F(GraphTest, CheckMultiStepLSTM) {
+  // The multi-step LSTM should behave the same as the unrolled LSTM.
+  const unsigned n = 3, steps = 4;
+  vector<float> xu_data(4 * n * steps * 2), wh_data(4 * n * n);
+  vector<float> h0_data(n), c0_data(n * 2), k_data(2 * n * steps * 2);
+  for (unsigned i = 0; i < xu_data.size(); ++i) xu_data[i] = i % 7 * .5 - 1.5;
+  for (unsigned i = 0; i < wh_data.size(); ++i) wh_data[i] = i % 5 * .2 - .4;
+  for (unsigned i = 0; i < h0_data.size(); ++i) h0_data[i] = i % 3 * .5 - .5;
+  for (unsigned i = 0; i < c0_data.size(); ++i) c0_data[i] = i % 4 * .5 - .7;
+  for (unsigned i = 0; i < k_data.size(); ++i) k_data[i] = i % 5 * .25 - .5;
+  Parameter pwh("wh", {4 * n, n}, wh_data, &dev);
+  Parameter ph0("h0", {n}, h0_data, &dev);
+
+  vector<vector<float>> results;
+  for (const bool fused : {false, true}) {
+    pwh.reset_gradient();
+    ph0.reset_gradient();
+    Graph g;
+    const Node xu = node_ops::input(
+        Shape({4 * n, steps}, 2), xu_data, &dev, &g);
+    const Node wh = node_ops::input(&pwh, &g);
+    const Node h0 = node_ops::input(&ph0, &g);
+    const Node c0 = node_ops::input(Shape({n}, 2), c0_data, &dev, &g);
+    const Node k = node_ops::input(
+        Shape({2 * n, steps}, 2), k_data, &dev, &g);
+    Node y;
+    if (fused) {
+      y = node_ops::lstm(xu, wh, h0, c0);
+    } else {
+      Node h = h0, c = c0;
+      vector<Node> ys;
+      for (unsigned t = 0; t < steps; ++t) {
+        const Node u =
+          node_ops::slice(xu, 1, t, t + 1) + node_ops::matmul(wh, h);
+        ys.emplace_back(node_ops::lstm_cell(u, c));
+        h = node_ops::slice(ys.back(), 0, 0, n);
+        c = node_ops::slice(ys.back(), 0, n, 2 * n);
+      }
+      y = node_ops::concat(ys, 1);
+    }
+    EXPECT_EQ(Shape({2 * n, steps}, 2), y.shape());
+    const Node z = node_ops::batch::sum(
+        node_ops::sum(node_ops::sum(y * k, 0), 1));
+    vector<float> result = g.forward(y).to_vector();
+    g.forward(z);
+    g.backward(z);
+    for (const vector<float> &grad : {
+        g.get_gradient(xu).to_vector(), pwh.gradient().to_vector(),
+        ph0.gradient().to_vector(), g.get_gradient(c0).to_vector()}) {
+      result.insert(result.end(), grad.begin(), grad.end());
+    }
+    results.emplace_back(move(result));
+  }
+  EXPECT_TRUE(vector_near(results[0], results[1], 1e-5));
+}
+
 TEST_F(GraphTest, CheckXor) {
   // Solves a 2-dimension XOR problem with 3-layer perceptron.
   // h = tanh(W1.x + b1)
@@ -392,4 +1075,318 @@ TEST_F(GraphTest, CheckConcatLSTM) {
 #undef PRINT_GRAD
 }
 
+TEST_F(GraphTest, CheckSampledSoftmaxCrossEntropy) {
+  // Output layer with 4 words, 2 hidden units and the batch size 2.
+  const vector<float> w_data {1, -1, 2, 0, 0, 3, -2, 1};
+  const vector<float> b_data {.1, .2, .3, .4};
+  const vector<float> h_data {1, 2, -1, .5};
+  const vector<unsigned> ids {2, 0};
+
+  // Samples covering all words make the same result as the full softmax.
+  Parameter w1("w", {4, 2}, w_data, &dev), b1("b", {4}, b_data, &dev);
+  Parameter w2("w", {4, 2}, w_data, &dev), b2("b", {4}, b_data, &dev);
+  Graph g1, g2;
+  const Node full = node_ops::batch::sum(node_ops::softmax_cross_entropy(
+        node_ops::matmul(
+          node_ops::input(&w1, &g1),
+          node_ops::input(Shape({2}, 2), h_data, &dev, &g1))
+        + node_ops::input(&b1, &g1), 0, ids));
+  const Node sampled = node_ops::batch::sum(
+      node_ops::sampled_softmax_cross_entropy(
+        node_ops::input(&w2, &g2), node_ops::input(&b2, &g2),
+        node_ops::input(Shape({2}, 2), h_data, &dev, &g2),
+        ids, {3, 1, 1, 0}));
+  for (Parameter *p : {&w1, &b1, &w2, &b2}) p->reset_gradient();
+  g1.forward(full);
+  g2.forward(sampled);
+  g1.backward(full);
+  g2.backward(sampled);
+  EXPECT_TRUE(vector_near(
+        g1.forward(full).to_vector(), g2.forward(sampled).to_vector(), 1e-5));
+  EXPECT_TRUE(vector_near(
+        w1.gradient().to_vector(), w2.gradient().to_vector(), 1e-5));
+  EXPECT_TRUE(vector_near(
+        b1.gradient().to_vector(), b2.gradient().to_vector(), 1e-5));
+
+  // Only targets and samples are used for the normalization.
+  Parameter w3("w", {4, 2}, w_data, &dev), b3("b", {4}, b_data, &dev);
+  w3.reset_gradient();
+  b3.reset_gradient();
+  Graph g;
+  const Node h = node_ops::input(Shape({2}, 2), h_data, &dev, &g);
+  const Node partial = node_ops::sampled_softmax_cross_entropy(
+      node_ops::input(&w3, &g), node_ops::input(&b3, &g), h, ids, {3});
+  const Node expected = node_ops::softmax_cross_entropy(
+      node_ops::input(
+        Shape({3}, 2), {1.1, -1.7, 2.4, -.9, -2.7, .9}, &dev, &g),
+      0, {1, 0});
+  const Node partial_sum = node_ops::batch::sum(partial);
+  g.forward(partial_sum);
+  g.backward(partial_sum);
+  EXPECT_TRUE(vector_near(
+        g.forward(expected).to_vector(), g.forward(partial).to_vector(), 1e-5));
+  const vector<float> gw = w3.gradient().to_vector();
+  EXPECT_FLOAT_EQ(0, gw[1]);
+  EXPECT_FLOAT_EQ(0, gw[5]);
+}
+
+TEST_F(GraphTest, CheckUpdateParameterWithoutCopy) {
+  Parameter w("w", {2, 2}, {1, 2, 3, 4}, &dev);
+  trainers::SGD trainer(.5);
+  trainer.add_parameter(&w);
+  trainer.reset_gradients();
+
+  Graph g(Graph::RELEASE_POLICY_TRAINING);
+  const Node x = node_ops::input({2}, {1, 1}, &dev, &g);
+  const Node y = node_ops::matmul(node_ops::input(&w, &g), x);
+  const Node z = node_ops::sum(y, 0);
+  g.forward(z);
+  g.backward(z);
+
+  // The graph released the value by backward(), and the update does not
+  // duplicate it.
+  const std::uint64_t num_cows = Tensor::num_copy_on_writes();
+  trainer.update(1);
+  EXPECT_EQ(num_cows, Tensor::num_copy_on_writes());
+  EXPECT_TRUE(vector_match(
+        vector<float> {.5, 1.5, 2.5, 3.5}, w.value().to_vector()));
+}
+
+TEST_F(GraphTest, CheckUpdateParameterAfterClear) {
+  Parameter w("w", {2, 2}, {1, 2, 3, 4}, &dev);
+  trainers::SGD trainer(.5);
+  trainer.add_parameter(&w);
+
+  Graph g;
+  for (unsigned i = 0; i < 2; ++i) {
+    trainer.reset_gradients();
+    const Node x = node_ops::input({2}, {1, 1}, &dev, &g);
+    const Node y = node_ops::matmul(node_ops::input(&w, &g), x);
+    const Node z = node_ops::sum(y, 0);
+    g.forward(z);
+    g.backward(z);
+
+    // The graph keeps a copy of the value, which is duplicated by the update.
+    // Clearing the graph releases it.
+    const std::uint64_t num_cows = Tensor::num_copy_on_writes();
+    if (i == 1) g.clear();
+    trainer.update(1);
+    EXPECT_EQ(num_cows + (i == 0), Tensor::num_copy_on_writes());
+    g.clear();
+  }
+  EXPECT_TRUE(vector_match(
+        vector<float> {0, 1, 2, 3}, w.value().to_vector()));
+}
+
+TEST_F(GraphTest, CheckUpdateParameterKeepsCopies) {
+  for (const bool pack : {false, true}) {
+    Parameter w("w", {2}, {1, 2}, &dev);
+    trainers::SGD trainer(.5);
+    trainer.add_parameter(&w);
+    if (pack) trainer.pack_parameters(true);
+    trainer.reset_gradients();
+
+    Graph g;
+    const Node pw = node_ops::input(&w, &g);
+    const Node z = node_ops::sum(pw * pw, 0);
+    g.forward(z);
+    const Tensor snapshot = w.value();
+    const Tensor reshaped = w.value().reshape({1, 2});
+    g.backward(z);
+    trainer.update(1);
+
+    // Copies of the value and values in the graph are not updated.
+    EXPECT_TRUE(vector_match(vector<float> {0, 0}, w.value().to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {1, 2}, snapshot.to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {1, 2}, reshaped.to_vector()));
+    EXPECT_TRUE(vector_match(
+          vector<float> {1, 2}, g.get_value(pw).to_vector()));
+    EXPECT_FLOAT_EQ(5, g.get_value(z).to_vector()[0]);
+  }
+}
+
+TEST_F(GraphTest, CheckGradientCheckpointing) {
+  vector<vector<float>> grads;
+  for (const bool checkpointing : {false, true}) {
+    Parameter w("w", {2, 2}, {.5, -.25, .75, .5}, &dev);
+    w.reset_gradient();
+    Graph g(Graph::RELEASE_POLICY_TRAINING);
+    EXPECT_FALSE(g.gradient_checkpointing());
+    g.set_gradient_checkpointing(checkpointing);
+    EXPECT_EQ(checkpointing, g.gradient_checkpointing());
+    const Node pw = node_ops::input(&w, &g);
+    const Node x = node_ops::input({2}, {1, -1}, &dev, &g);
+    vector<Node> hs {x};
+    for (unsigned t = 0; t < 20; ++t) {
+      hs.emplace_back(node_ops::tanh(node_ops::matmul(pw, hs.back())) + .5f);
+      if (t % 5 == 4) g.mark_checkpoint(hs.back());
+    }
+    const Node loss = node_ops::sum(hs.back(), 0);
+    g.forward(loss);
+    // Only inputs, checkpoints and the last node have values.
+    EXPECT_NO_THROW(g.get_value(pw));
+    EXPECT_NO_THROW(g.get_value(x));
+    for (unsigned t = 1; t < hs.size(); ++t) {
+      if (checkpointing && t % 5 != 0) {
+        EXPECT_THROW(g.get_value(hs[t]), Error);
+      } else {
+        EXPECT_NO_THROW(g.get_value(hs[t]));
+      }
+    }
+    g.backward(loss);
+    grads.emplace_back(w.gradient().to_vector());
+  }
+  EXPECT_TRUE(vector_match(grads[0], grads[1]));
+}
+
+TEST_F(GraphTest, CheckGradientCheckpointingRecalculatesValues) {
+  Graph g;
+  g.set_gradient_checkpointing(true);
+  const Node a = node_ops::input({2}, {1, 2}, &dev, &g);
+  const Node b = a * 3;
+  const Node c = b + 1;
+  g.require_gradient(a);
+  g.forward(c);
+  EXPECT_THROW(g.get_value(b), Error);
+  g.backward(c);
+  EXPECT_TRUE(vector_match(vector<float> {3, 6}, g.get_value(b).to_vector()));
+  EXPECT_TRUE(vector_match(
+        vector<float> {3, 3}, g.get_gradient(a).to_vector()));
+}
+
+TEST_F(GraphTest, CheckConcatPlacement) {
+  vector<vector<float>> results;
+  for (const bool enabled : {false, true}) {
+    Graph g;
+    EXPECT_FALSE(g.concat_placement());
+    g.set_concat_placement(enabled);
+    EXPECT_EQ(enabled, g.concat_placement());
+    const Node x = node_ops::input({2}, {1, -2}, &dev, &g);
+    const Node a = node_ops::tanh(x);
+    const Node b = x * 3;
+    const Node y1 = node_ops::concat({a, b}, 1);
+    // `c` is used twice and can not be placed.
+    const Node c = node_ops::exp(x);
+    const Node y2 = node_ops::concat({x * 6, c}, 1);
+    const Node z = node_ops::sum(y1, 1) + node_ops::sum(y2, 1) + c;
+    results.emplace_back(g.forward(z).to_vector());
+    const float *pa = static_cast<const float *>(g.get_value(a).data());
+    const float *pb = static_cast<const float *>(g.get_value(b).data());
+    const float *pc = static_cast<const float *>(g.get_value(c).data());
+    EXPECT_EQ(enabled, pa == g.get_value(y1).data());
+    EXPECT_EQ(enabled, pa + 2 == pb);
+    EXPECT_NE(pc, g.get_value(y2).data());
+    const vector<float> y1_val = g.get_value(y1).to_vector();
+    EXPECT_NEAR(std::tanh(1.f), y1_val[0], 1e-6);
+    EXPECT_FLOAT_EQ(-6, y1_val[3]);
+    const vector<float> y2_val = g.get_value(y2).to_vector();
+    EXPECT_FLOAT_EQ(6, y2_val[0]);
+    EXPECT_FLOAT_EQ(std::exp(1.f), y2_val[2]);
+  }
+  EXPECT_TRUE(vector_match(results[0], results[1]));
+}
+
+TEST_F(GraphTest, CheckTensorAndHostInput) {
+  const Tensor x = dev.new_tensor_by_vector({2, 2}, {1, 2, 3, 4});
+  const vector<float> host {5, 6, 7, 8};
+  Graph g;
+  const Node a = node_ops::input(x, &g);
+  const Node b = node_ops::input({2, 2}, host.data(), nullptr, &dev, &g);
+  const Node y = node_ops::sum(node_ops::flatten(a * b), 0);
+  g.require_gradient(a);
+  EXPECT_TRUE(vector_match(vector<float> {70}, g.forward(y).to_vector()));
+  EXPECT_EQ(x.data(), g.get_value(a).data());
+  g.backward(y);
+  EXPECT_TRUE(vector_match(host, g.get_gradient(a).to_vector()));
+  // The caller's tensor is never updated by the graph.
+  EXPECT_TRUE(vector_match(vector<float> {1, 2, 3, 4}, x.to_vector()));
+}
+
+TEST_F(GraphTest, CheckProfiling) {
+  Graph g;
+  EXPECT_FALSE(g.profiling());
+  const Node a = node_ops::input({2}, {1, 2}, &dev, &g);
+  const Node b = node_ops::input({2}, {3, 4}, &dev, &g);
+  const Node c = a * b;
+  const Node d = c * b;
+  g.require_gradient(a);
+  g.forward(d);
+  g.backward(d);
+  EXPECT_TRUE(g.profile_records().empty());
+
+  g.clear();
+  g.set_profiling(true);
+  EXPECT_TRUE(g.profiling());
+  const Node x = node_ops::input({2}, {1, 2}, &dev, &g);
+  const Node y = node_ops::input({2}, {3, 4}, &dev, &g);
+  const Node z = node_ops::sum(x * y * y, 0);
+  g.require_gradient(x);
+  g.forward(z);
+  g.backward(z);
+
+  // Inputs have no backward calls because they have no arguments.
+  const vector<Graph::ProfileRecord> &records = g.profile_records();
+  ASSERT_EQ(8u, records.size());
+  for (unsigned i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(
+        i < 5 ? Graph::PROFILE_PHASE_FORWARD : Graph::PROFILE_PHASE_BACKWARD,
+        records[i].phase);
+    EXPECT_EQ(&dev, records[i].device);
+    EXPECT_LE(0, records[i].duration_us);
+    if (i > 0) {
+      EXPECT_LE(records[i - 1].start_us, records[i].start_us);
+    }
+  }
+  EXPECT_EQ("Input", records[0].name);
+  EXPECT_EQ("Input", records[1].name);
+  EXPECT_EQ(records[2].name, records[3].name);
+  EXPECT_EQ("Sum(0)", records[4].name);
+  EXPECT_EQ("Sum(0)", records[5].name);
+  EXPECT_EQ(records[2].name, records[6].name);
+  EXPECT_EQ(records[2].name, records[7].name);
+  const vector<std::uint64_t> expected_bytes {8, 8, 8, 8, 4, 8, 16, 16};
+  for (unsigned i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(expected_bytes[i], records[i].bytes);
+  }
+
+  const vector<Graph::ProfileSummary> summary = g.profile_summary();
+  ASSERT_EQ(5u, summary.size());
+  unsigned total_count = 0;
+  for (unsigned i = 0; i < summary.size(); ++i) {
+    if (i > 0) {
+      EXPECT_GE(summary[i - 1].total_us, summary[i].total_us);
+    }
+    total_count += summary[i].count;
+    if (summary[i].name == "Input") {
+      EXPECT_EQ(Graph::PROFILE_PHASE_FORWARD, summary[i].phase);
+      EXPECT_EQ(2u, summary[i].count);
+      EXPECT_EQ(16u, summary[i].total_bytes);
+    }
+  }
+  EXPECT_EQ(8u, total_count);
+
+  std::stringstream table;
+  g.dump_profile(table);
+  EXPECT_NE(std::string::npos, table.str().find("Input"));
+  EXPECT_NE(std::string::npos, table.str().find("Sum(0)"));
+  EXPECT_NE(std::string::npos, table.str().find("backward"));
+
+  std::stringstream trace;
+  g.dump_profile_chrome_trace(trace);
+  const std::string json = trace.str();
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+  unsigned num_events = 0;
+  for (std::size_t pos = 0;
+      (pos = json.find("\"ph\":\"X\"", pos)) != std::string::npos; ++pos) {
+    ++num_events;
+  }
+  EXPECT_EQ(8u, num_events);
+
+  // Records are kept across clear().
+  g.clear();
+  EXPECT_EQ(8u, g.profile_records().size());
+  g.clear_profile();
+  EXPECT_TRUE(g.profile_records().empty());
+}
+
 }  // namespace primitiv
@@ -0,0 +1,160 @@
+#include <config.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
+#include <primitiv/graph.h>
+#include <primitiv/inference_plan.h>
+#include <primitiv/node_ops.h>
+#include <primitiv/parameter.h>
+#include <test_utils.h>
+
+using std::string;
+using std::vector;
+using test_utils::vector_match;
+using test_utils::vector_near;
+
+namespace primitiv {
+
+class InferencePlanTest : public testing::Test {
+protected:
+  InferencePlanTest()
+  : pw("w", {2, 3}, {1, -1, .5, 2, -.25, 0}, &dev)
+  , pb("b", {2}, {.5, -.5}, &dev) {}
+
+  // Builds a small network and returns {input, outputs...}.
+  vector<Node> build(Graph &g, const vector<float> &data, unsigned batch) {
+    namespace F = node_ops;
+    const Node x = F::input(Shape({3}, batch), data, &dev, &g);
+    const Node w = F::input(&pw, &g);
+    const Node b = F::input(&pb, &g);
+    const Node h = F::tanh(F::matmul(w, x) + b);
+    const Node y = F::softmax(F::concat({h, 2 * F::slice(h, 0, 0, 1)}, 0), 0);
+    const Node z = F::sum(F::reshape(y, Shape({1, 3}, batch)), 1) + 1;
+    return {x, y, z};
+  }
+
+  CPUDevice dev;
+  Parameter pw;
+  Parameter pb;
+};
+
+TEST_F(InferencePlanTest, CheckRun) {
+  const vector<float> data {1, 2, 3, -1, 0, 1};
+  Graph g;
+  const vector<Node> nodes = build(g, data, 2);
+  InferencePlan plan({nodes[0]}, {nodes[1], nodes[2]}, &dev);
+  EXPECT_EQ(1u, plan.num_inputs());
+  EXPECT_EQ(2u, plan.num_outputs());
+  EXPECT_EQ(Shape({3}, 2), plan.input_shape(0));
+  EXPECT_EQ(&dev, plan.device());
+  EXPECT_EQ(0u, plan.workspace_size({Shape({3}, 2)}));
+
+  const Tensor x = dev.new_tensor_by_vector(Shape({3}, 2), data);
+  for (unsigned i = 0; i < 3; ++i) {
+    const vector<Tensor> ys = plan.run({x});
+    ASSERT_EQ(2u, ys.size());
+    EXPECT_EQ(Shape({3}, 2), ys[0].shape());
+    EXPECT_EQ(Shape({}, 2), ys[1].shape());
+    EXPECT_TRUE(vector_near(
+          g.forward(nodes[1]).to_vector(), ys[0].to_vector(), 1e-6));
+    EXPECT_TRUE(vector_near(
+          g.forward(nodes[2]).to_vector(), ys[1].to_vector(), 1e-6));
+    EXPECT_LT(0u, plan.workspace_size({Shape({3}, 2)}));
+  }
+}
+
+TEST_F(InferencePlanTest, CheckOtherBatchSizes) {
+  Graph g;
+  const vector<Node> nodes = build(g, vector<float>(3), 1);
+  InferencePlan plan({nodes[0]}, {nodes[2]}, &dev);
+  for (unsigned batch : {3u, 1u, 5u, 3u}) {
+    vector<float> data;
+    for (unsigned i = 0; i < 3 * batch; ++i) data.emplace_back(.1 * i - .4);
+    Graph g2;
+    const vector<Node> expected = build(g2, data, batch);
+    const Tensor x = dev.new_tensor_by_vector(Shape({3}, batch), data);
+    const vector<Tensor> ys = plan.run({x});
+    ASSERT_EQ(1u, ys.size());
+    EXPECT_TRUE(vector_near(
+          g2.forward(expected[2]).to_vector(), ys[0].to_vector(), 1e-6));
+  }
+}
+
+TEST_F(InferencePlanTest, CheckSaveLoad) {
+  const vector<float> data {1, 2, 3};
+  const string path = "/tmp/primitiv_InferencePlanTest_CheckSaveLoad.plan";
+  Graph g;
+  const vector<Node> nodes = build(g, data, 1);
+  const vector<float> y = g.forward(nodes[1]).to_vector();
+  const vector<float> z = g.forward(nodes[2]).to_vector();
+  {
+    InferencePlan plan({nodes[0]}, {nodes[2], nodes[1]}, &dev);
+    plan.save(path);
+  }
+  // Parameters updated after tracing do not affect the plan.
+  pw.value().reset(0);
+
+  InferencePlan loaded(path, &dev);
+  EXPECT_EQ(1u, loaded.num_inputs());
+  EXPECT_EQ(2u, loaded.num_outputs());
+  EXPECT_EQ(Shape({3}), loaded.input_shape(0));
+  const vector<Tensor> ys =
+    loaded.run({dev.new_tensor_by_vector({3}, data)});
+  ASSERT_EQ(2u, ys.size());
+  EXPECT_TRUE(vector_near(z, ys[0].to_vector(), 1e-6));
+  EXPECT_TRUE(vector_near(y, ys[1].to_vector(), 1e-6));
+
+  EXPECT_THROW(InferencePlan(path + ".none", &dev), Error);
+}
+
+TEST_F(InferencePlanTest, CheckConcurrentRuns) {
+  Graph g;
+  const vector<Node> nodes = build(g, vector<float>(3), 1);
+  InferencePlan plan({nodes[0]}, {nodes[1]}, &dev);
+  vector<vector<float>> data(8), expected(8), actual(8);
+  for (unsigned i = 0; i < 8; ++i) {
+    data[i] = {.5f * i, -.25f * i, 1};
+    Graph g2;
+    expected[i] = g2.forward(build(g2, data[i], 1)[1]).to_vector();
+  }
+  vector<std::thread> threads;
+  for (unsigned i = 0; i < 8; ++i) {
+    threads.emplace_back([&, i] {
+        for (unsigned j = 0; j < 20; ++j) {
+          const Tensor x = dev.new_tensor_by_vector({3}, data[i]);
+          actual[i] = plan.run({x})[0].to_vector();
+          if (!vector_near(expected[i], actual[i], 1e-6)) return;
+        }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+  for (unsigned i = 0; i < 8; ++i) {
+    EXPECT_TRUE(vector_near(expected[i], actual[i], 1e-6));
+  }
+}
+
+TEST_F(InferencePlanTest, CheckInvalidNodes) {
+  namespace F = node_ops;
+  Graph g, g2;
+  const Node x = F::input(Shape({2}), {1, 2}, &dev, &g);
+  const Node y = F::input(Shape({2}), {1, 2}, &dev, &g2);
+  EXPECT_THROW(InferencePlan({x}, {}, &dev), Error);
+  EXPECT_THROW(InferencePlan({x}, {x + y}, &dev), Error);
+  EXPECT_THROW(InferencePlan({x}, {Node()}, &dev), Error);
+  EXPECT_THROW(InferencePlan({x, x}, {2 * x}, &dev), Error);
+  EXPECT_THROW(
+      InferencePlan({x}, {F::dropout(x, .5, true)}, &dev), Error);
+
+  InferencePlan plan({x}, {2 * x}, &dev);
+  EXPECT_EQ(1u, plan.num_functions());
+  EXPECT_THROW(plan.run({}), Error);
+  EXPECT_THROW(plan.run({Tensor()}), Error);
+  const vector<Tensor> ys = plan.run({dev.new_tensor_by_vector({2}, {3, 4})});
+  EXPECT_TRUE(vector_match(vector<float> {6, 8}, ys[0].to_vector()));
+}
+
+}  // namespace primitiv
@@ -0,0 +1,72 @@
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/cpu_memory_pool.h>
+#include <primitiv/error.h>
+#include <primitiv/numa.h>
+#include <primitiv/tensor_ops.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+
+class NUMATest : public testing::Test {};
+
+TEST_F(NUMATest, CheckParseIDList) {
+  EXPECT_EQ(vector<unsigned> {}, numa::parse_id_list(""));
+  EXPECT_EQ(vector<unsigned> {3}, numa::parse_id_list("3"));
+  EXPECT_EQ(
+      (vector<unsigned> {0, 1, 2, 3, 8, 10, 11}),
+      numa::parse_id_list("0-3,8,10-11\n"));
+  EXPECT_EQ((vector<unsigned> {1, 2}), numa::parse_id_list("2, 1-2"));
+  EXPECT_THROW(numa::parse_id_list("a"), Error);
+  EXPECT_THROW(numa::parse_id_list("1-"), Error);
+  EXPECT_THROW(numa::parse_id_list("3-1"), Error);
+  EXPECT_THROW(numa::parse_id_list("1-2-3"), Error);
+}
+
+TEST_F(NUMATest, CheckTopology) {
+  const unsigned n = numa::num_nodes();
+  ASSERT_LE(1u, n);
+  for (unsigned i = 0; i < n; ++i) {
+    const vector<unsigned> cpus = numa::node_cpus(i);
+    EXPECT_TRUE(std::is_sorted(cpus.begin(), cpus.end()));
+  }
+  EXPECT_FALSE(numa::node_cpus(0).empty());
+  EXPECT_THROW(numa::node_cpus(n), Error);
+  EXPECT_LE(4096u, numa::page_size());
+}
+
+TEST_F(NUMATest, CheckMemoryPool) {
+  CPUMemoryPool pool(0);
+  EXPECT_EQ(0, pool.numa_node());
+  EXPECT_EQ(-1, CPUMemoryPool().numa_node());
+  for (const std::uint64_t size : {1ull, 100ull, 1ull << 20}) {
+    std::shared_ptr<void> p = pool.allocate(size);
+    EXPECT_EQ(
+        0u, reinterpret_cast<std::uintptr_t>(p.get()) %
+        CPUMemoryPool::ALIGNMENT);
+    std::memset(p.get(), 0, size);
+  }
+  EXPECT_THROW(CPUMemoryPool(numa::num_nodes()), Error);
+}
+
+TEST_F(NUMATest, CheckCPUDevice) {
+  CPUDevice dev(0, 2, 0);
+  EXPECT_EQ(0, dev.numa_node());
+  EXPECT_EQ(2u, dev.num_threads());
+  EXPECT_EQ(-1, CPUDevice(0, 2).numa_node());
+  const vector<float> x_data(1 << 16, 1);
+  const Tensor x = dev.new_tensor_by_vector({1 << 16}, x_data);
+  const Tensor y = tensor_ops::sum(2 * x, 0);
+  EXPECT_TRUE(vector_match(vector<float> {1 << 17}, y.to_vector()));
+  EXPECT_THROW(CPUDevice(0, 2, numa::num_nodes()), Error);
+}
+
+}  // namespace primitiv
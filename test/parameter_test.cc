@@ -1,5 +1,10 @@
 #include <config.h>
 
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
 #include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
@@ -174,6 +179,75 @@ TEST_F(ParameterTest, CheckAddGradient) {
   EXPECT_TRUE(vector_match(diff_values2, p.gradient().to_vector()));
 }
 
+TEST_F(ParameterTest, CheckAddSparseGradient) {
+  const Shape shape {2, 4};
+  Parameter p("test", shape, &dev);
+  EXPECT_FALSE(p.has_sparse_gradient());
+  p.reset_gradient();
+  EXPECT_FALSE(p.has_sparse_gradient());
+
+  const Tensor gy1 = dev.new_tensor_by_vector(
+      Shape({2}, 3), {1, 2, 3, 4, 5, 6});
+  p.add_gradient_rows(1, {3, 1, 3}, gy1);
+  EXPECT_TRUE(p.has_sparse_gradient());
+  EXPECT_EQ(1u, p.gradient_dim());
+  EXPECT_EQ(vector<unsigned>({1, 3}), p.gradient_rows());
+  EXPECT_TRUE(vector_match(
+        vector<float>({0, 0, 3, 4, 0, 0, 6, 8}), p.gradient().to_vector()));
+
+  const Tensor gy2 = dev.new_tensor_by_vector({2}, {1, 1});
+  p.add_gradient_rows(1, {0}, gy2);
+  EXPECT_TRUE(p.has_sparse_gradient());
+  EXPECT_EQ(vector<unsigned>({0, 1, 3}), p.gradient_rows());
+  EXPECT_TRUE(vector_match(
+        vector<float>({1, 1, 3, 4, 0, 0, 6, 8}), p.gradient().to_vector()));
+
+  p.reset_gradient();
+  EXPECT_FALSE(p.has_sparse_gradient());
+  EXPECT_TRUE(vector_match(vector<float>(8, 0), p.gradient().to_vector()));
+}
+
+TEST_F(ParameterTest, CheckResetNonFiniteSparseGradient) {
+  const float inf = std::numeric_limits<float>::infinity();
+  Parameter p("test", {2, 8}, &dev);
+  p.reset_gradient();
+  p.add_gradient_rows(1, {3}, dev.new_tensor_by_vector({2}, {inf, 1}));
+  p.add_gradient_rows(1, {5}, dev.new_tensor_by_vector({2}, {-inf, inf}));
+  p.add_gradient_rows(
+      1, {6}, dev.new_tensor_by_vector({2}, {1, std::nanf("")}));
+  ASSERT_TRUE(p.has_sparse_gradient());
+  p.reset_gradient();
+  EXPECT_TRUE(vector_match(vector<float>(16, 0), p.gradient().to_vector()));
+}
+
+TEST_F(ParameterTest, CheckSparseGradientBecomesDense) {
+  const Shape shape {2, 4};
+  const Tensor gy = dev.new_tensor_by_vector({2}, {1, 2});
+  Parameter p("test", shape, &dev);
+
+  // Gradients without reset_gradient() are not sparse.
+  p.add_gradient_rows(1, {0}, gy);
+  EXPECT_FALSE(p.has_sparse_gradient());
+
+  // Dense gradients.
+  p.reset_gradient();
+  p.add_gradient_rows(1, {0}, gy);
+  p.add_gradient(dev.new_tensor(shape, 1));
+  EXPECT_FALSE(p.has_sparse_gradient());
+  p.add_gradient_rows(1, {1}, gy);
+  EXPECT_FALSE(p.has_sparse_gradient());
+  EXPECT_TRUE(vector_match(
+        vector<float>({2, 3, 2, 3, 1, 1, 1, 1}), p.gradient().to_vector()));
+
+  // Slices along different dimensions.
+  p.reset_gradient();
+  p.add_gradient_rows(1, {0}, gy);
+  p.add_gradient_rows(0, {1}, dev.new_tensor({1, 4}, 1));
+  EXPECT_FALSE(p.has_sparse_gradient());
+  EXPECT_TRUE(vector_match(
+        vector<float>({1, 3, 0, 1, 0, 1, 0, 1}), p.gradient().to_vector()));
+}
+
 TEST_F(ParameterTest, CheckSaveLoad) {
   const Shape shape {2, 2};
   const vector<float> values {1, 2, 3, 4};
@@ -206,4 +280,67 @@ TEST_F(ParameterTest, CheckSaveLoadWithStats) {
   EXPECT_TRUE(vector_match(values, p2.stats("a").to_vector()));
 }
 
+TEST_F(ParameterTest, CheckSaveLoadBinary) {
+  const Shape shape {2, 2};
+  const vector<float> values {1, 2, 3, 4};
+  const std::string path = "/tmp/primitiv_ParameterTest_CheckSaveLoad_p.bin";
+  const Parameter p1("test", shape, values, &dev);
+
+  p1.save(path, true);
+
+  const Parameter p2 = Parameter::load(path, &dev);
+  EXPECT_EQ("test", p2.name());
+  EXPECT_EQ(shape, p2.shape());
+  EXPECT_TRUE(vector_match(values, p2.value().to_vector()));
+  EXPECT_TRUE(p2.stats_names().empty());
+}
+
+TEST_F(ParameterTest, CheckSaveLoadBinaryWithStats) {
+  const Shape shape {3};
+  const vector<float> values {1, 2, 3};
+  const vector<float> a_values {4, 5, 6, 7, 8, 9};
+  const vector<float> b_values {10};
+  const std::string path = "/tmp/primitiv_ParameterTest_CheckSaveLoad_p.bin";
+  Parameter p1("test", shape, values, &dev);
+  p1.add_stats("b", {});
+  p1.stats("b").reset_by_vector(b_values);
+  p1.add_stats("a", {3, 2});
+  p1.stats("a").reset_by_vector(a_values);
+
+  p1.save(path, true);
+
+  const Parameter p2 = Parameter::load(path, &dev);
+  EXPECT_EQ("test", p2.name());
+  EXPECT_EQ(shape, p2.shape());
+  EXPECT_TRUE(vector_match(values, p2.value().to_vector()));
+  ASSERT_TRUE(p2.has_stats("a"));
+  EXPECT_EQ(Shape({3, 2}), p2.stats("a").shape());
+  EXPECT_TRUE(vector_match(a_values, p2.stats("a").to_vector()));
+  ASSERT_TRUE(p2.has_stats("b"));
+  EXPECT_EQ(Shape(), p2.stats("b").shape());
+  EXPECT_TRUE(vector_match(b_values, p2.stats("b").to_vector()));
+}
+
+TEST_F(ParameterTest, CheckInvalidLoadBinary) {
+  const std::string path = "/tmp/primitiv_ParameterTest_CheckSaveLoad_p.bin";
+  const Parameter p1("test", {256}, vector<float>(256, 1), &dev);
+  p1.save(path, true);
+
+  // Truncates the data block.
+  std::string data;
+  {
+    std::ifstream ifs(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(ifs), {});
+  }
+  {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(data.data(), data.size() - 4);
+  }
+  EXPECT_THROW(Parameter::load(path, &dev), Error);
+
+  EXPECT_THROW(
+      Parameter::load("/tmp/primitiv_ParameterTest_no_such_file", &dev),
+      Error);
+}
+
 }  // namespace primitiv
@@ -0,0 +1,96 @@
+#include <config.h>
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
+#include <primitiv/graph.h>
+#include <primitiv/node_ops.h>
+#include <primitiv/parameter.h>
+#include <primitiv/quantized_parameter.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+using test_utils::vector_near;
+
+namespace primitiv {
+
+class QuantizedParameterTest : public testing::Test {
+protected:
+  CPUDevice dev;
+};
+
+TEST_F(QuantizedParameterTest, CheckInvalid) {
+  const QuantizedParameter q;
+  EXPECT_FALSE(q.valid());
+  EXPECT_EQ(nullptr, q.device());
+  EXPECT_THROW(q.dequantize(), Error);
+}
+
+TEST_F(QuantizedParameterTest, CheckNew) {
+  const Parameter param("w", {2, 3}, {1, 0, -2, 0, 4, .5}, &dev);
+  const QuantizedParameter q(param);
+  EXPECT_TRUE(q.valid());
+  EXPECT_EQ("w", q.name());
+  EXPECT_EQ(Shape({2, 3}), q.shape());
+  EXPECT_EQ(&dev, q.device());
+  EXPECT_EQ(2u * 32u, q.values().size());
+  ASSERT_EQ(2u, q.scales().size());
+  EXPECT_FLOAT_EQ(4.f / 127, q.scales()[0]);
+  EXPECT_FLOAT_EQ(.5f / 127, q.scales()[1]);
+  ASSERT_EQ(2u, q.sums().size());
+  EXPECT_EQ(32 - 64 + 127, q.sums()[0]);
+  EXPECT_EQ(127, q.sums()[1]);
+
+  const Tensor w = q.dequantize();
+  EXPECT_EQ(Shape({2, 3}), w.shape());
+  EXPECT_TRUE(vector_near(
+        vector<float> {1.007874, 0, -2.015748, 0, 4, .5}, w.to_vector(), 1e-5));
+}
+
+TEST_F(QuantizedParameterTest, CheckInvalidNew) {
+  const Parameter invalid;
+  EXPECT_THROW(QuantizedParameter q(invalid), Error);
+  const Parameter param("w", {2, 2, 2}, &dev);
+  EXPECT_THROW(QuantizedParameter q(param), Error);
+}
+
+TEST_F(QuantizedParameterTest, CheckMatmul) {
+  // Values are quantized without errors.
+  const Parameter param("w", {2, 3}, {127, 0, -64, 1, 32, -127}, &dev);
+  const QuantizedParameter q(param);
+  const Tensor x = dev.new_tensor_by_vector(
+      Shape({3, 2}, 2), {1, 2, 127, -3, -2, 127, 0, 0, 0, 127, 0, 0});
+  const Tensor y = dev.quantized_matmul_fw(q, x);
+  EXPECT_EQ(Shape({2, 2}, 2), y.shape());
+  EXPECT_TRUE(vector_near(
+        dev.matmul_fw(param.value(), x).to_vector(), y.to_vector(), 1e-3));
+
+  CPUDevice dev2;
+  EXPECT_THROW(dev2.quantized_matmul_fw(q, dev2.copy_tensor(x)), Error);
+  EXPECT_THROW(dev.quantized_matmul_fw(q, dev.new_tensor({2, 2})), Error);
+}
+
+TEST_F(QuantizedParameterTest, CheckNodeMatmul) {
+  Parameter param("w", {2, 3}, {127, 0, -64, 1, 32, -127}, &dev);
+  const QuantizedParameter q(param);
+  Graph g;
+  const Node x = node_ops::input(
+      Shape({3}, 2), {127, 2, 3, 4, 5, 127}, &dev, &g);
+  const Node y = node_ops::matmul(q, x);
+  const Node z = node_ops::matmul(node_ops::input(&param, &g), x);
+  EXPECT_EQ(Shape({2}, 2), y.shape());
+  EXPECT_TRUE(vector_near(
+        g.forward(z).to_vector(), g.forward(y).to_vector(), 1e-3));
+
+  // Only the gradient of the input is calculated.
+  const Node s = node_ops::sum(node_ops::batch::sum(y), 0);
+  g.forward(s);
+  g.backward(s);
+  EXPECT_TRUE(vector_near(
+        vector<float> {127, -63, -95, 127, -63, -95},
+        g.get_gradient(x).to_vector(), 1e-3));
+}
+
+}  // namespace primitiv
@@ -0,0 +1,122 @@
+#include <config.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/cpu_device.h>
+#include <primitiv/error.h>
+#include <primitiv/graph.h>
+#include <primitiv/inference_plan.h>
+#include <primitiv/node_ops.h>
+#include <primitiv/request_batcher.h>
+#include <test_utils.h>
+
+using std::vector;
+using test_utils::vector_match;
+
+namespace primitiv {
+
+class RequestBatcherTest : public testing::Test {
+protected:
+  // Plan calculating {2 * x + 1, sum(x)}.
+  RequestBatcherTest() {
+    namespace F = node_ops;
+    Graph g;
+    const Node x = F::input(Shape({2}), {0, 0}, &dev, &g);
+    plan.reset(new InferencePlan({x}, {2 * x + 1, F::sum(x, 0)}, &dev));
+  }
+
+  std::future<vector<Tensor>> submit(
+      RequestBatcher &batcher, const vector<float> &data) {
+    const unsigned n = data.size() / 2;
+    return batcher.submit({dev.new_tensor_by_vector(Shape({2}, n), data)});
+  }
+
+  static void check(
+      const vector<float> &data, const vector<Tensor> &ys) {
+    const unsigned n = data.size() / 2;
+    ASSERT_EQ(2u, ys.size());
+    EXPECT_EQ(Shape({2}, n), ys[0].shape());
+    EXPECT_EQ(Shape({}, n), ys[1].shape());
+    vector<float> y0, y1;
+    for (unsigned i = 0; i < n; ++i) {
+      y0.emplace_back(2 * data[2 * i] + 1);
+      y0.emplace_back(2 * data[2 * i + 1] + 1);
+      y1.emplace_back(data[2 * i] + data[2 * i + 1]);
+    }
+    EXPECT_TRUE(vector_match(y0, ys[0].to_vector()));
+    EXPECT_TRUE(vector_match(y1, ys[1].to_vector()));
+  }
+
+  CPUDevice dev;
+  std::unique_ptr<InferencePlan> plan;
+};
+
+TEST_F(RequestBatcherTest, CheckMaxBatchSize) {
+  // Requests are issued only when the minibatch is full.
+  RequestBatcher batcher(*plan, 4, std::chrono::seconds(60));
+  const vector<vector<float>> data {{1, 2}, {3, 4, 5, 6}, {-1, 0}};
+  vector<std::future<vector<Tensor>>> results;
+  for (const vector<float> &d : data) results.emplace_back(submit(batcher, d));
+  for (unsigned i = 0; i < data.size(); ++i) check(data[i], results[i].get());
+  EXPECT_EQ(1u, batcher.num_batches());
+  EXPECT_EQ(4u, batcher.num_samples());
+}
+
+TEST_F(RequestBatcherTest, CheckMaxDelay) {
+  RequestBatcher batcher(*plan, 100, std::chrono::milliseconds(1));
+  check({1, 2}, batcher.run({dev.new_tensor_by_vector({2}, {1, 2})}));
+  check({3, 4}, batcher.run({dev.new_tensor_by_vector({2}, {3, 4})}));
+  EXPECT_EQ(2u, batcher.num_batches());
+  EXPECT_EQ(2u, batcher.num_samples());
+}
+
+TEST_F(RequestBatcherTest, CheckIncompatibleShapes) {
+  RequestBatcher batcher(*plan, 10, std::chrono::milliseconds(100));
+  std::future<vector<Tensor>> r1 = submit(batcher, {1, 2});
+  std::future<vector<Tensor>> r2 =
+    batcher.submit({dev.new_tensor_by_vector({3}, {1, 2, 3})});
+  std::future<vector<Tensor>> r3 = submit(batcher, {3, 4});
+  std::future<vector<Tensor>> r4 = submit(batcher, {5, 6});
+  check({1, 2}, r1.get());
+  const vector<Tensor> y2 = r2.get();
+  EXPECT_TRUE(vector_match(vector<float> {3, 5, 7}, y2[0].to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {6}, y2[1].to_vector()));
+  check({3, 4}, r3.get());
+  check({5, 6}, r4.get());
+  EXPECT_EQ(3u, batcher.num_batches());
+}
+
+TEST_F(RequestBatcherTest, CheckConcurrentRequests) {
+  RequestBatcher batcher(*plan, 8, std::chrono::microseconds(200), 2);
+  vector<std::thread> threads;
+  vector<unsigned> failures(8, 0);
+  for (unsigned i = 0; i < 8; ++i) {
+    threads.emplace_back([&, i] {
+        for (unsigned j = 0; j < 10; ++j) {
+          const vector<float> data {1.f * i, 1.f * j};
+          const vector<Tensor> ys = submit(batcher, data).get();
+          if (ys[0].to_vector() != vector<float> {2.f * i + 1, 2.f * j + 1}) {
+            ++failures[i];
+          }
+        }
+    });
+  }
+  for (std::thread &t : threads) t.join();
+  EXPECT_EQ(vector<unsigned>(8, 0), failures);
+  EXPECT_EQ(80u, batcher.num_samples());
+  EXPECT_GE(80u, batcher.num_batches());
+}
+
+TEST_F(RequestBatcherTest, CheckInvalidRequests) {
+  EXPECT_THROW(RequestBatcher(*plan, 0, std::chrono::seconds(1)), Error);
+  EXPECT_THROW(RequestBatcher(*plan, 1, std::chrono::seconds(1), 0), Error);
+  RequestBatcher batcher(*plan, 1, std::chrono::seconds(1));
+  EXPECT_THROW(batcher.submit({}), Error);
+  EXPECT_THROW(batcher.submit({Tensor()}), Error);
+}
+
+}  // namespace primitiv
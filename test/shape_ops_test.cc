@@ -229,6 +229,34 @@ TEST_F(ShapeOpsTest, CheckInvalidConcat) {
   }
 }
 
+TEST_F(ShapeOpsTest, CheckBatchSlice) {
+  EXPECT_EQ(Shape({2, 3}), batch_slice(Shape({2, 3}), 0, 1));
+  EXPECT_EQ(Shape({2, 3}, 2), batch_slice(Shape({2, 3}, 4), 1, 3));
+  EXPECT_EQ(Shape({2, 3}, 4), batch_slice(Shape({2, 3}, 4), 0, 4));
+  EXPECT_THROW(batch_slice(Shape({2, 3}), 0, 2), Error);
+  EXPECT_THROW(batch_slice(Shape({2, 3}, 4), 2, 2), Error);
+  EXPECT_THROW(batch_slice(Shape({2, 3}, 4), 3, 5), Error);
+}
+
+TEST_F(ShapeOpsTest, CheckBatchConcat) {
+  const Shape a({2, 3}), b({2, 3}, 2), c({3, 2}), d({2, 3, 1}, 3);
+  EXPECT_EQ(a, batch_concat({&a}));
+  EXPECT_EQ(Shape({2, 3}, 3), batch_concat({&a, &b}));
+  EXPECT_EQ(Shape({2, 3}, 6), batch_concat({&b, &d, &a}));
+  EXPECT_THROW(batch_concat({}), Error);
+  EXPECT_THROW(batch_concat({&a, &c}), Error);
+}
+
+TEST_F(ShapeOpsTest, CheckBatchPick) {
+  EXPECT_EQ(Shape({2, 3}), batch_pick(Shape({2, 3}), {0}));
+  EXPECT_EQ(Shape({2, 3}, 3), batch_pick(Shape({2, 3}), {0, 0, 0}));
+  EXPECT_EQ(Shape({2, 3}, 2), batch_pick(Shape({2, 3}, 4), {3, 1}));
+  EXPECT_EQ(Shape({2, 3}, 5), batch_pick(Shape({2, 3}, 4), {3, 1, 1, 0, 2}));
+  EXPECT_THROW(batch_pick(Shape({2, 3}, 4), {}), Error);
+  EXPECT_THROW(batch_pick(Shape({2, 3}), {1}), Error);
+  EXPECT_THROW(batch_pick(Shape({2, 3}, 4), {0, 4}), Error);
+}
+
 TEST_F(ShapeOpsTest, CheckPick) {
   struct TestCase {
     Shape input;
@@ -270,6 +298,43 @@ TEST_F(ShapeOpsTest, CheckInvalidPick) {
   }
 }
 
+TEST_F(ShapeOpsTest, CheckGather) {
+  struct TestCase {
+    Shape input;
+    unsigned dim;
+    vector<unsigned> ids;
+    Shape expected;
+  };
+  const vector<TestCase> test_cases {
+    {Shape({2, 2, 2}, 3), 0, {0, 0, 0}, Shape({3, 2, 2}, 3)},
+    {Shape({2, 2, 2}, 3), 0, {1}, Shape({1, 2, 2}, 3)},
+    {{2, 2, 2}, 1, {1, 0}, {2, 2, 2}},
+    {{2, 2, 2}, 2, {1, 0, 1, 0}, {2, 2, 4}},
+    {{2, 2, 2}, 3, {0, 0}, {2, 2, 2, 2}},
+  };
+  for (const TestCase &tc : test_cases) {
+    const Shape observed = gather(tc.input, tc.dim, tc.ids);
+    EXPECT_EQ(tc.expected, observed);
+  }
+}
+
+TEST_F(ShapeOpsTest, CheckInvalidGather) {
+  struct TestCase {
+    Shape input;
+    unsigned dim;
+    vector<unsigned> ids;
+  };
+  const vector<TestCase> test_cases {
+     {Shape({2, 2, 2}, 3), 0, {}},
+     {Shape({2, 2, 2}, 3), 0, {2}},
+     {Shape({2, 2, 2}, 3), 1, {0, 2}},
+     {Shape({2, 2, 2}, 3), 3, {1}},
+  };
+  for (const TestCase &tc : test_cases) {
+    EXPECT_THROW(gather(tc.input, tc.dim, tc.ids), Error);
+  }
+}
+
 TEST_F(ShapeOpsTest, CheckTranspose) {
   EXPECT_EQ(Shape(), transpose({}));
   EXPECT_EQ(Shape({}, 5), transpose(Shape({}, 5)));
@@ -332,5 +397,66 @@ TEST_F(ShapeOpsTest, CheckInvalidMatMul) {
   EXPECT_THROW(matmul(Shape({}, 2), Shape({}, 3)), Error);
 }
 
+TEST_F(ShapeOpsTest, CheckAffine) {
+  EXPECT_EQ(Shape({20, 30}), affine({20, 10}, {10, 30}, {20}));
+  EXPECT_EQ(Shape({20, 30}, 3), affine(Shape({20, 10}, 3), {10, 30}, {20}));
+  EXPECT_EQ(Shape({20, 30}, 3), affine({20, 10}, Shape({10, 30}, 3), {20}));
+  EXPECT_EQ(Shape({20, 30}, 3), affine({20, 10}, {10, 30}, Shape({20}, 3)));
+  EXPECT_EQ(
+      Shape({20, 30}, 3),
+      affine(Shape({20, 10}, 3), Shape({10, 30}, 3), Shape({20}, 3)));
+  EXPECT_EQ(Shape({20}), affine({20, 10}, {10}, {20}));
+  EXPECT_EQ(Shape({1, 30}), affine({1, 10}, {10, 30}, {}));
+}
+
+TEST_F(ShapeOpsTest, CheckLSTMCell) {
+  EXPECT_EQ(Shape({2}), lstm_cell({4}, {}));
+  EXPECT_EQ(Shape({20}), lstm_cell({40}, {10}));
+  EXPECT_EQ(Shape({20, 5}), lstm_cell({40, 5}, {10, 5}));
+  EXPECT_EQ(Shape({20, 5}, 3), lstm_cell(Shape({40, 5}, 3), {10, 5}));
+  EXPECT_EQ(Shape({20, 5}, 3), lstm_cell({40, 5}, Shape({10, 5}, 3)));
+  EXPECT_EQ(
+      Shape({20, 5}, 3), lstm_cell(Shape({40, 5}, 3), Shape({10, 5}, 3)));
+}
+
+TEST_F(ShapeOpsTest, CheckInvalidLSTMCell) {
+  EXPECT_THROW(lstm_cell({30}, {10}), Error);
+  EXPECT_THROW(lstm_cell({40, 5}, {10, 4}), Error);
+  EXPECT_THROW(lstm_cell({40, 5, 2}, {10, 5, 2}), Error);
+  EXPECT_THROW(lstm_cell(Shape({40}, 2), Shape({10}, 3)), Error);
+}
+
+TEST_F(ShapeOpsTest, CheckLSTM) {
+  EXPECT_EQ(Shape({2}), lstm({4}, {4}, {}, {}));
+  EXPECT_EQ(Shape({20, 7}), lstm({40, 7}, {40, 10}, {10}, {10}));
+  EXPECT_EQ(
+      Shape({20, 7}, 3), lstm(Shape({40, 7}, 3), {40, 10}, {10}, {10}));
+  EXPECT_EQ(
+      Shape({20, 7}, 3), lstm({40, 7}, {40, 10}, Shape({10}, 3), {10}));
+  EXPECT_EQ(
+      Shape({20, 7}, 3), lstm({40, 7}, {40, 10}, {10}, Shape({10}, 3)));
+}
+
+TEST_F(ShapeOpsTest, CheckInvalidLSTM) {
+  EXPECT_THROW(lstm({30, 7}, {40, 10}, {10}, {10}), Error);
+  EXPECT_THROW(lstm({40, 7, 2}, {40, 10}, {10}, {10}), Error);
+  EXPECT_THROW(lstm({40, 7}, {40, 9}, {10}, {10}), Error);
+  EXPECT_THROW(lstm({40, 7}, {40, 10}, {10}, {9}), Error);
+  EXPECT_THROW(lstm({40, 7}, {40, 10}, {10, 2}, {10, 2}), Error);
+  EXPECT_THROW(lstm({40, 7}, Shape({40, 10}, 2), {10}, {10}), Error);
+  EXPECT_THROW(
+      lstm(Shape({40, 7}, 2), {40, 10}, Shape({10}, 3), {10}), Error);
+  EXPECT_THROW(
+      lstm({40, 7}, {40, 10}, Shape({10}, 2), Shape({10}, 3)), Error);
+}
+
+TEST_F(ShapeOpsTest, CheckInvalidAffine) {
+  EXPECT_THROW(affine({2, 3}, {4, 5}, {2}), Error);
+  EXPECT_THROW(affine({2, 3}, {3, 5}, {3}), Error);
+  EXPECT_THROW(affine({2, 3}, {3, 5}, {2, 5}), Error);
+  EXPECT_THROW(affine({2, 3}, {3, 5}, {2, 1, 2}), Error);
+  EXPECT_THROW(affine(Shape({2, 3}, 2), {3, 5}, Shape({2}, 3)), Error);
+}
+
 }  // namespace shape_ops
 }  // namespace primitiv
@@ -1,5 +1,7 @@
 #include <config.h>
 
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
@@ -354,6 +356,47 @@ TEST_F(TensorBackwardTest, CheckInvalidPick) {
   }
 }
 
+TEST_F(TensorBackwardTest, CheckPickAssign) {
+  const float inf = std::numeric_limits<float>::infinity();
+  const vector<float> a_data {0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3};
+  struct TestCase {
+    Shape a_shape, b_shape;
+    vector<float> b_data;
+    unsigned dim;
+    vector<unsigned> ids;
+    vector<float> y_data;
+  };
+  const vector<TestCase> test_cases {
+    {Shape({2, 2}, 3), Shape({1, 2}, 3), {5, 5, 6, 6, 7, 7}, 0, {0, 1, 0},
+      {5, 1, 5, 3, 0, 6, 2, 6, 7, 1, 7, 3}},
+    {Shape({2, 2}, 3), Shape({2}, 3), {5, 5, 6, 6, 7, 7}, 1, {1, 0, 1},
+      {0, 1, 5, 5, 6, 6, 2, 3, 0, 1, 7, 7}},
+    {Shape({2, 2}, 3), Shape({2}, 3), {5, 5, 6, 6, 7, 7}, 1, {0},
+      {5, 5, 2, 3, 6, 6, 2, 3, 7, 7, 2, 3}},
+    {{2, 6}, Shape({2}, 2), {5, 5, 6, 6}, 1, {4, 1},
+      {0, 1, 6, 6, 0, 1, 2, 3, 5, 5, 2, 3}},
+  };
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      Tensor a = dev->new_tensor_by_vector(tc.a_shape, a_data);
+      const Tensor b = dev->new_tensor_by_vector(tc.b_shape, tc.b_data);
+      dev->pick_assign(b, tc.dim, tc.ids, a);
+      EXPECT_TRUE(vector_match(tc.y_data, a.to_vector()));
+    }
+
+    // Non-finite values are also overwritten.
+    Tensor a = dev->new_tensor_by_vector({2, 2}, {inf, std::nanf(""), 1, 2});
+    dev->pick_assign(dev->new_tensor({2}, 0), 1, {0}, a);
+    EXPECT_TRUE(vector_match(vector<float> {0, 0, 1, 2}, a.to_vector()));
+
+    // Shape mismatched.
+    EXPECT_THROW(
+        dev->pick_assign(dev->new_tensor({3}, 0), 1, {0}, a), Error);
+    EXPECT_THROW(
+        dev->pick_assign(dev->new_tensor({2}, 0), 1, {2}, a), Error);
+  }
+}
+
 TEST_F(TensorBackwardTest, CheckCopyAndPick) {
   const vector<float> a_data {0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3};
   const vector<float> b_data {1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
@@ -1004,4 +1047,75 @@ TEST_F(TensorBackwardTest, CheckMatMulN1) {
   }
 }
 
+TEST_F(TensorBackwardTest, CheckAffine) {
+  struct TestCase { unsigned w_bs, x_bs, b_bs; };
+  const vector<TestCase> test_cases {
+    {1, 1, 1}, {1, 2, 1}, {2, 1, 1}, {1, 1, 2}, {2, 2, 2},
+  };
+  const vector<Device::Activation> activations {
+    Device::ACTIVATION_IDENTITY, Device::ACTIVATION_RELU,
+    Device::ACTIVATION_TANH, Device::ACTIVATION_SIGMOID,
+  };
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      const Shape sw({3, 4}, tc.w_bs), sx({4, 5}, tc.x_bs), sb({3}, tc.b_bs);
+      vector<float> w_data(sw.size()), x_data(sx.size()), b_data(sb.size());
+      for (unsigned i = 0; i < w_data.size(); ++i) w_data[i] = i % 7 * .25 - 1;
+      for (unsigned i = 0; i < x_data.size(); ++i) x_data[i] = i % 5 * .5 - 1;
+      for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = i * .5 - 1;
+      const Tensor w = dev->new_tensor_by_vector(sw, w_data);
+      const Tensor x = dev->new_tensor_by_vector(sx, x_data);
+      const Tensor b = dev->new_tensor_by_vector(sb, b_data);
+      for (Device::Activation act : activations) {
+        // Calculates expected gradients through the unfused operations.
+        const Tensor z = dev->matmul_fw(w, x);
+        const Tensor bb = dev->broadcast_fw(b, 1, 5);
+        const Tensor s = dev->add_fw(z, bb);
+        Tensor y;
+        switch (act) {
+          case Device::ACTIVATION_RELU: y = dev->prelu_fw(s, 0); break;
+          case Device::ACTIVATION_TANH: y = dev->tanh_fw(s); break;
+          case Device::ACTIVATION_SIGMOID: y = dev->sigmoid_fw(s); break;
+          default: y = s;
+        }
+        vector<float> gy_data(y.shape().size());
+        for (unsigned i = 0; i < gy_data.size(); ++i) {
+          gy_data[i] = static_cast<int>(i % 3) - 1;
+        }
+        const Tensor gy = dev->new_tensor_by_vector(y.shape(), gy_data);
+        Tensor gs = dev->new_tensor(s.shape(), 0);
+        switch (act) {
+          case Device::ACTIVATION_RELU: dev->prelu_bw(s, y, gy, 0, gs); break;
+          case Device::ACTIVATION_TANH: dev->tanh_bw(s, y, gy, gs); break;
+          case Device::ACTIVATION_SIGMOID: dev->sigmoid_bw(s, y, gy, gs); break;
+          default: dev->inplace_add(gy, gs);
+        }
+        Tensor gz = dev->new_tensor(z.shape(), 0);
+        Tensor gbb = dev->new_tensor(bb.shape(), 0);
+        dev->add_bw(z, bb, s, gs, gz, gbb);
+        Tensor ew = dev->new_tensor(sw, 0);
+        Tensor ex = dev->new_tensor(sx, 0);
+        dev->matmul_bw(w, x, z, gz, ew, ex);
+        const Tensor eb = dev->sum_fw(gbb, 1);
+
+        const Tensor ay = dev->affine_fw(w, x, b, act);
+        EXPECT_TRUE(vector_near(y.to_vector(), ay.to_vector(), 1e-6));
+        Tensor gw = dev->new_tensor(sw, 0);
+        Tensor gx = dev->new_tensor(sx, 0);
+        Tensor gb = dev->new_tensor(sb, 0);
+        dev->affine_bw(w, x, b, ay, gy, act, gw, gx, gb);
+        EXPECT_TRUE(vector_near(ew.to_vector(), gw.to_vector(), 1e-5))
+          << "w_bs=" << tc.w_bs << ", x_bs=" << tc.x_bs
+          << ", b_bs=" << tc.b_bs << ", activation=" << act;
+        EXPECT_TRUE(vector_near(ex.to_vector(), gx.to_vector(), 1e-5))
+          << "w_bs=" << tc.w_bs << ", x_bs=" << tc.x_bs
+          << ", b_bs=" << tc.b_bs << ", activation=" << act;
+        EXPECT_TRUE(vector_near(eb.to_vector(), gb.to_vector(), 1e-5))
+          << "w_bs=" << tc.w_bs << ", x_bs=" << tc.x_bs
+          << ", b_bs=" << tc.b_bs << ", activation=" << act;
+      }
+    }
+  }
+}
+
 }  // namespace primitiv
@@ -117,6 +117,37 @@ TEST_F(TensorOpsTest, CheckPickNN) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckGather) {
+  struct TestCase {
+    Shape x_shape;
+    unsigned dim;
+    vector<unsigned> ids;
+    Shape y_shape;
+    vector<float> values;
+  };
+  const vector<TestCase> test_cases {
+    {Shape({2, 2}, 2), 0, {1, 0, 1},
+      Shape({3, 2}, 2),
+      {1, 0, 1, 3, 2, 3, 5, 4, 5, 7, 6, 7}},
+    {Shape({2, 2}, 2), 1, {1},
+      Shape({2, 1}, 2),
+      {2, 3, 6, 7}},
+    {{2, 3}, 1, {2, 0, 2, 1},
+      {2, 4},
+      {4, 5, 0, 1, 4, 5, 2, 3}},
+  };
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      vector<float> x_data(tc.x_shape.size());
+      iota(x_data.begin(), x_data.end(), 0);
+      const Tensor x = dev->new_tensor_by_vector(tc.x_shape, x_data);
+      const Tensor y = gather(x, tc.dim, tc.ids);
+      EXPECT_EQ(tc.y_shape, y.shape());
+      EXPECT_TRUE(vector_match(tc.values, y.to_vector()));
+    }
+  }
+}
+
 TEST_F(TensorOpsTest, CheckInvalidPick) {
   struct TestCase {
     unsigned dim;
@@ -221,6 +252,73 @@ TEST_F(TensorOpsTest, CheckInvalidSlice) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckContiguousSliceSharesMemory) {
+  const vector<float> x_data {1, 2, 3, 4, 5, 6};
+  for (Device *dev : devices) {
+    Tensor x = dev->new_tensor_by_vector({2, 3}, x_data);
+    const float *px = static_cast<const float *>(
+        static_cast<const Tensor &>(x).data());
+    Tensor y = slice(x, 1, 1, 3);
+    EXPECT_EQ(Shape({2, 2}), y.shape());
+    EXPECT_EQ(px + 2, static_cast<const Tensor &>(y).data());
+    EXPECT_TRUE(vector_match(vector<float> {3, 4, 5, 6}, y.to_vector()));
+
+    // Updating either tensor never affects the other one.
+    y *= 2;
+    EXPECT_TRUE(vector_match(vector<float> {6, 8, 10, 12}, y.to_vector()));
+    EXPECT_TRUE(vector_match(x_data, x.to_vector()));
+    const Tensor z = slice(x, 1, 0, 1);
+    x *= 3;
+    EXPECT_TRUE(vector_match(vector<float> {1, 2}, z.to_vector()));
+
+    // Non-contiguous slices are copied.
+    const Tensor w = slice(x, 0, 1, 2);
+    EXPECT_NE(
+        static_cast<const Tensor &>(x).data(),
+        static_cast<const Tensor &>(w).data());
+    EXPECT_TRUE(vector_match(vector<float> {6, 12, 18}, w.to_vector()));
+  }
+}
+
+TEST_F(TensorOpsTest, CheckVectorTransposeSharesMemory) {
+  const vector<float> x_data {1, 2, 3};
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector(Shape({3}, 1), x_data);
+    Tensor y = transpose(x);
+    EXPECT_EQ(Shape({1, 3}), y.shape());
+    EXPECT_EQ(x.data(), static_cast<const Tensor &>(y).data());
+    y *= 2;
+    EXPECT_TRUE(vector_match(vector<float> {2, 4, 6}, y.to_vector()));
+    EXPECT_TRUE(vector_match(x_data, x.to_vector()));
+  }
+}
+
+TEST_F(TensorOpsTest, CheckBatchConcatAndSlice) {
+  const vector<float> y_data {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  for (Device *dev : devices) {
+    const Tensor a = dev->new_tensor_by_vector(Shape({2}, 2), {1, 2, 3, 4});
+    const Tensor b = dev->new_tensor_by_vector({2}, {5, 6});
+    const Tensor c = dev->new_tensor_by_vector(Shape({2}, 2), {7, 8, 9, 10});
+    const Tensor y = dev->batch_concat_fw({&a, &b, &c});
+    EXPECT_EQ(Shape({2}, 5), y.shape());
+    EXPECT_TRUE(vector_match(y_data, y.to_vector()));
+
+    // Slices of the minibatch share the memory.
+    Tensor z = dev->batch_slice_fw(y, 1, 3);
+    EXPECT_EQ(Shape({2}, 2), z.shape());
+    EXPECT_EQ(
+        static_cast<const float *>(y.data()) + 2,
+        static_cast<const Tensor &>(z).data());
+    EXPECT_TRUE(vector_match(vector<float> {3, 4, 5, 6}, z.to_vector()));
+    z *= 2;
+    EXPECT_TRUE(vector_match(y_data, y.to_vector()));
+
+    EXPECT_THROW(dev->batch_slice_fw(y, 3, 6), Error);
+    const Tensor w = dev->new_tensor_by_vector({1, 2}, {1, 2});
+    EXPECT_THROW(dev->batch_concat_fw({&a, &w}), Error);
+  }
+}
+
 TEST_F(TensorOpsTest, CheckConcatN_3x3) {
   const vector<float> y_data {
     1, 2, 3, 4, 5, 6, 1, 2, 3, 4, 5, 6, 1, 2, 3, 4, 5, 6,
@@ -331,6 +429,49 @@ TEST_F(TensorOpsTest, CheckConcatBatchBroadcast) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckConcatWithoutCopy) {
+  for (Device *dev : devices) {
+    // Tensors placed in the preallocated result.
+    Tensor y0 = dev->new_tensor({2, 3});
+    const void *p0 = static_cast<const Tensor &>(y0).data();
+    dev->place_next_tensor(y0, 0, 2);
+    const Tensor a = dev->new_tensor_by_vector({2}, {1, 2});
+    dev->place_next_tensor(y0, 2, 4);
+    const Tensor b = dev->new_tensor_by_vector({2, 2}, {3, 4, 5, 6});
+    y0 = Tensor();
+    const Tensor y1 = dev->concat_fw({&a, &b}, 1);
+    EXPECT_EQ(Shape({2, 3}), y1.shape());
+    EXPECT_EQ(p0, y1.data());
+    EXPECT_TRUE(vector_match(vector<float> {1, 2, 3, 4, 5, 6}, y1.to_vector()));
+
+    // Tensors in the wrong order, and concatenation with an incompatible
+    // layout.
+    const Tensor y2 = dev->concat_fw({&b, &a}, 1);
+    EXPECT_NE(p0, y2.data());
+    EXPECT_TRUE(vector_match(vector<float> {3, 4, 5, 6, 1, 2}, y2.to_vector()));
+    const Tensor y3 = dev->concat_fw({&a, &a}, 0);
+    EXPECT_NE(p0, y3.data());
+    EXPECT_TRUE(vector_match(vector<float> {1, 2, 1, 2}, y3.to_vector()));
+
+    // Adjacent slices, and minibatches.
+    const Tensor x = dev->new_tensor_by_vector(
+        Shape({2, 2}, 2), {1, 2, 3, 4, 5, 6, 7, 8});
+    const Tensor s1 = dev->batch_slice_fw(x, 0, 1);
+    const Tensor s2 = dev->batch_slice_fw(x, 1, 2);
+    const Tensor y4 = dev->batch_concat_fw({&s1, &s2});
+    EXPECT_EQ(x.data(), y4.data());
+    EXPECT_TRUE(vector_match(x.to_vector(), y4.to_vector()));
+    const Tensor c1 = dev->slice_fw(s1, 1, 0, 1);
+    const Tensor c2 = dev->slice_fw(s1, 1, 1, 2);
+    const Tensor y5 = dev->concat_fw({&c1, &c2}, 1);
+    EXPECT_EQ(x.data(), y5.data());
+    EXPECT_TRUE(vector_match(vector<float> {1, 2, 3, 4}, y5.to_vector()));
+
+    EXPECT_THROW(dev->place_next_tensor(x, 6, 4), Error);
+    dev->cancel_placement();
+  }
+}
+
 TEST_F(TensorOpsTest, CheckInvalidConcat) {
   for (Device *dev : devices) {
     const Tensor a = dev->new_tensor(Shape({1, 42}, 2), 0);
@@ -974,6 +1115,137 @@ TEST_F(TensorOpsTest, CheckMatMulBatchBroadcastN1) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckAffine) {
+  struct TestCase { unsigned w_bs, x_bs, b_bs; };
+  const vector<TestCase> test_cases {
+    {1, 1, 1}, {1, 2, 1}, {2, 1, 1}, {1, 1, 2}, {2, 2, 2},
+  };
+  const vector<Device::Activation> activations {
+    Device::ACTIVATION_IDENTITY, Device::ACTIVATION_RELU,
+    Device::ACTIVATION_TANH, Device::ACTIVATION_SIGMOID,
+  };
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      const Shape sw({3, 4}, tc.w_bs), sx({4, 5}, tc.x_bs), sb({3}, tc.b_bs);
+      vector<float> w_data(sw.size()), x_data(sx.size()), b_data(sb.size());
+      for (unsigned i = 0; i < w_data.size(); ++i) w_data[i] = i % 7 * .25 - 1;
+      for (unsigned i = 0; i < x_data.size(); ++i) x_data[i] = i % 5 * .5 - 1;
+      for (unsigned i = 0; i < b_data.size(); ++i) b_data[i] = i * .5 - 1;
+      const Tensor w = dev->new_tensor_by_vector(sw, w_data);
+      const Tensor x = dev->new_tensor_by_vector(sx, x_data);
+      const Tensor b = dev->new_tensor_by_vector(sb, b_data);
+      const Tensor z = matmul(w, x) + broadcast(b, 1, 5);
+      for (Device::Activation act : activations) {
+        Tensor expected;
+        switch (act) {
+          case Device::ACTIVATION_RELU: expected = relu(z); break;
+          case Device::ACTIVATION_TANH: expected = tanh(z); break;
+          case Device::ACTIVATION_SIGMOID: expected = sigmoid(z); break;
+          default: expected = z;
+        }
+        const Tensor y = affine(w, x, b, act);
+        EXPECT_EQ(expected.shape(), y.shape());
+        EXPECT_TRUE(vector_near(expected.to_vector(), y.to_vector(), 1e-6))
+          << "w_bs=" << tc.w_bs << ", x_bs=" << tc.x_bs
+          << ", b_bs=" << tc.b_bs << ", activation=" << act;
+      }
+    }
+  }
+}
+
+TEST_F(TensorOpsTest, CheckInvalidAffine) {
+  for (Device *dev : devices) {
+    const Tensor w = dev->new_tensor({2, 3});
+    const Tensor x = dev->new_tensor({3, 4});
+    EXPECT_THROW(affine(w, x, dev->new_tensor({3})), Error);
+    EXPECT_THROW(affine(w, x, dev->new_tensor({2, 4})), Error);
+    EXPECT_THROW(affine(w, w, dev->new_tensor({2})), Error);
+    EXPECT_THROW(
+        affine(
+          dev->new_tensor(Shape({2, 3}, 2)), x,
+          dev->new_tensor(Shape({2}, 3))),
+        Error);
+  }
+}
+
+TEST_F(TensorOpsTest, CheckLSTMCell) {
+  struct TestCase { unsigned u_bs, c_bs; };
+  const vector<TestCase> test_cases {{1, 1}, {2, 1}, {1, 2}, {2, 2}};
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      const Shape su({8, 3}, tc.u_bs), sc({2, 3}, tc.c_bs);
+      vector<float> u_data(su.size()), c_data(sc.size());
+      for (unsigned i = 0; i < u_data.size(); ++i) u_data[i] = i % 7 * .5 - 1.5;
+      for (unsigned i = 0; i < c_data.size(); ++i) c_data[i] = i % 3 * .5 - .5;
+      const Tensor u = dev->new_tensor_by_vector(su, u_data);
+      const Tensor c = dev->new_tensor_by_vector(sc, c_data);
+      // Each column of u is [i; f; o; j].
+      const Tensor ur = u.reshape(Shape({2, 4, 3}, tc.u_bs));
+      const auto gate = [&](unsigned k) {
+        return slice(ur, 1, k, k + 1).reshape(Shape({2, 3}, tc.u_bs));
+      };
+      const Tensor ig = sigmoid(gate(0));
+      const Tensor fg = sigmoid(gate(1));
+      const Tensor og = sigmoid(gate(2));
+      const Tensor jg = tanh(gate(3));
+      const Tensor cc = ig * jg + fg * c;
+      const Tensor hh = og * tanh(cc);
+      const Tensor expected = concat({&hh, &cc}, 0);
+      const Tensor y = lstm_cell(u, c);
+      EXPECT_EQ(expected.shape(), y.shape());
+      EXPECT_TRUE(vector_near(expected.to_vector(), y.to_vector(), 1e-6))
+        << "u_bs=" << tc.u_bs << ", c_bs=" << tc.c_bs;
+    }
+  }
+}
+
+TEST_F(TensorOpsTest, CheckLSTM) {
+  struct TestCase { unsigned xu_bs, h0_bs, c0_bs; };
+  const vector<TestCase> test_cases {
+    {1, 1, 1}, {2, 1, 1}, {1, 2, 1}, {1, 1, 2}, {2, 2, 2},
+  };
+  const unsigned n = 3, steps = 5;
+  for (Device *dev : devices) {
+    for (const TestCase &tc : test_cases) {
+      const Shape sxu({4 * n, steps}, tc.xu_bs), swh({4 * n, n});
+      const Shape sh0({n}, tc.h0_bs), sc0({n}, tc.c0_bs);
+      vector<float> xu_data(sxu.size()), wh_data(swh.size());
+      vector<float> h0_data(sh0.size()), c0_data(sc0.size());
+      for (unsigned i = 0; i < xu_data.size(); ++i) {
+        xu_data[i] = i % 7 * .5 - 1.5;
+      }
+      for (unsigned i = 0; i < wh_data.size(); ++i) {
+        wh_data[i] = i % 5 * .2 - .4;
+      }
+      for (unsigned i = 0; i < h0_data.size(); ++i) {
+        h0_data[i] = i % 3 * .5 - .5;
+      }
+      for (unsigned i = 0; i < c0_data.size(); ++i) {
+        c0_data[i] = i % 4 * .5 - .7;
+      }
+      const Tensor xu = dev->new_tensor_by_vector(sxu, xu_data);
+      const Tensor wh = dev->new_tensor_by_vector(swh, wh_data);
+      const Tensor h0 = dev->new_tensor_by_vector(sh0, h0_data);
+      const Tensor c0 = dev->new_tensor_by_vector(sc0, c0_data);
+      Tensor h = h0, c = c0;
+      vector<Tensor> ys;
+      for (unsigned t = 0; t < steps; ++t) {
+        ys.emplace_back(lstm_cell(slice(xu, 1, t, t + 1) + matmul(wh, h), c));
+        h = slice(ys.back(), 0, 0, n);
+        c = slice(ys.back(), 0, n, 2 * n);
+      }
+      vector<const Tensor *> yps;
+      for (const Tensor &yt : ys) yps.emplace_back(&yt);
+      const Tensor expected = concat(yps, 1);
+      const Tensor y = lstm(xu, wh, h0, c0);
+      EXPECT_EQ(expected.shape(), y.shape());
+      EXPECT_TRUE(vector_near(expected.to_vector(), y.to_vector(), 1e-6))
+        << "xu_bs=" << tc.xu_bs << ", h0_bs=" << tc.h0_bs
+        << ", c0_bs=" << tc.c0_bs;
+    }
+  }
+}
+
 TEST_F(TensorOpsTest, CheckInvalidMatMul) {
   for (Device *dev : devices) {
     {
@@ -1305,6 +1577,38 @@ TEST_F(TensorOpsTest, CheckLogSumExp2) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckLogSumExpLargeValues) {
+  // Values are large enough to overflow exp(x) without the shift.
+  const vector<float> x_data {1000, 1001, -1000, -1001};
+  const vector<float> y_data {1001.31326169, -999.68673831};
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector({2, 2}, x_data);
+    EXPECT_TRUE(vector_near(y_data, logsumexp(x, 0).to_vector(), 1e-2));
+    EXPECT_TRUE(vector_near(
+          vector<float>({-1.31326169, -.31326169, -.31326169, -1.31326169}),
+          log_softmax(x, 0).to_vector(), 1e-4));
+    EXPECT_TRUE(vector_near(
+          vector<float>({.26894142, .73105858, .73105858, .26894142}),
+          softmax(x, 0).to_vector(), 1e-6));
+  }
+}
+
+TEST_F(TensorOpsTest, CheckSoftmaxManyRows) {
+  // Rows are interleaved and more than the number of rows processed at once.
+  const unsigned m = 150, n = 3;
+  vector<float> x_data(m * n);
+  for (unsigned i = 0; i < m * n; ++i) x_data[i] = (i % m) * .01 + (i / m);
+  const float lse = std::log(std::exp(0.f) + std::exp(1.f) + std::exp(2.f));
+  vector<float> y_data(m), z_data(m * n);
+  for (unsigned i = 0; i < m; ++i) y_data[i] = i * .01 + lse;
+  for (unsigned i = 0; i < m * n; ++i) z_data[i] = (i / m) - lse;
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector({m, n}, x_data);
+    EXPECT_TRUE(vector_near(y_data, logsumexp(x, 1).to_vector(), 1e-4));
+    EXPECT_TRUE(vector_near(z_data, log_softmax(x, 1).to_vector(), 1e-4));
+  }
+}
+
 TEST_F(TensorOpsTest, CheckLogSoftmax) {
   const vector<float> x_data {
     1, 2, 3, 4, 5, 6, 7, 8, -1, -2, -3, -4, -5, -6, -7, -8,
@@ -1500,6 +1804,90 @@ TEST_F(TensorOpsTest, CheckBatchSum) {
   }
 }
 
+TEST_F(TensorOpsTest, CheckBatchPick) {
+  const vector<float> x_data {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  const vector<float> y_data {9, 10, 11, 12, 1, 2, 3, 4, 9, 10, 11, 12};
+  const vector<float> gx_data {1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 2, 2};
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector(Shape({2, 2}, 3), x_data);
+    const Tensor y = batch_pick(x, {2, 0, 2});
+    EXPECT_EQ(Shape({2, 2}, 3), y.shape());
+    EXPECT_TRUE(vector_match(y_data, y.to_vector()));
+    const Tensor y1 = batch_pick(x, {1});
+    EXPECT_EQ(Shape({2, 2}), y1.shape());
+    EXPECT_TRUE(vector_match(vector<float> {5, 6, 7, 8}, y1.to_vector()));
+    Tensor gx = dev->new_tensor(x.shape(), 0);
+    const Tensor copied = gx;
+    dev->batch_pick_bw(dev->new_tensor(y.shape(), 1), {2, 0, 2}, gx);
+    EXPECT_TRUE(vector_match(gx_data, gx.to_vector()));
+    EXPECT_TRUE(vector_match(vector<float>(12, 0), copied.to_vector()));
+    EXPECT_THROW(batch_pick(x, {}), Error);
+    EXPECT_THROW(batch_pick(x, {3}), Error);
+    EXPECT_THROW(
+        dev->batch_pick_bw(dev->new_tensor(y.shape(), 1), {2, 0}, gx), Error);
+  }
+}
+
+TEST_F(TensorOpsTest, CheckTopK) {
+  const vector<float> x_data {
+    3, 1, 4, 1, 5, 9, 2, 6,
+    -1, -1, 0, -2, 0, -3, 7, -1,
+  };
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector(Shape({4, 2}, 2), x_data);
+    vector<unsigned> ids;
+    vector<float> values;
+    dev->top_k(x, 3, ids, values);
+    EXPECT_EQ((vector<unsigned> {5, 7, 4, 6, 2, 4}), ids);
+    EXPECT_TRUE(vector_match(vector<float> {9, 6, 5, 7, 0, 0}, values));
+    dev->top_k(x, 8, ids, values);
+    EXPECT_EQ(16u, ids.size());
+    EXPECT_EQ((vector<unsigned> {5, 7, 4, 2, 0, 6, 1, 3}),
+        vector<unsigned>(ids.begin(), ids.begin() + 8));
+    EXPECT_EQ((vector<unsigned> {6, 2, 4, 0, 1, 7, 3, 5}),
+        vector<unsigned>(ids.begin() + 8, ids.end()));
+    EXPECT_THROW(dev->top_k(x, 0, ids, values), Error);
+    EXPECT_THROW(dev->top_k(x, 9, ids, values), Error);
+  }
+}
+
+TEST_F(TensorOpsTest, CheckBatchMomentsAndNormalize) {
+  const vector<float> x_data {
+    10001, -1, 10002, 1, 10003, -1, 10006, 1,
+  };
+  const vector<float> y_data {
+    -0.92582010, -0.86602540, -0.46291005, 0.86602540,
+    0, -0.86602540, 1.38873015, 0.86602540,
+  };
+  for (Device *dev : devices) {
+    const Tensor x = dev->new_tensor_by_vector(Shape({2}, 4), x_data);
+    Tensor mean, var;
+    dev->batch_moments_fw(x, mean, var);
+    EXPECT_EQ(Shape({2}), mean.shape());
+    EXPECT_EQ(Shape({2}), var.shape());
+    EXPECT_TRUE(vector_match(vector<float> {10003, 0}, mean.to_vector()));
+    EXPECT_TRUE(vector_near(
+          vector<float> {14. / 3, 4. / 3}, var.to_vector(), 1e-5));
+    const Tensor y = dev->batch_normalize_fw(x, mean, var, 0);
+    EXPECT_EQ(Shape({2}, 4), y.shape());
+    EXPECT_TRUE(vector_near(y_data, y.to_vector(), 1e-5));
+  }
+}
+
+TEST_F(TensorOpsTest, CheckInvalidBatchMomentsAndNormalize) {
+  for (Device *dev : devices) {
+    Tensor mean, var;
+    EXPECT_THROW(dev->batch_moments_fw(dev->new_tensor({2}), mean, var), Error);
+    const Tensor x = dev->new_tensor(Shape({2}, 3));
+    EXPECT_THROW(
+        dev->batch_normalize_fw(
+          x, dev->new_tensor({3}), dev->new_tensor({2}), 0), Error);
+    EXPECT_THROW(
+        dev->batch_normalize_fw(
+          x, dev->new_tensor({2}), dev->new_tensor(Shape({2}, 3)), 0), Error);
+  }
+}
+
 TEST_F(TensorOpsTest, CheckSoftmaxCrossEntropy) {
   const vector<vector<float>> x_data {
     {-1, 0, 1, 1, 0, 0, 0, 0, 1},
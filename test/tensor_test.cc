@@ -1,5 +1,6 @@
 #include <config.h>
 
+#include <cstdint>
 #include <utility>
 #include <vector>
 #include <gtest/gtest.h>
@@ -388,6 +389,150 @@ TEST_F(TensorTest, CheckUnique) {
   }
 }
 
+TEST_F(TensorTest, CheckToArray) {
+  for (Device *dev : devices) {
+    const vector<float> data {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    const Tensor x = dev->new_tensor_by_vector(Shape({2, 2}, 3), data);
+    vector<float> values(12, -1);
+    x.to_array(values.data());
+    EXPECT_TRUE(vector_match(data, values));
+  }
+}
+
+TEST_F(TensorTest, CheckView) {
+  for (Device *dev : devices) {
+    Tensor x = dev->new_tensor_by_vector({6}, {1, 2, 3, 4, 5, 6});
+    EXPECT_FALSE(x.aliased());
+    Tensor v = x.view({2}, 3);
+    EXPECT_TRUE(x.aliased());
+    EXPECT_TRUE(v.aliased());
+    EXPECT_EQ(Shape({2}), v.shape());
+    EXPECT_EQ(
+        static_cast<const float *>(static_cast<const Tensor &>(x).data()) + 3,
+        static_cast<const Tensor &>(v).data());
+    EXPECT_TRUE(vector_match(vector<float> {4, 5}, v.to_vector()));
+
+    // Updates are visible through both tensors.
+    v.reset(0);
+    EXPECT_TRUE(vector_match(
+          vector<float> {1, 2, 3, 0, 0, 6}, x.to_vector()));
+    x *= 2;
+    EXPECT_TRUE(vector_match(
+          vector<float> {2, 4, 6, 0, 0, 12}, x.to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {0, 0}, v.to_vector()));
+
+    // Copies are not aliased, and they are not changed by updates of views.
+    Tensor copied = v;
+    const Tensor reshaped = v.reshape({1, 2});
+    const Tensor flattened = x.flatten();
+    Tensor assigned;
+    assigned = x;
+    EXPECT_FALSE(copied.aliased());
+    EXPECT_FALSE(reshaped.aliased());
+    EXPECT_FALSE(flattened.aliased());
+    EXPECT_FALSE(assigned.aliased());
+    copied.reset(1);
+    EXPECT_TRUE(vector_match(vector<float> {0, 0}, v.to_vector()));
+    EXPECT_TRUE(vector_match(vector<float> {1, 1}, copied.to_vector()));
+    x.reset(-1);
+    EXPECT_TRUE(vector_match(vector<float> {0, 0}, reshaped.to_vector()));
+    EXPECT_TRUE(vector_match(
+          vector<float> {2, 4, 6, 0, 0, 12}, flattened.to_vector()));
+    EXPECT_TRUE(vector_match(
+          vector<float> {2, 4, 6, 0, 0, 12}, assigned.to_vector()));
+    x.reset_by_vector({2, 4, 6, 0, 0, 12});
+
+    // Moves keep the aliasing.
+    Tensor moved = std::move(v);
+    EXPECT_TRUE(moved.aliased());
+    moved.reset(3);
+    EXPECT_TRUE(vector_match(
+          vector<float> {2, 4, 6, 3, 3, 12}, x.to_vector()));
+  }
+}
+
+TEST_F(TensorTest, CheckMakeUnique) {
+  for (Device *dev : devices) {
+    Tensor x = dev->new_tensor({2}, 1);
+    EXPECT_TRUE(x.unique());
+    Tensor copied = x;
+    EXPECT_FALSE(x.unique());
+    EXPECT_FALSE(copied.unique());
+
+    // make_unique() duplicates the shared memory explicitly.
+    const std::uint64_t num_cows = Tensor::num_copy_on_writes();
+    copied.make_unique();
+    EXPECT_EQ(num_cows, Tensor::num_copy_on_writes());
+    EXPECT_TRUE(x.unique());
+    EXPECT_TRUE(copied.unique());
+    EXPECT_NE(
+        static_cast<const Tensor &>(x).data(),
+        static_cast<const Tensor &>(copied).data());
+    const void *ptr = static_cast<const Tensor &>(copied).data();
+    copied.make_unique();
+    EXPECT_EQ(ptr, static_cast<const Tensor &>(copied).data());
+
+    // Aliased views are detached from the original memory.
+    Tensor v = x.view({1}, 1);
+    v.make_unique();
+    EXPECT_FALSE(v.aliased());
+    v.reset(2);
+    EXPECT_TRUE(vector_match(vector<float> {1, 1}, x.to_vector()));
+
+    Tensor invalid;
+    EXPECT_FALSE(invalid.unique());
+    EXPECT_THROW(invalid.make_unique(), Error);
+  }
+}
+
+namespace {
+
+unsigned num_hook_calls = 0;
+void count_hook_calls(const Tensor &) { ++num_hook_calls; }
+
+}  // namespace
+
+TEST_F(TensorTest, CheckCopyOnWriteHook) {
+  for (Device *dev : devices) {
+    Tensor x = dev->new_tensor({2}, 1);
+    Tensor copied = x;
+    const std::uint64_t num_cows = Tensor::num_copy_on_writes();
+    num_hook_calls = 0;
+    Tensor::set_copy_on_write_hook(count_hook_calls);
+    copied *= 2;
+    EXPECT_EQ(num_cows + 1, Tensor::num_copy_on_writes());
+    EXPECT_EQ(1u, num_hook_calls);
+
+    // Unique tensors and aliased views are updated without copies, and
+    // copies of views have their own memory.
+    copied *= 2;
+    Tensor v = x.view({2}, 0);
+    Tensor v2 = v;
+    v *= 2;
+    v2 *= 2;
+    EXPECT_EQ(num_cows + 1, Tensor::num_copy_on_writes());
+    EXPECT_EQ(1u, num_hook_calls);
+
+    Tensor::set_copy_on_write_hook(nullptr);
+    Tensor copied2 = copied;
+    copied2 *= 2;
+    EXPECT_EQ(num_cows + 2, Tensor::num_copy_on_writes());
+    EXPECT_EQ(1u, num_hook_calls);
+  }
+}
+
+TEST_F(TensorTest, CheckInvalidView) {
+  for (Device *dev : devices) {
+    Tensor x = dev->new_tensor({6});
+    EXPECT_NO_THROW(x.view({6}, 0));
+    EXPECT_NO_THROW(x.view({2}, 4));
+    EXPECT_THROW(x.view({2}, 5), Error);
+    EXPECT_THROW(x.view({7}, 0), Error);
+    Tensor invalid;
+    EXPECT_THROW(invalid.view({}, 0), Error);
+  }
+}
+
 TEST_F(TensorTest, CheckResetValuesByConstant) {
   for (Device *dev : devices) {
     {
@@ -0,0 +1,84 @@
+#include <config.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#include <primitiv/thread_pool.h>
+
+using std::vector;
+
+namespace primitiv {
+
+class ThreadPoolTest : public testing::Test {};
+
+TEST_F(ThreadPoolTest, CheckNumThreads) {
+  EXPECT_EQ(1u, ThreadPool(0).num_threads());
+  EXPECT_EQ(1u, ThreadPool(1).num_threads());
+  EXPECT_EQ(2u, ThreadPool(2).num_threads());
+  EXPECT_EQ(8u, ThreadPool(8).num_threads());
+}
+
+TEST_F(ThreadPoolTest, CheckParallelFor) {
+  for (unsigned num_threads : {1u, 2u, 3u, 8u}) {
+    ThreadPool pool(num_threads);
+    for (unsigned size : {0u, 1u, 7u, 100u, 1000u, 12345u}) {
+      for (unsigned grain : {0u, 1u, 10u, 100000u}) {
+        vector<unsigned> counts(size, 0);
+        pool.parallel_for(size, grain, [&](unsigned begin, unsigned end) {
+          EXPECT_LT(begin, end);
+          EXPECT_LE(end, size);
+          for (unsigned i = begin; i < end; ++i) ++counts[i];
+        });
+        for (unsigned i = 0; i < size; ++i) {
+          EXPECT_EQ(1u, counts[i]);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, CheckGrain) {
+  ThreadPool pool(4);
+  std::atomic<unsigned> num_calls(0);
+  pool.parallel_for(100, 100, [&](unsigned begin, unsigned end) {
+    EXPECT_EQ(0u, begin);
+    EXPECT_EQ(100u, end);
+    ++num_calls;
+  });
+  EXPECT_EQ(1u, num_calls);
+}
+
+TEST_F(ThreadPoolTest, CheckNestedParallelFor) {
+  ThreadPool pool(4);
+  vector<unsigned> counts(100 * 100, 0);
+  pool.parallel_for(100, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; ++i) {
+      // Runs on the current thread.
+      pool.parallel_for(100, 1, [&](unsigned b, unsigned e) {
+        for (unsigned j = b; j < e; ++j) ++counts[i * 100 + j];
+      });
+    }
+  });
+  for (unsigned c : counts) {
+    EXPECT_EQ(1u, c);
+  }
+}
+
+TEST_F(ThreadPoolTest, CheckException) {
+  ThreadPool pool(4);
+  EXPECT_THROW(
+      pool.parallel_for(1000, 1, [](unsigned begin, unsigned) {
+        if (begin == 0) throw std::runtime_error("error");
+      }),
+      std::runtime_error);
+
+  // The pool is still available.
+  std::atomic<unsigned> sum(0);
+  pool.parallel_for(1000, 1, [&](unsigned begin, unsigned end) {
+    sum += end - begin;
+  });
+  EXPECT_EQ(1000u, sum);
+}
+
+}  // namespace primitiv
@@ -1,5 +1,7 @@
 #include <config.h>
 
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
 #include <primitiv/error.h>
@@ -17,12 +19,50 @@ namespace trainers {
 class TrainerImplTest : public testing::Test {
 protected:
   CPUDevice dev;
+
+  // Updates a large parameter by multiple threads while its value and
+  // statistics are shared with other tensors.
+  static void check_shared_update(Trainer &trainer) {
+    CPUDevice dev8(0, 8);
+    const Shape shape({1 << 20});
+    Parameter param("param", shape, vector<float>(shape.size(), 1), &dev8);
+    trainer.add_parameter(&param);
+    for (unsigned i = 0; i < 3; ++i) {
+      const vector<std::string> names = param.stats_names();
+      const Tensor value = param.value();
+      vector<Tensor> stats;
+      for (const std::string &name : names) {
+        stats.emplace_back(param.stats(name));
+      }
+      const vector<float> prev_value = value.to_vector();
+      trainer.reset_gradients();
+      param.gradient() += param.value();
+      trainer.update(.1);
+
+      // Copies keep old values, and all elements are updated.
+      EXPECT_TRUE(vector_match(prev_value, value.to_vector()));
+      const vector<float> next_value = param.value().to_vector();
+      EXPECT_NE(prev_value[0], next_value[0]);
+      EXPECT_TRUE(vector_match(
+            vector<float>(shape.size(), next_value[0]), next_value));
+      for (unsigned j = 0; j < names.size(); ++j) {
+        const vector<float> next_stats = param.stats(names[j]).to_vector();
+        EXPECT_NE(stats[j].to_vector()[0], next_stats[0]);
+        EXPECT_TRUE(vector_match(
+              vector<float>(shape.size(), next_stats[0]), next_stats));
+      }
+    }
+  }
 };
 
 TEST_F(TrainerImplTest, CheckDefaultHyperparameters) {
   SGD sgd;
   EXPECT_FLOAT_EQ(.1, sgd.eta());
 
+  MomentumSGD msgd;
+  EXPECT_FLOAT_EQ(.01, msgd.eta());
+  EXPECT_FLOAT_EQ(.9, msgd.momentum());
+
   Adam adam;
   EXPECT_FLOAT_EQ(.001, adam.alpha());
   EXPECT_FLOAT_EQ(.9, adam.beta1());
@@ -35,6 +75,10 @@ TEST_F(TrainerImplTest, CheckGivenHyperparameters) {
   SGD sgd(1);
   EXPECT_FLOAT_EQ(1, sgd.eta());
 
+  MomentumSGD msgd(1, 2);
+  EXPECT_FLOAT_EQ(1, msgd.eta());
+  EXPECT_FLOAT_EQ(2, msgd.momentum());
+
   Adam adam(1, 2, 3, 4);
   EXPECT_FLOAT_EQ(1, adam.alpha());
   EXPECT_FLOAT_EQ(2, adam.beta1());
@@ -43,6 +87,21 @@ TEST_F(TrainerImplTest, CheckGivenHyperparameters) {
   EXPECT_EQ(1u, adam.epoch());
 }
 
+TEST_F(TrainerImplTest, CheckStates) {
+  SGD sgd;
+  EXPECT_TRUE(sgd.get_states().empty());
+  EXPECT_NO_THROW(sgd.set_states({}));
+
+  Adam adam;
+  EXPECT_EQ(1u, adam.get_states().at("epoch"));
+  adam.set_states({{"epoch", 42}});
+  EXPECT_EQ(42u, adam.epoch());
+  EXPECT_EQ(42u, adam.get_states().at("epoch"));
+  EXPECT_THROW(adam.set_states({}), Error);
+  EXPECT_THROW(adam.set_states({{"epoch", 0}}), Error);
+  EXPECT_EQ(42u, adam.epoch());
+}
+
 TEST_F(TrainerImplTest, CheckSGD) {
   Parameter param("param", {2, 2}, {1, 2, 3, 4}, &dev);
   ASSERT_TRUE(vector_match(
@@ -70,6 +129,46 @@ TEST_F(TrainerImplTest, CheckSGD) {
   }
 }
 
+TEST_F(TrainerImplTest, CheckMomentumSGD) {
+  Parameter param("param", {2, 2}, {1, 2, 3, 4}, &dev);
+  ASSERT_TRUE(vector_match(
+        vector<float> {1, 2, 3, 4}, param.value().to_vector()));
+
+  MomentumSGD trainer;
+  trainer.add_parameter(&param);
+  ASSERT_TRUE(param.has_stats("momentumsgd-m"));
+  EXPECT_TRUE(vector_match(
+        vector<float>(4, 0), param.stats("momentumsgd-m").to_vector()));
+
+  const vector<vector<float>> expected_v {
+    {9.9900000e-01, 1.9980000e+00, 2.9970000e+00, 3.9960000e+00},
+    {9.9710100e-01, 1.9942020e+00, 2.9913030e+00, 3.9884040e+00},
+    {9.9439480e-01, 1.9887896e+00, 2.9831844e+00, 3.9775792e+00},
+    {9.9096482e-01, 1.9819296e+00, 2.9728945e+00, 3.9638593e+00},
+    {9.8688688e-01, 1.9737738e+00, 2.9606606e+00, 3.9475475e+00},
+  };
+  const vector<vector<float>> expected_m {
+    {-1.0000000e-03, -2.0000000e-03, -3.0000000e-03, -4.0000000e-03},
+    {-1.8990000e-03, -3.7980000e-03, -5.6970000e-03, -7.5960000e-03},
+    {-2.7062010e-03, -5.4124020e-03, -8.1186030e-03, -1.0824804e-02},
+    {-3.4299757e-03, -6.8599514e-03, -1.0289927e-02, -1.3719903e-02},
+    {-4.0779430e-03, -8.1558859e-03, -1.2233829e-02, -1.6311772e-02},
+  };
+
+  for (unsigned i = 0; i < 5; ++i) {
+    trainer.reset_gradients();
+    EXPECT_TRUE(vector_match(
+          vector<float>(4, 0), param.gradient().to_vector()));
+
+    param.gradient() += param.value();  // Squared loss
+    trainer.update(.1);
+    EXPECT_TRUE(vector_near(
+          expected_v[i], param.value().to_vector(), 1e-5));
+    EXPECT_TRUE(vector_near(
+          expected_m[i], param.stats("momentumsgd-m").to_vector(), 1e-5));
+  }
+}
+
 TEST_F(TrainerImplTest, CheckAdam) {
   Parameter param("param", {2, 2}, {1, 2, 3, 4}, &dev);
   ASSERT_TRUE(vector_match(
@@ -123,5 +222,89 @@ TEST_F(TrainerImplTest, CheckAdam) {
   }
 }
 
+TEST_F(TrainerImplTest, CheckSparseSGD) {
+  Parameter param("param", {2, 3}, {1, 2, 3, 4, 5, 6}, &dev);
+  SGD trainer;
+  trainer.add_parameter(&param);
+  trainer.reset_gradients();
+  const Tensor gy = dev.new_tensor_by_vector(
+      Shape({2}, 3), {1, 2, 3, 4, 5, 6});
+  param.add_gradient_rows(1, {2, 0, 2}, gy);
+  trainer.update(1);
+  EXPECT_TRUE(vector_near(
+        vector<float>({.7, 1.6, 3, 4, 4.4, 5.2}),
+        param.value().to_vector(), 1e-5));
+  trainer.reset_gradients();
+  EXPECT_FALSE(param.has_sparse_gradient());
+  EXPECT_TRUE(vector_match(vector<float>(6, 0), param.gradient().to_vector()));
+}
+
+TEST_F(TrainerImplTest, CheckSparseAdam) {
+  // Updated slices should be the same as the dense update, and other slices
+  // and their statistics should not be changed.
+  Parameter sparse("sparse", {2, 2}, {1, 2, 3, 4}, &dev);
+  Parameter dense("dense", {2}, {3, 4}, &dev);
+  Adam sparse_trainer, dense_trainer;
+  sparse_trainer.add_parameter(&sparse);
+  dense_trainer.add_parameter(&dense);
+
+  for (unsigned i = 0; i < 5; ++i) {
+    sparse_trainer.reset_gradients();
+    dense_trainer.reset_gradients();
+    const Tensor gy = dev.new_tensor_by_vector({2}, {1, 2});
+    sparse.add_gradient_rows(1, {1}, gy);
+    dense.gradient() += gy;
+    ASSERT_TRUE(sparse.has_sparse_gradient());
+    sparse_trainer.update(.1);
+    dense_trainer.update(.1);
+
+    const vector<float> v = sparse.value().to_vector();
+    const vector<float> m1 = sparse.stats("adam-m1").to_vector();
+    const vector<float> m2 = sparse.stats("adam-m2").to_vector();
+    EXPECT_TRUE(vector_match(vector<float>({1, 2}), {v[0], v[1]}));
+    EXPECT_TRUE(vector_match(vector<float>({0, 0}), {m1[0], m1[1]}));
+    EXPECT_TRUE(vector_match(vector<float>({0, 0}), {m2[0], m2[1]}));
+    EXPECT_TRUE(vector_match(dense.value().to_vector(), {v[2], v[3]}));
+    EXPECT_TRUE(vector_match(
+          dense.stats("adam-m1").to_vector(), {m1[2], m1[3]}));
+    EXPECT_TRUE(vector_match(
+          dense.stats("adam-m2").to_vector(), {m2[2], m2[3]}));
+  }
+}
+
+TEST_F(TrainerImplTest, CheckMultipleParameters) {
+  Parameter param1("param1", {2, 2}, {1, 2, 3, 4}, &dev);
+  Parameter param2("param2", {4}, {1, 2, 3, 4}, &dev);
+  CPUDevice dev2;
+  Parameter param3("param3", {2, 2}, {1, 2, 3, 4}, &dev2);
+
+  Adam trainer;
+  trainer.add_parameter(&param1);
+  trainer.add_parameter(&param2);
+  trainer.add_parameter(&param3);
+  trainer.reset_gradients();
+  param1.gradient() += param1.value();
+  param2.gradient() += param2.value();
+  param3.gradient() += param3.value();
+  trainer.update(.1);
+
+  const vector<float> expected_v {
+    9.9990000e-01, 1.9999000e+00, 2.9999000e+00, 3.9999000e+00,
+  };
+  EXPECT_TRUE(vector_near(expected_v, param1.value().to_vector(), 1e-5));
+  EXPECT_TRUE(vector_near(expected_v, param2.value().to_vector(), 1e-5));
+  EXPECT_TRUE(vector_near(expected_v, param3.value().to_vector(), 1e-5));
+  EXPECT_EQ(2u, trainer.epoch());
+}
+
+TEST_F(TrainerImplTest, CheckSharedValuesWithMultipleThreads) {
+  SGD sgd;
+  check_shared_update(sgd);
+  MomentumSGD momentum_sgd;
+  check_shared_update(momentum_sgd);
+  Adam adam;
+  check_shared_update(adam);
+}
+
 }  // namespace trainers
 }  // namespace primitiv
@@ -1,5 +1,8 @@
 #include <config.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <gtest/gtest.h>
 #include <primitiv/cpu_device.h>
 #include <primitiv/error.h>
@@ -9,6 +12,7 @@
 
 using std::vector;
 using test_utils::vector_match;
+using test_utils::vector_near;
 
 namespace primitiv {
 
@@ -40,4 +44,240 @@ TEST_F(TraingerTest, CheckAddParameter) {
   EXPECT_THROW(trainer.add_parameter(&param4), Error);
 }
 
+TEST_F(TraingerTest, CheckPackGradients) {
+  trainers::SGD trainer(.1);
+  Parameter param1("param1", {2}, {1, 2}, &dev);
+  Parameter param2("param2", {3}, {3, 4, 5}, &dev);
+  trainer.add_parameter(&param1);
+  trainer.add_parameter(&param2);
+  param1.gradient().reset(1);
+  param2.gradient().reset(2);
+  EXPECT_THROW(trainer.packed_gradients(&dev), Error);
+
+  trainer.pack_parameters();
+  EXPECT_THROW(trainer.packed_values(&dev), Error);
+  Tensor &grads = trainer.packed_gradients(&dev);
+  EXPECT_EQ(Shape({5}), grads.shape());
+  EXPECT_TRUE(param1.gradient().aliased());
+  EXPECT_TRUE(param2.gradient().aliased());
+  EXPECT_FALSE(param1.value().aliased());
+  EXPECT_TRUE(
+      vector_match(vector<float> {1, 1}, param1.gradient().to_vector()));
+  EXPECT_TRUE(
+      vector_match(vector<float> {2, 2, 2}, param2.gradient().to_vector()));
+
+  // Updates of the flat buffer are visible through parameters, and vice versa.
+  grads *= 3;
+  EXPECT_TRUE(
+      vector_match(vector<float> {3, 3}, param1.gradient().to_vector()));
+  EXPECT_TRUE(
+      vector_match(vector<float> {6, 6, 6}, param2.gradient().to_vector()));
+  trainer.update(1);
+  EXPECT_TRUE(
+      vector_match(vector<float> {.7, 1.7}, param1.value().to_vector()));
+  EXPECT_TRUE(vector_near(
+        vector<float> {2.4, 3.4, 4.4}, param2.value().to_vector(), 1e-6));
+
+  trainer.reset_gradients();
+  EXPECT_TRUE(vector_match(vector<float>(5, 0), grads.to_vector()));
+  EXPECT_TRUE(vector_match(vector<float>(2, 0), param1.gradient().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float>(3, 0), param2.gradient().to_vector()));
+
+  // Replaced gradients are reset individually.
+  param1.gradient() = dev.new_tensor({2}, 5);
+  trainer.reset_gradients();
+  EXPECT_TRUE(vector_match(vector<float>(2, 0), param1.gradient().to_vector()));
+
+  // Parameters registered later are not packed.
+  Parameter param3("param3", {2}, {1, 2}, &dev);
+  trainer.add_parameter(&param3);
+  param3.gradient().reset(1);
+  trainer.reset_gradients();
+  EXPECT_FALSE(param3.gradient().aliased());
+  EXPECT_TRUE(vector_match(vector<float>(2, 0), param3.gradient().to_vector()));
+}
+
+TEST_F(TraingerTest, CheckPackValuesAndStats) {
+  trainers::Adam trainer;
+  Parameter param1("param1", {2}, {1, 2}, &dev);
+  Parameter param2("param2", {2}, {3, 4}, &dev);
+  trainer.add_parameter(&param1);
+  trainer.add_parameter(&param2);
+  trainer.pack_parameters(true);
+
+  Tensor &values = trainer.packed_values(&dev);
+  EXPECT_EQ(Shape({4}), values.shape());
+  EXPECT_TRUE(param1.value().aliased());
+  EXPECT_TRUE(param1.stats("adam-m1").aliased());
+  EXPECT_TRUE(param2.stats("adam-m2").aliased());
+  EXPECT_TRUE(vector_match(vector<float> {1, 2}, param1.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {3, 4}, param2.value().to_vector()));
+
+  trainer.reset_gradients();
+  param1.gradient() += param1.value();
+  param2.gradient() += param2.value();
+  trainer.update(.1);
+  EXPECT_TRUE(vector_near(
+        vector<float> {.9999, 1.9999}, param1.value().to_vector(), 1e-5));
+  EXPECT_TRUE(vector_near(
+        vector<float> {2.9999, 3.9999}, param2.value().to_vector(), 1e-5));
+
+  vector<float> flat = param1.value().to_vector();
+  for (float x : param2.value().to_vector()) flat.emplace_back(x);
+  vector<float> packed = values.to_vector();
+  std::sort(flat.begin(), flat.end());
+  std::sort(packed.begin(), packed.end());
+  EXPECT_TRUE(vector_match(flat, packed));
+}
+
+TEST_F(TraingerTest, CheckLossScaling) {
+  trainers::SGD trainer(1);
+  Parameter param1("param1", {2}, {1, 2}, &dev);
+  Parameter param2("param2", {2}, {3, 4}, &dev);
+  trainer.add_parameter(&param1);
+  trainer.add_parameter(&param2);
+  EXPECT_EQ(1, trainer.loss_scale());
+
+  trainer.enable_loss_scaling(8, 2);
+  EXPECT_EQ(8, trainer.loss_scale());
+
+  // Gradients are divided by the scale.
+  param1.gradient().reset_by_vector({8, 16});
+  param2.gradient().reset_by_vector({-8, 0});
+  trainer.update(1);
+  EXPECT_TRUE(vector_match(vector<float> {0, 0}, param1.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {4, 4}, param2.value().to_vector()));
+  EXPECT_EQ(8, trainer.loss_scale());
+
+  // Non-finite gradients skip the update.
+  const float inf = std::numeric_limits<float>::infinity();
+  param1.gradient().reset_by_vector({8, 8});
+  param2.gradient().reset_by_vector({inf, 8});
+  trainer.update(1);
+  EXPECT_TRUE(vector_match(vector<float> {0, 0}, param1.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {4, 4}, param2.value().to_vector()));
+  EXPECT_EQ(4, trainer.loss_scale());
+  param2.gradient().reset_by_vector({std::nanf(""), 0});
+  trainer.update(1);
+  EXPECT_EQ(2, trainer.loss_scale());
+
+  // The scale grows after `growth_interval` successful updates.
+  param1.gradient().reset_by_vector({2, 2});
+  param2.gradient().reset_by_vector({2, 2});
+  trainer.update(1);
+  EXPECT_EQ(2, trainer.loss_scale());
+  EXPECT_TRUE(
+      vector_match(vector<float> {-1, -1}, param1.value().to_vector()));
+  param1.gradient().reset_by_vector({2, 2});
+  param2.gradient().reset_by_vector({2, 2});
+  trainer.update(1);
+  EXPECT_EQ(4, trainer.loss_scale());
+  EXPECT_TRUE(
+      vector_match(vector<float> {-2, -2}, param1.value().to_vector()));
+
+  trainer.disable_loss_scaling();
+  EXPECT_EQ(1, trainer.loss_scale());
+  param1.gradient().reset_by_vector({inf, 0});
+  trainer.update(1);
+  EXPECT_EQ(-inf, param1.value().to_vector()[0]);
+}
+
+TEST_F(TraingerTest, CheckLossScalingWithSparseGradient) {
+  const float inf = std::numeric_limits<float>::infinity();
+  trainers::SGD trainer(1);
+  Parameter param("param", {2, 4}, vector<float>(8, 0), &dev);
+  trainer.add_parameter(&param);
+  trainer.enable_loss_scaling(8, 100);
+
+  // The overflowed slice should not remain after reset_gradients().
+  trainer.reset_gradients();
+  param.add_gradient_rows(1, {3}, dev.new_tensor_by_vector({2}, {inf, 1}));
+  ASSERT_TRUE(param.has_sparse_gradient());
+  trainer.update(1);
+  EXPECT_EQ(4, trainer.loss_scale());
+  EXPECT_TRUE(vector_match(vector<float>(8, 0), param.value().to_vector()));
+
+  trainer.reset_gradients();
+  EXPECT_TRUE(vector_match(vector<float>(8, 0), param.gradient().to_vector()));
+  param.add_gradient_rows(1, {3}, dev.new_tensor_by_vector({2}, {4, 8}));
+  trainer.update(1);
+  EXPECT_EQ(4, trainer.loss_scale());
+  EXPECT_TRUE(vector_match(
+        vector<float> {0, 0, 0, 0, 0, 0, -1, -2}, param.value().to_vector()));
+}
+
+TEST_F(TraingerTest, CheckInvalidLossScaling) {
+  trainers::SGD trainer;
+  EXPECT_THROW(trainer.enable_loss_scaling(0.5, 1), Error);
+  EXPECT_THROW(trainer.enable_loss_scaling(std::nanf(""), 1), Error);
+  EXPECT_THROW(trainer.enable_loss_scaling(1, 0), Error);
+  EXPECT_EQ(1, trainer.loss_scale());
+}
+
+TEST_F(TraingerTest, CheckGradientClipping) {
+  trainers::SGD trainer(1);
+  Parameter param1("param1", {2}, {0, 0}, &dev);
+  Parameter param2("param2", {1}, {0}, &dev);
+  trainer.add_parameter(&param1);
+  trainer.add_parameter(&param2);
+  EXPECT_EQ(0, trainer.max_gradient_norm());
+
+  trainer.enable_gradient_clipping(5);
+  EXPECT_EQ(5, trainer.max_gradient_norm());
+
+  // Gradients with the small norm are not changed.
+  param1.gradient().reset_by_vector({1, 2});
+  param2.gradient().reset_by_vector({2});
+  EXPECT_FLOAT_EQ(3, trainer.gradient_norm());
+  trainer.update(1);
+  EXPECT_TRUE(vector_match(vector<float> {-1, -2}, param1.value().to_vector()));
+  EXPECT_TRUE(vector_match(vector<float> {-2}, param2.value().to_vector()));
+
+  // Gradients are scaled by 5 / 10.
+  param1.gradient().reset_by_vector({6, 0});
+  param2.gradient().reset_by_vector({-8});
+  EXPECT_FLOAT_EQ(10, trainer.gradient_norm());
+  trainer.update(1);
+  EXPECT_TRUE(vector_near(
+        vector<float> {-4, -2}, param1.value().to_vector(), 1e-6));
+  EXPECT_TRUE(vector_near(vector<float> {2}, param2.value().to_vector(), 1e-6));
+  EXPECT_FLOAT_EQ(5, trainer.gradient_norm());
+
+  // Gradients are clipped after the loss scaling.
+  CPUDevice dev2;
+  Parameter param3("param3", {1}, {0}, &dev2);
+  trainer.add_parameter(&param3);
+  trainer.enable_loss_scaling(2, 100);
+  param1.gradient().reset_by_vector({0, 12});
+  param2.gradient().reset_by_vector({0});
+  param3.gradient().reset_by_vector({16});
+  EXPECT_FLOAT_EQ(20, trainer.gradient_norm());
+  trainer.update(1);
+  EXPECT_TRUE(vector_near(
+        vector<float> {-4, -5}, param1.value().to_vector(), 1e-6));
+  EXPECT_TRUE(vector_near(
+        vector<float> {-4}, param3.value().to_vector(), 1e-6));
+
+  trainer.disable_gradient_clipping();
+  EXPECT_EQ(0, trainer.max_gradient_norm());
+  param1.gradient().reset_by_vector({20, 0});
+  param2.gradient().reset_by_vector({0});
+  param3.gradient().reset_by_vector({0});
+  trainer.update(1);
+  EXPECT_TRUE(vector_near(
+        vector<float> {-14, -5}, param1.value().to_vector(), 1e-6));
+}
+
+TEST_F(TraingerTest, CheckInvalidGradientClipping) {
+  trainers::SGD trainer;
+  EXPECT_THROW(trainer.enable_gradient_clipping(0), Error);
+  EXPECT_THROW(trainer.enable_gradient_clipping(-1), Error);
+  EXPECT_THROW(trainer.enable_gradient_clipping(std::nanf("")), Error);
+  EXPECT_THROW(
+      trainer.enable_gradient_clipping(
+        std::numeric_limits<float>::infinity()),
+      Error);
+  EXPECT_EQ(0, trainer.max_gradient_norm());
+}
+
 }  // namespace primitiv